@@ -0,0 +1,416 @@
+
+// CompressionBenchmark.cpp
+
+// Implements the main app entrypoint and the cCompressionBenchmark class representing the entire app
+
+#include "Globals.h"
+#include "CompressionBenchmark.h"
+#include "Logger.h"
+#include "LoggerListeners.h"
+#include <chrono>
+
+
+
+
+
+/** The compression factor used for the chunk NBT data, the same as the server's default. */
+static const int CHUNK_COMPRESSION_FACTOR = 6;
+
+/** The compression factor used for the protocol data, the same as the protocol uses. */
+static const int PACKET_COMPRESSION_FACTOR = Z_DEFAULT_COMPRESSION;
+
+/** Number of blocks in a chunk section (16 x 16 x 16), and the number of sections in a chunk. */
+static const size_t SECTION_BLOCKS = 4096;
+static const size_t NUM_SECTIONS = 16;
+
+/** The size of the slices in the "small" corpus, and the number of slices taken from each chunk. */
+static const size_t SMALL_PACKET_SIZE = 1024;
+static const size_t SMALL_PACKETS_PER_CHUNK = 16;
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	cLogger::cListener * consoleLogListener = MakeConsoleListener();
+	cLogger::GetInstance().AttachListener(consoleLogListener);
+
+	cLogger::InitiateMultithreading();
+
+	cCompressionBenchmark Benchmark;
+	if (!Benchmark.Init(argc, argv))
+	{
+		return 1;
+	}
+
+	Benchmark.Run();
+
+	cLogger::GetInstance().DetachListener(consoleLogListener);
+	delete consoleLogListener;
+
+	return 0;
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cCompressionBenchmark:
+
+cCompressionBenchmark::cCompressionBenchmark(void) :
+	m_NumRepetitions(5),
+	m_MaxNumChunks(10000)
+{
+}
+
+
+
+
+
+bool cCompressionBenchmark::Init(int argc, char ** argv)
+{
+	if ((argc < 2) || (argc > 4))
+	{
+		LOGERROR("Usage: CompressionBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]");
+		return false;
+	}
+	m_WorldFolder = argv[1];
+	if (argc > 2)
+	{
+		m_NumRepetitions = std::max(atoi(argv[2]), 1);
+	}
+	if (argc > 3)
+	{
+		m_MaxNumChunks = static_cast<size_t>(std::max(atoi(argv[3]), 1));
+	}
+	return true;
+}
+
+
+
+
+
+void cCompressionBenchmark::Run(void)
+{
+	// Load the corpora:
+	AString Folder = m_WorldFolder + "/region";
+	AStringVector Files = cFile::GetFolderContents(Folder);
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); (itr != end) && (m_Chunks.size() < m_MaxNumChunks); ++itr)
+	{
+		int RegionX, RegionZ;
+		char Ext[4] = "";
+		if ((sscanf(itr->c_str(), "r.%d.%d.%3s", &RegionX, &RegionZ, Ext) == 3) && (strcmp(Ext, "mca") == 0))
+		{
+			LoadAnvilFile(Folder + "/" + *itr);
+		}
+	}
+	if (m_Chunks.empty())
+	{
+		LOGERROR("No chunks found in \"%s\".", Folder.c_str());
+		return;
+	}
+	LOGINFO("Loaded %u chunks.", static_cast<unsigned>(m_Chunks.size()));
+
+	if (!Prepare(m_Chunks) || !Prepare(m_Packets) || !Prepare(m_SmallPackets))
+	{
+		LOGERROR("The pooled compression produces different data than the per-call compression.");
+		return;
+	}
+
+	Measure("chunk", m_Chunks);
+	Measure("packet", m_Packets);
+	Measure("small", m_SmallPackets);
+}
+
+
+
+
+
+void cCompressionBenchmark::LoadAnvilFile(const AString & a_FileName)
+{
+	cFile f;
+	if (!f.Open(a_FileName, cFile::fmRead))
+	{
+		LOGWARNING("Cannot open file %s for reading, skipping file.", a_FileName.c_str());
+		return;
+	}
+	Byte Locations[4 KiB];
+	if (f.Read(Locations, sizeof(Locations)) != sizeof(Locations))
+	{
+		LOGWARNING("Cannot read Locations in file %s, skipping file.", a_FileName.c_str());
+		return;
+	}
+	for (size_t i = 0; (i < 1024) && (m_Chunks.size() < m_MaxNumChunks); i++)
+	{
+		int SectorNum = (Locations[4 * i] << 16) | (Locations[4 * i + 1] << 8) | Locations[4 * i + 2];
+		if ((SectorNum < 2) || (Locations[4 * i + 3] == 0))
+		{
+			continue;
+		}
+		Byte Buf[5];
+		if ((f.Seek(SectorNum * (4 KiB)) < 0) || (f.Read(Buf, 5) != 5) || (Buf[4] != 2))
+		{
+			continue;
+		}
+		int CompressedSize = ((Buf[0] << 24) | (Buf[1] << 16) | (Buf[2] << 8) | Buf[3]) - 1;
+		if ((CompressedSize <= 0) || (CompressedSize > Locations[4 * i + 3] * (4 KiB)))
+		{
+			continue;
+		}
+		AString Compressed;
+		Compressed.resize(static_cast<size_t>(CompressedSize));
+		sPayload Chunk;
+		Chunk.m_Factor = CHUNK_COMPRESSION_FACTOR;
+		if (
+			(f.Read(&Compressed[0], Compressed.size()) != CompressedSize) ||
+			(InflateString(Compressed.data(), Compressed.size(), Chunk.m_Data) != Z_OK)
+		)
+		{
+			continue;
+		}
+		cParsedNBT NBT(Chunk.m_Data.data(), Chunk.m_Data.size());
+		if (!NBT.IsValid())
+		{
+			continue;
+		}
+		AddPacket(NBT);
+		m_Chunks.push_back(std::move(Chunk));
+	}
+}
+
+
+
+
+
+void cCompressionBenchmark::AddPacket(const cParsedNBT & a_NBT)
+{
+	// The layout of cChunkDataSerializer's 1.8 data: the blocks as two bytes each, the block light, the sky light and the biomes:
+	const size_t NumBlocks = SECTION_BLOCKS * NUM_SECTIONS;
+	const size_t BlockLightOffset = 2 * NumBlocks;
+	const size_t SkyLightOffset = BlockLightOffset + NumBlocks / 2;
+	const size_t BiomeOffset = SkyLightOffset + NumBlocks / 2;
+	sPayload Packet;
+	Packet.m_Factor = PACKET_COMPRESSION_FACTOR;
+	Packet.m_Data.assign(BiomeOffset + 256, '\0');
+
+	int Level = a_NBT.FindChildByName(a_NBT.GetRoot(), "Level");
+	if (Level < 0)
+	{
+		return;
+	}
+	int Biomes = a_NBT.FindChildByName(Level, "Biomes");
+	if ((Biomes >= 0) && (a_NBT.GetType(Biomes) == TAG_ByteArray) && (a_NBT.GetDataLength(Biomes) == 256))
+	{
+		memcpy(&Packet.m_Data[BiomeOffset], a_NBT.GetData(Biomes), 256);
+	}
+	int Sections = a_NBT.FindChildByName(Level, "Sections");
+	if ((Sections < 0) || (a_NBT.GetType(Sections) != TAG_List))
+	{
+		return;
+	}
+	for (int Section = a_NBT.GetFirstChild(Sections); Section >= 0; Section = a_NBT.GetNextSibling(Section))
+	{
+		int Y = a_NBT.FindChildByName(Section, "Y");
+		int Blocks = a_NBT.FindChildByName(Section, "Blocks");
+		int Data = a_NBT.FindChildByName(Section, "Data");
+		int BlockLight = a_NBT.FindChildByName(Section, "BlockLight");
+		int SkyLight = a_NBT.FindChildByName(Section, "SkyLight");
+		if (
+			(Y < 0) || (a_NBT.GetType(Y) != TAG_Byte) || (a_NBT.GetByte(Y) >= static_cast<int>(NUM_SECTIONS)) ||
+			(Blocks < 0) || (a_NBT.GetDataLength(Blocks) != SECTION_BLOCKS) ||
+			(Data < 0) || (a_NBT.GetDataLength(Data) != SECTION_BLOCKS / 2) ||
+			(BlockLight < 0) || (a_NBT.GetDataLength(BlockLight) != SECTION_BLOCKS / 2) ||
+			(SkyLight < 0) || (a_NBT.GetDataLength(SkyLight) != SECTION_BLOCKS / 2)
+		)
+		{
+			continue;
+		}
+		size_t FirstBlock = static_cast<size_t>(a_NBT.GetByte(Y)) * SECTION_BLOCKS;
+		const Byte * BlockTypes = reinterpret_cast<const Byte *>(a_NBT.GetData(Blocks));
+		const Byte * BlockMetas = reinterpret_cast<const Byte *>(a_NBT.GetData(Data));
+		for (size_t i = 0; i < SECTION_BLOCKS; i++)
+		{
+			Byte Meta = (BlockMetas[i / 2] >> ((i & 1) * 4)) & 0x0f;
+			Packet.m_Data[2 * (FirstBlock + i)]     = static_cast<char>((BlockTypes[i] << 4) | Meta);
+			Packet.m_Data[2 * (FirstBlock + i) + 1] = static_cast<char>(BlockTypes[i] >> 4);
+		}
+		memcpy(&Packet.m_Data[BlockLightOffset + FirstBlock / 2], a_NBT.GetData(BlockLight), SECTION_BLOCKS / 2);
+		memcpy(&Packet.m_Data[SkyLightOffset + FirstBlock / 2], a_NBT.GetData(SkyLight), SECTION_BLOCKS / 2);
+	}
+
+	// Take the slices evenly spread over the whole data:
+	const size_t SliceDistance = Packet.m_Data.size() / SMALL_PACKETS_PER_CHUNK;
+	for (size_t i = 0; i < SMALL_PACKETS_PER_CHUNK; i++)
+	{
+		sPayload Slice;
+		Slice.m_Factor = PACKET_COMPRESSION_FACTOR;
+		Slice.m_Data.assign(Packet.m_Data, i * SliceDistance, SMALL_PACKET_SIZE);
+		m_SmallPackets.push_back(std::move(Slice));
+	}
+	m_Packets.push_back(std::move(Packet));
+}
+
+
+
+
+
+bool cCompressionBenchmark::Prepare(cPayloads & a_Payloads)
+{
+	for (cPayloads::iterator itr = a_Payloads.begin(), end = a_Payloads.end(); itr != end; ++itr)
+	{
+		int Factor = itr->m_Factor;
+		uLongf PerCallSize = compressBound(static_cast<uLong>(itr->m_Data.size()));
+		AString PerCall(PerCallSize, '\0');
+		if (compress2(reinterpret_cast<Bytef *>(&PerCall[0]), &PerCallSize, reinterpret_cast<const Bytef *>(itr->m_Data.data()), static_cast<uLong>(itr->m_Data.size()), Factor) != Z_OK)
+		{
+			return false;
+		}
+		PerCall.resize(PerCallSize);
+
+		// Compress twice, so that the reused state is verified, too:
+		for (int i = 0; i < 2; i++)
+		{
+			size_t PooledSize = compressBound(static_cast<uLong>(itr->m_Data.size()));
+			itr->m_Compressed.assign(PooledSize, '\0');
+			if (CompressBuffer(itr->m_Data.data(), itr->m_Data.size(), &itr->m_Compressed[0], PooledSize, Factor) != Z_OK)
+			{
+				return false;
+			}
+			itr->m_Compressed.resize(PooledSize);
+			if (itr->m_Compressed != PerCall)
+			{
+				return false;
+			}
+		}
+
+		// Check the decompression, including the detection of a too small buffer:
+		AString Uncompressed(itr->m_Data.size(), '\0');
+		size_t UncompressedSize = Uncompressed.size();
+		size_t TooSmallSize = UncompressedSize - 1;
+		if (
+			(UncompressBuffer(itr->m_Compressed.data(), itr->m_Compressed.size(), &Uncompressed[0], UncompressedSize) != Z_OK) ||
+			(UncompressedSize != itr->m_Data.size()) ||
+			(Uncompressed != itr->m_Data) ||
+			(UncompressBuffer(itr->m_Compressed.data(), itr->m_Compressed.size(), &Uncompressed[0], TooSmallSize) != Z_BUF_ERROR)
+		)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+void cCompressionBenchmark::Measure(const char * a_CorpusName, const cPayloads & a_Payloads)
+{
+	size_t TotalSize = 0, TotalCompressed = 0;
+	for (cPayloads::const_iterator itr = a_Payloads.begin(), end = a_Payloads.end(); itr != end; ++itr)
+	{
+		TotalSize += itr->m_Data.size();
+		TotalCompressed += itr->m_Compressed.size();
+	}
+	LOGINFO("Corpus \"%s\": %u payloads, %u KiB, %u KiB compressed.",
+		a_CorpusName, static_cast<unsigned>(a_Payloads.size()), static_cast<unsigned>(TotalSize / 1024), static_cast<unsigned>(TotalCompressed / 1024)
+	);
+
+	// Alternate the ways, so that both get the same conditions on average:
+	double Times[4] = {0, 0, 0, 0};  // Deflate per-call, deflate pooled, inflate per-call, inflate pooled
+	for (int i = 0; i < m_NumRepetitions; i++)
+	{
+		for (int Way = 0; Way < 4; Way++)
+		{
+			auto Start = std::chrono::steady_clock::now();
+			bool IsPooled = ((Way & 1) != 0);
+			size_t Size = (Way < 2) ? RunDeflate(a_Payloads, IsPooled) : RunInflate(a_Payloads, IsPooled);
+			Times[Way] += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+			if (Size != ((Way < 2) ? TotalCompressed : TotalSize))
+			{
+				LOGWARNING("Way %d produced %u bytes instead of the expected amount.", Way, static_cast<unsigned>(Size));
+			}
+		}
+	}
+
+	double NumPayloads = static_cast<double>(a_Payloads.size()) * m_NumRepetitions;
+	double NumMiB = static_cast<double>(TotalSize) * m_NumRepetitions / (1024 * 1024);
+	const char * Names[4] = {"deflate per-call", "deflate pooled  ", "inflate per-call", "inflate pooled  "};
+	for (int Way = 0; Way < 4; Way++)
+	{
+		LOGINFO("  %s: %.3f sec, %.0f payloads per sec, %.1f MiB/s of uncompressed data",
+			Names[Way], Times[Way], NumPayloads / Times[Way], NumMiB / Times[Way]
+		);
+	}
+	LOGINFO("  Pooled deflate takes %.1f %% and pooled inflate takes %.1f %% of the per-call time.",
+		100 * Times[1] / Times[0], 100 * Times[3] / Times[2]
+	);
+}
+
+
+
+
+
+size_t cCompressionBenchmark::RunDeflate(const cPayloads & a_Payloads, bool a_IsPooled)
+{
+	// The output buffer is reused, so that only the zlib state allocation differs between the ways:
+	size_t TotalSize = 0;
+	AString Buffer;
+	for (cPayloads::const_iterator itr = a_Payloads.begin(), end = a_Payloads.end(); itr != end; ++itr)
+	{
+		int Factor = itr->m_Factor;
+		size_t Size = compressBound(static_cast<uLong>(itr->m_Data.size()));
+		if (Buffer.size() < Size)
+		{
+			Buffer.resize(Size);
+		}
+		if (a_IsPooled)
+		{
+			CompressBuffer(itr->m_Data.data(), itr->m_Data.size(), &Buffer[0], Size, Factor);
+		}
+		else
+		{
+			uLongf PerCallSize = static_cast<uLongf>(Size);
+			compress2(reinterpret_cast<Bytef *>(&Buffer[0]), &PerCallSize, reinterpret_cast<const Bytef *>(itr->m_Data.data()), static_cast<uLong>(itr->m_Data.size()), Factor);
+			Size = PerCallSize;
+		}
+		TotalSize += Size;
+	}
+	return TotalSize;
+}
+
+
+
+
+
+size_t cCompressionBenchmark::RunInflate(const cPayloads & a_Payloads, bool a_IsPooled)
+{
+	size_t TotalSize = 0;
+	AString Buffer;
+	for (cPayloads::const_iterator itr = a_Payloads.begin(), end = a_Payloads.end(); itr != end; ++itr)
+	{
+		size_t Size = itr->m_Data.size();
+		if (Buffer.size() < Size)
+		{
+			Buffer.resize(Size);
+		}
+		if (a_IsPooled)
+		{
+			UncompressBuffer(itr->m_Compressed.data(), itr->m_Compressed.size(), &Buffer[0], Size);
+		}
+		else
+		{
+			uLongf PerCallSize = static_cast<uLongf>(Size);
+			uncompress(reinterpret_cast<Bytef *>(&Buffer[0]), &PerCallSize, reinterpret_cast<const Bytef *>(itr->m_Compressed.data()), static_cast<uLong>(itr->m_Compressed.size()));
+			Size = PerCallSize;
+		}
+		TotalSize += Size;
+	}
+	return TotalSize;
+}
+
+
+
+
@@ -0,0 +1,96 @@
+
+// CompressionBenchmark.h
+
+// Interfaces to the cCompressionBenchmark class encapsulating the entire app
+
+/*
+Measures the speed of the zlib compression and decompression, comparing the two ways available:
+	- "per-call": zlib's compress2() and uncompress(), which allocate and free the zlib state for each call
+	- "pooled": CompressBuffer() and UncompressBuffer(), which reuse the zlib state kept in a pool
+Two corpora are measured, both made from the chunks in the Anvil region files of a world ("<world>/region/r.X.Z.mca"):
+	- "chunk": the uncompressed NBT data of each chunk, as compressed by the storage
+	- "packet": the block, light and biome data of each chunk, laid out as the 1.8 protocol sends it
+	- "small": slices of the "packet" data, the size of the smaller packets that the 1.8 protocol compresses
+The corpora are loaded upfront, so that only the compression and decompression are measured.
+Usage: CompressionBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]
+*/
+
+
+
+
+
+#pragma once
+
+#include "WorldStorage/FastNBT.h"
+#include "StringCompression.h"
+
+
+
+
+
+class cCompressionBenchmark
+{
+public:
+	cCompressionBenchmark(void);
+
+	/** Reads the cmdline params and initializes the app.
+	Returns true if the app should continue, false if not. */
+	bool Init(int argc, char ** argv);
+
+	/** Runs the entire app. */
+	void Run(void);
+
+protected:
+	/** A single payload of a corpus, both uncompressed and compressed, with the compression factor used for it. */
+	struct sPayload
+	{
+		AString m_Data;
+		AString m_Compressed;
+		int m_Factor;
+	} ;
+
+	typedef std::vector<sPayload> cPayloads;
+
+
+	/** The folder of the world whose chunks make the corpora. */
+	AString m_WorldFolder;
+
+	/** Number of times each way processes each whole corpus. */
+	int m_NumRepetitions;
+
+	/** Maximum number of chunks loaded into the corpora. */
+	size_t m_MaxNumChunks;
+
+	/** The uncompressed NBT data of each chunk. */
+	cPayloads m_Chunks;
+
+	/** The protocol chunk data of each chunk. */
+	cPayloads m_Packets;
+
+	/** Slices of the protocol chunk data. */
+	cPayloads m_SmallPackets;
+
+
+	/** Loads all the chunks from the specified Anvil region file into the corpora. */
+	void LoadAnvilFile(const AString & a_FileName);
+
+	/** Adds the protocol chunk data of the specified parsed chunk NBT into m_Packets, and its slices into m_SmallPackets. */
+	void AddPacket(const cParsedNBT & a_NBT);
+
+	/** Compresses all the payloads in the corpus, filling their m_Compressed.
+	Returns false if the two ways produce different data, true if they produce the same. */
+	static bool Prepare(cPayloads & a_Payloads);
+
+	/** Measures the compression and decompression of the corpus and logs the results. */
+	void Measure(const char * a_CorpusName, const cPayloads & a_Payloads);
+
+	/** Compresses all the payloads with compress2() or CompressBuffer(). Returns the total compressed size. */
+	static size_t RunDeflate(const cPayloads & a_Payloads, bool a_IsPooled);
+
+	/** Uncompresses all the payloads with uncompress() or UncompressBuffer(). Returns the total uncompressed size. */
+	static size_t RunInflate(const cPayloads & a_Payloads, bool a_IsPooled);
+} ;
+
+
+
+
@@ -0,0 +1,354 @@
+
+// NBTReaderBenchmark.cpp
+
+// Implements the main app entrypoint and the cNBTReaderBenchmark class representing the entire app
+
+#include "Globals.h"
+#include "NBTReaderBenchmark.h"
+#include "Logger.h"
+#include "LoggerListeners.h"
+#include <chrono>
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	cLogger::cListener * consoleLogListener = MakeConsoleListener();
+	cLogger::GetInstance().AttachListener(consoleLogListener);
+
+	cLogger::InitiateMultithreading();
+
+	cNBTReaderBenchmark Benchmark;
+	if (!Benchmark.Init(argc, argv))
+	{
+		return 1;
+	}
+
+	Benchmark.Run();
+
+	cLogger::GetInstance().DetachListener(consoleLogListener);
+	delete consoleLogListener;
+
+	return 0;
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cNBTReaderBenchmark:
+
+cNBTReaderBenchmark::cNBTReaderBenchmark(void) :
+	m_NumRepetitions(5),
+	m_MaxNumChunks(10000),
+	m_TotalSize(0)
+{
+}
+
+
+
+
+
+bool cNBTReaderBenchmark::Init(int argc, char ** argv)
+{
+	if ((argc < 2) || (argc > 4))
+	{
+		LOGERROR("Usage: NBTReaderBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]");
+		return false;
+	}
+	m_WorldFolder = argv[1];
+	if (argc > 2)
+	{
+		m_NumRepetitions = std::max(atoi(argv[2]), 1);
+	}
+	if (argc > 3)
+	{
+		m_MaxNumChunks = static_cast<size_t>(std::max(atoi(argv[3]), 1));
+	}
+	return true;
+}
+
+
+
+
+
+void cNBTReaderBenchmark::Run(void)
+{
+	// Load the corpus:
+	AString Folder = m_WorldFolder + "/region";
+	AStringVector Files = cFile::GetFolderContents(Folder);
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); (itr != end) && (m_Chunks.size() < m_MaxNumChunks); ++itr)
+	{
+		int RegionX, RegionZ;
+		char Ext[4] = "";
+		if ((sscanf(itr->c_str(), "r.%d.%d.%3s", &RegionX, &RegionZ, Ext) == 3) && (strcmp(Ext, "mca") == 0))
+		{
+			LoadAnvilFile(Folder + "/" + *itr);
+		}
+	}
+	if (m_Chunks.empty())
+	{
+		LOGERROR("No chunks found in \"%s\".", Folder.c_str());
+		return;
+	}
+	LOGINFO("Loaded %u chunks, %u KiB of NBT data.", static_cast<unsigned>(m_Chunks.size()), static_cast<unsigned>(m_TotalSize / 1024));
+
+	if (!Verify())
+	{
+		LOGERROR("The lazy parsing produces a different tag tree than the full parsing.");
+		return;
+	}
+
+	// Alternate the modes, so that both get the same conditions on average:
+	double TimeFull = 0, TimeLazy = 0;
+	size_t ChecksumFull = 0, ChecksumLazy = 0;
+	for (int i = 0; i < m_NumRepetitions; i++)
+	{
+		auto Start = std::chrono::steady_clock::now();
+		ChecksumFull = RunLoad(false);
+		auto Middle = std::chrono::steady_clock::now();
+		ChecksumLazy = RunLoad(true);
+		auto End = std::chrono::steady_clock::now();
+		TimeFull += std::chrono::duration<double>(Middle - Start).count();
+		TimeLazy += std::chrono::duration<double>(End - Middle).count();
+	}
+	if (ChecksumFull != ChecksumLazy)
+	{
+		LOGERROR("The lazy parsing has accessed different data than the full parsing.");
+		return;
+	}
+
+	double NumChunks = static_cast<double>(m_Chunks.size()) * m_NumRepetitions;
+	LOGINFO("Full: %.3f sec, %.0f chunks per sec", TimeFull, NumChunks / TimeFull);
+	LOGINFO("Lazy: %.3f sec, %.0f chunks per sec", TimeLazy, NumChunks / TimeLazy);
+	LOGINFO("Lazy parsing takes %.1f %% of the full parsing time.", 100 * TimeLazy / TimeFull);
+}
+
+
+
+
+
+void cNBTReaderBenchmark::LoadAnvilFile(const AString & a_FileName)
+{
+	cFile f;
+	if (!f.Open(a_FileName, cFile::fmRead))
+	{
+		LOGWARNING("Cannot open file %s for reading, skipping file.", a_FileName.c_str());
+		return;
+	}
+	Byte Locations[4 KiB];
+	if (f.Read(Locations, sizeof(Locations)) != sizeof(Locations))
+	{
+		LOGWARNING("Cannot read Locations in file %s, skipping file.", a_FileName.c_str());
+		return;
+	}
+	for (size_t i = 0; (i < 1024) && (m_Chunks.size() < m_MaxNumChunks); i++)
+	{
+		int SectorNum = (Locations[4 * i] << 16) | (Locations[4 * i + 1] << 8) | Locations[4 * i + 2];
+		if ((SectorNum < 2) || (Locations[4 * i + 3] == 0))
+		{
+			continue;
+		}
+		Byte Buf[5];
+		if ((f.Seek(SectorNum * (4 KiB)) < 0) || (f.Read(Buf, 5) != 5) || (Buf[4] != 2))
+		{
+			continue;
+		}
+		int CompressedSize = ((Buf[0] << 24) | (Buf[1] << 16) | (Buf[2] << 8) | Buf[3]) - 1;
+		if ((CompressedSize <= 0) || (CompressedSize > Locations[4 * i + 3] * (4 KiB)))
+		{
+			continue;
+		}
+		AString Compressed, Uncompressed;
+		Compressed.resize(static_cast<size_t>(CompressedSize));
+		if (
+			(f.Read(&Compressed[0], Compressed.size()) != CompressedSize) ||
+			(InflateString(Compressed.data(), Compressed.size(), Uncompressed) != Z_OK) ||
+			!cParsedNBT(Uncompressed.data(), Uncompressed.size()).IsValid()
+		)
+		{
+			continue;
+		}
+		m_TotalSize += Uncompressed.size();
+		m_Chunks.push_back(Uncompressed);
+	}
+}
+
+
+
+
+
+size_t cNBTReaderBenchmark::RunLoad(bool a_IsLazy)
+{
+	size_t Checksum = 0;
+	for (AStringVector::const_iterator itr = m_Chunks.begin(), end = m_Chunks.end(); itr != end; ++itr)
+	{
+		cParsedNBT NBT(itr->data(), itr->size(), a_IsLazy);
+		if (NBT.IsValid())
+		{
+			Checksum += AccessChunk(NBT);
+		}
+	}
+	return Checksum;
+}
+
+
+
+
+
+bool cNBTReaderBenchmark::Verify(void)
+{
+	for (AStringVector::const_iterator itr = m_Chunks.begin(), end = m_Chunks.end(); itr != end; ++itr)
+	{
+		cParsedNBT Full(itr->data(), itr->size());
+		cParsedNBT Lazy(itr->data(), itr->size(), true);
+		if (!Lazy.IsValid() || !AreTagsEqual(Full, Full.GetRoot(), Lazy, Lazy.GetRoot()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+size_t cNBTReaderBenchmark::AccessChunk(const cParsedNBT & a_NBT)
+{
+	size_t Checksum = 0;
+	int Level = a_NBT.FindChildByName(0, "Level");
+	if (Level < 0)
+	{
+		return 0;
+	}
+
+	// Block data, same as cWSSAnvil::LoadChunkFromNBT():
+	int Sections = a_NBT.FindChildByName(Level, "Sections");
+	if ((Sections >= 0) && (a_NBT.GetType(Sections) == TAG_List))
+	{
+		static const char * ArrayNames[] = { "Blocks", "Add", "Data", "BlockLight", "SkyLight" };
+		for (int Child = a_NBT.GetFirstChild(Sections); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+		{
+			int SectionY = a_NBT.FindChildByName(Child, "Y");
+			if ((SectionY < 0) || (a_NBT.GetType(SectionY) != TAG_Byte))
+			{
+				continue;
+			}
+			Checksum += a_NBT.GetByte(SectionY);
+			for (size_t i = 0; i < ARRAYCOUNT(ArrayNames); i++)
+			{
+				int Array = a_NBT.FindChildByName(Child, ArrayNames[i]);
+				if ((Array >= 0) && (a_NBT.GetType(Array) == TAG_ByteArray) && (a_NBT.GetDataLength(Array) > 0))
+				{
+					Checksum += a_NBT.GetDataLength(Array) + static_cast<Byte>(a_NBT.GetData(Array)[0]);
+				}
+			}
+		}
+	}
+
+	// Biomes:
+	int Biomes = a_NBT.FindChildByName(Level, "MCSBiomes");
+	if (Biomes < 0)
+	{
+		Biomes = a_NBT.FindChildByName(Level, "Biomes");
+	}
+	if ((Biomes >= 0) && (a_NBT.GetType(Biomes) != TAG_List) && (a_NBT.GetType(Biomes) != TAG_Compound))
+	{
+		Checksum += a_NBT.GetDataLength(Biomes);
+	}
+
+	// Entities, the id and the common position of each:
+	int Entities = a_NBT.FindChildByName(Level, "Entities");
+	if ((Entities >= 0) && (a_NBT.GetType(Entities) == TAG_List))
+	{
+		for (int Child = a_NBT.GetFirstChild(Entities); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+		{
+			if (a_NBT.GetType(Child) != TAG_Compound)
+			{
+				continue;
+			}
+			int ID = a_NBT.FindChildByName(Child, "id");
+			if ((ID >= 0) && (a_NBT.GetType(ID) == TAG_String))
+			{
+				Checksum += a_NBT.GetDataLength(ID);
+			}
+			int Pos = a_NBT.FindChildByName(Child, "Pos");
+			if ((Pos >= 0) && (a_NBT.GetType(Pos) == TAG_List) && (a_NBT.GetChildrenType(Pos) == TAG_Double))
+			{
+				for (int Coord = a_NBT.GetFirstChild(Pos); Coord >= 0; Coord = a_NBT.GetNextSibling(Coord))
+				{
+					Checksum += static_cast<size_t>(a_NBT.GetDouble(Coord));
+				}
+			}
+		}
+	}
+
+	// Block entities, the id and the coords of each:
+	int TileEntities = a_NBT.FindChildByName(Level, "TileEntities");
+	if ((TileEntities >= 0) && (a_NBT.GetType(TileEntities) == TAG_List))
+	{
+		static const char * Names[] = { "id", "x", "y", "z" };
+		for (int Child = a_NBT.GetFirstChild(TileEntities); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+		{
+			if (a_NBT.GetType(Child) != TAG_Compound)
+			{
+				continue;
+			}
+			for (size_t i = 0; i < ARRAYCOUNT(Names); i++)
+			{
+				int Tag = a_NBT.FindChildByName(Child, Names[i]);
+				if ((Tag >= 0) && (a_NBT.GetType(Tag) == TAG_Int))
+				{
+					Checksum += static_cast<size_t>(a_NBT.GetInt(Tag));
+				}
+			}
+		}
+	}
+
+	Checksum += (a_NBT.FindChildByName(Level, "MCSIsLightValid") > 0) ? 1 : 0;
+	return Checksum;
+}
+
+
+
+
+
+bool cNBTReaderBenchmark::AreTagsEqual(const cParsedNBT & a_NBT1, int a_Tag1, const cParsedNBT & a_NBT2, int a_Tag2)
+{
+	if ((a_NBT1.GetType(a_Tag1) != a_NBT2.GetType(a_Tag2)) || (a_NBT1.GetName(a_Tag1) != a_NBT2.GetName(a_Tag2)))
+	{
+		return false;
+	}
+	switch (a_NBT1.GetType(a_Tag1))
+	{
+		case TAG_List:
+		case TAG_Compound:
+		{
+			int Child1 = a_NBT1.GetFirstChild(a_Tag1);
+			int Child2 = a_NBT2.GetFirstChild(a_Tag2);
+			for (; (Child1 >= 0) && (Child2 >= 0); Child1 = a_NBT1.GetNextSibling(Child1), Child2 = a_NBT2.GetNextSibling(Child2))
+			{
+				if (!AreTagsEqual(a_NBT1, Child1, a_NBT2, Child2))
+				{
+					return false;
+				}
+			}
+			return (Child1 < 0) && (Child2 < 0);
+		}
+		default:
+		{
+			return (
+				(a_NBT1.GetDataLength(a_Tag1) == a_NBT2.GetDataLength(a_Tag2)) &&
+				(memcmp(a_NBT1.GetData(a_Tag1), a_NBT2.GetData(a_Tag2), a_NBT1.GetDataLength(a_Tag1)) == 0)
+			);
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,77 @@
+
+// NBTReaderBenchmark.h
+
+// Interfaces to the cNBTReaderBenchmark class encapsulating the entire app
+
+/*
+Measures the speed of loading chunk NBT data, comparing the two parsing modes of cParsedNBT:
+	- "full": the entire tag tree is indexed upfront
+	- "lazy": only the top-level tags are indexed upfront, the children of each Compound and List tag on first access
+Each load parses the data and then accesses the tags the same way cWSSAnvil::LoadChunkFromNBT() does.
+The corpus is made of the chunks in the Anvil region files of a world ("<world>/region/r.X.Z.mca").
+The chunks are loaded and decompressed upfront, so that only the parsing and the access are measured.
+Usage: NBTReaderBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]
+*/
+
+
+
+
+
+#pragma once
+
+#include "WorldStorage/FastNBT.h"
+#include "StringCompression.h"
+
+
+
+
+
+class cNBTReaderBenchmark
+{
+public:
+	cNBTReaderBenchmark(void);
+
+	/** Reads the cmdline params and initializes the app.
+	Returns true if the app should continue, false if not. */
+	bool Init(int argc, char ** argv);
+
+	/** Runs the entire app. */
+	void Run(void);
+
+protected:
+	/** The folder of the world whose chunks make the corpus. */
+	AString m_WorldFolder;
+
+	/** Number of times each mode loads the whole corpus. */
+	int m_NumRepetitions;
+
+	/** Maximum number of chunks loaded into the corpus. */
+	size_t m_MaxNumChunks;
+
+	/** The corpus, the uncompressed NBT data of each chunk. */
+	AStringVector m_Chunks;
+
+	/** The total size of the uncompressed NBT data in the corpus. */
+	size_t m_TotalSize;
+
+
+	/** Loads all the chunks from the specified Anvil region file into the corpus. */
+	void LoadAnvilFile(const AString & a_FileName);
+
+	/** Parses and accesses all the chunks in the specified mode.
+	Returns a checksum of the accessed data, so that the work cannot be optimized away. */
+	size_t RunLoad(bool a_IsLazy);
+
+	/** Checks that both modes see the same tag tree for all the chunks. Returns true if they do. */
+	bool Verify(void);
+
+	/** Accesses the tags of a parsed chunk the same way the Anvil loader does. Returns a checksum of the accessed data. */
+	static size_t AccessChunk(const cParsedNBT & a_NBT);
+
+	/** Returns true if the specified tags, including all their children, are the same in both trees. */
+	static bool AreTagsEqual(const cParsedNBT & a_NBT1, int a_Tag1, const cParsedNBT & a_NBT2, int a_Tag2);
+} ;
+
+
+
+
@@ -0,0 +1,366 @@
+
+// NBTWriterBenchmark.cpp
+
+// Implements the main app entrypoint and the cNBTWriterBenchmark class representing the entire app
+
+#include "Globals.h"
+#include "NBTWriterBenchmark.h"
+#include "Logger.h"
+#include "LoggerListeners.h"
+#include <chrono>
+
+
+
+
+
+/** The compression factor used by both paths, the same as the server's default. */
+static const int COMPRESSION_FACTOR = 6;
+
+
+
+
+
+/** Passes the data from a streaming cFastNBTWriter into a cZlibDeflater. */
+class cDeflaterOutput :
+	public cFastNBTWriter::cOutput
+{
+public:
+	cDeflaterOutput(cZlibDeflater & a_Deflater) :
+		m_Deflater(a_Deflater)
+	{
+	}
+
+protected:
+	cZlibDeflater & m_Deflater;
+
+	virtual void Write(const char * a_Data, size_t a_Size) override
+	{
+		m_Deflater.Write(a_Data, a_Size);
+	}
+} ;
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	cLogger::cListener * consoleLogListener = MakeConsoleListener();
+	cLogger::GetInstance().AttachListener(consoleLogListener);
+
+	cLogger::InitiateMultithreading();
+
+	cNBTWriterBenchmark Benchmark;
+	if (!Benchmark.Init(argc, argv))
+	{
+		return 1;
+	}
+
+	Benchmark.Run();
+
+	cLogger::GetInstance().DetachListener(consoleLogListener);
+	delete consoleLogListener;
+
+	return 0;
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cNBTWriterBenchmark:
+
+cNBTWriterBenchmark::cNBTWriterBenchmark(void) :
+	m_NumRepetitions(5),
+	m_MaxNumChunks(10000),
+	m_TotalSize(0)
+{
+}
+
+
+
+
+
+bool cNBTWriterBenchmark::Init(int argc, char ** argv)
+{
+	if ((argc < 2) || (argc > 4))
+	{
+		LOGERROR("Usage: NBTWriterBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]");
+		return false;
+	}
+	m_WorldFolder = argv[1];
+	if (argc > 2)
+	{
+		m_NumRepetitions = std::max(atoi(argv[2]), 1);
+	}
+	if (argc > 3)
+	{
+		m_MaxNumChunks = static_cast<size_t>(std::max(atoi(argv[3]), 1));
+	}
+	return true;
+}
+
+
+
+
+
+void cNBTWriterBenchmark::Run(void)
+{
+	// Load the corpus:
+	AString Folder = m_WorldFolder + "/region";
+	AStringVector Files = cFile::GetFolderContents(Folder);
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); (itr != end) && (m_Chunks.size() < m_MaxNumChunks); ++itr)
+	{
+		int RegionX, RegionZ;
+		char Ext[4] = "";
+		if ((sscanf(itr->c_str(), "r.%d.%d.%3s", &RegionX, &RegionZ, Ext) == 3) && (strcmp(Ext, "mca") == 0))
+		{
+			LoadAnvilFile(Folder + "/" + *itr);
+		}
+	}
+	if (m_Chunks.empty())
+	{
+		LOGERROR("No chunks found in \"%s\".", Folder.c_str());
+		return;
+	}
+	LOGINFO("Loaded %u chunks, %u KiB of NBT data.", static_cast<unsigned>(m_Chunks.size()), static_cast<unsigned>(m_TotalSize / 1024));
+
+	if (!Verify())
+	{
+		LOGERROR("The streaming path produces different NBT data than the buffered path.");
+		return;
+	}
+
+	// Alternate the paths, so that both get the same conditions on average:
+	double TimeBuffered = 0, TimeStreaming = 0;
+	size_t SizeBuffered = 0, SizeStreaming = 0;
+	for (int i = 0; i < m_NumRepetitions; i++)
+	{
+		auto Start = std::chrono::steady_clock::now();
+		SizeBuffered = RunBuffered();
+		auto Middle = std::chrono::steady_clock::now();
+		SizeStreaming = RunStreaming();
+		auto End = std::chrono::steady_clock::now();
+		TimeBuffered  += std::chrono::duration<double>(Middle - Start).count();
+		TimeStreaming += std::chrono::duration<double>(End - Middle).count();
+	}
+
+	double NumChunks = static_cast<double>(m_Chunks.size()) * m_NumRepetitions;
+	LOGINFO("Buffered:  %.3f sec, %.0f chunks per sec, %u KiB compressed",
+		TimeBuffered, NumChunks / TimeBuffered, static_cast<unsigned>(SizeBuffered / 1024)
+	);
+	LOGINFO("Streaming: %.3f sec, %.0f chunks per sec, %u KiB compressed",
+		TimeStreaming, NumChunks / TimeStreaming, static_cast<unsigned>(SizeStreaming / 1024)
+	);
+	LOGINFO("Streaming takes %.1f %% of the buffered time.", 100 * TimeStreaming / TimeBuffered);
+}
+
+
+
+
+
+void cNBTWriterBenchmark::LoadAnvilFile(const AString & a_FileName)
+{
+	cFile f;
+	if (!f.Open(a_FileName, cFile::fmRead))
+	{
+		LOGWARNING("Cannot open file %s for reading, skipping file.", a_FileName.c_str());
+		return;
+	}
+	Byte Locations[4 KiB];
+	if (f.Read(Locations, sizeof(Locations)) != sizeof(Locations))
+	{
+		LOGWARNING("Cannot read Locations in file %s, skipping file.", a_FileName.c_str());
+		return;
+	}
+	for (size_t i = 0; (i < 1024) && (m_Chunks.size() < m_MaxNumChunks); i++)
+	{
+		int SectorNum = (Locations[4 * i] << 16) | (Locations[4 * i + 1] << 8) | Locations[4 * i + 2];
+		if ((SectorNum < 2) || (Locations[4 * i + 3] == 0))
+		{
+			continue;
+		}
+		Byte Buf[5];
+		if ((f.Seek(SectorNum * (4 KiB)) < 0) || (f.Read(Buf, 5) != 5) || (Buf[4] != 2))
+		{
+			continue;
+		}
+		int CompressedSize = ((Buf[0] << 24) | (Buf[1] << 16) | (Buf[2] << 8) | Buf[3]) - 1;
+		if ((CompressedSize <= 0) || (CompressedSize > Locations[4 * i + 3] * (4 KiB)))
+		{
+			continue;
+		}
+		AString Compressed;
+		Compressed.resize(static_cast<size_t>(CompressedSize));
+		std::unique_ptr<sChunk> Chunk(new sChunk);
+		if (
+			(f.Read(&Compressed[0], Compressed.size()) != CompressedSize) ||
+			(InflateString(Compressed.data(), Compressed.size(), Chunk->m_Data) != Z_OK)
+		)
+		{
+			continue;
+		}
+		Chunk->m_NBT.reset(new cParsedNBT(Chunk->m_Data.data(), Chunk->m_Data.size()));
+		if (!Chunk->m_NBT->IsValid())
+		{
+			continue;
+		}
+		m_TotalSize += Chunk->m_Data.size();
+		m_Chunks.push_back(std::move(Chunk));
+	}
+}
+
+
+
+
+
+size_t cNBTWriterBenchmark::RunBuffered(void)
+{
+	size_t TotalSize = 0;
+	for (cChunks::const_iterator itr = m_Chunks.begin(), end = m_Chunks.end(); itr != end; ++itr)
+	{
+		const cParsedNBT & NBT = *(*itr)->m_NBT;
+		cFastNBTWriter Writer(NBT.GetName(NBT.GetRoot()));
+		CopyChildren(NBT, NBT.GetRoot(), Writer, false);
+		Writer.Finish();
+		AString Compressed;
+		CompressString(Writer.GetResult().data(), Writer.GetResult().size(), Compressed, COMPRESSION_FACTOR);
+		TotalSize += Compressed.size();
+	}
+	return TotalSize;
+}
+
+
+
+
+
+size_t cNBTWriterBenchmark::RunStreaming(void)
+{
+	size_t TotalSize = 0;
+	cZlibDeflater Deflater;
+	cDeflaterOutput Output(Deflater);
+	cFastNBTWriter Writer(Output);
+	AString Compressed;
+	for (cChunks::const_iterator itr = m_Chunks.begin(), end = m_Chunks.end(); itr != end; ++itr)
+	{
+		const cParsedNBT & NBT = *(*itr)->m_NBT;
+		Compressed.clear();
+		Deflater.Begin(COMPRESSION_FACTOR, Compressed);
+		Writer.Reset(NBT.GetName(NBT.GetRoot()));
+		CopyChildren(NBT, NBT.GetRoot(), Writer, true);
+		Writer.Finish();
+		Deflater.End();
+		TotalSize += Compressed.size();
+	}
+	return TotalSize;
+}
+
+
+
+
+
+bool cNBTWriterBenchmark::Verify(void)
+{
+	cZlibDeflater Deflater;
+	cDeflaterOutput Output(Deflater);
+	cFastNBTWriter StreamingWriter(Output);
+	for (cChunks::const_iterator itr = m_Chunks.begin(), end = m_Chunks.end(); itr != end; ++itr)
+	{
+		const cParsedNBT & NBT = *(*itr)->m_NBT;
+		cFastNBTWriter Writer(NBT.GetName(NBT.GetRoot()));
+		CopyChildren(NBT, NBT.GetRoot(), Writer, false);
+		Writer.Finish();
+
+		AString Compressed, Uncompressed;
+		Deflater.Begin(COMPRESSION_FACTOR, Compressed);
+		StreamingWriter.Reset(NBT.GetName(NBT.GetRoot()));
+		CopyChildren(NBT, NBT.GetRoot(), StreamingWriter, true);
+		StreamingWriter.Finish();
+		if (
+			(Deflater.End() != Z_OK) ||
+			(InflateString(Compressed.data(), Compressed.size(), Uncompressed) != Z_OK) ||
+			(Uncompressed != Writer.GetResult())
+		)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+void cNBTWriterBenchmark::CopyChildren(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer, bool a_UseListCount)
+{
+	for (int Child = a_NBT.GetFirstChild(a_Tag); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+	{
+		CopyTag(a_NBT, Child, a_Writer, a_UseListCount);
+	}
+}
+
+
+
+
+
+void cNBTWriterBenchmark::CopyTag(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer, bool a_UseListCount)
+{
+	AString Name = a_NBT.GetName(a_Tag);
+	switch (a_NBT.GetType(a_Tag))
+	{
+		case TAG_Byte:      a_Writer.AddByte     (Name, a_NBT.GetByte(a_Tag));   break;
+		case TAG_Short:     a_Writer.AddShort    (Name, a_NBT.GetShort(a_Tag));  break;
+		case TAG_Int:       a_Writer.AddInt      (Name, a_NBT.GetInt(a_Tag));    break;
+		case TAG_Long:      a_Writer.AddLong     (Name, a_NBT.GetLong(a_Tag));   break;
+		case TAG_Float:     a_Writer.AddFloat    (Name, a_NBT.GetFloat(a_Tag));  break;
+		case TAG_Double:    a_Writer.AddDouble   (Name, a_NBT.GetDouble(a_Tag)); break;
+		case TAG_String:    a_Writer.AddString   (Name, a_NBT.GetString(a_Tag)); break;
+		case TAG_ByteArray: a_Writer.AddByteArray(Name, a_NBT.GetData(a_Tag), a_NBT.GetDataLength(a_Tag)); break;
+		case TAG_IntArray:
+		{
+			std::vector<int> Values(a_NBT.GetDataLength(a_Tag) / 4);
+			for (size_t i = 0; i < Values.size(); i++)
+			{
+				Values[i] = GetBEInt(a_NBT.GetData(a_Tag) + 4 * i);
+			}
+			a_Writer.AddIntArray(Name, Values.empty() ? nullptr : &Values[0], Values.size());
+			break;
+		}
+		case TAG_List:
+		{
+			if (a_UseListCount)
+			{
+				int Count = 0;
+				for (int Child = a_NBT.GetFirstChild(a_Tag); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+				{
+					Count++;
+				}
+				a_Writer.BeginList(Name, a_NBT.GetChildrenType(a_Tag), Count);
+			}
+			else
+			{
+				a_Writer.BeginList(Name, a_NBT.GetChildrenType(a_Tag));
+			}
+			CopyChildren(a_NBT, a_Tag, a_Writer, a_UseListCount);
+			a_Writer.EndList();
+			break;
+		}
+		case TAG_Compound:
+		{
+			a_Writer.BeginCompound(Name);
+			CopyChildren(a_NBT, a_Tag, a_Writer, a_UseListCount);
+			a_Writer.EndCompound();
+			break;
+		}
+		case TAG_End:
+		{
+			break;
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,91 @@
+
+// NBTWriterBenchmark.h
+
+// Interfaces to the cNBTWriterBenchmark class encapsulating the entire app
+
+/*
+Measures the speed of serializing and compressing chunk NBT data, comparing the two paths available:
+	- "buffered": a new cFastNBTWriter builds the entire NBT in a string, which is then compressed by CompressString()
+	- "streaming": a reused cFastNBTWriter streams the NBT into a reused cZlibDeflater, appending to a reused string
+The corpus is made of the chunks in the Anvil region files of a world ("<world>/region/r.X.Z.mca").
+The chunks are loaded and parsed upfront; each path then re-serializes the parsed NBT of all the chunks.
+Usage: NBTWriterBenchmark <WorldFolder> [NumRepetitions] [MaxNumChunks]
+*/
+
+
+
+
+
+#pragma once
+
+#include "WorldStorage/FastNBT.h"
+#include "StringCompression.h"
+
+
+
+
+
+class cNBTWriterBenchmark
+{
+public:
+	cNBTWriterBenchmark(void);
+
+	/** Reads the cmdline params and initializes the app.
+	Returns true if the app should continue, false if not. */
+	bool Init(int argc, char ** argv);
+
+	/** Runs the entire app. */
+	void Run(void);
+
+protected:
+	/** A single chunk of the corpus, with its NBT data and the parsed tree pointing into it. */
+	struct sChunk
+	{
+		AString m_Data;
+		std::unique_ptr<cParsedNBT> m_NBT;
+	} ;
+
+	typedef std::vector<std::unique_ptr<sChunk>> cChunks;
+
+
+	/** The folder of the world whose chunks make the corpus. */
+	AString m_WorldFolder;
+
+	/** Number of times each path serializes the whole corpus. */
+	int m_NumRepetitions;
+
+	/** Maximum number of chunks loaded into the corpus. */
+	size_t m_MaxNumChunks;
+
+	/** The corpus. */
+	cChunks m_Chunks;
+
+	/** The total size of the uncompressed NBT data in the corpus. */
+	size_t m_TotalSize;
+
+
+	/** Loads all the chunks from the specified Anvil region file into the corpus. */
+	void LoadAnvilFile(const AString & a_FileName);
+
+	/** Serializes and compresses all the chunks the way the storage did before streaming was available.
+	Returns the total compressed size. */
+	size_t RunBuffered(void);
+
+	/** Serializes and compresses all the chunks by streaming into a reused compressor.
+	Returns the total compressed size. */
+	size_t RunStreaming(void);
+
+	/** Checks that both paths produce the same NBT data for all the chunks. Returns true if they do. */
+	bool Verify(void);
+
+	/** Writes a copy of all the children of the specified compound tag into a_Writer.
+	If a_UseListCount is true, the lists are written with their count known upfront, so that they can be streamed. */
+	static void CopyChildren(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer, bool a_UseListCount);
+
+	/** Writes a copy of the specified tag, with all its children, into a_Writer. */
+	static void CopyTag(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer, bool a_UseListCount);
+} ;
+
+
+
+
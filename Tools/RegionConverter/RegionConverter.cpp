@@ -0,0 +1,542 @@
+
+// RegionConverter.cpp
+
+// Implements the main app entrypoint and the cRegionConverter class representing the entire app
+
+#include "Globals.h"
+#include "RegionConverter.h"
+#include "Logger.h"
+#include "LoggerListeners.h"
+#include "StringCompression.h"
+#include "zlib/zlib.h"
+
+
+
+
+
+// An array of 4096 zero bytes, used for writing the padding
+static const Byte g_Zeroes[4096] = {0};
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	cLogger::cListener * consoleLogListener = MakeConsoleListener();
+	cLogger::cListener * fileLogListener = new cFileListener();
+	cLogger::GetInstance().AttachListener(consoleLogListener);
+	cLogger::GetInstance().AttachListener(fileLogListener);
+
+	cLogger::InitiateMultithreading();
+
+	cRegionConverter Converter;
+	if (!Converter.Init(argc, argv))
+	{
+		return 1;
+	}
+
+	Converter.Run();
+
+	cLogger::GetInstance().DetachListener(consoleLogListener);
+	delete consoleLogListener;
+	cLogger::GetInstance().DetachListener(fileLogListener);
+	delete fileLogListener;
+
+	return 0;
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cRegionConverter:
+
+cRegionConverter::cRegionConverter(void) :
+	m_IsToBinary(true),
+	m_NumChunks(0),
+	m_NumFailed(0)
+{
+}
+
+
+
+
+
+bool cRegionConverter::Init(int argc, char ** argv)
+{
+	if (argc != 3)
+	{
+		LOGERROR("Usage: RegionConverter toBinary|toAnvil <WorldFolder>");
+		return false;
+	}
+	if (NoCaseCompare(argv[1], "toBinary") == 0)
+	{
+		m_IsToBinary = true;
+	}
+	else if (NoCaseCompare(argv[1], "toAnvil") == 0)
+	{
+		m_IsToBinary = false;
+	}
+	else
+	{
+		LOGERROR("Unknown conversion \"%s\", use either \"toBinary\" or \"toAnvil\".", argv[1]);
+		return false;
+	}
+	m_WorldFolder = argv[2];
+	return true;
+}
+
+
+
+
+
+void cRegionConverter::Run(void)
+{
+	AString SrcFolder = m_WorldFolder + (m_IsToBinary ? "/region" : "/binregion");
+	cFile::CreateFolder(m_WorldFolder + (m_IsToBinary ? "/binregion" : "/region"));
+	AStringVector Files = cFile::GetFolderContents(SrcFolder);
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); itr != end; ++itr)
+	{
+		int RegionX, RegionZ;
+		char Ext[4] = "";
+		if (sscanf(itr->c_str(), "r.%d.%d.%3s", &RegionX, &RegionZ, Ext) != 3)
+		{
+			continue;
+		}
+		if (m_IsToBinary && (strcmp(Ext, "mca") == 0))
+		{
+			ConvertAnvilFile(SrcFolder + "/" + *itr, RegionX, RegionZ);
+		}
+		else if (!m_IsToBinary && (strcmp(Ext, "mcb") == 0))
+		{
+			ConvertBinaryFile(SrcFolder + "/" + *itr, RegionX, RegionZ);
+		}
+	}  // for itr - Files[]
+	LOGINFO("Converted %d chunks, %d chunks failed.", m_NumChunks, m_NumFailed);
+}
+
+
+
+
+
+void cRegionConverter::ConvertAnvilFile(const AString & a_FileName, int a_RegionX, int a_RegionZ)
+{
+	LOGINFO("%s", a_FileName.c_str());
+	cFile In;
+	if (!In.Open(a_FileName, cFile::fmRead))
+	{
+		LOGWARNING("Cannot open file %s for reading, skipping file.", a_FileName.c_str());
+		return;
+	}
+	Byte Locations[4 KiB];
+	if (In.Read(Locations, sizeof(Locations)) != sizeof(Locations))
+	{
+		LOGWARNING("Cannot read Locations in file %s, skipping file.", a_FileName.c_str());
+		return;
+	}
+
+	// Read and convert all the chunks:
+	std::vector<int> Indices;
+	AStringVector Data;
+	std::unique_ptr<cBinaryChunk> Chunk(new cBinaryChunk);
+	for (int i = 0; i < cBinaryRegionFile::NUM_CHUNKS; i++)
+	{
+		int SectorNum = (Locations[4 * i] << 16) | (Locations[4 * i + 1] << 8) | Locations[4 * i + 2];
+		if ((SectorNum < 2) || (Locations[4 * i + 3] == 0))
+		{
+			continue;
+		}
+		Byte Buf[5];
+		if ((In.Seek(SectorNum * (4 KiB)) < 0) || (In.Read(Buf, 5) != 5))
+		{
+			LOGWARNING("Cannot read chunk #%d header from file %s, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		int CompressedSize = ((Buf[0] << 24) | (Buf[1] << 16) | (Buf[2] << 8) | Buf[3]) - 1;  // Without the compression method byte
+		if ((CompressedSize <= 0) || (CompressedSize > Locations[4 * i + 3] * (4 KiB)) || (Buf[4] != 2))
+		{
+			LOGWARNING("Chunk #%d in file %s has invalid size or unsupported compression, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		AString Compressed, Uncompressed;
+		Compressed.resize(static_cast<size_t>(CompressedSize));
+		if (
+			(In.Read(&Compressed[0], Compressed.size()) != CompressedSize) ||
+			(InflateString(Compressed.data(), Compressed.size(), Uncompressed) != Z_OK)
+		)
+		{
+			LOGWARNING("Cannot read chunk #%d from file %s, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		cParsedNBT NBT(Uncompressed.data(), Uncompressed.size());
+		if (!NBT.IsValid() || !AnvilToBinary(NBT, *Chunk))
+		{
+			LOGWARNING("Chunk #%d in file %s is not a valid Anvil chunk, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		AString Serialized;
+		Chunk->Serialize(Serialized);
+		Data.push_back(AString());
+		if (!cBinaryChunk::Compress(Serialized, Data.back()))
+		{
+			LOGWARNING("Cannot compress chunk #%d from file %s, skipping chunk.", i, a_FileName.c_str());
+			Data.pop_back();
+			m_NumFailed += 1;
+			continue;
+		}
+		Indices.push_back(i);
+	}  // for i - chunks
+
+	// Write all the chunks at once:
+	AString OutFileName;
+	Printf(OutFileName, "%s/binregion/r.%d.%d.mcb", m_WorldFolder.c_str(), a_RegionX, a_RegionZ);
+	cFile::Delete(OutFileName);
+	cBinaryRegionFile Out(OutFileName, a_RegionX, a_RegionZ);
+	std::vector<bool> IsSaved;
+	Out.SetChunksData(Indices, Data, IsSaved);
+	for (std::vector<bool>::const_iterator itr = IsSaved.begin(), end = IsSaved.end(); itr != end; ++itr)
+	{
+		if (*itr)
+		{
+			m_NumChunks += 1;
+		}
+		else
+		{
+			m_NumFailed += 1;
+		}
+	}
+}
+
+
+
+
+
+void cRegionConverter::ConvertBinaryFile(const AString & a_FileName, int a_RegionX, int a_RegionZ)
+{
+	LOGINFO("%s", a_FileName.c_str());
+	cBinaryRegionFile In(a_FileName, a_RegionX, a_RegionZ);
+	AString OutFileName;
+	Printf(OutFileName, "%s/region/r.%d.%d.mca", m_WorldFolder.c_str(), a_RegionX, a_RegionZ);
+	cFile Out;
+	if (!Out.Open(OutFileName, cFile::fmWrite))
+	{
+		LOGWARNING("Cannot open file %s for writing, skipping file.", OutFileName.c_str());
+		return;
+	}
+
+	// Write the chunks one after another, after the space for the Locations and Timestamps:
+	Byte Header[8 KiB];
+	memset(Header, 0, sizeof(Header));
+	if (Out.Write(Header, sizeof(Header)) != sizeof(Header))
+	{
+		LOGWARNING("Cannot write the header to file %s, skipping file.", OutFileName.c_str());
+		return;
+	}
+	int CurrentSector = 2;
+	std::unique_ptr<cBinaryChunk> Chunk(new cBinaryChunk);
+	for (int i = 0; i < cBinaryRegionFile::NUM_CHUNKS; i++)
+	{
+		AString Compressed, Serialized;
+		if (!In.GetChunkData(i % 32, i / 32, Compressed))
+		{
+			// Not present
+			continue;
+		}
+		if (
+			!cBinaryChunk::Uncompress(Compressed.data(), Compressed.size(), Serialized) ||
+			!Chunk->Parse(Serialized.data(), Serialized.size())
+		)
+		{
+			LOGWARNING("Cannot read chunk #%d from file %s, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		cFastNBTWriter Writer;
+		BinaryToAnvil(*Chunk, a_RegionX * 32 + i % 32, a_RegionZ * 32 + i / 32, Writer);
+		Writer.Finish();
+		AString AnvilData;
+		CompressString(Writer.GetResult().data(), Writer.GetResult().size(), AnvilData, Z_DEFAULT_COMPRESSION);
+
+		// Write the chunk, padded to whole sectors:
+		int Size = static_cast<int>(AnvilData.size()) + 1;  // Including the compression method byte
+		int NumSectors = (Size + 4 + (4 KiB) - 1) / (4 KiB);
+		if (NumSectors > 255)
+		{
+			LOGWARNING("Chunk #%d from file %s is too large for Anvil, skipping chunk.", i, a_FileName.c_str());
+			m_NumFailed += 1;
+			continue;
+		}
+		Byte Buf[5] = { static_cast<Byte>(Size >> 24), static_cast<Byte>((Size >> 16) & 0xff), static_cast<Byte>((Size >> 8) & 0xff), static_cast<Byte>(Size & 0xff), 2 };
+		int NumPadding = NumSectors * (4 KiB) - (Size + 4);
+		if (
+			(Out.Write(Buf, 5) != 5) ||
+			(Out.Write(AnvilData.data(), AnvilData.size()) != static_cast<int>(AnvilData.size())) ||
+			((NumPadding > 0) && (Out.Write(g_Zeroes, static_cast<size_t>(NumPadding)) != NumPadding))
+		)
+		{
+			LOGWARNING("Cannot write chunk #%d to file %s, skipping file.", i, OutFileName.c_str());
+			return;
+		}
+		Header[4 * i]     = static_cast<Byte>(CurrentSector >> 16);
+		Header[4 * i + 1] = static_cast<Byte>((CurrentSector >> 8) & 0xff);
+		Header[4 * i + 2] = static_cast<Byte>(CurrentSector & 0xff);
+		Header[4 * i + 3] = static_cast<Byte>(NumSectors);
+		CurrentSector += NumSectors;
+		m_NumChunks += 1;
+	}  // for i - chunks
+
+	if ((Out.Seek(0) < 0) || (Out.Write(Header, sizeof(Header)) != sizeof(Header)))
+	{
+		LOGWARNING("Cannot write the header to file %s.", OutFileName.c_str());
+	}
+}
+
+
+
+
+
+bool cRegionConverter::AnvilToBinary(const cParsedNBT & a_NBT, cBinaryChunk & a_Chunk)
+{
+	a_Chunk.Clear();
+	int Level = a_NBT.FindChildByName(a_NBT.GetRoot(), "Level");
+	if (Level < 0)
+	{
+		return false;
+	}
+	int Sections = a_NBT.FindChildByName(Level, "Sections");
+	if ((Sections < 0) || (a_NBT.GetType(Sections) != TAG_List))
+	{
+		return false;
+	}
+
+	// The blocks, the same way cWSSAnvil loads them:
+	for (int Child = a_NBT.GetFirstChild(Sections); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+	{
+		int SectionY = a_NBT.FindChildByName(Child, "Y");
+		if ((SectionY < 0) || (a_NBT.GetType(SectionY) != TAG_Byte) || (a_NBT.GetByte(SectionY) > 15))
+		{
+			continue;
+		}
+		size_t y = a_NBT.GetByte(SectionY);
+		struct
+		{
+			const char * m_Name;
+			Byte * m_Dest;
+			size_t m_Size;
+		} Arrays[] =
+		{
+			{"Blocks",     a_Chunk.m_BlockTypes + y * cBinaryChunk::SECTION_NUM_BLOCKS,     cBinaryChunk::SECTION_NUM_BLOCKS},
+			{"Data",       a_Chunk.m_BlockMetas + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2},
+			{"BlockLight", a_Chunk.m_BlockLight + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2},
+			{"SkyLight",   a_Chunk.m_SkyLight   + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2},
+		};
+		for (size_t i = 0; i < ARRAYCOUNT(Arrays); i++)
+		{
+			int Tag = a_NBT.FindChildByName(Child, Arrays[i].m_Name);
+			if ((Tag >= 0) && (a_NBT.GetType(Tag) == TAG_ByteArray) && (a_NBT.GetDataLength(Tag) == Arrays[i].m_Size))
+			{
+				memcpy(Arrays[i].m_Dest, a_NBT.GetData(Tag), Arrays[i].m_Size);
+			}
+		}
+	}  // for Child - Sections[]
+	a_Chunk.m_IsLightValid = (a_NBT.FindChildByName(Level, "MCSIsLightValid") > 0);
+
+	// The biomes, MCS-style if available, Vanilla-style otherwise:
+	int Biomes = a_NBT.FindChildByName(Level, "MCSBiomes");
+	if ((Biomes >= 0) && (a_NBT.GetType(Biomes) == TAG_IntArray) && (a_NBT.GetDataLength(Biomes) == 4 * cBinaryChunk::NUM_COLUMNS))
+	{
+		a_Chunk.m_AreBiomesValid = true;
+		for (size_t i = 0; i < cBinaryChunk::NUM_COLUMNS; i++)
+		{
+			int Biome = GetBEInt(a_NBT.GetData(Biomes) + 4 * i);
+			if ((Biome < 0) || (Biome > 255))
+			{
+				a_Chunk.m_AreBiomesValid = false;
+				break;
+			}
+			a_Chunk.m_Biomes[i] = static_cast<Byte>(Biome);
+		}
+	}
+	else
+	{
+		Biomes = a_NBT.FindChildByName(Level, "Biomes");
+		if ((Biomes >= 0) && (a_NBT.GetType(Biomes) == TAG_ByteArray) && (a_NBT.GetDataLength(Biomes) == cBinaryChunk::NUM_COLUMNS))
+		{
+			memcpy(a_Chunk.m_Biomes, a_NBT.GetData(Biomes), cBinaryChunk::NUM_COLUMNS);
+			a_Chunk.m_AreBiomesValid = (memchr(a_Chunk.m_Biomes, 0xff, cBinaryChunk::NUM_COLUMNS) == nullptr);  // 0xff means unassigned
+		}
+	}
+
+	// The entities and block entities, as NBT:
+	cFastNBTWriter Writer;
+	int Entities = a_NBT.FindChildByName(Level, "Entities");
+	if ((Entities >= 0) && (a_NBT.GetType(Entities) == TAG_List))
+	{
+		CopyNBTTag(a_NBT, Entities, Writer);
+	}
+	int TileEntities = a_NBT.FindChildByName(Level, "TileEntities");
+	if ((TileEntities >= 0) && (a_NBT.GetType(TileEntities) == TAG_List))
+	{
+		CopyNBTTag(a_NBT, TileEntities, Writer);
+	}
+	Writer.Finish();
+	a_Chunk.m_EntitiesNBT = Writer.GetResult();
+	return true;
+}
+
+
+
+
+
+void cRegionConverter::BinaryToAnvil(const cBinaryChunk & a_Chunk, int a_ChunkX, int a_ChunkZ, cFastNBTWriter & a_Writer)
+{
+	a_Writer.BeginCompound("Level");
+	a_Writer.AddInt("xPos", a_ChunkX);
+	a_Writer.AddInt("zPos", a_ChunkZ);
+
+	// The entities and block entities, copied from the stored NBT; both lists are required by MCEdit:
+	bool HasEntities = false, HasTileEntities = false;
+	if (!a_Chunk.m_EntitiesNBT.empty())
+	{
+		cParsedNBT NBT(a_Chunk.m_EntitiesNBT.data(), a_Chunk.m_EntitiesNBT.size());
+		if (NBT.IsValid())
+		{
+			for (int Child = NBT.GetFirstChild(NBT.GetRoot()); Child >= 0; Child = NBT.GetNextSibling(Child))
+			{
+				CopyNBTTag(NBT, Child, a_Writer);
+				HasEntities     = HasEntities     || (NBT.GetName(Child) == "Entities");
+				HasTileEntities = HasTileEntities || (NBT.GetName(Child) == "TileEntities");
+			}
+		}
+	}
+	if (!HasEntities)
+	{
+		a_Writer.BeginList("Entities", TAG_Compound);
+		a_Writer.EndList();
+	}
+	if (!HasTileEntities)
+	{
+		a_Writer.BeginList("TileEntities", TAG_Compound);
+		a_Writer.EndList();
+	}
+
+	// The biomes, both MCS (IntArray) and MC-vanilla (ByteArray):
+	if (a_Chunk.m_AreBiomesValid)
+	{
+		int Biomes[cBinaryChunk::NUM_COLUMNS];
+		for (size_t i = 0; i < ARRAYCOUNT(Biomes); i++)
+		{
+			Biomes[i] = a_Chunk.m_Biomes[i];
+		}
+		a_Writer.AddByteArray("Biomes",    reinterpret_cast<const char *>(a_Chunk.m_Biomes), ARRAYCOUNT(a_Chunk.m_Biomes));
+		a_Writer.AddIntArray ("MCSBiomes", Biomes, ARRAYCOUNT(Biomes));
+	}
+
+	// The heightmap (required by Vanilla), the highest non-air block in each column:
+	int HeightMap[cBinaryChunk::NUM_COLUMNS];
+	for (size_t i = 0; i < ARRAYCOUNT(HeightMap); i++)
+	{
+		int y = cBinaryChunk::NUM_BLOCKS / cBinaryChunk::NUM_COLUMNS - 1;
+		while ((y > 0) && (a_Chunk.m_BlockTypes[i + static_cast<size_t>(y) * cBinaryChunk::NUM_COLUMNS] == 0))
+		{
+			y--;
+		}
+		HeightMap[i] = y;
+	}
+	a_Writer.AddIntArray("HeightMap", HeightMap, ARRAYCOUNT(HeightMap));
+
+	// The blocks; Anvil stores the light even if it's not valid, as all zeroes:
+	static const Byte NoLight[cBinaryChunk::SECTION_NUM_BLOCKS / 2] = {0};
+	a_Writer.BeginList("Sections", TAG_Compound);
+	for (size_t y = 0; y < cBinaryChunk::NUM_SECTIONS; y++)
+	{
+		a_Writer.BeginCompound("");
+		a_Writer.AddByteArray("Blocks",     reinterpret_cast<const char *>(a_Chunk.m_BlockTypes) + y * cBinaryChunk::SECTION_NUM_BLOCKS,     cBinaryChunk::SECTION_NUM_BLOCKS);
+		a_Writer.AddByteArray("Data",       reinterpret_cast<const char *>(a_Chunk.m_BlockMetas) + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2);
+		if (a_Chunk.m_IsLightValid)
+		{
+			a_Writer.AddByteArray("SkyLight",   reinterpret_cast<const char *>(a_Chunk.m_SkyLight)   + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2);
+			a_Writer.AddByteArray("BlockLight", reinterpret_cast<const char *>(a_Chunk.m_BlockLight) + y * cBinaryChunk::SECTION_NUM_BLOCKS / 2, cBinaryChunk::SECTION_NUM_BLOCKS / 2);
+		}
+		else
+		{
+			a_Writer.AddByteArray("SkyLight",   reinterpret_cast<const char *>(NoLight), sizeof(NoLight));
+			a_Writer.AddByteArray("BlockLight", reinterpret_cast<const char *>(NoLight), sizeof(NoLight));
+		}
+		a_Writer.AddByte("Y", static_cast<unsigned char>(y));
+		a_Writer.EndCompound();
+	}
+	a_Writer.EndList();  // "Sections"
+
+	if (a_Chunk.m_IsLightValid)
+	{
+		a_Writer.AddByte("MCSIsLightValid", 1);
+	}
+	a_Writer.AddLong("LastUpdate", 0);
+	a_Writer.AddByte("TerrainPopulated", 1);
+	a_Writer.EndCompound();  // "Level"
+}
+
+
+
+
+
+void cRegionConverter::CopyNBTTag(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer)
+{
+	AString Name = a_NBT.GetName(a_Tag);
+	switch (a_NBT.GetType(a_Tag))
+	{
+		case TAG_Byte:      a_Writer.AddByte     (Name, a_NBT.GetByte(a_Tag));   break;
+		case TAG_Short:     a_Writer.AddShort    (Name, a_NBT.GetShort(a_Tag));  break;
+		case TAG_Int:       a_Writer.AddInt      (Name, a_NBT.GetInt(a_Tag));    break;
+		case TAG_Long:      a_Writer.AddLong     (Name, a_NBT.GetLong(a_Tag));   break;
+		case TAG_Float:     a_Writer.AddFloat    (Name, a_NBT.GetFloat(a_Tag));  break;
+		case TAG_Double:    a_Writer.AddDouble   (Name, a_NBT.GetDouble(a_Tag)); break;
+		case TAG_String:    a_Writer.AddString   (Name, a_NBT.GetString(a_Tag)); break;
+		case TAG_ByteArray: a_Writer.AddByteArray(Name, a_NBT.GetData(a_Tag), a_NBT.GetDataLength(a_Tag)); break;
+		case TAG_IntArray:
+		{
+			std::vector<int> Values(a_NBT.GetDataLength(a_Tag) / 4);
+			for (size_t i = 0; i < Values.size(); i++)
+			{
+				Values[i] = GetBEInt(a_NBT.GetData(a_Tag) + 4 * i);
+			}
+			a_Writer.AddIntArray(Name, Values.empty() ? nullptr : &Values[0], Values.size());
+			break;
+		}
+		case TAG_List:
+		{
+			a_Writer.BeginList(Name, a_NBT.GetChildrenType(a_Tag));
+			for (int Child = a_NBT.GetFirstChild(a_Tag); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+			{
+				CopyNBTTag(a_NBT, Child, a_Writer);
+			}
+			a_Writer.EndList();
+			break;
+		}
+		case TAG_Compound:
+		{
+			a_Writer.BeginCompound(Name);
+			for (int Child = a_NBT.GetFirstChild(a_Tag); Child >= 0; Child = a_NBT.GetNextSibling(Child))
+			{
+				CopyNBTTag(a_NBT, Child, a_Writer);
+			}
+			a_Writer.EndCompound();
+			break;
+		}
+		case TAG_End:
+		{
+			break;
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,70 @@
+
+// RegionConverter.h
+
+// Interfaces to the cRegionConverter class encapsulating the entire app
+
+/*
+Converts the chunks of a world between the Anvil storage format ("<world>/region/r.X.Z.mca")
+and the binary storage format ("<world>/binregion/r.X.Z.mcb"), in either direction.
+The source files are left intact; the destination files are overwritten.
+Usage: RegionConverter toBinary|toAnvil <WorldFolder>
+*/
+
+
+
+
+
+#pragma once
+
+#include "WorldStorage/BinaryRegionFile.h"
+#include "WorldStorage/FastNBT.h"
+
+
+
+
+
+class cRegionConverter
+{
+public:
+	cRegionConverter(void);
+
+	/** Reads the cmdline params and initializes the app.
+	Returns true if the app should continue, false if not. */
+	bool Init(int argc, char ** argv);
+
+	/** Runs the entire app. */
+	void Run(void);
+
+protected:
+	/** Set to true when converting from Anvil to binary, false when converting from binary to Anvil. */
+	bool m_IsToBinary;
+
+	/** The folder of the world being converted. */
+	AString m_WorldFolder;
+
+	/** Number of chunks converted so far. */
+	int m_NumChunks;
+
+	/** Number of chunks that failed to convert so far. */
+	int m_NumFailed;
+
+
+	/** Converts the specified Anvil region file into the binary format. */
+	void ConvertAnvilFile(const AString & a_FileName, int a_RegionX, int a_RegionZ);
+
+	/** Converts the specified binary region file into the Anvil format. */
+	void ConvertBinaryFile(const AString & a_FileName, int a_RegionX, int a_RegionZ);
+
+	/** Reads the chunk data from the Anvil chunk NBT into a_Chunk. Returns false if the NBT is not a valid chunk. */
+	bool AnvilToBinary(const cParsedNBT & a_NBT, cBinaryChunk & a_Chunk);
+
+	/** Writes the chunk data into a_Writer as an Anvil chunk NBT. */
+	void BinaryToAnvil(const cBinaryChunk & a_Chunk, int a_ChunkX, int a_ChunkZ, cFastNBTWriter & a_Writer);
+
+	/** Writes a copy of the specified tag, with all its children, into a_Writer. */
+	static void CopyNBTTag(const cParsedNBT & a_NBT, int a_Tag, cFastNBTWriter & a_Writer);
+} ;
+
+
+
+
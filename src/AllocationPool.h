@@ -2,6 +2,7 @@
 #pragma once
 
 #include <memory>
+#include "OSSupport/CriticalSection.h"
 
 template <class T>
 class cAllocationPool
@@ -33,7 +34,8 @@ public:
 };
 
 /** Allocates memory storing unused elements in a linked list. Keeps at least NumElementsInReserve
-elements in the list unless malloc fails so that the program has a reserve to handle OOM.**/
+elements in the list unless malloc fails so that the program has a reserve to handle OOM.
+Thread-safe, the chunks ticked in parallel allocate and free their sections from a single pool. **/
 template <class T, size_t NumElementsInReserve>
 class cListAllocationPool : public cAllocationPool<T>
 {
@@ -65,6 +67,7 @@ class cListAllocationPool : public cAllocationPool<T>
 		
 		virtual T * Allocate() override
 		{
+			cCSLock Lock(m_CS);
 			if (m_FreeList.size() <= NumElementsInReserve)
 			{
 				void * space = malloc(sizeof(T));
@@ -96,6 +99,7 @@ class cListAllocationPool : public cAllocationPool<T>
 			}
 			// placement destruct.
 			a_ptr->~T();
+			cCSLock Lock(m_CS);
 			m_FreeList.push_front(a_ptr);
 			if (m_FreeList.size() == NumElementsInReserve)
 			{
@@ -104,6 +108,9 @@ class cListAllocationPool : public cAllocationPool<T>
 		}
 		
 	private:
+		/** Protects m_FreeList against concurrent Allocate() and Free() calls. */
+		cCriticalSection m_CS;
+
 		std::list<void *> m_FreeList;
 		std::auto_ptr<typename cAllocationPool<T>::cStarvationCallbacks> m_Callbacks;
 };
@@ -68,6 +68,9 @@ public:
 	/// Returns nullptr for unknown block types
 	static cBlockEntity * CreateByBlockType(BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta, int a_BlockX, int a_BlockY, int a_BlockZ, cWorld * a_World = nullptr);
 	
+	/** Returns true if the block entity for the specified block type does anything in its Tick(). */
+	static bool IsTickedBlockType(BLOCKTYPE a_BlockType);
+	
 	static const char * GetClassStatic(void)  // Needed for ManualBindings's ForEach templates
 	{
 		return "cBlockEntity";
@@ -115,6 +118,16 @@ public:
 		UNUSED(a_Dt);
 		return false;
 	}
+	
+	/** Called instead of Tick() when the entity hasn't been ticked for a while, because it was out of the players' activation range.
+	a_NumTicks is the number of ticks since the last tick, including this one.
+	The entity should bring itself to the state it would be in if it had been ticked all the time, as far as it's cheaply possible.
+	Returns true if the chunk should be marked as dirty. By default ticks the entity once. */
+	virtual bool CatchUpTicks(int a_NumTicks, float a_Dt, cChunk & a_Chunk)
+	{
+		UNUSED(a_NumTicks);
+		return Tick(a_Dt, a_Chunk);
+	}
 
 protected:
 	/// Position in absolute block coordinates
@@ -86,6 +86,7 @@ protected:
 			}
 
 			m_World->MarkChunkDirty(GetChunkX(), GetChunkZ());
+			m_World->WakeUpHoppersAround(m_PosX, m_PosY, m_PosZ);
 		}
 	}
 } ;  // tolua_export
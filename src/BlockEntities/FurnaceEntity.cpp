@@ -132,6 +132,43 @@ bool cFurnaceEntity::Tick(float a_Dt, cChunk & a_Chunk)
 
 
 
+bool cFurnaceEntity::CatchUpTicks(int a_NumTicks, float a_Dt, cChunk & a_Chunk)
+{
+	// Skip the ticks in which only the counters change, do a real tick for each event (an item smelted, a fuel exhausted):
+	bool res = false;
+	int TicksLeft = a_NumTicks;
+	while (TicksLeft > 0)
+	{
+		if (m_FuelBurnTime <= 0)
+		{
+			// Out of fuel, the progress only reverses; the last tick does the rest:
+			m_TimeCooked = std::max(m_TimeCooked - 2 * (TicksLeft - 1), 0);
+			return Tick(a_Dt, a_Chunk) || res;
+		}
+
+		int NumTicks = std::min(TicksLeft, m_FuelBurnTime - m_TimeBurned);
+		if (m_IsCooking)
+		{
+			NumTicks = std::min(NumTicks, m_NeedCookTime - m_TimeCooked);
+		}
+		NumTicks = std::max(NumTicks, 1);
+
+		// Advance the counters up to the tick in which the next event happens, and process that tick normally:
+		if (m_IsCooking)
+		{
+			m_TimeCooked += NumTicks - 1;
+		}
+		m_TimeBurned += NumTicks - 1;
+		res = Tick(a_Dt, a_Chunk) || res;
+		TicksLeft -= NumTicks;
+	}
+	return res;
+}
+
+
+
+
+
 void cFurnaceEntity::SendTo(cClientHandle & a_Client)
 {
 	// Nothing needs to be sent
@@ -43,6 +43,7 @@ public:
 	// cBlockEntity overrides:
 	virtual void SendTo(cClientHandle & a_Client) override;
 	virtual bool Tick(float a_Dt, cChunk & a_Chunk) override;
+	virtual bool CatchUpTicks(int a_NumTicks, float a_Dt, cChunk & a_Chunk) override;
 	virtual void UsedBy(cPlayer * a_Player) override;
 	virtual void Destroy() override
 	{
@@ -6,6 +6,7 @@
 #include "Globals.h"
 #include "HopperEntity.h"
 #include "../Chunk.h"
+#include "../BoundingBox.h"
 #include "../Entities/Player.h"
 #include "../Entities/Pickup.h"
 #include "../Bindings/PluginManager.h"
@@ -19,7 +20,8 @@
 cHopperEntity::cHopperEntity(int a_BlockX, int a_BlockY, int a_BlockZ, cWorld * a_World) :
 	super(E_BLOCK_HOPPER, a_BlockX, a_BlockY, a_BlockZ, ContentsWidth, ContentsHeight, a_World),
 	m_LastMoveItemsInTick(0),
-	m_LastMoveItemsOutTick(0)
+	m_LastMoveItemsOutTick(0),
+	m_IsSleeping(false)
 {
 }
 
@@ -57,12 +59,63 @@ bool cHopperEntity::GetOutputBlockPos(NIBBLETYPE a_BlockMeta, int & a_OutputX, i
 bool cHopperEntity::Tick(float a_Dt, cChunk & a_Chunk)
 {
 	UNUSED(a_Dt);
+	if (m_IsSleeping)
+	{
+		// Nothing can move until the containers or the pickups around change
+		return false;
+	}
 	Int64 CurrentTick = a_Chunk.GetWorld()->GetWorldAge();
+	bool AreTransfersDue = (
+		(CurrentTick - m_LastMoveItemsInTick >= TICKS_PER_TRANSFER) &&
+		(CurrentTick - m_LastMoveItemsOutTick >= TICKS_PER_TRANSFER)
+	);
 
 	bool res = false;
 	res = MoveItemsIn  (a_Chunk, CurrentTick) || res;
 	res = MovePickupsIn(a_Chunk, CurrentTick) || res;
 	res = MoveItemsOut (a_Chunk, CurrentTick) || res;
+
+	// If no transfer was held back and nothing moved, nothing will move until something around changes:
+	if (!res && AreTransfersDue && AreNeighborChunksValid(a_Chunk))
+	{
+		m_IsSleeping = true;
+	}
+	return res;
+}
+
+
+
+
+
+bool cHopperEntity::CatchUpTicks(int a_NumTicks, float a_Dt, cChunk & a_Chunk)
+{
+	// Replay the transfers that would have happened since the last tick, one round per TICKS_PER_TRANSFER ticks,
+	// until a round doesn't move anything (the hopper would have stayed idle from then on):
+	if (m_IsSleeping)
+	{
+		return false;
+	}
+	Int64 CurrentTick = a_Chunk.GetWorld()->GetWorldAge();
+	Int64 FirstTick = std::max(CurrentTick - a_NumTicks + 1, std::max(m_LastMoveItemsInTick, m_LastMoveItemsOutTick) + TICKS_PER_TRANSFER);
+	if (FirstTick > CurrentTick)
+	{
+		return Tick(a_Dt, a_Chunk);
+	}
+
+	bool res = false;
+	for (Int64 EmulatedTick = FirstTick; EmulatedTick <= CurrentTick; EmulatedTick += TICKS_PER_TRANSFER)
+	{
+		bool HasMoved = false;
+		HasMoved = MoveItemsIn  (a_Chunk, EmulatedTick) || HasMoved;
+		HasMoved = MovePickupsIn(a_Chunk, EmulatedTick) || HasMoved;
+		HasMoved = MoveItemsOut (a_Chunk, EmulatedTick) || HasMoved;
+		if (!HasMoved)
+		{
+			m_IsSleeping = AreNeighborChunksValid(a_Chunk);
+			break;
+		}
+		res = true;
+	}
 	return res;
 }
 
@@ -124,6 +177,29 @@ void cHopperEntity::OpenNewWindow(void)
 
 
 
+bool cHopperEntity::AreNeighborChunksValid(cChunk & a_Chunk)
+{
+	// The hopper reaches at most two blocks away horizontally (the other half of a double chest next to its output):
+	for (int x = -2; x <= 2; x += 2)
+	{
+		for (int z = -2; z <= 2; z += 2)
+		{
+			int RelX = m_RelX + x;
+			int RelZ = m_RelZ + z;
+			cChunk * Neighbor = a_Chunk.GetRelNeighborChunkAdjustCoords(RelX, RelZ);
+			if ((Neighbor == nullptr) || !Neighbor->IsValid())
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+
+
+
 /// Moves items from the container above it into this hopper. Returns true if the contents have changed.
 bool cHopperEntity::MoveItemsIn(cChunk & a_Chunk, Int64 a_CurrentTick)
 {
@@ -262,8 +338,13 @@ bool cHopperEntity::MovePickupsIn(cChunk & a_Chunk, Int64 a_CurrentTick)
 		cItemGrid & m_Contents;
 	};
 
+	// Only the pickups in the block above the hopper can be sucked in:
+	cBoundingBox SearchBox(
+		Vector3d(GetPosX(),     GetPosY() + 0.5, GetPosZ()),
+		Vector3d(GetPosX() + 1, GetPosY() + 1.5, GetPosZ() + 1)
+	);
 	cHopperPickupSearchCallback HopperPickupSearchCallback(Vector3i(GetPosX(), GetPosY(), GetPosZ()), m_Contents);
-	a_Chunk.ForEachEntity(HopperPickupSearchCallback);
+	a_Chunk.ForEachEntityInBox(SearchBox, HopperPickupSearchCallback);
 
 	return HopperPickupSearchCallback.FoundPickupsAbove();
 }
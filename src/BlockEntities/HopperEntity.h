@@ -41,20 +41,32 @@ public:
 	Exported in ManualBindings.cpp
 	*/
 	bool GetOutputBlockPos(NIBBLETYPE a_BlockMeta, int & a_OutputX, int & a_OutputY, int & a_OutputZ);
+
+	/** Makes the hopper try moving items again in its next tick.
+	Called when the contents of a container around change, a container is placed next to the hopper, or a pickup is above the hopper. */
+	void WakeUp(void) { m_IsSleeping = false; }
 	
 protected:
 
 	Int64 m_LastMoveItemsInTick;
 	Int64 m_LastMoveItemsOutTick;
 
+	/** Set when the hopper has found nothing to move; it then isn't ticked until woken up by WakeUp(). */
+	bool m_IsSleeping;
+
 	// cBlockEntity overrides:
 	virtual bool Tick(float a_Dt, cChunk & a_Chunk) override;
+	virtual bool CatchUpTicks(int a_NumTicks, float a_Dt, cChunk & a_Chunk) override;
 	virtual void SendTo(cClientHandle & a_Client) override;
 	virtual void UsedBy(cPlayer * a_Player) override;
 	
 	/// Opens a new chest window for this chest. Scans for neighbors to open a double chest window, if appropriate.
 	void OpenNewWindow(void);
 
+	/** Returns true if all the chunks the hopper can reach into are loaded and valid.
+	The hopper mustn't fall asleep otherwise, because nothing wakes it up when such a chunk loads. */
+	bool AreNeighborChunksValid(cChunk & a_Chunk);
+
 	/// Moves items from the container above it into this hopper. Returns true if the contents have changed.
 	bool MoveItemsIn(cChunk & a_Chunk, Int64 a_CurrentTick);
 	
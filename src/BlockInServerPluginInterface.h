@@ -18,11 +18,13 @@ public:
 
 	virtual bool CallHookBlockSpread(int a_BlockX, int a_BlockY, int a_BlockZ, eSpreadSource a_Source)
 	{
+		ASSERT(!m_World.GetChunkMap()->IsTickingInParallel());  // The plugins may access any chunk, see cChunk::TickLocal()
 		return cPluginManager::Get()->CallHookBlockSpread(m_World, a_BlockX, a_BlockY, a_BlockZ, a_Source);
 	}
 
 	virtual bool CallHookBlockToPickups(cEntity * a_Digger, int a_BlockX, int a_BlockY, int a_BlockZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta, cItems & a_Pickups) override
 	{
+		ASSERT(!m_World.GetChunkMap()->IsTickingInParallel());  // The plugins may access any chunk, see cChunk::TickLocal()
 		return cPluginManager::Get()->CallHookBlockToPickups(m_World, a_Digger, a_BlockX, a_BlockY, a_BlockZ, a_BlockType, a_BlockMeta, a_Pickups);
 	}
 
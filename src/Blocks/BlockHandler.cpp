@@ -556,6 +556,15 @@ bool cBlockHandler::DoesDropOnUnsuitable(void)
 
 
 
+bool cBlockHandler::DoesUpdateCallPluginHooks(void)
+{
+	return false;
+}
+
+
+
+
+
 void cBlockHandler::Check(cChunkInterface & a_ChunkInterface, cBlockPluginInterface & a_PluginInterface, int a_RelX, int a_RelY, int a_RelZ, cChunk & a_Chunk)
 {
 	if (!CanBeAt(a_ChunkInterface, a_RelX, a_RelY, a_RelZ, a_Chunk))
@@ -118,6 +118,11 @@ public:
 	/** Returns if this block drops if it gets destroyed by an unsuitable situation.
 	Default: true */
 	virtual bool DoesDropOnUnsuitable(void);
+
+	/** Returns true if OnUpdate() may call the plugin hooks, directly or by dropping the block.
+	The random ticks of such blocks are deferred from the parallel chunk ticking to the tick thread, see cChunk::TickBlocks().
+	Default: false */
+	virtual bool DoesUpdateCallPluginHooks(void);
 	
 	/** Called when one of the neighbors gets set; equivalent to MC block update.
 	By default drops if position no more suitable (CanBeAt(), DoesDropOnUnsuitable(), Drop()),
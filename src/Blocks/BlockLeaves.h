@@ -70,6 +70,13 @@ public:
 	}
 	
 	
+	virtual bool DoesUpdateCallPluginHooks(void) override
+	{
+		// Decaying leaves are dropped, calling the BlockToPickups hook
+		return true;
+	}
+	
+	
 	virtual void OnUpdate(cChunkInterface & a_ChunkInterface, cWorldInterface & a_WorldInterface, cBlockPluginInterface & a_PluginInterface, cChunk & a_Chunk, int a_RelX, int a_RelY, int a_RelZ) override
 	{
 		NIBBLETYPE Meta = a_Chunk.GetMeta(a_RelX, a_RelY, a_RelZ);
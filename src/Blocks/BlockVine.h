@@ -177,6 +177,13 @@ public:
 	}
 	
 
+	virtual bool DoesUpdateCallPluginHooks(void) override
+	{
+		// Vine spreading calls the BlockSpread hook
+		return true;
+	}
+	
+
 	virtual void OnUpdate(cChunkInterface & a_ChunkInterface, cWorldInterface & a_WorldInterface, cBlockPluginInterface & a_BlockPluginInterface, cChunk & a_Chunk, int a_RelX, int a_RelY, int a_RelZ)
 	{
 		UNUSED(a_ChunkInterface);
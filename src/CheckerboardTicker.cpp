@@ -0,0 +1,217 @@
+
+// CheckerboardTicker.cpp
+
+// Implements the cCheckerboardTicker class that ticks square regions in parallel, in the rounds of a 2x2 checkerboard pattern
+
+#include "Globals.h"
+#include "CheckerboardTicker.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cCheckerboardTicker:
+
+cCheckerboardTicker::cCheckerboardTicker(void) :
+	m_IsTickingParallel(false),
+	m_NumTicking(0),
+	m_Dt(0)
+{
+}
+
+
+
+
+
+cCheckerboardTicker::~cCheckerboardTicker()
+{
+	StopThreads();
+}
+
+
+
+
+
+void cCheckerboardTicker::StartThreads(int a_NumThreads)
+{
+	StopThreads();
+
+	// The thread calling Tick() ticks, too, so start one thread less than requested:
+	for (int i = 1; i < a_NumThreads; i++)
+	{
+		cWorker * Worker = new cWorker(*this);
+		if (!Worker->Start())
+		{
+			LOGWARNING("%s: Cannot start a tick thread, ticking with %u threads", __FUNCTION__, static_cast<unsigned>(m_Workers.size() + 1));
+			delete Worker;
+			return;
+		}
+		m_Workers.push_back(Worker);
+	}
+}
+
+
+
+
+
+void cCheckerboardTicker::StopThreads(void)
+{
+	ASSERT(!m_IsTickingParallel);
+	for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->Stop();
+		delete *itr;
+	}
+	m_Workers.clear();
+}
+
+
+
+
+
+void cCheckerboardTicker::Tick(const cRegions & a_Regions, float a_Dt)
+{
+	// The regions are ticked in four rounds, by their "color" in a 2x2 checkerboard pattern.
+	// Two regions ticked in the same round are always at least one whole region apart.
+	m_IsTickingParallel = !m_Workers.empty();
+	for (int Color = 0; Color < 4; Color++)
+	{
+		{
+			cCSLock Lock(m_CSQueue);
+			ASSERT(m_Queue.empty());
+			ASSERT(m_NumTicking == 0);
+			for (cRegions::const_iterator itr = a_Regions.begin(), end = a_Regions.end(); itr != end; ++itr)
+			{
+				if ((((*itr)->GetRegionX() & 1) == (Color & 1)) && (((*itr)->GetRegionZ() & 1) == (Color >> 1)))
+				{
+					m_Queue.push_back(*itr);
+				}
+			}  // for itr - a_Regions[]
+			if (m_Queue.empty())
+			{
+				continue;
+			}
+			m_NumTicking = m_Queue.size();
+			m_Dt = a_Dt;
+		}
+		for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+		{
+			(*itr)->WakeUp();
+		}
+
+		// Help with the ticking, then wait for the workers to finish the regions they have taken:
+		TickQueuedRegions();
+		for (;;)
+		{
+			{
+				cCSLock Lock(m_CSQueue);
+				if (m_NumTicking == 0)
+				{
+					break;
+				}
+			}
+			m_evtRegionsTicked.Wait();
+		}
+	}  // for Color
+	m_IsTickingParallel = false;
+}
+
+
+
+
+
+bool cCheckerboardTicker::IsWorkerThread(void) const
+{
+	if (!m_IsTickingParallel)
+	{
+		return false;
+	}
+	for (cWorkers::const_iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+	{
+		if ((*itr)->IsCurrentThread())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+void cCheckerboardTicker::TickQueuedRegions(void)
+{
+	for (;;)
+	{
+		cRegion * Region;
+		float Dt;
+		{
+			cCSLock Lock(m_CSQueue);
+			if (m_Queue.empty())
+			{
+				return;
+			}
+			Region = m_Queue.back();
+			m_Queue.pop_back();
+			Dt = m_Dt;
+		}
+
+		Region->TickRegion(Dt);
+
+		cCSLock Lock(m_CSQueue);
+		ASSERT(m_NumTicking > 0);
+		m_NumTicking -= 1;
+		if (m_NumTicking == 0)
+		{
+			m_evtRegionsTicked.Set();
+		}
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cCheckerboardTicker::cWorker:
+
+cCheckerboardTicker::cWorker::cWorker(cCheckerboardTicker & a_Ticker) :
+	super("cCheckerboardTicker::cWorker"),
+	m_Ticker(a_Ticker)
+{
+}
+
+
+
+
+
+void cCheckerboardTicker::cWorker::Stop(void)
+{
+	m_ShouldTerminate = true;
+	m_evtRegionsQueued.Set();
+
+	Wait();
+}
+
+
+
+
+
+void cCheckerboardTicker::cWorker::Execute(void)
+{
+	while (!m_ShouldTerminate)
+	{
+		m_evtRegionsQueued.Wait();
+		if (m_ShouldTerminate)
+		{
+			return;
+		}
+		m_Ticker.TickQueuedRegions();
+	}
+}
+
+
+
+
@@ -0,0 +1,126 @@
+
+// CheckerboardTicker.h
+
+// Declares the cCheckerboardTicker class that ticks square regions in parallel, in the rounds of a 2x2 checkerboard pattern
+
+/*
+The regions are split into four rounds by their "color" in a 2x2 checkerboard pattern. The regions of a single round
+are ticked in parallel by the worker threads and by the thread calling Tick(); two regions ticked at the same time
+are always at least one whole region apart, so ticking a region may reach into its direct neighbors without locking.
+The next round starts only after all the regions of the previous round have finished ticking.
+cChunkMap uses this to tick its chunk layers.
+*/
+
+
+
+
+
+#pragma once
+
+#include "OSSupport/IsThread.h"
+
+
+
+
+
+class cCheckerboardTicker
+{
+public:
+
+	/** Interface for the regions to be ticked. */
+	class cRegion
+	{
+	public:
+		virtual ~cRegion() {}
+
+		/** Returns the coords of the region in the checkerboard. */
+		virtual int GetRegionX(void) const = 0;
+		virtual int GetRegionZ(void) const = 0;
+
+		/** Ticks the region. Called from any of the ticking threads, but never for two neighboring regions at the same time. */
+		virtual void TickRegion(float a_Dt) = 0;
+	} ;
+
+	typedef std::vector<cRegion *> cRegions;
+
+
+	cCheckerboardTicker(void);
+	~cCheckerboardTicker();
+
+	/** Starts the worker threads, stopping the previous ones first.
+	The thread calling Tick() ticks, too, so a_NumThreads - 1 workers are started; with a_NumThreads less than 2, none are. */
+	void StartThreads(int a_NumThreads);
+
+	/** Stops all the worker threads. Must not be called while ticking. */
+	void StopThreads(void);
+
+	/** Returns the number of threads ticking the regions, including the thread calling Tick(). */
+	size_t GetNumThreads(void) const { return m_Workers.size() + 1; }
+
+	/** Ticks all the specified regions, in parallel if there are worker threads. Returns after all the regions have been ticked. */
+	void Tick(const cRegions & a_Regions, float a_Dt);
+
+	/** Returns true while Tick() is ticking the regions in parallel. */
+	bool IsTickingParallel(void) const { return m_IsTickingParallel; }
+
+	/** Returns true if the calling thread is one of the workers, currently ticking the regions in parallel. */
+	bool IsWorkerThread(void) const;
+
+protected:
+
+	/** A thread that helps the thread calling Tick() with ticking the regions queued in m_Queue. */
+	class cWorker :
+		public cIsThread
+	{
+		typedef cIsThread super;
+
+	public:
+		cWorker(cCheckerboardTicker & a_Ticker);
+
+		/** Signals the thread to terminate and waits until it's finished. */
+		void Stop(void);
+
+		/** Wakes the thread up if it's waiting for regions to tick. */
+		void WakeUp(void) { m_evtRegionsQueued.Set(); }
+
+	protected:
+		cCheckerboardTicker & m_Ticker;
+
+		/** Set when regions have been queued for ticking, or to stop the thread */
+		cEvent m_evtRegionsQueued;
+
+		virtual void Execute(void) override;
+	} ;
+
+	typedef std::vector<cWorker *> cWorkers;
+
+
+	/** The threads helping the thread calling Tick(). Empty if the regions are ticked serially. */
+	cWorkers m_Workers;
+
+	/** Set while the regions are being ticked in parallel, so that IsWorkerThread() needn't look through m_Workers otherwise. */
+	std::atomic<bool> m_IsTickingParallel;
+
+	/** Protects m_Queue, m_NumTicking and m_Dt */
+	cCriticalSection m_CSQueue;
+
+	/** The regions waiting to be picked by a thread for ticking, all of the same checkerboard color. */
+	cRegions m_Queue;
+
+	/** The number of regions of the current checkerboard color that haven't finished ticking yet, including those in m_Queue. */
+	size_t m_NumTicking;
+
+	/** The Dt value for the current tick, to be passed to the regions ticked by the workers. */
+	float m_Dt;
+
+	/** Set when m_NumTicking drops to zero. */
+	cEvent m_evtRegionsTicked;
+
+
+	/** Ticks the regions queued in m_Queue until the queue is empty. Called by both the thread calling Tick() and the workers. */
+	void TickQueuedRegions(void);
+} ;
+
+
+
+
@@ -39,6 +39,7 @@
 #include "SetChunkData.h"
 #include "BoundingBox.h"
 #include "Blocks/ChunkInterface.h"
+#include "LightUpdater.h"
 
 #include "json/json.h"
 
@@ -66,6 +67,12 @@ sSetBlock::sSetBlock(int a_BlockX, int a_BlockY, int a_BlockZ, BLOCKTYPE a_Block
 ////////////////////////////////////////////////////////////////////////////////
 // cChunk:
 
+std::atomic<UInt64> cChunk::s_DataVersionCounter(0);
+
+
+
+
+
 cChunk::cChunk(
 	int a_ChunkX, int a_ChunkZ,
 	cChunkMap * a_ChunkMap, cWorld * a_World,
@@ -74,10 +81,13 @@ cChunk::cChunk(
 ) :
 	m_Presence(cpInvalid),
 	m_ShouldGenerateIfLoadFailed(false),
+	m_IsExplicitlyRequested(false),
 	m_IsLightValid(false),
 	m_IsDirty(false),
 	m_IsSaving(false),
 	m_HasLoadFailed(false),
+	m_IsReplayingJournal(false),
+	m_DataVersion(++s_DataVersionCounter),
 	m_StayCount(0),
 	m_PosX(a_ChunkX),
 	m_PosZ(a_ChunkZ),
@@ -95,7 +105,9 @@ cChunk::cChunk(
 	m_LavaSimulatorData (a_World->GetLavaSimulator ()->CreateChunkData()),
 	m_RedstoneSimulatorData(a_World->GetRedstoneSimulator()->CreateChunkData()),
 	m_IsRedstoneDirty(false),
-	m_AlwaysTicked(0)
+	m_AlwaysTicked(0),
+	m_NumSkippedBlockEntityTicks(0),
+	m_AreBlockEntitiesWoken(false)
 {
 	if (a_NeighborXM != nullptr)
 	{
@@ -132,6 +144,7 @@ cChunk::~cChunk()
 	m_BlockEntities.clear();
 
 	// Remove and destroy all entities that are not players:
+	m_EntityIndex.Clear();
 	cEntityList Entities;
 	std::swap(Entities, m_Entities);  // Need another list because cEntity destructors check if they've been removed from chunk
 	for (cEntityList::const_iterator itr = Entities.begin(); itr != Entities.end(); ++itr)
@@ -174,6 +187,10 @@ cChunk::~cChunk()
 void cChunk::SetPresence(cChunk::ePresence a_Presence)
 {
 	m_Presence = a_Presence;
+	if (a_Presence != cpQueued)
+	{
+		m_IsExplicitlyRequested = false;
+	}
 	if (a_Presence == cpPresent)
 	{
 		m_World->GetChunkMap()->ChunkValidated();
@@ -266,7 +283,22 @@ void cChunk::MarkLoadFailed(void)
 	else
 	{
 		m_Presence = cpInvalid;
+		m_IsExplicitlyRequested = false;
+	}
+}
+
+
+
+
+
+bool cChunk::TryUnqueueUnwanted(void)
+{
+	if ((m_Presence != cpQueued) || !m_LoadedByClient.empty() || (m_StayCount > 0) || m_IsExplicitlyRequested)
+	{
+		return false;
 	}
+	m_Presence = cpInvalid;
+	return true;
 }
 
 
@@ -282,6 +314,8 @@ void cChunk::GetAllData(cChunkDataCallback & a_Callback)
 
 	a_Callback.LightIsValid(m_IsLightValid);
 
+	a_Callback.DataVersion(m_DataVersion);
+
 	a_Callback.ChunkData(m_ChunkData);
 	
 	for (cEntityList::iterator itr = m_Entities.begin(); itr != m_Entities.end(); ++itr)
@@ -307,6 +341,7 @@ void cChunk::SetAllData(cSetChunkData & a_SetChunkData)
 	
 	memcpy(m_BiomeMap, a_SetChunkData.GetBiomes(), sizeof(m_BiomeMap));
 	memcpy(m_HeightMap, a_SetChunkData.GetHeightMap(), sizeof(m_HeightMap));
+	MarkDataChanged();
 
 	m_ChunkData.SetBlockTypes(a_SetChunkData.GetBlockTypes());
 	m_ChunkData.SetMetas(a_SetChunkData.GetBlockMetas());
@@ -361,6 +396,24 @@ void cChunk::SetAllData(cSetChunkData & a_SetChunkData)
 
 
 
+void cChunk::ReplayJournal(const cChunkJournal::cBlockChanges & a_Changes)
+{
+	m_IsReplayingJournal = true;
+	for (cChunkJournal::cBlockChanges::const_iterator itr = a_Changes.begin(), end = a_Changes.end(); itr != end; ++itr)
+	{
+		// Skip the blocks that already match, so that their block entities are kept:
+		if ((GetBlock(itr->m_RelX, itr->m_RelY, itr->m_RelZ) != itr->m_BlockType) || (GetMeta(itr->m_RelX, itr->m_RelY, itr->m_RelZ) != itr->m_BlockMeta))
+		{
+			SetBlock(itr->m_RelX, itr->m_RelY, itr->m_RelZ, itr->m_BlockType, itr->m_BlockMeta, false);
+		}
+	}
+	m_IsReplayingJournal = false;
+}
+
+
+
+
+
 void cChunk::SetLight(
 	const cChunkDef::BlockNibbles & a_BlockLight,
 	const cChunkDef::BlockNibbles & a_SkyLight
@@ -374,6 +427,7 @@ void cChunk::SetLight(
 	m_ChunkData.SetSkyLight(a_SkyLight);
 
 	m_IsLightValid = true;
+	MarkDataChanged();
 }
 
 
@@ -413,6 +467,12 @@ void cChunk::WriteBlockArea(cBlockArea & a_Area, int a_MinBlockX, int a_MinBlock
 	int BaseZ = BlockStartZ - a_MinBlockZ;
 	int SizeY = a_Area.GetSizeY();
 
+	// For large areas, updating the light around each changed block is slower than re-lighting the whole chunk later on:
+	if (SizeX * SizeY * SizeZ > 16 * 16 * 16)
+	{
+		m_IsLightValid = false;
+	}
+
 	// TODO: Improve this by not calling FastSetBlock() and doing the processing here
 	// so that the heightmap is touched only once for each column.
 	BLOCKTYPE *  AreaBlockTypes = a_Area.GetBlockTypes();
@@ -603,30 +663,97 @@ void cChunk::SpawnMobs(cMobSpawner& a_MobSpawner)
 
 void cChunk::Tick(float a_Dt)
 {
+	TickLocal(a_Dt);
+	TickShared(a_Dt);
+}
+
+
+
+
+
+void cChunk::TickLocal(float a_Dt)
+{
+	UNUSED(a_Dt);
+
 	BroadcastPendingBlockChanges();
 
 	// Set all blocks that have been queued for setting later:
 	ProcessQueuedSetBlocks();
 
-	CheckBlocks();
+	// Checking a block may drop it, calling the plugin hooks; in parallel ticking, defer the checks to TickShared():
+	if (m_ChunkMap->IsTickingInParallel())
+	{
+		m_DeferredCheckBlocks.insert(m_DeferredCheckBlocks.end(), m_ToTickBlocks.begin(), m_ToTickBlocks.end());
+		m_ToTickBlocks.clear();
+	}
+	else
+	{
+		CheckBlocks();
+	}
 	
+	TickBlocks();
+
+	ApplyWeatherToTop();
+}
+
+
+
+
+
+void cChunk::TickShared(float a_Dt)
+{
+	ProcessDeferredBlocks();
+
 	// Tick simulators:
 	m_World->GetSimulatorManager()->SimulateChunk(a_Dt, m_PosX, m_PosZ, this);
 	
-	TickBlocks();
-
-	// Tick all block entities in this chunk:
-	for (cBlockEntityList::iterator itr = m_BlockEntities.begin(); itr != m_BlockEntities.end(); ++itr)
+	// Tick all block entities in this chunk. Out of the players' activation range, tick them only once in a while,
+	// or when a block next to them changes, and let them catch up on the skipped ticks:
+	if (
+		m_AreBlockEntitiesWoken ||
+		(m_NumSkippedBlockEntityTicks + 1 >= m_World->GetInactiveBlockEntityTickInterval()) ||
+		m_World->IsChunkInActivationRange(m_PosX, m_PosZ, m_World->GetBlockEntityActivationRange())
+	)
 	{
-		m_IsDirty = (*itr)->Tick(a_Dt, *this) | m_IsDirty;
+		int NumTicks = m_NumSkippedBlockEntityTicks + 1;
+		for (cBlockEntityList::iterator itr = m_BlockEntities.begin(); itr != m_BlockEntities.end(); ++itr)
+		{
+			if (NumTicks > 1)
+			{
+				m_IsDirty = (*itr)->CatchUpTicks(NumTicks, a_Dt, *this) | m_IsDirty;
+			}
+			else
+			{
+				m_IsDirty = (*itr)->Tick(a_Dt, *this) | m_IsDirty;
+			}
+		}
+		m_NumSkippedBlockEntityTicks = 0;
+		m_AreBlockEntitiesWoken = false;
+	}
+	else
+	{
+		m_NumSkippedBlockEntityTicks++;
 	}
 	
+	// Out of the players' activation range, entities are ticked only once per interval, spread over the ticks by their IDs.
+	// Such a tick covers all the skipped ticks, so that the timers (despawning) and the physics keep their pace:
+	bool AreEntitiesActive = m_World->IsChunkInActivationRange(m_PosX, m_PosZ, m_World->GetEntityActivationRange());
+	Int64 WorldAge = m_World->GetWorldAge();
+	int InactiveEntityTickInterval = m_World->GetInactiveEntityTickInterval();
 	for (cEntityList::iterator itr = m_Entities.begin(); itr != m_Entities.end();)
 	{
 		if (!((*itr)->IsMob()))  // Mobs are ticked inside cWorld::TickMobs() (as we don't have to tick them if they are far away from players)
 		{
-			// Tick all entities in this chunk (except mobs):
-			(*itr)->Tick(a_Dt, *this);
+			// Tick all entities in this chunk (except mobs). Players and fast-moving entities are always ticked:
+			bool IsAlwaysTicked = (
+				AreEntitiesActive ||
+				(*itr)->IsPlayer() || (*itr)->IsProjectile() || (*itr)->IsTNT() || (*itr)->IsFallingBlock()
+			);
+			if (IsAlwaysTicked || (((WorldAge + (*itr)->GetUniqueID()) % InactiveEntityTickInterval) == 0))
+			{
+				int NumTicks = (*itr)->UpdateLastChunkTick(WorldAge, InactiveEntityTickInterval);
+				(*itr)->Tick(IsAlwaysTicked ? a_Dt : a_Dt * NumTicks, *this);
+			}
 		}
 
 		if ((*itr)->IsDestroyed())  // Remove all entities that were scheduled for removal:
@@ -634,6 +761,7 @@ void cChunk::Tick(float a_Dt)
 			LOGD("Destroying entity #%i (%s)", (*itr)->GetUniqueID(), (*itr)->GetClass());
 			MarkDirty();
 			cEntity * ToDelete = *itr;
+			m_EntityIndex.Remove(ToDelete);
 			itr = m_Entities.erase(itr);
 			delete ToDelete;
 		}
@@ -642,6 +770,7 @@ void cChunk::Tick(float a_Dt)
 			// Remove all entities that are travelling to another world
 			MarkDirty();
 			(*itr)->SetWorldTravellingFrom(nullptr);
+			m_EntityIndex.Remove(*itr);
 			itr = m_Entities.erase(itr);
 		}
 		else if (
@@ -651,16 +780,16 @@ void cChunk::Tick(float a_Dt)
 		{
 			// The entity moved out of the chunk, move it to the neighbor
 			MarkDirty();
+			m_EntityIndex.Remove(*itr);  // Before the neighbor adds it into its own index
 			MoveEntityToNewChunk(*itr);
 			itr = m_Entities.erase(itr);
 		}
 		else
 		{
+			m_EntityIndex.Update(*itr);
 			++itr;
 		}
 	}  // for itr - m_Entitites[]
-	
-	ApplyWeatherToTop();
 }
 
 
@@ -740,6 +869,7 @@ void cChunk::ProcessQueuedSetBlocks(void)
 					// Current world age is bigger than/equal to target world age - delay time reached AND
 					// Previous block type was the same as current block type (to prevent duplication)
 					SetBlock(itr->m_RelX, itr->m_RelY, itr->m_RelZ, itr->m_BlockType, itr->m_BlockMeta);  // SetMeta doesn't send to client
+					m_QueuedSetBlocksDone.push_back(Vector3i(itr->m_RelX, itr->m_RelY, itr->m_RelZ));
 					itr = m_SetBlockQueue.erase(itr);
 					LOGD("Successfully set queued block - previous and current types matched");
 				}
@@ -753,6 +883,7 @@ void cChunk::ProcessQueuedSetBlocks(void)
 			{
 				// Current world age is bigger than/equal to target world age - delay time reached
 				SetBlock(itr->m_RelX, itr->m_RelY, itr->m_RelZ, itr->m_BlockType, itr->m_BlockMeta);
+				m_QueuedSetBlocksDone.push_back(Vector3i(itr->m_RelX, itr->m_RelY, itr->m_RelZ));
 				itr = m_SetBlockQueue.erase(itr);
 				LOGD("Successfully set queued block - previous type ignored");
 			}
@@ -770,6 +901,18 @@ void cChunk::ProcessQueuedSetBlocks(void)
 
 
 
+void cChunk::JournalBlockChange(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+	if (!m_IsReplayingJournal)
+	{
+		m_World->GetStorage().GetJournal().AddBlockChange(m_PosX, m_PosZ, a_RelX, a_RelY, a_RelZ, a_BlockType, a_BlockMeta);
+	}
+}
+
+
+
+
+
 void cChunk::BroadcastPendingBlockChanges(void)
 {
 	if (m_PendingSendBlocks.empty())
@@ -796,17 +939,66 @@ void cChunk::CheckBlocks()
 	}
 	std::vector<Vector3i> ToTickBlocks;
 	std::swap(m_ToTickBlocks, ToTickBlocks);
-	
+	CheckBlocks(ToTickBlocks);
+}
+
+
+
+
+
+void cChunk::CheckBlocks(const std::vector<Vector3i> & a_Blocks)
+{
 	cChunkInterface ChunkInterface(m_World->GetChunkMap());
 	cBlockInServerPluginInterface PluginInterface(*m_World);
 	
-	for (std::vector<Vector3i>::const_iterator itr = ToTickBlocks.begin(), end = ToTickBlocks.end(); itr != end; ++itr)
+	for (std::vector<Vector3i>::const_iterator itr = a_Blocks.begin(), end = a_Blocks.end(); itr != end; ++itr)
 	{
 		Vector3i Pos = (*itr);
 
 		cBlockHandler * Handler = BlockHandler(GetBlock(Pos));
 		Handler->Check(ChunkInterface, PluginInterface, Pos.x, Pos.y, Pos.z, *this);
-	}  // for itr - ToTickBlocks[]
+	}  // for itr - a_Blocks[]
+}
+
+
+
+
+
+void cChunk::ProcessDeferredBlocks(void)
+{
+	// Wake up the redstone simulator for the queued blocks that have been set, if it needs that (buttons popping back out):
+	if (!m_QueuedSetBlocksDone.empty())
+	{
+		std::vector<Vector3i> SetBlocks;
+		std::swap(m_QueuedSetBlocksDone, SetBlocks);
+		cRedstoneSimulator * RedstoneSimulator = m_World->GetRedstoneSimulator();
+		if (RedstoneSimulator->ShouldWakeUpOnQueuedSetBlocks())
+		{
+			for (std::vector<Vector3i>::const_iterator itr = SetBlocks.begin(), end = SetBlocks.end(); itr != end; ++itr)
+			{
+				RedstoneSimulator->WakeUp(m_PosX * Width + itr->x, itr->y, m_PosZ * Width + itr->z, this);
+			}
+		}
+	}
+	if (!m_DeferredCheckBlocks.empty())
+	{
+		std::vector<Vector3i> ToCheck;
+		std::swap(m_DeferredCheckBlocks, ToCheck);
+		CheckBlocks(ToCheck);
+	}
+	if (!m_DeferredTickBlocks.empty())
+	{
+		std::vector<Vector3i> ToTick;
+		std::swap(m_DeferredTickBlocks, ToTick);
+		cChunkInterface ChunkInterface(m_World->GetChunkMap());
+		cBlockInServerPluginInterface PluginInterface(*m_World);
+		for (std::vector<Vector3i>::const_iterator itr = ToTick.begin(), end = ToTick.end(); itr != end; ++itr)
+		{
+			// The block may have changed since the tick was deferred, use its current handler:
+			cBlockHandler * Handler = BlockHandler(GetBlock(*itr));
+			Handler->OnUpdate(ChunkInterface, *m_World, PluginInterface, *this, itr->x, itr->y, itr->z);
+		}
+	}
 }
 
 
@@ -826,6 +1018,7 @@ void cChunk::TickBlocks(void)
 	
 	cChunkInterface ChunkInterface(this->GetWorld()->GetChunkMap());
 	cBlockInServerPluginInterface PluginInterface(*this->GetWorld());
+	bool IsParallel = m_ChunkMap->IsTickingInParallel();
 
 	// This for loop looks disgusting, but it actually does a simple thing - first processes m_BlockTick, then adds random to it
 	// This is so that SetNextBlockTick() works
@@ -850,6 +1043,12 @@ void cChunk::TickBlocks(void)
 
 		cBlockHandler * Handler = BlockHandler(GetBlock(m_BlockTickX, m_BlockTickY, m_BlockTickZ));
 		ASSERT(Handler != nullptr);  // Happenned on server restart, FS #243
+		if (IsParallel && Handler->DoesUpdateCallPluginHooks())
+		{
+			// The plugins may access any chunk, tick this block from TickShared() in the tick thread:
+			m_DeferredTickBlocks.push_back(Vector3i(m_BlockTickX, m_BlockTickY, m_BlockTickZ));
+			continue;
+		}
 		Handler->OnUpdate(ChunkInterface, *this->GetWorld(), PluginInterface, *this, m_BlockTickX, m_BlockTickY, m_BlockTickZ);
 	}  // for i - tickblocks
 }
@@ -1485,6 +1684,9 @@ void cChunk::SetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType,
 		case E_BLOCK_MOB_SPAWNER:
 		{
 			AddBlockEntity(cBlockEntity::CreateByBlockType(a_BlockType, a_BlockMeta, WorldPos.x, WorldPos.y, WorldPos.z, m_World));
+
+			// A new container may give the sleeping hoppers around a place to move items from or to:
+			m_World->WakeUpHoppersAround(WorldPos.x, WorldPos.y, WorldPos.z);
 			break;
 		}
 	}  // switch (a_BlockType)
@@ -1562,9 +1764,11 @@ void cChunk::FastSetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockT
 	}
 
 	MarkDirty();
+	MarkDataChanged();
 	m_IsRedstoneDirty = true;
 
 	m_ChunkData.SetBlock(a_RelX, a_RelY, a_RelZ, a_BlockType);
+	WakeBlockEntitiesAround(a_RelX, a_RelY, a_RelZ);
 
 	// Queue block to be sent only if ...
 	if (
@@ -1584,18 +1788,10 @@ void cChunk::FastSetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockT
 	}
 	
 	m_ChunkData.SetMeta(a_RelX, a_RelY, a_RelZ, a_BlockMeta);
-
-	// ONLY recalculate lighting if it's necessary!
-	if (
-		(cBlockInfo::GetLightValue        (OldBlockType) != cBlockInfo::GetLightValue        (a_BlockType)) ||
-		(cBlockInfo::GetSpreadLightFalloff(OldBlockType) != cBlockInfo::GetSpreadLightFalloff(a_BlockType)) ||
-		(cBlockInfo::IsTransparent        (OldBlockType) != cBlockInfo::IsTransparent        (a_BlockType))
-	)
-	{
-		m_IsLightValid = false;
-	}
+	JournalBlockChange(a_RelX, a_RelY, a_RelZ, a_BlockType, a_BlockMeta);
 
 	// Update heightmap, if needed:
+	int OldHeight = m_HeightMap[a_RelX + a_RelZ * Width];
 	if (a_RelY >= m_HeightMap[a_RelX + a_RelZ * Width])
 	{
 		if (a_BlockType != E_BLOCK_AIR)
@@ -1614,6 +1810,27 @@ void cChunk::FastSetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockT
 			}  // for y - column in m_BlockData
 		}
 	}
+
+	// ONLY recalculate lighting if it's necessary!
+	if (
+		(cBlockInfo::GetLightValue        (OldBlockType) != cBlockInfo::GetLightValue        (a_BlockType)) ||
+		(cBlockInfo::GetSpreadLightFalloff(OldBlockType) != cBlockInfo::GetSpreadLightFalloff(a_BlockType)) ||
+		(cBlockInfo::IsTransparent        (OldBlockType) != cBlockInfo::IsTransparent        (a_BlockType)) ||
+		(OldHeight != m_HeightMap[a_RelX + a_RelZ * Width])
+	)
+	{
+		if (m_IsLightValid)
+		{
+			// Update only the light around the changed block, instead of re-lighting the whole chunk:
+			cLightUpdater LightUpdater(*this);
+			LightUpdater.BlockChanged(a_RelX, a_RelY, a_RelZ, OldHeight);
+			if (LightUpdater.HasReachedUnlitChunk())
+			{
+				// The light couldn't spread through a neighbor that isn't lighted yet, light the whole chunk later on:
+				m_IsLightValid = false;
+			}
+		}
+	}
 }
 
 
@@ -1657,6 +1874,84 @@ void cChunk::AddBlockEntity(cBlockEntity * a_BlockEntity)
 
 
 
+void cChunk::WakeBlockEntitiesAround(int a_RelX, int a_RelY, int a_RelZ)
+{
+	static const struct
+	{
+		int x, y, z;
+	} Coords[] =
+	{
+		{ 0,  0,  0},
+		{-1,  0,  0},
+		{ 1,  0,  0},
+		{ 0, -1,  0},
+		{ 0,  1,  0},
+		{ 0,  0, -1},
+		{ 0,  0,  1},
+	} ;
+	for (size_t i = 0; i < ARRAYCOUNT(Coords); i++)
+	{
+		int RelX = a_RelX + Coords[i].x;
+		int RelY = a_RelY + Coords[i].y;
+		int RelZ = a_RelZ + Coords[i].z;
+		if ((RelY < 0) || (RelY >= Height))
+		{
+			continue;
+		}
+		if ((RelX >= 0) && (RelX < Width) && (RelZ >= 0) && (RelZ < Width))
+		{
+			if (!m_AreBlockEntitiesWoken && !m_BlockEntities.empty())
+			{
+				WakeBlockEntityAt(RelX, RelY, RelZ);
+			}
+			continue;
+		}
+
+		// The block is across the chunk border, forward the wake-up to the neighbor, so that a dispenser or dropper there reacts right away:
+		cChunk * Neighbor = GetRelNeighborChunkAdjustCoords(RelX, RelZ);
+		if ((Neighbor != nullptr) && Neighbor->IsValid())
+		{
+			Neighbor->WakeBlockEntityAt(RelX, RelY, RelZ);
+		}
+	}
+}
+
+
+
+
+
+void cChunk::WakeBlockEntityAt(int a_RelX, int a_RelY, int a_RelZ)
+{
+	if (!m_AreBlockEntitiesWoken && cBlockEntity::IsTickedBlockType(GetBlock(a_RelX, a_RelY, a_RelZ)))
+	{
+		m_AreBlockEntitiesWoken = true;
+	}
+}
+
+
+
+
+
+void cChunk::WakeUpHoppers(int a_MinBlockX, int a_MaxBlockX, int a_MinBlockY, int a_MaxBlockY, int a_MinBlockZ, int a_MaxBlockZ)
+{
+	for (cBlockEntityList::iterator itr = m_BlockEntities.begin(); itr != m_BlockEntities.end(); ++itr)
+	{
+		if (
+			((*itr)->GetBlockType() == E_BLOCK_HOPPER) &&
+			((*itr)->GetPosX() >= a_MinBlockX) && ((*itr)->GetPosX() <= a_MaxBlockX) &&
+			((*itr)->GetPosY() >= a_MinBlockY) && ((*itr)->GetPosY() <= a_MaxBlockY) &&
+			((*itr)->GetPosZ() >= a_MinBlockZ) && ((*itr)->GetPosZ() <= a_MaxBlockZ)
+		)
+		{
+			static_cast<cHopperEntity *>(*itr)->WakeUp();
+		}
+	}
+}
+
+
+
+
+
 cBlockEntity * cChunk::GetBlockEntity(int a_BlockX, int a_BlockY, int a_BlockZ)
 {
 	// Check that the query coords are within chunk bounds:
@@ -1726,6 +2021,7 @@ void cChunk::SetBiomeAt(int a_RelX, int a_RelZ, EMCSBiome a_Biome)
 {
 	cChunkDef::SetBiome(m_BiomeMap, a_RelX, a_RelZ, a_Biome);
 	MarkDirty();
+	MarkDataChanged();
 }
 
 
@@ -1742,6 +2038,7 @@ void cChunk::SetAreaBiome(int a_MinRelX, int a_MaxRelX, int a_MinRelZ, int a_Max
 		}
 	}
 	MarkDirty();
+	MarkDataChanged();
 	
 	// Re-send the chunk to all clients:
 	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
@@ -1756,46 +2053,55 @@ void cChunk::SetAreaBiome(int a_MinRelX, int a_MaxRelX, int a_MinRelZ, int a_Max
 
 void cChunk::CollectPickupsByPlayer(cPlayer & a_Player)
 {
-	double PosX = a_Player.GetPosX();
-	double PosY = a_Player.GetPosY();
-	double PosZ = a_Player.GetPosZ();
-	
-	for (cEntityList::iterator itr = m_Entities.begin(); itr != m_Entities.end(); ++itr)
+	class cCollector :
+		public cEntityCallback
 	{
-		if ((!(*itr)->IsPickup()) && (!(*itr)->IsProjectile()))
-		{
-			continue;  // Only pickups and projectiles can be picked up
-		}
-		float DiffX = (float)((*itr)->GetPosX() - PosX);
-		float DiffY = (float)((*itr)->GetPosY() - PosY);
-		float DiffZ = (float)((*itr)->GetPosZ() - PosZ);
-		float SqrDist = DiffX * DiffX + DiffY * DiffY + DiffZ * DiffZ;
-		if (SqrDist < 1.5f * 1.5f)  // 1.5 block
+		cChunk & m_Chunk;
+		cPlayer & m_Player;
+		Vector3d m_Pos;
+
+		virtual bool Item(cEntity * a_Entity) override
 		{
-			/*
-			LOG("Pickup %d being collected by player \"%s\", distance %f",
-				(*itr)->GetUniqueID(), a_Player->GetName().c_str(), SqrDist
-			);
-			*/
-			MarkDirty();
-			if ((*itr)->IsPickup())
+			if ((!a_Entity->IsPickup()) && (!a_Entity->IsProjectile()))
 			{
-				(reinterpret_cast<cPickup *>(*itr))->CollectedBy(a_Player);
+				return false;  // Only pickups and projectiles can be picked up
 			}
-			else
+			float DiffX = (float)(a_Entity->GetPosX() - m_Pos.x);
+			float DiffY = (float)(a_Entity->GetPosY() - m_Pos.y);
+			float DiffZ = (float)(a_Entity->GetPosZ() - m_Pos.z);
+			float SqrDist = DiffX * DiffX + DiffY * DiffY + DiffZ * DiffZ;
+			if (SqrDist < 1.5f * 1.5f)  // 1.5 block
 			{
-				(reinterpret_cast<cProjectileEntity *>(*itr))->CollectedBy(a_Player);
+				/*
+				LOG("Pickup %d being collected by player \"%s\", distance %f",
+					a_Entity->GetUniqueID(), m_Player.GetName().c_str(), SqrDist
+				);
+				*/
+				m_Chunk.MarkDirty();
+				if (a_Entity->IsPickup())
+				{
+					(reinterpret_cast<cPickup *>(a_Entity))->CollectedBy(m_Player);
+				}
+				else
+				{
+					(reinterpret_cast<cProjectileEntity *>(a_Entity))->CollectedBy(m_Player);
+				}
 			}
+			return false;
 		}
-		else if (SqrDist < 5 * 5)
+
+	public:
+		cCollector(cChunk & a_Chunk, cPlayer & a_Player) :
+			m_Chunk(a_Chunk),
+			m_Player(a_Player),
+			m_Pos(a_Player.GetPosition())
 		{
-			/*
-			LOG("Pickup %d close to player \"%s\", but still too far to collect: %f",
-				(*itr)->GetUniqueID(), a_Player->GetName().c_str(), SqrDist
-			);
-			*/
 		}
-	}
+	} Collector(*this, a_Player);
+
+	// Only the entities near the player's height need checking:
+	double PosY = a_Player.GetPosY();
+	m_EntityIndex.ForEachInYRange(PosY - 1.5, PosY + 1.5, Collector);
 }
 
 
@@ -1939,6 +2245,7 @@ void cChunk::AddEntity(cEntity * a_Entity)
 	ASSERT(std::find(m_Entities.begin(), m_Entities.end(), a_Entity) == m_Entities.end());  // Not there already
 
 	m_Entities.push_back(a_Entity);
+	m_EntityIndex.Add(a_Entity);
 }
 
 
@@ -1948,6 +2255,7 @@ void cChunk::AddEntity(cEntity * a_Entity)
 void cChunk::RemoveEntity(cEntity * a_Entity)
 {
 	m_Entities.remove(a_Entity);
+	m_EntityIndex.Remove(a_Entity);
 
 	// Mark as dirty if it was a server-generated entity:
 	if (!a_Entity->IsPlayer())
@@ -1996,22 +2304,34 @@ bool cChunk::ForEachEntity(cEntityCallback & a_Callback)
 
 bool cChunk::ForEachEntityInBox(const cBoundingBox & a_Box, cEntityCallback & a_Callback)
 {
-	// The entity list is locked by the parent chunkmap's CS
-	for (cEntityList::iterator itr = m_Entities.begin(), itr2 = itr; itr != m_Entities.end(); itr = itr2)
+	// Filters the entities reported by the index to those that really intersect the box:
+	class cBoxFilter :
+		public cEntityCallback
 	{
-		++itr2;
-		cBoundingBox EntBox((*itr)->GetPosition(), (*itr)->GetWidth() / 2, (*itr)->GetHeight());
-		if (!EntBox.DoesIntersect(a_Box))
+		const cBoundingBox & m_Box;
+		cEntityCallback & m_Callback;
+
+		virtual bool Item(cEntity * a_Entity) override
 		{
-			// The entity is not in the specified box
-			continue;
+			cBoundingBox EntBox(a_Entity->GetPosition(), a_Entity->GetWidth() / 2, a_Entity->GetHeight());
+			if (!EntBox.DoesIntersect(m_Box))
+			{
+				// The entity is not in the specified box
+				return false;
+			}
+			return m_Callback.Item(a_Entity);
 		}
-		if (a_Callback.Item(*itr))
+
+	public:
+		cBoxFilter(const cBoundingBox & a_Box, cEntityCallback & a_Callback) :
+			m_Box(a_Box),
+			m_Callback(a_Callback)
 		{
-			return false;
 		}
-	}  // for itr - m_Entitites[]
-	return true;
+	} Filter(a_Box, a_Callback);
+
+	// The entity list is locked by the parent chunkmap's CS
+	return m_EntityIndex.ForEachInYRange(a_Box.GetMinY(), a_Box.GetMaxY(), Filter);
 }
 
 
@@ -2777,6 +3097,26 @@ cChunk * cChunk::GetRelNeighborChunkAdjustCoords(int & a_RelX, int & a_RelZ) con
 
 
 
+template <class SendFn>
+void cChunk::BroadcastPacket(const cClientHandle * a_Exclude, SendFn a_Send, const cEntity * a_MovedEntity)
+{
+	cProtocol::cPacketSerializerFn<SendFn> Serializer(a_Send);
+	cProtocol::cBroadcastCache Cache;
+	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
+	{
+		if (*itr == a_Exclude)
+		{
+			continue;
+		}
+		ASSERT((a_MovedEntity == nullptr) || (a_MovedEntity->GetUniqueID() != (*itr)->GetPlayer()->GetUniqueID()));  // Must not send for self
+		(*itr)->SendBroadcastPacket(Cache, Serializer);
+	}  // for itr - LoadedByClient[]
+}
+
+
+
+
+
 void cChunk::BroadcastAttachEntity(const cEntity & a_Entity, const cEntity * a_Vehicle)
 {
 	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
@@ -2791,14 +3131,11 @@ void cChunk::BroadcastAttachEntity(const cEntity & a_Entity, const cEntity * a_V
 
 void cChunk::BroadcastBlockAction(int a_BlockX, int a_BlockY, int a_BlockZ, char a_Byte1, char a_Byte2, BLOCKTYPE a_BlockType, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendBlockAction(a_BlockX, a_BlockY, a_BlockZ, a_Byte1, a_Byte2, a_BlockType);
 		}
-		(*itr)->SendBlockAction(a_BlockX, a_BlockY, a_BlockZ, a_Byte1, a_Byte2, a_BlockType);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2807,14 +3144,11 @@ void cChunk::BroadcastBlockAction(int a_BlockX, int a_BlockY, int a_BlockZ, char
 
 void cChunk::BroadcastBlockBreakAnimation(int a_entityID, int a_blockX, int a_blockY, int a_blockZ, char a_stage, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendBlockBreakAnim(a_entityID, a_blockX, a_blockY, a_blockZ, a_stage);
 		}
-		(*itr)->SendBlockBreakAnim(a_entityID, a_blockX, a_blockY, a_blockZ, a_stage);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2861,14 +3195,11 @@ void cChunk::BroadcastChunkData(cChunkDataSerializer & a_Serializer, const cClie
 
 void cChunk::BroadcastCollectEntity(const cEntity & a_Entity, const cPlayer & a_Player, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendCollectEntity(a_Entity, a_Player);
 		}
-		(*itr)->SendCollectEntity(a_Entity, a_Player);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2877,14 +3208,11 @@ void cChunk::BroadcastCollectEntity(const cEntity & a_Entity, const cPlayer & a_
 
 void cChunk::BroadcastDestroyEntity(const cEntity & a_Entity, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendDestroyEntity(a_Entity);
 		}
-		(*itr)->SendDestroyEntity(a_Entity);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2893,14 +3221,11 @@ void cChunk::BroadcastDestroyEntity(const cEntity & a_Entity, const cClientHandl
 
 void cChunk::BroadcastEntityEffect(const cEntity & a_Entity, int a_EffectID, int a_Amplifier, short a_Duration, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityEffect(a_Entity, a_EffectID, a_Amplifier, a_Duration);
 		}
-		(*itr)->SendEntityEffect(a_Entity, a_EffectID, a_Amplifier, a_Duration);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2909,14 +3234,11 @@ void cChunk::BroadcastEntityEffect(const cEntity & a_Entity, int a_EffectID, int
 
 void cChunk::BroadcastEntityEquipment(const cEntity & a_Entity, short a_SlotNum, const cItem & a_Item, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityEquipment(a_Entity, a_SlotNum, a_Item);
 		}
-		(*itr)->SendEntityEquipment(a_Entity, a_SlotNum, a_Item);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2925,14 +3247,12 @@ void cChunk::BroadcastEntityEquipment(const cEntity & a_Entity, short a_SlotNum,
 
 void cChunk::BroadcastEntityHeadLook(const cEntity & a_Entity, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
-		}
-		(*itr)->SendEntityHeadLook(a_Entity);
-	}  // for itr - LoadedByClient[]
+			a_Protocol.SendEntityHeadLook(a_Entity);
+		},
+		&a_Entity
+	);
 }
 
 
@@ -2941,14 +3261,12 @@ void cChunk::BroadcastEntityHeadLook(const cEntity & a_Entity, const cClientHand
 
 void cChunk::BroadcastEntityLook(const cEntity & a_Entity, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
-		}
-		(*itr)->SendEntityLook(a_Entity);
-	}  // for itr - LoadedByClient[]
+			a_Protocol.SendEntityLook(a_Entity);
+		},
+		&a_Entity
+	);
 }
 
 
@@ -2957,14 +3275,11 @@ void cChunk::BroadcastEntityLook(const cEntity & a_Entity, const cClientHandle *
 
 void cChunk::BroadcastEntityMetadata(const cEntity & a_Entity, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityMetadata(a_Entity);
 		}
-		(*itr)->SendEntityMetadata(a_Entity);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -2973,14 +3288,12 @@ void cChunk::BroadcastEntityMetadata(const cEntity & a_Entity, const cClientHand
 
 void cChunk::BroadcastEntityRelMove(const cEntity & a_Entity, char a_RelX, char a_RelY, char a_RelZ, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
-		}
-		(*itr)->SendEntityRelMove(a_Entity, a_RelX, a_RelY, a_RelZ);
-	}  // for itr - LoadedByClient[]
+			a_Protocol.SendEntityRelMove(a_Entity, a_RelX, a_RelY, a_RelZ);
+		},
+		&a_Entity
+	);
 }
 
 
@@ -2989,14 +3302,12 @@ void cChunk::BroadcastEntityRelMove(const cEntity & a_Entity, char a_RelX, char
 
 void cChunk::BroadcastEntityRelMoveLook(const cEntity & a_Entity, char a_RelX, char a_RelY, char a_RelZ, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
-		}
-		(*itr)->SendEntityRelMoveLook(a_Entity, a_RelX, a_RelY, a_RelZ);
-	}  // for itr - LoadedByClient[]
+			a_Protocol.SendEntityRelMoveLook(a_Entity, a_RelX, a_RelY, a_RelZ);
+		},
+		&a_Entity
+	);
 }
 
 
@@ -3005,14 +3316,11 @@ void cChunk::BroadcastEntityRelMoveLook(const cEntity & a_Entity, char a_RelX, c
 
 void cChunk::BroadcastEntityStatus(const cEntity & a_Entity, char a_Status, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityStatus(a_Entity, a_Status);
 		}
-		(*itr)->SendEntityStatus(a_Entity, a_Status);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3021,14 +3329,11 @@ void cChunk::BroadcastEntityStatus(const cEntity & a_Entity, char a_Status, cons
 
 void cChunk::BroadcastEntityVelocity(const cEntity & a_Entity, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityVelocity(a_Entity);
 		}
-		(*itr)->SendEntityVelocity(a_Entity);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3037,14 +3342,11 @@ void cChunk::BroadcastEntityVelocity(const cEntity & a_Entity, const cClientHand
 
 void cChunk::BroadcastEntityAnimation(const cEntity & a_Entity, char a_Animation, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::const_iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendEntityAnimation(a_Entity, a_Animation);
 		}
-		(*itr)->SendEntityAnimation(a_Entity, a_Animation);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3053,14 +3355,11 @@ void cChunk::BroadcastEntityAnimation(const cEntity & a_Entity, char a_Animation
 
 void cChunk::BroadcastParticleEffect(const AString & a_ParticleName, float a_SrcX, float a_SrcY, float a_SrcZ, float a_OffsetX, float a_OffsetY, float a_OffsetZ, float a_ParticleData, int a_ParticleAmount, cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendParticleEffect(a_ParticleName, a_SrcX, a_SrcY, a_SrcZ, a_OffsetX, a_OffsetY, a_OffsetZ, a_ParticleData, a_ParticleAmount);
 		}
-		(*itr)->SendParticleEffect(a_ParticleName, a_SrcX, a_SrcY, a_SrcZ, a_OffsetX, a_OffsetY, a_OffsetZ, a_ParticleData, a_ParticleAmount);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3069,14 +3368,11 @@ void cChunk::BroadcastParticleEffect(const AString & a_ParticleName, float a_Src
 
 void cChunk::BroadcastRemoveEntityEffect(const cEntity & a_Entity, int a_EffectID, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendRemoveEntityEffect(a_Entity, a_EffectID);
 		}
-		(*itr)->SendRemoveEntityEffect(a_Entity, a_EffectID);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3085,14 +3381,11 @@ void cChunk::BroadcastRemoveEntityEffect(const cEntity & a_Entity, int a_EffectI
 
 void cChunk::BroadcastSoundEffect(const AString & a_SoundName, double a_X, double a_Y, double a_Z, float a_Volume, float a_Pitch, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendSoundEffect(a_SoundName, a_X, a_Y, a_Z, a_Volume, a_Pitch);
 		}
-		(*itr)->SendSoundEffect(a_SoundName, a_X, a_Y, a_Z, a_Volume, a_Pitch);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3101,14 +3394,11 @@ void cChunk::BroadcastSoundEffect(const AString & a_SoundName, double a_X, doubl
 
 void cChunk::BroadcastSoundParticleEffect(int a_EffectID, int a_SrcX, int a_SrcY, int a_SrcZ, int a_Data, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendSoundParticleEffect(a_EffectID, a_SrcX, a_SrcY, a_SrcZ, a_Data);
 		}
-		(*itr)->SendSoundParticleEffect(a_EffectID, a_SrcX, a_SrcY, a_SrcZ, a_Data);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
@@ -3133,14 +3423,11 @@ void cChunk::BroadcastSpawnEntity(cEntity & a_Entity, const cClientHandle * a_Ex
 
 void cChunk::BroadcastThunderbolt(int a_BlockX, int a_BlockY, int a_BlockZ, const cClientHandle * a_Exclude)
 {
-	for (cClientHandleList::iterator itr = m_LoadedByClient.begin(); itr != m_LoadedByClient.end(); ++itr)
-	{
-		if (*itr == a_Exclude)
+	BroadcastPacket(a_Exclude, [&](cProtocol & a_Protocol)
 		{
-			continue;
+			a_Protocol.SendThunderbolt(a_BlockX, a_BlockY, a_BlockZ);
 		}
-		(*itr)->SendThunderbolt(a_BlockX, a_BlockY, a_BlockZ);
-	}  // for itr - LoadedByClient[]
+	);
 }
 
 
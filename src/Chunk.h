@@ -4,6 +4,7 @@
 #include "Entities/Entity.h"
 #include "ChunkDef.h"
 #include "ChunkData.h"
+#include "ChunkEntityIndex.h"
 
 #include "Simulator/FireSimulator.h"
 #include "Simulator/SandSimulator.h"
@@ -12,6 +13,7 @@
 #include "Blocks/GetHandlerCompileTimeTemplate.h"
 
 #include "ChunkMap.h"
+#include "WorldStorage/ChunkJournal.h"
 
 
 
@@ -105,6 +107,10 @@ public:
 	/** Marks all clients attached to this chunk as wanting this chunk. Also sets presence to cpQueued. */
 	void MarkRegenerating(void);
 
+	/** Marks the chunk as requested by a plugin (TouchChunk(), GenerateChunk(), RegenerateChunk()), so that its queued
+	load / generate request is kept even if no player wants the chunk. Reset once the chunk is present or no longer queued. */
+	void MarkExplicitlyRequested(void) { m_IsExplicitlyRequested = true; }
+
 	/** Returns true iff the chunk has changed since it was last saved. */
 	bool IsDirty(void) const {return m_IsDirty; }
 
@@ -112,6 +118,11 @@ public:
 	
 	bool IsLightValid(void) const {return m_IsLightValid; }
 	
+	/** Returns the version of the chunk's block, light and biome data.
+	The version changes with each modification of the data and is unique across all chunks ever loaded,
+	so it identifies the data for caching purposes (cChunkDataCache). */
+	UInt64 GetDataVersion(void) const { return m_DataVersion; }
+	
 	/*
 	To save a chunk, the WSSchema must:
 	1. Mark the chunk as being saved (MarkSaving())
@@ -126,6 +137,10 @@ public:
 	/** Marks the chunk as failed to load.
 	If m_ShouldGenerateIfLoadFailed is set, queues the chunk for generating. */
 	void MarkLoadFailed(void);
+
+	/** If the chunk is queued, but neither a client nor a ChunkStay wants it, marks it as invalid and returns true.
+	The caller then drops the chunk's load / generate request; the chunk will be queued again when it is needed. */
+	bool TryUnqueueUnwanted(void);
 	
 	/** Gets all chunk data, calls the a_Callback's methods for each data type */
 	void GetAllData(cChunkDataCallback & a_Callback);
@@ -135,6 +150,10 @@ public:
 	Modifies the BlockEntity list in a_SetChunkData - moves the block entities into the chunk. */
 	void SetAllData(cSetChunkData & a_SetChunkData);
 	
+	/** Re-applies the block changes restored from the world's journal after a crash, to be called right after SetAllData().
+	The changes are not journaled again, they are still in the journal until the chunk is saved. */
+	void ReplayJournal(const cChunkJournal::cBlockChanges & a_Changes);
+	
 	void SetLight(
 		const cChunkDef::BlockNibbles & a_BlockLight,
 		const cChunkDef::BlockNibbles & a_SkyLight
@@ -161,6 +180,18 @@ public:
 	void SpawnMobs(cMobSpawner& a_MobSpawner);
 
 	void Tick(float a_Dt);
+
+	/** Ticks the parts of the chunk whose effects stay within the chunk's close neighborhood:
+	pending block changes, queued block sets, block checks, random block ticks and weather.
+	The chunkmap may run these for chunks far enough apart in parallel, see cChunkMap::Tick().
+	When ticked in parallel, the block checks and the random ticks that may call the plugin hooks are deferred to TickShared(),
+	because the plugins may access any chunk, including those being ticked by the other threads. */
+	void TickLocal(float a_Dt);
+
+	/** Ticks the parts of the chunk that may touch state shared across the whole world:
+	simulators, block entities and entities. These always run in the tick thread, with no TickLocal() running.
+	Both in the serial and the parallel ticking, the simulators thus run after TickLocal()'s random block ticks. */
+	void TickShared(float a_Dt);
 	
 	/** Ticks a single block. Used by cWorld::TickQueuedBlocks() to tick the queued blocks */
 	void TickBlock(int a_RelX, int a_RelY, int a_RelZ);
@@ -356,6 +387,12 @@ public:
 		m_IsSaving = false;
 	}
 	
+	/** Assigns a new data version to the chunk, to be called whenever its block, light or biome data changes. */
+	inline void MarkDataChanged(void)
+	{
+		m_DataVersion = ++s_DataVersionCounter;
+	}
+	
 	/** Sets the blockticking to start at the specified block. Only one blocktick may be set, second call overwrites the first call */
 	inline void SetNextBlockTick(int a_RelX, int a_RelY, int a_RelZ)
 	{
@@ -374,7 +411,10 @@ public:
 			if (hasChanged)
 			{
 				MarkDirty();
+				MarkDataChanged();
 				m_IsRedstoneDirty = true;
+				WakeBlockEntitiesAround(a_RelX, a_RelY, a_RelZ);
+				JournalBlockChange(a_RelX, a_RelY, a_RelZ, GetBlock(a_RelX, a_RelY, a_RelZ), a_Meta);
 				
 				m_PendingSendBlocks.push_back(sSetBlock(m_PosX, m_PosZ, a_RelX, a_RelY, a_RelZ, GetBlock(a_RelX, a_RelY, a_RelZ), a_Meta));
 			}
@@ -382,6 +422,24 @@ public:
 
 	inline NIBBLETYPE GetBlockLight(int a_RelX, int a_RelY, int a_RelZ) const {return m_ChunkData.GetBlockLight(a_RelX, a_RelY, a_RelZ); }
 	inline NIBBLETYPE GetSkyLight  (int a_RelX, int a_RelY, int a_RelZ) const {return m_ChunkData.GetSkyLight(a_RelX, a_RelY, a_RelZ); }
+
+	/** Sets the blocklight / skylight of a single block, used by cLightUpdater. Marks the chunk dirty if the value changes. */
+	inline void SetBlockLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_BlockLight)
+	{
+		if (m_ChunkData.SetBlockLight(a_RelX, a_RelY, a_RelZ, a_BlockLight))
+		{
+			MarkDirty();
+			MarkDataChanged();
+		}
+	}
+	inline void SetSkyLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_SkyLight)
+	{
+		if (m_ChunkData.SetSkyLight(a_RelX, a_RelY, a_RelZ, a_SkyLight))
+		{
+			MarkDirty();
+			MarkDataChanged();
+		}
+	}
 	
 	/** Same as GetBlock(), but relative coords needn't be in this chunk (uses m_Neighbor-s or m_ChunkMap in such a case); returns true on success */
 	bool UnboundedRelGetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE & a_BlockType, NIBBLETYPE & a_BlockMeta) const;
@@ -427,6 +485,9 @@ public:
 
 	cBlockEntity * GetBlockEntity(int a_BlockX, int a_BlockY, int a_BlockZ);
 	cBlockEntity * GetBlockEntity(const Vector3i & a_BlockPos) { return GetBlockEntity(a_BlockPos.x, a_BlockPos.y, a_BlockPos.z); }
+
+	/** Wakes up the hoppers of this chunk within the specified area of blocks (absolute coords), so that they try moving items again. */
+	void WakeUpHoppers(int a_MinBlockX, int a_MaxBlockX, int a_MinBlockY, int a_MaxBlockY, int a_MinBlockZ, int a_MaxBlockZ);
 	
 	/** Returns true if the chunk should be ticked in the tick-thread.
 	Checks if there are any clients and if the always-tick flag is set */
@@ -466,12 +527,31 @@ private:
 	/** If the chunk fails to load, should it be queued in the generator or reset back to invalid? */
 	bool m_ShouldGenerateIfLoadFailed;
 
+	/** Set by MarkExplicitlyRequested(); TryUnqueueUnwanted() doesn't drop the chunk's queued request while set. */
+	bool m_IsExplicitlyRequested;
+
 	bool m_IsLightValid;   // True if the blocklight and skylight are calculated
 	bool m_IsDirty;        // True if the chunk has changed since it was last saved
 	bool m_IsSaving;       // True if the chunk is being saved
 	bool m_HasLoadFailed;  // True if chunk failed to load and hasn't been generated yet since then
 	
+	/** Set while ReplayJournal() is applying the changes, so that they aren't journaled again. */
+	bool m_IsReplayingJournal;
+	
+	/** The version of the block, light and biome data, see GetDataVersion(). */
+	UInt64 m_DataVersion;
+	
+	/** The source of the unique data versions for all the chunks. */
+	static std::atomic<UInt64> s_DataVersionCounter;
+	
 	std::vector<Vector3i> m_ToTickBlocks;
+
+	/** The block checks and random block ticks that a parallel TickLocal() deferred to TickShared(), because they may call the plugin hooks. */
+	std::vector<Vector3i> m_DeferredCheckBlocks;
+	std::vector<Vector3i> m_DeferredTickBlocks;
+
+	/** The blocks set by ProcessQueuedSetBlocks(), to wake the redstone simulator up for in TickShared(), see ProcessDeferredBlocks(). */
+	std::vector<Vector3i> m_QueuedSetBlocksDone;
 	sSetBlockVector       m_PendingSendBlocks;  ///< Blocks that have changed and need to be sent to all clients
 	
 	sSetBlockQueueVector m_SetBlockQueue;  ///< Block changes that are queued to a specific tick
@@ -480,6 +560,9 @@ private:
 	cClientHandleList  m_LoadedByClient;
 	cEntityList        m_Entities;
 	cBlockEntityList   m_BlockEntities;
+
+	/** Spatial index of m_Entities, used for the box and radius queries. */
+	cChunkEntityIndex  m_EntityIndex;
 	
 	/** Number of times the chunk has been requested to stay (by various cChunkStay objects); if zero, the chunk can be unloaded */
 	int m_StayCount;
@@ -516,6 +599,13 @@ private:
 	Manipulated by the SetAlwaysTicked() function, allows for nested calls of the function.
 	This is the support for plugin-accessible chunk tick forcing. */
 	int m_AlwaysTicked;
+
+	/** The number of ticks in which the block entities were not ticked, because the chunk was out of the players' activation range. */
+	int m_NumSkippedBlockEntityTicks;
+
+	/** Set when a block next to a ticked block entity changes, so that the block entities are ticked in the next tick
+	even if the chunk is out of the players' activation range. Atomic, because the neighbor chunks set it, too. */
+	std::atomic<bool> m_AreBlockEntitiesWoken;
 	
 
 	// Pick up a random block of this chunk
@@ -525,6 +615,13 @@ private:
 	void RemoveBlockEntity(cBlockEntity * a_BlockEntity);
 	void AddBlockEntity   (cBlockEntity * a_BlockEntity);
 
+	/** Wakes the block entities of this chunk or of the neighbor chunks, if the specified block or any of its neighbors has a ticked block entity. */
+	void WakeBlockEntitiesAround(int a_RelX, int a_RelY, int a_RelZ);
+
+	/** Sets m_AreBlockEntitiesWoken if the specified block of this chunk has a ticked block entity.
+	May be called from the neighbor chunks' tick threads, hence the atomic flag. */
+	void WakeBlockEntityAt(int a_RelX, int a_RelY, int a_RelZ);
+
 	/** Creates a block entity for each block that needs a block entity and doesn't have one in the list */
 	void CreateBlockEntities(void);
 	
@@ -537,8 +634,21 @@ private:
 	/** Sends m_PendingSendBlocks to all clients */
 	void BroadcastPendingBlockChanges(void);
 	
+	/** Sends a packet to all clients of this chunk except a_Exclude.
+	The packet is serialized by calling a_Send(cProtocol &), only once for each protocol version, and the serialized data is shared among the clients.
+	a_MovedEntity is the entity whose movement the packet describes, if any; clients must not be sent their own player's movement. */
+	template <class SendFn>
+	void BroadcastPacket(const cClientHandle * a_Exclude, SendFn a_Send, const cEntity * a_MovedEntity = nullptr);
+	
 	/** Checks the block scheduled for checking in m_ToTickBlocks[] */
 	void CheckBlocks();
+
+	/** Checks the specified blocks */
+	void CheckBlocks(const std::vector<Vector3i> & a_Blocks);
+
+	/** Runs the block checks and random block ticks deferred by a parallel TickLocal(),
+	and wakes the redstone simulator up for the queued blocks set by TickLocal(), if it needs that. */
+	void ProcessDeferredBlocks(void);
 	
 	/** Ticks several random blocks in the chunk */
 	void TickBlocks(void);
@@ -560,6 +670,9 @@ private:
 	
 	/** Processes all blocks that have been scheduled for replacement by the QueueSetBlock() function */
 	void ProcessQueuedSetBlocks(void);
+	
+	/** Writes the block change into the world's journal, unless replaying the journal. */
+	void JournalBlockChange(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta);
 };
 
 typedef cChunk * cChunkPtr;
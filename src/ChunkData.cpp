@@ -157,7 +157,7 @@ BLOCKTYPE cChunkData::GetBlock(int a_X, int a_Y, int a_Z) const
 	if (m_Sections[Section] != nullptr)
 	{
 		int Index = cChunkDef::MakeIndexNoCheck(a_X, a_Y - (Section * SectionHeight), a_Z);
-		return m_Sections[Section]->m_BlockTypes[Index];
+		return m_Sections[Section]->m_BlockTypes.Get(static_cast<size_t>(Index));
 	}
 	else
 	{
@@ -182,7 +182,7 @@ void cChunkData::SetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_Block)
 	}
 
 	int Section = a_RelY / SectionHeight;
-	if (m_Sections[Section] == nullptr)
+	if (GetWritableSection(static_cast<size_t>(Section)) == nullptr)
 	{
 		if (a_Block == 0x00)
 		{
@@ -197,7 +197,7 @@ void cChunkData::SetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_Block)
 		ZeroSection(m_Sections[Section]);
 	}
 	int Index = cChunkDef::MakeIndexNoCheck(a_RelX, a_RelY - (Section * SectionHeight), a_RelZ);
-	m_Sections[Section]->m_BlockTypes[Index] = a_Block;
+	m_Sections[Section]->m_BlockTypes.Set(static_cast<size_t>(Index), a_Block);
 }
 
 
@@ -243,7 +243,7 @@ bool cChunkData::SetMeta(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble
 	}
 
 	int Section = a_RelY / SectionHeight;
-	if (m_Sections[Section] == nullptr)
+	if (GetWritableSection(static_cast<size_t>(Section)) == nullptr)
 	{
 		if ((a_Nibble & 0xf) == 0x00)
 		{
@@ -297,6 +297,46 @@ NIBBLETYPE cChunkData::GetBlockLight(int a_RelX, int a_RelY, int a_RelZ) const
 
 
 
+bool cChunkData::SetBlockLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble)
+{
+	if (
+		(a_RelX >= cChunkDef::Width)  || (a_RelX < 0) ||
+		(a_RelY >= cChunkDef::Height) || (a_RelY < 0) ||
+		(a_RelZ >= cChunkDef::Width)  || (a_RelZ < 0)
+	)
+	{
+		ASSERT(!"cChunkData::SetBlockLight(): index out of range!");
+		return false;
+	}
+
+	int Section = a_RelY / SectionHeight;
+	if (GetWritableSection(static_cast<size_t>(Section)) == nullptr)
+	{
+		if ((a_Nibble & 0xf) == 0x00)
+		{
+			return false;
+		}
+		m_Sections[Section] = Allocate();
+		if (m_Sections[Section] == nullptr)
+		{
+			ASSERT(!"Failed to allocate a new section in Chunkbuffer");
+			return false;
+		}
+		ZeroSection(m_Sections[Section]);
+	}
+	int Index = cChunkDef::MakeIndexNoCheck(a_RelX, a_RelY - (Section * SectionHeight), a_RelZ);
+	NIBBLETYPE oldval = m_Sections[Section]->m_BlockLight[Index / 2] >> ((Index & 1) * 4) & 0xf;
+	m_Sections[Section]->m_BlockLight[Index / 2] = static_cast<NIBBLETYPE>(
+		(m_Sections[Section]->m_BlockLight[Index / 2] & (0xf0 >> ((Index & 1) * 4))) |  // The untouched nibble
+		((a_Nibble & 0x0f) << ((Index & 1) * 4))  // The nibble being set
+	);
+	return oldval != a_Nibble;
+}
+
+
+
+
+
 NIBBLETYPE cChunkData::GetSkyLight(int a_RelX, int a_RelY, int a_RelZ) const
 {
 	if ((a_RelX < cChunkDef::Width) && (a_RelX > -1) && (a_RelY < cChunkDef::Height) && (a_RelY > -1) && (a_RelZ < cChunkDef::Width) && (a_RelZ > -1))
@@ -320,15 +360,56 @@ NIBBLETYPE cChunkData::GetSkyLight(int a_RelX, int a_RelY, int a_RelZ) const
 
 
 
+bool cChunkData::SetSkyLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble)
+{
+	if (
+		(a_RelX >= cChunkDef::Width)  || (a_RelX < 0) ||
+		(a_RelY >= cChunkDef::Height) || (a_RelY < 0) ||
+		(a_RelZ >= cChunkDef::Width)  || (a_RelZ < 0)
+	)
+	{
+		ASSERT(!"cChunkData::SetSkyLight(): index out of range!");
+		return false;
+	}
+
+	int Section = a_RelY / SectionHeight;
+	if (GetWritableSection(static_cast<size_t>(Section)) == nullptr)
+	{
+		if ((a_Nibble & 0xf) == 0x0f)
+		{
+			return false;
+		}
+		m_Sections[Section] = Allocate();
+		if (m_Sections[Section] == nullptr)
+		{
+			ASSERT(!"Failed to allocate a new section in Chunkbuffer");
+			return false;
+		}
+		ZeroSection(m_Sections[Section]);
+	}
+	int Index = cChunkDef::MakeIndexNoCheck(a_RelX, a_RelY - (Section * SectionHeight), a_RelZ);
+	NIBBLETYPE oldval = m_Sections[Section]->m_BlockSkyLight[Index / 2] >> ((Index & 1) * 4) & 0xf;
+	m_Sections[Section]->m_BlockSkyLight[Index / 2] = static_cast<NIBBLETYPE>(
+		(m_Sections[Section]->m_BlockSkyLight[Index / 2] & (0xf0 >> ((Index & 1) * 4))) |  // The untouched nibble
+		((a_Nibble & 0x0f) << ((Index & 1) * 4))  // The nibble being set
+	);
+	return oldval != a_Nibble;
+}
+
+
+
+
+
 cChunkData cChunkData::Copy(void) const
 {
 	cChunkData copy(m_Pool);
 	for (size_t i = 0; i < NumSections; i++)
 	{
+		// Share the section with the copy, it gets duplicated only when one of the sharers writes to it:
 		if (m_Sections[i] != nullptr)
 		{
-			copy.m_Sections[i] = copy.Allocate();
-			*copy.m_Sections[i] = *m_Sections[i];
+			++m_Sections[i]->m_RefCount;
+			copy.m_Sections[i] = m_Sections[i];
 		}
 	}
 	return copy;
@@ -356,8 +437,7 @@ void cChunkData::CopyBlockTypes(BLOCKTYPE * a_Dest, size_t a_Idx, size_t a_Lengt
 			a_Length -= ToCopy;
 			if (m_Sections[i] != nullptr)
 			{
-				BLOCKTYPE * blockbuffer = m_Sections[i]->m_BlockTypes;
-				memcpy(&a_Dest[(i * SectionBlockCount) + StartPos - a_Idx], blockbuffer + StartPos, sizeof(BLOCKTYPE) * ToCopy);
+				m_Sections[i]->m_BlockTypes.CopyTo(&a_Dest[(i * SectionBlockCount) + StartPos - a_Idx], StartPos, ToCopy);
 			}
 			else
 			{
@@ -435,9 +515,9 @@ void cChunkData::SetBlockTypes(const BLOCKTYPE * a_Src)
 	for (size_t i = 0; i < NumSections; i++)
 	{
 		// If the section is already allocated, copy the data into it:
-		if (m_Sections[i] != nullptr)
+		if (GetWritableSection(i) != nullptr)
 		{
-			memcpy(m_Sections[i]->m_BlockTypes, &a_Src[i * SectionBlockCount], sizeof(m_Sections[i]->m_BlockTypes));
+			m_Sections[i]->m_BlockTypes.SetAll(&a_Src[i * SectionBlockCount]);
 			continue;
 		}
 
@@ -450,7 +530,7 @@ void cChunkData::SetBlockTypes(const BLOCKTYPE * a_Src)
 		
 		// Allocate the section and copy the data into it:
 		m_Sections[i] = Allocate();
-		memcpy(m_Sections[i]->m_BlockTypes, &a_Src[i * SectionBlockCount], sizeof(m_Sections[i]->m_BlockTypes));
+		m_Sections[i]->m_BlockTypes.SetAll(&a_Src[i * SectionBlockCount]);
 		memset(m_Sections[i]->m_BlockMetas,    0x00, sizeof(m_Sections[i]->m_BlockMetas));
 		memset(m_Sections[i]->m_BlockLight,    0x00, sizeof(m_Sections[i]->m_BlockLight));
 		memset(m_Sections[i]->m_BlockSkyLight, 0xff, sizeof(m_Sections[i]->m_BlockSkyLight));
@@ -467,7 +547,7 @@ void cChunkData::SetMetas(const NIBBLETYPE * a_Src)
 	for (size_t i = 0; i < NumSections; i++)
 	{
 		// If the section is already allocated, copy the data into it:
-		if (m_Sections[i] != nullptr)
+		if (GetWritableSection(i) != nullptr)
 		{
 			memcpy(m_Sections[i]->m_BlockMetas, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockMetas));
 			continue;
@@ -483,7 +563,7 @@ void cChunkData::SetMetas(const NIBBLETYPE * a_Src)
 		// Allocate the section and copy the data into it:
 		m_Sections[i] = Allocate();
 		memcpy(m_Sections[i]->m_BlockMetas, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockMetas));
-		memset(m_Sections[i]->m_BlockTypes,    0x00, sizeof(m_Sections[i]->m_BlockTypes));
+		m_Sections[i]->m_BlockTypes.Clear();
 		memset(m_Sections[i]->m_BlockLight,    0x00, sizeof(m_Sections[i]->m_BlockLight));
 		memset(m_Sections[i]->m_BlockSkyLight, 0xff, sizeof(m_Sections[i]->m_BlockSkyLight));
 	}  // for i - m_Sections[]
@@ -503,7 +583,7 @@ void cChunkData::SetBlockLight(const NIBBLETYPE * a_Src)
 	for (size_t i = 0; i < NumSections; i++)
 	{
 		// If the section is already allocated, copy the data into it:
-		if (m_Sections[i] != nullptr)
+		if (GetWritableSection(i) != nullptr)
 		{
 			memcpy(m_Sections[i]->m_BlockLight, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockLight));
 			continue;
@@ -519,7 +599,7 @@ void cChunkData::SetBlockLight(const NIBBLETYPE * a_Src)
 		// Allocate the section and copy the data into it:
 		m_Sections[i] = Allocate();
 		memcpy(m_Sections[i]->m_BlockLight, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockLight));
-		memset(m_Sections[i]->m_BlockTypes,    0x00, sizeof(m_Sections[i]->m_BlockTypes));
+		m_Sections[i]->m_BlockTypes.Clear();
 		memset(m_Sections[i]->m_BlockMetas,    0x00, sizeof(m_Sections[i]->m_BlockMetas));
 		memset(m_Sections[i]->m_BlockSkyLight, 0xff, sizeof(m_Sections[i]->m_BlockSkyLight));
 	}  // for i - m_Sections[]
@@ -538,7 +618,7 @@ void cChunkData::SetSkyLight(const NIBBLETYPE * a_Src)
 	for (size_t i = 0; i < NumSections; i++)
 	{
 		// If the section is already allocated, copy the data into it:
-		if (m_Sections[i] != nullptr)
+		if (GetWritableSection(i) != nullptr)
 		{
 			memcpy(m_Sections[i]->m_BlockSkyLight, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockSkyLight));
 			continue;
@@ -554,7 +634,7 @@ void cChunkData::SetSkyLight(const NIBBLETYPE * a_Src)
 		// Allocate the section and copy the data into it:
 		m_Sections[i] = Allocate();
 		memcpy(m_Sections[i]->m_BlockSkyLight, &a_Src[i * SectionBlockCount / 2], sizeof(m_Sections[i]->m_BlockSkyLight));
-		memset(m_Sections[i]->m_BlockTypes, 0x00, sizeof(m_Sections[i]->m_BlockTypes));
+		m_Sections[i]->m_BlockTypes.Clear();
 		memset(m_Sections[i]->m_BlockMetas, 0x00, sizeof(m_Sections[i]->m_BlockMetas));
 		memset(m_Sections[i]->m_BlockLight, 0x00, sizeof(m_Sections[i]->m_BlockLight));
 	}  // for i - m_Sections[]
@@ -575,7 +655,37 @@ cChunkData::sChunkSection * cChunkData::Allocate(void)
 
 void cChunkData::Free(cChunkData::sChunkSection * a_Section)
 {
-	m_Pool.Free(a_Section);
+	if (a_Section == nullptr)
+	{
+		return;
+	}
+	if (--a_Section->m_RefCount == 0)
+	{
+		m_Pool.Free(a_Section);
+	}
+}
+
+
+
+
+
+cChunkData::sChunkSection * cChunkData::GetWritableSection(size_t a_SectionIdx)
+{
+	sChunkSection * Section = m_Sections[a_SectionIdx];
+	if ((Section == nullptr) || (Section->m_RefCount == 1))
+	{
+		return Section;
+	}
+
+	// The section is shared, make a private copy:
+	sChunkSection * Copy = Allocate();
+	Copy->m_BlockTypes = Section->m_BlockTypes;
+	memcpy(Copy->m_BlockMetas,    Section->m_BlockMetas,    sizeof(Copy->m_BlockMetas));
+	memcpy(Copy->m_BlockLight,    Section->m_BlockLight,    sizeof(Copy->m_BlockLight));
+	memcpy(Copy->m_BlockSkyLight, Section->m_BlockSkyLight, sizeof(Copy->m_BlockSkyLight));
+	Free(Section);
+	m_Sections[a_SectionIdx] = Copy;
+	return Copy;
 }
 
 
@@ -584,7 +694,7 @@ void cChunkData::Free(cChunkData::sChunkSection * a_Section)
 
 void cChunkData::ZeroSection(cChunkData::sChunkSection * a_Section) const
 {
-	memset(a_Section->m_BlockTypes,    0x00, sizeof(a_Section->m_BlockTypes));
+	a_Section->m_BlockTypes.Clear();
 	memset(a_Section->m_BlockMetas,    0x00, sizeof(a_Section->m_BlockMetas));
 	memset(a_Section->m_BlockLight,    0x00, sizeof(a_Section->m_BlockLight));
 	memset(a_Section->m_BlockSkyLight, 0xff, sizeof(a_Section->m_BlockSkyLight));
@@ -593,3 +703,230 @@ void cChunkData::ZeroSection(cChunkData::sChunkSection * a_Section) const
 
 
 
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkData::cPalettedBlockTypes:
+
+cChunkData::cPalettedBlockTypes::cPalettedBlockTypes(void) :
+	m_BitsPerBlock(0)
+{
+	m_Palette.push_back(0);
+}
+
+
+
+
+
+BLOCKTYPE cChunkData::cPalettedBlockTypes::Get(size_t a_Index) const
+{
+	ASSERT(a_Index < SectionBlockCount);
+	switch (m_BitsPerBlock)
+	{
+		case 0: return m_Palette[0];
+		case 8: return m_Indices[a_Index];
+		default: return m_Palette[GetPaletteIndex(a_Index)];
+	}
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::Set(size_t a_Index, BLOCKTYPE a_Block)
+{
+	ASSERT(a_Index < SectionBlockCount);
+	if (m_BitsPerBlock == 8)
+	{
+		m_Indices[a_Index] = a_Block;
+		return;
+	}
+
+	// If the blocktype is already in the palette, only the index needs changing:
+	size_t PaletteSize = m_Palette.size();
+	for (size_t i = 0; i < PaletteSize; i++)
+	{
+		if (m_Palette[i] == a_Block)
+		{
+			if (m_BitsPerBlock > 0)
+			{
+				SetPaletteIndex(a_Index, i);
+			}
+			return;
+		}
+	}
+
+	// Add the blocktype to the palette, widen the indices if they cannot address it:
+	size_t NewBits = BitsForPaletteSize(PaletteSize + 1);
+	if (NewBits > m_BitsPerBlock)
+	{
+		Repack(NewBits);
+		if (m_BitsPerBlock == 8)
+		{
+			m_Indices[a_Index] = a_Block;
+			return;
+		}
+	}
+	m_Palette.push_back(a_Block);
+	SetPaletteIndex(a_Index, PaletteSize);
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::CopyTo(BLOCKTYPE * a_Dest, size_t a_Start, size_t a_Count) const
+{
+	ASSERT(a_Start + a_Count <= SectionBlockCount);
+	switch (m_BitsPerBlock)
+	{
+		case 0:
+		{
+			memset(a_Dest, m_Palette[0], sizeof(BLOCKTYPE) * a_Count);
+			return;
+		}
+		case 8:
+		{
+			memcpy(a_Dest, &m_Indices[a_Start], sizeof(BLOCKTYPE) * a_Count);
+			return;
+		}
+	}
+	for (size_t i = 0; i < a_Count; i++)
+	{
+		a_Dest[i] = m_Palette[GetPaletteIndex(a_Start + i)];
+	}
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::SetAll(const BLOCKTYPE * a_Src)
+{
+	// Build the palette out of the blocktypes present, in the order of their first appearance:
+	bool IsPresent[256];
+	memset(IsPresent, 0, sizeof(IsPresent));
+	m_Palette.clear();
+	for (size_t i = 0; i < SectionBlockCount; i++)
+	{
+		if (!IsPresent[a_Src[i]])
+		{
+			IsPresent[a_Src[i]] = true;
+			m_Palette.push_back(a_Src[i]);
+		}
+	}
+	Encode(a_Src, BitsForPaletteSize(m_Palette.size()));
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::Clear(void)
+{
+	std::vector<Byte>().swap(m_Indices);
+	m_Palette.clear();
+	m_Palette.push_back(0);
+	m_BitsPerBlock = 0;
+}
+
+
+
+
+
+size_t cChunkData::cPalettedBlockTypes::BitsForPaletteSize(size_t a_PaletteSize)
+{
+	if (a_PaletteSize <= 1)
+	{
+		return 0;
+	}
+	if (a_PaletteSize <= 2)
+	{
+		return 1;
+	}
+	if (a_PaletteSize <= 4)
+	{
+		return 2;
+	}
+	if (a_PaletteSize <= 16)
+	{
+		return 4;
+	}
+	return 8;
+}
+
+
+
+
+
+size_t cChunkData::cPalettedBlockTypes::GetPaletteIndex(size_t a_Index) const
+{
+	size_t BitPos = a_Index * m_BitsPerBlock;
+	size_t Mask = (static_cast<size_t>(1) << m_BitsPerBlock) - 1;
+	return (static_cast<size_t>(m_Indices[BitPos / 8]) >> (BitPos % 8)) & Mask;
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::SetPaletteIndex(size_t a_Index, size_t a_PaletteIndex)
+{
+	size_t BitPos = a_Index * m_BitsPerBlock;
+	size_t Mask = ((static_cast<size_t>(1) << m_BitsPerBlock) - 1) << (BitPos % 8);
+	Byte & Dest = m_Indices[BitPos / 8];
+	Dest = static_cast<Byte>((Dest & ~Mask) | ((a_PaletteIndex << (BitPos % 8)) & Mask));
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::Repack(size_t a_NewBitsPerBlock)
+{
+	ASSERT(a_NewBitsPerBlock > m_BitsPerBlock);
+	BLOCKTYPE Blocks[SectionBlockCount];
+	CopyTo(Blocks, 0, SectionBlockCount);
+	if (a_NewBitsPerBlock == 8)
+	{
+		m_Palette.clear();
+	}
+	Encode(Blocks, a_NewBitsPerBlock);
+}
+
+
+
+
+
+void cChunkData::cPalettedBlockTypes::Encode(const BLOCKTYPE * a_Src, size_t a_BitsPerBlock)
+{
+	m_BitsPerBlock = a_BitsPerBlock;
+	std::vector<Byte>(SectionBlockCount * a_BitsPerBlock / 8).swap(m_Indices);
+	switch (a_BitsPerBlock)
+	{
+		case 0:
+		{
+			return;
+		}
+		case 8:
+		{
+			m_Palette.clear();
+			memcpy(&m_Indices[0], a_Src, SectionBlockCount);
+			return;
+		}
+	}
+
+	Byte PaletteIndex[256];
+	size_t PaletteSize = m_Palette.size();
+	for (size_t i = 0; i < PaletteSize; i++)
+	{
+		PaletteIndex[m_Palette[i]] = static_cast<Byte>(i);
+	}
+	for (size_t i = 0; i < SectionBlockCount; i++)
+	{
+		SetPaletteIndex(i, PaletteIndex[a_Src[i]]);
+	}
+}
+
+
+
+
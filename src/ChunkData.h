@@ -57,10 +57,13 @@ public:
 	bool SetMeta(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble);
 	
 	NIBBLETYPE GetBlockLight(int a_RelX, int a_RelY, int a_RelZ) const;
+	bool SetBlockLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble);
 	
 	NIBBLETYPE GetSkyLight(int a_RelX, int a_RelY, int a_RelZ) const;
+	bool SetSkyLight(int a_RelX, int a_RelY, int a_RelZ, NIBBLETYPE a_Nibble);
 	
-	/** Creates a (deep) copy of self. */
+	/** Creates a copy of self.
+	The copy shares the sections with self, a section is duplicated only when either of the two is written to (copy-on-write). */
 	cChunkData Copy(void) const;
 
 	/** Copies the blocktype data into the specified flat array.
@@ -96,12 +99,71 @@ public:
 	Allows a_Src to be nullptr, in which case it doesn't do anything. */
 	void SetSkyLight(const NIBBLETYPE * a_Src);
 
+	/** Storage for the blocktypes of a single section.
+	The blocktypes are stored as a palette of the distinct blocktypes present in the section and an array of bit-packed indices into the palette.
+	The index width is 0, 1, 2, 4 or 8 bits, so that an index never straddles a byte boundary. A section of a single blocktype
+	needs no index storage at all; at 8 bits the indices are the blocktypes themselves and the palette is not used.
+	The palette only grows on Set(), it is compacted when the whole section is rewritten using SetAll(). */
+	class cPalettedBlockTypes
+	{
+	public:
+		/** Creates a storage filled with air. */
+		cPalettedBlockTypes(void);
+
+		BLOCKTYPE Get(size_t a_Index) const;
+		void Set(size_t a_Index, BLOCKTYPE a_Block);
+
+		/** Copies a_Count blocktypes, starting at index a_Start, into a_Dest. */
+		void CopyTo(BLOCKTYPE * a_Dest, size_t a_Start, size_t a_Count) const;
+
+		/** Replaces the entire contents with SectionBlockCount blocktypes read from a_Src, using the narrowest possible index width. */
+		void SetAll(const BLOCKTYPE * a_Src);
+
+		/** Fills the entire storage with air, releasing the index storage. */
+		void Clear(void);
+
+		/** Returns the number of bits used for each block's index into the palette. */
+		size_t GetBitsPerBlock(void) const { return m_BitsPerBlock; }
+
+		/** Returns the number of bytes used by the packed indices. */
+		size_t GetIndicesSize(void) const { return m_Indices.size(); }
+
+	private:
+		/** The distinct blocktypes in the section. Empty if m_BitsPerBlock is 8. */
+		std::vector<BLOCKTYPE> m_Palette;
+
+		/** The bit-packed indices into m_Palette, SectionBlockCount * m_BitsPerBlock / 8 bytes. */
+		std::vector<Byte> m_Indices;
+
+		size_t m_BitsPerBlock;
+
+		/** Returns the narrowest supported index width that can address a palette of the specified size. */
+		static size_t BitsForPaletteSize(size_t a_PaletteSize);
+
+		size_t GetPaletteIndex(size_t a_Index) const;
+		void SetPaletteIndex(size_t a_Index, size_t a_PaletteIndex);
+
+		/** Re-encodes the indices using the specified (wider) index width. */
+		void Repack(size_t a_NewBitsPerBlock);
+
+		/** Encodes a_Src into m_Indices using the specified index width. m_Palette must already contain all blocktypes in a_Src. */
+		void Encode(const BLOCKTYPE * a_Src, size_t a_BitsPerBlock);
+	};
+
 	struct sChunkSection
 	{
-		BLOCKTYPE  m_BlockTypes   [SectionHeight * 16 * 16]    ;
+		cPalettedBlockTypes m_BlockTypes;
 		NIBBLETYPE m_BlockMetas   [SectionHeight * 16 * 16 / 2];
 		NIBBLETYPE m_BlockLight   [SectionHeight * 16 * 16 / 2];
 		NIBBLETYPE m_BlockSkyLight[SectionHeight * 16 * 16 / 2];
+
+		/** Number of cChunkData objects sharing this section. The section may only be written to while there's a single owner. */
+		std::atomic<int> m_RefCount;
+
+		sChunkSection(void) :
+			m_RefCount(1)
+		{
+		}
 	};
 	
 private:
@@ -117,9 +179,14 @@ private:
 	/** Allocates a new section. Entry-point to custom allocators. */
 	sChunkSection * Allocate(void);
 
-	/** Frees the specified section, previously allocated using Allocate().
+	/** Releases this object's reference to the specified section, previously allocated using Allocate().
+	The section is returned to the pool once no other cChunkData shares it.
 	Note that a_Section may be nullptr. */
 	void Free(sChunkSection * a_Section);
+
+	/** Makes sure that the specified section isn't shared with any other cChunkData, so that it may be written to.
+	If it is shared, replaces it with a private copy. Returns the section, nullptr if the section isn't allocated. */
+	sChunkSection * GetWritableSection(size_t a_SectionIdx);
 	
 	/** Sets the data in the specified section to their default values. */
 	void ZeroSection(sChunkSection * a_Section) const;
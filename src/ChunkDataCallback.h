@@ -40,6 +40,9 @@ public:
 	/// Called once to let know if the chunk lighting is valid. Return value is ignored
 	virtual void LightIsValid(bool a_IsLightValid) { UNUSED(a_IsLightValid); }
 	
+	/// Called once to provide the version of the chunk's data, see cChunk::GetDataVersion()
+	virtual void DataVersion(UInt64 a_DataVersion) { UNUSED(a_DataVersion); }
+	
 	/// Called once to export block info
 	virtual void ChunkData(const cChunkData & a_Buffer) { UNUSED(a_Buffer); }
 	
@@ -100,7 +103,9 @@ protected:
 
 
 
-/** A simple implementation of the cChunkDataCallback interface that collects all block data into separate buffers */
+/** A simple implementation of the cChunkDataCallback interface that collects all block data into separate buffers.
+While the chunk is locked, only a copy-on-write copy of its data is taken, sharing the sections with the chunk;
+the buffers are filled from it by ExpandSnapshot(), after the chunk has been unlocked. */
 class cChunkDataSeparateCollector :
 	public cChunkDataCallback
 {
@@ -111,14 +116,29 @@ public:
 	cChunkDef::BlockNibbles m_BlockLight;
 	cChunkDef::BlockNibbles m_BlockSkyLight;
 
+	/** Fills the buffers from the copy taken in ChunkData() and releases the copy, so that the chunk doesn't need
+	to duplicate the shared sections when it's written to. Must be called after querying the chunk data, before using the buffers. */
+	void ExpandSnapshot(void)
+	{
+		if (m_Snapshot.get() == nullptr)
+		{
+			return;
+		}
+		m_Snapshot->CopyBlockTypes(m_BlockTypes);
+		m_Snapshot->CopyMetas(m_BlockMetas);
+		m_Snapshot->CopyBlockLight(m_BlockLight);
+		m_Snapshot->CopySkyLight(m_BlockSkyLight);
+		m_Snapshot.reset();
+	}
+
 protected:
 
+	/** The copy-on-write copy of the chunk's data, taken in ChunkData(). */
+	std::unique_ptr<cChunkData> m_Snapshot;
+
 	virtual void ChunkData(const cChunkData & a_ChunkBuffer) override
 	{
-		a_ChunkBuffer.CopyBlockTypes(m_BlockTypes);
-		a_ChunkBuffer.CopyMetas(m_BlockMetas);
-		a_ChunkBuffer.CopyBlockLight(m_BlockLight);
-		a_ChunkBuffer.CopySkyLight(m_BlockSkyLight);
+		m_Snapshot.reset(new cChunkData(a_ChunkBuffer.Copy()));
 	}
 } ;
 
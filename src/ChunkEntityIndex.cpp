@@ -0,0 +1,129 @@
+
+// ChunkEntityIndex.cpp
+
+// Implements the cChunkEntityIndex class representing a spatial index of the entities in a single chunk
+
+#include "Globals.h"
+#include "ChunkEntityIndex.h"
+#include "Entities/Entity.h"
+
+
+
+
+
+cChunkEntityIndex::cChunkEntityIndex(void)
+{
+}
+
+
+
+
+
+void cChunkEntityIndex::Add(cEntity * a_Entity)
+{
+	ASSERT(a_Entity->m_EntityIndexCell < 0);  // Not in any index already
+
+	int Cell = GetCellForY(a_Entity->GetPosY());
+	a_Entity->m_EntityIndexCell = Cell;
+	a_Entity->m_EntityIndexSlot = m_Cells[Cell].size();
+	m_Cells[Cell].push_back(a_Entity);
+}
+
+
+
+
+
+void cChunkEntityIndex::Remove(cEntity * a_Entity)
+{
+	int Cell = a_Entity->m_EntityIndexCell;
+	if (Cell < 0)
+	{
+		return;
+	}
+	cEntityPtrs & Entities = m_Cells[Cell];
+	size_t Slot = a_Entity->m_EntityIndexSlot;
+	ASSERT((Slot < Entities.size()) && (Entities[Slot] == a_Entity));  // Must be in this index
+
+	// Move the last entity of the cell into the freed slot:
+	cEntity * Last = Entities.back();
+	Entities[Slot] = Last;
+	Last->m_EntityIndexSlot = Slot;
+	Entities.pop_back();
+
+	a_Entity->m_EntityIndexCell = -1;
+}
+
+
+
+
+
+void cChunkEntityIndex::Update(cEntity * a_Entity)
+{
+	if (a_Entity->m_EntityIndexCell == GetCellForY(a_Entity->GetPosY()))
+	{
+		return;
+	}
+	Remove(a_Entity);
+	Add(a_Entity);
+}
+
+
+
+
+
+void cChunkEntityIndex::Clear(void)
+{
+	for (int Cell = 0; Cell < NumCells; Cell++)
+	{
+		for (auto Entity : m_Cells[Cell])
+		{
+			Entity->m_EntityIndexCell = -1;
+		}
+		m_Cells[Cell].clear();
+	}
+}
+
+
+
+
+
+bool cChunkEntityIndex::ForEachInYRange(double a_MinY, double a_MaxY, cEntityCallback & a_Callback)
+{
+	// Entities are indexed by their bottom, but reach up by their height, and their cell may be a tick old.
+	// Scan two cells below the range and one above it to catch those:
+	int MinCell = std::max(GetCellForY(a_MinY) - 2, 0);
+	int MaxCell = std::min(GetCellForY(a_MaxY) + 1, NumCells - 1);
+	for (int Cell = MinCell; Cell <= MaxCell; Cell++)
+	{
+		cEntityPtrs & Entities = m_Cells[Cell];
+
+		// Walk backwards, so that removing the current entity (which swaps in the last one, already processed) is safe:
+		for (size_t i = Entities.size(); i-- > 0;)
+		{
+			if (i >= Entities.size())
+			{
+				// The callback has removed several entities
+				continue;
+			}
+			if (a_Callback.Item(Entities[i]))
+			{
+				return false;
+			}
+		}  // for i - Entities[]
+	}  // for Cell - m_Cells[]
+	return true;
+}
+
+
+
+
+
+int cChunkEntityIndex::GetCellForY(double a_Y)
+{
+	int Cell = FloorC(a_Y) / CellHeight;
+	return Clamp(Cell, 0, NumCells - 1);
+}
+
+
+
+
@@ -0,0 +1,80 @@
+
+// ChunkEntityIndex.h
+
+// Declares the cChunkEntityIndex class representing a spatial index of the entities in a single chunk
+
+/*
+The chunk is split vertically into cells as high as a chunk section (16 blocks), each cell keeps a contiguous array
+of the entities whose position is inside it. Box and radius queries then only need to look at the cells that the
+queried range spans, instead of walking the whole entity list of the chunk.
+Each entity remembers its cell and its slot within the cell's array, so that it can be removed in constant time
+(the last entity of the cell is swapped into its place).
+The cell of an entity is refreshed by cChunk once per tick, so an entity can be up to a tick's movement away from
+its cell; the queries widen the range of scanned cells to account for that and for the entity height. The callers
+still do the exact test against the live entity position.
+Not thread-safe, it is protected by the parent cChunkMap's CS, same as the rest of the chunk.
+*/
+
+
+
+
+
+#pragma once
+
+#include "ChunkDef.h"
+
+
+
+
+
+// fwd:
+class cEntity;
+typedef cItemCallback<cEntity> cEntityCallback;
+
+
+
+
+
+class cChunkEntityIndex
+{
+public:
+	cChunkEntityIndex(void);
+
+	/** Adds the entity into the cell given by its current position. */
+	void Add(cEntity * a_Entity);
+
+	/** Removes the entity from the index. Ignored if the entity is not in the index. */
+	void Remove(cEntity * a_Entity);
+
+	/** Moves the entity into the cell given by its current position, if it has left its cell. */
+	void Update(cEntity * a_Entity);
+
+	/** Removes all the entities from the index. */
+	void Clear(void);
+
+	/** Calls the callback for each entity that may intersect the specified Y range.
+	Entities in the cells around the range are reported as well, so the callback needs to check the exact position.
+	The callback may destroy or remove the reported entity.
+	Returns true if all the entities have been processed, false if the callback aborted by returning true. */
+	bool ForEachInYRange(double a_MinY, double a_MaxY, cEntityCallback & a_Callback);
+
+protected:
+	/** Height of a single cell, in blocks. Same as the chunk section height. */
+	static const int CellHeight = 16;
+
+	/** Number of cells in the index. */
+	static const int NumCells = cChunkDef::Height / CellHeight;
+
+	typedef std::vector<cEntity *> cEntityPtrs;
+
+	/** The entities in each cell. */
+	cEntityPtrs m_Cells[NumCells];
+
+
+	/** Returns the cell index for the specified Y coord, clamped to the valid cells. */
+	static int GetCellForY(double a_Y);
+} ;
+
+
+
+
@@ -7,6 +7,7 @@
 
 
 #include "ChunkDataCallback.h"
+#include "CheckerboardTicker.h"
 
 
 
@@ -110,6 +111,9 @@ public:
 	/** Wakes up the simulators for the specified area of blocks */
 	void WakeUpSimulatorsInArea(int a_MinBlockX, int a_MaxBlockX, int a_MinBlockY, int a_MaxBlockY, int a_MinBlockZ, int a_MaxBlockZ);
 
+	/** Wakes up the hoppers that may move items from or to the container at the specified coords, after its contents changed. */
+	void WakeUpHoppersAround(int a_BlockX, int a_BlockY, int a_BlockZ);
+
 	void MarkRedstoneDirty  (int a_ChunkX, int a_ChunkZ);
 	void MarkChunkDirty     (int a_ChunkX, int a_ChunkZ, bool a_MarkRedstoneDirty = false);
 	void MarkChunkSaving    (int a_ChunkX, int a_ChunkZ);
@@ -313,6 +317,10 @@ public:
 	/** Marks the chunk as failed-to-load */
 	void ChunkLoadFailed(int a_ChunkX, int a_ChunkZ);
 	
+	/** Marks the chunk as invalid if it is queued, but no client or ChunkStay wants it anymore.
+	Returns true if the chunk's queued load / generate request should be dropped. */
+	bool TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ);
+	
 	/** Sets the sign text. Returns true if sign text changed. */
 	bool SetSignLines(int a_BlockX, int a_BlockY, int a_BlockZ, const AString & a_Line1, const AString & a_Line2, const AString & a_Line3, const AString & a_Line4);
 	
@@ -348,14 +356,36 @@ public:
 	/** Try to Spawn Monsters inside all Chunks */
 	void SpawnMobs(cMobSpawner& a_MobSpawner);
 
+	/** Ticks all the chunks that should be ticked.
+	If there are tick worker threads, the chunk layers are ticked in parallel, see cChunkMap::Tick() for details. */
 	void Tick(float a_Dt);
 	
+	/** Starts the specified number of threads that help the tick thread tick the chunk layers in parallel.
+	With a_NumThreads less than 1, no threads are started and the chunks are ticked serially in the tick thread. */
+	void StartTickThreads(int a_NumThreads);
+
+	/** Stops all the tick worker threads; the chunks are ticked serially in the tick thread afterwards. */
+	void StopTickThreads(void);
+
+	/** Returns true if the calling thread is ticking the chunk layers in parallel with other threads: a tick worker, or the tick thread helping them.
+	Such a thread mustn't call into the plugins, because they may access any chunk, including those ticked by the other threads. */
+	bool IsTickingInParallel(void);
+
+	/** Returns the number of threads ticking the chunks, including the tick thread itself. */
+	size_t GetNumTickThreads(void) const { return m_Ticker.GetNumThreads(); }
+
 	/** Ticks a single block. Used by cWorld::TickQueuedBlocks() to tick the queued blocks */
 	void TickBlock(int a_BlockX, int a_BlockY, int a_BlockZ);
 
 	void UnloadUnusedChunks(void);
 	void SaveAllChunks(void);
 
+	/** Queues all the dirty chunks in the specified layer for saving. Does nothing if the layer doesn't exist. */
+	void SaveLayer(int a_LayerX, int a_LayerZ);
+
+	/** Unloads the chunks in the specified layer that can be unloaded. Does nothing if the layer doesn't exist. */
+	void UnloadUnusedLayerChunks(int a_LayerX, int a_LayerZ);
+
 	cWorld * GetWorld(void) { return m_World; }
 
 	int GetNumChunks(void);
@@ -384,7 +414,8 @@ private:
 	friend class cChunkStay;
 	
 
-	class cChunkLayer
+	class cChunkLayer :
+		public cCheckerboardTicker::cRegion
 	{
 	public:
 		cChunkLayer(
@@ -417,6 +448,17 @@ private:
 
 		void Tick(float a_Dt);
 		
+		/** Calls cChunk::TickLocal() on all the chunks in the layer that should be ticked. */
+		void TickLocal(float a_Dt);
+
+		/** Calls cChunk::TickShared() on all the chunks in the layer that should be ticked. */
+		void TickShared(float a_Dt);
+
+		// cCheckerboardTicker::cRegion overrides:
+		virtual int GetRegionX(void) const override { return m_LayerX; }
+		virtual int GetRegionZ(void) const override { return m_LayerZ; }
+		virtual void TickRegion(float a_Dt) override { TickLocal(a_Dt); }
+
 		void RemoveClient(cClientHandle * a_Client);
 		
 		/** Calls the callback for each entity in the entire world; returns true if all entities processed, false if the callback aborted by returning true */
@@ -456,14 +498,30 @@ private:
 		}
 	};
 	
+	/** RAII lock of m_CSLayers; doesn't lock anything in the tick worker threads.
+	While the tick workers run, the tick thread holds m_CSLayers on their behalf and only waits for them to finish. */
+	class cLayersLock
+	{
+	public:
+		cLayersLock(cChunkMap & a_ChunkMap);
+		~cLayersLock();
+
+		/** Unlocks the CS before the object goes out of scope; it cannot be re-locked. */
+		void Unlock(void);
+
+	protected:
+		/** The CS locked by this object, nullptr when used in a tick worker thread or after Unlock(). */
+		cCriticalSection * m_CS;
+	} ;
+
 	typedef std::list<cChunkLayer *> cChunkLayerList;
 	
 	typedef std::list<cChunkStay *> cChunkStays;
 
-	/** Finds the cChunkLayer object responsible for the specified chunk; returns nullptr if not found. Assumes m_CSLayers is locked. */
+	/** Finds the cChunkLayer object responsible for the specified chunk; returns nullptr if not found. Assumes m_CSLayers is locked (IsLayersLocked()). */
 	cChunkLayer * FindLayerForChunk(int a_ChunkX, int a_ChunkZ);
 	
-	/** Returns the specified cChunkLayer object; returns nullptr if not found. Assumes m_CSLayers is locked. */
+	/** Returns the specified cChunkLayer object; returns nullptr if not found. Assumes m_CSLayers is locked (IsLayersLocked()). */
 	cChunkLayer * FindLayer(int a_LayerX, int a_LayerZ);
 	
 	/** Returns the cChunkLayer object responsible for the specified chunk; creates it if not found. */
@@ -474,8 +532,21 @@ private:
 	
 	void RemoveLayer(cChunkLayer * a_Layer);
 
+	/** Returns true if the calling thread is one of the tick workers, currently ticking the layers with m_CSLayers held by the tick thread. */
+	bool IsTickWorkerThread(void) const { return m_Ticker.IsWorkerThread(); }
+
+	/** Returns true if the calling thread has access to the layers, either by having m_CSLayers locked, or by being a tick worker. Used for ASSERTs. */
+	bool IsLayersLocked(void) { return m_CSLayers.IsLockedByCurrentThread() || IsTickWorkerThread(); }
+
 	cCriticalSection m_CSLayers;
 	cChunkLayerList  m_Layers;
+
+	/** Protects the m_Layers list itself, so that the tick workers can look up and create layers concurrently. */
+	cCriticalSection m_CSLayerList;
+
+	/** Ticks the layers in parallel, when there are tick threads. */
+	cCheckerboardTicker m_Ticker;
+
 	cEvent           m_evtChunkValid;  // Set whenever any chunk becomes valid, via ChunkValidated()
 
 	cWorld * m_World;
@@ -0,0 +1,126 @@
+
+// ChunkScheduler.cpp
+
+// Implements the cChunkScheduler class that prioritizes the chunk requests in the storage and generator queues
+
+#include "Globals.h"
+#include "ChunkScheduler.h"
+
+
+
+
+
+const int cChunkScheduler::UNWANTED;
+
+/** A player moving by more than this many chunks between two updates is considered teleported, rather than heading somewhere. */
+static const int MAX_HEADING_STEP = 2;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkScheduler::cSnapshot:
+
+int cChunkScheduler::cSnapshot::GetPriority(int a_ChunkX, int a_ChunkZ) const
+{
+	int res = UNWANTED;
+	for (cPlayers::const_iterator itr = m_Players.begin(), end = m_Players.end(); itr != end; ++itr)
+	{
+		int Distance = std::max(std::abs(itr->m_ChunkX - a_ChunkX), std::abs(itr->m_ChunkZ - a_ChunkZ));
+
+		// The chunks one beyond the view distance are wanted, too, they are needed for lighting the edge of the view:
+		if ((Distance <= itr->m_ViewDistance + 1) && (Distance < res))
+		{
+			res = Distance;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkScheduler:
+
+void cChunkScheduler::SetPlayers(const cPlayers & a_Players)
+{
+	cCSLock Lock(m_CS);
+	cPlayers OldPlayers;
+	std::swap(OldPlayers, m_Players);
+	m_Players = a_Players;
+
+	// Update the headings from the previous positions (there are only a few players, so a linear search is fine):
+	for (cPlayers::iterator itr = m_Players.begin(), end = m_Players.end(); itr != end; ++itr)
+	{
+		for (cPlayers::const_iterator itrOld = OldPlayers.begin(), endOld = OldPlayers.end(); itrOld != endOld; ++itrOld)
+		{
+			if (itrOld->m_ID != itr->m_ID)
+			{
+				continue;
+			}
+			int DiffX = itr->m_ChunkX - itrOld->m_ChunkX;
+			int DiffZ = itr->m_ChunkZ - itrOld->m_ChunkZ;
+			if ((DiffX == 0) && (DiffZ == 0))
+			{
+				// Still in the same chunk, keep the heading
+				itr->m_HeadingX = itrOld->m_HeadingX;
+				itr->m_HeadingZ = itrOld->m_HeadingZ;
+			}
+			else if ((std::abs(DiffX) <= MAX_HEADING_STEP) && (std::abs(DiffZ) <= MAX_HEADING_STEP))
+			{
+				itr->m_HeadingX = Clamp(DiffX, -1, 1);
+				itr->m_HeadingZ = Clamp(DiffZ, -1, 1);
+			}
+			break;
+		}  // for itrOld - OldPlayers[]
+	}  // for itr - m_Players[]
+}
+
+
+
+
+
+void cChunkScheduler::GetSnapshot(cSnapshot & a_Snapshot)
+{
+	cCSLock Lock(m_CS);
+	a_Snapshot.m_Players = m_Players;
+}
+
+
+
+
+
+void cChunkScheduler::GetChunksAhead(const sPlayer & a_Player, cChunkCoordsVector & a_Chunks)
+{
+	// The player wants the chunks up to one beyond the view distance (see cSnapshot::GetPriority());
+	// after moving one chunk in its heading, the wanted square shifts by the heading:
+	int Radius = a_Player.m_ViewDistance + 1;
+	int CenterX = a_Player.m_ChunkX + a_Player.m_HeadingX;
+	int CenterZ = a_Player.m_ChunkZ + a_Player.m_HeadingZ;
+	if (a_Player.m_HeadingX != 0)
+	{
+		int x = CenterX + a_Player.m_HeadingX * Radius;
+		for (int z = CenterZ - Radius; z <= CenterZ + Radius; z++)
+		{
+			a_Chunks.push_back(cChunkCoords(x, z));
+		}
+	}
+	if (a_Player.m_HeadingZ != 0)
+	{
+		// Skip the corner that has been added with the column above:
+		int z = CenterZ + a_Player.m_HeadingZ * Radius;
+		int MinX = CenterX - Radius + ((a_Player.m_HeadingX < 0) ? 1 : 0);
+		int MaxX = CenterX + Radius - ((a_Player.m_HeadingX > 0) ? 1 : 0);
+		for (int x = MinX; x <= MaxX; x++)
+		{
+			a_Chunks.push_back(cChunkCoords(x, z));
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,110 @@
+
+// ChunkScheduler.h
+
+// Declares the cChunkScheduler class that prioritizes the chunk requests in the storage and generator queues
+
+/*
+The world's storage and generator queues don't process their chunks in the order in which they were queued.
+Instead, they take the chunk nearest to a player who wants it, so that the chunks around the players
+(especially after logging in or teleporting) get loaded before the chunks on the edge of someone else's view.
+The world updates the player positions in the scheduler once per tick; the queues take a snapshot of them
+and evaluate the priorities of all their items against the snapshot each time they pick the next item,
+so the priorities follow the players as they move.
+A chunk that no player has within its view distance gets the UNWANTED priority; such requests are processed last
+and the queues may drop them altogether, if nothing else (a callback, a ChunkStay, an explicit request
+from a plugin) depends on the chunk.
+The scheduler also keeps track of the direction in which each player last moved from one chunk to another, so that
+the storage can prefetch the chunks that the player is going to want next (see GetChunksAhead()).
+*/
+
+
+
+
+
+#pragma once
+
+#include "ChunkDef.h"
+
+
+
+
+
+class cChunkScheduler
+{
+public:
+
+	/** The priority of a chunk that no player wants. Lower priority values are processed first. */
+	static const int UNWANTED = std::numeric_limits<int>::max();
+
+	/** The position of a single player and the view distance of its client, in chunks. */
+	struct sPlayer
+	{
+		/** The player's entity ID, used for matching the player's positions between the updates. */
+		int m_ID;
+
+		int m_ChunkX;
+		int m_ChunkZ;
+		int m_ViewDistance;
+
+		/** The direction (-1, 0 or 1 on each axis) of the player's last move to another chunk; both zero if not known.
+		Filled in by SetPlayers(). */
+		int m_HeadingX;
+		int m_HeadingZ;
+
+		sPlayer(int a_ID, int a_ChunkX, int a_ChunkZ, int a_ViewDistance) :
+			m_ID(a_ID),
+			m_ChunkX(a_ChunkX),
+			m_ChunkZ(a_ChunkZ),
+			m_ViewDistance(a_ViewDistance),
+			m_HeadingX(0),
+			m_HeadingZ(0)
+		{
+		}
+
+		bool HasHeading(void) const { return (m_HeadingX != 0) || (m_HeadingZ != 0); }
+	};
+
+	typedef std::vector<sPlayer> cPlayers;
+
+
+	/** A copy of the player positions, for evaluating the priorities of many chunks without locking. */
+	class cSnapshot
+	{
+		friend class cChunkScheduler;
+
+	public:
+
+		/** Returns the priority of the specified chunk: the distance, in chunks, to the nearest player
+		who has the chunk within its view distance, or UNWANTED if there is no such player. */
+		int GetPriority(int a_ChunkX, int a_ChunkZ) const;
+
+		const cPlayers & GetPlayers(void) const { return m_Players; }
+
+	protected:
+
+		cPlayers m_Players;
+	};
+
+
+	/** Replaces the player positions by the ones specified, updating their headings. Called by the world each tick. */
+	void SetPlayers(const cPlayers & a_Players);
+
+	/** Fills a_Snapshot with the current player positions. */
+	void GetSnapshot(cSnapshot & a_Snapshot);
+
+	/** Appends to a_Chunks the chunks that the player will newly want once it moves one more chunk in its heading:
+	the row and / or column of chunks just beyond the edge of its view in that direction. Appends nothing if the player has no heading. */
+	static void GetChunksAhead(const sPlayer & a_Player, cChunkCoordsVector & a_Chunks);
+
+protected:
+
+	/** Protects m_Players against multithreaded access. */
+	cCriticalSection m_CS;
+
+	/** The current player positions. */
+	cPlayers m_Players;
+} ;
+
+
+
+
@@ -37,7 +37,8 @@ cChunkSender::cChunkSender(void) :
 	super("ChunkSender"),
 	m_World(nullptr),
 	m_RemoveCount(0),
-	m_Notify(nullptr)
+	m_Notify(nullptr),
+	m_DataVersion(0)
 {
 	m_Notify.SetChunkSender(this);
 }
@@ -285,7 +286,8 @@ void cChunkSender::SendChunk(int a_ChunkX, int a_ChunkZ, cClientHandle * a_Clien
 	{
 		return;
 	}
-	cChunkDataSerializer Data(m_BlockTypes, m_BlockMetas, m_BlockLight, m_BlockSkyLight, m_BiomeMap);
+	ExpandSnapshot();
+	cChunkDataSerializer Data(m_BlockTypes, m_BlockMetas, m_BlockLight, m_BlockSkyLight, m_BiomeMap, &m_World->GetChunkDataCache(), m_DataVersion);
 
 	// Send:
 	if (a_Client == nullptr)
@@ -335,6 +337,15 @@ void cChunkSender::Entity(cEntity *)
 
 
 
+void cChunkSender::DataVersion(UInt64 a_DataVersion)
+{
+	m_DataVersion = a_DataVersion;
+}
+
+
+
+
+
 void cChunkSender::BiomeData(const cChunkDef::BiomeMap * a_BiomeMap)
 {
 	for (size_t i = 0; i < ARRAYCOUNT(m_BiomeMap); i++)
@@ -38,6 +38,9 @@
 /** Maximum number of block change interactions a player can perform per tick - exceeding this causes a kick */
 #define MAX_BLOCK_CHANGE_INTERACTIONS 20
 
+/** Outgoing data buffers smaller than this are copied into the outgoing queue, larger ones are queued without copying */
+#define MIN_SHARED_OUTGOING_DATA_SIZE 1024
+
 /** The interval for sending pings to clients.
 Vanilla sends one ping every 1 second. */
 static const std::chrono::milliseconds PING_TIME_MS = std::chrono::milliseconds(1000);
@@ -60,7 +63,6 @@ cClientHandle::cClientHandle(const cSocket * a_Socket, int a_ViewDistance) :
 	m_CurrentViewDistance(a_ViewDistance),
 	m_RequestedViewDistance(a_ViewDistance),
 	m_IPString(a_Socket->GetIPString()),
-	m_OutgoingData(64 KiB),
 	m_Player(nullptr),
 	m_HasSentDC(false),
 	m_LastStreamedChunkX(0x7fffffff),  // bogus chunk coords to force streaming upon login
@@ -1780,38 +1782,42 @@ void cClientHandle::SendData(const char * a_Data, size_t a_Size)
 	
 	{
 		cCSLock Lock(m_CSOutgoingData);
-		
-		// _X 2012_09_06: We need an overflow buffer, usually when streaming the initial chunks
-		if (m_OutgoingDataOverflow.empty())
+		m_OutgoingDataTail.append(a_Data, a_Size);
+	}
+	
+	// Notify SocketThreads that we have something to write:
+	cRoot::Get()->GetServer()->NotifyClientWrite(this);
+}
+
+
+
+
+
+void cClientHandle::SendData(const cSocketThreads::cDataPtr & a_Data)
+{
+	if (m_HasSentDC)
+	{
+		// This could crash the client, because they've already unloaded the world etc., and suddenly a wild packet appears (#31)
+		return;
+	}
+	
+	{
+		cCSLock Lock(m_CSOutgoingData);
+		if (a_Data->size() < MIN_SHARED_OUTGOING_DATA_SIZE)
 		{
-			// No queued overflow data; if this packet fits into the ringbuffer, put it in, otherwise put it in the overflow buffer:
-			size_t CanFit = m_OutgoingData.GetFreeSpace();
-			if (CanFit > a_Size)
-			{
-				CanFit = a_Size;
-			}
-			if (CanFit > 0)
-			{
-				m_OutgoingData.Write(a_Data, CanFit);
-			}
-			if (a_Size > CanFit)
-			{
-				m_OutgoingDataOverflow.append(a_Data + CanFit, a_Size - CanFit);
-			}
+			// Copying a small buffer is cheaper than sending it as a separate piece:
+			m_OutgoingDataTail.append(*a_Data);
 		}
 		else
 		{
-			// There is a queued overflow. Append to it, then send as much from its front as possible
-			m_OutgoingDataOverflow.append(a_Data, a_Size);
-			size_t CanFit = m_OutgoingData.GetFreeSpace();
-			if (CanFit > 128)
+			if (!m_OutgoingDataTail.empty())
 			{
-				// No point in moving the data over if it's not large enough - too much effort for too little an effect
-				m_OutgoingData.Write(m_OutgoingDataOverflow.data(), CanFit);
-				m_OutgoingDataOverflow.erase(0, CanFit);
+				m_OutgoingData.push_back(std::make_shared<const AString>(std::move(m_OutgoingDataTail)));
+				m_OutgoingDataTail.clear();
 			}
+			m_OutgoingData.push_back(a_Data);
 		}
-	}  // Lock(m_CSOutgoingData)
+	}
 	
 	// Notify SocketThreads that we have something to write:
 	cRoot::Get()->GetServer()->NotifyClientWrite(this);
@@ -1991,6 +1997,15 @@ void cClientHandle::SendAttachEntity(const cEntity & a_Entity, const cEntity * a
 
 
 
+void cClientHandle::SendBroadcastPacket(cProtocol::cBroadcastCache & a_Cache, cProtocol::cPacketSerializer & a_Serializer)
+{
+	m_Protocol->SendBroadcastPacket(a_Cache, a_Serializer);
+}
+
+
+
+
+
 void cClientHandle::SendBlockAction(int a_BlockX, int a_BlockY, int a_BlockZ, char a_Byte1, char a_Byte2, BLOCKTYPE a_BlockType)
 {
 	m_Protocol->SendBlockAction(a_BlockX, a_BlockY, a_BlockZ, a_Byte1, a_Byte2, a_BlockType);
@@ -2859,16 +2874,36 @@ bool cClientHandle::DataReceived(const char * a_Data, size_t a_Size)
 void cClientHandle::GetOutgoingData(AString & a_Data)
 {
 	// Data can be sent to client
+	cSocketThreads::cDataPtrs Buffers;
+	GetOutgoingBuffers(Buffers);
+	for (cSocketThreads::cDataPtrs::const_iterator itr = Buffers.begin(), end = Buffers.end(); itr != end; ++itr)
+	{
+		a_Data.append(**itr);
+	}
+}
+
+
+
+
+
+void cClientHandle::GetOutgoingBuffers(cSocketThreads::cDataPtrs & a_Data)
+{
+	// Data can be sent to client
+	bool IsEmpty;
 	{
 		cCSLock Lock(m_CSOutgoingData);
-		m_OutgoingData.ReadAll(a_Data);
-		m_OutgoingData.CommitRead();
-		a_Data.append(m_OutgoingDataOverflow);
-		m_OutgoingDataOverflow.clear();
+		if (!m_OutgoingDataTail.empty())
+		{
+			m_OutgoingData.push_back(std::make_shared<const AString>(std::move(m_OutgoingDataTail)));
+			m_OutgoingDataTail.clear();
+		}
+		IsEmpty = m_OutgoingData.empty();
+		a_Data.insert(a_Data.end(), m_OutgoingData.begin(), m_OutgoingData.end());
+		m_OutgoingData.clear();
 	}
 
 	// Disconnect player after all packets have been sent
-	if (m_HasSentDC && a_Data.empty())
+	if (m_HasSentDC && IsEmpty)
 	{
 		Destroy();
 	}
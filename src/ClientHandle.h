@@ -22,6 +22,7 @@
 #include "UI/SlotArea.h"
 #include "json/json.h"
 #include "ChunkSender.h"
+#include "Protocol/Protocol.h"
 
 
 
@@ -35,7 +36,6 @@ class cExpOrb;
 class cPainting;
 class cPickup;
 class cPlayer;
-class cProtocol;
 class cWindow;
 class cFallingBlock;
 class cItemHandler;
@@ -210,6 +210,9 @@ public:
 	void SendWindowClose                (const cWindow & a_Window);
 	void SendWindowOpen                 (const cWindow & a_Window);
 	void SendWindowProperty             (const cWindow & a_Window, short a_Property, short a_Value);
+	
+	/** Sends a packet that is being broadcast to multiple clients; the packet is serialized only once per protocol version, see cProtocol::SendBroadcastPacket() */
+	void SendBroadcastPacket(cProtocol::cBroadcastCache & a_Cache, cProtocol::cPacketSerializer & a_Serializer);
 
 	// tolua_begin
 	const AString & GetUsername(void) const;
@@ -325,6 +328,10 @@ public:
 	
 	void SendData(const char * a_Data, size_t a_Size);
 	
+	/** Queues the (already serialized and encrypted) data buffer for sending, without copying it if it is large enough.
+	The same buffer may be queued to any number of clients. */
+	void SendData(const cSocketThreads::cDataPtr & a_Data);
+	
 	/** Called when the player moves into a different world.
 	Sends an UnloadChunk packet for each loaded chunk and resets the streamed chunks. */
 	void RemoveFromWorld(void);
@@ -366,8 +373,8 @@ private:
 	AString          m_IncomingData;
 	
 	cCriticalSection m_CSOutgoingData;
-	cByteBuffer      m_OutgoingData;
-	AString          m_OutgoingDataOverflow;  ///< For data that didn't fit into the m_OutgoingData ringbuffer temporarily
+	cSocketThreads::cDataPtrs m_OutgoingData;  ///< The outgoing data buffers, in the order in which they are to be sent
+	AString          m_OutgoingDataTail;       ///< Small pieces of outgoing data, accumulated here so that they are queued in a single buffer
 
 	Vector3d m_ConfirmPosition;
 
@@ -486,6 +493,7 @@ private:
 	// cSocketThreads::cCallback overrides:
 	virtual bool DataReceived   (const char * a_Data, size_t a_Size) override;  // Data is received from the client
 	virtual void GetOutgoingData(AString & a_Data) override;  // Data can be sent to client
+	virtual void GetOutgoingBuffers(cSocketThreads::cDataPtrs & a_Data) override;  // Data can be sent to client, without copying
 	virtual void SocketClosed   (void) override;  // The socket has been closed for any reason
 };  // tolua_export
 
@@ -52,6 +52,7 @@ cEntity::cEntity(eEntityType a_EntityType, double a_X, double a_Y, double a_Z, d
 	, m_AirLevel(0)
 	, m_AirTickTimer(0)
 	, m_TicksAlive(0)
+	, m_LastChunkTick(-1)
 	, m_HeadYaw(0.0)
 	, m_Rot(0.0, 0.0, 0.0)
 	, m_Pos(a_X, a_Y, a_Z)
@@ -60,6 +61,8 @@ cEntity::cEntity(eEntityType a_EntityType, double a_X, double a_Y, double a_Z, d
 	, m_Width(a_Width)
 	, m_Height(a_Height)
 	, m_InvulnerableTicks(0)
+	, m_EntityIndexCell(-1)
+	, m_EntityIndexSlot(0)
 {
 	cCSLock Lock(m_CSCount);
 	m_EntityCount++;
@@ -841,6 +844,17 @@ void cEntity::Tick(float a_Dt, cChunk & a_Chunk)
 
 
 
+int cEntity::UpdateLastChunkTick(Int64 a_WorldAge, int a_MaxTicks)
+{
+	Int64 NumTicks = (m_LastChunkTick < 0) ? 1 : (a_WorldAge - m_LastChunkTick);
+	m_LastChunkTick = a_WorldAge;
+	return static_cast<int>(Clamp<Int64>(NumTicks, 1, std::max(a_MaxTicks, 1)));
+}
+
+
+
+
+
 void cEntity::HandlePhysics(float a_Dt, cChunk & a_Chunk)
 {
 	int BlockX = POSX_TOINT;
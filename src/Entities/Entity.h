@@ -459,6 +459,10 @@ public:
 	/** Sets the internal world pointer to a new cWorld, doesn't update anything else. */
 	void SetWorld(cWorld * a_World) { m_World = a_World; }
 
+	/** Returns the number of ticks since the entity's chunk last ticked it, between 1 and a_MaxTicks, and remembers a_WorldAge as the last tick.
+	Used by cChunk to scale the tick length of the entities that are ticked at a reduced rate out of the players' activation range. */
+	int UpdateLastChunkTick(Int64 a_WorldAge, int a_MaxTicks);
+
 protected:
 	static cCriticalSection m_CSCount;
 	static int m_EntityCount;
@@ -571,6 +575,9 @@ protected:
 	
 	/** The number of ticks this entity has been alive for */
 	long int m_TicksAlive;
+
+	/** The world age when the entity's chunk last ticked it, -1 if not yet ticked. */
+	Int64 m_LastChunkTick;
 	
 private:
 	/** Measured in degrees, [-180, +180) */
@@ -597,6 +604,14 @@ private:
 	/** If a player hit a entity, the entity receive a invulnerable of 10 ticks.
 	While this ticks, a player can't hit this entity. */
 	int m_InvulnerableTicks;
+
+	/** The cell of the chunk's cChunkEntityIndex in which the entity is stored, or -1 if not stored in any. */
+	int m_EntityIndexCell;
+
+	/** The position of the entity within its cChunkEntityIndex cell. */
+	size_t m_EntityIndexSlot;
+
+	friend class cChunkEntityIndex;
 } ;  // tolua_export
 
 typedef std::list<cEntity *> cEntityList;
@@ -163,6 +163,12 @@ void cPickup::Tick(float a_Dt, cChunk & a_Chunk)
 					m_World->BroadcastEntityMetadata(*this);
 				}
 			}
+
+			// Wake up the hopper below, so that it sucks the pickup in:
+			if (!IsDestroyed() && ((BlockBelow == E_BLOCK_HOPPER) || (BlockIn == E_BLOCK_HOPPER)))
+			{
+				CurrentChunk->WakeUpHoppers(BlockX, BlockX, BlockY - 1, BlockY, BlockZ, BlockZ);
+			}
 		}
 	}
 	else
@@ -72,6 +72,10 @@ protected:
 	int m_NumMisses;
 	int m_TotalChain;  // Number of cache items walked to get to a hit (only added for hits)
 	
+	/** Protects the cache data and the underlying generator against multithreaded access,
+	the biomes are requested both by the generator threads and directly by the world. */
+	cCriticalSection m_CS;
+	
 	virtual void GenBiomes(int a_ChunkX, int a_ChunkZ, cChunkDef::BiomeMap & a_BiomeMap) override;
 	virtual void InitializeBiomeGen(cIniFile & a_IniFile) override;
 } ;
@@ -103,6 +107,10 @@ protected:
 	/** Individual sub-caches. */
 	cBiomeGenPtrs m_Caches;
 
+	/** Protects the sub-caches against multithreaded access.
+	The sub-caches share the underlying generator, which isn't thread-safe by itself. */
+	cCriticalSection m_CS;
+
 
 	virtual void GenBiomes(int a_ChunkX, int a_ChunkZ, cChunkDef::BiomeMap & a_BiomeMap) override;
 	virtual void InitializeBiomeGen(cIniFile & a_IniFile) override;
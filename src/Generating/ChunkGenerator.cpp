@@ -15,9 +15,6 @@
 /// If the generation queue size exceeds this number, a warning will be output
 const unsigned int QUEUE_WARNING_LIMIT = 1000;
 
-/// If the generation queue size exceeds this number, chunks with no clients will be skipped
-const unsigned int QUEUE_SKIP_LIMIT = 500;
-
 
 
 
@@ -26,8 +23,8 @@ const unsigned int QUEUE_SKIP_LIMIT = 500;
 // cChunkGenerator:
 
 cChunkGenerator::cChunkGenerator(void) :
-	super("cChunkGenerator"),
 	m_Seed(0),  // Will be overwritten by the actual generator
+	m_ShouldTerminate(false),
 	m_Generator(nullptr),
 	m_PluginInterface(nullptr),
 	m_ChunkSink(nullptr)
@@ -49,8 +46,10 @@ cChunkGenerator::~cChunkGenerator()
 
 bool cChunkGenerator::Start(cPluginInterface & a_PluginInterface, cChunkSink & a_ChunkSink, cIniFile & a_IniFile)
 {
+	ASSERT(m_Workers.empty());  // Not started yet
 	m_PluginInterface = &a_PluginInterface;
 	m_ChunkSink = &a_ChunkSink;
+	m_ShouldTerminate = false;
 
 	// Get the seed; create a new one and log it if not found in the INI file:
 	if (a_IniFile.HasValue("Seed", "Seed"))
@@ -65,30 +64,30 @@ bool cChunkGenerator::Start(cPluginInterface & a_PluginInterface, cChunkSink & a
 		a_IniFile.SetValueI("Seed", "Seed", m_Seed);
 	}
 	
-	// Get the generator engine based on the INI file settings:
-	AString GeneratorName = a_IniFile.GetValueSet("Generator", "Generator", "Composable");
-	if (NoCaseCompare(GeneratorName, "Noise3D") == 0)
-	{
-		m_Generator = new cNoise3DGenerator(*this);
-	}
-	else
+	int NumThreads = std::max(a_IniFile.GetValueSetI("Generator", "NumThreads", 2), 1);
+
+	// Each worker gets its own generator engine, the first one is also used for the direct biome requests:
+	cCSLock Lock(m_CS);
+	for (int i = 0; i < NumThreads; i++)
 	{
-		if (NoCaseCompare(GeneratorName, "composable") != 0)
+		cGenerator * Generator = CreateGenerator(a_IniFile);
+		if (Generator == nullptr)
 		{
-			LOGWARN("[Generator]::Generator value \"%s\" not recognized, using \"Composable\".", GeneratorName.c_str());
+			LOGERROR("Generator could not start, aborting the server");
+			return false;
+		}
+		if (i == 0)
+		{
+			m_Generator = Generator;
+		}
+		cWorker * Worker = new cWorker(*this, Generator);
+		m_Workers.push_back(Worker);
+		if (!Worker->Start())
+		{
+			return false;
 		}
-		m_Generator = new cComposableGenerator(*this);
-	}
-
-	if (m_Generator == nullptr)
-	{
-		LOGERROR("Generator could not start, aborting the server");
-		return false;
 	}
-
-	m_Generator->Initialize(a_IniFile);
-
-	return super::Start();
+	return true;
 }
 
 
@@ -97,13 +96,25 @@ bool cChunkGenerator::Start(cPluginInterface & a_PluginInterface, cChunkSink & a
 
 void cChunkGenerator::Stop(void)
 {
-	m_ShouldTerminate = true;
-	m_Event.Set();
+	cWorkers Workers;
+	{
+		cCSLock Lock(m_CS);
+		m_ShouldTerminate = true;
+		std::swap(Workers, m_Workers);
+	}
 	m_evtRemoved.Set();  // Wake up anybody waiting for empty queue
-	Wait();
 
-	delete m_Generator;
+	for (cWorkers::iterator itr = Workers.begin(), end = Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->Stop();
+	}
+
+	// The first worker owns m_Generator, so clear it before the workers are deleted:
 	m_Generator = nullptr;
+	for (cWorkers::iterator itr = Workers.begin(), end = Workers.end(); itr != end; ++itr)
+	{
+		delete *itr;
+	}
 }
 
 
@@ -125,7 +136,7 @@ void cChunkGenerator::QueueGenerateChunk(int a_ChunkX, int a_ChunkZ, bool a_Forc
 		m_Queue.push_back(cQueueItem{a_ChunkX, a_ChunkZ, a_ForceGenerate, a_Callback});
 	}
 
-	m_Event.Set();
+	WakeUpWorkers();
 }
 
 
@@ -147,7 +158,7 @@ void cChunkGenerator::GenerateBiomes(int a_ChunkX, int a_ChunkZ, cChunkDef::Biom
 void cChunkGenerator::WaitForQueueEmpty(void)
 {
 	cCSLock Lock(m_CS);
-	while (!m_ShouldTerminate && !m_Queue.empty())
+	while (!m_ShouldTerminate && (!m_Queue.empty() || !m_InProgress.empty()))
 	{
 		cCSUnlock Unlock(Lock);
 		m_evtRemoved.Wait();
@@ -168,6 +179,16 @@ int cChunkGenerator::GetQueueLength(void)
 
 
 
+size_t cChunkGenerator::GetNumThreads(void)
+{
+	cCSLock Lock(m_CS);
+	return m_Workers.size();
+}
+
+
+
+
+
 EMCSBiome cChunkGenerator::GetBiomeAt(int a_BlockX, int a_BlockZ)
 {
 	ASSERT(m_Generator != nullptr);
@@ -194,19 +215,164 @@ BLOCKTYPE cChunkGenerator::GetIniBlock(cIniFile & a_IniFile, const AString & a_S
 
 
 
-void cChunkGenerator::Execute(void)
+cChunkGenerator::cGenerator * cChunkGenerator::CreateGenerator(cIniFile & a_IniFile)
 {
-	// To be able to display performance information, the generator counts the chunks generated.
-	// When the queue gets empty, the count is reset, so that waiting for the queue is not counted into the total time.
+	// Get the generator engine based on the INI file settings:
+	cGenerator * Generator = nullptr;
+	AString GeneratorName = a_IniFile.GetValueSet("Generator", "Generator", "Composable");
+	if (NoCaseCompare(GeneratorName, "Noise3D") == 0)
+	{
+		Generator = new cNoise3DGenerator(*this);
+	}
+	else
+	{
+		if (NoCaseCompare(GeneratorName, "composable") != 0)
+		{
+			LOGWARN("[Generator]::Generator value \"%s\" not recognized, using \"Composable\".", GeneratorName.c_str());
+		}
+		Generator = new cComposableGenerator(*this);
+	}
+
+	if (Generator != nullptr)
+	{
+		Generator->Initialize(a_IniFile);
+	}
+	return Generator;
+}
+
+
+
+
+
+bool cChunkGenerator::GetNextItem(cQueueItem & a_Item, int & a_Priority)
+{
+	cChunkScheduler::cSnapshot Scheduler;
+	m_ChunkSink->GetSchedulerSnapshot(Scheduler);
+
+	cCSLock Lock(m_CS);
+	if (m_ShouldTerminate)
+	{
+		return false;
+	}
+	cGenQueue::iterator Best = m_Queue.end();
+	int BestPriority = cChunkScheduler::UNWANTED;
+	for (cGenQueue::iterator itr = m_Queue.begin(), end = m_Queue.end(); itr != end; ++itr)
+	{
+		// Skip the item if another worker is generating the same chunk:
+		if (std::find(m_InProgress.begin(), m_InProgress.end(), cChunkCoords(itr->m_ChunkX, itr->m_ChunkZ)) != m_InProgress.end())
+		{
+			continue;
+		}
+
+		// Pick the item with the best priority; the older item wins on a tie:
+		int Priority = Scheduler.GetPriority(itr->m_ChunkX, itr->m_ChunkZ);
+		if ((Best == m_Queue.end()) || (Priority < BestPriority))
+		{
+			Best = itr;
+			BestPriority = Priority;
+			if (Priority == 0)
+			{
+				break;
+			}
+		}
+	}
+	if (Best == m_Queue.end())
+	{
+		return false;
+	}
+
+	a_Item = *Best;
+	a_Priority = BestPriority;
+	m_Queue.erase(Best);
+	m_InProgress.push_back(cChunkCoords(a_Item.m_ChunkX, a_Item.m_ChunkZ));
+	return true;
+}
+
+
+
+
+
+void cChunkGenerator::ItemFinished(int a_ChunkX, int a_ChunkZ)
+{
+	{
+		cCSLock Lock(m_CS);
+		m_InProgress.remove(cChunkCoords(a_ChunkX, a_ChunkZ));
+	}
+	m_evtRemoved.Set();
+
+	// Items for the same chunk may have become available to the other workers:
+	WakeUpWorkers();
+}
+
+
+
+
+
+void cChunkGenerator::WakeUpWorkers(void)
+{
+	cCSLock Lock(m_CS);
+	for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->WakeUp();
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkGenerator::cWorker:
+
+cChunkGenerator::cWorker::cWorker(cChunkGenerator & a_ChunkGenerator, cGenerator * a_Generator) :
+	super("cChunkGenerator"),
+	m_ChunkGenerator(a_ChunkGenerator),
+	m_Generator(a_Generator)
+{
+}
+
+
+
+
+
+cChunkGenerator::cWorker::~cWorker()
+{
+	delete m_Generator;
+	m_Generator = nullptr;
+}
+
+
+
+
+
+void cChunkGenerator::cWorker::Stop(void)
+{
+	m_ShouldTerminate = true;
+	m_evtItemAdded.Set();
+
+	Wait();
+}
+
+
+
+
+
+void cChunkGenerator::cWorker::Execute(void)
+{
+	// To be able to display performance information, the worker counts the chunks generated.
+	// When there's nothing to do, the count is reset, so that waiting for the queue is not counted into the total time.
 	int NumChunksGenerated = 0;  // Number of chunks generated since the queue was last empty
 	clock_t GenerationStart = clock();  // Clock tick when the queue started to fill
 	clock_t LastReportTick = clock();  // Clock tick of the last report made (so that performance isn't reported too often)
 
+	cChunkSink & ChunkSink = *m_ChunkGenerator.m_ChunkSink;
 	while (!m_ShouldTerminate)
 	{
-		cCSLock Lock(m_CS);
-		while (m_Queue.empty())
+		cQueueItem item;
+		int Priority;
+		if (!m_ChunkGenerator.GetNextItem(item, Priority))
 		{
+			// Nothing available for this worker, wait for an item to be queued or another worker to finish:
 			if ((NumChunksGenerated > 16) && (clock() - LastReportTick > CLOCKS_PER_SEC))
 			{
 				LOG("Chunk generator performance: %.2f ch/s (%d ch total)",
@@ -214,30 +380,13 @@ void cChunkGenerator::Execute(void)
 					NumChunksGenerated
 				);
 			}
-			cCSUnlock Unlock(Lock);
-			m_Event.Wait();
-			if (m_ShouldTerminate)
-			{
-				return;
-			}
+			m_evtItemAdded.Wait();
 			NumChunksGenerated = 0;
 			GenerationStart = clock();
 			LastReportTick = clock();
-		}
-
-		if (m_Queue.empty())
-		{
-			// Sometimes the queue remains empty
-			// If so, we can't do any front() operations on it!
 			continue;
 		}
 
-		cQueueItem item = m_Queue.front();  // Get next chunk from the queue
-		bool SkipEnabled = (m_Queue.size() > QUEUE_SKIP_LIMIT);
-		m_Queue.erase(m_Queue.begin());  // Remove the item from the queue
-		Lock.Unlock();  // Unlock ASAP
-		m_evtRemoved.Set();
-
 		// Display perf info once in a while:
 		if ((NumChunksGenerated > 16) && (clock() - LastReportTick > 2 * CLOCKS_PER_SEC))
 		{
@@ -248,59 +397,57 @@ void cChunkGenerator::Execute(void)
 			LastReportTick = clock();
 		}
 
-		// Skip the chunk if it's already generated and regeneration is not forced:
-		if (!item.m_ForceGenerate && m_ChunkSink->IsChunkValid(item.m_ChunkX, item.m_ChunkZ))
+		if (!item.m_ForceGenerate && ChunkSink.IsChunkValid(item.m_ChunkX, item.m_ChunkZ))
 		{
+			// Skip the chunk if it's already generated and regeneration is not forced:
 			LOGD("Chunk [%d, %d] already generated, skipping generation", item.m_ChunkX, item.m_ChunkZ);
-			if (item.m_Callback != nullptr)
-			{
-				item.m_Callback->Call(item.m_ChunkX, item.m_ChunkZ);
-			}
-			continue;
 		}
-
-		// Skip the chunk if the generator is overloaded:
-		if (SkipEnabled && !m_ChunkSink->HasChunkAnyClients(item.m_ChunkX, item.m_ChunkZ))
+		else if (
+			(Priority == cChunkScheduler::UNWANTED) && (item.m_Callback == nullptr) &&
+			ChunkSink.TryUnqueueUnwantedChunk(item.m_ChunkX, item.m_ChunkZ)
+		)
 		{
-			LOGWARNING("Chunk generator overloaded, skipping chunk [%d, %d]", item.m_ChunkX, item.m_ChunkZ);
-			if (item.m_Callback != nullptr)
-			{
-				item.m_Callback->Call(item.m_ChunkX, item.m_ChunkZ);
-			}
-			continue;
+			// Drop the request if nobody wants the chunk anymore:
+			LOGD("Chunk [%d, %d] no longer wanted, skipping generation", item.m_ChunkX, item.m_ChunkZ);
+		}
+		else
+		{
+			// Generate the chunk:
+			LOGD("Generating chunk [%d, %d]", item.m_ChunkX, item.m_ChunkZ);
+			DoGenerate(item.m_ChunkX, item.m_ChunkZ);
+			NumChunksGenerated++;
 		}
 
-		// Generate the chunk:
-		LOGD("Generating chunk [%d, %d]", item.m_ChunkX, item.m_ChunkZ);
-		DoGenerate(item.m_ChunkX, item.m_ChunkZ);
+		// The callback is called even if the chunk was skipped (but requests with a callback are never dropped):
 		if (item.m_Callback != nullptr)
 		{
 			item.m_Callback->Call(item.m_ChunkX, item.m_ChunkZ);
 		}
-		NumChunksGenerated++;
-	}  // while (!bStop)
+		m_ChunkGenerator.ItemFinished(item.m_ChunkX, item.m_ChunkZ);
+	}  // while (!m_ShouldTerminate)
 }
 
 
 
 
-void cChunkGenerator::DoGenerate(int a_ChunkX, int a_ChunkZ)
+
+void cChunkGenerator::cWorker::DoGenerate(int a_ChunkX, int a_ChunkZ)
 {
-	ASSERT(m_PluginInterface != nullptr);
-	ASSERT(m_ChunkSink != nullptr);
-	ASSERT(m_ChunkSink->IsChunkQueued(a_ChunkX, a_ChunkZ));
+	cPluginInterface & PluginInterface = *m_ChunkGenerator.m_PluginInterface;
+	cChunkSink & ChunkSink = *m_ChunkGenerator.m_ChunkSink;
+	ASSERT(ChunkSink.IsChunkQueued(a_ChunkX, a_ChunkZ));
 
 	cChunkDesc ChunkDesc(a_ChunkX, a_ChunkZ);
-	m_PluginInterface->CallHookChunkGenerating(ChunkDesc);
+	PluginInterface.CallHookChunkGenerating(ChunkDesc);
 	m_Generator->DoGenerate(a_ChunkX, a_ChunkZ, ChunkDesc);
-	m_PluginInterface->CallHookChunkGenerated(ChunkDesc);
+	PluginInterface.CallHookChunkGenerated(ChunkDesc);
 
 	#ifdef _DEBUG
 	// Verify that the generator has produced valid data:
 	ChunkDesc.VerifyHeightmap();
 	#endif
 
-	m_ChunkSink->OnChunkGenerated(ChunkDesc);
+	ChunkSink.OnChunkGenerated(ChunkDesc);
 }
 
 
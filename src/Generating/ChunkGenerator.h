@@ -1,15 +1,18 @@
 
 // ChunkGenerator.h
 
-// Interfaces to the cChunkGenerator class representing the thread that generates chunks
+// Interfaces to the cChunkGenerator class representing the pool of threads that generate chunks
 
 /*
-The object takes requests for generating chunks and processes them in a separate thread one by one.
-The requests are not added to the queue if there is already a request with the same coords
-Before generating, the thread checks if the chunk hasn't been already generated.
-It is theoretically possible to have multiple generator threads by having multiple instances of this object,
-but then it MAY happen that the chunk is generated twice.
-If the generator queue is overloaded, the generator skips chunks with no clients in them
+The object takes requests for generating chunks and processes them in a pool of worker threads.
+Each worker (cChunkGenerator::cWorker) has its own generator engine instance, because the engines keep
+per-instance scratch state (caches, noise arrays) that is not safe to share across threads.
+A worker takes the queued chunk with the best priority from the world's cChunkScheduler (nearest to a player
+who wants it), rather than the oldest one, so that the chunks around the players get generated first.
+A chunk that is being generated by one worker is not taken by another worker, so the same chunk is never
+generated twice in parallel.
+Before generating, the worker checks if the chunk hasn't been already generated.
+Requests for chunks that no player wants anymore are dropped, unless they have a callback or a ChunkStay needs the chunk.
 */
 
 
@@ -20,6 +23,7 @@ If the generator queue is overloaded, the generator skips chunks with no clients
 
 #include "../OSSupport/IsThread.h"
 #include "../ChunkDef.h"
+#include "../ChunkScheduler.h"
 
 
 
@@ -33,11 +37,8 @@ class cChunkDesc;
 
 
 
-class cChunkGenerator :
-	cIsThread
+class cChunkGenerator
 {
-	typedef cIsThread super;
-	
 public:
 	/** The interface that a class has to implement to become a generator */
 	class cGenerator
@@ -102,20 +103,25 @@ public:
 		*/
 		virtual bool IsChunkValid(int a_ChunkX, int a_ChunkZ) = 0;
 		
-		/** Called when the generator is overloaded to skip chunks that are no longer needed.
-		If this callback returns false, the chunk is not generated.
-		*/
-		virtual bool HasChunkAnyClients(int a_ChunkX, int a_ChunkZ) = 0;
-
 		/** Called to check whether the specified chunk is in the queued state.
 		Currently used only in Debug-mode asserts. */
 		virtual bool IsChunkQueued(int a_ChunkX, int a_ChunkZ) = 0;
+
+		/** Called before picking the next chunk to generate, to get the current player positions
+		by which the queued chunks are prioritized. */
+		virtual void GetSchedulerSnapshot(cChunkScheduler::cSnapshot & a_Snapshot) = 0;
+
+		/** Called for a chunk that no player wants anymore, before generating it.
+		If this callback returns true, the request is dropped and the chunk is not generated. */
+		virtual bool TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ) = 0;
 	} ;
 	
 
 	cChunkGenerator (void);
 	~cChunkGenerator();
 
+	/** Creates the generator engines and starts the worker threads.
+	The number of the threads is read from the [Generator] NumThreads ini value. */
 	bool Start(cPluginInterface & a_PluginInterface, cChunkSink & a_ChunkSink, cIniFile & a_IniFile);
 	void Stop(void);
 
@@ -123,7 +129,7 @@ public:
 	If a-ForceGenerate is set, the chunk is regenerated even if the data is already present in the chunksink.
 	a_Callback is called after the chunk is generated. If the chunk was already present, the callback is still called, even if not regenerating.
 	It is legal to set the callback to nullptr, no callback is called then.
-	If the generator becomes overloaded and skips this chunk, the callback is still called. */
+	Requests with a callback are never dropped as unwanted. */
 	void QueueGenerateChunk(int a_ChunkX, int a_ChunkZ, bool a_ForceGenerate, cChunkCoordCallback * a_Callback = nullptr);
 	
 	/// Generates the biomes for the specified chunk (directly, not in a separate thread). Used by the world loader if biomes failed loading.
@@ -133,6 +139,9 @@ public:
 	
 	int GetQueueLength(void);
 	
+	/** Returns the number of worker threads generating the chunks. */
+	size_t GetNumThreads(void);
+	
 	int GetSeed(void) const { return m_Seed; }
 	
 	/** Returns the biome at the specified coords. Used by ChunkMap if an invalid chunk is queried for biome */
@@ -156,6 +165,43 @@ private:
 	};
 
 	typedef std::list<cQueueItem> cGenQueue;
+	
+	
+	/** A single generator thread, with its own generator engine and chunk scratch. */
+	class cWorker :
+		public cIsThread
+	{
+		typedef cIsThread super;
+		
+	public:
+		
+		/** Creates a new worker; takes ownership of a_Generator. */
+		cWorker(cChunkGenerator & a_ChunkGenerator, cGenerator * a_Generator);
+		virtual ~cWorker();
+		
+		/** Signals the thread to terminate and waits until it's finished. */
+		void Stop(void);
+		
+		/** Wakes the thread up if it's waiting for an item to process. */
+		void WakeUp(void) { m_evtItemAdded.Set(); }
+		
+	protected:
+		
+		cChunkGenerator & m_ChunkGenerator;
+		
+		/** The generator engine used by this worker. Owned by the worker. */
+		cGenerator * m_Generator;
+		
+		/** Set when an item may be available for this worker, or to stop the thread */
+		cEvent m_evtItemAdded;
+		
+		virtual void Execute(void) override;
+		
+		/** Generates the specified chunk and sets it into the chunksink. */
+		void DoGenerate(int a_ChunkX, int a_ChunkZ);
+	} ;
+	
+	typedef std::vector<cWorker *> cWorkers;
 
 
 	/** Seed used for the generator. */
@@ -167,13 +213,20 @@ private:
 	/** Queue of the chunks to be generated. Protected against multithreaded access by m_CS. */
 	cGenQueue m_Queue;
 
-	/** Set when an item is added to the queue or the thread should terminate. */
-	cEvent m_Event;
+	/** Chunks currently being generated by the workers. Protected against multithreaded access by m_CS. */
+	cChunkCoordsList m_InProgress;
+
+	/** The worker threads. Protected against multithreaded access by m_CS. */
+	cWorkers m_Workers;
+
+	/** Set when the workers should terminate; makes the WaitForQueueEmpty() waiters return. */
+	bool m_ShouldTerminate;
 
 	/** Set when an item is removed from the queue. */
 	cEvent m_evtRemoved;
 	
-	/** The actual generator engine used to generate chunks. */
+	/** The generator engine used for the direct biome requests from other threads (GenerateBiomes(), GetBiomeAt()).
+	It is shared with the first worker. */
 	cGenerator * m_Generator;
 	
 	/** The plugin interface that may modify the generated chunks */
@@ -182,14 +235,23 @@ private:
 	/** The destination where the generated chunks are sent */
 	cChunkSink * m_ChunkSink;
 	
+	
+	/** Creates a new generator engine based on the ini file settings and initializes it. */
+	cGenerator * CreateGenerator(cIniFile & a_IniFile);
+
+	/** Removes the queued item with the best priority, whose chunk isn't being generated by another worker,
+	and marks the chunk as in-progress. Returns false if there's no such item.
+	a_Priority is set to the item's priority, as given by the cChunkScheduler. */
+	bool GetNextItem(cQueueItem & a_Item, int & a_Priority);
 
-	// cIsThread override:
-	virtual void Execute(void) override;
+	/** Marks the chunk as no longer in progress and wakes up the workers that may be waiting for it. */
+	void ItemFinished(int a_ChunkX, int a_ChunkZ);
 
-	/** Generates the specified chunk and sets it into the chunksink. */
-	void DoGenerate(int a_ChunkX, int a_ChunkZ);
+	/** Wakes up all the workers. */
+	void WakeUpWorkers(void);
 };
 
 
 
 
+
@@ -57,6 +57,9 @@ protected:
 	int m_NumHits;
 	int m_NumMisses;
 	int m_TotalChain;  // Number of cache items walked to get to a hit (only added for hits)
+	
+	/** Protects the cache data and the underlying generator against multithreaded access. */
+	cCriticalSection m_CS;
 } ;
 
 
@@ -89,6 +92,10 @@ protected:
 
 	/** The individual sub-caches. */
 	cHeiGenCachePtrs m_SubCaches;
+
+	/** Protects the sub-caches against multithreaded access.
+	The sub-caches share the underlying generator, which isn't thread-safe by itself. */
+	cCriticalSection m_CS;
 };
 
 
@@ -252,6 +252,7 @@ template class SizeChecker<UInt16, 2>;
 #include <set>
 #include <queue>
 #include <limits>
+#include <atomic>
 #include <chrono>
 
 
@@ -298,6 +299,25 @@ void inline LOGD(const char* a_Format, ...)
 	va_end(argList);
 }
 
+void inline LOG(const char* a_Format, ...) FORMATSTRING(1, 2);
+
+void inline LOG(const char* a_Format, ...)
+{
+	va_list argList;
+	va_start(argList, a_Format);
+	vprintf(a_Format, argList);
+	va_end(argList);
+}
+
+#define LOGINFO LOG
+#define LOGWARN LOGWARNING
+
+	// Common headers (part 1, without macros), for the tests that exercise the threading and file code:
+	#include "StringUtils.h"
+	#include "OSSupport/CriticalSection.h"
+	#include "OSSupport/Event.h"
+	#include "OSSupport/File.h"
+
 #endif
 
 
@@ -358,7 +378,11 @@ void inline LOGD(const char* a_Format, ...)
 #endif
 
 // Pretty much the same as ASSERT() but stays in Release builds
-#define VERIFY( x) ( !!(x) || ( LOGERROR("Verification failed: %s, file %s, line %i", #x, __FILE__, __LINE__), PrintStackTrace(), exit(1), 0))
+#ifdef TEST_GLOBALS
+	#define VERIFY( x) ( !!(x) || ( LOGERROR("Verification failed: %s, file %s, line %i", #x, __FILE__, __LINE__), exit(1), 0))
+#else
+	#define VERIFY( x) ( !!(x) || ( LOGERROR("Verification failed: %s, file %s, line %i", #x, __FILE__, __LINE__), PrintStackTrace(), exit(1), 0))
+#endif
 
 // Same as assert but in all Self test builds
 #ifdef SELF_TEST
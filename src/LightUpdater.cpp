@@ -0,0 +1,250 @@
+
+// LightUpdater.cpp
+
+// Implements the cLightUpdater class that updates the light around a single changed block
+
+#include "Globals.h"
+#include "LightUpdater.h"
+#include "Chunk.h"
+#include "BlockInfo.h"
+
+
+
+
+
+/** The offsets of the six neighbors of a block, in which the light spreads. */
+static const Vector3i g_NeighborOffsets[] =
+{
+	Vector3i( 1,  0,  0),
+	Vector3i(-1,  0,  0),
+	Vector3i( 0,  1,  0),
+	Vector3i( 0, -1,  0),
+	Vector3i( 0,  0,  1),
+	Vector3i( 0,  0, -1),
+} ;
+
+
+
+
+
+cLightUpdater::cLightUpdater(cChunk & a_Chunk) :
+	m_Chunk(a_Chunk),
+	m_NumLightChanges(0),
+	m_HasReachedUnlitChunk(false)
+{
+}
+
+
+
+
+
+void cLightUpdater::BlockChanged(int a_RelX, int a_RelY, int a_RelZ, int a_OldHeight)
+{
+	cPositions Changed;
+	Changed.push_back(Vector3i(a_RelX, a_RelY, a_RelZ));
+	Update(false, Changed);
+
+	// For skylight, the blocks between the old and the new height have changed their "above the heightmap" status, too:
+	int NewHeight = m_Chunk.GetHeight(a_RelX, a_RelZ);
+	for (int y = std::min(a_OldHeight, NewHeight) + 1, MaxY = std::max(a_OldHeight, NewHeight); y <= MaxY; y++)
+	{
+		if (y != a_RelY)
+		{
+			Changed.push_back(Vector3i(a_RelX, y, a_RelZ));
+		}
+	}
+	Update(true, Changed);
+}
+
+
+
+
+
+void cLightUpdater::Update(bool a_IsSkyLight, const cPositions & a_Changed)
+{
+	cRemovals Removals;
+	cPositions Removed;
+	cPositions Seeds;
+
+	// Remove the light of the changed blocks:
+	for (cPositions::const_iterator itr = a_Changed.begin(), end = a_Changed.end(); itr != end; ++itr)
+	{
+		NIBBLETYPE Light;
+		BLOCKTYPE BlockType;
+		if (!GetBlockLight(a_IsSkyLight, *itr, Light, BlockType) || (Light == 0))
+		{
+			continue;
+		}
+		SetBlockLight(a_IsSkyLight, *itr, 0);
+		Removals.push_back(sRemoval(*itr, Light));
+		Removed.push_back(*itr);
+	}
+
+	// Spread the removal into the neighbors that may have been lit by the removed blocks:
+	for (size_t i = 0; i < Removals.size(); i++)
+	{
+		sRemoval Removal = Removals[i];  // Copy, the vector may get reallocated in the loop
+		for (size_t n = 0; n < ARRAYCOUNT(g_NeighborOffsets); n++)
+		{
+			Vector3i Neighbor = Removal.m_Pos + g_NeighborOffsets[n];
+			NIBBLETYPE NeighborLight;
+			BLOCKTYPE NeighborBlockType;
+			if (!GetBlockLight(a_IsSkyLight, Neighbor, NeighborLight, NeighborBlockType) || (NeighborLight == 0))
+			{
+				continue;
+			}
+			if (NeighborLight < Removal.m_Light)
+			{
+				// The neighbor may have been lit by the removed block, remove its light as well:
+				SetBlockLight(a_IsSkyLight, Neighbor, 0);
+				Removals.push_back(sRemoval(Neighbor, NeighborLight));
+				Removed.push_back(Neighbor);
+			}
+			else
+			{
+				// The neighbor is lit by a different source, it will spread its light back into the removed area:
+				Seeds.push_back(Neighbor);
+			}
+		}  // for n - g_NeighborOffsets[]
+	}  // for i - Removals[]
+
+	// The light sources among the removed and changed blocks get their own light back:
+	Removed.insert(Removed.end(), a_Changed.begin(), a_Changed.end());
+	for (cPositions::const_iterator itr = Removed.begin(), end = Removed.end(); itr != end; ++itr)
+	{
+		NIBBLETYPE Light;
+		BLOCKTYPE BlockType;
+		if (!GetBlockLight(a_IsSkyLight, *itr, Light, BlockType))
+		{
+			continue;
+		}
+		NIBBLETYPE SourceLight = GetSourceLight(a_IsSkyLight, *itr);
+		if (SourceLight > Light)
+		{
+			SetBlockLight(a_IsSkyLight, *itr, SourceLight);
+			Seeds.push_back(*itr);
+		}
+	}
+
+	// The neighbors of the changed blocks may spread light into them, if they became more transparent:
+	for (cPositions::const_iterator itr = a_Changed.begin(), end = a_Changed.end(); itr != end; ++itr)
+	{
+		for (size_t n = 0; n < ARRAYCOUNT(g_NeighborOffsets); n++)
+		{
+			Seeds.push_back(*itr + g_NeighborOffsets[n]);
+		}
+	}
+
+	// Spread the light from the seeds, the same way cLightingThread does:
+	for (size_t i = 0; i < Seeds.size(); i++)
+	{
+		Vector3i Seed = Seeds[i];  // Copy, the vector may get reallocated in the loop
+		NIBBLETYPE SeedLight;
+		BLOCKTYPE SeedBlockType;
+		if (!GetBlockLight(a_IsSkyLight, Seed, SeedLight, SeedBlockType) || (SeedLight <= 1))
+		{
+			continue;
+		}
+		for (size_t n = 0; n < ARRAYCOUNT(g_NeighborOffsets); n++)
+		{
+			Vector3i Neighbor = Seed + g_NeighborOffsets[n];
+			NIBBLETYPE NeighborLight;
+			BLOCKTYPE NeighborBlockType;
+			if (!GetBlockLight(a_IsSkyLight, Neighbor, NeighborLight, NeighborBlockType))
+			{
+				continue;
+			}
+			NIBBLETYPE Falloff = cBlockInfo::GetSpreadLightFalloff(NeighborBlockType);
+			if (SeedLight <= NeighborLight + Falloff)
+			{
+				// We're not offering more light than the neighbor already has
+				continue;
+			}
+			SetBlockLight(a_IsSkyLight, Neighbor, SeedLight - Falloff);
+			Seeds.push_back(Neighbor);
+		}  // for n - g_NeighborOffsets[]
+	}  // for i - Seeds[]
+}
+
+
+
+
+
+cChunk * cLightUpdater::GetChunk(int & a_RelX, int a_RelY, int & a_RelZ) const
+{
+	if ((a_RelY < 0) || (a_RelY >= cChunkDef::Height))
+	{
+		return nullptr;
+	}
+	cChunk * Chunk = m_Chunk.GetRelNeighborChunkAdjustCoords(a_RelX, a_RelZ);
+	if ((Chunk == nullptr) || !Chunk->IsValid())
+	{
+		return nullptr;
+	}
+	if (!Chunk->IsLightValid())
+	{
+		m_HasReachedUnlitChunk = true;
+		return nullptr;
+	}
+	return Chunk;
+}
+
+
+
+
+
+bool cLightUpdater::GetBlockLight(bool a_IsSkyLight, const Vector3i & a_Pos, NIBBLETYPE & a_Light, BLOCKTYPE & a_BlockType) const
+{
+	int RelX = a_Pos.x;
+	int RelZ = a_Pos.z;
+	cChunk * Chunk = GetChunk(RelX, a_Pos.y, RelZ);
+	if (Chunk == nullptr)
+	{
+		return false;
+	}
+	a_Light = a_IsSkyLight ? Chunk->GetSkyLight(RelX, a_Pos.y, RelZ) : Chunk->GetBlockLight(RelX, a_Pos.y, RelZ);
+	a_BlockType = Chunk->GetBlock(RelX, a_Pos.y, RelZ);
+	return true;
+}
+
+
+
+
+
+void cLightUpdater::SetBlockLight(bool a_IsSkyLight, const Vector3i & a_Pos, NIBBLETYPE a_Light)
+{
+	int RelX = a_Pos.x;
+	int RelZ = a_Pos.z;
+	cChunk * Chunk = GetChunk(RelX, a_Pos.y, RelZ);
+	ASSERT(Chunk != nullptr);
+	if (a_IsSkyLight)
+	{
+		Chunk->SetSkyLight(RelX, a_Pos.y, RelZ, a_Light);
+	}
+	else
+	{
+		Chunk->SetBlockLight(RelX, a_Pos.y, RelZ, a_Light);
+	}
+	m_NumLightChanges += 1;
+}
+
+
+
+
+
+NIBBLETYPE cLightUpdater::GetSourceLight(bool a_IsSkyLight, const Vector3i & a_Pos) const
+{
+	int RelX = a_Pos.x;
+	int RelZ = a_Pos.z;
+	cChunk * Chunk = GetChunk(RelX, a_Pos.y, RelZ);
+	ASSERT(Chunk != nullptr);
+	if (a_IsSkyLight)
+	{
+		return (a_Pos.y > Chunk->GetHeight(RelX, RelZ)) ? 15 : 0;
+	}
+	return cBlockInfo::GetLightValue(Chunk->GetBlock(RelX, a_Pos.y, RelZ));
+}
+
+
+
+
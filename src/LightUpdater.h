@@ -0,0 +1,110 @@
+
+// LightUpdater.h
+
+// Declares the cLightUpdater class that updates the light around a single changed block
+
+/*
+Instead of re-lighting the whole 3x3 chunk area through the cLightingThread, a single block change only
+updates the light values of the blocks that are actually affected, in a flood-fill fashion within the chunkmap:
+1. Removal: for each block whose light source value may have changed (the changed block itself, and for skylight
+	also the column blocks whose "above the heightmap" status changed), its light is zeroed and the zeroing spreads
+	to all the neighbors that may have received their light from it (neighbor light lower than the removed light).
+	Neighbors with light equal or higher than the removed light are lit by a different source, they become seeds.
+2. The light sources among the zeroed blocks get their source value back and become seeds, as do the neighbors of the
+	changed block, so that light may flow into the changed block if it became more transparent.
+3. Addition: the seeds spread their light into their neighbors the same way as cLightingThread::PropagateLight() does.
+Only chunks that are valid and have valid light are touched, other chunks will get lighted as a whole later on.
+When the update reaches a loaded chunk whose light isn't valid yet, the light that should have flowed through it is missing,
+so the updater reports it (HasReachedUnlitChunk()) and the changed chunk falls back to being lighted as a whole, too.
+*/
+
+
+
+
+
+#pragma once
+
+#include "ChunkDef.h"
+#include "Vector3.h"
+
+
+
+
+
+// fwd: Chunk.h
+class cChunk;
+
+
+
+
+
+class cLightUpdater
+{
+public:
+	/** Creates an updater for block changes in the specified chunk. The chunk must have valid light. */
+	cLightUpdater(cChunk & a_Chunk);
+
+	/** Updates both the blocklight and the skylight after the block at the specified relative coords has changed.
+	The chunk's blocktype and heightmap must already contain the new values, a_OldHeight is the heightmap value
+	of the block's column before the change. */
+	void BlockChanged(int a_RelX, int a_RelY, int a_RelZ, int a_OldHeight);
+
+	/** Returns the number of light values that were changed by the updates so far. */
+	size_t GetNumLightChanges(void) const { return m_NumLightChanges; }
+
+	/** Returns true if the updates reached a loaded chunk without valid light, so their result may be incomplete
+	and the changed chunk needs to be lighted as a whole. */
+	bool HasReachedUnlitChunk(void) const { return m_HasReachedUnlitChunk; }
+
+protected:
+
+	/** A block whose light is being removed, with the light value it had before the removal. */
+	struct sRemoval
+	{
+		Vector3i m_Pos;
+		NIBBLETYPE m_Light;
+
+		sRemoval(const Vector3i & a_Pos, NIBBLETYPE a_Light) :
+			m_Pos(a_Pos),
+			m_Light(a_Light)
+		{
+		}
+	};
+
+	typedef std::vector<Vector3i> cPositions;
+	typedef std::vector<sRemoval> cRemovals;
+
+
+	/** The chunk to which all the coords are relative. */
+	cChunk & m_Chunk;
+
+	/** The number of light values changed so far. */
+	size_t m_NumLightChanges;
+
+	/** Set when a block in a loaded chunk without valid light was skipped, see HasReachedUnlitChunk(). */
+	mutable bool m_HasReachedUnlitChunk;
+
+
+	/** Updates the specified light type for the blocks whose source light value may have changed. */
+	void Update(bool a_IsSkyLight, const cPositions & a_Changed);
+
+	/** Returns the chunk containing the specified block (in m_Chunk-relative coords) and adjusts the coords to be relative to it.
+	Returns nullptr if the block is not available for lighting (outside the world height, chunk not loaded or not lighted).
+	Sets m_HasReachedUnlitChunk if the chunk is loaded but not lighted. */
+	cChunk * GetChunk(int & a_RelX, int a_RelY, int & a_RelZ) const;
+
+	/** Retrieves the light value and the blocktype at the specified m_Chunk-relative coords.
+	Returns false if the block is not available for lighting. */
+	bool GetBlockLight(bool a_IsSkyLight, const Vector3i & a_Pos, NIBBLETYPE & a_Light, BLOCKTYPE & a_BlockType) const;
+
+	/** Sets the light value at the specified m_Chunk-relative coords. The block must be available for lighting. */
+	void SetBlockLight(bool a_IsSkyLight, const Vector3i & a_Pos, NIBBLETYPE a_Light);
+
+	/** Returns the light that the block at the specified m_Chunk-relative coords emits by itself
+	(the blocktype's light value for blocklight, full light above the heightmap for skylight). */
+	NIBBLETYPE GetSourceLight(bool a_IsSkyLight, const Vector3i & a_Pos) const;
+} ;
+
+
+
+
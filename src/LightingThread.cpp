@@ -1,7 +1,7 @@
 
 // LightingThread.cpp
 
-// Implements the cLightingThread class representing the thread that processes requests for lighting
+// Implements the cLightingThread class representing the pool of threads that process requests for lighting
 
 #include "Globals.h"
 #include "LightingThread.h"
@@ -90,10 +90,12 @@ public:
 // cLightingThread:
 
 cLightingThread::cLightingThread(void) :
-	super("cLightingThread"),
 	m_World(nullptr),
-	m_MaxHeight(0),
-	m_NumSeeds(0)
+	m_ShouldTerminate(false),
+	m_NumChunksLighted(0),
+	m_TotalLatency(0),
+	m_MaxLatency(0),
+	m_TotalLightingTime(0)
 {
 }
 
@@ -110,12 +112,24 @@ cLightingThread::~cLightingThread()
 
 
 
-bool cLightingThread::Start(cWorld * a_World)
+bool cLightingThread::Start(cWorld * a_World, int a_NumThreads)
 {
 	ASSERT(m_World == nullptr);  // Not started yet
+	ASSERT(m_Workers.empty());
 	m_World = a_World;
+	m_ShouldTerminate = false;
 	
-	return super::Start();
+	cCSLock Lock(m_CS);
+	for (int i = 0; i < std::max(a_NumThreads, 1); i++)
+	{
+		cWorker * Worker = new cWorker(*this, *a_World);
+		m_Workers.push_back(Worker);
+		if (!Worker->Start())
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 
@@ -124,8 +138,10 @@ bool cLightingThread::Start(cWorld * a_World)
 
 void cLightingThread::Stop(void)
 {
+	cWorkers Workers;
 	{
 		cCSLock Lock(m_CS);
+		m_ShouldTerminate = true;
 		for (cChunkStays::iterator itr = m_PendingQueue.begin(), end = m_PendingQueue.end(); itr != end; ++itr)
 		{
 			(*itr)->Disable();
@@ -138,11 +154,15 @@ void cLightingThread::Stop(void)
 			delete *itr;
 		}
 		m_Queue.clear();
+		std::swap(Workers, m_Workers);
 	}
-	m_ShouldTerminate = true;
-	m_evtItemAdded.Set();
 	
-	Wait();
+	for (cWorkers::iterator itr = Workers.begin(), end = Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->Stop();
+		delete *itr;
+	}
+	m_evtQueueEmpty.Set();
 }
 
 
@@ -170,7 +190,7 @@ void cLightingThread::QueueChunk(int a_ChunkX, int a_ChunkZ, cChunkCoordCallback
 void cLightingThread::WaitForQueueEmpty(void)
 {
 	cCSLock Lock(m_CS);
-	while (!m_ShouldTerminate && (!m_Queue.empty() || !m_PendingQueue.empty()))
+	while (!m_ShouldTerminate && (!m_Queue.empty() || !m_PendingQueue.empty() || !m_InProgress.empty()))
 	{
 		cCSUnlock Unlock(Lock);
 		m_evtQueueEmpty.Wait();
@@ -191,41 +211,191 @@ size_t cLightingThread::GetQueueLength(void)
 
 
 
-void cLightingThread::Execute(void)
+size_t cLightingThread::GetNumThreads(void)
+{
+	cCSLock Lock(m_CS);
+	return m_Workers.size();
+}
+
+
+
+
+
+size_t cLightingThread::GetNumChunksLighted(void)
+{
+	cCSLock Lock(m_CS);
+	return m_NumChunksLighted;
+}
+
+
+
+
+
+double cLightingThread::GetAverageLatency(void)
 {
-	for (;;)
+	cCSLock Lock(m_CS);
+	return (m_NumChunksLighted > 0) ? (m_TotalLatency / m_NumChunksLighted) : 0;
+}
+
+
+
+
+
+double cLightingThread::GetMaxLatency(void)
+{
+	cCSLock Lock(m_CS);
+	return m_MaxLatency;
+}
+
+
+
+
+
+double cLightingThread::GetAverageLightingTime(void)
+{
+	cCSLock Lock(m_CS);
+	return (m_NumChunksLighted > 0) ? (m_TotalLightingTime / m_NumChunksLighted) : 0;
+}
+
+
+
+
+
+void cLightingThread::QueueChunkStay(cLightingChunkStay & a_ChunkStay)
+{
+	// Move the ChunkStay from the Pending queue to the lighting queue.
 	{
+		cCSLock Lock(m_CS);
+		m_PendingQueue.remove(&a_ChunkStay);
+		m_Queue.push_back(&a_ChunkStay);
+	}
+	WakeUpWorkers();
+}
+
+
+
+
+
+cLightingThread::cLightingChunkStay * cLightingThread::GetNextItem(void)
+{
+	cCSLock Lock(m_CS);
+	if (m_ShouldTerminate)
+	{
+		return nullptr;
+	}
+	for (cChunkStays::iterator itr = m_Queue.begin(), end = m_Queue.end(); itr != end; ++itr)
+	{
+		cLightingChunkStay * Item = static_cast<cLightingChunkStay *>(*itr);
+		
+		// Skip the item if another worker is lighting a chunk whose 3x3 area contains this item's chunk:
+		bool IsAdjacent = false;
+		for (cChunkCoordsList::const_iterator itrP = m_InProgress.begin(), endP = m_InProgress.end(); itrP != endP; ++itrP)
 		{
-			cCSLock Lock(m_CS);
-			if (m_Queue.size() == 0)
+			if ((std::abs(itrP->m_ChunkX - Item->m_ChunkX) <= 1) && (std::abs(itrP->m_ChunkZ - Item->m_ChunkZ) <= 1))
 			{
-				cCSUnlock Unlock(Lock);
-				m_evtItemAdded.Wait();
+				IsAdjacent = true;
+				break;
 			}
 		}
-		
-		if (m_ShouldTerminate)
+		if (IsAdjacent)
 		{
-			return;
+			continue;
 		}
 		
-		// Process one items from the queue:
-		cLightingChunkStay * Item;
+		m_Queue.erase(itr);
+		m_InProgress.push_back(cChunkCoords(Item->m_ChunkX, Item->m_ChunkZ));
+		return Item;
+	}
+	return nullptr;
+}
+
+
+
+
+
+void cLightingThread::ItemFinished(cLightingChunkStay & a_Item, double a_LightingTime)
+{
+	double Latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - a_Item.m_QueuedTime).count();
+	bool IsEmpty;
+	{
+		cCSLock Lock(m_CS);
+		m_InProgress.remove(cChunkCoords(a_Item.m_ChunkX, a_Item.m_ChunkZ));
+		m_NumChunksLighted += 1;
+		m_TotalLatency += Latency;
+		m_MaxLatency = std::max(m_MaxLatency, Latency);
+		m_TotalLightingTime += a_LightingTime;
+		IsEmpty = m_Queue.empty() && m_InProgress.empty();
+	}
+	if (IsEmpty)
+	{
+		m_evtQueueEmpty.Set();
+	}
+	
+	// Items adjacent to the finished one may have become available to the other workers:
+	WakeUpWorkers();
+}
+
+
+
+
+
+void cLightingThread::WakeUpWorkers(void)
+{
+	cCSLock Lock(m_CS);
+	for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->WakeUp();
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cLightingThread::cWorker:
+
+cLightingThread::cWorker::cWorker(cLightingThread & a_LightingThread, cWorld & a_World) :
+	super("cLightingThread"),
+	m_LightingThread(a_LightingThread),
+	m_World(a_World),
+	m_MaxHeight(0),
+	m_NumSeeds(0)
+{
+}
+
+
+
+
+
+void cLightingThread::cWorker::Stop(void)
+{
+	m_ShouldTerminate = true;
+	m_evtItemAdded.Set();
+	
+	Wait();
+}
+
+
+
+
+
+void cLightingThread::cWorker::Execute(void)
+{
+	while (!m_ShouldTerminate)
+	{
+		cLightingChunkStay * Item = m_LightingThread.GetNextItem();
+		if (Item == nullptr)
 		{
-			cCSLock Lock(m_CS);
-			if (m_Queue.empty())
-			{
-				continue;
-			}
-			Item = (cLightingChunkStay *)m_Queue.front();
-			m_Queue.pop_front();
-			if (m_Queue.empty())
-			{
-				m_evtQueueEmpty.Set();
-			}
-		}  // CSLock(m_CS)
+			// Nothing available for this worker, wait for an item to be queued or another worker to finish:
+			m_evtItemAdded.Wait();
+			continue;
+		}
 		
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
 		LightChunk(*Item);
+		double LightingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+		m_LightingThread.ItemFinished(*Item, LightingTime);
 		Item->Disable();
 		delete Item;
 	}
@@ -236,10 +406,10 @@ void cLightingThread::Execute(void)
 
 
 
-void cLightingThread::LightChunk(cLightingChunkStay & a_Item)
+void cLightingThread::cWorker::LightChunk(cLightingChunkStay & a_Item)
 {
 	// If the chunk is already lit, skip it:
-	if (m_World->IsChunkLighted(a_Item.m_ChunkX, a_Item.m_ChunkZ))
+	if (m_World.IsChunkLighted(a_Item.m_ChunkX, a_Item.m_ChunkZ))
 	{
 		if (a_Item.m_CallbackAfter != nullptr)
 		{
@@ -320,7 +490,7 @@ void cLightingThread::LightChunk(cLightingChunkStay & a_Item)
 	CompressLight(m_BlockLight, BlockLight);
 	CompressLight(m_SkyLight, SkyLight);
 	
-	m_World->ChunkLighted(a_Item.m_ChunkX, a_Item.m_ChunkZ, BlockLight, SkyLight);
+	m_World.ChunkLighted(a_Item.m_ChunkX, a_Item.m_ChunkZ, BlockLight, SkyLight);
 
 	if (a_Item.m_CallbackAfter != nullptr)
 	{
@@ -332,7 +502,7 @@ void cLightingThread::LightChunk(cLightingChunkStay & a_Item)
 
 
 
-void cLightingThread::ReadChunks(int a_ChunkX, int a_ChunkZ)
+void cLightingThread::cWorker::ReadChunks(int a_ChunkX, int a_ChunkZ)
 {
 	cReader Reader(m_BlockTypes, m_HeightMap);
 	
@@ -342,7 +512,7 @@ void cLightingThread::ReadChunks(int a_ChunkX, int a_ChunkZ)
 		for (int x = 0; x < 3; x++)
 		{
 			Reader.m_ReadingChunkX = x;
-			VERIFY(m_World->GetChunkData(a_ChunkX + x - 1, a_ChunkZ + z - 1, Reader));
+			VERIFY(m_World.GetChunkData(a_ChunkX + x - 1, a_ChunkZ + z - 1, Reader));
 		}  // for z
 	}  // for x
 	
@@ -355,7 +525,7 @@ void cLightingThread::ReadChunks(int a_ChunkX, int a_ChunkZ)
 
 
 
-void cLightingThread::PrepareSkyLight(void)
+void cLightingThread::cWorker::PrepareSkyLight(void)
 {
 	// Clear seeds:
 	memset(m_IsSeed1, 0, sizeof(m_IsSeed1));
@@ -403,7 +573,7 @@ void cLightingThread::PrepareSkyLight(void)
 
 
 
-void cLightingThread::PrepareBlockLight(void)
+void cLightingThread::cWorker::PrepareBlockLight(void)
 {
 	// Clear seeds:
 	memset(m_IsSeed1, 0, sizeof(m_IsSeed1));
@@ -439,7 +609,7 @@ void cLightingThread::PrepareBlockLight(void)
 
 
 
-void cLightingThread::PrepareBlockLight2(void)
+void cLightingThread::cWorker::PrepareBlockLight2(void)
 {
 	// Clear seeds:
 	memset(m_IsSeed1, 0, sizeof(m_IsSeed1));
@@ -483,7 +653,7 @@ void cLightingThread::PrepareBlockLight2(void)
 
 
 
-void cLightingThread::CalcLight(NIBBLETYPE * a_Light)
+void cLightingThread::cWorker::CalcLight(NIBBLETYPE * a_Light)
 {
 	int NumSeeds2 = 0;
 	while (m_NumSeeds > 0)
@@ -508,7 +678,7 @@ void cLightingThread::CalcLight(NIBBLETYPE * a_Light)
 
 
 
-void cLightingThread::CalcLightStep(
+void cLightingThread::cWorker::CalcLightStep(
 	NIBBLETYPE * a_Light,
 	int a_NumSeedsIn,    unsigned char * a_IsSeedIn,  unsigned int * a_SeedIdxIn,
 	int & a_NumSeedsOut, unsigned char * a_IsSeedOut, unsigned int * a_SeedIdxOut
@@ -556,7 +726,7 @@ void cLightingThread::CalcLightStep(
 
 
 
-void cLightingThread::CompressLight(NIBBLETYPE * a_LightArray, NIBBLETYPE * a_ChunkLight)
+void cLightingThread::cWorker::CompressLight(NIBBLETYPE * a_LightArray, NIBBLETYPE * a_ChunkLight)
 {
 	int InIdx = cChunkDef::Width * 49;  // Index to the first nibble of the middle chunk in the a_LightArray
 	int OutIdx = 0;
@@ -581,21 +751,6 @@ void cLightingThread::CompressLight(NIBBLETYPE * a_LightArray, NIBBLETYPE * a_Ch
 
 
 
-void cLightingThread::QueueChunkStay(cLightingChunkStay & a_ChunkStay)
-{
-	// Move the ChunkStay from the Pending queue to the lighting queue.
-	{
-		cCSLock Lock(m_CS);
-		m_PendingQueue.remove(&a_ChunkStay);
-		m_Queue.push_back(&a_ChunkStay);
-	}
-	m_evtItemAdded.Set();
-}
-
-
-
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // cLightingThread::cLightingChunkStay:
 
@@ -603,7 +758,8 @@ cLightingThread::cLightingChunkStay::cLightingChunkStay(cLightingThread & a_Ligh
 	m_LightingThread(a_LightingThread),
 	m_ChunkX(a_ChunkX),
 	m_ChunkZ(a_ChunkZ),
-	m_CallbackAfter(a_CallbackAfter)
+	m_CallbackAfter(a_CallbackAfter),
+	m_QueuedTime(std::chrono::steady_clock::now())
 {
 	Add(a_ChunkX + 1, a_ChunkZ + 1);
 	Add(a_ChunkX + 1, a_ChunkZ);
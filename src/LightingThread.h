@@ -1,7 +1,7 @@
 
 // LightingThread.h
 
-// Interfaces to the cLightingThread class representing the thread that processes requests for lighting
+// Interfaces to the cLightingThread class representing the pool of threads that process requests for lighting
 
 /*
 Lighting is done on whole chunks. For each chunk to be lighted, the whole 3x3 chunk area around it is read,
@@ -21,10 +21,15 @@ the other is an array of seed coords, encoded as a single int.
 Step 2 needs two separate storages for old seeds and new seeds, so there are two actual storages for that purpose,
 their content is swapped after each full step-2-cycle.
 
-The thread has two queues of chunks that are to be lighted.
-The first queue, m_Queue, is the only one that is publicly visible, chunks get queued there by external requests.
-The second one, m_PostponedQueue, is for chunks that have been taken out of m_Queue and didn't have neighbors ready.
-Chunks from m_PostponedQueue are moved back into m_Queue when their neighbors get valid, using the ChunkReady callback.
+Lighting is done by a pool of worker threads (cLightingThread::cWorker), each having its own set of buffers
+for the 3x3 chunk data and the seeds, so that they can light chunks in parallel.
+
+The service has two queues of chunks that are to be lighted, shared by all the workers.
+The first queue, m_PendingQueue, holds the ChunkStays that are waiting for their 3x3 chunks to load.
+The second one, m_Queue, holds the ChunkStays that have all of their chunks available; a ChunkStay is moved
+there by its OnAllChunksAvailable() callback.
+A worker takes the first item from m_Queue whose chunk is not adjacent to a chunk being currently lighted
+by another worker (m_InProgress), so that two workers never work on overlapping areas' middle chunks.
 */
 
 
@@ -46,17 +51,15 @@ class cWorld;
 
 
 
-class cLightingThread :
-	public cIsThread
+class cLightingThread
 {
-	typedef cIsThread super;
-	
 public:
 	
 	cLightingThread(void);
 	~cLightingThread();
 	
-	bool Start(cWorld * a_World);
+	/** Starts the specified number of worker threads lighting chunks in the specified world. */
+	bool Start(cWorld * a_World, int a_NumThreads);
 	
 	void Stop(void);
 	
@@ -68,6 +71,21 @@ public:
 	
 	size_t GetQueueLength(void);
 	
+	/** Returns the number of worker threads lighting the chunks. */
+	size_t GetNumThreads(void);
+	
+	/** Returns the number of chunks lighted since the start. */
+	size_t GetNumChunksLighted(void);
+	
+	/** Returns the average time, in msec, between a chunk being queued and its light being calculated. */
+	double GetAverageLatency(void);
+	
+	/** Returns the maximum time, in msec, between a chunk being queued and its light being calculated. */
+	double GetMaxLatency(void);
+	
+	/** Returns the average time, in msec, that a worker spends calculating the light of a single chunk. */
+	double GetAverageLightingTime(void);
+	
 protected:
 
 	class cLightingChunkStay :
@@ -79,6 +97,9 @@ protected:
 		int m_ChunkZ;
 		cChunkCoordCallback * m_CallbackAfter;
 		
+		/** The time when the chunk was queued, used for the latency statistics. */
+		std::chrono::steady_clock::time_point m_QueuedTime;
+		
 		cLightingChunkStay(cLightingThread & a_LightingThread, int a_ChunkX, int a_ChunkZ, cChunkCoordCallback * a_CallbackAfter);
 		
 	protected:
@@ -91,12 +112,120 @@ protected:
 		virtual void OnDisabled(void) override;
 	} ;
 	
+	
+	/** A single lighting thread, with its own buffers for the calculation. */
+	class cWorker :
+		public cIsThread
+	{
+		typedef cIsThread super;
+		
+	public:
+		
+		cWorker(cLightingThread & a_LightingThread, cWorld & a_World);
+		
+		/** Signals the thread to terminate and waits until it's finished. */
+		void Stop(void);
+		
+		/** Wakes the thread up if it's waiting for an item to process. */
+		void WakeUp(void) { m_evtItemAdded.Set(); }
+		
+	protected:
+		
+		cLightingThread & m_LightingThread;
+		
+		cWorld & m_World;
+		
+		/** Set when an item may be available for this worker, or to stop the thread */
+		cEvent m_evtItemAdded;
+		
+		/** The highest block in the current 3x3 chunk data */
+		HEIGHTTYPE m_MaxHeight;
+		
+		
+		// Buffers for the 3x3 chunk data
+		// These buffers alone are 1.7 MiB in size, therefore they cannot be located on the stack safely - some architectures may have only 1 MiB for stack, or even less
+		// Each worker has its own buffers, therefore the workers need to be allocated on the heap
+		// The blobs are XZY organized as a whole, instead of 3x3 XZY-organized subarrays ->
+		//  -> This means data has to be scatterred when reading and gathered when writing!
+		static const int BlocksPerYLayer = cChunkDef::Width * cChunkDef::Width * 3 * 3;
+		BLOCKTYPE  m_BlockTypes[BlocksPerYLayer * cChunkDef::Height];
+		NIBBLETYPE m_BlockLight[BlocksPerYLayer * cChunkDef::Height];
+		NIBBLETYPE m_SkyLight  [BlocksPerYLayer * cChunkDef::Height];
+		HEIGHTTYPE m_HeightMap [BlocksPerYLayer];
+		
+		// Seed management (5.7 MiB)
+		// Two buffers, in each calc step one is set as input and the other as output, then in the next step they're swapped
+		// Each seed is represented twice in this structure - both as a "list" and as a "position".
+		// "list" allows fast traversal from seed to seed
+		// "position" allows fast checking if a coord is already a seed
+		unsigned char m_IsSeed1 [BlocksPerYLayer * cChunkDef::Height];
+		unsigned int  m_SeedIdx1[BlocksPerYLayer * cChunkDef::Height];
+		unsigned char m_IsSeed2 [BlocksPerYLayer * cChunkDef::Height];
+		unsigned int  m_SeedIdx2[BlocksPerYLayer * cChunkDef::Height];
+		int m_NumSeeds;
+
+		virtual void Execute(void) override;
+
+		/** Lights the entire chunk. If neighbor chunks don't exist, touches them and re-queues the chunk */
+		void LightChunk(cLightingChunkStay & a_Item);
+		
+		/** Prepares m_BlockTypes and m_HeightMap data; zeroes out the light arrays */
+		void ReadChunks(int a_ChunkX, int a_ChunkZ);
+		
+		/** Uses m_HeightMap to initialize the m_SkyLight[] data; fills in seeds for the skylight */
+		void PrepareSkyLight(void);
+		
+		/** Uses m_BlockTypes to initialize the m_BlockLight[] data; fills in seeds for the blocklight */
+		void PrepareBlockLight(void);
+		
+		/** Same as PrepareBlockLight(), but uses a different traversal scheme; possibly better perf cache-wise.
+		To be compared in perf benchmarks. */
+		void PrepareBlockLight2(void);
+		
+		/** Calculates light in the light array specified, using stored seeds */
+		void CalcLight(NIBBLETYPE * a_Light);
+		
+		/** Does one step in the light calculation - one seed propagation and seed recalculation */
+		void CalcLightStep(
+			NIBBLETYPE * a_Light,
+			int a_NumSeedsIn,    unsigned char * a_IsSeedIn,  unsigned int * a_SeedIdxIn,
+			int & a_NumSeedsOut, unsigned char * a_IsSeedOut, unsigned int * a_SeedIdxOut
+		);
+		
+		/** Compresses from 1-block-per-byte (faster calc) into 2-blocks-per-byte (MC storage): */
+		void CompressLight(NIBBLETYPE * a_LightArray, NIBBLETYPE * a_ChunkLight);
+		
+		inline void PropagateLight(
+			NIBBLETYPE * a_Light,
+			unsigned int a_SrcIdx, unsigned int a_DstIdx,
+			int & a_NumSeedsOut, unsigned char * a_IsSeedOut, unsigned int * a_SeedIdxOut
+		)
+		{
+			ASSERT(a_SrcIdx < ARRAYCOUNT(m_SkyLight));
+			ASSERT(a_DstIdx < ARRAYCOUNT(m_BlockTypes));
+			
+			if (a_Light[a_SrcIdx] <= a_Light[a_DstIdx] + cBlockInfo::GetSpreadLightFalloff(m_BlockTypes[a_DstIdx]))
+			{
+				// We're not offering more light than the dest block already has
+				return;
+			}
+
+			a_Light[a_DstIdx] = a_Light[a_SrcIdx] - cBlockInfo::GetSpreadLightFalloff(m_BlockTypes[a_DstIdx]);
+			if (!a_IsSeedOut[a_DstIdx])
+			{
+				a_IsSeedOut[a_DstIdx] = true;
+				a_SeedIdxOut[a_NumSeedsOut++] = a_DstIdx;
+			}
+		}
+	} ;
+	
 	typedef std::list<cChunkStay *> cChunkStays;
+	typedef std::vector<cWorker *> cWorkers;
 	
 	
 	cWorld * m_World;
 	
-	/** The mutex to protect m_Queue and m_PendingQueue */
+	/** The mutex to protect m_Queue, m_PendingQueue, m_InProgress, m_Workers and the statistics */
 	cCriticalSection m_CS;
 	
 	/** The ChunkStays that are loaded and are waiting to be lit. */
@@ -105,93 +234,37 @@ protected:
 	/** The ChunkStays that are waiting for load. Used for stopping the thread. */
 	cChunkStays m_PendingQueue;
 
-	cEvent m_evtItemAdded;    // Set when queue is appended, or to stop the thread
+	/** The chunks that are being lighted by the workers right now. */
+	cChunkCoordsList m_InProgress;
+
 	cEvent m_evtQueueEmpty;   // Set when the queue gets empty
 	
-	/** The highest block in the current 3x3 chunk data */
-	HEIGHTTYPE m_MaxHeight;
-	
-	
-	// Buffers for the 3x3 chunk data
-	// These buffers alone are 1.7 MiB in size, therefore they cannot be located on the stack safely - some architectures may have only 1 MiB for stack, or even less
-	// Placing the buffers into the object means that this object can light chunks only in one thread!
-	// The blobs are XZY organized as a whole, instead of 3x3 XZY-organized subarrays ->
-	//  -> This means data has to be scatterred when reading and gathered when writing!
-	static const int BlocksPerYLayer = cChunkDef::Width * cChunkDef::Width * 3 * 3;
-	BLOCKTYPE  m_BlockTypes[BlocksPerYLayer * cChunkDef::Height];
-	NIBBLETYPE m_BlockLight[BlocksPerYLayer * cChunkDef::Height];
-	NIBBLETYPE m_SkyLight  [BlocksPerYLayer * cChunkDef::Height];
-	HEIGHTTYPE m_HeightMap [BlocksPerYLayer];
-	
-	// Seed management (5.7 MiB)
-	// Two buffers, in each calc step one is set as input and the other as output, then in the next step they're swapped
-	// Each seed is represented twice in this structure - both as a "list" and as a "position".
-	// "list" allows fast traversal from seed to seed
-	// "position" allows fast checking if a coord is already a seed
-	unsigned char m_IsSeed1 [BlocksPerYLayer * cChunkDef::Height];
-	unsigned int  m_SeedIdx1[BlocksPerYLayer * cChunkDef::Height];
-	unsigned char m_IsSeed2 [BlocksPerYLayer * cChunkDef::Height];
-	unsigned int  m_SeedIdx2[BlocksPerYLayer * cChunkDef::Height];
-	int m_NumSeeds;
-
-	virtual void Execute(void) override;
-
-	/** Lights the entire chunk. If neighbor chunks don't exist, touches them and re-queues the chunk */
-	void LightChunk(cLightingChunkStay & a_Item);
-	
-	/** Prepares m_BlockTypes and m_HeightMap data; zeroes out the light arrays */
-	void ReadChunks(int a_ChunkX, int a_ChunkZ);
-	
-	/** Uses m_HeightMap to initialize the m_SkyLight[] data; fills in seeds for the skylight */
-	void PrepareSkyLight(void);
-	
-	/** Uses m_BlockTypes to initialize the m_BlockLight[] data; fills in seeds for the blocklight */
-	void PrepareBlockLight(void);
-	
-	/** Same as PrepareBlockLight(), but uses a different traversal scheme; possibly better perf cache-wise.
-	To be compared in perf benchmarks. */
-	void PrepareBlockLight2(void);
-	
-	/** Calculates light in the light array specified, using stored seeds */
-	void CalcLight(NIBBLETYPE * a_Light);
-	
-	/** Does one step in the light calculation - one seed propagation and seed recalculation */
-	void CalcLightStep(
-		NIBBLETYPE * a_Light,
-		int a_NumSeedsIn,    unsigned char * a_IsSeedIn,  unsigned int * a_SeedIdxIn,
-		int & a_NumSeedsOut, unsigned char * a_IsSeedOut, unsigned int * a_SeedIdxOut
-	);
-	
-	/** Compresses from 1-block-per-byte (faster calc) into 2-blocks-per-byte (MC storage): */
-	void CompressLight(NIBBLETYPE * a_LightArray, NIBBLETYPE * a_ChunkLight);
-	
-	inline void PropagateLight(
-		NIBBLETYPE * a_Light,
-		unsigned int a_SrcIdx, unsigned int a_DstIdx,
-		int & a_NumSeedsOut, unsigned char * a_IsSeedOut, unsigned int * a_SeedIdxOut
-	)
-	{
-		ASSERT(a_SrcIdx < ARRAYCOUNT(m_SkyLight));
-		ASSERT(a_DstIdx < ARRAYCOUNT(m_BlockTypes));
-		
-		if (a_Light[a_SrcIdx] <= a_Light[a_DstIdx] + cBlockInfo::GetSpreadLightFalloff(m_BlockTypes[a_DstIdx]))
-		{
-			// We're not offering more light than the dest block already has
-			return;
-		}
-
-		a_Light[a_DstIdx] = a_Light[a_SrcIdx] - cBlockInfo::GetSpreadLightFalloff(m_BlockTypes[a_DstIdx]);
-		if (!a_IsSeedOut[a_DstIdx])
-		{
-			a_IsSeedOut[a_DstIdx] = true;
-			a_SeedIdxOut[a_NumSeedsOut++] = a_DstIdx;
-		}
-	}
+	/** The worker threads */
+	cWorkers m_Workers;
+	
+	/** Set when the service is stopping; no more items are handed out to the workers. */
+	bool m_ShouldTerminate;
+	
+	// Statistics, protected by m_CS:
+	size_t m_NumChunksLighted;
+	double m_TotalLatency;       // Sum of the queue-to-lighted times of all lighted chunks, in msec
+	double m_MaxLatency;         // Maximum queue-to-lighted time of a single chunk, in msec
+	double m_TotalLightingTime;  // Sum of the light calculation times of all lighted chunks, in msec
 	
 	/** Queues a chunkstay that has all of its chunks loaded.
 	Called by cLightingChunkStay when all of its chunks are loaded. */
 	void QueueChunkStay(cLightingChunkStay & a_ChunkStay);
 	
+	/** Removes and returns the first item in m_Queue that isn't adjacent to any chunk being lighted, and marks it as in progress.
+	Returns nullptr if there's no such item. */
+	cLightingChunkStay * GetNextItem(void);
+	
+	/** Called by the workers when they finish an item taken from GetNextItem(); updates the statistics.
+	a_LightingTime is the time spent on the calculation, in msec. */
+	void ItemFinished(cLightingChunkStay & a_Item, double a_LightingTime);
+	
+	/** Wakes up all the worker threads, so that they check the queue. */
+	void WakeUpWorkers(void);
 } ;
 
 
@@ -74,6 +74,7 @@ cMonster::cMonster(const AString & a_ConfigName, eMonsterType a_MobType, const A
 	, m_EMPersonality(AGGRESSIVE)
 	, m_Target(nullptr)
 	, m_bMovingToDestination(false)
+	, m_PathIndex(0)
 	, m_LastGroundHeight(POSY_TOINT)
 	, m_IdleInterval(0)
 	, m_DestroyTimer(0)
@@ -117,88 +118,48 @@ void cMonster::SpawnOn(cClientHandle & a_Client)
 
 void cMonster::TickPathFinding()
 {
-	const int PosX = POSX_TOINT;
-	const int PosY = POSY_TOINT;
-	const int PosZ = POSZ_TOINT;
-
-	std::vector<Vector3d> m_PotentialCoordinates;
-	m_TraversedCoordinates.push_back(Vector3i(PosX, PosY, PosZ));
-
-	static const struct  // Define which directions to try to move to
-	{
-		int x, z;
-	} gCrossCoords[] =
+	if (m_PathSearch != nullptr)
 	{
-		{ 1, 0},
-		{-1, 0},
-		{ 0, 1},
-		{ 0, -1},
-	} ;
-	
-	if ((PosY - 1 < 0) || (PosY + 2 > cChunkDef::Height) /* PosY + 1 will never be true if PosY + 2 is not */)
-	{
-		// Too low/high, can't really do anything
-		FinishPathFinding();
-		return;
-	}
-
-	for (size_t i = 0; i < ARRAYCOUNT(gCrossCoords); i++)
-	{
-		if (IsCoordinateInTraversedList(Vector3i(gCrossCoords[i].x + PosX, PosY, gCrossCoords[i].z + PosZ)))
-		{
-			continue;
-		}
-
-		BLOCKTYPE BlockAtY = m_World->GetBlock(gCrossCoords[i].x + PosX, PosY, gCrossCoords[i].z + PosZ);
-		BLOCKTYPE BlockAtYP = m_World->GetBlock(gCrossCoords[i].x + PosX, PosY + 1, gCrossCoords[i].z + PosZ);
-		BLOCKTYPE BlockAtYPP = m_World->GetBlock(gCrossCoords[i].x + PosX, PosY + 2, gCrossCoords[i].z + PosZ);
-		int LowestY = FindFirstNonAirBlockPosition(gCrossCoords[i].x + PosX, gCrossCoords[i].z + PosZ);
-		BLOCKTYPE BlockAtLowestY = (LowestY >= cChunkDef::Height) ? E_BLOCK_AIR : m_World->GetBlock(gCrossCoords[i].x + PosX, LowestY, gCrossCoords[i].z + PosZ);
-
-		if (
-			(!cBlockInfo::IsSolid(BlockAtY)) &&
-			(!cBlockInfo::IsSolid(BlockAtYP)) &&
-			(!IsBlockLava(BlockAtLowestY)) &&
-			(BlockAtLowestY != E_BLOCK_CACTUS) &&
-			(PosY - LowestY < FALL_DAMAGE_HEIGHT)
-			)
-		{
-			m_PotentialCoordinates.push_back(Vector3d((gCrossCoords[i].x + PosX), PosY, gCrossCoords[i].z + PosZ));
-		}
-		else if (
-			(cBlockInfo::IsSolid(BlockAtY)) &&
-			(BlockAtY != E_BLOCK_CACTUS) &&
-			(!cBlockInfo::IsSolid(BlockAtYP)) &&
-			(!cBlockInfo::IsSolid(BlockAtYPP)) &&
-			(BlockAtY != E_BLOCK_FENCE) &&
-			(BlockAtY != E_BLOCK_FENCE_GATE)
-			)
+		std::vector<Vector3i> Path;
+		switch (m_PathSearch->GetPath(Vector3i(POSX_TOINT, POSY_TOINT, POSZ_TOINT), Path))
 		{
-			m_PotentialCoordinates.push_back(Vector3d((gCrossCoords[i].x + PosX), PosY + 1, gCrossCoords[i].z + PosZ));
+			case cPathSearch::psSearching:
+			{
+				// Keep walking the previous path, if any, until the search gets here
+				break;
+			}
+			case cPathSearch::psFound:
+			{
+				std::swap(m_Path, Path);
+				m_PathIndex = 0;
+				m_PathSearch.reset();
+				break;
+			}
+			case cPathSearch::psNotFound:
+			{
+				FinishPathFinding();
+				return;
+			}
 		}
 	}
 
-	if (!m_PotentialCoordinates.empty())
+	if (m_PathIndex >= m_Path.size())
 	{
-		Vector3f ShortestCoords = m_PotentialCoordinates.front();
-		for (std::vector<Vector3d>::const_iterator itr = m_PotentialCoordinates.begin(); itr != m_PotentialCoordinates.end(); ++itr)
+		if (m_PathSearch == nullptr)
 		{
-			Vector3f Distance = m_FinalDestination - ShortestCoords;
-			Vector3f Distance2 = m_FinalDestination - *itr;
-			if (Distance.SqrLength() > Distance2.SqrLength())
-			{
-				ShortestCoords = *itr;
-			}
+			// Walked the whole path, yet not at the final destination; the world must have changed meanwhile
+			FinishPathFinding();
+			return;
 		}
 
-		m_Destination = ShortestCoords;
-		m_Destination.z += 0.5f;
-		m_Destination.x += 0.5f;
-	}
-	else
-	{
-		FinishPathFinding();
+		// Wait in place for the search:
+		m_Destination = GetPosition();
+		return;
 	}
+
+	const Vector3i & Next = m_Path[m_PathIndex];
+	m_Destination = Vector3d(Next.x + 0.5, Next.y, Next.z + 0.5);
+	m_PathIndex++;
 }
 
 
@@ -207,18 +168,30 @@ void cMonster::TickPathFinding()
 
 void cMonster::MoveToPosition(const Vector3d & a_Position)
 {
-	FinishPathFinding();
+	bool IsSameGoalBlock = (
+		(FloorC(a_Position.x) == FloorC(m_FinalDestination.x)) &&
+		(FloorC(a_Position.y) == FloorC(m_FinalDestination.y)) &&
+		(FloorC(a_Position.z) == FloorC(m_FinalDestination.z))
+	);
+	if (!m_bMovingToDestination)
+	{
+		FinishPathFinding();
+	}
+	else if (IsSameGoalBlock)
+	{
+		// The path there is already being walked or searched for
+		m_FinalDestination = a_Position;
+		return;
+	}
 
 	m_FinalDestination = a_Position;
 	m_bMovingToDestination = true;
-	TickPathFinding();
-}
-
-
-
-bool cMonster::IsCoordinateInTraversedList(Vector3i a_Coords)
-{
-	return (std::find(m_TraversedCoordinates.begin(), m_TraversedCoordinates.end(), a_Coords) != m_TraversedCoordinates.end());
+	m_PathSearch = m_World->GetPathFinder().FindPath(a_Position);
+	if (m_PathIndex >= m_Path.size())
+	{
+		// Not walking any path yet, start with the new one; otherwise it gets picked up at the next block of the current path
+		TickPathFinding();
+	}
 }
 
 
@@ -7,6 +7,7 @@
 #include "../Item.h"
 #include "../Enchantments.h"
 #include "MonsterTypes.h"
+#include "PathFinder.h"
 
 
 
@@ -192,18 +193,22 @@ protected:
 		return ((a_PosY > POSY_TOINT) && (a_PosY == POSY_TOINT + 1));
 	}
 
-	/** A semi-temporary list to store the traversed coordinates during active pathfinding so we don't visit them again */
-	std::vector<Vector3i> m_TraversedCoordinates;
-	/** Returns if coordinate is in the traversed list */
-	bool IsCoordinateInTraversedList(Vector3i a_Coords);
+	/** The search for a path to m_FinalDestination, while the path is not known yet. Shared with the other mobs heading there. */
+	cPathSearchPtr m_PathSearch;
+	/** The path being walked, the blocks from the one after the mob's starting position to the final destination */
+	std::vector<Vector3i> m_Path;
+	/** Index into m_Path of the block to walk to after m_Destination */
+	size_t m_PathIndex;
 
-	/** Finds the next place to go
-		This is based on the ultimate, final destination and the current position, as well as the traversed coordinates, and any environmental hazards */
+	/** Sets m_Destination to the next block on the path
+		Picks up the path from m_PathSearch once it is found; until then, the mob keeps walking the previous path or waits */
 	void TickPathFinding(void);
 	/** Finishes a pathfinding task, be it due to failure or something else */
 	inline void FinishPathFinding(void)
 	{
-		m_TraversedCoordinates.clear();
+		m_PathSearch.reset();
+		m_Path.clear();
+		m_PathIndex = 0;
 		m_bMovingToDestination = false;
 	}
 	/** Sets the body yaw and head yaw/pitch based on next/ultimate destinations */
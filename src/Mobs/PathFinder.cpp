@@ -0,0 +1,640 @@
+
+// PathFinder.cpp
+
+// Implements the cPathFinder class representing the per-world service that finds walking paths for the mobs
+
+#include "Globals.h"
+#include "PathFinder.h"
+#include "../World.h"
+#include "../Entities/Entity.h"
+
+
+
+
+
+/** Distance from the center of a snapshot to its sides, in blocks. */
+static const int SNAPSHOT_HORZ_RADIUS = 40;
+
+/** Distance from the center of a snapshot to its sides, used if the large snapshot reaches into chunks that aren't loaded. */
+static const int SNAPSHOT_SMALL_HORZ_RADIUS = 16;
+
+/** Distance from the center of a snapshot to its top and bottom, in blocks. Needs to fit the columns' UInt64 bitmasks. */
+static const int SNAPSHOT_VERT_RADIUS = 16;
+
+/** Number of ticks for which a snapshot is reused by new searches. */
+static const Int64 SNAPSHOT_LIFETIME_TICKS = 20;
+
+/** Number of ticks for which a search is reused by new requests; older searches are stopped. */
+static const Int64 SEARCH_LIFETIME_TICKS = 40;
+
+/** Maximum number of blocks closed by all the searches in a single tick. */
+static const int NODES_PER_TICK = 2000;
+
+/** Minimum number of blocks closed by a running search in a single tick, however many searches are running. */
+static const int MIN_NODES_PER_SEARCH = 50;
+
+/** Maximum number of blocks closed by a single search, it gives up on the remaining starts afterwards. */
+static const int MAX_NODES_PER_SEARCH = 8000;
+
+/** Cost of moving into a neighboring column, in 1/10 blocks. */
+static const int STEP_COST = 10;
+
+/** Additional cost of jumping up or dropping down a block while moving. */
+static const int CLIMB_COST = 5;
+
+/** The highest drop that the mobs take without taking fall damage. */
+static const int MAX_DROP = cEntity::FALL_DAMAGE_HEIGHT - 1;
+
+static const struct
+{
+	int x, z;
+} g_NeighborColumns[] =
+{
+	{ 1,  0},
+	{-1,  0},
+	{ 0,  1},
+	{ 0, -1},
+} ;
+
+
+
+
+
+/** Returns true if mobs can stand on a block of the specified type. */
+static bool IsFloor(BLOCKTYPE a_BlockType)
+{
+	switch (a_BlockType)
+	{
+		case E_BLOCK_CACTUS:
+		case E_BLOCK_FENCE:
+		case E_BLOCK_SPRUCE_FENCE:
+		case E_BLOCK_BIRCH_FENCE:
+		case E_BLOCK_JUNGLE_FENCE:
+		case E_BLOCK_DARK_OAK_FENCE:
+		case E_BLOCK_ACACIA_FENCE:
+		case E_BLOCK_NETHER_BRICK_FENCE:
+		case E_BLOCK_FENCE_GATE:
+		case E_BLOCK_SPRUCE_FENCE_GATE:
+		case E_BLOCK_BIRCH_FENCE_GATE:
+		case E_BLOCK_JUNGLE_FENCE_GATE:
+		case E_BLOCK_DARK_OAK_FENCE_GATE:
+		case E_BLOCK_ACACIA_FENCE_GATE:
+		case E_BLOCK_COBBLESTONE_WALL:
+		{
+			// Too high to jump onto
+			return false;
+		}
+		default: return cBlockInfo::IsSolid(a_BlockType);
+	}
+}
+
+
+
+
+
+/** Returns true if a mob's body can be in a block of the specified type without getting hurt. */
+static bool IsRoom(BLOCKTYPE a_BlockType)
+{
+	if (IsBlockLava(a_BlockType) || (a_BlockType == E_BLOCK_FIRE) || (a_BlockType == E_BLOCK_CACTUS))
+	{
+		return false;
+	}
+	return !cBlockInfo::IsSolid(a_BlockType);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cPathSnapshot:
+
+cPathSnapshot::cPathSnapshot(cWorld & a_World, const Vector3i & a_Center, int a_HorzRadius, int a_VertRadius) :
+	m_WorldAge(a_World.GetWorldAge()),
+	m_Center(a_Center),
+	m_HorzRadius(a_HorzRadius)
+{
+	int MinY = Clamp(a_Center.y - a_VertRadius, 0, cChunkDef::Height - 1);
+	int MaxY = Clamp(a_Center.y + a_VertRadius, 0, cChunkDef::Height - 1);
+	if (!m_Area.Read(
+		&a_World,
+		a_Center.x - a_HorzRadius, a_Center.x + a_HorzRadius,
+		MinY, MaxY,
+		a_Center.z - a_HorzRadius, a_Center.z + a_HorzRadius,
+		cBlockArea::baTypes
+	))
+	{
+		// Some of the chunks are not loaded, the area stays empty
+		return;
+	}
+	ASSERT(m_Area.GetSizeY() <= 64);  // Each column's standable blocks need to fit a UInt64
+
+	size_t NumColumns = static_cast<size_t>(m_Area.GetSizeX() * m_Area.GetSizeZ());
+	m_Standable.resize(NumColumns, 0);
+	m_IsColumnCached.resize(NumColumns, false);
+}
+
+
+
+
+
+bool cPathSnapshot::IsInside(const Vector3i & a_BlockPos) const
+{
+	if (!IsValid())
+	{
+		return false;
+	}
+	Vector3i Rel = a_BlockPos - m_Area.GetOrigin();
+	return (
+		(Rel.x >= 0) && (Rel.x < m_Area.GetSizeX()) &&
+		(Rel.z >= 0) && (Rel.z < m_Area.GetSizeZ()) &&
+		(Rel.y >= 1) && (Rel.y < m_Area.GetSizeY() - 1)
+	);
+}
+
+
+
+
+
+bool cPathSnapshot::IsStandable(const Vector3i & a_BlockPos)
+{
+	if (!IsInside(a_BlockPos))
+	{
+		return false;
+	}
+	Vector3i Rel = a_BlockPos - m_Area.GetOrigin();
+	size_t Column = static_cast<size_t>(Rel.x + Rel.z * m_Area.GetSizeX());
+	if (!m_IsColumnCached[Column])
+	{
+		CacheColumn(Rel.x, Rel.z);
+	}
+	return ((m_Standable[Column] & (static_cast<UInt64>(1) << Rel.y)) != 0);
+}
+
+
+
+
+
+bool cPathSnapshot::CanMove(const Vector3i & a_From, const Vector3i & a_To) const
+{
+	int Height = a_To.y - a_From.y;
+	if (Height == 0)
+	{
+		return true;
+	}
+	if (Height == 1)
+	{
+		// Jumping up needs room above the mob's head:
+		return IsPassable(a_From + Vector3i(0, 2, 0));
+	}
+	if ((Height < 0) && (Height >= -MAX_DROP))
+	{
+		// Walking off an edge, the mob falls through the column in front of it:
+		for (int y = a_To.y + 2; y <= a_From.y + 1; y++)
+		{
+			if (!IsPassable(Vector3i(a_To.x, y, a_To.z)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+
+
+
+
+bool cPathSnapshot::FindStandable(Vector3i & a_BlockPos, int a_MaxDistance)
+{
+	for (int Distance = 0; Distance <= a_MaxDistance; Distance++)
+	{
+		// Prefer the blocks below, the mob is more likely to be jumping than sunk into the ground:
+		if (IsStandable(Vector3i(a_BlockPos.x, a_BlockPos.y - Distance, a_BlockPos.z)))
+		{
+			a_BlockPos.y -= Distance;
+			return true;
+		}
+		if (IsStandable(Vector3i(a_BlockPos.x, a_BlockPos.y + Distance, a_BlockPos.z)))
+		{
+			a_BlockPos.y += Distance;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+int cPathSnapshot::MakeIndex(const Vector3i & a_BlockPos) const
+{
+	ASSERT(IsInside(a_BlockPos));
+	Vector3i Rel = a_BlockPos - m_Area.GetOrigin();
+	return Rel.x + m_Area.GetSizeX() * (Rel.z + m_Area.GetSizeZ() * Rel.y);
+}
+
+
+
+
+
+Vector3i cPathSnapshot::IndexToPos(int a_Index) const
+{
+	int SizeX = m_Area.GetSizeX();
+	int SizeZ = m_Area.GetSizeZ();
+	return m_Area.GetOrigin() + Vector3i(a_Index % SizeX, a_Index / (SizeX * SizeZ), (a_Index / SizeX) % SizeZ);
+}
+
+
+
+
+
+bool cPathSnapshot::IsPassable(const Vector3i & a_BlockPos) const
+{
+	Vector3i Rel = a_BlockPos - m_Area.GetOrigin();
+	if (
+		(Rel.x < 0) || (Rel.x >= m_Area.GetSizeX()) ||
+		(Rel.y < 0) || (Rel.y >= m_Area.GetSizeY()) ||
+		(Rel.z < 0) || (Rel.z >= m_Area.GetSizeZ())
+	)
+	{
+		return false;
+	}
+	return !cBlockInfo::IsSolid(m_Area.GetBlockTypes()[m_Area.MakeIndex(Rel.x, Rel.y, Rel.z)]);
+}
+
+
+
+
+
+void cPathSnapshot::CacheColumn(int a_RelX, int a_RelZ)
+{
+	const BLOCKTYPE * BlockTypes = m_Area.GetBlockTypes();
+	UInt64 Standable = 0;
+	for (int y = 1; y < m_Area.GetSizeY() - 1; y++)
+	{
+		if (
+			IsFloor(BlockTypes[m_Area.MakeIndex(a_RelX, y - 1, a_RelZ)]) &&
+			IsRoom(BlockTypes[m_Area.MakeIndex(a_RelX, y, a_RelZ)]) &&
+			IsRoom(BlockTypes[m_Area.MakeIndex(a_RelX, y + 1, a_RelZ)])
+		)
+		{
+			Standable |= (static_cast<UInt64>(1) << y);
+		}
+	}
+	size_t Column = static_cast<size_t>(a_RelX + a_RelZ * m_Area.GetSizeX());
+	m_Standable[Column] = Standable;
+	m_IsColumnCached[Column] = true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cPathSearch:
+
+cPathSearch::cPathSearch(cPathSnapshotPtr a_Snapshot, const Vector3i & a_Goal, Int64 a_WorldAge) :
+	m_Snapshot(a_Snapshot),
+	m_Goal(a_Goal),
+	m_WorldAge(a_WorldAge),
+	m_NumClosed(0),
+	m_IsExhausted(false)
+{
+	Vector3i Goal(a_Goal);
+	if (!m_Snapshot->FindStandable(Goal, 3))
+	{
+		// Nowhere to stand at the goal, no path leads there
+		m_IsExhausted = true;
+		return;
+	}
+
+	int Index = m_Snapshot->MakeIndex(Goal);
+	sNode & Node = m_Nodes[Index];
+	Node.m_Cost = 0;
+	Node.m_Next = -1;
+	Node.m_IsClosed = false;
+
+	sOpenItem Item;
+	Item.m_Index = Index;
+	Item.m_Cost = 0;
+	Item.m_Estimate = 0;
+	m_Open.push_back(Item);
+}
+
+
+
+
+
+cPathSearch::eStatus cPathSearch::GetPath(const Vector3i & a_Start, std::vector<Vector3i> & a_Path)
+{
+	// The mob may be in the middle of a jump or a fall, find the block it is going to stand in:
+	Vector3i Start(a_Start);
+	if (!m_Snapshot->FindStandable(Start, 2))
+	{
+		return psNotFound;
+	}
+
+	int Index = m_Snapshot->MakeIndex(Start);
+	if (IsClosed(Index))
+	{
+		a_Path.clear();
+		for (int Next = m_Nodes.find(Index)->second.m_Next; Next >= 0; Next = m_Nodes.find(Next)->second.m_Next)
+		{
+			a_Path.push_back(m_Snapshot->IndexToPos(Next));
+		}
+		return psFound;
+	}
+	if (m_IsExhausted)
+	{
+		return psNotFound;
+	}
+
+	if (std::find(m_Starts.begin(), m_Starts.end(), Start) == m_Starts.end())
+	{
+		m_Starts.push_back(Start);
+		if (m_Starts.size() == 1)
+		{
+			// The search now heads for this start:
+			ReorderOpen();
+		}
+	}
+	return psSearching;
+}
+
+
+
+
+
+void cPathSearch::Step(int & a_Budget)
+{
+	while (a_Budget > 0)
+	{
+		UpdateStarts();
+		if (m_Starts.empty())
+		{
+			// All the requested paths have been found
+			return;
+		}
+		if (m_Open.empty() || (m_NumClosed >= MAX_NODES_PER_SEARCH))
+		{
+			// Everything reachable has been searched, there's no path to the remaining starts:
+			Stop();
+			return;
+		}
+
+		std::pop_heap(m_Open.begin(), m_Open.end());
+		sOpenItem Item = m_Open.back();
+		m_Open.pop_back();
+		sNode & Node = m_Nodes.find(Item.m_Index)->second;
+		if (Node.m_IsClosed || (Item.m_Cost > Node.m_Cost))
+		{
+			// The block has been reached over a shorter path meanwhile
+			continue;
+		}
+		Node.m_IsClosed = true;
+		m_NumClosed++;
+		a_Budget--;
+
+		// Open all the blocks from which a mob gets into this block in a single move:
+		Vector3i Pos = m_Snapshot->IndexToPos(Item.m_Index);
+		for (size_t i = 0; i < ARRAYCOUNT(g_NeighborColumns); i++)
+		{
+			for (int Height = -1; Height <= MAX_DROP; Height++)
+			{
+				Vector3i From(Pos.x + g_NeighborColumns[i].x, Pos.y + Height, Pos.z + g_NeighborColumns[i].z);
+				if (!m_Snapshot->IsStandable(From) || !m_Snapshot->CanMove(From, Pos))
+				{
+					continue;
+				}
+				int Cost = Item.m_Cost + STEP_COST + ((Height != 0) ? CLIMB_COST : 0);
+				int FromIndex = m_Snapshot->MakeIndex(From);
+				auto itr = m_Nodes.find(FromIndex);
+				if (itr == m_Nodes.end())
+				{
+					itr = m_Nodes.insert(std::make_pair(FromIndex, sNode())).first;
+					itr->second.m_IsClosed = false;
+				}
+				else if (itr->second.m_IsClosed || (itr->second.m_Cost <= Cost))
+				{
+					continue;
+				}
+				itr->second.m_Cost = Cost;
+				itr->second.m_Next = Item.m_Index;
+
+				sOpenItem Open;
+				Open.m_Index = FromIndex;
+				Open.m_Cost = Cost;
+				Open.m_Estimate = Cost + GetEstimate(From);
+				m_Open.push_back(Open);
+				std::push_heap(m_Open.begin(), m_Open.end());
+			}  // for Height
+		}  // for i - g_NeighborColumns[]
+	}
+}
+
+
+
+
+
+void cPathSearch::Stop(void)
+{
+	m_IsExhausted = true;
+	m_Starts.clear();
+	m_Open.clear();
+}
+
+
+
+
+
+int cPathSearch::GetEstimate(const Vector3i & a_BlockPos) const
+{
+	if (m_Starts.empty())
+	{
+		return 0;
+	}
+
+	// Each move changes the column by one, so the Manhattan distance never overestimates:
+	const Vector3i & Start = m_Starts.front();
+	return STEP_COST * (std::abs(a_BlockPos.x - Start.x) + std::abs(a_BlockPos.z - Start.z));
+}
+
+
+
+
+
+bool cPathSearch::IsClosed(int a_Index) const
+{
+	auto itr = m_Nodes.find(a_Index);
+	return ((itr != m_Nodes.end()) && itr->second.m_IsClosed);
+}
+
+
+
+
+
+void cPathSearch::UpdateStarts(void)
+{
+	if (m_Starts.empty())
+	{
+		return;
+	}
+	Vector3i Front = m_Starts.front();
+	m_Starts.erase(
+		std::remove_if(m_Starts.begin(), m_Starts.end(), [this](const Vector3i & a_Start)
+			{
+				return IsClosed(m_Snapshot->MakeIndex(a_Start));
+			}
+		),
+		m_Starts.end()
+	);
+	if (!m_Starts.empty() && (m_Starts.front() != Front))
+	{
+		ReorderOpen();
+	}
+}
+
+
+
+
+
+void cPathSearch::ReorderOpen(void)
+{
+	for (auto & Item : m_Open)
+	{
+		Item.m_Estimate = Item.m_Cost + GetEstimate(m_Snapshot->IndexToPos(Item.m_Index));
+	}
+	std::make_heap(m_Open.begin(), m_Open.end());
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cPathFinder:
+
+cPathFinder::cPathFinder(cWorld & a_World) :
+	m_World(a_World),
+	m_NextSearch(0)
+{
+}
+
+
+
+
+
+cPathSearchPtr cPathFinder::FindPath(const Vector3d & a_Goal)
+{
+	Vector3i Goal(FloorC(a_Goal.x), FloorC(a_Goal.y), FloorC(a_Goal.z));
+	for (const auto & Search : m_Searches)
+	{
+		if (Search->GetGoal() == Goal)
+		{
+			return Search;
+		}
+	}
+
+	cPathSearchPtr Search = std::make_shared<cPathSearch>(GetSnapshot(Goal), Goal, m_World.GetWorldAge());
+	m_Searches.push_back(Search);
+	return Search;
+}
+
+
+
+
+
+void cPathFinder::Tick(void)
+{
+	// Drop the old searches and snapshots, the world may have changed since they were made:
+	Int64 WorldAge = m_World.GetWorldAge();
+	for (auto itr = m_Searches.begin(); itr != m_Searches.end();)
+	{
+		if (WorldAge - (*itr)->GetWorldAge() > SEARCH_LIFETIME_TICKS)
+		{
+			// The mobs still waiting for the search will get no path and ask again
+			(*itr)->Stop();
+			itr = m_Searches.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+	m_Snapshots.erase(
+		std::remove_if(m_Snapshots.begin(), m_Snapshots.end(), [WorldAge](const cPathSnapshotPtr & a_Snapshot)
+			{
+				return (WorldAge - a_Snapshot->GetWorldAge() > SNAPSHOT_LIFETIME_TICKS);
+			}
+		),
+		m_Snapshots.end()
+	);
+
+	// Share the budget among the running searches, starting with a different one each tick:
+	int NumRunning = 0;
+	for (const auto & Search : m_Searches)
+	{
+		if (Search->IsRunning())
+		{
+			NumRunning++;
+		}
+	}
+	if (NumRunning == 0)
+	{
+		return;
+	}
+	int Share = std::max(NODES_PER_TICK / NumRunning, MIN_NODES_PER_SEARCH);
+	int Budget = NODES_PER_TICK;
+	size_t NumSearches = m_Searches.size();
+	m_NextSearch = (m_NextSearch + 1) % NumSearches;
+	for (size_t i = 0; (i < NumSearches) && (Budget > 0); i++)
+	{
+		cPathSearch & Search = *m_Searches[(m_NextSearch + i) % NumSearches];
+		if (!Search.IsRunning())
+		{
+			continue;
+		}
+		int SearchBudget = std::min(Share, Budget);
+		int Used = SearchBudget;
+		Search.Step(SearchBudget);
+		Budget -= Used - SearchBudget;
+	}
+}
+
+
+
+
+
+cPathSnapshotPtr cPathFinder::GetSnapshot(const Vector3i & a_Center)
+{
+	// Reuse a snapshot whose center is close enough for the search to have enough room around the goal:
+	for (const auto & Snapshot : m_Snapshots)
+	{
+		const Vector3i & Center = Snapshot->GetCenter();
+		int MaxDistance = Snapshot->GetHorzRadius() / 4;
+		if (
+			(std::abs(Center.x - a_Center.x) <= MaxDistance) &&
+			(std::abs(Center.z - a_Center.z) <= MaxDistance) &&
+			(std::abs(Center.y - a_Center.y) <= SNAPSHOT_VERT_RADIUS / 4)
+		)
+		{
+			return Snapshot;
+		}
+	}
+
+	cPathSnapshotPtr Snapshot = std::make_shared<cPathSnapshot>(m_World, a_Center, SNAPSHOT_HORZ_RADIUS, SNAPSHOT_VERT_RADIUS);
+	if (!Snapshot->IsValid())
+	{
+		// Close to the edge of the loaded area, try a smaller one:
+		Snapshot = std::make_shared<cPathSnapshot>(m_World, a_Center, SNAPSHOT_SMALL_HORZ_RADIUS, SNAPSHOT_VERT_RADIUS);
+	}
+	m_Snapshots.push_back(Snapshot);
+	return Snapshot;
+}
+
+
+
+
@@ -0,0 +1,230 @@
+
+// PathFinder.h
+
+// Declares the cPathFinder class representing the per-world service that finds walking paths for the mobs
+
+/*
+The path finding runs on read-only snapshots of the blocks around the goal (cPathSnapshot), so that it doesn't need
+to lock the chunkmap for each block it examines. The snapshot also caches which blocks a mob can stand in, per block
+column, computed the first time a column is examined. Snapshots are reused by later searches nearby for a short time.
+
+Each search (cPathSearch) is an A* that runs backwards, from the goal towards the mob. Since the search remembers,
+for every block it has closed, the next step towards the goal, the same search serves all the mobs heading for the
+same goal block (typically the mobs chasing the same player): once a mob's position is closed, its path is read off
+the search directly, and the searches for other mobs continue from where the previous ones stopped.
+
+The searches don't run when the mobs request them, cPathFinder::Tick() advances all the running searches, up to
+a fixed number of examined blocks per tick in total; long searches thus spread over several ticks.
+
+Everything is accessed from the world's tick thread only, so there's no locking.
+*/
+
+
+
+
+
+#pragma once
+
+#include <unordered_map>
+#include "../BlockArea.h"
+
+
+
+
+
+// fwd:
+class cWorld;
+
+
+
+
+
+/** A read-only copy of the block types around a point, with cached walkability of its block columns. */
+class cPathSnapshot
+{
+public:
+	/** Reads the blocks within the specified distances of the center. */
+	cPathSnapshot(cWorld & a_World, const Vector3i & a_Center, int a_HorzRadius, int a_VertRadius);
+
+	/** Returns true if the blocks have been read. False if some of the chunks were not loaded; all searches in such a snapshot fail. */
+	bool IsValid(void) const { return (m_Area.GetBlockTypes() != nullptr); }
+
+	/** Returns true if the snapshot contains the specified block, as well as the blocks directly below and above it. */
+	bool IsInside(const Vector3i & a_BlockPos) const;
+
+	/** Returns true if a mob can stand in the specified block: it has a floor, and room for the mob's body. */
+	bool IsStandable(const Vector3i & a_BlockPos);
+
+	/** Returns true if a mob standing in a_From can walk, jump or drop down into the neighboring column at a_To.
+	Both positions need to be standable. */
+	bool CanMove(const Vector3i & a_From, const Vector3i & a_To) const;
+
+	/** Returns the standable block in the column closest to the specified height, within a_MaxDistance blocks.
+	Returns false if there's none. */
+	bool FindStandable(Vector3i & a_BlockPos, int a_MaxDistance);
+
+	/** Returns the index of the block, unique within the snapshot. The block must be inside the snapshot. */
+	int MakeIndex(const Vector3i & a_BlockPos) const;
+
+	/** Returns the block position for an index returned by MakeIndex(). */
+	Vector3i IndexToPos(int a_Index) const;
+
+	const Vector3i & GetCenter(void) const { return m_Center; }
+	int GetHorzRadius(void) const { return m_HorzRadius; }
+	Int64 GetWorldAge(void) const { return m_WorldAge; }
+
+protected:
+	/** The world age at which the snapshot was taken. */
+	Int64 m_WorldAge;
+
+	Vector3i m_Center;
+	int m_HorzRadius;
+
+	/** The block types. */
+	cBlockArea m_Area;
+
+	/** Bit y is set if a mob can stand in the block at relative height y of the column. Valid if m_IsColumnCached is set. */
+	std::vector<UInt64> m_Standable;
+	std::vector<bool> m_IsColumnCached;
+
+
+	/** Returns true if the block type doesn't block a mob's movement. */
+	bool IsPassable(const Vector3i & a_BlockPos) const;
+
+	/** Fills m_Standable for the column at the specified relative coords. */
+	void CacheColumn(int a_RelX, int a_RelZ);
+} ;
+
+typedef std::shared_ptr<cPathSnapshot> cPathSnapshotPtr;
+
+
+
+
+
+/** A single A* search from a goal backwards to the mobs that want to reach it. */
+class cPathSearch
+{
+public:
+	enum eStatus
+	{
+		psSearching,  ///< The path is not known yet
+		psFound,      ///< The path has been found
+		psNotFound,   ///< There is no path to the goal
+	} ;
+
+	cPathSearch(cPathSnapshotPtr a_Snapshot, const Vector3i & a_Goal, Int64 a_WorldAge);
+
+	/** Returns the path from the specified block to the goal, if known, in a_Path, excluding the start and including the goal.
+	If it's not known yet, the search will look for it in the following ticks. */
+	eStatus GetPath(const Vector3i & a_Start, std::vector<Vector3i> & a_Path);
+
+	/** Examines up to a_Budget blocks, decreasing a_Budget by the number of blocks examined. */
+	void Step(int & a_Budget);
+
+	/** Stops the search for good. Paths already found can still be read, any other is reported as not found. */
+	void Stop(void);
+
+	/** Returns true if the search is waiting for the budget to continue. */
+	bool IsRunning(void) const { return !m_Starts.empty(); }
+
+	const Vector3i & GetGoal(void) const { return m_Goal; }
+	Int64 GetWorldAge(void) const { return m_WorldAge; }
+
+protected:
+	struct sNode
+	{
+		/** The walking distance from this block to the goal, in 1/10 blocks. */
+		int m_Cost;
+
+		/** Index of the next block on the path to the goal, -1 for the goal itself. */
+		int m_Next;
+
+		bool m_IsClosed;
+	} ;
+
+	struct sOpenItem
+	{
+		int m_Index;
+		int m_Cost;
+		int m_Estimate;
+
+		/** Orders the items for a min-heap by m_Estimate. */
+		bool operator < (const sOpenItem & a_Other) const { return (m_Estimate > a_Other.m_Estimate); }
+	} ;
+
+
+	cPathSnapshotPtr m_Snapshot;
+
+	/** The goal block as requested. The search starts from the nearest standable block. */
+	Vector3i m_Goal;
+
+	/** The world age at which the search has been created. */
+	Int64 m_WorldAge;
+
+	/** All the blocks that the search has reached, keyed by their snapshot index. */
+	std::unordered_map<int, sNode> m_Nodes;
+
+	/** The blocks to examine, a heap ordered by their estimated total cost. */
+	std::vector<sOpenItem> m_Open;
+
+	/** The requested starts that haven't been closed yet. The first one is the one the search heads for. */
+	std::vector<Vector3i> m_Starts;
+
+	/** Number of blocks closed so far. */
+	int m_NumClosed;
+
+	/** Set when the search cannot reach any more blocks, or has been stopped. */
+	bool m_IsExhausted;
+
+
+	/** Returns the estimated cost of walking from the goal-side block to the current start. */
+	int GetEstimate(const Vector3i & a_BlockPos) const;
+
+	/** Returns true if the block at the specified index has been closed. */
+	bool IsClosed(int a_Index) const;
+
+	/** Removes the closed starts from m_Starts. If the start that the search heads for changes, re-sorts m_Open. */
+	void UpdateStarts(void);
+
+	/** Recalculates the estimates of all the open blocks for the current start and re-sorts m_Open. */
+	void ReorderOpen(void);
+} ;
+
+typedef std::shared_ptr<cPathSearch> cPathSearchPtr;
+
+
+
+
+
+/** The per-world path finding service, shares the searches among the mobs and spreads them over the ticks. */
+class cPathFinder
+{
+public:
+	cPathFinder(cWorld & a_World);
+
+	/** Returns the search for paths to the specified goal. Reuses a recent search for the same goal block, if there's one. */
+	cPathSearchPtr FindPath(const Vector3d & a_Goal);
+
+	/** Advances the running searches, and drops the old ones. Called from the world's tick. */
+	void Tick(void);
+
+protected:
+	cWorld & m_World;
+
+	/** The recent searches. Searches older than their lifetime are stopped and dropped, the world may have changed since. */
+	std::vector<cPathSearchPtr> m_Searches;
+
+	/** The recent snapshots. */
+	std::vector<cPathSnapshotPtr> m_Snapshots;
+
+	/** Index into m_Searches of the search to advance first in the next tick, so that the budget is shared fairly. */
+	size_t m_NextSearch;
+
+
+	/** Returns a recent snapshot centered close enough to the specified point, or takes a new one. */
+	cPathSnapshotPtr GetSnapshot(const Vector3i & a_Center);
+} ;
+
+
+
+
@@ -9,6 +9,9 @@
 #include <fstream>
 #ifdef _WIN32
 	#include <share.h>  // for _SH_DENYWRITE
+	#include <io.h>     // for _commit()
+#else
+	#include <unistd.h>  // for fsync()
 #endif  // _WIN32
 
 
@@ -475,3 +478,20 @@ void cFile::Flush(void)
 
 
 
+
+bool cFile::Sync(void)
+{
+	if (fflush(m_File) != 0)
+	{
+		return false;
+	}
+	#ifdef _WIN32
+		return (_commit(_fileno(m_File)) == 0);
+	#else
+		return (fsync(fileno(m_File)) == 0);
+	#endif
+}
+
+
+
+
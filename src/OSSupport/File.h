@@ -137,6 +137,10 @@ public:
 	/** Flushes all the bufferef output into the file (only when writing) */
 	void Flush(void);
 	
+	/** Flushes all the buffered output and makes the OS write the file data to the disk, so that it survives a crash.
+	Much slower than Flush(). Returns true on success. */
+	bool Sync(void);
+	
 private:
 	#ifdef USE_STDIO_FILE
 	FILE * m_File;
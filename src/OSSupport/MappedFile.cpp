@@ -0,0 +1,129 @@
+
+// MappedFile.cpp
+
+// Implements the cMappedFile class representing a read-only memory mapping of a whole file
+
+#include "Globals.h"  // NOTE: MSVC stupidness requires this to be the same across all modules
+
+#include "MappedFile.h"
+#ifndef _WIN32
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif  // _WIN32
+
+
+
+
+
+cMappedFile::cMappedFile(void) :
+	m_Data(nullptr),
+	m_Size(0)
+	#ifdef _WIN32
+	, m_File(INVALID_HANDLE_VALUE),
+	m_Mapping(nullptr)
+	#endif  // _WIN32
+{
+}
+
+
+
+
+
+cMappedFile::~cMappedFile()
+{
+	Unmap();
+}
+
+
+
+
+
+bool cMappedFile::Map(const AString & a_FileName)
+{
+	Unmap();
+	AString FileName = FILE_IO_PREFIX + a_FileName;
+
+	#ifdef _WIN32
+		m_File = CreateFileA(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER Size;
+		if (!GetFileSizeEx(m_File, &Size) || (Size.QuadPart == 0) || (static_cast<ULONGLONG>(Size.QuadPart) > std::numeric_limits<size_t>::max()))
+		{
+			Unmap();
+			return false;
+		}
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping == nullptr)
+		{
+			Unmap();
+			return false;
+		}
+		m_Data = static_cast<const char *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_Data == nullptr)
+		{
+			Unmap();
+			return false;
+		}
+		m_Size = static_cast<size_t>(Size.QuadPart);
+	#else
+		int File = open(FileName.c_str(), O_RDONLY);
+		if (File < 0)
+		{
+			return false;
+		}
+		struct stat Stat;
+		if ((fstat(File, &Stat) != 0) || (Stat.st_size <= 0))
+		{
+			close(File);
+			return false;
+		}
+		void * Data = mmap(nullptr, static_cast<size_t>(Stat.st_size), PROT_READ, MAP_SHARED, File, 0);
+		close(File);  // The mapping keeps its own reference to the file
+		if (Data == MAP_FAILED)
+		{
+			return false;
+		}
+		m_Data = static_cast<const char *>(Data);
+		m_Size = static_cast<size_t>(Stat.st_size);
+	#endif  // else _WIN32
+
+	return true;
+}
+
+
+
+
+
+void cMappedFile::Unmap(void)
+{
+	#ifdef _WIN32
+		if (m_Data != nullptr)
+		{
+			UnmapViewOfFile(m_Data);
+		}
+		if (m_Mapping != nullptr)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+		if (m_File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_File);
+			m_File = INVALID_HANDLE_VALUE;
+		}
+	#else
+		if (m_Data != nullptr)
+		{
+			munmap(const_cast<char *>(m_Data), m_Size);
+		}
+	#endif  // else _WIN32
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+
+
+
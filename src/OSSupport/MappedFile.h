@@ -0,0 +1,58 @@
+
+// MappedFile.h
+
+// Declares the cMappedFile class representing a read-only memory mapping of a whole file
+
+/*
+The mapping covers the file as it was when mapped; the file may be written by other means meanwhile
+(the writes become visible in the mapping once they reach the OS, i.e. after the writer flushes them),
+but the mapping doesn't grow with the file - map the file anew to see the data appended to it.
+The file may even be replaced (renamed over) or deleted, the mapping keeps the old contents available.
+The object has no multithreading locks, but since it is read-only, it can be read from multiple threads at once.
+*/
+
+
+
+
+
+#pragma once
+
+
+
+
+
+class cMappedFile
+{
+public:
+	cMappedFile(void);
+	~cMappedFile();
+
+	/** Maps the whole specified file (FILE_IO_PREFIX is prepended). Returns false if the file cannot be opened or is empty. */
+	bool Map(const AString & a_FileName);
+
+	/** Unmaps the file, if mapped. */
+	void Unmap(void);
+
+	bool IsMapped(void) const { return (m_Data != nullptr); }
+
+	/** Returns the mapped contents, nullptr if not mapped. */
+	const char * GetData(void) const { return m_Data; }
+
+	/** Returns the size of the mapped contents, in bytes. */
+	size_t GetSize(void) const { return m_Size; }
+
+protected:
+	const char * m_Data;
+	size_t m_Size;
+
+	#ifdef _WIN32
+	HANDLE m_File;
+	HANDLE m_Mapping;
+	#endif  // _WIN32
+} ;
+
+typedef std::shared_ptr<cMappedFile> cMappedFilePtr;
+
+
+
+
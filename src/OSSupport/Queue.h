@@ -97,6 +97,66 @@ public:
 	}
 
 
+	/** Dequeues the item with the lowest priority value from the queue, if any are present.
+	a_GetPriority is called for each item and returns its priority as an int; of the items with the same priority,
+	the one queued first is dequeued.
+	Returns true if successful. Value of item is undefined if dequeuing was unsuccessful. */
+	template <class PriorityFn>
+	bool TryDequeueBestItem(ItemType & item, PriorityFn a_GetPriority)
+	{
+		cCSLock Lock(m_CS);
+		iterator Best = m_Contents.end();
+		int BestPriority = 0;
+		for (iterator itr = m_Contents.begin(); itr != m_Contents.end(); ++itr)
+		{
+			int Priority = a_GetPriority(*itr);
+			if ((Best == m_Contents.end()) || (Priority < BestPriority))
+			{
+				Best = itr;
+				BestPriority = Priority;
+			}
+		}
+		if (Best == m_Contents.end())
+		{
+			return false;
+		}
+		item = *Best;
+		m_Contents.erase(Best);
+		m_evtRemoved.Set();
+		return true;
+	}
+
+
+	/** Dequeues up to a_MaxCount items for which a_ShouldDequeue returns true, in the queue order, appending them to a_Items.
+	The predicate may look at a_Items to see the items already dequeued by this call (e.g. to form batches of related items).
+	Returns true if at least one item was dequeued. */
+	template <class Predicate>
+	bool TryDequeueItems(std::vector<ItemType> & a_Items, size_t a_MaxCount, Predicate a_ShouldDequeue)
+	{
+		cCSLock Lock(m_CS);
+		size_t NumDequeued = 0;
+		for (auto itr = m_Contents.begin(); (itr != m_Contents.end()) && (NumDequeued < a_MaxCount);)
+		{
+			if (a_ShouldDequeue(*itr))
+			{
+				a_Items.push_back(*itr);
+				itr = m_Contents.erase(itr);
+				NumDequeued += 1;
+			}
+			else
+			{
+				++itr;
+			}
+		}  // for itr - m_Contents[]
+		if (NumDequeued == 0)
+		{
+			return false;
+		}
+		m_evtRemoved.Set();
+		return true;
+	}
+
+
 	/// Dequeues an item from the queue, blocking until an item is available.
 	ItemType DequeueItem(void)
 	{
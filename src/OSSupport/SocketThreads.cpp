@@ -9,6 +9,11 @@
 #include "SocketThreads.h"
 #include "Errors.h"
 
+#ifdef SOCKETTHREADS_USE_EPOLL
+	#include <sys/eventfd.h>
+	#include <unistd.h>
+#endif
+
 
 
 
@@ -140,8 +145,13 @@ void cSocketThreads::Write(const cCallback * a_Client, const AString & a_Data)
 
 cSocketThreads::cSocketThread::cSocketThread(cSocketThreads * a_Parent) :
 	cIsThread("cSocketThread"),
-	m_Parent(a_Parent),
-	m_NumSlots(0)
+	m_Parent(a_Parent)
+	#ifdef SOCKETTHREADS_USE_EPOLL
+	,
+	m_EpollFD(-1),
+	m_EventFD(-1),
+	m_LastSlotID(0)
+	#endif
 {
 	// Nothing needed yet
 }
@@ -155,15 +165,20 @@ cSocketThreads::cSocketThread::~cSocketThread()
 	m_ShouldTerminate = true;
 
 	// Notify the thread:
-	ASSERT(m_ControlSocket2.IsValid());
-	m_ControlSocket2.Send("a", 1);
+	Notify();
 
 	// Wait for the thread to finish:
 	Wait();
 	
-	// Close the control sockets:
-	m_ControlSocket1.CloseSocket();
-	m_ControlSocket2.CloseSocket();
+	#ifdef SOCKETTHREADS_USE_EPOLL
+		// Close the epoll and the eventfd:
+		close(m_EpollFD);
+		close(m_EventFD);
+	#else
+		// Close the control sockets:
+		m_ControlSocket1.CloseSocket();
+		m_ControlSocket2.CloseSocket();
+	#endif
 }
 
 
@@ -173,18 +188,35 @@ cSocketThreads::cSocketThread::~cSocketThread()
 void cSocketThreads::cSocketThread::AddClient(const cSocket & a_Socket, cCallback * a_Client)
 {
 	ASSERT(m_Parent->m_CS.IsLockedByCurrentThread());
-	ASSERT(m_NumSlots < MAX_SLOTS);  // Use HasEmptySlot() to check before adding
+	ASSERT(HasEmptySlot());  // Use HasEmptySlot() to check before adding
+	
+	sSlot Slot;
+	Slot.m_Client = a_Client;
+	Slot.m_Socket = a_Socket;
+	Slot.m_Socket.SetNonBlocking();
+	Slot.m_OutgoingOffset = 0;
+	Slot.m_State = sSlot::ssNormal;
 	
-	m_Slots[m_NumSlots].m_Client = a_Client;
-	m_Slots[m_NumSlots].m_Socket = a_Socket;
-	m_Slots[m_NumSlots].m_Socket.SetNonBlocking();
-	m_Slots[m_NumSlots].m_Outgoing.clear();
-	m_Slots[m_NumSlots].m_State = sSlot::ssNormal;
-	m_NumSlots++;
+	#ifdef SOCKETTHREADS_USE_EPOLL
+		// Register the socket in the epoll, edge-triggered:
+		Slot.m_ID = ++m_LastSlotID;
+		Slot.m_IsWritable = true;
+		epoll_event Event;
+		Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		Event.data.u64 = Slot.m_ID;
+		if (epoll_ctl(m_EpollFD, EPOLL_CTL_ADD, Slot.m_Socket.GetSocket(), &Event) != 0)
+		{
+			LOGERROR("Cannot add socket for client \"%s\" to a cSocketThread's epoll (\"%s\"); the client won't receive any data.",
+				Slot.m_Socket.GetIPString().c_str(), cSocket::GetLastErrorString().c_str()
+			);
+		}
+		m_SlotIndices[Slot.m_ID] = m_Slots.size();
+	#endif
+	
+	m_Slots.push_back(Slot);
 	
 	// Notify the thread of the change:
-	ASSERT(m_ControlSocket2.IsValid());
-	m_ControlSocket2.Send("a", 1);
+	Notify();
 }
 
 
@@ -195,12 +227,7 @@ bool cSocketThreads::cSocketThread::RemoveClient(const cCallback * a_Client)
 {
 	ASSERT(m_Parent->m_CS.IsLockedByCurrentThread());
 	
-	if (m_NumSlots == 0)
-	{
-		return false;
-	}
-	
-	for (int i = m_NumSlots - 1; i >= 0 ; --i)
+	for (size_t i = m_Slots.size(); i-- > 0;)
 	{
 		if (m_Slots[i].m_Client != a_Client)
 		{
@@ -215,14 +242,12 @@ bool cSocketThreads::cSocketThread::RemoveClient(const cCallback * a_Client)
 			{
 				m_Slots[i].m_Socket.CloseSocket();
 			}
-			m_Slots[i] = m_Slots[--m_NumSlots];
+			RemoveSlot(i);
 		}
 		else
 		{
 			// Query and queue the last batch of outgoing data:
-			AString Data;
-			m_Slots[i].m_Client->GetOutgoingData(Data);
-			m_Slots[i].m_Outgoing.append(Data);
+			QueryOutgoingData(m_Slots[i]);
 			if (m_Slots[i].m_Outgoing.empty())
 			{
 				// No more outgoing data, shut the socket down immediately:
@@ -238,8 +263,7 @@ bool cSocketThreads::cSocketThread::RemoveClient(const cCallback * a_Client)
 		}
 		
 		// Notify the thread of the change:
-		ASSERT(m_ControlSocket2.IsValid());
-		m_ControlSocket2.Send("r", 1);
+		Notify();
 		return true;
 	}  // for i - m_Slots[]
 	
@@ -255,13 +279,13 @@ bool cSocketThreads::cSocketThread::HasClient(const cCallback * a_Client) const
 {
 	ASSERT(m_Parent->m_CS.IsLockedByCurrentThread());
 
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (cSlots::const_iterator itr = m_Slots.begin(), end = m_Slots.end(); itr != end; ++itr)
 	{
-		if (m_Slots[i].m_Client == a_Client)
+		if (itr->m_Client == a_Client)
 		{
 			return true;
 		}
-	}  // for i - m_Slots[]
+	}  // for itr - m_Slots[]
 	return false;
 }
 
@@ -271,13 +295,13 @@ bool cSocketThreads::cSocketThread::HasClient(const cCallback * a_Client) const
 
 bool cSocketThreads::cSocketThread::HasSocket(const cSocket * a_Socket) const
 {
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (cSlots::const_iterator itr = m_Slots.begin(), end = m_Slots.end(); itr != end; ++itr)
 	{
-		if (m_Slots[i].m_Socket == *a_Socket)
+		if (itr->m_Socket.GetSocket() == a_Socket->GetSocket())
 		{
 			return true;
 		}
-	}  // for i - m_Slots[]
+	}  // for itr - m_Slots[]
 	return false;
 }
 
@@ -292,8 +316,7 @@ bool cSocketThreads::cSocketThread::NotifyWrite(const cCallback * a_Client)
 	if (HasClient(a_Client))
 	{
 		// Notify the thread that there's another packet in the queue:
-		ASSERT(m_ControlSocket2.IsValid());
-		m_ControlSocket2.Send("q", 1);
+		Notify();
 		return true;
 	}
 	return false;
@@ -306,19 +329,21 @@ bool cSocketThreads::cSocketThread::NotifyWrite(const cCallback * a_Client)
 bool cSocketThreads::cSocketThread::Write(const cCallback * a_Client, const AString & a_Data)
 {
 	ASSERT(m_Parent->m_CS.IsLockedByCurrentThread());
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (cSlots::iterator itr = m_Slots.begin(), end = m_Slots.end(); itr != end; ++itr)
 	{
-		if (m_Slots[i].m_Client == a_Client)
+		if (itr->m_Client == a_Client)
 		{
-			m_Slots[i].m_Outgoing.append(a_Data);
+			if (!a_Data.empty())
+			{
+				itr->m_Outgoing.push_back(std::make_shared<const AString>(a_Data));
+			}
 			
 			// Notify the thread that there's data in the queue:
-			ASSERT(m_ControlSocket2.IsValid());
-			m_ControlSocket2.Send("q", 1);
+			Notify();
 			
 			return true;
 		}
-	}  // for i - m_Slots[]
+	}  // for itr - m_Slots[]
 	return false;
 }
 
@@ -326,6 +351,150 @@ bool cSocketThreads::cSocketThread::Write(const cCallback * a_Client, const AStr
 
 
 
+#ifdef SOCKETTHREADS_USE_EPOLL
+
+bool cSocketThreads::cSocketThread::Start(void)
+{
+	// Create the epoll and the eventfd used for waking up the thread:
+	m_EpollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (m_EpollFD < 0)
+	{
+		LOGERROR("Cannot create an epoll for a cSocketThread (\"%s\"); continuing, but server may be unreachable from now on.", cSocket::GetLastErrorString().c_str());
+		return false;
+	}
+	m_EventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_EventFD < 0)
+	{
+		LOGERROR("Cannot create an eventfd for a cSocketThread (\"%s\"); continuing, but server may be unreachable from now on.", cSocket::GetLastErrorString().c_str());
+		close(m_EpollFD);
+		m_EpollFD = -1;
+		return false;
+	}
+	epoll_event Event;
+	Event.events = EPOLLIN;
+	Event.data.u64 = 0;
+	if (epoll_ctl(m_EpollFD, EPOLL_CTL_ADD, m_EventFD, &Event) != 0)
+	{
+		LOGERROR("Cannot add the eventfd to a cSocketThread's epoll (\"%s\"); continuing, but server may be unreachable from now on.", cSocket::GetLastErrorString().c_str());
+		close(m_EventFD);
+		close(m_EpollFD);
+		m_EventFD = -1;
+		m_EpollFD = -1;
+		return false;
+	}
+
+	// Start the thread
+	if (!super::Start())
+	{
+		LOGERROR("Cannot start new cSocketThread");
+		close(m_EventFD);
+		close(m_EpollFD);
+		m_EventFD = -1;
+		m_EpollFD = -1;
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+void cSocketThreads::cSocketThread::Execute(void)
+{
+	// The main thread loop:
+	epoll_event Events[256];
+	while (!m_ShouldTerminate)
+	{
+		// Read outgoing data from the clients and send whatever the sockets can take:
+		QueueOutgoingData();
+		WriteToSockets();
+		
+		// Wait for the sockets:
+		int NumEvents = epoll_wait(m_EpollFD, Events, ARRAYCOUNT(Events), 5000);
+		if (NumEvents < 0)
+		{
+			if (errno != EINTR)
+			{
+				LOG("epoll_wait() call failed in cSocketThread: \"%s\"", cSocket::GetLastErrorString().c_str());
+			}
+			continue;
+		}
+		
+		// Perform the IO:
+		ProcessEvents(Events, NumEvents);
+		WriteToSockets();
+		CleanUpShutSockets();
+	}  // while (!mShouldTerminate)
+}
+
+
+
+
+
+void cSocketThreads::cSocketThread::Notify(void)
+{
+	ASSERT(m_EventFD >= 0);
+	eventfd_write(m_EventFD, 1);
+}
+
+
+
+
+
+void cSocketThreads::cSocketThread::ProcessEvents(const epoll_event * a_Events, int a_NumEvents)
+{
+	cCSLock Lock(m_Parent->m_CS);
+	for (int i = 0; i < a_NumEvents; i++)
+	{
+		if (a_Events[i].data.u64 == 0)
+		{
+			// Reset the eventfd state:
+			eventfd_t Dummy;
+			eventfd_read(m_EventFD, &Dummy);
+			continue;
+		}
+		
+		// Find the slot; it may have been removed by an earlier event in this batch:
+		std::unordered_map<UInt64, size_t>::const_iterator itr = m_SlotIndices.find(a_Events[i].data.u64);
+		if (itr == m_SlotIndices.end())
+		{
+			continue;
+		}
+		size_t Idx = itr->second;
+		
+		if ((a_Events[i].events & EPOLLOUT) != 0)
+		{
+			m_Slots[Idx].m_IsWritable = true;
+		}
+		if ((a_Events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+		{
+			// The socket is edge-triggered, read everything that is available:
+			while (ReadFromSlot(Idx))
+			{
+			}
+		}
+	}  // for i - a_Events[]
+}
+
+
+
+
+
+void cSocketThreads::cSocketThread::WriteToSockets(void)
+{
+	cCSLock Lock(m_Parent->m_CS);
+	for (size_t i = m_Slots.size(); i-- > 0;)
+	{
+		if (m_Slots[i].m_IsWritable && m_Slots[i].m_Socket.IsValid())
+		{
+			WriteToSlot(i);
+		}
+	}  // for i - m_Slots[]
+}
+
+#else  // SOCKETTHREADS_USE_EPOLL
+
 bool cSocketThreads::cSocketThread::Start(void)
 {
 	// Create the control socket listener
@@ -425,6 +594,16 @@ void cSocketThreads::cSocketThread::Execute(void)
 
 
 
+void cSocketThreads::cSocketThread::Notify(void)
+{
+	ASSERT(m_ControlSocket2.IsValid());
+	m_ControlSocket2.Send("a", 1);
+}
+
+
+
+
+
 void cSocketThreads::cSocketThread::PrepareSets(fd_set * a_Read, fd_set * a_Write, cSocket::xSocket & a_Highest)
 {
 	FD_ZERO(a_Read);
@@ -432,29 +611,29 @@ void cSocketThreads::cSocketThread::PrepareSets(fd_set * a_Read, fd_set * a_Writ
 	FD_SET(m_ControlSocket1.GetSocket(), a_Read);
 
 	cCSLock Lock(m_Parent->m_CS);
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (cSlots::const_iterator itr = m_Slots.begin(), end = m_Slots.end(); itr != end; ++itr)
 	{
-		if (!m_Slots[i].m_Socket.IsValid())
+		if (!itr->m_Socket.IsValid())
 		{
 			continue;
 		}
-		if (m_Slots[i].m_State == sSlot::ssRemoteClosed)
+		if (itr->m_State == sSlot::ssRemoteClosed)
 		{
 			// This socket won't provide nor consume any data anymore, don't put it in the Set
 			continue;
 		}
-		cSocket::xSocket s = m_Slots[i].m_Socket.GetSocket();
+		cSocket::xSocket s = itr->m_Socket.GetSocket();
 		FD_SET(s, a_Read);
 		if (s > a_Highest)
 		{
 			a_Highest = s;
 		}
-		if (!m_Slots[i].m_Outgoing.empty())
+		if (!itr->m_Outgoing.empty())
 		{
 			// There's outgoing data for the socket, put it in the Write set
 			FD_SET(s, a_Write);
 		}
-	}  // for i - m_Slots[]
+	}  // for itr - m_Slots[]
 }
 
 
@@ -474,64 +653,14 @@ void cSocketThreads::cSocketThread::ReadFromSockets(fd_set * a_Read)
 
 	// Read from clients:
 	cCSLock Lock(m_Parent->m_CS);
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (size_t i = m_Slots.size(); i-- > 0;)
 	{
 		cSocket::xSocket Socket = m_Slots[i].m_Socket.GetSocket();
 		if (!cSocket::IsValidSocket(Socket) || !FD_ISSET(Socket, a_Read))
 		{
 			continue;
 		}
-		char Buffer[1024];
-		int Received = m_Slots[i].m_Socket.Receive(Buffer, ARRAYCOUNT(Buffer), 0);
-		if (Received <= 0)
-		{
-			if (cSocket::GetLastError() != cSocket::ErrWouldBlock)
-			{
-				// The socket has been closed by the remote party
-				switch (m_Slots[i].m_State)
-				{
-					case sSlot::ssNormal:
-					{
-						// Close the socket on our side:
-						m_Slots[i].m_State = sSlot::ssRemoteClosed;
-						m_Slots[i].m_Socket.CloseSocket();
-
-						// Notify the callback that the remote has closed the socket, *after* removing the socket:
-						cCallback * client = m_Slots[i].m_Client;
-						m_Slots[i] = m_Slots[--m_NumSlots];
-						if (client != nullptr)
-						{
-							client->SocketClosed();
-						}
-						break;
-					}
-					case sSlot::ssWritingRestOut:
-					case sSlot::ssShuttingDown:
-					case sSlot::ssShuttingDown2:
-					{
-						// Force-close the socket and remove the slot:
-						m_Slots[i].m_Socket.CloseSocket();
-						m_Slots[i] = m_Slots[--m_NumSlots];
-						break;
-					}
-					default:
-					{
-						LOG("%s: Unexpected socket state: %d (%s)",
-							__FUNCTION__, m_Slots[i].m_Socket.GetSocket(), m_Slots[i].m_Socket.GetIPString().c_str()
-						);
-						ASSERT(!"Unexpected socket state");
-						break;
-					}
-				}  // switch (m_Slots[i].m_State)
-			}
-		}
-		else
-		{
-			if (m_Slots[i].m_Client != nullptr)
-			{
-				m_Slots[i].m_Client->DataReceived(Buffer, Received);
-			}
-		}
+		ReadFromSlot(i);
 	}  // for i - m_Slots[]
 }
 
@@ -543,7 +672,7 @@ void cSocketThreads::cSocketThread::WriteToSockets(fd_set * a_Write)
 {
 	// Write to available client sockets:
 	cCSLock Lock(m_Parent->m_CS);
-	for (int i = m_NumSlots - 1; i >= 0; --i)
+	for (size_t i = m_Slots.size(); i-- > 0;)
 	{
 		cSocket::xSocket Socket = m_Slots[i].m_Socket.GetSocket();
 		if (!cSocket::IsValidSocket(Socket) || !FD_ISSET(Socket, a_Write))
@@ -553,12 +682,7 @@ void cSocketThreads::cSocketThread::WriteToSockets(fd_set * a_Write)
 		if (m_Slots[i].m_Outgoing.empty())
 		{
 			// Request another chunk of outgoing data:
-			if (m_Slots[i].m_Client != nullptr)
-			{
-				AString Data;
-				m_Slots[i].m_Client->GetOutgoingData(Data);
-				m_Slots[i].m_Outgoing.append(Data);
-			}
+			QueryOutgoingData(m_Slots[i]);
 			if (m_Slots[i].m_Outgoing.empty())
 			{
 				// No outgoing data is ready
@@ -571,53 +695,182 @@ void cSocketThreads::cSocketThread::WriteToSockets(fd_set * a_Write)
 			}
 		}  // if (outgoing data is empty)
 		
-		if (m_Slots[i].m_State == sSlot::ssRemoteClosed)
+		WriteToSlot(i);
+
+		// _X: If there's data left, it means the client is not reading fast enough, the server would unnecessarily spin in the main loop with zero actions taken; so signalling is disabled
+		// This means that if there's data left, it will be sent only when there's incoming data or someone queues another packet (for any socket handled by this thread)
+	}  // for i - m_Slots[i]
+}
+
+#endif  // else SOCKETTHREADS_USE_EPOLL
+
+
+
+
+
+void cSocketThreads::cSocketThread::RemoveSlot(size_t a_Idx)
+{
+	ASSERT(a_Idx < m_Slots.size());
+	
+	#ifdef SOCKETTHREADS_USE_EPOLL
+		m_SlotIndices.erase(m_Slots[a_Idx].m_ID);
+		if (a_Idx + 1 < m_Slots.size())
 		{
-			continue;
+			m_SlotIndices[m_Slots.back().m_ID] = a_Idx;
 		}
-		
-		if (!SendDataThroughSocket(m_Slots[i].m_Socket, m_Slots[i].m_Outgoing))
+	#endif
+	
+	if (a_Idx + 1 < m_Slots.size())
+	{
+		std::swap(m_Slots[a_Idx], m_Slots.back());
+	}
+	m_Slots.pop_back();
+}
+
+
+
+
+
+bool cSocketThreads::cSocketThread::ReadFromSlot(size_t a_Idx)
+{
+	sSlot & Slot = m_Slots[a_Idx];
+	if (!Slot.m_Socket.IsValid() || (Slot.m_State == sSlot::ssRemoteClosed))
+	{
+		return false;
+	}
+	char Buffer[16 KiB];
+	int Received = Slot.m_Socket.Receive(Buffer, ARRAYCOUNT(Buffer), 0);
+	if (Received > 0)
+	{
+		if (Slot.m_Client != nullptr)
 		{
-			int Err = cSocket::GetLastError();
-			LOGWARNING("Error %d while writing to client \"%s\", disconnecting. \"%s\"", Err, m_Slots[i].m_Socket.GetIPString().c_str(), GetOSErrorString(Err).c_str());
-			m_Slots[i].m_Socket.CloseSocket();
-			if (m_Slots[i].m_Client != nullptr)
+			Slot.m_Client->DataReceived(Buffer, static_cast<size_t>(Received));
+		}
+		return true;
+	}
+	
+	if ((Received < 0) && (cSocket::GetLastError() == cSocket::ErrWouldBlock))
+	{
+		// No more data for now
+		return false;
+	}
+	
+	// The socket has been closed by the remote party
+	switch (Slot.m_State)
+	{
+		case sSlot::ssNormal:
+		{
+			// Close the socket on our side:
+			Slot.m_State = sSlot::ssRemoteClosed;
+			Slot.m_Socket.CloseSocket();
+
+			// Notify the callback that the remote has closed the socket, *after* removing the socket:
+			cCallback * client = Slot.m_Client;
+			RemoveSlot(a_Idx);
+			if (client != nullptr)
 			{
-				m_Slots[i].m_Client->SocketClosed();
+				client->SocketClosed();
 			}
-			continue;
+			break;
 		}
-		
-		if (m_Slots[i].m_Outgoing.empty() && (m_Slots[i].m_State == sSlot::ssWritingRestOut))
+		case sSlot::ssWritingRestOut:
+		case sSlot::ssShuttingDown:
+		case sSlot::ssShuttingDown2:
+		{
+			// Force-close the socket and remove the slot:
+			Slot.m_Socket.CloseSocket();
+			RemoveSlot(a_Idx);
+			break;
+		}
+		default:
 		{
-			m_Slots[i].m_State = sSlot::ssShuttingDown;
-			m_Slots[i].m_Socket.ShutdownReadWrite();
+			LOG("%s: Unexpected socket state: %d (%s)",
+				__FUNCTION__, Slot.m_Socket.GetSocket(), Slot.m_Socket.GetIPString().c_str()
+			);
+			ASSERT(!"Unexpected socket state");
+			break;
 		}
+	}  // switch (Slot.m_State)
+	return false;
+}
 
-		// _X: If there's data left, it means the client is not reading fast enough, the server would unnecessarily spin in the main loop with zero actions taken; so signalling is disabled
-		// This means that if there's data left, it will be sent only when there's incoming data or someone queues another packet (for any socket handled by this thread)
-		/*
-		// If there's any data left, signalize the Control socket:
-		if (!m_Slots[i].m_Outgoing.empty())
+
+
+
+
+void cSocketThreads::cSocketThread::WriteToSlot(size_t a_Idx)
+{
+	sSlot & Slot = m_Slots[a_Idx];
+	if (Slot.m_Outgoing.empty() || (Slot.m_State == sSlot::ssRemoteClosed))
+	{
+		return;
+	}
+	
+	if (!SendDataThroughSocket(Slot))
+	{
+		int Err = cSocket::GetLastError();
+		LOGWARNING("Error %d while writing to client \"%s\", disconnecting. \"%s\"", Err, Slot.m_Socket.GetIPString().c_str(), GetOSErrorString(Err).c_str());
+		Slot.m_Socket.CloseSocket();
+		if (Slot.m_Client != nullptr)
 		{
-			ASSERT(m_ControlSocket2.IsValid());
-			m_ControlSocket2.Send("q", 1);
+			Slot.m_Client->SocketClosed();
 		}
-		*/
-	}  // for i - m_Slots[i]
+		return;
+	}
+	
+	#ifdef SOCKETTHREADS_USE_EPOLL
+		// If not everything was sent, the OS send buffer is full; wait for the next EPOLLOUT:
+		if (!Slot.m_Outgoing.empty())
+		{
+			Slot.m_IsWritable = false;
+		}
+	#endif
+	
+	if (Slot.m_Outgoing.empty() && (Slot.m_State == sSlot::ssWritingRestOut))
+	{
+		Slot.m_State = sSlot::ssShuttingDown;
+		Slot.m_Socket.ShutdownReadWrite();
+	}
 }
 
 
 
 
 
-bool cSocketThreads::cSocketThread::SendDataThroughSocket(cSocket & a_Socket, AString & a_Data)
+bool cSocketThreads::cSocketThread::SendDataThroughSocket(sSlot & a_Slot)
 {
-	// Send data in smaller chunks, so that the OS send buffers aren't overflown easily
-	while (!a_Data.empty())
+	while (!a_Slot.m_Outgoing.empty())
 	{
-		size_t NumToSend = std::min(a_Data.size(), (size_t)1024);
-		int Sent = a_Socket.Send(a_Data.data(), NumToSend);
+		// Gather the queued buffers for a single send call:
+		#ifdef _WIN32
+			WSABUF Buffers[64];
+		#else
+			iovec Buffers[64];
+		#endif
+		size_t NumBuffers = 0;
+		for (std::deque<cDataPtr>::const_iterator itr = a_Slot.m_Outgoing.begin(), end = a_Slot.m_Outgoing.end(); (itr != end) && (NumBuffers < ARRAYCOUNT(Buffers)); ++itr)
+		{
+			size_t Offset = (NumBuffers == 0) ? a_Slot.m_OutgoingOffset : 0;
+			#ifdef _WIN32
+				Buffers[NumBuffers].buf = const_cast<char *>((*itr)->data() + Offset);
+				Buffers[NumBuffers].len = static_cast<ULONG>((*itr)->size() - Offset);
+			#else
+				Buffers[NumBuffers].iov_base = const_cast<char *>((*itr)->data() + Offset);
+				Buffers[NumBuffers].iov_len = (*itr)->size() - Offset;
+			#endif
+			NumBuffers++;
+		}
+		
+		#ifdef _WIN32
+			DWORD NumSent = 0;
+			int Sent = (WSASend(a_Slot.m_Socket.GetSocket(), Buffers, static_cast<DWORD>(NumBuffers), &NumSent, 0, nullptr, nullptr) == 0) ? static_cast<int>(NumSent) : -1;
+		#else
+			msghdr Msg;
+			memset(&Msg, 0, sizeof(Msg));
+			Msg.msg_iov = Buffers;
+			Msg.msg_iovlen = NumBuffers;
+			ssize_t Sent = sendmsg(a_Slot.m_Socket.GetSocket(), &Msg, MSG_NOSIGNAL);
+		#endif
 		if (Sent < 0)
 		{
 			int Err = cSocket::GetLastError();
@@ -631,10 +884,24 @@ bool cSocketThreads::cSocketThread::SendDataThroughSocket(cSocket & a_Socket, AS
 		}
 		if (Sent == 0)
 		{
-			a_Socket.CloseSocket();
+			a_Slot.m_Socket.CloseSocket();
 			return true;
 		}
-		a_Data.erase(0, Sent);
+		
+		// Remove the sent data from the queue:
+		size_t NumLeft = static_cast<size_t>(Sent);
+		while (NumLeft > 0)
+		{
+			size_t Available = a_Slot.m_Outgoing.front()->size() - a_Slot.m_OutgoingOffset;
+			if (NumLeft < Available)
+			{
+				a_Slot.m_OutgoingOffset += NumLeft;
+				break;
+			}
+			NumLeft -= Available;
+			a_Slot.m_Outgoing.pop_front();
+			a_Slot.m_OutgoingOffset = 0;
+		}
 	}
 	return true;
 }
@@ -643,10 +910,40 @@ bool cSocketThreads::cSocketThread::SendDataThroughSocket(cSocket & a_Socket, AS
 
 
 
+void cSocketThreads::cSocketThread::QueryOutgoingData(sSlot & a_Slot)
+{
+	if (a_Slot.m_Client == nullptr)
+	{
+		return;
+	}
+	cDataPtrs Data;
+	a_Slot.m_Client->GetOutgoingBuffers(Data);
+	AppendOutgoing(a_Slot, Data);
+}
+
+
+
+
+
+void cSocketThreads::cSocketThread::AppendOutgoing(sSlot & a_Slot, const cDataPtrs & a_Data)
+{
+	for (cDataPtrs::const_iterator itr = a_Data.begin(), end = a_Data.end(); itr != end; ++itr)
+	{
+		if (!(*itr)->empty())
+		{
+			a_Slot.m_Outgoing.push_back(*itr);
+		}
+	}
+}
+
+
+
+
+
 void cSocketThreads::cSocketThread::CleanUpShutSockets(void)
 {
 	cCSLock Lock(m_Parent->m_CS);
-	for (int i = m_NumSlots - 1; i >= 0; i--)
+	for (size_t i = m_Slots.size(); i-- > 0;)
 	{
 		switch (m_Slots[i].m_State)
 		{
@@ -654,7 +951,7 @@ void cSocketThreads::cSocketThread::CleanUpShutSockets(void)
 			{
 				// The socket has reached the shutdown timeout, close it and clear its slot:
 				m_Slots[i].m_Socket.CloseSocket();
-				m_Slots[i] = m_Slots[--m_NumSlots];
+				RemoveSlot(i);
 				break;
 			}
 			case sSlot::ssShuttingDown:
@@ -674,29 +971,20 @@ void cSocketThreads::cSocketThread::CleanUpShutSockets(void)
 void cSocketThreads::cSocketThread::QueueOutgoingData(void)
 {
 	cCSLock Lock(m_Parent->m_CS);
-	for (int i = 0; i < m_NumSlots; i++)
+	for (cSlots::iterator itr = m_Slots.begin(), end = m_Slots.end(); itr != end; ++itr)
 	{
-		if (m_Slots[i].m_Client != nullptr)
-		{
-			AString Data;
-			m_Slots[i].m_Client->GetOutgoingData(Data);
-			m_Slots[i].m_Outgoing.append(Data);
-		}
-		if (m_Slots[i].m_Outgoing.empty())
+		QueryOutgoingData(*itr);
+		if (itr->m_Outgoing.empty())
 		{
 			// No outgoing data is ready
-			if (m_Slots[i].m_State == sSlot::ssWritingRestOut)
+			if (itr->m_State == sSlot::ssWritingRestOut)
 			{
 				// The socket doesn't want to be kept alive anymore, and doesn't have any remaining data to send.
 				// Shut it down and then close it after a timeout, or when the other side agrees
-				m_Slots[i].m_State = sSlot::ssShuttingDown;
-				m_Slots[i].m_Socket.ShutdownReadWrite();
+				itr->m_State = sSlot::ssShuttingDown;
+				itr->m_Socket.ShutdownReadWrite();
 			}
 			continue;
 		}
 	}
 }
-
-
-
-
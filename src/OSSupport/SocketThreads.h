@@ -14,14 +14,24 @@ queue is empty, then shutdown is called on it and finally the socket is closed a
 If at any time within this the remote end closes the socket, then the socket is closed directly.
 As soon as the socket is closed, the slot is finally removed from the SocketThread.
 The graph in $/docs/SocketThreads States.gv shows the state-machine transitions of the slot.
+
+On Linux, the threads use an edge-triggered epoll instead of select(). There is no limit on the number of
+slots per thread, so a single thread handles all the clients. Wakeups are done through an eventfd instead of
+the control socket pair. Since the sockets are edge-triggered, each readable socket is read until it would block,
+and each slot remembers whether its socket is writable; the outgoing data is queued in the slot and only sent
+while the socket is writable, the rest waits for the next EPOLLOUT.
 */
 
 
 
 
 
-/** How many clients should one thread handle? (must be less than FD_SETSIZE for your platform) */
-#define MAX_SLOTS 63
+#if defined(__linux__)
+	#define SOCKETTHREADS_USE_EPOLL
+#else
+	/** How many clients should one thread handle? (must be less than FD_SETSIZE for your platform) */
+	#define MAX_SLOTS 63
+#endif
 
 
 
@@ -32,12 +42,19 @@ The graph in $/docs/SocketThreads States.gv shows the state-machine transitions
 #include "Socket.h"
 #include "IsThread.h"
 
+#ifdef SOCKETTHREADS_USE_EPOLL
+	#include <sys/epoll.h>
+	#include <unordered_map>
+#endif
+
 
 
 
-// Check MAX_SLOTS:
-#if MAX_SLOTS >= FD_SETSIZE
-	#error "MAX_SLOTS must be less than FD_SETSIZE for your platform! (otherwise select() won't work)"
+#ifndef SOCKETTHREADS_USE_EPOLL
+	// Check MAX_SLOTS:
+	#if MAX_SLOTS >= FD_SETSIZE
+		#error "MAX_SLOTS must be less than FD_SETSIZE for your platform! (otherwise select() won't work)"
+	#endif
 #endif
 
 
@@ -56,6 +73,11 @@ class cSocketThreads
 {
 public:
 
+	/** A refcounted piece of outgoing data. The data is never modified once queued, so a single buffer
+	can be queued to any number of sockets without copying it. */
+	typedef std::shared_ptr<const AString> cDataPtr;
+	typedef std::vector<cDataPtr> cDataPtrs;
+
 	// Clients of cSocketThreads must implement this interface to be able to communicate
 	class cCallback
 	{
@@ -72,6 +94,19 @@ public:
 		The function is supposed to *set* outgoing data to a_Data (overwrite) */
 		virtual void GetOutgoingData(AString & a_Data) = 0;
 		
+		/** Called when data can be sent to remote party
+		The function is supposed to *append* the outgoing data buffers to a_Data; these are sent without copying.
+		The default implementation queries GetOutgoingData() and wraps its output into a single buffer. */
+		virtual void GetOutgoingBuffers(cDataPtrs & a_Data)
+		{
+			AString Data;
+			GetOutgoingData(Data);
+			if (!Data.empty())
+			{
+				a_Data.push_back(std::make_shared<const AString>(std::move(Data)));
+			}
+		}
+		
 		/** Called when the socket has been closed for any reason */
 		virtual void SocketClosed(void) = 0;
 	} ;
@@ -108,8 +143,12 @@ private:
 		virtual ~cSocketThread();
 		
 		// All these methods assume parent's m_CS is locked
-		bool HasEmptySlot(void) const {return m_NumSlots < MAX_SLOTS; }
-		bool IsEmpty     (void) const {return m_NumSlots == 0; }
+		#ifdef SOCKETTHREADS_USE_EPOLL
+		bool HasEmptySlot(void) const {return true; }
+		#else
+		bool HasEmptySlot(void) const {return m_Slots.size() < MAX_SLOTS; }
+		#endif
+		bool IsEmpty     (void) const {return m_Slots.empty(); }
 
 		void AddClient   (const cSocket &   a_Socket, cCallback * a_Client);  // Takes ownership of the socket
 		bool RemoveClient(const cCallback * a_Client);  // Returns true if removed, false if not found
@@ -120,15 +159,27 @@ private:
 		
 		bool Start(void);  // Hide the cIsThread's Start method, we need to provide our own startup to create the control socket
 		
+		#ifdef SOCKETTHREADS_USE_EPOLL
+		bool IsValid(void) const {return (m_EventFD >= 0); }  // If the eventfd dies, the thread is not valid anymore
+		#else
 		bool IsValid(void) const {return m_ControlSocket2.IsValid(); }  // If the Control socket dies, the thread is not valid anymore
+		#endif
 		
 	private:
 	
 		cSocketThreads * m_Parent;
 	
+		#ifdef SOCKETTHREADS_USE_EPOLL
+		/** The epoll instance watching all the sockets and the eventfd */
+		int m_EpollFD;
+		
+		/** The eventfd used for waking up the thread from epoll_wait(); registered in the epoll with the ID 0 */
+		int m_EventFD;
+		#else
 		// Two ends of the control socket, the first is select()-ed, the second is written to for notifications
 		cSocket m_ControlSocket1;
 		cSocket m_ControlSocket2;
+		#endif
 		
 		// Socket-client-dataqueues-state quadruplets.
 		// Manipulation with these assumes that the parent's m_CS is locked
@@ -140,9 +191,13 @@ private:
 			/** The callback to call for events. May be nullptr */
 			cCallback * m_Client;
 			
-			/** If sending writes only partial data, the rest is stored here for another send.
+			/** The outgoing data buffers, sent in a single scatter-gather call. If sending writes only partial data,
+			the rest is kept here for another send.
 			Also used when the slot is being removed to store the last batch of outgoing data. */
-			AString m_Outgoing;
+			std::deque<cDataPtr> m_Outgoing;
+			
+			/** Number of bytes of the first m_Outgoing buffer that have already been sent */
+			size_t m_OutgoingOffset;
 			
 			enum eState
 			{
@@ -152,13 +207,52 @@ private:
 				ssShuttingDown2,   ///< The shutdown has been done at least 1 thread loop ago (timeout detection)
 				ssRemoteClosed,    ///< The remote end has closed the connection (and we still have a client callback)
 			} m_State;
+			
+			#ifdef SOCKETTHREADS_USE_EPOLL
+			/** The ID under which the socket is registered in the epoll. Unique within the thread, never reused,
+			so that events queued for an already removed slot cannot be mistaken for another slot's events. */
+			UInt64 m_ID;
+			
+			/** True if the socket can take more outgoing data; cleared when send() would block, set on EPOLLOUT */
+			bool m_IsWritable;
+			#endif
 		} ;
 		
-		sSlot m_Slots[MAX_SLOTS];
-		int   m_NumSlots;  // Number of slots actually used
+		typedef std::vector<sSlot> cSlots;
+		
+		cSlots m_Slots;
+		
+		#ifdef SOCKETTHREADS_USE_EPOLL
+		/** Maps the epoll IDs of the slots to their index in m_Slots */
+		std::unordered_map<UInt64, size_t> m_SlotIndices;
+		
+		/** The ID that was assigned to the last added slot */
+		UInt64 m_LastSlotID;
+		#endif
 		
 		virtual void Execute(void) override;
 		
+		/** Wakes up the thread, so that it re-queries the outgoing data and the slot states */
+		void Notify(void);
+		
+		/** Removes the slot at the specified index, replacing it with the last slot */
+		void RemoveSlot(size_t a_Idx);
+		
+		/** Receives a single batch of data from the slot's socket and passes it to the client.
+		If the remote end has closed the socket, the slot is removed.
+		Returns true if some data was received, false if there's no more data or the slot has been removed. */
+		bool ReadFromSlot(size_t a_Idx);
+		
+		/** Sends the slot's queued outgoing data. If the socket fails, it is closed and the client notified. */
+		void WriteToSlot(size_t a_Idx);
+		
+		#ifdef SOCKETTHREADS_USE_EPOLL
+		/** Processes the events returned by epoll_wait() */
+		void ProcessEvents(const epoll_event * a_Events, int a_NumEvents);
+		
+		/** Writes to all the sockets that are writable and have outgoing data queued */
+		void WriteToSockets(void);
+		#else
 		/** Prepares the Read and Write socket sets for select()
 		Puts all sockets into the read set, along with m_ControlSocket1.
 		Only sockets that have outgoing data queued on them are put in the write set.*/
@@ -169,11 +263,18 @@ private:
 		
 		/** Writes to sockets indicated in a_Write */
 		void WriteToSockets (fd_set * a_Write);
+		#endif
 		
-		/** Sends data through the specified socket, trying to fill the OS send buffer in chunks.
+		/** Sends the slot's outgoing data through its socket, gathering the queued buffers into as few send calls as possible.
 		Returns true if there was no error while sending, false if an error has occured.
-		Modifies a_Data to contain only the unsent data. */
-		bool SendDataThroughSocket(cSocket & a_Socket, AString & a_Data);
+		Removes the sent data from the slot's outgoing queue. */
+		bool SendDataThroughSocket(sSlot & a_Slot);
+		
+		/** Queries the slot's client for its outgoing data and appends it to the slot's outgoing queue */
+		void QueryOutgoingData(sSlot & a_Slot);
+		
+		/** Appends the buffers to the slot's outgoing queue, skipping the empty ones */
+		static void AppendOutgoing(sSlot & a_Slot, const cDataPtrs & a_Data);
 
 		/** Removes those slots in ssShuttingDown2 state, sets those with ssShuttingDown state to ssShuttingDown2 */
 		void CleanUpShutSockets(void);
@@ -0,0 +1,356 @@
+
+// Pregenerator.cpp
+
+// Implements the cPregenerator class representing the thread that pregenerates an area of a world
+
+#include "Globals.h"
+#include "Pregenerator.h"
+#include "World.h"
+#include "ChunkMap.h"
+#include "LightingThread.h"
+#include "Generating/ChunkGenerator.h"
+#include "WorldStorage/WorldStorage.h"
+
+
+
+
+
+/** The minimum number of chunks kept in flight, regardless of the number of threads. */
+static const int MIN_CHUNKS_IN_FLIGHT = 64;
+
+/** The number of chunks kept in flight for each generator and lighting thread. */
+static const int CHUNKS_IN_FLIGHT_PER_THREAD = 16;
+
+/** No more chunks are queued while the storage has more than this many chunks waiting to be saved.
+Keeps the memory bounded when the disk is slower than the generator. */
+static const size_t MAX_SAVE_QUEUE_LENGTH = 2 * cChunkMap::LAYER_SIZE * cChunkMap::LAYER_SIZE;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cTaskSaveLayer:
+
+/** Queues all the dirty chunks in a single cChunkMap layer for saving. Runs in the tick thread. */
+class cTaskSaveLayer :
+	public cWorld::cTask
+{
+public:
+	cTaskSaveLayer(int a_LayerX, int a_LayerZ) :
+		m_LayerX(a_LayerX),
+		m_LayerZ(a_LayerZ)
+	{
+	}
+
+protected:
+	int m_LayerX;
+	int m_LayerZ;
+
+	// cWorld::cTask overrides:
+	virtual void Run(cWorld & a_World) override
+	{
+		a_World.GetChunkMap()->SaveLayer(m_LayerX, m_LayerZ);
+	}
+} ;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cTaskUnloadLayer:
+
+/** Unloads the unused chunks in a single cChunkMap layer. Runs in the tick thread. */
+class cTaskUnloadLayer :
+	public cWorld::cTask
+{
+public:
+	cTaskUnloadLayer(int a_LayerX, int a_LayerZ) :
+		m_LayerX(a_LayerX),
+		m_LayerZ(a_LayerZ)
+	{
+	}
+
+protected:
+	int m_LayerX;
+	int m_LayerZ;
+
+	// cWorld::cTask overrides:
+	virtual void Run(cWorld & a_World) override
+	{
+		a_World.GetChunkMap()->UnloadUnusedLayerChunks(m_LayerX, m_LayerZ);
+	}
+} ;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cPregenerator:
+
+cPregenerator::cPregenerator(cWorld & a_World, int a_CenterChunkX, int a_CenterChunkZ, int a_Radius) :
+	super(Printf("Pregenerator %s", a_World.GetName().c_str())),
+	m_World(a_World),
+	m_CenterChunkX(a_CenterChunkX),
+	m_CenterChunkZ(a_CenterChunkZ),
+	m_Radius(std::max(a_Radius, 0)),
+	m_QueueRegionIdx(0),
+	m_QueueChunkIdx(0),
+	m_FinishRegionIdx(0),
+	m_MaxInFlight(MIN_CHUNKS_IN_FLIGHT),
+	m_NumInFlight(0),
+	m_NumTotal(0),
+	m_NumPrepared(0),
+	m_StartTime(std::chrono::steady_clock::now()),
+	m_LastReportTime(m_StartTime),
+	m_LastReportChunkCount(0)
+{
+	InitRegions();
+}
+
+
+
+
+
+cPregenerator::~cPregenerator()
+{
+	Stop();
+}
+
+
+
+
+
+AString cPregenerator::GetStatus(void)
+{
+	int NumPrepared = m_NumPrepared;
+	auto Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_StartTime).count();
+	return Printf("chunk [%d, %d], radius %d: %.02f%% (%d/%d; %.02f chunks/s on average)",
+		m_CenterChunkX, m_CenterChunkZ, m_Radius,
+		static_cast<float>(NumPrepared) * 100 / m_NumTotal, NumPrepared, m_NumTotal,
+		(Elapsed > 0) ? static_cast<float>(NumPrepared) * 1000 / Elapsed : 0.0f
+	);
+}
+
+
+
+
+
+void cPregenerator::Execute(void)
+{
+	// Size the window so that all the generator and lighting threads have enough work queued:
+	int NumThreads = static_cast<int>(m_World.GetGenerator().GetNumThreads() + m_World.GetLightingThread().GetNumThreads());
+	m_MaxInFlight = std::max(MIN_CHUNKS_IN_FLIGHT, NumThreads * CHUNKS_IN_FLIGHT_PER_THREAD);
+
+	LOG("Pregenerating world %s: %d chunks in " SIZE_T_FMT " regions around chunk [%d, %d], %d chunks in flight",
+		m_World.GetName().c_str(), m_NumTotal, m_Regions.size(), m_CenterChunkX, m_CenterChunkZ, m_MaxInFlight
+	);
+	if (!m_Regions.empty())
+	{
+		InitRegionChunks(m_Regions[0]);
+	}
+
+	// Keep the window full until all the chunks are queued; when terminating, only wait for the chunks already queued:
+	for (;;)
+	{
+		if (!m_ShouldTerminate)
+		{
+			QueueChunks();
+		}
+		if (m_NumInFlight == 0)
+		{
+			break;
+		}
+		m_EvtPrepared.Wait(1000);
+		ProcessPrepared();
+		ReportProgress();
+	}
+
+	// Save the chunks generated around the area's edges, too:
+	m_World.QueueSaveAllChunks();
+
+	auto Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_StartTime).count();
+	int NumPrepared = m_NumPrepared;
+	LOG("Pregeneration of world %s %s: %d/%d chunks in %.02f s (%.02f chunks/s)",
+		m_World.GetName().c_str(), IsFinished() ? "finished" : "stopped", NumPrepared, m_NumTotal,
+		static_cast<float>(Elapsed) / 1000, (Elapsed > 0) ? static_cast<float>(NumPrepared) * 1000 / Elapsed : 0.0f
+	);
+}
+
+
+
+
+
+void cPregenerator::Call(int a_ChunkX, int a_ChunkZ)
+{
+	// Called from the lighting thread, or from our own thread if the chunk was already prepared.
+	// Only hand the chunk over, the accounting is done in our thread:
+	{
+		cCSLock Lock(m_CS);
+		m_Prepared.emplace_back(a_ChunkX, a_ChunkZ);
+	}
+	m_EvtPrepared.Set();
+}
+
+
+
+
+
+void cPregenerator::InitRegions(void)
+{
+	const int MinChunkX = m_CenterChunkX - m_Radius;
+	const int MaxChunkX = m_CenterChunkX + m_Radius;
+	const int MinChunkZ = m_CenterChunkZ - m_Radius;
+	const int MaxChunkZ = m_CenterChunkZ + m_Radius;
+	const int MinLayerX = FAST_FLOOR_DIV(MinChunkX, cChunkMap::LAYER_SIZE);
+	const int MaxLayerX = FAST_FLOOR_DIV(MaxChunkX, cChunkMap::LAYER_SIZE);
+	const int MinLayerZ = FAST_FLOOR_DIV(MinChunkZ, cChunkMap::LAYER_SIZE);
+	const int MaxLayerZ = FAST_FLOOR_DIV(MaxChunkZ, cChunkMap::LAYER_SIZE);
+
+	// A zigzag pattern from the top to bottom, each row alternating between forward-x and backward-x:
+	m_NumTotal = 0;
+	for (int LayerZ = MinLayerZ; LayerZ <= MaxLayerZ; LayerZ++)
+	{
+		int SizeZ = std::min(MaxChunkZ, (LayerZ + 1) * cChunkMap::LAYER_SIZE - 1) - std::max(MinChunkZ, LayerZ * cChunkMap::LAYER_SIZE) + 1;
+		bool IsReversed = (((LayerZ - MinLayerZ) & 1) != 0);
+		for (int i = MinLayerX; i <= MaxLayerX; i++)
+		{
+			int LayerX = IsReversed ? (MaxLayerX + MinLayerX - i) : i;
+			int SizeX = std::min(MaxChunkX, (LayerX + 1) * cChunkMap::LAYER_SIZE - 1) - std::max(MinChunkX, LayerX * cChunkMap::LAYER_SIZE) + 1;
+			m_Regions.emplace_back(LayerX, LayerZ, SizeX * SizeZ);
+			m_NumTotal += SizeX * SizeZ;
+		}  // for i
+	}  // for LayerZ
+}
+
+
+
+
+
+void cPregenerator::InitRegionChunks(const sRegion & a_Region)
+{
+	const int MinChunkX = std::max(m_CenterChunkX - m_Radius, a_Region.m_LayerX * cChunkMap::LAYER_SIZE);
+	const int MaxChunkX = std::min(m_CenterChunkX + m_Radius, (a_Region.m_LayerX + 1) * cChunkMap::LAYER_SIZE - 1);
+	const int MinChunkZ = std::max(m_CenterChunkZ - m_Radius, a_Region.m_LayerZ * cChunkMap::LAYER_SIZE);
+	const int MaxChunkZ = std::min(m_CenterChunkZ + m_Radius, (a_Region.m_LayerZ + 1) * cChunkMap::LAYER_SIZE - 1);
+
+	// The same zigzag pattern as the regions, so that the consecutive chunks are neighbors:
+	m_RegionChunks.clear();
+	m_QueueChunkIdx = 0;
+	for (int ChunkZ = MinChunkZ; ChunkZ <= MaxChunkZ; ChunkZ++)
+	{
+		bool IsReversed = (((ChunkZ - MinChunkZ) & 1) != 0);
+		for (int i = MinChunkX; i <= MaxChunkX; i++)
+		{
+			m_RegionChunks.emplace_back(IsReversed ? (MaxChunkX + MinChunkX - i) : i, ChunkZ);
+		}  // for i
+	}  // for ChunkZ
+}
+
+
+
+
+
+void cPregenerator::QueueChunks(void)
+{
+	while ((m_NumInFlight < m_MaxInFlight) && (m_QueueRegionIdx < m_Regions.size()))
+	{
+		// Move on to the next region once all the chunks in the current one are queued:
+		if (m_QueueChunkIdx >= m_RegionChunks.size())
+		{
+			m_QueueRegionIdx += 1;
+			if (m_QueueRegionIdx < m_Regions.size())
+			{
+				InitRegionChunks(m_Regions[m_QueueRegionIdx]);
+			}
+			continue;
+		}
+
+		// Let the storage catch up, if needed:
+		if (m_World.GetStorage().GetSaveQueueLength() > MAX_SAVE_QUEUE_LENGTH)
+		{
+			return;
+		}
+
+		const cChunkCoords & Coords = m_RegionChunks[m_QueueChunkIdx];
+		m_QueueChunkIdx += 1;
+		m_NumInFlight += 1;
+		m_World.PrepareChunk(Coords.m_ChunkX, Coords.m_ChunkZ, this);
+	}
+}
+
+
+
+
+
+void cPregenerator::ProcessPrepared(void)
+{
+	cChunkCoordsVector Prepared;
+	{
+		cCSLock Lock(m_CS);
+		std::swap(Prepared, m_Prepared);
+	}
+	if (Prepared.empty())
+	{
+		return;
+	}
+
+	// Account each chunk to its region; only the regions between the first unfinished one and the queued one can have chunks in flight:
+	size_t LastRegionIdx = std::min(m_QueueRegionIdx, m_Regions.size() - 1);
+	for (const auto & Coords : Prepared)
+	{
+		int LayerX = FAST_FLOOR_DIV(Coords.m_ChunkX, cChunkMap::LAYER_SIZE);
+		int LayerZ = FAST_FLOOR_DIV(Coords.m_ChunkZ, cChunkMap::LAYER_SIZE);
+		for (size_t i = m_FinishRegionIdx; i <= LastRegionIdx; i++)
+		{
+			if ((m_Regions[i].m_LayerX == LayerX) && (m_Regions[i].m_LayerZ == LayerZ))
+			{
+				m_Regions[i].m_NumRemaining -= 1;
+				break;
+			}
+		}  // for i - m_Regions[]
+	}  // for Coords - Prepared[]
+	m_NumInFlight -= static_cast<int>(Prepared.size());
+	m_NumPrepared += static_cast<int>(Prepared.size());
+
+	// Save the regions that have finished, in order. Unload the region that finished before, its saving has had time to complete:
+	while ((m_FinishRegionIdx < m_Regions.size()) && (m_Regions[m_FinishRegionIdx].m_NumRemaining <= 0))
+	{
+		const sRegion & Region = m_Regions[m_FinishRegionIdx];
+		m_World.QueueTask(make_unique<cTaskSaveLayer>(Region.m_LayerX, Region.m_LayerZ));
+		if (m_FinishRegionIdx > 0)
+		{
+			const sRegion & PrevRegion = m_Regions[m_FinishRegionIdx - 1];
+			m_World.QueueTask(make_unique<cTaskUnloadLayer>(PrevRegion.m_LayerX, PrevRegion.m_LayerZ));
+		}
+		m_FinishRegionIdx += 1;
+	}
+}
+
+
+
+
+
+void cPregenerator::ReportProgress(void)
+{
+	// Report progress every 5 seconds:
+	auto Now = std::chrono::steady_clock::now();
+	if (Now - m_LastReportTime < std::chrono::seconds(5))
+	{
+		return;
+	}
+	int NumPrepared = m_NumPrepared;
+	float PercentDone = static_cast<float>(NumPrepared) * 100 / m_NumTotal;
+	float ChunkSpeed = static_cast<float>((NumPrepared - m_LastReportChunkCount) * 1000) / std::chrono::duration_cast<std::chrono::milliseconds>(Now - m_LastReportTime).count();
+	LOG("Pregenerating world %s: %.02f%% (%d/%d; %.02f chunks/s; region " SIZE_T_FMT "/" SIZE_T_FMT ")",
+		m_World.GetName().c_str(), PercentDone, NumPrepared, m_NumTotal, ChunkSpeed, m_FinishRegionIdx, m_Regions.size()
+	);
+	m_LastReportTime = Now;
+	m_LastReportChunkCount = NumPrepared;
+}
+
+
+
+
@@ -0,0 +1,154 @@
+
+// Pregenerator.h
+
+// Interfaces to the cPregenerator class representing the thread that pregenerates an area of a world
+
+/*
+The area is a square of chunks around a center chunk. It is processed in regions aligned to the cChunkMap
+layers (cChunkMap::LAYER_SIZE chunks across); the regions are visited in a zigzag pattern, and so are the
+chunks inside each region, so that the chunks being worked on are always close to each other.
+The chunks are queued using cWorld::PrepareChunk(), which loads or generates them and lights them, without
+any client or ChunkStay bookkeeping. A window of chunks is kept in flight, large enough to keep all the
+generator and lighting threads busy.
+Once all the chunks of a region are prepared, the region's layer is queued for saving; the region that
+finished before it is then unloaded, so that the memory used stays bounded no matter the size of the area.
+The progress, including the throughput in chunks per second, is logged periodically.
+*/
+
+
+
+
+
+#pragma once
+
+#include "OSSupport/IsThread.h"
+#include "ChunkDef.h"
+
+
+
+
+
+// fwd:
+class cWorld;
+
+
+
+
+
+class cPregenerator :
+	public cIsThread,
+	public cChunkCoordCallback
+{
+	typedef cIsThread super;
+
+public:
+	/** Creates a new pregenerator for the square of chunks of the specified radius around the specified center chunk.
+	The thread is not started yet, call Start() to start pregenerating. */
+	cPregenerator(cWorld & a_World, int a_CenterChunkX, int a_CenterChunkZ, int a_Radius);
+
+	virtual ~cPregenerator();
+
+	/** Returns true if all the chunks in the area have been prepared. */
+	bool IsFinished(void) const { return (m_NumPrepared >= m_NumTotal); }
+
+	/** Returns a single-line description of the progress, used by the console commands. */
+	AString GetStatus(void);
+
+protected:
+	/** A single region of the area, covering (part of) one cChunkMap layer. */
+	struct sRegion
+	{
+		int m_LayerX;
+		int m_LayerZ;
+
+		/** Number of the region's chunks not yet prepared. */
+		int m_NumRemaining;
+
+		sRegion(int a_LayerX, int a_LayerZ, int a_NumRemaining) :
+			m_LayerX(a_LayerX),
+			m_LayerZ(a_LayerZ),
+			m_NumRemaining(a_NumRemaining)
+		{
+		}
+	} ;
+
+	typedef std::vector<sRegion> cRegions;
+
+
+	cWorld & m_World;
+	int m_CenterChunkX;
+	int m_CenterChunkZ;
+	int m_Radius;
+
+	/** All the regions of the area, in the order in which they are processed. */
+	cRegions m_Regions;
+
+	/** The chunks of the region currently being queued, in the order in which they are queued. */
+	cChunkCoordsVector m_RegionChunks;
+
+	/** Index into m_Regions of the region currently being queued. */
+	size_t m_QueueRegionIdx;
+
+	/** Index into m_RegionChunks of the next chunk to be queued. */
+	size_t m_QueueChunkIdx;
+
+	/** Index into m_Regions of the first region that hasn't finished yet.
+	All the regions before it have been queued for saving. */
+	size_t m_FinishRegionIdx;
+
+	/** Maximum number of chunks queued at the same time. */
+	int m_MaxInFlight;
+
+	/** Number of chunks queued and not prepared yet. */
+	int m_NumInFlight;
+
+	/** Total number of chunks in the area. */
+	int m_NumTotal;
+
+	/** Number of chunks already prepared. Read by other threads for the status reports. */
+	std::atomic<int> m_NumPrepared;
+
+	/** Protects m_Prepared. */
+	cCriticalSection m_CS;
+
+	/** The chunks that have been prepared but not yet processed by the thread. Protected by m_CS. */
+	cChunkCoordsVector m_Prepared;
+
+	/** Set whenever a chunk is prepared. */
+	cEvent m_EvtPrepared;
+
+	/** The time when the pregeneration started. */
+	std::chrono::steady_clock::time_point m_StartTime;
+
+	/** The timestamp of the last progress report emitted. */
+	std::chrono::steady_clock::time_point m_LastReportTime;
+
+	/** Number of chunks prepared when the last progress report was emitted. */
+	int m_LastReportChunkCount;
+
+
+	// cIsThread override:
+	virtual void Execute(void) override;
+
+	// cChunkCoordCallback override:
+	virtual void Call(int a_ChunkX, int a_ChunkZ) override;
+
+	/** Fills m_Regions with all the regions of the area, in the zigzag order, and counts their chunks. */
+	void InitRegions(void);
+
+	/** Fills m_RegionChunks with the chunks of the area inside the specified region, in the zigzag order. */
+	void InitRegionChunks(const sRegion & a_Region);
+
+	/** Queues more chunks, until the window is full or there are no more chunks in the area. */
+	void QueueChunks(void);
+
+	/** Accounts for the chunks prepared since the last call, saves and unloads the regions that have finished. */
+	void ProcessPrepared(void);
+
+	/** Logs the progress, if enough time has passed since the last report. */
+	void ReportProgress(void);
+} ;
+
+
+
+
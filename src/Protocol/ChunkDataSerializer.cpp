@@ -10,6 +10,7 @@
 #include "zlib/zlib.h"
 #include "ByteBuffer.h"
 #include "Protocol18x.h"
+#include "../StringCompression.h"
 
 
 
@@ -19,13 +20,17 @@ cChunkDataSerializer::cChunkDataSerializer(
 	const cChunkDef::BlockNibbles & a_BlockMetas,
 	const cChunkDef::BlockNibbles & a_BlockLight,
 	const cChunkDef::BlockNibbles & a_BlockSkyLight,
-	const unsigned char *           a_BiomeData
+	const unsigned char *           a_BiomeData,
+	cChunkDataCache *               a_Cache,
+	UInt64                          a_DataVersion
 ) :
 	m_BlockTypes(a_BlockTypes),
 	m_BlockMetas(a_BlockMetas),
 	m_BlockLight(a_BlockLight),
 	m_BlockSkyLight(a_BlockSkyLight),
-	m_BiomeData(a_BiomeData)
+	m_BiomeData(a_BiomeData),
+	m_Cache(a_Cache),
+	m_DataVersion(a_DataVersion)
 {
 }
 
@@ -40,7 +45,14 @@ const AString & cChunkDataSerializer::Serialize(int a_Version, int a_ChunkX, int
 		return itr->second;
 	}
 	
+	// Try the world-wide cache:
 	AString data;
+	if ((m_Cache != nullptr) && m_Cache->Get(a_ChunkX, a_ChunkZ, m_DataVersion, a_Version, data))
+	{
+		m_Serializations[a_Version] = data;
+		return m_Serializations[a_Version];
+	}
+	
 	switch (a_Version)
 	{
 		case RELEASE_1_2_5: Serialize29(data); break;
@@ -58,6 +70,10 @@ const AString & cChunkDataSerializer::Serialize(int a_Version, int a_ChunkX, int
 	if (!data.empty())
 	{
 		m_Serializations[a_Version] = data;
+		if (m_Cache != nullptr)
+		{
+			m_Cache->Set(a_ChunkX, a_ChunkZ, m_DataVersion, a_Version, data);
+		}
 	}
 	return m_Serializations[a_Version];
 }
@@ -92,12 +108,12 @@ void cChunkDataSerializer::Serialize29(AString & a_Data)
 	const uLongf CompressedMaxSize = DataSize + (DataSize >> 12) + (DataSize >> 14) + (DataSize >> 25) + 16;
 	char CompressedBlockData[CompressedMaxSize];
 
-	uLongf CompressedSize = compressBound(DataSize);
+	size_t CompressedSize = compressBound(DataSize);
 	
 	// Run-time check that our compile-time guess about CompressedMaxSize was enough:
 	ASSERT(CompressedSize <= CompressedMaxSize);
 	
-	compress2((Bytef*)CompressedBlockData, &CompressedSize, (const Bytef*)AllData, sizeof(AllData), Z_DEFAULT_COMPRESSION);
+	CompressBuffer(AllData, sizeof(AllData), CompressedBlockData, CompressedSize, Z_DEFAULT_COMPRESSION);
 
 	// Now put all those data into a_Data:
 	
@@ -150,12 +166,12 @@ void cChunkDataSerializer::Serialize39(AString & a_Data)
 	const uLongf CompressedMaxSize = DataSize + (DataSize >> 12) + (DataSize >> 14) + (DataSize >> 25) + 16;
 	char CompressedBlockData[CompressedMaxSize];
 
-	uLongf CompressedSize = compressBound(DataSize);
+	size_t CompressedSize = compressBound(DataSize);
 	
 	// Run-time check that our compile-time guess about CompressedMaxSize was enough:
 	ASSERT(CompressedSize <= CompressedMaxSize);
 	
-	compress2((Bytef*)CompressedBlockData, &CompressedSize, (const Bytef*)AllData, sizeof(AllData), Z_DEFAULT_COMPRESSION);
+	CompressBuffer(AllData, sizeof(AllData), CompressedBlockData, CompressedSize, Z_DEFAULT_COMPRESSION);
 
 	// Now put all those data into a_Data:
 	
@@ -249,3 +265,130 @@ void cChunkDataSerializer::Serialize47(AString & a_Data, int a_ChunkX, int a_Chu
 
 
 
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkDataCache:
+
+cChunkDataCache::cChunkDataCache(size_t a_MaxNumChunks) :
+	m_MaxNumChunks(a_MaxNumChunks),
+	m_NumHits(0),
+	m_NumMisses(0)
+{
+}
+
+
+
+
+
+bool cChunkDataCache::Get(int a_ChunkX, int a_ChunkZ, UInt64 a_DataVersion, int a_ProtocolVersion, AString & a_Data)
+{
+	cCSLock Lock(m_CS);
+	cEntryMap::iterator itr = m_EntryMap.find(cChunkCoords(a_ChunkX, a_ChunkZ));
+	if ((itr == m_EntryMap.end()) || (itr->second->m_DataVersion != a_DataVersion))
+	{
+		m_NumMisses += 1;
+		return false;
+	}
+	Serializations::const_iterator itrS = itr->second->m_Serializations.find(a_ProtocolVersion);
+	if (itrS == itr->second->m_Serializations.end())
+	{
+		m_NumMisses += 1;
+		return false;
+	}
+	a_Data = itrS->second;
+	m_NumHits += 1;
+
+	// Move the entry to the front, as the most recently used:
+	m_Entries.splice(m_Entries.begin(), m_Entries, itr->second);
+	return true;
+}
+
+
+
+
+
+void cChunkDataCache::Set(int a_ChunkX, int a_ChunkZ, UInt64 a_DataVersion, int a_ProtocolVersion, const AString & a_Data)
+{
+	cCSLock Lock(m_CS);
+	if (m_MaxNumChunks == 0)
+	{
+		return;
+	}
+	cChunkCoords Coords(a_ChunkX, a_ChunkZ);
+	cEntryMap::iterator itr = m_EntryMap.find(Coords);
+	if (itr == m_EntryMap.end())
+	{
+		m_Entries.push_front(sEntry(Coords, a_DataVersion));
+		itr = m_EntryMap.insert(std::make_pair(Coords, m_Entries.begin())).first;
+	}
+	else
+	{
+		m_Entries.splice(m_Entries.begin(), m_Entries, itr->second);
+		if (itr->second->m_DataVersion != a_DataVersion)
+		{
+			// The chunk has changed, the data for the other protocol versions is outdated:
+			itr->second->m_DataVersion = a_DataVersion;
+			itr->second->m_Serializations.clear();
+		}
+	}
+	itr->second->m_Serializations[a_ProtocolVersion] = a_Data;
+	Trim();
+}
+
+
+
+
+
+void cChunkDataCache::SetMaxNumChunks(size_t a_MaxNumChunks)
+{
+	cCSLock Lock(m_CS);
+	m_MaxNumChunks = a_MaxNumChunks;
+	Trim();
+}
+
+
+
+
+
+size_t cChunkDataCache::GetNumHits(void)
+{
+	cCSLock Lock(m_CS);
+	return m_NumHits;
+}
+
+
+
+
+
+size_t cChunkDataCache::GetNumMisses(void)
+{
+	cCSLock Lock(m_CS);
+	return m_NumMisses;
+}
+
+
+
+
+
+size_t cChunkDataCache::GetNumChunks(void)
+{
+	cCSLock Lock(m_CS);
+	return m_Entries.size();
+}
+
+
+
+
+
+void cChunkDataCache::Trim(void)
+{
+	while (m_Entries.size() > m_MaxNumChunks)
+	{
+		m_EntryMap.erase(m_Entries.back().m_Coords);
+		m_Entries.pop_back();
+	}
+}
+
+
+
+
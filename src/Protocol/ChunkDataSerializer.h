@@ -4,6 +4,88 @@
 // Interfaces to the cChunkDataSerializer class representing the object that can:
 //  - serialize chunk data to different protocol versions
 //  - cache such serialized data for multiple clients
+// Also declares the cChunkDataCache class that keeps the serialized data of recently sent chunks for the whole world
+
+
+
+
+
+#pragma once
+
+#include "../ChunkDef.h"
+#include <unordered_map>
+
+
+
+
+
+/** Caches the serialized data of recently sent chunks, for each protocol version separately,
+so that sending an unchanged chunk to more clients doesn't need to compress its data again.
+The serialized data is identified by the chunk's data version (cChunk::GetDataVersion()), which changes with
+every modification of the chunk data; the data of an older version is never returned.
+When the cache is full, the data of the least recently used chunk is discarded. */
+class cChunkDataCache
+{
+public:
+	cChunkDataCache(size_t a_MaxNumChunks);
+
+	/** Retrieves the serialized data for the specified chunk, its data version and protocol version.
+	Returns true and fills a_Data on a hit, returns false on a miss. */
+	bool Get(int a_ChunkX, int a_ChunkZ, UInt64 a_DataVersion, int a_ProtocolVersion, AString & a_Data);
+
+	/** Stores the serialized data for the specified chunk, its data version and protocol version.
+	Discards all the chunk's data of any other data version. */
+	void Set(int a_ChunkX, int a_ChunkZ, UInt64 a_DataVersion, int a_ProtocolVersion, const AString & a_Data);
+
+	/** Sets the maximum number of chunks whose data is kept; 0 disables the cache. */
+	void SetMaxNumChunks(size_t a_MaxNumChunks);
+
+	size_t GetNumHits(void);
+	size_t GetNumMisses(void);
+
+	/** Returns the number of chunks whose data is currently cached. */
+	size_t GetNumChunks(void);
+
+protected:
+
+	typedef std::map<int, AString> Serializations;
+
+	/** The serialized data of a single chunk, for all the protocol versions that it has been sent to. */
+	struct sEntry
+	{
+		cChunkCoords m_Coords;
+		UInt64 m_DataVersion;
+		Serializations m_Serializations;
+
+		sEntry(const cChunkCoords & a_Coords, UInt64 a_DataVersion) :
+			m_Coords(a_Coords),
+			m_DataVersion(a_DataVersion)
+		{
+		}
+	};
+
+	typedef std::list<sEntry> cEntries;
+	typedef std::unordered_map<cChunkCoords, cEntries::iterator, cChunkCoordsHash> cEntryMap;
+
+	/** Protects all the members against multithreaded access. */
+	cCriticalSection m_CS;
+
+	/** The cached chunks, the most recently used one first. */
+	cEntries m_Entries;
+
+	/** Index into m_Entries by the chunk coords. */
+	cEntryMap m_EntryMap;
+
+	/** The maximum number of chunks in m_Entries. */
+	size_t m_MaxNumChunks;
+
+	size_t m_NumHits;
+	size_t m_NumMisses;
+
+
+	/** Discards the least recently used entries until there are at most m_MaxNumChunks. */
+	void Trim(void);
+} ;
 
 
 
@@ -18,6 +100,12 @@ protected:
 	const cChunkDef::BlockNibbles & m_BlockSkyLight;
 	const unsigned char * m_BiomeData;
 	
+	/** The world-wide cache of the serialized data, or nullptr if not caching. */
+	cChunkDataCache * m_Cache;
+	
+	/** The version of the chunk data being serialized, used for m_Cache. */
+	UInt64 m_DataVersion;
+	
 	typedef std::map<int, AString> Serializations;
 	
 	Serializations m_Serializations;
@@ -39,7 +127,9 @@ public:
 		const cChunkDef::BlockNibbles & a_BlockMetas,
 		const cChunkDef::BlockNibbles & a_BlockLight,
 		const cChunkDef::BlockNibbles & a_BlockSkyLight,
-		const unsigned char *           a_BiomeData
+		const unsigned char *           a_BiomeData,
+		cChunkDataCache *               a_Cache = nullptr,
+		UInt64                          a_DataVersion = 0
 	);
 
 	const AString & Serialize(int a_Version, int a_ChunkX, int a_ChunkZ);  // Returns one of the internal m_Serializations[]
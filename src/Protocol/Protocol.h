@@ -46,6 +46,37 @@ typedef unsigned char Byte;
 class cProtocol
 {
 public:
+	/** Serializes a single packet that is being broadcast, by calling the specific Send* function of the protocol passed to it.
+	Used by SendBroadcastPacket(), so that the packet is serialized only once for all the clients using the same protocol version. */
+	class cPacketSerializer
+	{
+	public:
+		virtual ~cPacketSerializer() {}
+		
+		virtual void Serialize(cProtocol & a_Protocol) = 0;
+	} ;
+	
+	/** Adapts any callable taking a cProtocol & (such as a lambda) into a cPacketSerializer */
+	template <class SendFn>
+	class cPacketSerializerFn :
+		public cPacketSerializer
+	{
+	public:
+		cPacketSerializerFn(SendFn & a_Send) : m_Send(a_Send) {}
+		
+		virtual void Serialize(cProtocol & a_Protocol) override
+		{
+			m_Send(a_Protocol);
+		}
+		
+	protected:
+		SendFn & m_Send;
+	} ;
+	
+	/** The unencrypted packet data serialized during a single broadcast, keyed by the protocol version that serialized it */
+	typedef std::map<UInt32, std::shared_ptr<const AString> > cBroadcastCache;
+	
+	
 	cProtocol(cClientHandle * a_Client) :
 		m_Client(a_Client)
 	{
@@ -132,6 +163,16 @@ public:
 	virtual void SendWindowOpen                 (const cWindow & a_Window) = 0;
 	virtual void SendWindowProperty             (const cWindow & a_Window, short a_Property, short a_Value) = 0;
 
+	/** Sends a packet that is being broadcast to multiple clients.
+	If a_Cache already contains the packet as serialized by the same protocol version, the serialized data is sent directly,
+	otherwise the packet is serialized through a_Serializer and stored in a_Cache for the other clients.
+	The default implementation doesn't share anything and serializes the packet for each client. */
+	virtual void SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer)
+	{
+		UNUSED(a_Cache);
+		a_Serializer.Serialize(*this);
+	}
+
 	/// Returns the ServerID used for authentication through session.minecraft.net
 	virtual AString GetAuthServerID(void) = 0;
 
@@ -101,6 +101,7 @@ cProtocol172::cProtocol172(cClientHandle * a_Client, const AString & a_ServerAdd
 	m_OutPacketBuffer(64 KiB),
 	m_OutPacketLenBuffer(20),  // 20 bytes is more than enough for one VarInt
 	m_IsEncrypted(false),
+	m_CapturedPacketData(nullptr),
 	m_LastSentDimension(dimNotSet)
 {
 	// BungeeCord handling:
@@ -2314,6 +2315,47 @@ void cProtocol172::HandleVanillaPluginMessage(cByteBuffer & a_ByteBuffer, const
 
 
 
+void cProtocol172::SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer)
+{
+	cCSLock Lock(m_CSPacket);
+	if (m_State != 3)
+	{
+		// Not in game yet, don't share anything:
+		a_Serializer.Serialize(*this);
+		return;
+	}
+
+	std::shared_ptr<const AString> & Packet = a_Cache[m_Client->GetProtocolVersion()];
+	if (Packet == nullptr)
+	{
+		// This is the first client with this protocol version, serialize the packet and keep it for the others:
+		AString Data;
+		m_CapturedPacketData = &Data;
+		a_Serializer.Serialize(*this);
+		m_CapturedPacketData = nullptr;
+		Packet = std::make_shared<const AString>(std::move(Data));
+	}
+	if (Packet->empty())
+	{
+		return;
+	}
+
+	if (m_IsEncrypted)
+	{
+		// Each connection has its own cipher stream, encrypt a copy:
+		AString Data(*Packet);
+		SendPacketData(Data);
+	}
+	else
+	{
+		m_Client->SendData(Packet);
+	}
+}
+
+
+
+
+
 void cProtocol172::SendData(const char * a_Data, size_t a_Size)
 {
 	if (m_IsEncrypted)
@@ -2338,6 +2380,21 @@ void cProtocol172::SendData(const char * a_Data, size_t a_Size)
 
 
 
+void cProtocol172::SendPacketData(AString & a_Data)
+{
+	if (m_IsEncrypted)
+	{
+		// The data is not shared with anyone yet, encrypt it in place:
+		m_Encryptor.ProcessData((Byte *)&a_Data[0], (const Byte *)a_Data.data(), a_Data.size());
+	}
+	m_Client->SendData(std::make_shared<const AString>(std::move(a_Data)));
+	a_Data.clear();
+}
+
+
+
+
+
 bool cProtocol172::ReadItem(cByteBuffer & a_ByteBuffer, cItem & a_Item)
 {
 	HANDLE_PACKET_READ(a_ByteBuffer, ReadBEShort, short, ItemType);
@@ -2487,31 +2544,35 @@ void cProtocol172::StartEncryption(const Byte * a_Key)
 
 cProtocol172::cPacketizer::~cPacketizer()
 {
-	AString DataToSend;
-
-	// Send the packet length
+	// Assemble the packet length and the packet data in a single buffer:
 	UInt32 PacketLen = (UInt32)m_Out.GetUsedSpace();
-
+	AString Packet;
 	m_Protocol.m_OutPacketLenBuffer.WriteVarInt(PacketLen);
-	m_Protocol.m_OutPacketLenBuffer.ReadAll(DataToSend);
-	m_Protocol.SendData(DataToSend.data(), DataToSend.size());
+	m_Protocol.m_OutPacketLenBuffer.ReadAll(Packet);
 	m_Protocol.m_OutPacketLenBuffer.CommitRead();
-	
-	// Send the packet data:
-	m_Out.ReadAll(DataToSend);
-	m_Protocol.SendData(DataToSend.data(), DataToSend.size());
+	size_t HeaderSize = Packet.size();
+	Packet.resize(HeaderSize + PacketLen);
+	m_Out.ReadBuf(&Packet[HeaderSize], PacketLen);
 	m_Out.CommitRead();
 	
 	// Log the comm into logfile:
 	if (g_ShouldLogCommOut)
 	{
 		AString Hex;
-		ASSERT(DataToSend.size() > 0);
-		CreateHexDump(Hex, DataToSend.data() + 1, DataToSend.size() - 1, 16);
+		ASSERT(PacketLen > 0);
+		CreateHexDump(Hex, Packet.data() + HeaderSize + 1, PacketLen - 1, 16);
 		m_Protocol.m_CommLogFile.Printf("Outgoing packet: type %d (0x%x), length %u (0x%x), state %d. Payload:\n%s\n",
-			DataToSend[0], DataToSend[0], PacketLen, PacketLen, m_Protocol.m_State, Hex.c_str()
+			Packet[HeaderSize], Packet[HeaderSize], PacketLen, PacketLen, m_Protocol.m_State, Hex.c_str()
 		);
 	}
+	
+	// Send the packet, or capture it for a broadcast:
+	if (m_Protocol.m_CapturedPacketData != nullptr)
+	{
+		m_Protocol.m_CapturedPacketData->append(Packet);
+		return;
+	}
+	m_Protocol.SendPacketData(Packet);
 }
 
 
@@ -136,6 +136,8 @@ public:
 	virtual void SendWindowOpen                 (const cWindow & a_Window) override;
 	virtual void SendWindowProperty             (const cWindow & a_Window, short a_Property, short a_Value) override;
 
+	virtual void SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer) override;
+
 	virtual AString GetAuthServerID(void) override { return m_AuthServerID; }
 
 protected:
@@ -243,6 +245,10 @@ protected:
 	
 	bool m_IsEncrypted;
 	
+	/** If not nullptr, the packetizers append the finished (unencrypted) packets here instead of sending them.
+	Used by SendBroadcastPacket() to capture the serialized packet for sharing with other clients. */
+	AString * m_CapturedPacketData;
+	
 	cAesCfb128Decryptor m_Decryptor;
 	cAesCfb128Encryptor m_Encryptor;
 
@@ -301,6 +307,10 @@ protected:
 	
 	/** Sends the data to the client, encrypting them if needed. */
 	virtual void SendData(const char * a_Data, size_t a_Size) override;
+	
+	/** Sends the complete packet data to the client, encrypting it in place if needed.
+	The data is moved into a refcounted buffer that is queued without copying; a_Data is left empty. */
+	void SendPacketData(AString & a_Data);
 
 	void SendCompass(const cWorld & a_World);
 	
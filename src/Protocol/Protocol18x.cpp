@@ -101,6 +101,7 @@ cProtocol180::cProtocol180(cClientHandle * a_Client, const AString & a_ServerAdd
 	m_OutPacketBuffer(64 KiB),
 	m_OutPacketLenBuffer(20),  // 20 bytes is more than enough for one VarInt
 	m_IsEncrypted(false),
+	m_CapturedPacketData(nullptr),
 	m_LastSentDimension(dimNotSet)
 {
 	// Create the comm log file, if so requested:
@@ -1517,19 +1518,20 @@ void cProtocol180::SendWindowProperty(const cWindow & a_Window, short a_Property
 
 bool cProtocol180::CompressPacket(const AString & a_Packet, AString & a_CompressedData)
 {
-	// Compress the data:
-	char CompressedData[MAX_COMPRESSED_PACKET_LEN];
-
-	uLongf CompressedSize = compressBound(a_Packet.size());
+	size_t CompressedSize = compressBound(a_Packet.size());
 	if (CompressedSize >= MAX_COMPRESSED_PACKET_LEN)
 	{
 		ASSERT(!"Too high packet size.");
 		return false;
 	}
 
-	int Status = compress2((Bytef*)CompressedData, &CompressedSize, (const Bytef*)a_Packet.data(), a_Packet.size(), Z_DEFAULT_COMPRESSION);
+	// Compress the data directly into the output, leaving space for the lengths in front of it:
+	const size_t MaxHeaderSize = 10;  // Two VarInts, each 5 bytes at most
+	a_CompressedData.resize(MaxHeaderSize + CompressedSize);
+	int Status = CompressBuffer(a_Packet.data(), a_Packet.size(), &a_CompressedData[MaxHeaderSize], CompressedSize, Z_DEFAULT_COMPRESSION);
 	if (Status != Z_OK)
 	{
+		a_CompressedData.clear();
 		return false;
 	}
 
@@ -1544,10 +1546,11 @@ bool cProtocol180::CompressPacket(const AString & a_Packet, AString & a_Compress
 	Buffer.ReadAll(LengthData);
 	Buffer.CommitRead();
 
-	a_CompressedData.clear();
-	a_CompressedData.reserve(LengthData.size() + CompressedSize);
-	a_CompressedData.append(LengthData.data(), LengthData.size());
-	a_CompressedData.append(CompressedData, CompressedSize);
+	// Put the lengths right in front of the compressed data and drop the unused space:
+	size_t HeaderStart = MaxHeaderSize - LengthData.size();
+	memcpy(&a_CompressedData[HeaderStart], LengthData.data(), LengthData.size());
+	a_CompressedData.resize(MaxHeaderSize + CompressedSize);
+	a_CompressedData.erase(0, HeaderStart);
 	return true;
 }
 
@@ -2590,6 +2593,47 @@ void cProtocol180::HandleVanillaPluginMessage(cByteBuffer & a_ByteBuffer, const
 
 
 
+void cProtocol180::SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer)
+{
+	cCSLock Lock(m_CSPacket);
+	if (m_State != 3)
+	{
+		// Not in game yet, don't share anything:
+		a_Serializer.Serialize(*this);
+		return;
+	}
+
+	std::shared_ptr<const AString> & Packet = a_Cache[m_Client->GetProtocolVersion()];
+	if (Packet == nullptr)
+	{
+		// This is the first client with this protocol version, serialize the packet and keep it for the others:
+		AString Data;
+		m_CapturedPacketData = &Data;
+		a_Serializer.Serialize(*this);
+		m_CapturedPacketData = nullptr;
+		Packet = std::make_shared<const AString>(std::move(Data));
+	}
+	if (Packet->empty())
+	{
+		return;
+	}
+
+	if (m_IsEncrypted)
+	{
+		// Each connection has its own cipher stream, encrypt a copy:
+		AString Data(*Packet);
+		SendPacketData(Data);
+	}
+	else
+	{
+		m_Client->SendData(Packet);
+	}
+}
+
+
+
+
+
 void cProtocol180::SendData(const char * a_Data, size_t a_Size)
 {
 	if (m_IsEncrypted)
@@ -2614,6 +2658,21 @@ void cProtocol180::SendData(const char * a_Data, size_t a_Size)
 
 
 
+void cProtocol180::SendPacketData(AString & a_Data)
+{
+	if (m_IsEncrypted)
+	{
+		// The data is not shared with anyone yet, encrypt it in place:
+		m_Encryptor.ProcessData((Byte *)&a_Data[0], (const Byte *)a_Data.data(), a_Data.size());
+	}
+	m_Client->SendData(std::make_shared<const AString>(std::move(a_Data)));
+	a_Data.clear();
+}
+
+
+
+
+
 bool cProtocol180::ReadItem(cByteBuffer & a_ByteBuffer, cItem & a_Item, size_t a_KeepRemainingBytes)
 {
 	HANDLE_PACKET_READ(a_ByteBuffer, ReadBEShort, short, ItemType);
@@ -2748,43 +2807,44 @@ void cProtocol180::StartEncryption(const Byte * a_Key)
 cProtocol180::cPacketizer::~cPacketizer()
 {
 	UInt32 PacketLen = (UInt32)m_Out.GetUsedSpace();
-	AString PacketData, CompressedPacket;
-	m_Out.ReadAll(PacketData);
-	m_Out.CommitRead();
 
+	// Assemble the entire packet, including the lengths, in a single buffer:
+	AString Packet;
+	AString PacketData;
 	if ((m_Protocol.m_State == 3) && (PacketLen >= 256))
 	{
-		if (!cProtocol180::CompressPacket(PacketData, CompressedPacket))
+		m_Out.ReadAll(PacketData);
+		m_Out.CommitRead();
+		if (!cProtocol180::CompressPacket(PacketData, Packet))
 		{
 			return;
 		}
 	}
-	else if (m_Protocol.m_State == 3)
-	{
-		m_Protocol.m_OutPacketLenBuffer.WriteVarInt(PacketLen + 1);
-		m_Protocol.m_OutPacketLenBuffer.WriteVarInt(0);
-
-		AString LengthData;
-		m_Protocol.m_OutPacketLenBuffer.ReadAll(LengthData);
-		m_Protocol.SendData(LengthData.data(), LengthData.size());
-	}
 	else
 	{
-		m_Protocol.m_OutPacketLenBuffer.WriteVarInt(PacketLen);
+		if (m_Protocol.m_State == 3)
+		{
+			m_Protocol.m_OutPacketLenBuffer.WriteVarInt(PacketLen + 1);
+			m_Protocol.m_OutPacketLenBuffer.WriteVarInt(0);
+		}
+		else
+		{
+			m_Protocol.m_OutPacketLenBuffer.WriteVarInt(PacketLen);
+		}
+		m_Protocol.m_OutPacketLenBuffer.ReadAll(Packet);
+		m_Protocol.m_OutPacketLenBuffer.CommitRead();
 
-		AString LengthData;
-		m_Protocol.m_OutPacketLenBuffer.ReadAll(LengthData);
-		m_Protocol.SendData(LengthData.data(), LengthData.size());
-	}
+		// Read the packet data straight after the lengths:
+		size_t HeaderSize = Packet.size();
+		Packet.resize(HeaderSize + PacketLen);
+		m_Out.ReadBuf(&Packet[HeaderSize], PacketLen);
+		m_Out.CommitRead();
 
-	if (CompressedPacket.empty())
-	{
-		m_Protocol.m_OutPacketLenBuffer.CommitRead();
-		m_Protocol.SendData(PacketData.data(), PacketData.size());
-	}
-	else
-	{
-		m_Protocol.SendData(CompressedPacket.data(), CompressedPacket.size());
+		// Keep a copy of the packet data for the comm log:
+		if (g_ShouldLogCommOut)
+		{
+			PacketData.assign(Packet, HeaderSize, PacketLen);
+		}
 	}
 
 	// Log the comm into logfile:
@@ -2797,6 +2857,14 @@ cProtocol180::cPacketizer::~cPacketizer()
 			PacketData[0], PacketData[0], PacketLen, PacketLen, m_Protocol.m_State, Hex.c_str()
 		);
 	}
+
+	// Send the packet, or capture it for a broadcast:
+	if (m_Protocol.m_CapturedPacketData != nullptr)
+	{
+		m_Protocol.m_CapturedPacketData->append(Packet);
+		return;
+	}
+	m_Protocol.SendPacketData(Packet);
 }
 
 
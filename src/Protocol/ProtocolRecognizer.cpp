@@ -838,6 +838,16 @@ void cProtocolRecognizer::SendWindowOpen(const cWindow & a_Window)
 
 
 
+void cProtocolRecognizer::SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer)
+{
+	ASSERT(m_Protocol != nullptr);
+	m_Protocol->SendBroadcastPacket(a_Cache, a_Serializer);
+}
+
+
+
+
+
 AString cProtocolRecognizer::GetAuthServerID(void)
 {
 	ASSERT(m_Protocol != nullptr);
@@ -123,6 +123,8 @@ public:
 	virtual void SendWindowOpen                 (const cWindow & a_Window) override;
 	virtual void SendWindowProperty             (const cWindow & a_Window, short a_Property, short a_Value) override;
 	
+	virtual void SendBroadcastPacket(cBroadcastCache & a_Cache, cPacketSerializer & a_Serializer) override;
+	
 	virtual AString GetAuthServerID(void) override;
 
 	virtual void SendData(const char * a_Data, size_t a_Size) override;
@@ -803,7 +803,19 @@ void cRoot::LogChunkStats(cCommandOutputCallback & a_Output)
 		a_Output.Out("  Num loaded chunks: %d", NumValid);
 		a_Output.Out("  Num dirty chunks: %d", NumDirty);
 		a_Output.Out("  Num chunks in lighting queue: %d", NumInLighting);
+		cLightingThread & Lighting = World->GetLightingThread();
+		a_Output.Out("  Num lighting threads: " SIZE_T_FMT ", chunks lighted: " SIZE_T_FMT, Lighting.GetNumThreads(), Lighting.GetNumChunksLighted());
+		a_Output.Out("  Lighting latency: %.1f msec average, %.1f msec max; %.1f msec average calculation time",
+			Lighting.GetAverageLatency(), Lighting.GetMaxLatency(), Lighting.GetAverageLightingTime()
+		);
 		a_Output.Out("  Num chunks in generator queue: %d", NumInGenerator);
+		a_Output.Out("  Num generator threads: " SIZE_T_FMT, World->GetGenerator().GetNumThreads());
+		a_Output.Out("  Num storage threads: " SIZE_T_FMT, World->GetStorage().GetNumThreads());
+		a_Output.Out("  Num chunk tick threads: " SIZE_T_FMT, World->GetChunkMap()->GetNumTickThreads());
+		cChunkDataCache & ChunkDataCache = World->GetChunkDataCache();
+		a_Output.Out("  Chunk data cache: " SIZE_T_FMT " chunks, " SIZE_T_FMT " hits, " SIZE_T_FMT " misses",
+			ChunkDataCache.GetNumChunks(), ChunkDataCache.GetNumHits(), ChunkDataCache.GetNumMisses()
+		);
 		a_Output.Out("  Num chunks in storage load queue: %d", NumInLoadQueue);
 		a_Output.Out("  Num chunks in storage save queue: %d", NumInSaveQueue);
 		int Mem = NumValid * sizeof(cChunk);
@@ -572,6 +572,27 @@ void cServer::ExecuteConsoleCommand(const AString & a_Cmd, cCommandOutputCallbac
 		a_Output.Finished();
 		return;
 	}
+	else if (split[0].compare("compactregions") == 0)
+	{
+		class WorldCallback : public cWorldListCallback
+		{
+			virtual bool Item(cWorld * a_World) override
+			{
+				a_World->GetStorage().QueueCompactFiles();
+				return false;
+			}
+		} WC;
+		cRoot::Get()->ForEachWorld(WC);
+		a_Output.Out("Queued the compaction of the region files of all worlds");
+		a_Output.Finished();
+		return;
+	}
+	else if (split[0].compare("pregenerate") == 0)
+	{
+		ExecutePregenerateCommand(split, a_Output);
+		a_Output.Finished();
+		return;
+	}
 	#if defined(_MSC_VER) && defined(_DEBUG) && defined(ENABLE_LEAK_FINDER)
 	else if (split[0].compare("dumpmem") == 0)
 	{
@@ -647,6 +668,64 @@ void cServer::PrintHelp(const AStringVector & a_Split, cCommandOutputCallback &
 
 
 
+void cServer::ExecutePregenerateCommand(const AStringVector & a_Split, cCommandOutputCallback & a_Output)
+{
+	if ((a_Split.size() < 2) || (a_Split.size() > 5) || (a_Split.size() == 4))
+	{
+		a_Output.Out("Usage: pregenerate <world> <radius> [<chunkx> <chunkz>] | pregenerate <world> [stop]");
+		return;
+	}
+	cWorld * World = cRoot::Get()->GetWorld(a_Split[1]);
+	if (World == nullptr)
+	{
+		a_Output.Out(Printf("There is no world \"%s\"", a_Split[1].c_str()));
+		return;
+	}
+
+	// Report the progress:
+	if (a_Split.size() == 2)
+	{
+		AString Status = World->GetPregenerationStatus();
+		a_Output.Out(Status.empty() ? Printf("World %s is not being pregenerated", a_Split[1].c_str()) : Printf("Pregenerating world %s around %s", a_Split[1].c_str(), Status.c_str()));
+		return;
+	}
+
+	// Stop the pregeneration:
+	if (a_Split[2].compare("stop") == 0)
+	{
+		if (a_Split.size() != 3)
+		{
+			a_Output.Out("Usage: pregenerate <world> stop");
+			return;
+		}
+		a_Output.Out(World->StopPregeneration() ? Printf("Stopped the pregeneration of world %s", a_Split[1].c_str()) : Printf("World %s is not being pregenerated", a_Split[1].c_str()));
+		return;
+	}
+
+	// Start the pregeneration, around the spawn by default:
+	int Radius;
+	int ChunkX = 0, ChunkZ = 0;
+	cChunkDef::BlockToChunk(FloorC(World->GetSpawnX()), FloorC(World->GetSpawnZ()), ChunkX, ChunkZ);
+	if (
+		!StringToInteger(a_Split[2], Radius) || (Radius < 0) ||
+		((a_Split.size() == 5) && (!StringToInteger(a_Split[3], ChunkX) || !StringToInteger(a_Split[4], ChunkZ)))
+	)
+	{
+		a_Output.Out("Usage: pregenerate <world> <radius> [<chunkx> <chunkz>]");
+		return;
+	}
+	if (!World->StartPregeneration(ChunkX, ChunkZ, Radius))
+	{
+		a_Output.Out(Printf("World %s is already being pregenerated, stop it first", a_Split[1].c_str()));
+		return;
+	}
+	a_Output.Out(Printf("Started pregenerating world %s, radius %d around chunk [%d, %d]", a_Split[1].c_str(), Radius, ChunkX, ChunkZ));
+}
+
+
+
+
+
 void cServer::BindBuiltInConsoleCommands(void)
 {
 	cPluginManager * PlgMgr = cPluginManager::Get();
@@ -655,6 +734,9 @@ void cServer::BindBuiltInConsoleCommands(void)
 	PlgMgr->BindConsoleCommand("restart", nullptr, " - Restarts the server cleanly");
 	PlgMgr->BindConsoleCommand("stop", nullptr, " - Stops the server cleanly");
 	PlgMgr->BindConsoleCommand("chunkstats", nullptr, " - Displays detailed chunk memory statistics");
+	PlgMgr->BindConsoleCommand("compactregions", nullptr, " - Compacts the region files of all worlds");
+	PlgMgr->BindConsoleCommand("pregenerate <world> <radius> [<chunkx> <chunkz>]", nullptr, " - Generates, lights and saves the chunks around the spawn or the specified chunk");
+	PlgMgr->BindConsoleCommand("pregenerate <world> [stop]", nullptr, " - Shows or stops the progress of the pregeneration");
 	PlgMgr->BindConsoleCommand("load <pluginname>", nullptr, " - Adds and enables the specified plugin");
 	PlgMgr->BindConsoleCommand("unload <pluginname>", nullptr, " - Disables the specified plugin");
 	PlgMgr->BindConsoleCommand("destroyentities", nullptr, " - Destroys all entities in all worlds");
@@ -90,6 +90,10 @@ public:  // tolua_export
 	/** Lists all available console commands and their helpstrings */
 	void PrintHelp(const AStringVector & a_Split, cCommandOutputCallback & a_Output);
 
+	/** Executes the "pregenerate" console command: starts, stops or reports the pregeneration of a world.
+	Doesn't call a_Output.Finished(), the caller does. */
+	void ExecutePregenerateCommand(const AStringVector & a_Split, cCommandOutputCallback & a_Output);
+
 	/** Binds the built-in console commands with the plugin manager */
 	static void BindBuiltInConsoleCommands(void);
 	
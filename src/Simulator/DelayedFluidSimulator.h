@@ -65,7 +65,7 @@ protected:
 	int m_AddSlotNum;  // Index into m_Slots[] where to add new blocks in each ChunkData
 	int m_SimSlotNum;  // Index into m_Slots[] where to simulate blocks in each ChunkData
 	
-	int m_TotalBlocks;  // Statistics only: the total number of blocks currently queued
+	std::atomic<int> m_TotalBlocks;  // Statistics only: the total number of blocks currently queued; blocks may be added by parallel chunk tickers
 
 	/*
 	Slots:
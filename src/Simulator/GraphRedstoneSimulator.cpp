@@ -0,0 +1,1523 @@
+
+// GraphRedstoneSimulator.cpp
+
+// Implements the cGraphRedstoneSimulator class representing a redstone simulator that propagates power changes through a graph of components
+
+#include "Globals.h"
+#include "GraphRedstoneSimulator.h"
+#include "../World.h"
+#include "../Chunk.h"
+#include "../BoundingBox.h"
+#include "../Entities/Entity.h"
+#include "../BlockEntities/ChestEntity.h"
+#include "../BlockEntities/RedstonePoweredEntity.h"
+#include "../Blocks/ChunkInterface.h"
+#include "../Blocks/GetHandlerCompileTimeTemplate.h"
+#include "../Blocks/BlockTorch.h"
+#include "../Blocks/BlockLever.h"
+#include "../Blocks/BlockButton.h"
+#include "../Blocks/BlockTripwireHook.h"
+#include "../Blocks/BlockDoor.h"
+#include "../Blocks/BlockPiston.h"
+
+
+
+
+
+/** The highest power level of a redstone signal. */
+static const unsigned char MAX_POWER = 15;
+
+/** Number of ticks that a torch takes to change its output (one redstone tick). */
+static const int TORCH_DELAY_TICKS = 2;
+
+/** Maximum number of component evaluations in a single chunk per tick; the rest is left for the next tick.
+Stops clocks made of instant components from hanging the tick thread. */
+static const size_t MAX_EVALUATIONS_PER_TICK = 4096;
+
+/** Maximum number of tripwire blocks between two tripwire hooks. */
+static const int MAX_TRIPWIRE_LENGTH = 40;
+
+static const eBlockFace g_Faces[] =
+{
+	BLOCK_FACE_XM,
+	BLOCK_FACE_XP,
+	BLOCK_FACE_YM,
+	BLOCK_FACE_YP,
+	BLOCK_FACE_ZM,
+	BLOCK_FACE_ZP,
+} ;
+
+static const eBlockFace g_HorizontalFaces[] =
+{
+	BLOCK_FACE_XM,
+	BLOCK_FACE_XP,
+	BLOCK_FACE_ZM,
+	BLOCK_FACE_ZP,
+} ;
+
+typedef GetHandlerCompileTime<E_BLOCK_TORCH>::type TorchHandler;
+typedef GetHandlerCompileTime<E_BLOCK_LEVER>::type LeverHandler;
+typedef GetHandlerCompileTime<E_BLOCK_STONE_BUTTON>::type ButtonHandler;
+typedef GetHandlerCompileTime<E_BLOCK_TRIPWIRE_HOOK>::type TripwireHookHandler;
+typedef GetHandlerCompileTime<E_BLOCK_WOODEN_DOOR>::type DoorHandler;
+typedef GetHandlerCompileTime<E_BLOCK_PISTON>::type PistonHandler;
+
+
+
+
+
+/** Returns the offset of the neighbor on the specified face. */
+static Vector3i FaceOffset(eBlockFace a_Face)
+{
+	int x = 0, y = 0, z = 0;
+	AddFaceDirection(x, y, z, a_Face);
+	return Vector3i(x, y, z);
+}
+
+
+
+
+
+static bool IsHorizontalFace(eBlockFace a_Face)
+{
+	return ((a_Face != BLOCK_FACE_YM) && (a_Face != BLOCK_FACE_YP));
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cGraphRedstoneSimulator:
+
+cGraphRedstoneSimulator::cGraphRedstoneSimulator(cWorld & a_World) :
+	super(a_World)
+{
+}
+
+
+
+
+
+cRedstoneSimulatorChunkData * cGraphRedstoneSimulator::CreateChunkData()
+{
+	return new cGraphChunkData;
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::SimulateChunk(float a_Dt, int a_ChunkX, int a_ChunkZ, cChunk * a_Chunk)
+{
+	UNUSED(a_Dt);
+	UNUSED(a_ChunkX);
+	UNUSED(a_ChunkZ);
+
+	cGraphChunkData * Data = GetData(a_Chunk);
+	Data->m_Tick += 1;
+	a_Chunk->SetIsRedstoneDirty(false);  // Block changes come in through WakeUp(), the flag is not needed
+	if (Data->m_Components.empty())
+	{
+		Data->m_Queue.clear();
+		Data->m_ScheduledChanges.clear();
+		return;
+	}
+
+	ProcessScheduledChanges(a_Chunk, *Data);
+
+	// Sensors have no inputs to tell them about a change, poll them:
+	for (const auto & Sensor : Data->m_Sensors)
+	{
+		Queue(a_Chunk, Sensor);
+	}
+
+	ProcessQueue(a_Chunk, *Data);
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::WakeUp(int a_BlockX, int a_BlockY, int a_BlockZ, cChunk * a_Chunk)
+{
+	// The base class wakes up all the neighbors as well, but AddBlock() already handles everything around the block:
+	AddBlock(a_BlockX, a_BlockY, a_BlockZ, a_Chunk);
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::AddBlock(int a_BlockX, int a_BlockY, int a_BlockZ, cChunk * a_Chunk)
+{
+	if ((a_Chunk == nullptr) || !a_Chunk->IsValid() || (a_BlockY < 0) || (a_BlockY >= cChunkDef::Height))
+	{
+		return;
+	}
+
+	int RelX = a_BlockX - a_Chunk->GetPosX() * cChunkDef::Width;
+	int RelZ = a_BlockZ - a_Chunk->GetPosZ() * cChunkDef::Width;
+	cChunk * Chunk = a_Chunk->GetRelNeighborChunkAdjustCoords(RelX, RelZ);
+	if ((Chunk == nullptr) || !Chunk->IsValid())
+	{
+		return;
+	}
+
+	UpdateComponent(Chunk, Vector3i(RelX, a_BlockY, RelZ));
+}
+
+
+
+
+
+cGraphRedstoneSimulator::eComponentKind cGraphRedstoneSimulator::GetComponentKind(BLOCKTYPE a_BlockType)
+{
+	switch (a_BlockType)
+	{
+		case E_BLOCK_LEVER:
+		case E_BLOCK_STONE_BUTTON:
+		case E_BLOCK_WOODEN_BUTTON:
+		case E_BLOCK_DETECTOR_RAIL:
+		{
+			return ckSwitch;
+		}
+		case E_BLOCK_BLOCK_OF_REDSTONE: return ckRedstoneBlock;
+
+		case E_BLOCK_STONE_PRESSURE_PLATE:
+		case E_BLOCK_WOODEN_PRESSURE_PLATE:
+		case E_BLOCK_LIGHT_WEIGHTED_PRESSURE_PLATE:
+		case E_BLOCK_HEAVY_WEIGHTED_PRESSURE_PLATE:
+		{
+			return ckPressurePlate;
+		}
+		case E_BLOCK_TRIPWIRE:        return ckTripwire;
+		case E_BLOCK_TRIPWIRE_HOOK:   return ckTripwireHook;
+		case E_BLOCK_DAYLIGHT_SENSOR: return ckDaylightSensor;
+		case E_BLOCK_TRAPPED_CHEST:   return ckTrappedChest;
+
+		case E_BLOCK_REDSTONE_WIRE: return ckWire;
+		case E_BLOCK_REDSTONE_TORCH_ON:
+		case E_BLOCK_REDSTONE_TORCH_OFF:
+		{
+			return ckTorch;
+		}
+		case E_BLOCK_REDSTONE_REPEATER_ON:
+		case E_BLOCK_REDSTONE_REPEATER_OFF:
+		{
+			return ckRepeater;
+		}
+
+		case E_BLOCK_REDSTONE_LAMP_ON:
+		case E_BLOCK_REDSTONE_LAMP_OFF:
+		{
+			return ckLamp;
+		}
+		case E_BLOCK_PISTON:
+		case E_BLOCK_STICKY_PISTON:
+		{
+			return ckPiston;
+		}
+		case E_BLOCK_WOODEN_DOOR:
+		case E_BLOCK_IRON_DOOR:
+		case E_BLOCK_SPRUCE_DOOR:
+		case E_BLOCK_BIRCH_DOOR:
+		case E_BLOCK_JUNGLE_DOOR:
+		case E_BLOCK_ACACIA_DOOR:
+		case E_BLOCK_DARK_OAK_DOOR:
+		{
+			return ckDoor;
+		}
+		case E_BLOCK_TRAPDOOR:
+		case E_BLOCK_IRON_TRAPDOOR:
+		{
+			return ckTrapdoor;
+		}
+		case E_BLOCK_FENCE_GATE:
+		case E_BLOCK_SPRUCE_FENCE_GATE:
+		case E_BLOCK_BIRCH_FENCE_GATE:
+		case E_BLOCK_JUNGLE_FENCE_GATE:
+		case E_BLOCK_DARK_OAK_FENCE_GATE:
+		case E_BLOCK_ACACIA_FENCE_GATE:
+		{
+			return ckFenceGate;
+		}
+		case E_BLOCK_TNT: return ckTNT;
+		case E_BLOCK_ACTIVATOR_RAIL:
+		case E_BLOCK_POWERED_RAIL:
+		{
+			return ckRail;
+		}
+		case E_BLOCK_DISPENSER:
+		case E_BLOCK_DROPPER:
+		case E_BLOCK_COMMAND_BLOCK:
+		case E_BLOCK_NOTE_BLOCK:
+		{
+			return ckPoweredEntity;
+		}
+		default: return ckNone;
+	}
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::IsSensor(eComponentKind a_Kind)
+{
+	switch (a_Kind)
+	{
+		case ckPressurePlate:
+		case ckTripwire:
+		case ckTripwireHook:
+		case ckDaylightSensor:
+		case ckTrappedChest:
+		{
+			return true;
+		}
+		default: return false;
+	}
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::IsConductive(BLOCKTYPE a_BlockType)
+{
+	switch (a_BlockType)
+	{
+		case E_BLOCK_BLOCK_OF_REDSTONE:
+		case E_BLOCK_PISTON:
+		case E_BLOCK_STICKY_PISTON:
+		{
+			return false;
+		}
+		default: return cBlockInfo::FullyOccupiesVoxel(a_BlockType);
+	}
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetBlockStatePower(BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+	switch (a_BlockType)
+	{
+		case E_BLOCK_REDSTONE_WIRE: return a_BlockMeta;
+
+		case E_BLOCK_BLOCK_OF_REDSTONE:
+		case E_BLOCK_REDSTONE_TORCH_ON:
+		case E_BLOCK_REDSTONE_REPEATER_ON:
+		{
+			return MAX_POWER;
+		}
+
+		case E_BLOCK_LEVER:
+		case E_BLOCK_STONE_BUTTON:
+		case E_BLOCK_WOODEN_BUTTON:
+		case E_BLOCK_DETECTOR_RAIL:
+		case E_BLOCK_TRIPWIRE_HOOK:
+		{
+			// The highest meta bit says whether they're on:
+			return ((a_BlockMeta & 0x08) != 0) ? MAX_POWER : 0;
+		}
+
+		case E_BLOCK_STONE_PRESSURE_PLATE:
+		case E_BLOCK_WOODEN_PRESSURE_PLATE:
+		case E_BLOCK_LIGHT_WEIGHTED_PRESSURE_PLATE:
+		case E_BLOCK_HEAVY_WEIGHTED_PRESSURE_PLATE:
+		{
+			return (a_BlockMeta == E_META_PRESSURE_PLATE_DEPRESSED) ? MAX_POWER : 0;
+		}
+
+		default: return 0;
+	}
+}
+
+
+
+
+
+eBlockFace cGraphRedstoneSimulator::GetStrongPowerFace(BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+	switch (a_BlockType)
+	{
+		case E_BLOCK_LEVER:         return ReverseBlockFace(LeverHandler::BlockMetaDataToBlockFace(a_BlockMeta));
+		case E_BLOCK_STONE_BUTTON:
+		case E_BLOCK_WOODEN_BUTTON:
+		{
+			return ReverseBlockFace(ButtonHandler::BlockMetaDataToBlockFace(a_BlockMeta));
+		}
+		case E_BLOCK_TRIPWIRE_HOOK: return ReverseBlockFace(TripwireHookHandler::MetadataToDirection(a_BlockMeta));
+
+		// Pressure plates, detector rails and trapped chests power the block beneath them:
+		default: return BLOCK_FACE_YM;
+	}
+}
+
+
+
+
+
+eBlockFace cGraphRedstoneSimulator::GetRepeaterFront(NIBBLETYPE a_BlockMeta)
+{
+	switch (a_BlockMeta & 0x03)
+	{
+		case 0x0: return BLOCK_FACE_ZM;
+		case 0x1: return BLOCK_FACE_XP;
+		case 0x2: return BLOCK_FACE_ZP;
+		default:  return BLOCK_FACE_XM;
+	}
+}
+
+
+
+
+
+cGraphRedstoneSimulator::cGraphChunkData * cGraphRedstoneSimulator::GetData(cChunk * a_Chunk)
+{
+	return static_cast<cGraphChunkData *>(a_Chunk->GetRedstoneSimulatorData());
+}
+
+
+
+
+
+cChunk * cGraphRedstoneSimulator::GetChunkAdjustCoords(cChunk * a_Chunk, Vector3i & a_RelPos)
+{
+	if ((a_RelPos.y < 0) || (a_RelPos.y >= cChunkDef::Height))
+	{
+		return nullptr;
+	}
+	int RelX = a_RelPos.x;
+	int RelZ = a_RelPos.z;
+	cChunk * Chunk = a_Chunk->GetRelNeighborChunkAdjustCoords(RelX, RelZ);
+	if ((Chunk == nullptr) || !Chunk->IsValid())
+	{
+		return nullptr;
+	}
+	a_RelPos.x = RelX;
+	a_RelPos.z = RelZ;
+	return Chunk;
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::GetBlock(cChunk * a_Chunk, const Vector3i & a_RelPos, sBlock & a_Block)
+{
+	a_Block.m_RelPos = a_RelPos;
+	a_Block.m_Chunk = GetChunkAdjustCoords(a_Chunk, a_Block.m_RelPos);
+	if (a_Block.m_Chunk == nullptr)
+	{
+		return false;
+	}
+	a_Block.m_Chunk->GetBlockTypeMeta(a_Block.m_RelPos.x, a_Block.m_RelPos.y, a_Block.m_RelPos.z, a_Block.m_BlockType, a_Block.m_BlockMeta);
+	return true;
+}
+
+
+
+
+
+cGraphRedstoneSimulator::sComponent * cGraphRedstoneSimulator::FindComponent(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	cComponents & Components = GetData(a_Chunk)->m_Components;
+	auto itr = Components.find(cChunkDef::MakeIndexNoCheck(a_RelPos.x, a_RelPos.y, a_RelPos.z));
+	return (itr == Components.end()) ? nullptr : &itr->second;
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::HasComponentAt(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	Vector3i RelPos(a_RelPos);
+	cChunk * Chunk = GetChunkAdjustCoords(a_Chunk, RelPos);
+	return ((Chunk != nullptr) && (FindComponent(Chunk, RelPos) != nullptr));
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::UpdateComponent(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	BLOCKTYPE BlockType;
+	NIBBLETYPE BlockMeta;
+	a_Chunk->GetBlockTypeMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, BlockType, BlockMeta);
+	eComponentKind Kind = GetComponentKind(BlockType);
+
+	cGraphChunkData * Data = GetData(a_Chunk);
+	int Index = cChunkDef::MakeIndexNoCheck(a_RelPos.x, a_RelPos.y, a_RelPos.z);
+	auto itr = Data->m_Components.find(Index);
+	if (itr != Data->m_Components.end())
+	{
+		sComponent & Component = itr->second;
+		if (Component.m_Kind != Kind)
+		{
+			if (IsSensor(Component.m_Kind))
+			{
+				auto & Sensors = Data->m_Sensors;
+				Sensors.erase(std::remove(Sensors.begin(), Sensors.end(), a_RelPos), Sensors.end());
+			}
+			if (Kind == ckNone)
+			{
+				// Everything that read the component's output is close enough to be queued by InvalidateAround() below
+				Data->m_Components.erase(itr);
+			}
+			else
+			{
+				Component.m_Kind = Kind;
+				Component.m_Power = GetBlockStatePower(BlockType, BlockMeta);
+				Component.m_HasActed = false;
+				if (IsSensor(Kind))
+				{
+					Data->m_Sensors.push_back(a_RelPos);
+				}
+			}
+		}
+	}
+	else if (Kind != ckNone)
+	{
+		sComponent Component;
+		Component.m_Kind = Kind;
+		Component.m_Power = GetBlockStatePower(BlockType, BlockMeta);
+		Component.m_IsQueued = false;
+		Component.m_IsScheduled = false;
+		Component.m_AreOutputsValid = false;
+		Component.m_HasActed = false;
+		Data->m_Components[Index] = Component;
+		if (IsSensor(Kind))
+		{
+			Data->m_Sensors.push_back(a_RelPos);
+		}
+	}
+
+	InvalidateAround(a_Chunk, a_RelPos);
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::InvalidateAround(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	// A block change can affect the components up to two blocks away (through a conductive block, or a wire going up or down):
+	for (int x = -2; x <= 2; x++)
+	{
+		for (int y = -2; y <= 2; y++)
+		{
+			for (int z = -2; z <= 2; z++)
+			{
+				if (std::abs(x) + std::abs(y) + std::abs(z) > 2)
+				{
+					continue;
+				}
+				Vector3i RelPos(a_RelPos.x + x, a_RelPos.y + y, a_RelPos.z + z);
+				cChunk * Chunk = GetChunkAdjustCoords(a_Chunk, RelPos);
+				if (Chunk == nullptr)
+				{
+					continue;
+				}
+				sComponent * Component = FindComponent(Chunk, RelPos);
+				if (Component == nullptr)
+				{
+					continue;
+				}
+				Component->m_AreOutputsValid = false;
+				Queue(Chunk, RelPos);
+			}  // for z
+		}  // for y
+	}  // for x
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::Queue(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	Vector3i RelPos(a_RelPos);
+	cChunk * Chunk = GetChunkAdjustCoords(a_Chunk, RelPos);
+	if (Chunk == nullptr)
+	{
+		return;
+	}
+	sComponent * Component = FindComponent(Chunk, RelPos);
+	if ((Component == nullptr) || Component->m_IsQueued)
+	{
+		return;
+	}
+	Component->m_IsQueued = true;
+	GetData(Chunk)->m_Queue.push_back(RelPos);
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::QueueOutputs(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	sComponent * Component = FindComponent(a_Chunk, a_RelPos);
+	if (Component == nullptr)
+	{
+		return;
+	}
+	if (!Component->m_AreOutputsValid)
+	{
+		BuildOutputs(a_Chunk, a_RelPos, *Component);
+	}
+
+	// Queue() doesn't add nor remove components, so Component stays valid:
+	for (const auto & Output : Component->m_Outputs)
+	{
+		Queue(a_Chunk, Output);
+	}
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::BuildOutputs(cChunk * a_Chunk, const Vector3i & a_RelPos, sComponent & a_Component)
+{
+	auto & Outputs = a_Component.m_Outputs;
+	Outputs.clear();
+	auto AddOutput = [&](const Vector3i & a_Pos)
+	{
+		if (HasComponentAt(a_Chunk, a_Pos) && (std::find(Outputs.begin(), Outputs.end(), a_Pos) == Outputs.end()))
+		{
+			Outputs.push_back(a_Pos);
+		}
+	};
+
+	for (auto Face : g_Faces)
+	{
+		Vector3i Neighbor = a_RelPos + FaceOffset(Face);
+		AddOutput(Neighbor);
+
+		// The components around a conductive neighbor read its power:
+		sBlock Block;
+		if (GetBlock(a_Chunk, Neighbor, Block) && IsConductive(Block.m_BlockType))
+		{
+			for (auto BlockFace : g_Faces)
+			{
+				Vector3i Pos = Neighbor + FaceOffset(BlockFace);
+				if (Pos != a_RelPos)
+				{
+					AddOutput(Pos);
+				}
+			}
+		}
+	}
+
+	// Wires going up or down a block:
+	for (auto Face : g_HorizontalFaces)
+	{
+		Vector3i Side = a_RelPos + FaceOffset(Face);
+		AddOutput(Side + Vector3i(0, 1, 0));
+		AddOutput(Side + Vector3i(0, -1, 0));
+	}
+
+	a_Component.m_AreOutputsValid = true;
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::ProcessQueue(cChunk * a_Chunk, cGraphChunkData & a_Data)
+{
+	size_t NumEvaluations = 0;
+	while (!a_Data.m_Queue.empty())
+	{
+		// Evaluating may queue more components, take the current batch out of the queue:
+		std::vector<Vector3i> Batch;
+		std::swap(Batch, a_Data.m_Queue);
+		for (size_t i = 0; i < Batch.size(); i++)
+		{
+			if (NumEvaluations >= MAX_EVALUATIONS_PER_TICK)
+			{
+				// Leave the rest for the next tick, before the components queued meanwhile:
+				a_Data.m_Queue.insert(a_Data.m_Queue.begin(), Batch.begin() + static_cast<ptrdiff_t>(i), Batch.end());
+				return;
+			}
+			sComponent * Component = FindComponent(a_Chunk, Batch[i]);
+			if (Component == nullptr)
+			{
+				continue;
+			}
+			Component->m_IsQueued = false;
+			Evaluate(a_Chunk, Batch[i]);
+			NumEvaluations++;
+		}  // for i - Batch[]
+	}
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::ProcessScheduledChanges(cChunk * a_Chunk, cGraphChunkData & a_Data)
+{
+	if (a_Data.m_ScheduledChanges.empty())
+	{
+		return;
+	}
+
+	// Take the changes that are due out of the list, keeping the order of the rest:
+	Int64 Now = a_Data.m_Tick;
+	auto & Changes = a_Data.m_ScheduledChanges;
+	auto Due = std::stable_partition(Changes.begin(), Changes.end(), [Now](const sScheduledChange & a_Change)
+		{
+			return (a_Change.m_Tick > Now);
+		}
+	);
+	std::vector<sScheduledChange> DueChanges(Due, Changes.end());
+	Changes.erase(Due, Changes.end());
+
+	for (const auto & Change : DueChanges)
+	{
+		const Vector3i & RelPos = Change.m_RelPos;
+		sComponent * Component = FindComponent(a_Chunk, RelPos);
+		if (Component == nullptr)
+		{
+			continue;
+		}
+		Component->m_IsScheduled = false;
+
+		BLOCKTYPE BlockType;
+		NIBBLETYPE BlockMeta;
+		a_Chunk->GetBlockTypeMeta(RelPos.x, RelPos.y, RelPos.z, BlockType, BlockMeta);
+		BLOCKTYPE NewBlockType;
+		switch (Component->m_Kind)
+		{
+			case ckTorch:    NewBlockType = Change.m_ShouldPowerOn ? E_BLOCK_REDSTONE_TORCH_ON : E_BLOCK_REDSTONE_TORCH_OFF; break;
+			case ckRepeater: NewBlockType = Change.m_ShouldPowerOn ? E_BLOCK_REDSTONE_REPEATER_ON : E_BLOCK_REDSTONE_REPEATER_OFF; break;
+			default:
+			{
+				// The block has been replaced since the change was scheduled
+				continue;
+			}
+		}
+		if (NewBlockType != BlockType)
+		{
+			a_Chunk->SetBlock(RelPos.x, RelPos.y, RelPos.z, NewBlockType, BlockMeta);
+		}
+		SetOutputPower(a_Chunk, RelPos, Change.m_ShouldPowerOn ? MAX_POWER : 0);
+
+		// The input may have changed again while the change was pending:
+		Queue(a_Chunk, RelPos);
+	}  // for Change - DueChanges[]
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::Evaluate(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	sComponent * Component = FindComponent(a_Chunk, a_RelPos);
+	if (Component == nullptr)
+	{
+		return;
+	}
+	sBlock Self;
+	VERIFY(GetBlock(a_Chunk, a_RelPos, Self));
+	eComponentKind Kind = GetComponentKind(Self.m_BlockType);
+	if (Kind != Component->m_Kind)
+	{
+		// The block has been changed without notifying the simulator, catch up:
+		UpdateComponent(a_Chunk, a_RelPos);
+		return;
+	}
+
+	switch (Kind)
+	{
+		case ckSwitch:
+		case ckRedstoneBlock:
+		{
+			SetOutputPower(a_Chunk, a_RelPos, GetBlockStatePower(Self.m_BlockType, Self.m_BlockMeta));
+			break;
+		}
+
+		case ckPressurePlate:  SetOutputPower(a_Chunk, a_RelPos, SensePressurePlate(a_Chunk, a_RelPos, Self.m_BlockType, Self.m_BlockMeta)); break;
+		case ckTripwire:       SenseTripwire(a_Chunk, a_RelPos, Self.m_BlockMeta); break;
+		case ckTripwireHook:   SetOutputPower(a_Chunk, a_RelPos, SenseTripwireHook(a_Chunk, a_RelPos, Self.m_BlockMeta)); break;
+		case ckDaylightSensor: SetOutputPower(a_Chunk, a_RelPos, SenseDaylight(a_Chunk, a_RelPos)); break;
+		case ckTrappedChest:   SetOutputPower(a_Chunk, a_RelPos, SenseTrappedChest(a_Chunk, a_RelPos)); break;
+
+		case ckWire:
+		{
+			unsigned char Power = GetWireInputPower(a_Chunk, a_RelPos);
+			if (Power != Self.m_BlockMeta)
+			{
+				a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, Power);
+			}
+			SetOutputPower(a_Chunk, a_RelPos, Power);
+			break;
+		}
+
+		case ckTorch:
+		{
+			if (Component->m_IsScheduled)
+			{
+				break;
+			}
+
+			// The torch turns off when the block it is attached to is powered:
+			Vector3i AttachedPos = a_RelPos + FaceOffset(ReverseBlockFace(TorchHandler::MetaDataToDirection(Self.m_BlockMeta)));
+			sBlock Attached;
+			bool IsInputPowered = (
+				GetBlock(a_Chunk, AttachedPos, Attached) &&
+				IsConductive(Attached.m_BlockType) &&
+				(GetBlockPower(a_Chunk, AttachedPos, a_RelPos, false) > 0)
+			);
+			bool IsOn = (Self.m_BlockType == E_BLOCK_REDSTONE_TORCH_ON);
+			if (IsInputPowered == IsOn)
+			{
+				ScheduleChange(a_Chunk, a_RelPos, TORCH_DELAY_TICKS, !IsInputPowered);
+			}
+			break;
+		}
+
+		case ckRepeater:
+		{
+			if (Component->m_IsScheduled || IsRepeaterLocked(a_Chunk, a_RelPos, Self.m_BlockMeta))
+			{
+				break;
+			}
+			bool IsInputPowered = (GetPowerFrom(a_Chunk, a_RelPos, ReverseBlockFace(GetRepeaterFront(Self.m_BlockMeta))) > 0);
+			bool IsOn = (Self.m_BlockType == E_BLOCK_REDSTONE_REPEATER_ON);
+			if (IsInputPowered != IsOn)
+			{
+				// Meta bits 2 and 3 hold the delay in redstone ticks, minus one; a redstone tick is two world ticks:
+				ScheduleChange(a_Chunk, a_RelPos, (((Self.m_BlockMeta & 0x0c) >> 2) + 1) * 2, IsInputPowered);
+			}
+			break;
+		}
+
+		case ckLamp:
+		case ckPiston:
+		case ckDoor:
+		case ckTrapdoor:
+		case ckFenceGate:
+		case ckTNT:
+		case ckRail:
+		case ckPoweredEntity:
+		{
+			// Pistons aren't powered through their head:
+			eBlockFace IgnoredFace = (Kind == ckPiston) ? PistonHandler::MetaDataToDirection(Self.m_BlockMeta & 0x07) : BLOCK_FACE_NONE;
+			bool IsPowered = (GetMechanismInputPower(a_Chunk, a_RelPos, IgnoredFace) > 0);
+			if (Component->m_HasActed && (IsPowered == (Component->m_Power > 0)))
+			{
+				break;
+			}
+			Component->m_HasActed = true;
+			Component->m_Power = IsPowered ? MAX_POWER : 0;
+
+			// Acting may change the blocks around and re-enter the simulator, Component must not be used after this:
+			ActuateMechanism(a_Chunk, a_RelPos, Self, IsPowered);
+			break;
+		}
+
+		case ckNone:
+		{
+			ASSERT(!"Components of no kind are not stored");
+			break;
+		}
+	}
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::SetOutputPower(cChunk * a_Chunk, const Vector3i & a_RelPos, unsigned char a_Power)
+{
+	sComponent * Component = FindComponent(a_Chunk, a_RelPos);
+	if ((Component == nullptr) || (Component->m_Power == a_Power))
+	{
+		return;
+	}
+	Component->m_Power = a_Power;
+	QueueOutputs(a_Chunk, a_RelPos);
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::ScheduleChange(cChunk * a_Chunk, const Vector3i & a_RelPos, int a_DelayTicks, bool a_ShouldPowerOn)
+{
+	sComponent * Component = FindComponent(a_Chunk, a_RelPos);
+	if (Component == nullptr)
+	{
+		return;
+	}
+	Component->m_IsScheduled = true;
+
+	sScheduledChange Change;
+	Change.m_RelPos = a_RelPos;
+	cGraphChunkData * Data = GetData(a_Chunk);
+	Change.m_Tick = Data->m_Tick + a_DelayTicks;
+	Change.m_ShouldPowerOn = a_ShouldPowerOn;
+	Data->m_ScheduledChanges.push_back(Change);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Power queries:
+
+unsigned char cGraphRedstoneSimulator::GetComponentPower(const sBlock & a_Block)
+{
+	sComponent * Component = FindComponent(a_Block.m_Chunk, a_Block.m_RelPos);
+	if ((Component != nullptr) && (Component->m_Kind == GetComponentKind(a_Block.m_BlockType)))
+	{
+		return Component->m_Power;
+	}
+	return GetBlockStatePower(a_Block.m_BlockType, a_Block.m_BlockMeta);
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetOutputPower(const sBlock & a_Source, eBlockFace a_Face, bool a_IsIntoBlock)
+{
+	switch (GetComponentKind(a_Source.m_BlockType))
+	{
+		case ckRedstoneBlock:
+		case ckDaylightSensor:
+		{
+			// Power the neighboring components, but not blocks:
+			return a_IsIntoBlock ? 0 : GetComponentPower(a_Source);
+		}
+
+		case ckSwitch:
+		case ckPressurePlate:
+		case ckTripwireHook:
+		case ckTrappedChest:
+		{
+			// Power the neighboring components, and the block they're attached to:
+			if (!a_IsIntoBlock || (a_Face == GetStrongPowerFace(a_Source.m_BlockType, a_Source.m_BlockMeta)))
+			{
+				return GetComponentPower(a_Source);
+			}
+			return 0;
+		}
+
+		case ckTorch:
+		{
+			if (a_Source.m_BlockType != E_BLOCK_REDSTONE_TORCH_ON)
+			{
+				return 0;
+			}
+
+			// Power the neighboring components except through the attached block, and the block above:
+			if (a_Face == ReverseBlockFace(TorchHandler::MetaDataToDirection(a_Source.m_BlockMeta)))
+			{
+				return 0;
+			}
+			return (!a_IsIntoBlock || (a_Face == BLOCK_FACE_YP)) ? MAX_POWER : 0;
+		}
+
+		case ckRepeater:
+		{
+			// Power whatever is in front:
+			if ((a_Source.m_BlockType == E_BLOCK_REDSTONE_REPEATER_ON) && (a_Face == GetRepeaterFront(a_Source.m_BlockMeta)))
+			{
+				return MAX_POWER;
+			}
+			return 0;
+		}
+
+		case ckWire:
+		{
+			// Power the block beneath and whatever the wire points to:
+			if ((a_Face == BLOCK_FACE_YM) || (IsHorizontalFace(a_Face) && IsWirePointingTo(a_Source, a_Face)))
+			{
+				return GetComponentPower(a_Source);
+			}
+			return 0;
+		}
+
+		default: return 0;
+	}
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetBlockPower(cChunk * a_Chunk, const Vector3i & a_BlockPos, const Vector3i & a_ExcludePos, bool a_StrongOnly)
+{
+	unsigned char Power = 0;
+	for (auto Face : g_Faces)
+	{
+		Vector3i SourcePos = a_BlockPos + FaceOffset(Face);
+		if (SourcePos == a_ExcludePos)
+		{
+			continue;
+		}
+		sBlock Source;
+		if (!GetBlock(a_Chunk, SourcePos, Source))
+		{
+			continue;
+		}
+		eComponentKind Kind = GetComponentKind(Source.m_BlockType);
+		if ((Kind == ckNone) || (a_StrongOnly && (Kind == ckWire)))
+		{
+			continue;
+		}
+		Power = std::max(Power, GetOutputPower(Source, ReverseBlockFace(Face), true));
+	}
+	return Power;
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetPowerFrom(cChunk * a_Chunk, const Vector3i & a_RelPos, eBlockFace a_Face)
+{
+	Vector3i SourcePos = a_RelPos + FaceOffset(a_Face);
+	sBlock Source;
+	if (!GetBlock(a_Chunk, SourcePos, Source))
+	{
+		return 0;
+	}
+	unsigned char Power = 0;
+	if (GetComponentKind(Source.m_BlockType) != ckNone)
+	{
+		Power = GetOutputPower(Source, ReverseBlockFace(a_Face), false);
+	}
+	if (IsConductive(Source.m_BlockType))
+	{
+		Power = std::max(Power, GetBlockPower(a_Chunk, SourcePos, a_RelPos, false));
+	}
+	return Power;
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetMechanismInputPower(cChunk * a_Chunk, const Vector3i & a_RelPos, eBlockFace a_IgnoredFace)
+{
+	unsigned char Power = 0;
+	for (auto Face : g_Faces)
+	{
+		if (Face == a_IgnoredFace)
+		{
+			continue;
+		}
+		Power = std::max(Power, GetPowerFrom(a_Chunk, a_RelPos, Face));
+		if (Power >= MAX_POWER)
+		{
+			break;
+		}
+	}
+	return Power;
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::GetWireInputPower(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	unsigned char Power = 0;
+
+	// Wires pass their power on to other wires, losing one level per block:
+	auto AddWirePower = [&Power](const sBlock & a_Wire)
+	{
+		unsigned char WirePower = GetComponentPower(a_Wire);
+		if (WirePower > 0)
+		{
+			Power = std::max(Power, static_cast<unsigned char>(WirePower - 1));
+		}
+	};
+
+	for (auto Face : g_Faces)
+	{
+		Vector3i Pos = a_RelPos + FaceOffset(Face);
+		sBlock Neighbor;
+		if (!GetBlock(a_Chunk, Pos, Neighbor))
+		{
+			continue;
+		}
+		eComponentKind Kind = GetComponentKind(Neighbor.m_BlockType);
+		if (Kind == ckWire)
+		{
+			if (IsHorizontalFace(Face))
+			{
+				AddWirePower(Neighbor);
+			}
+			continue;
+		}
+		if (Kind != ckNone)
+		{
+			Power = std::max(Power, GetOutputPower(Neighbor, ReverseBlockFace(Face), false));
+		}
+		if (IsConductive(Neighbor.m_BlockType))
+		{
+			// Wires don't power each other through blocks:
+			Power = std::max(Power, GetBlockPower(a_Chunk, Pos, a_RelPos, true));
+		}
+	}
+
+	// Wires going up or down a block, unless cut off by a solid block:
+	sBlock Above;
+	bool IsCovered = GetBlock(a_Chunk, a_RelPos + Vector3i(0, 1, 0), Above) && cBlockInfo::FullyOccupiesVoxel(Above.m_BlockType);
+	for (auto Face : g_HorizontalFaces)
+	{
+		Vector3i Side = a_RelPos + FaceOffset(Face);
+		sBlock Block;
+		if (!IsCovered && GetBlock(a_Chunk, Side + Vector3i(0, 1, 0), Block) && (Block.m_BlockType == E_BLOCK_REDSTONE_WIRE))
+		{
+			AddWirePower(Block);
+		}
+		if (
+			GetBlock(a_Chunk, Side, Block) && !cBlockInfo::FullyOccupiesVoxel(Block.m_BlockType) &&
+			GetBlock(a_Chunk, Side + Vector3i(0, -1, 0), Block) && (Block.m_BlockType == E_BLOCK_REDSTONE_WIRE)
+		)
+		{
+			AddWirePower(Block);
+		}
+	}
+	return Power;
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::IsWirePointingTo(const sBlock & a_Wire, eBlockFace a_Face)
+{
+	cChunk * Chunk = a_Wire.m_Chunk;
+	const Vector3i & RelPos = a_Wire.m_RelPos;
+
+	sBlock Above;
+	bool IsCovered = GetBlock(Chunk, RelPos + Vector3i(0, 1, 0), Above) && cBlockInfo::FullyOccupiesVoxel(Above.m_BlockType);
+
+	// Returns true if the wire connects to its neighbor on the specified face:
+	auto IsConnected = [&](eBlockFace a_SideFace)
+	{
+		Vector3i Side = RelPos + FaceOffset(a_SideFace);
+		sBlock Neighbor;
+		if (!GetBlock(Chunk, Side, Neighbor))
+		{
+			return false;
+		}
+		switch (GetComponentKind(Neighbor.m_BlockType))
+		{
+			case ckWire:
+			case ckSwitch:
+			case ckRedstoneBlock:
+			case ckPressurePlate:
+			case ckTripwireHook:
+			case ckDaylightSensor:
+			case ckTrappedChest:
+			case ckTorch:
+			{
+				return true;
+			}
+			case ckRepeater:
+			{
+				// Only the repeater's front and back connect:
+				eBlockFace Front = GetRepeaterFront(Neighbor.m_BlockMeta);
+				return ((Front == a_SideFace) || (Front == ReverseBlockFace(a_SideFace)));
+			}
+			default: break;
+		}
+		sBlock Block;
+		if (!IsCovered && GetBlock(Chunk, Side + Vector3i(0, 1, 0), Block) && (Block.m_BlockType == E_BLOCK_REDSTONE_WIRE))
+		{
+			return true;
+		}
+		return (
+			!cBlockInfo::FullyOccupiesVoxel(Neighbor.m_BlockType) &&
+			GetBlock(Chunk, Side + Vector3i(0, -1, 0), Block) && (Block.m_BlockType == E_BLOCK_REDSTONE_WIRE)
+		);
+	};
+
+	bool IsConnectedX = IsConnected(BLOCK_FACE_XM) || IsConnected(BLOCK_FACE_XP);
+	bool IsConnectedZ = IsConnected(BLOCK_FACE_ZM) || IsConnected(BLOCK_FACE_ZP);
+	if (!IsConnectedX && !IsConnectedZ)
+	{
+		// A lone dot of wire points everywhere
+		return true;
+	}
+
+	// A straight line points along its axis, a bent wire points nowhere:
+	if ((a_Face == BLOCK_FACE_XM) || (a_Face == BLOCK_FACE_XP))
+	{
+		return !IsConnectedZ;
+	}
+	return !IsConnectedX;
+}
+
+
+
+
+
+bool cGraphRedstoneSimulator::IsRepeaterLocked(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta)
+{
+	eBlockFace Front = GetRepeaterFront(a_BlockMeta);
+	for (auto Face : g_HorizontalFaces)
+	{
+		if ((Face == Front) || (Face == ReverseBlockFace(Front)))
+		{
+			continue;
+		}
+		sBlock Side;
+		if (!GetBlock(a_Chunk, a_RelPos + FaceOffset(Face), Side))
+		{
+			continue;
+		}
+		if ((Side.m_BlockType == E_BLOCK_REDSTONE_REPEATER_ON) && (GetRepeaterFront(Side.m_BlockMeta) == ReverseBlockFace(Face)))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Sensors:
+
+unsigned char cGraphRedstoneSimulator::SensePressurePlate(cChunk * a_Chunk, const Vector3i & a_RelPos, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+	class cPressurePlateCallback :
+		public cEntityCallback
+	{
+	public:
+		cPressurePlateCallback(bool a_IsPlayersOnly) :
+			m_NumEntities(0),
+			m_IsPlayersOnly(a_IsPlayersOnly)
+		{
+		}
+
+		virtual bool Item(cEntity * a_Entity) override
+		{
+			if (!m_IsPlayersOnly || a_Entity->IsPlayer())
+			{
+				m_NumEntities++;
+			}
+			return false;
+		}
+
+		int m_NumEntities;
+		bool m_IsPlayersOnly;
+	} Callback(a_BlockType == E_BLOCK_STONE_PRESSURE_PLATE);
+
+	int BlockX = a_Chunk->GetPosX() * cChunkDef::Width + a_RelPos.x;
+	int BlockZ = a_Chunk->GetPosZ() * cChunkDef::Width + a_RelPos.z;
+	cBoundingBox PlateBox(BlockX + 0.125, BlockX + 0.875, a_RelPos.y, a_RelPos.y + 0.25, BlockZ + 0.125, BlockZ + 0.875);
+	a_Chunk->ForEachEntityInBox(PlateBox, Callback);
+
+	unsigned char Power;
+	switch (a_BlockType)
+	{
+		case E_BLOCK_LIGHT_WEIGHTED_PRESSURE_PLATE:
+		{
+			Power = static_cast<unsigned char>(std::min(Callback.m_NumEntities, static_cast<int>(MAX_POWER)));
+			break;
+		}
+		case E_BLOCK_HEAVY_WEIGHTED_PRESSURE_PLATE:
+		{
+			Power = static_cast<unsigned char>(std::min((Callback.m_NumEntities + 9) / 10, static_cast<int>(MAX_POWER)));
+			break;
+		}
+		default:
+		{
+			Power = (Callback.m_NumEntities > 0) ? MAX_POWER : 0;
+			break;
+		}
+	}
+
+	NIBBLETYPE NewMeta = (Power > 0) ? E_META_PRESSURE_PLATE_DEPRESSED : E_META_PRESSURE_PLATE_RAISED;
+	if (NewMeta != a_BlockMeta)
+	{
+		a_Chunk->BroadcastSoundEffect("random.click", BlockX + 0.5, a_RelPos.y + 0.1, BlockZ + 0.5, 0.3f, (Power > 0) ? 0.6f : 0.5f);
+		a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewMeta);
+	}
+	return Power;
+}
+
+
+
+
+
+void cGraphRedstoneSimulator::SenseTripwire(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta)
+{
+	class cTripwireCallback :
+		public cEntityCallback
+	{
+	public:
+		cTripwireCallback(void) :
+			m_IsFound(false)
+		{
+		}
+
+		virtual bool Item(cEntity * a_Entity) override
+		{
+			UNUSED(a_Entity);
+			m_IsFound = true;
+			return true;
+		}
+
+		bool m_IsFound;
+	} Callback;
+
+	int BlockX = a_Chunk->GetPosX() * cChunkDef::Width + a_RelPos.x;
+	int BlockZ = a_Chunk->GetPosZ() * cChunkDef::Width + a_RelPos.z;
+	cBoundingBox WireBox(BlockX, BlockX + 1, a_RelPos.y, a_RelPos.y + 0.1, BlockZ, BlockZ + 1);
+	a_Chunk->ForEachEntityInBox(WireBox, Callback);
+
+	NIBBLETYPE NewMeta = Callback.m_IsFound ? 0x1 : 0x0;
+	if (NewMeta != a_BlockMeta)
+	{
+		// The hooks on both ends read the meta when they're polled:
+		a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewMeta);
+	}
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::SenseTripwireHook(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta)
+{
+	eBlockFace FaceToGoTowards = TripwireHookHandler::MetadataToDirection(a_BlockMeta);
+	Vector3i Step = FaceOffset(FaceToGoTowards);
+	Vector3i Pos = a_RelPos;
+	bool IsConnected = false;
+	bool IsActivated = false;
+	for (int i = 0; i < MAX_TRIPWIRE_LENGTH; i++)
+	{
+		Pos += Step;
+		sBlock Block;
+		if (!GetBlock(a_Chunk, Pos, Block))
+		{
+			break;
+		}
+		if (Block.m_BlockType == E_BLOCK_TRIPWIRE)
+		{
+			IsActivated = IsActivated || (Block.m_BlockMeta == 0x1);
+			continue;
+		}
+		// The line is complete if it ends in another hook, facing back:
+		IsConnected = (
+			(Block.m_BlockType == E_BLOCK_TRIPWIRE_HOOK) &&
+			(ReverseBlockFace(TripwireHookHandler::MetadataToDirection(Block.m_BlockMeta)) == FaceToGoTowards)
+		);
+		break;
+	}
+
+	NIBBLETYPE NewMeta;
+	if (!IsConnected)
+	{
+		// Not connected, AND away all the state bits
+		NewMeta = a_BlockMeta & 0x3;
+	}
+	else if (IsActivated)
+	{
+		// Connected and activated, set the 3rd and 4th highest bits
+		NewMeta = a_BlockMeta | 0xc;
+	}
+	else
+	{
+		// Connected but not activated, AND away the highest bit
+		NewMeta = (a_BlockMeta & 0x7) | 0x4;
+	}
+	if (NewMeta != a_BlockMeta)
+	{
+		a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewMeta);
+	}
+	return (IsConnected && IsActivated) ? MAX_POWER : 0;
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::SenseDaylight(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	if (!a_Chunk->IsLightValid())
+	{
+		// Keep the current power until the light is known:
+		m_World.QueueLightChunk(a_Chunk->GetPosX(), a_Chunk->GetPosZ());
+		sComponent * Component = FindComponent(a_Chunk, a_RelPos);
+		return (Component != nullptr) ? Component->m_Power : 0;
+	}
+
+	NIBBLETYPE SkyLight = (a_RelPos.y + 1 < cChunkDef::Height) ? a_Chunk->GetSkyLight(a_RelPos.x, a_RelPos.y + 1, a_RelPos.z) : 15;
+	return (a_Chunk->GetTimeAlteredLight(SkyLight) > 8) ? MAX_POWER : 0;
+}
+
+
+
+
+
+unsigned char cGraphRedstoneSimulator::SenseTrappedChest(cChunk * a_Chunk, const Vector3i & a_RelPos)
+{
+	class cTrappedChestCallback :
+		public cChestCallback
+	{
+	public:
+		cTrappedChestCallback(void) :
+			m_NumPlayers(0)
+		{
+		}
+
+		virtual bool Item(cChestEntity * a_Chest) override
+		{
+			m_NumPlayers = a_Chest->GetNumberOfPlayers();
+			return false;
+		}
+
+		int m_NumPlayers;
+	} Callback;
+
+	int BlockX = a_Chunk->GetPosX() * cChunkDef::Width + a_RelPos.x;
+	int BlockZ = a_Chunk->GetPosZ() * cChunkDef::Width + a_RelPos.z;
+	a_Chunk->DoWithChestAt(BlockX, a_RelPos.y, BlockZ, Callback);
+	return static_cast<unsigned char>(Clamp(Callback.m_NumPlayers, 0, static_cast<int>(MAX_POWER)));
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Mechanisms:
+
+void cGraphRedstoneSimulator::ActuateMechanism(cChunk * a_Chunk, const Vector3i & a_RelPos, const sBlock & a_Block, bool a_IsPowered)
+{
+	int BlockX = a_Chunk->GetPosX() * cChunkDef::Width + a_RelPos.x;
+	int BlockY = a_RelPos.y;
+	int BlockZ = a_Chunk->GetPosZ() * cChunkDef::Width + a_RelPos.z;
+	switch (GetComponentKind(a_Block.m_BlockType))
+	{
+		case ckLamp:
+		{
+			BLOCKTYPE NewBlockType = a_IsPowered ? E_BLOCK_REDSTONE_LAMP_ON : E_BLOCK_REDSTONE_LAMP_OFF;
+			if (NewBlockType != a_Block.m_BlockType)
+			{
+				a_Chunk->SetBlock(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewBlockType, 0);
+			}
+			break;
+		}
+
+		case ckPiston:
+		{
+			if (a_IsPowered)
+			{
+				PistonHandler::ExtendPiston(BlockX, BlockY, BlockZ, &m_World);
+			}
+			else
+			{
+				PistonHandler::RetractPiston(BlockX, BlockY, BlockZ, &m_World);
+			}
+			break;
+		}
+
+		case ckDoor:
+		{
+			cChunkInterface ChunkInterface(m_World.GetChunkMap());
+			if ((DoorHandler::IsOpen(ChunkInterface, BlockX, BlockY, BlockZ) != 0) != a_IsPowered)
+			{
+				DoorHandler::SetOpen(ChunkInterface, BlockX, BlockY, BlockZ, a_IsPowered);
+				a_Chunk->BroadcastSoundParticleEffect(1003, BlockX, BlockY, BlockZ, 0);
+			}
+			break;
+		}
+
+		case ckTrapdoor:
+		{
+			m_World.SetTrapdoorOpen(BlockX, BlockY, BlockZ, a_IsPowered);
+			break;
+		}
+
+		case ckFenceGate:
+		{
+			NIBBLETYPE NewMeta = a_IsPowered ? (a_Block.m_BlockMeta | 0x4) : (a_Block.m_BlockMeta & 0xb);
+			if (NewMeta != a_Block.m_BlockMeta)
+			{
+				a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewMeta);
+				a_Chunk->BroadcastSoundParticleEffect(1003, BlockX, BlockY, BlockZ, 0);
+			}
+			break;
+		}
+
+		case ckTNT:
+		{
+			if (!a_IsPowered)
+			{
+				break;
+			}
+			a_Chunk->BroadcastSoundEffect("game.tnt.primed", BlockX, BlockY, BlockZ, 0.5f, 0.6f);
+			a_Chunk->SetBlock(a_RelPos.x, a_RelPos.y, a_RelPos.z, E_BLOCK_AIR, 0);
+			m_World.SpawnPrimedTNT(BlockX + 0.5, BlockY + 0.5, BlockZ + 0.5);
+			UpdateComponent(a_Chunk, a_RelPos);
+			break;
+		}
+
+		case ckRail:
+		{
+			NIBBLETYPE NewMeta = a_IsPowered ? (a_Block.m_BlockMeta | 0x08) : (a_Block.m_BlockMeta & 0x07);
+			if (NewMeta != a_Block.m_BlockMeta)
+			{
+				a_Chunk->SetMeta(a_RelPos.x, a_RelPos.y, a_RelPos.z, NewMeta);
+			}
+			break;
+		}
+
+		case ckPoweredEntity:
+		{
+			class cSetPowerCallback :
+				public cRedstonePoweredCallback
+			{
+			public:
+				cSetPowerCallback(bool a_IsPowered) :
+					m_IsPowered(a_IsPowered)
+				{
+				}
+
+				virtual bool Item(cRedstonePoweredEntity * a_Entity) override
+				{
+					a_Entity->SetRedstonePower(m_IsPowered);
+					return false;
+				}
+
+				bool m_IsPowered;
+			} Callback(a_IsPowered);
+			a_Chunk->DoWithRedstonePoweredEntityAt(BlockX, BlockY, BlockZ, Callback);
+			break;
+		}
+
+		default:
+		{
+			ASSERT(!"Not a mechanism");
+			break;
+		}
+	}
+}
+
+
+
+
@@ -0,0 +1,273 @@
+
+// GraphRedstoneSimulator.h
+
+// Declares the cGraphRedstoneSimulator class representing a redstone simulator that propagates power changes through a graph of components
+
+#pragma once
+
+#include <unordered_map>
+#include "RedstoneSimulator.h"
+#include "../Defines.h"
+
+
+
+
+
+/** The graph redstone simulator keeps the redstone components of each chunk in a per-chunk hash map, keyed by
+the block index, storing each component's power level and the list of components that read its output (the graph edges).
+Instead of re-simulating all the components of a chunk whenever anything changes, only the components whose inputs may
+have changed are queued for evaluation; when a component's output changes, the components on its edges are queued in turn.
+Each component evaluates its input by looking at its immediate neighbors only, so a single evaluation is constant-time.
+Block changes reported through WakeUp() invalidate the edges of the components around the changed block and queue them.
+Torches and repeaters apply their output changes after a delay; sensors (pressure plates, tripwires, daylight sensors,
+trapped chests) are polled in each tick.
+Selected in world.ini by [Physics] RedstoneSimulator=Graph, next to the Incremental simulator, so that they can be compared.
+*/
+class cGraphRedstoneSimulator :
+	public cRedstoneSimulator
+{
+	typedef cRedstoneSimulator super;
+
+public:
+	cGraphRedstoneSimulator(cWorld & a_World);
+
+	virtual cRedstoneSimulatorChunkData * CreateChunkData() override;
+
+	virtual void Simulate(float a_Dt) override { UNUSED(a_Dt); }  // not used
+	virtual void SimulateChunk(float a_Dt, int a_ChunkX, int a_ChunkZ, cChunk * a_Chunk) override;
+	virtual bool IsAllowedBlock(BLOCKTYPE a_BlockType) override { return (GetComponentKind(a_BlockType) != ckNone); }
+	virtual void WakeUp(int a_BlockX, int a_BlockY, int a_BlockZ, cChunk * a_Chunk) override;
+
+	// The graph only learns about block changes through WakeUp(), the queued block sets (button resets) included:
+	virtual bool ShouldWakeUpOnQueuedSetBlocks(void) const override { return true; }
+
+protected:
+	/** The kinds of components, each kind is evaluated by its own rules. */
+	enum eComponentKind
+	{
+		ckNone,
+
+		// Sources whose output is given by their block meta (levers, buttons, detector rails) or type (redstone block):
+		ckSwitch,
+		ckRedstoneBlock,
+
+		// Sources that sense the world, polled in each tick:
+		ckPressurePlate,
+		ckTripwire,
+		ckTripwireHook,
+		ckDaylightSensor,
+		ckTrappedChest,
+
+		// Carriers:
+		ckWire,
+		ckTorch,
+		ckRepeater,
+
+		// Mechanisms, acting whenever their input power turns on or off:
+		ckLamp,
+		ckPiston,
+		ckDoor,
+		ckTrapdoor,
+		ckFenceGate,
+		ckTNT,
+		ckRail,
+		ckPoweredEntity,  // Dispensers, droppers, command blocks and note blocks, handled by their cRedstonePoweredEntity
+	} ;
+
+	/** A single node of the component graph. */
+	struct sComponent
+	{
+		eComponentKind m_Kind;
+
+		/** The power level that the component outputs, 0 - 15. For mechanisms, the input power level that they last acted upon. */
+		unsigned char m_Power;
+
+		/** True if the component is in its chunk's evaluation queue. */
+		bool m_IsQueued;
+
+		/** True if a delayed output change is scheduled for the component (torches and repeaters). */
+		bool m_IsScheduled;
+
+		/** True if m_Outputs matches the component's current surroundings. */
+		bool m_AreOutputsValid;
+
+		/** True if the mechanism has acted at least once; until then it acts upon any input power. */
+		bool m_HasActed;
+
+		/** The graph edges: the coords of the components that read this component's output, relative to its chunk. */
+		std::vector<Vector3i> m_Outputs;
+	} ;
+
+	/** A delayed change of a torch's or a repeater's output. */
+	struct sScheduledChange
+	{
+		Vector3i m_RelPos;
+		Int64 m_Tick;  // The cGraphChunkData::m_Tick value at which the change is due
+		bool m_ShouldPowerOn;
+	} ;
+
+	typedef std::unordered_map<int, sComponent> cComponents;
+
+	class cGraphChunkData :
+		public cRedstoneSimulatorChunkData
+	{
+	public:
+		cGraphChunkData(void) :
+			m_Tick(0)
+		{
+		}
+
+		/** All the components in the chunk, keyed by cChunkDef::MakeIndexNoCheck() of their relative coords. */
+		cComponents m_Components;
+
+		/** The components waiting for evaluation, in the order in which they were queued. */
+		std::vector<Vector3i> m_Queue;
+
+		/** The delayed output changes waiting for their tick. */
+		std::vector<sScheduledChange> m_ScheduledChanges;
+
+		/** The number of times the chunk has been simulated; the clock for m_ScheduledChanges.
+		The delays don't run while the chunk isn't ticked, same as the Incremental simulator's repeater delays. */
+		Int64 m_Tick;
+
+		/** The components that sense the world and need evaluating in each tick. */
+		std::vector<Vector3i> m_Sensors;
+	} ;
+
+	/** A block read from the world, with the chunk it is in and its coords relative to that chunk. */
+	struct sBlock
+	{
+		cChunk * m_Chunk;
+		Vector3i m_RelPos;
+		BLOCKTYPE m_BlockType;
+		NIBBLETYPE m_BlockMeta;
+	} ;
+
+
+	virtual void AddBlock(int a_BlockX, int a_BlockY, int a_BlockZ, cChunk * a_Chunk) override;
+
+	/** Returns the kind of component represented by the block type, ckNone if the block is not a redstone component. */
+	static eComponentKind GetComponentKind(BLOCKTYPE a_BlockType);
+
+	/** Returns true if the component kind is polled in each tick. */
+	static bool IsSensor(eComponentKind a_Kind);
+
+	/** Returns true if the block can be powered by a source and pass the power to its neighbors. */
+	static bool IsConductive(BLOCKTYPE a_BlockType);
+
+	/** Returns the power that a component outputs, judging by its block type and meta only. */
+	static unsigned char GetBlockStatePower(BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta);
+
+	/** Returns the face of a switch, tripwire hook, pressure plate or trapped chest through which it strongly powers a block. */
+	static eBlockFace GetStrongPowerFace(BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta);
+
+	/** Returns the face of a repeater through which it outputs its power. */
+	static eBlockFace GetRepeaterFront(NIBBLETYPE a_BlockMeta);
+
+	/** Returns the simulator data of the chunk. */
+	static cGraphChunkData * GetData(cChunk * a_Chunk);
+
+	/** Returns the chunk containing the specified coords, relative to a_Chunk but not necessarily in it, and adjusts the coords
+	to be relative to the returned chunk. Returns nullptr if the chunk is not valid or the coords are out of the world's height. */
+	static cChunk * GetChunkAdjustCoords(cChunk * a_Chunk, Vector3i & a_RelPos);
+
+	/** Reads the block at the specified coords, relative to a_Chunk but not necessarily in it. Returns false if not available. */
+	static bool GetBlock(cChunk * a_Chunk, const Vector3i & a_RelPos, sBlock & a_Block);
+
+	/** Returns the component at the specified coords, which must be in a_Chunk, or nullptr if there is none. */
+	static sComponent * FindComponent(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Returns true if there is a component at the specified coords, relative to a_Chunk but not necessarily in it. */
+	static bool HasComponentAt(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Creates, updates or removes the component at the specified coords, which must be in a_Chunk, to match the block there.
+	Queues the components around it for evaluation. */
+	void UpdateComponent(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Invalidates the graph edges of all the components close enough to the specified block to be affected by its change,
+	and queues them for evaluation. The coords are relative to a_Chunk but not necessarily in it. */
+	void InvalidateAround(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Queues the component at the specified coords for evaluation, if there is one and it is not queued yet.
+	The coords are relative to a_Chunk but not necessarily in it. */
+	void Queue(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Queues all the components that read the output of the component at the specified coords, which must be in a_Chunk.
+	Rebuilds the component's graph edges first, if they are not valid. */
+	void QueueOutputs(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Fills the graph edges of the component at the specified coords, which must be in a_Chunk. */
+	void BuildOutputs(cChunk * a_Chunk, const Vector3i & a_RelPos, sComponent & a_Component);
+
+	/** Evaluates the queued components of the chunk, up to the per-tick limit. */
+	void ProcessQueue(cChunk * a_Chunk, cGraphChunkData & a_Data);
+
+	/** Applies the delayed output changes whose time has come. */
+	void ProcessScheduledChanges(cChunk * a_Chunk, cGraphChunkData & a_Data);
+
+	/** Evaluates the component at the specified coords, which must be in a_Chunk. */
+	void Evaluate(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Sets the output power of the component at the specified coords, which must be in a_Chunk.
+	If the power changes, queues the components that read it. */
+	void SetOutputPower(cChunk * a_Chunk, const Vector3i & a_RelPos, unsigned char a_Power);
+
+	/** Schedules a delayed output change of the torch or repeater at the specified coords, which must be in a_Chunk. */
+	void ScheduleChange(cChunk * a_Chunk, const Vector3i & a_RelPos, int a_DelayTicks, bool a_ShouldPowerOn);
+
+	/* ====== Power queries ====== */
+
+	/** Returns the output power of the component, as stored in the graph, or judging by its block if not stored yet. */
+	static unsigned char GetComponentPower(const sBlock & a_Block);
+
+	/** Returns the power that the component outputs through the specified face.
+	If a_IsIntoBlock is true, the neighbor is a conductive block, and only the power that makes the block powered is returned. */
+	static unsigned char GetOutputPower(const sBlock & a_Source, eBlockFace a_Face, bool a_IsIntoBlock);
+
+	/** Returns the power level of the conductive block, given by the components around it, except the one at a_ExcludePos.
+	If a_StrongOnly is true, the power from wires (which only power the block weakly) is not counted.
+	The coords are relative to a_Chunk but not necessarily in it. */
+	static unsigned char GetBlockPower(cChunk * a_Chunk, const Vector3i & a_BlockPos, const Vector3i & a_ExcludePos, bool a_StrongOnly);
+
+	/** Returns the power that the block at the specified coords receives from its neighbor on the specified face,
+	either directly from a component or through a conductive block. The coords are relative to a_Chunk but not necessarily in it. */
+	static unsigned char GetPowerFrom(cChunk * a_Chunk, const Vector3i & a_RelPos, eBlockFace a_Face);
+
+	/** Returns the power that the mechanism at the specified coords receives from all its neighbors, except through a_IgnoredFace. */
+	static unsigned char GetMechanismInputPower(cChunk * a_Chunk, const Vector3i & a_RelPos, eBlockFace a_IgnoredFace);
+
+	/** Returns the power that the wire at the specified coords receives from its neighbors. */
+	static unsigned char GetWireInputPower(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Returns true if the wire outputs its power through the specified horizontal face, depending on its connections. */
+	static bool IsWirePointingTo(const sBlock & a_Wire, eBlockFace a_Face);
+
+	/** Returns true if the repeater at the specified coords is locked by a powered repeater facing its side. */
+	static bool IsRepeaterLocked(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta);
+
+	/* ====== Sensors ====== */
+
+	/** Returns the power of the pressure plate, updating its meta to reflect whether it is pressed. */
+	unsigned char SensePressurePlate(cChunk * a_Chunk, const Vector3i & a_RelPos, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta);
+
+	/** Updates the meta of the tripwire to reflect whether an entity is on it. */
+	void SenseTripwire(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta);
+
+	/** Returns the power of the tripwire hook, updating its meta to reflect the state of the tripwire line. */
+	unsigned char SenseTripwireHook(cChunk * a_Chunk, const Vector3i & a_RelPos, NIBBLETYPE a_BlockMeta);
+
+	/** Returns the power of the daylight sensor, based on the time-altered skylight above it. */
+	unsigned char SenseDaylight(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/** Returns the power of the trapped chest, based on the number of players using it. */
+	unsigned char SenseTrappedChest(cChunk * a_Chunk, const Vector3i & a_RelPos);
+
+	/* ====== Mechanisms ====== */
+
+	/** Makes the mechanism act upon its input power turning on or off. */
+	void ActuateMechanism(cChunk * a_Chunk, const Vector3i & a_RelPos, const sBlock & a_Block, bool a_IsPowered);
+} ;
+
+
+
+
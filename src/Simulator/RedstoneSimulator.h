@@ -27,4 +27,8 @@ public:
 	
 	virtual cRedstoneSimulatorChunkData * CreateChunkData() = 0;
 
+	/** Returns true if the simulator needs WakeUp() for the blocks set by cWorld::QueueSetBlock() when their time comes,
+	such as buttons popping back out. Simulators that rescan the dirty chunks don't need it. */
+	virtual bool ShouldWakeUpOnQueuedSetBlocks(void) const { return false; }
+
 } ;
@@ -46,7 +46,7 @@ public:
 protected:
 	bool m_IsInstantFall;  // If set to true, blocks don't fall using cFallingBlock entity, but instantly instead
 	
-	int  m_TotalBlocks;    // Total number of blocks currently in the queue for simulating
+	std::atomic<int> m_TotalBlocks;  // Total number of blocks currently in the queue for simulating; blocks may be added by parallel chunk tickers
 	
 	virtual void AddBlock(int a_BlockX, int a_BlockY, int a_BlockZ, cChunk * a_Chunk) override;
 	
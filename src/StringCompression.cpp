@@ -10,16 +10,95 @@
 
 
 
+/** A pool of reusable zlib contexts, either cZlibDeflater or cZlibInflater objects.
+A context is taken out of the pool for the duration of a single call and put back afterwards, so that it is never
+used by two threads at once. At most MAX_FREE contexts are kept, any more are freed when put back. */
+template <class T>
+class cZlibContextPool
+{
+public:
+	/** Takes a context out of the pool, creating a new one if the pool is empty. */
+	std::unique_ptr<T> Get(void)
+	{
+		{
+			cCSLock Lock(m_CS);
+			if (!m_Free.empty())
+			{
+				std::unique_ptr<T> res = std::move(m_Free.back());
+				m_Free.pop_back();
+				return res;
+			}
+		}
+		return std::unique_ptr<T>(new T);
+	}
+
+	/** Puts a context taken by Get() back into the pool. */
+	void Put(std::unique_ptr<T> a_Context)
+	{
+		cCSLock Lock(m_CS);
+		if (m_Free.size() < MAX_FREE)
+		{
+			m_Free.push_back(std::move(a_Context));
+		}
+	}
+
+protected:
+	static const size_t MAX_FREE = 16;
+
+	cCriticalSection m_CS;
+
+	/** The contexts not used by anyone at the moment. Protected by m_CS. */
+	std::vector<std::unique_ptr<T>> m_Free;
+} ;
+
+
+
+
+
+/** Holds a context taken out of a pool for its lifetime. */
+template <class T>
+class cPooledZlibContext
+{
+public:
+	cPooledZlibContext(cZlibContextPool<T> & a_Pool) :
+		m_Pool(a_Pool),
+		m_Context(a_Pool.Get())
+	{
+	}
+
+	~cPooledZlibContext()
+	{
+		m_Pool.Put(std::move(m_Context));
+	}
+
+	T * operator -> (void) { return m_Context.get(); }
+
+protected:
+	cZlibContextPool<T> & m_Pool;
+	std::unique_ptr<T> m_Context;
+} ;
+
+
+
+
+
+static cZlibContextPool<cZlibDeflater> g_DeflaterPool;
+static cZlibContextPool<cZlibInflater> g_InflaterPool;
+
+
+
+
+
 /// Compresses a_Data into a_Compressed; returns Z_XXX error constants same as zlib's compress2()
 int CompressString(const char * a_Data, size_t a_Length, AString & a_Compressed, int a_Factor)
 {
-	uLongf CompressedSize = compressBound((uLong)a_Length);
+	size_t CompressedSize = compressBound((uLong)a_Length);
 	
 	// HACK: We're assuming that AString returns its internal buffer in its data() call and we're overwriting that buffer!
 	// It saves us one allocation and one memcpy of the entire compressed data
 	// It may not work on some STL implementations! (Confirmed working on MSVC 2008 & 2010)
 	a_Compressed.resize(CompressedSize);
-	int errorcode = compress2((Bytef*)a_Compressed.data(), &CompressedSize, (const Bytef *)a_Data, (uLong)a_Length, a_Factor);
+	int errorcode = CompressBuffer(a_Data, a_Length, (char *)a_Compressed.data(), CompressedSize, a_Factor);
 	if (errorcode != Z_OK)
 	{
 		return errorcode;
@@ -39,8 +118,8 @@ int UncompressString(const char * a_Data, size_t a_Length, AString & a_Uncompres
 	// It saves us one allocation and one memcpy of the entire compressed data
 	// It may not work on some STL implementations! (Confirmed working on MSVC 2008 & 2010)
 	a_Uncompressed.resize(a_UncompressedSize);
-	uLongf UncompressedSize = (uLongf)a_UncompressedSize;  // On some architectures the uLongf is different in size to int, that may be the cause of the -5 error
-	int errorcode = uncompress((Bytef*)a_Uncompressed.data(), &UncompressedSize, (const Bytef*)a_Data, (uLong)a_Length);
+	size_t UncompressedSize = a_UncompressedSize;
+	int errorcode = UncompressBuffer(a_Data, a_Length, (char *)a_Uncompressed.data(), UncompressedSize);
 	if (errorcode != Z_OK)
 	{
 		return errorcode;
@@ -185,60 +264,338 @@ extern int InflateString(const char * a_Data, size_t a_Length, AString & a_Uncom
 {
 	a_Uncompressed.reserve(a_Length);
 
-	char Buffer[64 KiB];
-	z_stream strm;
-	memset(&strm, 0, sizeof(strm));
-	strm.next_in = (Bytef *)a_Data;
-	strm.avail_in = (uInt)a_Length;
-	strm.next_out = (Bytef *)Buffer;
-	strm.avail_out = sizeof(Buffer);
-	
-	int res = inflateInit(&strm);  // Force GZIP decoding
+	cPooledZlibContext<cZlibInflater> Inflater(g_InflaterPool);
+	int res = Inflater->Inflate(a_Data, a_Length, a_Uncompressed);
+	if (res != Z_OK)
+	{
+		LOG("%s: inflation failed: %d.", __FUNCTION__, res);
+	}
+	return res;
+}
+
+
+
+
+
+int CompressBuffer(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize, int a_Factor)
+{
+	cPooledZlibContext<cZlibDeflater> Deflater(g_DeflaterPool);
+	return Deflater->Compress(a_Factor, a_Data, a_Length, a_Out, a_OutSize);
+}
+
+
+
+
+
+int UncompressBuffer(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize)
+{
+	cPooledZlibContext<cZlibInflater> Inflater(g_InflaterPool);
+	return Inflater->Inflate(a_Data, a_Length, a_Out, a_OutSize);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cZlibDeflater:
+
+cZlibDeflater::cZlibDeflater(void) :
+	m_IsInitialized(false),
+	m_Factor(0),
+	m_Output(nullptr)
+{
+	memset(&m_Stream, 0, sizeof(m_Stream));
+}
+
+
+
+
+
+cZlibDeflater::~cZlibDeflater()
+{
+	if (m_IsInitialized)
+	{
+		deflateEnd(&m_Stream);
+	}
+}
+
+
+
+
+
+int cZlibDeflater::Begin(int a_Factor, AString & a_Output)
+{
+	m_Output = &a_Output;
+	return Init(a_Factor);
+}
+
+
+
+
+
+int cZlibDeflater::Write(const char * a_Data, size_t a_Length)
+{
+	ASSERT(m_IsInitialized);
+	m_Stream.next_in = (Bytef *)a_Data;
+	m_Stream.avail_in = (uInt)a_Length;
+	return Deflate(Z_NO_FLUSH);
+}
+
+
+
+
+
+int cZlibDeflater::End(void)
+{
+	ASSERT(m_IsInitialized);
+	m_Stream.next_in = nullptr;
+	m_Stream.avail_in = 0;
+	int res = Deflate(Z_FINISH);
+	m_Output = nullptr;
+	return res;
+}
+
+
+
+
+
+int cZlibDeflater::Compress(int a_Factor, const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize)
+{
+	ASSERT(m_Output == nullptr);  // Not in the middle of a stream
+	int res = Init(a_Factor);
 	if (res != Z_OK)
 	{
-		LOG("%s: inflation initialization failed: %d (\"%s\").", __FUNCTION__, res, strm.msg);
 		return res;
 	}
-	
+	m_Stream.next_in = (Bytef *)a_Data;
+	m_Stream.avail_in = (uInt)a_Length;
+	m_Stream.next_out = (Bytef *)a_Out;
+	m_Stream.avail_out = (uInt)a_OutSize;
+	res = deflate(&m_Stream, Z_FINISH);
+	if (res == Z_STREAM_END)
+	{
+		a_OutSize -= m_Stream.avail_out;
+		return Z_OK;
+	}
+	// The stream couldn't be finished, the output buffer is too small:
+	return ((res == Z_OK) || (res == Z_BUF_ERROR)) ? Z_BUF_ERROR : res;
+}
+
+
+
+
+
+int cZlibDeflater::Init(int a_Factor)
+{
+	if (!m_IsInitialized)
+	{
+		memset(&m_Stream, 0, sizeof(m_Stream));
+		int res = deflateInit(&m_Stream, a_Factor);
+		if (res != Z_OK)
+		{
+			return res;
+		}
+		m_IsInitialized = true;
+		m_Factor = a_Factor;
+		return Z_OK;
+	}
+
+	// Reuse the allocated state; its size doesn't depend on the factor, so only the parameters need changing:
+	int res = deflateReset(&m_Stream);
+	if ((res == Z_OK) && (m_Factor != a_Factor))
+	{
+		res = deflateParams(&m_Stream, a_Factor, Z_DEFAULT_STRATEGY);
+		if (res == Z_OK)
+		{
+			m_Factor = a_Factor;
+		}
+	}
+	return res;
+}
+
+
+
+
+
+int cZlibDeflater::Deflate(int a_Flush)
+{
 	for (;;)
 	{
-		res = inflate(&strm, Z_NO_FLUSH);
+		// Compress directly into the output string, growing it as needed (its capacity is kept when reused):
+		size_t OldSize = m_Output->size();
+		m_Output->resize(OldSize + OUTPUT_STEP);
+		m_Stream.next_out = (Bytef *)&(*m_Output)[OldSize];
+		m_Stream.avail_out = (uInt)OUTPUT_STEP;
+		int res = deflate(&m_Stream, a_Flush);
+		m_Output->resize(OldSize + OUTPUT_STEP - m_Stream.avail_out);
 		switch (res)
 		{
+			case Z_STREAM_END:
+			{
+				return Z_OK;
+			}
 			case Z_OK:
+			case Z_BUF_ERROR:
 			{
-				// Some data has been uncompressed. Consume the buffer and continue uncompressing
-				a_Uncompressed.append(Buffer, sizeof(Buffer) - strm.avail_out);
-				strm.next_out = (Bytef *)Buffer;
-				strm.avail_out = sizeof(Buffer);
-				if (strm.avail_in == 0)
+				if ((a_Flush == Z_NO_FLUSH) && (m_Stream.avail_in == 0) && (m_Stream.avail_out > 0))
 				{
-					// All data has been uncompressed
-					inflateEnd(&strm);
+					// All the input has been consumed
 					return Z_OK;
 				}
+				if ((res == Z_BUF_ERROR) && (m_Stream.avail_out > 0))
+				{
+					// No progress possible even with output space available
+					return res;
+				}
 				break;
 			}
-			
+			default:
+			{
+				return res;
+			}
+		}
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cZlibInflater:
+
+cZlibInflater::cZlibInflater(void) :
+	m_IsInitialized(false)
+{
+	memset(&m_Stream, 0, sizeof(m_Stream));
+}
+
+
+
+
+
+cZlibInflater::~cZlibInflater()
+{
+	if (m_IsInitialized)
+	{
+		inflateEnd(&m_Stream);
+	}
+}
+
+
+
+
+
+int cZlibInflater::Inflate(const char * a_Data, size_t a_Length, AString & a_Output)
+{
+	int res = Init();
+	if (res != Z_OK)
+	{
+		return res;
+	}
+	m_Stream.next_in = (Bytef *)a_Data;
+	m_Stream.avail_in = (uInt)a_Length;
+	for (;;)
+	{
+		// Uncompress directly into the output string, growing it as needed:
+		size_t OldSize = a_Output.size();
+		a_Output.resize(OldSize + OUTPUT_STEP);
+		m_Stream.next_out = (Bytef *)&a_Output[OldSize];
+		m_Stream.avail_out = (uInt)OUTPUT_STEP;
+		res = inflate(&m_Stream, Z_NO_FLUSH);
+		a_Output.resize(OldSize + OUTPUT_STEP - m_Stream.avail_out);
+		switch (res)
+		{
 			case Z_STREAM_END:
 			{
-				// Finished uncompressing. Consume the rest of the buffer and return
-				a_Uncompressed.append(Buffer, sizeof(Buffer) - strm.avail_out);
-				inflateEnd(&strm);
 				return Z_OK;
 			}
-			
+			case Z_OK:
+			case Z_BUF_ERROR:
+			{
+				if ((m_Stream.avail_in == 0) && (m_Stream.avail_out > 0))
+				{
+					// All the input has been consumed, even though the stream hasn't ended
+					return Z_OK;
+				}
+				if ((res == Z_BUF_ERROR) && (m_Stream.avail_out > 0))
+				{
+					// No progress possible even with output space available
+					return res;
+				}
+				break;
+			}
 			default:
 			{
-				// An error has occurred, log it and return the error value
-				LOG("%s: inflation failed: %d (\"%s\").", __FUNCTION__, res, strm.msg);
-				inflateEnd(&strm);
 				return res;
 			}
-		}  // switch (res)
-	}  // while (true)
+		}
+	}
+}
+
+
+
+
+
+int cZlibInflater::Inflate(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize)
+{
+	int res = Init();
+	if (res != Z_OK)
+	{
+		return res;
+	}
+	m_Stream.next_in = (Bytef *)a_Data;
+	m_Stream.avail_in = (uInt)a_Length;
+	m_Stream.next_out = (Bytef *)a_Out;
+	m_Stream.avail_out = (uInt)a_OutSize;
+	res = inflate(&m_Stream, Z_FINISH);
+	switch (res)
+	{
+		case Z_STREAM_END:
+		{
+			a_OutSize -= m_Stream.avail_out;
+			return Z_OK;
+		}
+		case Z_OK:
+		case Z_BUF_ERROR:
+		{
+			// Either the output buffer is too small, or the input is incomplete (reported the same as zlib's uncompress() does):
+			return (m_Stream.avail_out == 0) ? Z_BUF_ERROR : Z_DATA_ERROR;
+		}
+		case Z_NEED_DICT:
+		{
+			return Z_DATA_ERROR;
+		}
+		default:
+		{
+			return res;
+		}
+	}
 }
 
 
 
 
+
+int cZlibInflater::Init(void)
+{
+	if (m_IsInitialized)
+	{
+		// Reuse the allocated state:
+		return inflateReset(&m_Stream);
+	}
+	memset(&m_Stream, 0, sizeof(m_Stream));
+	int res = inflateInit(&m_Stream);
+	if (res != Z_OK)
+	{
+		return res;
+	}
+	m_IsInitialized = true;
+	return Z_OK;
+}
+
+
+
+
+
@@ -3,6 +3,8 @@
 
 // Interfaces to the wrapping functions for compression and decompression using AString as their data
 
+#pragma once
+
 #include "zlib/zlib.h"  // Needed for the Z_XXX return values
 
 
@@ -24,4 +26,105 @@ extern int UncompressStringGZIP(const char * a_Data, size_t a_Length, AString &
 /** Uncompresses a_Data into a_Uncompressed using Inflate; returns Z_OK for success or Z_XXX error constants same as zlib */
 extern int InflateString(const char * a_Data, size_t a_Length, AString & a_Uncompressed);
 
+/** Compresses a_Data using ZLIB into the caller-provided buffer a_Out, whose size is given in a_OutSize.
+On success, a_OutSize is set to the compressed size. compressBound(a_Length) bytes are always enough.
+Returns Z_OK for success, Z_BUF_ERROR if the buffer is too small, or other Z_XXX error constants same as zlib */
+extern int CompressBuffer(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize, int a_Factor);
+
+/** Uncompresses the ZLIB data a_Data into the caller-provided buffer a_Out, whose size is given in a_OutSize.
+On success, a_OutSize is set to the uncompressed size.
+Returns Z_OK for success, Z_BUF_ERROR if the buffer is too small, or other Z_XXX error constants same as zlib */
+extern int UncompressBuffer(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize);
+
+/* The ZLIB functions above (all but the GZIP ones) take their compressor or decompressor from a pool, instead of
+allocating the zlib state (about 256 KiB for deflate) for each call. A thread holds a pooled object only for the
+duration of a single call, so the number of objects allocated stays at the number of threads compressing at once. */
+
+
+
+
+
+/** Compresses a stream of data, given in parts, into the zlib format, appending the compressed data to an AString.
+The compressor state is kept between the streams, so that a reused deflater doesn't allocate any memory. */
+class cZlibDeflater
+{
+public:
+	cZlibDeflater(void);
+	~cZlibDeflater();
+
+	/** Starts a new stream compressed with the specified factor; the compressed data is appended to a_Output.
+	a_Output needs to stay valid until End() is called. Returns Z_OK on success, or a Z_XXX error constant. */
+	int Begin(int a_Factor, AString & a_Output);
+
+	/** Compresses the next part of the stream. Returns Z_OK on success, or a Z_XXX error constant. */
+	int Write(const char * a_Data, size_t a_Length);
+
+	/** Finishes the stream, writing all the remaining compressed data into the output. Returns Z_OK on success, or a Z_XXX error constant. */
+	int End(void);
+
+	/** Compresses a_Data as a whole stream into the caller-provided buffer a_Out, whose size is given in a_OutSize.
+	On success, a_OutSize is set to the compressed size. Returns Z_OK on success, Z_BUF_ERROR if the buffer is too small,
+	or another Z_XXX error constant. Must not be called between Begin() and End(). */
+	int Compress(int a_Factor, const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize);
+
+protected:
+	/** The amount by which the output grows while compressing. */
+	static const size_t OUTPUT_STEP = 16 * 1024;
+
+	z_stream m_Stream;
+
+	/** Set once m_Stream has been initialized by deflateInit(). */
+	bool m_IsInitialized;
+
+	/** The compression factor that m_Stream was initialized with. */
+	int m_Factor;
+
+	/** The string receiving the compressed data of the current stream. */
+	AString * m_Output;
+
+	/** Prepares m_Stream for a new stream with the specified factor.
+	The allocated state is reused, only the parameters are changed if the factor differs. */
+	int Init(int a_Factor);
+
+	/** Runs deflate() with the specified flush mode until it consumes all the input (and finishes the stream, for Z_FINISH). */
+	int Deflate(int a_Flush);
+} ;
+
+
+
+
+
+
+/** Uncompresses whole zlib streams. The decompressor state is kept between the streams, so that a reused inflater
+doesn't allocate any memory. */
+class cZlibInflater
+{
+public:
+	cZlibInflater(void);
+	~cZlibInflater();
+
+	/** Uncompresses a_Data, appending the uncompressed data to a_Output. Data missing at the end of the stream is tolerated.
+	Returns Z_OK on success, or a Z_XXX error constant. */
+	int Inflate(const char * a_Data, size_t a_Length, AString & a_Output);
+
+	/** Uncompresses a_Data into the caller-provided buffer a_Out, whose size is given in a_OutSize.
+	On success, a_OutSize is set to the uncompressed size.
+	Returns Z_OK on success, Z_BUF_ERROR if the buffer is too small, or another Z_XXX error constant. */
+	int Inflate(const char * a_Data, size_t a_Length, char * a_Out, size_t & a_OutSize);
+
+protected:
+	/** The amount by which the output grows while uncompressing into an AString. */
+	static const size_t OUTPUT_STEP = 64 * 1024;
+
+	z_stream m_Stream;
+
+	/** Set once m_Stream has been initialized by inflateInit(). */
+	bool m_IsInitialized;
+
+	/** Prepares m_Stream for a new stream, reusing the allocated state. */
+	int Init(void);
+} ;
+
+
+
 
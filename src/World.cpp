@@ -12,6 +12,7 @@
 #include "ChunkMap.h"
 #include "Generating/ChunkDesc.h"
 #include "SetChunkData.h"
+#include "Pregenerator.h"
 
 // Serializers
 #include "WorldStorage/ScoreboardSerializer.h"
@@ -36,6 +37,7 @@
 #include "Simulator/NoopRedstoneSimulator.h"
 #include "Simulator/SandSimulator.h"
 #include "Simulator/IncrementalRedstoneSimulator.h"
+#include "Simulator/GraphRedstoneSimulator.h"
 #include "Simulator/VanillaFluidSimulator.h"
 #include "Simulator/VaporizeFluidSimulator.h"
 
@@ -281,6 +283,7 @@ cWorld::cWorld(const AString & a_WorldName, eDimension a_Dimension, const AStrin
 	m_LastTimeUpdate(0),
 	m_LastUnload(0),
 	m_LastSave(0),
+	m_AutoSaveInterval(300),
 	m_SkyDarkness(0),
 	m_GameMode(gmNotSet),
 	m_bEnabledPVP(false),
@@ -293,6 +296,11 @@ cWorld::cWorld(const AString & a_WorldName, eDimension a_Dimension, const AStrin
 	m_LavaSimulator(nullptr),
 	m_FireSimulator(),
 	m_RedstoneSimulator(nullptr),
+	m_PathFinder(*this),
+	m_EntityActivationRange(0),
+	m_BlockEntityActivationRange(0),
+	m_InactiveEntityTickInterval(20),
+	m_InactiveBlockEntityTickInterval(20),
 	m_MaxPlayers(10),
 	m_ChunkMap(),
 	m_bAnimals(true),
@@ -318,6 +326,7 @@ cWorld::cWorld(const AString & a_WorldName, eDimension a_Dimension, const AStrin
 	m_Scoreboard(this),
 	m_MapManager(this),
 	m_GeneratorCallbacks(*this),
+	m_ChunkDataCache(0),
 	m_TickThread(*this)
 {
 	LOGD("cWorld::cWorld(\"%s\")", a_WorldName.c_str());
@@ -466,10 +475,24 @@ void cWorld::InitializeSpawn(void)
 	cIniFile IniFile;
 	IniFile.ReadFile(m_IniFileName);
 	int ViewDist = IniFile.GetValueSetI("SpawnPosition", "PregenerateDistance", DefaultViewDist);
+
+	// Read the pregeneration requested in the config. The request is consumed, so that it doesn't run again upon the next start:
+	int PregenerateRadius = IniFile.GetValueSetI("Pregeneration", "Radius", 0);
+	int PregenerateCenterX = IniFile.GetValueSetI("Pregeneration", "CenterChunkX", ChunkX);
+	int PregenerateCenterZ = IniFile.GetValueSetI("Pregeneration", "CenterChunkZ", ChunkZ);
+	if (PregenerateRadius > 0)
+	{
+		IniFile.SetValueI("Pregeneration", "Radius", 0);
+	}
 	IniFile.WriteFile(m_IniFileName);
 
 	cSpawnPrepare prep(*this, ChunkX, ChunkZ, ViewDist);
 	prep.Wait();
+
+	if (PregenerateRadius > 0)
+	{
+		StartPregeneration(PregenerateCenterX, PregenerateCenterZ, PregenerateRadius);
+	}
 	
 	#ifdef TEST_LINEBLOCKTRACER
 	// DEBUG: Test out the cLineBlockTracer class by tracing a few lines:
@@ -577,6 +600,13 @@ void cWorld::Start(void)
 
 	m_StorageSchema               = IniFile.GetValueSet ("Storage",       "Schema",                      m_StorageSchema);
 	m_StorageCompressionFactor    = IniFile.GetValueSetI("Storage",       "CompressionFactor",           m_StorageCompressionFactor);
+	int NumStorageThreads         = IniFile.GetValueSetI("Storage",       "NumThreads",                  2);
+	bool ShouldCompactStorage     = IniFile.GetValueSetB("Storage",       "CompactOnStartup",            false);
+	int JournalSyncInterval       = IniFile.GetValueSetI("Storage",       "JournalSyncInterval",         1000);
+	m_AutoSaveInterval            = IniFile.GetValueSetI("Storage",       "AutoSaveInterval",            300);
+	int NumLightingThreads        = IniFile.GetValueSetI("Lighting",      "NumThreads",                  2);
+	int NumTickThreads            = IniFile.GetValueSetI("Ticking",       "NumThreads",                  1);
+	int ChunkDataCacheSize        = IniFile.GetValueSetI("Network",       "ChunkDataCacheSize",          1024);
 	m_MaxCactusHeight             = IniFile.GetValueSetI("Plants",        "MaxCactusHeight",             3);
 	m_MaxSugarcaneHeight          = IniFile.GetValueSetI("Plants",        "MaxSugarcaneHeight",          3);
 	m_IsCactusBonemealable        = IniFile.GetValueSetB("Plants",        "IsCactusBonemealable",        false);
@@ -600,6 +630,12 @@ void cWorld::Start(void)
 	m_IsDaylightCycleEnabled      = IniFile.GetValueSetB("General",       "IsDaylightCycleEnabled",      true);
 	int GameMode                  = IniFile.GetValueSetI("General",       "Gamemode",                    (int)m_GameMode);
 	int Weather                   = IniFile.GetValueSetI("General",       "Weather",                     (int)m_Weather);
+
+	// Entities and block entities far from all players may be ticked at a reduced rate; disabled unless the admin sets the ranges (48 and 64 are sensible values):
+	m_EntityActivationRange         = IniFile.GetValueSetI("ActivationRange", "Entities",                        m_EntityActivationRange);
+	m_BlockEntityActivationRange    = IniFile.GetValueSetI("ActivationRange", "BlockEntities",                   m_BlockEntityActivationRange);
+	int InactiveEntityInterval      = IniFile.GetValueSetI("ActivationRange", "InactiveEntityTickInterval",      m_InactiveEntityTickInterval);
+	int InactiveBlockEntityInterval = IniFile.GetValueSetI("ActivationRange", "InactiveBlockEntityTickInterval", m_InactiveBlockEntityTickInterval);
 	
 	if (GetDimension() == dimOverworld)
 	{
@@ -615,12 +651,15 @@ void cWorld::Start(void)
 	m_GameMode         = (eGameMode)     Clamp(GameMode,         (int)gmSurvival, (int)gmSpectator);
 	m_TNTShrapnelLevel = (eShrapnelLevel)Clamp(TNTShrapnelLevel, (int)slNone,     (int)slAll);
 	m_Weather          = (eWeather)      Clamp(Weather,          (int)wSunny,     (int)wStorm);
+	m_InactiveEntityTickInterval      = std::max(InactiveEntityInterval,      1);
+	m_InactiveBlockEntityTickInterval = std::max(InactiveBlockEntityInterval, 1);
 
 	InitialiseGeneratorDefaults(IniFile);
 	InitialiseAndLoadMobSpawningValues(IniFile);
 	SetTimeOfDay(IniFile.GetValueSetI("General", "TimeInTicks", m_TimeOfDay));
 
 	m_ChunkMap = make_unique<cChunkMap>(this);
+	m_ChunkMap->StartTickThreads(NumTickThreads);
 	
 	// preallocate some memory for ticking blocks so we don't need to allocate that often
 	m_BlockTickQueue.reserve(1000);
@@ -638,8 +677,9 @@ void cWorld::Start(void)
 	m_SimulatorManager->RegisterSimulator(m_SandSimulator.get(), 1);
 	m_SimulatorManager->RegisterSimulator(m_FireSimulator.get(), 1);
 
-	m_Lighting.Start(this);
-	m_Storage.Start(this, m_StorageSchema, m_StorageCompressionFactor);
+	m_Lighting.Start(this, NumLightingThreads);
+	m_ChunkDataCache.SetMaxNumChunks(static_cast<size_t>(std::max(ChunkDataCacheSize, 0)));
+	m_Storage.Start(this, m_StorageSchema, m_StorageCompressionFactor, NumStorageThreads, ShouldCompactStorage, JournalSyncInterval);
 	m_Generator.Start(m_GeneratorCallbacks, m_GeneratorCallbacks, IniFile);
 	m_ChunkSender.Start(this);
 	m_TickThread.Start();
@@ -842,7 +882,11 @@ void cWorld::Stop(void)
 		IniFile.SetValueI("General", "TimeInTicks", m_TimeOfDay);
 	IniFile.WriteFile(m_IniFileName);
 	
+	// The pregenerator waits for its queued chunks, so it needs to be stopped while the lighting and generator threads still run:
+	StopPregeneration();
+
 	m_TickThread.Stop();
+	m_ChunkMap->StopTickThreads();
 	m_Lighting.Stop();
 	m_Generator.Stop();
 	m_ChunkSender.Stop();
@@ -910,9 +954,12 @@ void cWorld::Tick(float a_Dt, int a_LastTickDurationMSec)
 	// Add players waiting in the queue to be added:
 	AddQueuedPlayers();
 
+	UpdateActivationPositions();
 	m_ChunkMap->Tick(a_Dt);
+	m_PathFinder.Tick();
 
 	TickClients(a_Dt);
+	UpdateChunkScheduler();
 	TickQueuedBlocks();
 	TickQueuedTasks();
 	TickScheduledTasks();
@@ -923,7 +970,7 @@ void cWorld::Tick(float a_Dt, int a_LastTickDurationMSec)
 
 	m_ChunkMap->FastSetQueuedBlocks();
 
-	if (m_WorldAge - m_LastSave > 60 * 5 * 20)  // Save each 5 minutes
+	if (m_WorldAge - m_LastSave > m_AutoSaveInterval * 20)
 	{
 		SaveAllChunks();
 	}
@@ -1140,6 +1187,76 @@ void cWorld::TickClients(float a_Dt)
 
 
 
+void cWorld::UpdateChunkScheduler(void)
+{
+	cChunkScheduler::cPlayers Players;
+	{
+		cCSLock Lock(m_CSPlayers);
+		Players.reserve(m_Players.size());
+		for (cPlayerList::const_iterator itr = m_Players.begin(), end = m_Players.end(); itr != end; ++itr)
+		{
+			cClientHandle * Client = (*itr)->GetClientHandle();
+			if (Client == nullptr)
+			{
+				continue;
+			}
+			Players.push_back(cChunkScheduler::sPlayer((*itr)->GetUniqueID(), (*itr)->GetChunkX(), (*itr)->GetChunkZ(), Client->GetViewDistance()));
+		}
+	}
+	m_ChunkScheduler.SetPlayers(Players);
+}
+
+
+
+
+
+void cWorld::UpdateActivationPositions(void)
+{
+	m_ActivationPositions.clear();
+	if ((m_EntityActivationRange <= 0) && (m_BlockEntityActivationRange <= 0))
+	{
+		return;
+	}
+	cCSLock Lock(m_CSPlayers);
+	for (cPlayerList::const_iterator itr = m_Players.begin(), end = m_Players.end(); itr != end; ++itr)
+	{
+		m_ActivationPositions.push_back((*itr)->GetPosition());
+	}
+}
+
+
+
+
+
+bool cWorld::IsChunkInActivationRange(int a_ChunkX, int a_ChunkZ, int a_Range) const
+{
+	if (a_Range <= 0)
+	{
+		return true;
+	}
+
+	// Compare against the distance to the nearest point of the chunk:
+	double MinX = a_ChunkX * cChunkDef::Width;
+	double MinZ = a_ChunkZ * cChunkDef::Width;
+	double MaxX = MinX + cChunkDef::Width;
+	double MaxZ = MinZ + cChunkDef::Width;
+	double RangeSq = static_cast<double>(a_Range) * a_Range;
+	for (std::vector<Vector3d>::const_iterator itr = m_ActivationPositions.begin(), end = m_ActivationPositions.end(); itr != end; ++itr)
+	{
+		double DistX = std::max(std::max(MinX - itr->x, itr->x - MaxX), 0.0);
+		double DistZ = std::max(std::max(MinZ - itr->z, itr->z - MaxZ), 0.0);
+		if (DistX * DistX + DistZ * DistZ <= RangeSq)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
 void cWorld::UpdateSkyDarkness(void)
 {
 	int TempTime = (int)m_TimeOfDay;
@@ -1184,6 +1301,15 @@ void cWorld::WakeUpSimulatorsInArea(int a_MinBlockX, int a_MaxBlockX, int a_MinB
 
 
 
+void cWorld::WakeUpHoppersAround(int a_BlockX, int a_BlockY, int a_BlockZ)
+{
+	m_ChunkMap->WakeUpHoppersAround(a_BlockX, a_BlockY, a_BlockZ);
+}
+
+
+
+
+
 bool cWorld::ForEachBlockEntityInChunk(int a_ChunkX, int a_ChunkZ, cBlockEntityCallback & a_Callback)
 {
 	return m_ChunkMap->ForEachBlockEntityInChunk(a_ChunkX, a_ChunkZ, a_Callback);
@@ -2947,6 +3073,15 @@ void cWorld::ChunkLoadFailed(int a_ChunkX, int a_ChunkZ)
 
 
 
+bool cWorld::TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ)
+{
+	return m_ChunkMap->TryUnqueueUnwantedChunk(a_ChunkX, a_ChunkZ);
+}
+
+
+
+
+
 bool cWorld::SetSignLines(int a_BlockX, int a_BlockY, int a_BlockZ, const AString & a_Line1, const AString & a_Line2, const AString & a_Line3, const AString & a_Line4, cPlayer * a_Player)
 {
 	AString Line1(a_Line1);
@@ -3101,6 +3236,52 @@ void cWorld::QueueSaveAllChunks(void)
 
 
 
+bool cWorld::StartPregeneration(int a_CenterChunkX, int a_CenterChunkZ, int a_Radius)
+{
+	cCSLock Lock(m_CSPregenerator);
+	if ((m_Pregenerator != nullptr) && !m_Pregenerator->IsFinished())
+	{
+		return false;
+	}
+	m_Pregenerator = make_unique<cPregenerator>(*this, a_CenterChunkX, a_CenterChunkZ, a_Radius);
+	m_Pregenerator->Start();
+	return true;
+}
+
+
+
+
+
+bool cWorld::StopPregeneration(void)
+{
+	cCSLock Lock(m_CSPregenerator);
+	if (m_Pregenerator == nullptr)
+	{
+		return false;
+	}
+	bool WasRunning = !m_Pregenerator->IsFinished();
+	m_Pregenerator.reset();
+	return WasRunning;
+}
+
+
+
+
+
+AString cWorld::GetPregenerationStatus(void)
+{
+	cCSLock Lock(m_CSPregenerator);
+	if ((m_Pregenerator == nullptr) || m_Pregenerator->IsFinished())
+	{
+		return "";
+	}
+	return m_Pregenerator->GetStatus();
+}
+
+
+
+
+
 void cWorld::QueueTask(std::unique_ptr<cTask> a_Task)
 {
 	cCSLock Lock(m_CSTasks);
@@ -3410,6 +3591,10 @@ cRedstoneSimulator * cWorld::InitializeRedstoneSimulator(cIniFile & a_IniFile)
 	{
 		res = new cIncrementalRedstoneSimulator(*this);
 	}
+	else if (NoCaseCompare(SimulatorName, "Graph") == 0)
+	{
+		res = new cGraphRedstoneSimulator(*this);
+	}
 	else if (NoCaseCompare(SimulatorName, "noop") == 0)
 	{
 		res = new cRedstoneNoopSimulator(*this);
@@ -3669,9 +3854,18 @@ bool cWorld::cChunkGeneratorCallbacks::IsChunkQueued(int a_ChunkX, int a_ChunkZ)
 
 
 
-bool cWorld::cChunkGeneratorCallbacks::HasChunkAnyClients(int a_ChunkX, int a_ChunkZ)
+void cWorld::cChunkGeneratorCallbacks::GetSchedulerSnapshot(cChunkScheduler::cSnapshot & a_Snapshot)
+{
+	m_World->m_ChunkScheduler.GetSnapshot(a_Snapshot);
+}
+
+
+
+
+
+bool cWorld::cChunkGeneratorCallbacks::TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ)
 {
-	return m_World->HasChunkAnyClients(a_ChunkX, a_ChunkZ);
+	return m_World->TryUnqueueUnwantedChunk(a_ChunkX, a_ChunkZ);
 }
 
 
@@ -11,10 +11,12 @@
 
 #include "Simulator/SimulatorManager.h"
 #include "ChunkMap.h"
+#include "ChunkScheduler.h"
 #include "WorldStorage/WorldStorage.h"
 #include "Generating/ChunkGenerator.h"
 #include "Vector3.h"
 #include "ChunkSender.h"
+#include "Protocol/ChunkDataSerializer.h"
 #include "Defines.h"
 #include "LightingThread.h"
 #include "Item.h"
@@ -52,6 +54,7 @@ class cMobHeadEntity;
 class cCompositeChat;
 class cCuboid;
 class cSetChunkData;
+class cPregenerator;
 
 
 typedef std::list< cPlayer * > cPlayerList;
@@ -372,7 +375,8 @@ public:
 	/** Removes client from ChunkSender's queue of chunks to be sent */
 	void RemoveClientFromChunkSender(cClientHandle * a_Client);
 	
-	/** Touches the chunk, causing it to be loaded or generated */
+	/** Touches the chunk, causing it to be loaded or generated.
+	The request is processed after the chunks that the players want, but it is never dropped. */
 	void TouchChunk(int a_ChunkX, int a_ChunkZ);
 
 	/** Queues the chunk for preparing - making sure that it's generated and lit.
@@ -384,6 +388,10 @@ public:
 	/** Marks the chunk as failed-to-load: */
 	void ChunkLoadFailed(int a_ChunkX, int a_ChunkZ);
 	
+	/** Marks the chunk as invalid if it is queued, but no client or ChunkStay wants it anymore.
+	Returns true if the chunk's queued load / generate request should be dropped. */
+	bool TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ);
+	
 	/** Sets the sign text, asking plugins for permission first. a_Player is the player who this change belongs to, may be nullptr. Returns true if sign text changed. */
 	bool SetSignLines(int a_BlockX, int a_BlockY, int a_BlockZ, const AString & a_Line1, const AString & a_Line2, const AString & a_Line3, const AString & a_Line4, cPlayer * a_Player = nullptr);  // Exported in ManualBindings.cpp
 
@@ -396,10 +404,10 @@ public:
 	/** Set the state of a trapdoor. Returns true if the trapdoor was updated, false if there was no trapdoor at those coords. */
 	bool SetTrapdoorOpen(int a_BlockX, int a_BlockY, int a_BlockZ, bool a_Open);                        // tolua_export
 
-	/** Regenerate the given chunk: */
+	/** Regenerate the given chunk. The request is processed after the chunks that the players want, but it is never dropped. */
 	void RegenerateChunk(int a_ChunkX, int a_ChunkZ);  // tolua_export
 	
-	/** Generates the given chunk */
+	/** Generates the given chunk. The request is processed after the chunks that the players want, but it is never dropped. */
 	void GenerateChunk(int a_ChunkX, int a_ChunkZ);  // tolua_export
 	
 	/** Queues a chunk for lighting; a_Callback is called after the chunk is lighted */
@@ -519,6 +527,29 @@ public:
 	// tolua_end
 
 	inline cSimulatorManager * GetSimulatorManager(void) { return m_SimulatorManager.get(); }
+
+	/** Wakes up the hoppers that may move items from or to the container at the specified coords, after its contents changed. */
+	void WakeUpHoppersAround(int a_BlockX, int a_BlockY, int a_BlockZ);
+
+	/** Returns the service that finds the walking paths for the mobs in this world. */
+	cPathFinder & GetPathFinder(void) { return m_PathFinder; }
+
+	/** Returns true if any player is within a_Range blocks, horizontally, of the specified chunk.
+	Always returns true if a_Range is zero or negative (the activation range is disabled).
+	Uses the player positions taken at the start of the current tick, so it's safe to call from the chunk tick threads. */
+	bool IsChunkInActivationRange(int a_ChunkX, int a_ChunkZ, int a_Range) const;
+
+	/** Returns the distance from the players within which the non-mob entities are ticked in each tick. */
+	int GetEntityActivationRange(void) const { return m_EntityActivationRange; }
+
+	/** Returns the distance from the players within which the block entities are ticked in each tick. */
+	int GetBlockEntityActivationRange(void) const { return m_BlockEntityActivationRange; }
+
+	/** Returns the number of ticks between two ticks of a non-mob entity out of the activation range. */
+	int GetInactiveEntityTickInterval(void) const { return m_InactiveEntityTickInterval; }
+
+	/** Returns the maximum number of ticks between two ticks of a block entity out of the activation range. */
+	int GetInactiveBlockEntityTickInterval(void) const { return m_InactiveBlockEntityTickInterval; }
 	
 	inline cFluidSimulator * GetWaterSimulator(void) { return m_WaterSimulator; }
 	inline cFluidSimulator * GetLavaSimulator (void) { return m_LavaSimulator; }
@@ -708,6 +739,18 @@ public:
 	inline size_t GetStorageSaveQueueLength(void) { return m_Storage.GetSaveQueueLength(); }    // tolua_export
 
 	cLightingThread & GetLightingThread(void) { return m_Lighting; }
+	
+	cChunkDataCache & GetChunkDataCache(void) { return m_ChunkDataCache; }
+
+	/** Starts pregenerating (generating, lighting and saving) the square of chunks of the specified radius around the specified center chunk.
+	Returns false if a pregeneration is already running in this world. */
+	bool StartPregeneration(int a_CenterChunkX, int a_CenterChunkZ, int a_Radius);
+
+	/** Stops the running pregeneration, waiting for the chunks already queued. Returns false if there was none running. */
+	bool StopPregeneration(void);
+
+	/** Returns the progress of the running pregeneration, or an empty string if there is none running. */
+	AString GetPregenerationStatus(void);
 
 	void InitializeSpawn(void);
 	
@@ -784,6 +827,7 @@ public:
 
 	cChunkGenerator & GetGenerator(void) { return m_Generator; }
 	cWorldStorage &   GetStorage  (void) { return m_Storage; }
+	cChunkScheduler & GetChunkScheduler(void) { return m_ChunkScheduler; }
 	cChunkMap *       GetChunkMap (void) { return m_ChunkMap.get(); }
 		
 	/** Sets the blockticking to start at the specified block. Only one blocktick per chunk may be set, second call overwrites the first call */
@@ -803,8 +847,12 @@ public:
 	*/
 	int CreateProjectile(double a_PosX, double a_PosY, double a_PosZ, cProjectileEntity::eKind a_Kind, cEntity * a_Creator, const cItem * a_Item, const Vector3d * a_Speed = nullptr);  // tolua_export
 	
-	/** Returns a random number from the m_TickRand in range [0 .. a_Range]. To be used only in the tick thread! */
-	int GetTickRandomNumber(unsigned a_Range) { return (int)(m_TickRand.randInt(a_Range)); }
+	/** Returns a random number from the m_TickRand in range [0 .. a_Range]. To be used only in the tick thread and its chunk tick workers! */
+	int GetTickRandomNumber(unsigned a_Range)
+	{
+		cCSLock Lock(m_CSTickRand);
+		return (int)(m_TickRand.randInt(a_Range));
+	}
 	
 	/** Appends all usernames starting with a_Text (case-insensitive) into Results */
 	void TabCompleteUserName(const AString & a_Text, AStringVector & a_Results);
@@ -848,8 +896,9 @@ private:
 		// cChunkSink overrides:
 		virtual void OnChunkGenerated  (cChunkDesc & a_ChunkDesc) override;
 		virtual bool IsChunkValid      (int a_ChunkX, int a_ChunkZ) override;
-		virtual bool HasChunkAnyClients(int a_ChunkX, int a_ChunkZ) override;
 		virtual bool IsChunkQueued     (int a_ChunkX, int a_ChunkZ) override;
+		virtual void GetSchedulerSnapshot(cChunkScheduler::cSnapshot & a_Snapshot) override;
+		virtual bool TryUnqueueUnwantedChunk(int a_ChunkX, int a_ChunkZ) override;
 		
 		// cPluginInterface overrides:
 		virtual void CallHookChunkGenerating(cChunkDesc & a_ChunkDesc) override;
@@ -905,6 +954,9 @@ private:
 	/** This random generator is to be used only in the Tick() method, and thus only in the World-Tick-thread (MTRand is not exactly thread-safe) */
 	MTRand m_TickRand;
 
+	/** Protects m_TickRand in GetTickRandomNumber(), which the chunk tick workers use concurrently (see cChunkMap::Tick()) */
+	cCriticalSection m_CSTickRand;
+
 	bool m_IsSpawnExplicitlySet;
 	double m_SpawnX;
 	double m_SpawnY;
@@ -921,6 +973,7 @@ private:
 	Int64  m_LastTimeUpdate;    // The tick in which the last time update has been sent.
 	Int64  m_LastUnload;        // The last WorldAge (in ticks) in which unloading was triggerred
 	Int64  m_LastSave;          // The last WorldAge (in ticks) in which save-all was triggerred
+	int    m_AutoSaveInterval;  // The interval between two save-alls, in seconds. The journal keeps the block changes in between safe from crashes
 	std::map<cMonster::eFamily, Int64> m_LastSpawnMonster;  // The last WorldAge (in ticks) in which a monster was spawned (for each megatype of monster)  // MG TODO : find a way to optimize without creating unmaintenability (if mob IDs are becoming unrowed)
 
 	NIBBLETYPE m_SkyDarkness;
@@ -944,6 +997,28 @@ private:
 	cCriticalSection m_CSPlayers;
 	cPlayerList      m_Players;
 
+	/** Prioritizes the chunks in m_Storage's and m_Generator's queues by the distance to the players. */
+	cChunkScheduler m_ChunkScheduler;
+
+	/** Finds the walking paths for the mobs. */
+	cPathFinder m_PathFinder;
+
+	/** Entities further than this many blocks from all players are ticked only once per m_InactiveEntityTickInterval ticks.
+	Zero or negative to tick all entities in each tick (the default). */
+	int m_EntityActivationRange;
+
+	/** Block entities further than this many blocks from all players are ticked only once per m_InactiveBlockEntityTickInterval ticks,
+	or when a block next to them changes, and catch up on the skipped ticks then.
+	Zero or negative to tick all block entities in each tick (the default). */
+	int m_BlockEntityActivationRange;
+
+	int m_InactiveEntityTickInterval;
+	int m_InactiveBlockEntityTickInterval;
+
+	/** The player positions for the activation range checks, taken at the start of each tick.
+	Written only in the tick thread outside of chunk ticking, read by the chunk tick threads. */
+	std::vector<Vector3d> m_ActivationPositions;
+
 	cWorldStorage     m_Storage;
 	
 	unsigned int m_MaxPlayers;
@@ -1000,8 +1075,17 @@ private:
 	cChunkGeneratorCallbacks m_GeneratorCallbacks;
 	
 	cChunkSender     m_ChunkSender;
+	
+	/** The serialized data of the recently sent chunks, shared by all the clients in the world. */
+	cChunkDataCache  m_ChunkDataCache;
 	cLightingThread  m_Lighting;
 	cTickThread      m_TickThread;
+
+	/** Guards m_Pregenerator */
+	cCriticalSection m_CSPregenerator;
+
+	/** The pregeneration running or last run in this world, nullptr if none was started. Guarded by m_CSPregenerator. */
+	std::unique_ptr<cPregenerator> m_Pregenerator;
 	
 	/** Guards the m_Tasks */
 	cCriticalSection m_CSTasks;
@@ -1068,6 +1152,12 @@ private:
 	/** Ticks all clients that are in this world */
 	void TickClients(float a_Dt);
 
+	/** Updates the player positions in m_ChunkScheduler, so that the chunk queues follow the players. */
+	void UpdateChunkScheduler(void);
+
+	/** Takes the player positions into m_ActivationPositions, for the activation range checks in the following tick. */
+	void UpdateActivationPositions(void);
+
 	/** Unloads all chunks immediately.*/
 	void UnloadUnusedChunks(void);
 
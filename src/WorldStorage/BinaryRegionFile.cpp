@@ -0,0 +1,533 @@
+
+// BinaryRegionFile.cpp
+
+// Implements the cBinaryChunk and cBinaryRegionFile classes representing the binary chunk storage format
+
+#include "Globals.h"
+#include "BinaryRegionFile.h"
+#include "zlib/zlib.h"
+
+
+
+
+
+/** Version of the serialized chunk data, stored in each chunk. */
+static const Byte BINARY_CHUNK_VERSION = 1;
+
+/** Version of the region file format, stored in the file header. Includes the version of the compression dictionary. */
+static const UInt32 BINARY_REGION_VERSION = 1;
+
+/** The chunk data in the region file is aligned to this many bytes, leaving some space for the chunk to grow in place. */
+static const long BINARY_REGION_ALIGNMENT = 256;
+
+/** The size of the region file header: the magic, the version and the index. */
+static const long BINARY_REGION_HEADER_SIZE = 8 + 2 * 4 * cBinaryRegionFile::NUM_CHUNKS;
+
+/** The compression level used for the chunk data. The format is optimized for speed, the dictionary makes up for the lower level. */
+static const int BINARY_COMPRESSION_LEVEL = Z_BEST_SPEED;
+
+/** Flags stored in the serialized chunk. */
+static const Byte BINARY_CHUNK_LIGHT_VALID  = 0x01;
+static const Byte BINARY_CHUNK_BIOMES_VALID = 0x02;
+
+/** The preset dictionary used for compressing all chunks.
+Contains the NBT tag names and values that are most common in the entities and block entities,
+the most frequent ones near the end, where they are the cheapest to reference.
+Changing the dictionary makes the existing files unreadable, BINARY_REGION_VERSION needs to be increased when doing so. */
+static const char g_Dictionary[] =
+	"CustomNameVisibleCustomNamePersistenceRequiredCanPickUpLootAgeLeashedDropChancesEquipment"
+	"ActiveEffectsAbsorptionAmountAttackTimeDeathTimeHurtTimeInLoveOwnerSittingCollarColor"
+	"ProfessionRichesCareerCareerLevelWillingTypeSaddleTameVariantArmorBredChestedEatingHaying"
+	"ExplosionRadiusFuseignitedpoweredShearedColorSkeletonTypeIsVillagerIsBabyAngerConversionTime"
+	"TileXTileYTileZDirectionFacingItemRotationItemDropChanceTileIDDataFallHurtMaxFallHurtAmount"
+	"inGroundshakeinTileinDatapickupdamageOwnerUUIDownerUUIDPotion"
+	"BurnTimeCookTimeCookTimeTotalTransferCooldownTextText1Text2Text3Text4SkullTypeRotRecordRecordItem"
+	"EntityIdDelayMinSpawnDelayMaxSpawnDelaySpawnCountSpawnRangeMaxNearbyEntitiesRequiredPlayerRange"
+	"CommandSuccessCountLastOutputLevelsPrimarySecondarynoteLockTrapped"
+	"MinecartMinecartChestMinecartFurnaceMinecartTNTMinecartHopperBoatFallingSandPrimedTntXPOrbValue"
+	"ArrowSnowballEggThrownEnderpearlThrownPotionFireballSmallFireballItemFramePaintingEnderCrystal"
+	"BatBlazeCaveSpiderChickenCowCreeperEnderDragonEndermanGhastGiantGuardianEntityHorseVillagerGolem"
+	"LavaSlimeMushroomCowOzelotPigRabbitSheepSilverfishSkeletonSlimeSnowManSpiderSquidVillagerWitch"
+	"WitherBossWolfZombiePigZombie"
+	"ChestTrapFurnaceHopperDispenserDropperSignMobSpawnerMusicTrapRecordPlayerSkullFlowerPotBeacon"
+	"ControlCommandBlockEnchStorePotionEffectsDisplayNameLoreenchidlvldisplaytagRepairCost"
+	"HealthAirFireOnGroundFallDistanceInvulnerableDimensionPortalCooldownUUIDMostUUIDLeast"
+	"MotionRotationPosItemsSlotCountDamageidTileEntitiesEntities";
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cBinaryChunk:
+
+cBinaryChunk::cBinaryChunk(void)
+{
+	Clear();
+}
+
+
+
+
+
+void cBinaryChunk::Clear(void)
+{
+	memset(m_BlockTypes, 0,    sizeof(m_BlockTypes));
+	memset(m_BlockMetas, 0,    sizeof(m_BlockMetas));
+	memset(m_BlockLight, 0,    sizeof(m_BlockLight));
+	memset(m_SkyLight,   0xff, sizeof(m_SkyLight));
+	memset(m_Biomes,     0,    sizeof(m_Biomes));
+	m_IsLightValid = false;
+	m_AreBiomesValid = false;
+	m_EntitiesNBT.clear();
+}
+
+
+
+
+
+bool cBinaryChunk::IsSectionEmpty(size_t a_Section) const
+{
+	const Byte * BlockTypes = m_BlockTypes + a_Section * SECTION_NUM_BLOCKS;
+	for (size_t i = 0; i < SECTION_NUM_BLOCKS; i++)
+	{
+		if (BlockTypes[i] != 0)
+		{
+			return false;
+		}
+	}
+	size_t NibbleStart = a_Section * SECTION_NUM_BLOCKS / 2;
+	for (size_t i = NibbleStart; i < NibbleStart + SECTION_NUM_BLOCKS / 2; i++)
+	{
+		if ((m_BlockMetas[i] != 0) || (m_IsLightValid && ((m_BlockLight[i] != 0) || (m_SkyLight[i] != 0xff))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+void cBinaryChunk::Serialize(AString & a_Data) const
+{
+	UInt16 SectionMask = 0;
+	for (size_t i = 0; i < NUM_SECTIONS; i++)
+	{
+		if (!IsSectionEmpty(i))
+		{
+			SectionMask |= static_cast<UInt16>(1 << i);
+		}
+	}
+
+	a_Data.clear();
+	a_Data.reserve(4 + NUM_COLUMNS + NUM_BLOCKS * 5 / 2 + m_EntitiesNBT.size());
+	a_Data.push_back(static_cast<char>(BINARY_CHUNK_VERSION));
+	a_Data.push_back(static_cast<char>((m_IsLightValid ? BINARY_CHUNK_LIGHT_VALID : 0) | (m_AreBiomesValid ? BINARY_CHUNK_BIOMES_VALID : 0)));
+	a_Data.push_back(static_cast<char>(SectionMask >> 8));
+	a_Data.push_back(static_cast<char>(SectionMask & 0xff));
+	if (m_AreBiomesValid)
+	{
+		a_Data.append(reinterpret_cast<const char *>(m_Biomes), sizeof(m_Biomes));
+	}
+	for (size_t i = 0; i < NUM_SECTIONS; i++)
+	{
+		if ((SectionMask & (1 << i)) == 0)
+		{
+			continue;
+		}
+		a_Data.append(reinterpret_cast<const char *>(m_BlockTypes) + i * SECTION_NUM_BLOCKS,     SECTION_NUM_BLOCKS);
+		a_Data.append(reinterpret_cast<const char *>(m_BlockMetas) + i * SECTION_NUM_BLOCKS / 2, SECTION_NUM_BLOCKS / 2);
+		if (m_IsLightValid)
+		{
+			a_Data.append(reinterpret_cast<const char *>(m_BlockLight) + i * SECTION_NUM_BLOCKS / 2, SECTION_NUM_BLOCKS / 2);
+			a_Data.append(reinterpret_cast<const char *>(m_SkyLight)   + i * SECTION_NUM_BLOCKS / 2, SECTION_NUM_BLOCKS / 2);
+		}
+	}
+	a_Data.append(m_EntitiesNBT);
+}
+
+
+
+
+
+bool cBinaryChunk::Parse(const char * a_Data, size_t a_Size)
+{
+	Clear();
+	if ((a_Size < 4) || (static_cast<Byte>(a_Data[0]) != BINARY_CHUNK_VERSION))
+	{
+		return false;
+	}
+	Byte Flags = static_cast<Byte>(a_Data[1]);
+	UInt16 SectionMask = static_cast<UInt16>((static_cast<Byte>(a_Data[2]) << 8) | static_cast<Byte>(a_Data[3]));
+	m_IsLightValid   = ((Flags & BINARY_CHUNK_LIGHT_VALID) != 0);
+	m_AreBiomesValid = ((Flags & BINARY_CHUNK_BIOMES_VALID) != 0);
+	size_t Pos = 4;
+
+	if (m_AreBiomesValid)
+	{
+		if (a_Size < Pos + sizeof(m_Biomes))
+		{
+			return false;
+		}
+		memcpy(m_Biomes, a_Data + Pos, sizeof(m_Biomes));
+		Pos += sizeof(m_Biomes);
+	}
+
+	size_t SectionSize = SECTION_NUM_BLOCKS * (m_IsLightValid ? 5 : 3) / 2;
+	for (size_t i = 0; i < NUM_SECTIONS; i++)
+	{
+		if ((SectionMask & (1 << i)) == 0)
+		{
+			continue;
+		}
+		if (a_Size < Pos + SectionSize)
+		{
+			return false;
+		}
+		memcpy(m_BlockTypes + i * SECTION_NUM_BLOCKS, a_Data + Pos, SECTION_NUM_BLOCKS);
+		Pos += SECTION_NUM_BLOCKS;
+		memcpy(m_BlockMetas + i * SECTION_NUM_BLOCKS / 2, a_Data + Pos, SECTION_NUM_BLOCKS / 2);
+		Pos += SECTION_NUM_BLOCKS / 2;
+		if (m_IsLightValid)
+		{
+			memcpy(m_BlockLight + i * SECTION_NUM_BLOCKS / 2, a_Data + Pos, SECTION_NUM_BLOCKS / 2);
+			Pos += SECTION_NUM_BLOCKS / 2;
+			memcpy(m_SkyLight + i * SECTION_NUM_BLOCKS / 2, a_Data + Pos, SECTION_NUM_BLOCKS / 2);
+			Pos += SECTION_NUM_BLOCKS / 2;
+		}
+	}
+
+	m_EntitiesNBT.assign(a_Data + Pos, a_Size - Pos);
+	return true;
+}
+
+
+
+
+
+bool cBinaryChunk::Compress(const AString & a_Data, AString & a_Compressed)
+{
+	z_stream Stream;
+	memset(&Stream, 0, sizeof(Stream));
+	if (deflateInit(&Stream, BINARY_COMPRESSION_LEVEL) != Z_OK)
+	{
+		return false;
+	}
+	if (deflateSetDictionary(&Stream, reinterpret_cast<const Bytef *>(g_Dictionary), sizeof(g_Dictionary) - 1) != Z_OK)
+	{
+		deflateEnd(&Stream);
+		return false;
+	}
+	a_Compressed.resize(deflateBound(&Stream, static_cast<uLong>(a_Data.size())));
+	Stream.next_in   = reinterpret_cast<Bytef *>(const_cast<char *>(a_Data.data()));
+	Stream.avail_in  = static_cast<uInt>(a_Data.size());
+	Stream.next_out  = reinterpret_cast<Bytef *>(&a_Compressed[0]);
+	Stream.avail_out = static_cast<uInt>(a_Compressed.size());
+	int res = deflate(&Stream, Z_FINISH);
+	a_Compressed.resize(Stream.total_out);
+	deflateEnd(&Stream);
+	return (res == Z_STREAM_END);
+}
+
+
+
+
+
+bool cBinaryChunk::Uncompress(const char * a_Compressed, size_t a_Size, AString & a_Data)
+{
+	z_stream Stream;
+	memset(&Stream, 0, sizeof(Stream));
+	if (inflateInit(&Stream) != Z_OK)
+	{
+		return false;
+	}
+	Stream.next_in  = reinterpret_cast<Bytef *>(const_cast<char *>(a_Compressed));
+	Stream.avail_in = static_cast<uInt>(a_Size);
+
+	// Most chunks uncompress to less than this, so usually there's no reallocation:
+	a_Data.resize(64 KiB);
+	for (;;)
+	{
+		Stream.next_out  = reinterpret_cast<Bytef *>(&a_Data[Stream.total_out]);
+		Stream.avail_out = static_cast<uInt>(a_Data.size() - Stream.total_out);
+		int res = inflate(&Stream, Z_NO_FLUSH);
+		if (res == Z_NEED_DICT)
+		{
+			res = inflateSetDictionary(&Stream, reinterpret_cast<const Bytef *>(g_Dictionary), sizeof(g_Dictionary) - 1);
+		}
+		if (res == Z_STREAM_END)
+		{
+			break;
+		}
+		if ((res != Z_OK) && (res != Z_BUF_ERROR))
+		{
+			inflateEnd(&Stream);
+			return false;
+		}
+		if (Stream.avail_out == 0)
+		{
+			a_Data.resize(a_Data.size() * 2);
+		}
+		else if (Stream.avail_in == 0)
+		{
+			// The data is truncated
+			inflateEnd(&Stream);
+			return false;
+		}
+	}
+	a_Data.resize(Stream.total_out);
+	inflateEnd(&Stream);
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cBinaryRegionFile:
+
+cBinaryRegionFile::cBinaryRegionFile(const AString & a_FileName, int a_RegionX, int a_RegionZ) :
+	m_RegionX(a_RegionX),
+	m_RegionZ(a_RegionZ),
+	m_FileName(a_FileName),
+	m_FileSize(0)
+{
+	memset(m_Index, 0, sizeof(m_Index));
+}
+
+
+
+
+
+bool cBinaryRegionFile::OpenFile(bool a_IsForReading)
+{
+	if (m_File.IsOpen())
+	{
+		return true;
+	}
+	if (a_IsForReading && !cFile::Exists(m_FileName))
+	{
+		return false;
+	}
+	if (!m_File.Open(m_FileName, cFile::fmReadWrite))
+	{
+		return false;
+	}
+
+	char Magic[4];
+	UInt32 Version;
+	if (
+		(m_File.Read(Magic, sizeof(Magic)) == sizeof(Magic)) &&
+		(m_File.Read(&Version, sizeof(Version)) == sizeof(Version)) &&
+		(m_File.Read(m_Index, sizeof(m_Index)) == sizeof(m_Index))
+	)
+	{
+		if ((memcmp(Magic, "MCSB", 4) != 0) || (ntohl(Version) != BINARY_REGION_VERSION))
+		{
+			// Not our file, or a newer version; don't touch it
+			m_File.Close();
+			return false;
+		}
+		m_FileSize = m_File.GetSize();
+		return true;
+	}
+
+	// The file has just been created, write an empty header:
+	memset(m_Index, 0, sizeof(m_Index));
+	m_FileSize = BINARY_REGION_HEADER_SIZE;
+	if (!WriteHeader())
+	{
+		m_File.Close();
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+bool cBinaryRegionFile::WriteHeader(void)
+{
+	UInt32 Version = htonl(BINARY_REGION_VERSION);
+	if (
+		(m_File.Seek(0) < 0) ||
+		(m_File.Write("MCSB", 4) != 4) ||
+		(m_File.Write(&Version, sizeof(Version)) != sizeof(Version)) ||
+		(m_File.Write(m_Index, sizeof(m_Index)) != sizeof(m_Index))
+	)
+	{
+		return false;
+	}
+	m_File.Flush();
+	return true;
+}
+
+
+
+
+
+bool cBinaryRegionFile::GetChunkData(int a_LocalX, int a_LocalZ, AString & a_Compressed)
+{
+	cCSLock Lock(m_CS);
+	if (!OpenFile(true))
+	{
+		return false;
+	}
+	int Idx = a_LocalX + 32 * a_LocalZ;
+	UInt32 Offset = ntohl(m_Index[2 * Idx]);
+	UInt32 Size   = ntohl(m_Index[2 * Idx + 1]);
+	if ((Offset < static_cast<UInt32>(BINARY_REGION_HEADER_SIZE)) || (Size == 0))
+	{
+		return false;
+	}
+	a_Compressed.resize(Size);
+	return (
+		(m_File.Seek(static_cast<int>(Offset)) >= 0) &&
+		(m_File.Read(&a_Compressed[0], Size) == static_cast<int>(Size))
+	);
+}
+
+
+
+
+
+void cBinaryRegionFile::SetChunksData(const std::vector<int> & a_Chunks, const AStringVector & a_Compressed, std::vector<bool> & a_IsSaved)
+{
+	ASSERT(a_Chunks.size() == a_Compressed.size());
+	a_IsSaved.assign(a_Chunks.size(), false);
+
+	cCSLock Lock(m_CS);
+	if (!OpenFile(false))
+	{
+		return;
+	}
+
+	bool HasWritten = false;
+	for (size_t i = 0; i < a_Chunks.size(); i++)
+	{
+		const AString & Data = a_Compressed[i];
+		if (Data.empty())
+		{
+			continue;
+		}
+		int Idx = a_Chunks[i];
+		ASSERT((Idx >= 0) && (Idx < NUM_CHUNKS));
+
+		// Reuse the current location if the data fits into its aligned space, otherwise append to the end of the file:
+		long Offset = static_cast<long>(ntohl(m_Index[2 * Idx]));
+		long OldSize = static_cast<long>(ntohl(m_Index[2 * Idx + 1]));
+		long Capacity = (OldSize + BINARY_REGION_ALIGNMENT - 1) / BINARY_REGION_ALIGNMENT * BINARY_REGION_ALIGNMENT;
+		if ((Offset < BINARY_REGION_HEADER_SIZE) || (static_cast<long>(Data.size()) > Capacity))
+		{
+			Offset = (m_FileSize + BINARY_REGION_ALIGNMENT - 1) / BINARY_REGION_ALIGNMENT * BINARY_REGION_ALIGNMENT;
+		}
+		if (
+			(m_File.Seek(static_cast<int>(Offset)) < 0) ||
+			(m_File.Write(Data.data(), Data.size()) != static_cast<int>(Data.size()))
+		)
+		{
+			continue;
+		}
+		m_FileSize = std::max(m_FileSize, Offset + static_cast<long>(Data.size()));
+		m_Index[2 * Idx]     = htonl(static_cast<UInt32>(Offset));
+		m_Index[2 * Idx + 1] = htonl(static_cast<UInt32>(Data.size()));
+		a_IsSaved[i] = true;
+		HasWritten = true;
+	}
+
+	if (HasWritten && !WriteHeader())
+	{
+		a_IsSaved.assign(a_Chunks.size(), false);
+	}
+}
+
+
+
+
+
+bool cBinaryRegionFile::Compact(long & a_SizeBefore, long & a_SizeAfter)
+{
+	cCSLock Lock(m_CS);
+	if (!OpenFile(true))
+	{
+		return false;
+	}
+	a_SizeBefore = m_FileSize;
+
+	// Copy the chunks into a new file, one after another:
+	AString TempFileName = m_FileName + ".compact";
+	cFile TempFile;
+	if (!TempFile.Open(TempFileName, cFile::fmWrite))
+	{
+		return false;
+	}
+	UInt32 NewIndex[2 * NUM_CHUNKS];
+	memset(NewIndex, 0, sizeof(NewIndex));
+	long NextOffset = BINARY_REGION_HEADER_SIZE;
+	AString Data;
+	bool IsSuccess = true;
+	for (int Idx = 0; Idx < NUM_CHUNKS; Idx++)
+	{
+		UInt32 Offset = ntohl(m_Index[2 * Idx]);
+		UInt32 Size   = ntohl(m_Index[2 * Idx + 1]);
+		if ((Offset < static_cast<UInt32>(BINARY_REGION_HEADER_SIZE)) || (Size == 0))
+		{
+			continue;
+		}
+		NextOffset = (NextOffset + BINARY_REGION_ALIGNMENT - 1) / BINARY_REGION_ALIGNMENT * BINARY_REGION_ALIGNMENT;
+		Data.resize(Size);
+		if (
+			(m_File.Seek(static_cast<int>(Offset)) < 0) ||
+			(m_File.Read(&Data[0], Size) != static_cast<int>(Size)) ||
+			(TempFile.Seek(static_cast<int>(NextOffset)) < 0) ||
+			(TempFile.Write(Data.data(), Size) != static_cast<int>(Size))
+		)
+		{
+			IsSuccess = false;
+			break;
+		}
+		NewIndex[2 * Idx]     = htonl(static_cast<UInt32>(NextOffset));
+		NewIndex[2 * Idx + 1] = htonl(Size);
+		NextOffset += static_cast<long>(Size);
+	}  // for Idx - m_Index[]
+	UInt32 Version = htonl(BINARY_REGION_VERSION);
+	if (
+		!IsSuccess ||
+		(TempFile.Seek(0) < 0) ||
+		(TempFile.Write("MCSB", 4) != 4) ||
+		(TempFile.Write(&Version, sizeof(Version)) != sizeof(Version)) ||
+		(TempFile.Write(NewIndex, sizeof(NewIndex)) != sizeof(NewIndex))
+	)
+	{
+		TempFile.Close();
+		cFile::Delete(TempFileName);
+		return false;
+	}
+	TempFile.Close();
+
+	// Replace the file with the compacted one:
+	m_File.Close();
+	if (!cFile::Rename(TempFileName, m_FileName))
+	{
+		// Some platforms don't allow renaming over an existing file:
+		if (!cFile::Delete(m_FileName) || !cFile::Rename(TempFileName, m_FileName))
+		{
+			return false;
+		}
+	}
+	if (!OpenFile(true))
+	{
+		return false;
+	}
+	a_SizeAfter = m_FileSize;
+	return true;
+}
+
+
+
+
@@ -0,0 +1,155 @@
+
+// BinaryRegionFile.h
+
+// Declares the cBinaryChunk class representing the chunk data in the binary storage format,
+// and the cBinaryRegionFile class representing a single region file of that format
+
+/*
+The binary format is used by the cWSSBinary storage schema and by the RegionConverter tool.
+It stores the block data the way cChunkData keeps it in memory, a section after section, so that no NBT is
+involved in loading and saving the blocks; only the entities and block entities are kept as an Anvil NBT blob.
+
+Serialized chunk (before compression):
+	Byte      Version (BINARY_CHUNK_VERSION)
+	Byte      Flags (bit 0: light is valid, bit 1: biomes are valid)
+	UInt16    SectionMask, bit N set if section N is stored (big endian)
+	Byte[256] Biomes (only if the biomes are valid)
+	For each stored section:
+		Byte[4096] BlockTypes
+		Byte[2048] BlockMetas
+		Byte[2048] BlockLight (only if the light is valid)
+		Byte[2048] SkyLight   (only if the light is valid)
+	The rest: NBT compound with the "Entities" and "TileEntities" lists
+Sections that are all air with no light (and full skylight) are not stored.
+The serialized chunk is compressed using zlib with a preset dictionary shared by all chunks.
+
+Region file (32 x 32 chunks, r.<RegionX>.<RegionZ>.mcb):
+	Byte[4]    Magic "MCSB"
+	UInt32     Version (BINARY_REGION_VERSION)
+	UInt32[2 * 1024] Index: for each chunk (LocalX + 32 * LocalZ), the file offset and size of its compressed data, 0 if not present
+	...        Compressed chunk data, each starting at a multiple of BINARY_REGION_ALIGNMENT
+All the numbers are big endian.
+A chunk is rewritten in place if it fits into its current (aligned) space, otherwise it is appended at the end of the file;
+the space it used before is left unused until the file is compacted.
+*/
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** A single chunk in the binary storage format. */
+class cBinaryChunk
+{
+public:
+	enum
+	{
+		NUM_SECTIONS = 16,
+		SECTION_NUM_BLOCKS = 16 * 16 * 16,
+		NUM_BLOCKS = NUM_SECTIONS * SECTION_NUM_BLOCKS,
+		NUM_COLUMNS = 16 * 16,
+	} ;
+
+	// The block data, in the cChunkDef ordering (x + 16 * z + 256 * y), nibbles packed two per byte:
+	Byte m_BlockTypes[NUM_BLOCKS];
+	Byte m_BlockMetas[NUM_BLOCKS / 2];
+	Byte m_BlockLight[NUM_BLOCKS / 2];
+	Byte m_SkyLight  [NUM_BLOCKS / 2];
+
+	/** The biomes, as EMCSBiome values, indexed by x + 16 * z. Only valid if m_AreBiomesValid is set. */
+	Byte m_Biomes[NUM_COLUMNS];
+
+	bool m_IsLightValid;
+	bool m_AreBiomesValid;
+
+	/** The entities and block entities, an NBT compound containing the "Entities" and "TileEntities" lists in the Anvil format.
+	May be empty if there are none. */
+	AString m_EntitiesNBT;
+
+
+	/** Creates an empty chunk: all air, no blocklight, full skylight, invalid light and biomes, no entities. */
+	cBinaryChunk(void);
+
+	/** Resets the chunk to the empty state. */
+	void Clear(void);
+
+	/** Serializes the chunk into a_Data (uncompressed). */
+	void Serialize(AString & a_Data) const;
+
+	/** Reads the chunk from the serialized (uncompressed) data. Returns false if the data is not valid. */
+	bool Parse(const char * a_Data, size_t a_Size);
+
+	/** Compresses the serialized chunk data using the shared dictionary. Returns false on failure. */
+	static bool Compress(const AString & a_Data, AString & a_Compressed);
+
+	/** Uncompresses the data compressed by Compress(). Returns false on failure. */
+	static bool Uncompress(const char * a_Compressed, size_t a_Size, AString & a_Data);
+
+protected:
+	/** Returns true if the specified section is empty and need not be stored. */
+	bool IsSectionEmpty(size_t a_Section) const;
+} ;
+
+
+
+
+
+/** A single region file of the binary storage format. The public functions lock the object's own CS, so it can be used from multiple threads. */
+class cBinaryRegionFile
+{
+public:
+	enum
+	{
+		NUM_CHUNKS = 32 * 32,
+	} ;
+
+	cBinaryRegionFile(const AString & a_FileName, int a_RegionX, int a_RegionZ);
+
+	int             GetRegionX (void) const {return m_RegionX; }
+	int             GetRegionZ (void) const {return m_RegionZ; }
+	const AString & GetFileName(void) const {return m_FileName; }
+
+	/** Reads the compressed data of the specified chunk. Returns false if the chunk is not present or cannot be read. */
+	bool GetChunkData(int a_LocalX, int a_LocalZ, AString & a_Compressed);
+
+	/** Stores the compressed data of the specified chunks, writing the index only once after all the chunks.
+	a_Chunks contains the chunk indices (LocalX + 32 * LocalZ), a_Compressed their data; chunks with empty data are skipped.
+	a_IsSaved receives the result for each chunk. */
+	void SetChunksData(const std::vector<int> & a_Chunks, const AStringVector & a_Compressed, std::vector<bool> & a_IsSaved);
+
+	/** Rewrites the file so that it contains no unused space.
+	a_SizeBefore and a_SizeAfter receive the file size before and after the compaction.
+	Returns false if the file doesn't exist or cannot be compacted; the file is left untouched in such a case. */
+	bool Compact(long & a_SizeBefore, long & a_SizeAfter);
+
+protected:
+	cCriticalSection m_CS;
+
+	int     m_RegionX;
+	int     m_RegionZ;
+	AString m_FileName;
+	cFile   m_File;
+
+	/** The chunk index, as stored in the file (big endian): offset and size for each chunk. */
+	UInt32 m_Index[2 * NUM_CHUNKS];
+
+	/** The size of the file; new chunk data is appended here. */
+	long m_FileSize;
+
+
+	/** Opens the file and reads the index. If a_IsForReading is false, the file is created if it doesn't exist.
+	Assumes m_CS is locked. */
+	bool OpenFile(bool a_IsForReading);
+
+	/** Writes the header and the index into the file. Assumes m_CS is locked and the file is open. */
+	bool WriteHeader(void);
+} ;
+
+
+
+
@@ -0,0 +1,529 @@
+
+// ChunkJournal.cpp
+
+// Implements the cChunkJournal class representing the write-ahead journal of the block changes in a world
+
+#include "Globals.h"
+#include "ChunkJournal.h"
+
+
+
+
+
+/** Size of the record header common to all the records: type, seq, chunk coords. */
+#define JOURNAL_RECORD_HEADER_SIZE 17
+
+/** Size of the block change record, including the header. */
+#define JOURNAL_BLOCK_CHANGE_SIZE (JOURNAL_RECORD_HEADER_SIZE + 5)
+
+/** The journal file is rewritten when it has more than this many obsolete records and they outnumber the live ones. */
+#define JOURNAL_MIN_OBSOLETE_RECORDS 16384
+
+
+
+
+
+static void WriteBEUInt32(AString & a_Dest, UInt32 a_Value)
+{
+	a_Dest.push_back(static_cast<char>((a_Value >> 24) & 0xff));
+	a_Dest.push_back(static_cast<char>((a_Value >> 16) & 0xff));
+	a_Dest.push_back(static_cast<char>((a_Value >> 8)  & 0xff));
+	a_Dest.push_back(static_cast<char>(a_Value         & 0xff));
+}
+
+
+
+
+
+static UInt32 ReadBEUInt32(const char * a_Src)
+{
+	const Byte * Src = reinterpret_cast<const Byte *>(a_Src);
+	return (static_cast<UInt32>(Src[0]) << 24) | (static_cast<UInt32>(Src[1]) << 16) | (static_cast<UInt32>(Src[2]) << 8) | static_cast<UInt32>(Src[3]);
+}
+
+
+
+
+
+/** Removes the changes with a Seq lower than a_Seq from a_Changes. Returns the number of changes removed. */
+static size_t EraseChangesBefore(std::unordered_map<int, cChunkJournal::sBlockChange> & a_Changes, UInt64 a_Seq)
+{
+	size_t NumErased = 0;
+	for (auto itr = a_Changes.begin(); itr != a_Changes.end();)
+	{
+		if (itr->second.m_Seq < a_Seq)
+		{
+			itr = a_Changes.erase(itr);
+			NumErased++;
+		}
+		else
+		{
+			++itr;
+		}
+	}
+	return NumErased;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkJournal:
+
+cChunkJournal::cChunkJournal(void) :
+	super("cChunkJournal"),
+	m_IsEnabled(false),
+	m_SyncInterval(1000),
+	m_NextSeq(1),
+	m_NumUnsavedChanges(0),
+	m_NumFileRecords(0)
+{
+}
+
+
+
+
+
+cChunkJournal::~cChunkJournal()
+{
+	Stop();
+}
+
+
+
+
+
+bool cChunkJournal::Start(const AString & a_FileName, int a_SyncInterval)
+{
+	m_FileName = a_FileName;
+	m_SyncInterval = std::max(a_SyncInterval, 1);
+	size_t NumReplayChunks = ReadFile();
+
+	// Rewrite the file right away, to get rid of the obsolete records and of a possibly truncated last record:
+	AString Data;
+	size_t NumRecords;
+	if (!RewriteFile(Data, NumRecords))
+	{
+		LOGWARNING("Cannot write the journal file \"%s\", block changes will not be journaled", m_FileName.c_str());
+		return false;
+	}
+	if (NumReplayChunks > 0)
+	{
+		LOG("Journal \"%s\": %u block changes in %u chunks will be restored as the chunks load",
+			m_FileName.c_str(), static_cast<unsigned>(m_NumUnsavedChanges), static_cast<unsigned>(NumReplayChunks)
+		);
+	}
+	m_IsEnabled = true;
+	return super::Start();
+}
+
+
+
+
+
+void cChunkJournal::Stop(void)
+{
+	if (!m_IsEnabled)
+	{
+		return;
+	}
+	m_ShouldTerminate = true;
+	m_evtSync.Set();
+	Wait();
+	m_IsEnabled = false;
+	m_File.Close();
+}
+
+
+
+
+
+void cChunkJournal::AddBlockChange(int a_ChunkX, int a_ChunkZ, int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+	if (!m_IsEnabled)
+	{
+		return;
+	}
+	cChunkCoords Coords(a_ChunkX, a_ChunkZ);
+	int Index = cChunkDef::MakeIndexNoCheck(a_RelX, a_RelY, a_RelZ);
+	sBlockChange Change;
+	Change.m_RelX = static_cast<Byte>(a_RelX);
+	Change.m_RelY = static_cast<Byte>(a_RelY);
+	Change.m_RelZ = static_cast<Byte>(a_RelZ);
+	Change.m_BlockType = a_BlockType;
+	Change.m_BlockMeta = a_BlockMeta;
+
+	// Only the last change of each block is kept, both in the unsaved changes and in the records waiting to be written:
+	sShard & Shard = GetShard(a_ChunkX, a_ChunkZ);
+	cCSLock Lock(Shard.m_CS);
+	Change.m_Seq = m_NextSeq++;
+	cChunkBlockChanges & Changes = Shard.m_UnsavedChanges[Coords];
+	size_t NumChangesBefore = Changes.size();
+	Changes[Index] = Change;
+	m_NumUnsavedChanges += Changes.size() - NumChangesBefore;
+	Shard.m_PendingChanges[Coords][Index] = Change;
+}
+
+
+
+
+
+void cChunkJournal::ChunkSaving(int a_ChunkX, int a_ChunkZ)
+{
+	if (!m_IsEnabled)
+	{
+		return;
+	}
+	sShard & Shard = GetShard(a_ChunkX, a_ChunkZ);
+	cCSLock Lock(Shard.m_CS);
+	Shard.m_SavingSeqs[cChunkCoords(a_ChunkX, a_ChunkZ)] = m_NextSeq;
+}
+
+
+
+
+
+void cChunkJournal::ChunkSaved(int a_ChunkX, int a_ChunkZ)
+{
+	if (!m_IsEnabled)
+	{
+		return;
+	}
+	cChunkCoords Coords(a_ChunkX, a_ChunkZ);
+	sShard & Shard = GetShard(a_ChunkX, a_ChunkZ);
+	cCSLock Lock(Shard.m_CS);
+	cChunkSeqMap::iterator itrSeq = Shard.m_SavingSeqs.find(Coords);
+	if (itrSeq == Shard.m_SavingSeqs.end())
+	{
+		return;
+	}
+	UInt64 Seq = itrSeq->second;
+	Shard.m_SavingSeqs.erase(itrSeq);
+
+	// Drop the changes contained in the save:
+	cChunkChangesMap::iterator itr = Shard.m_UnsavedChanges.find(Coords);
+	if (itr == Shard.m_UnsavedChanges.end())
+	{
+		// The chunk hasn't changed since the last save, no need to write anything
+		return;
+	}
+	m_NumUnsavedChanges -= EraseChangesBefore(itr->second, Seq);
+	if (itr->second.empty())
+	{
+		Shard.m_UnsavedChanges.erase(itr);
+	}
+
+	// The saved changes that haven't been written yet don't need to be written at all:
+	cChunkChangesMap::iterator itrPending = Shard.m_PendingChanges.find(Coords);
+	if (itrPending != Shard.m_PendingChanges.end())
+	{
+		EraseChangesBefore(itrPending->second, Seq);
+		if (itrPending->second.empty())
+		{
+			Shard.m_PendingChanges.erase(itrPending);
+		}
+	}
+	Shard.m_PendingSaves[Coords] = Seq;
+}
+
+
+
+
+
+bool cChunkJournal::TakeReplayChanges(int a_ChunkX, int a_ChunkZ, cBlockChanges & a_Changes)
+{
+	sShard & Shard = GetShard(a_ChunkX, a_ChunkZ);
+	cCSLock Lock(Shard.m_CS);
+	if (Shard.m_ReplayChanges.empty())
+	{
+		return false;
+	}
+	cChunkChangesMap::iterator itr = Shard.m_ReplayChanges.find(cChunkCoords(a_ChunkX, a_ChunkZ));
+	if (itr == Shard.m_ReplayChanges.end())
+	{
+		return false;
+	}
+
+	// Replay the changes in the order they were made:
+	a_Changes.clear();
+	a_Changes.reserve(itr->second.size());
+	for (cChunkBlockChanges::const_iterator itrC = itr->second.begin(), endC = itr->second.end(); itrC != endC; ++itrC)
+	{
+		a_Changes.push_back(itrC->second);
+	}
+	std::sort(a_Changes.begin(), a_Changes.end(), [](const sBlockChange & a_First, const sBlockChange & a_Second)
+		{
+			return (a_First.m_Seq < a_Second.m_Seq);
+		}
+	);
+	Shard.m_ReplayChanges.erase(itr);
+	return true;
+}
+
+
+
+
+
+cChunkJournal::sShard & cChunkJournal::GetShard(int a_ChunkX, int a_ChunkZ)
+{
+	return m_Shards[(static_cast<unsigned>(a_ChunkX) * 7 + static_cast<unsigned>(a_ChunkZ)) % NUM_SHARDS];
+}
+
+
+
+
+
+size_t cChunkJournal::ReadFile(void)
+{
+	// Read all the records first; the last change of each block and the last save of each chunk win, regardless of the record order:
+	cChunkChangesMap Changes;
+	cChunkSeqMap SavedSeqs;
+	AString Data = cFile::ReadWholeFile(m_FileName);
+	size_t Pos = 0;
+	while (Pos + JOURNAL_RECORD_HEADER_SIZE <= Data.size())
+	{
+		const char * Record = Data.data() + Pos;
+		UInt64 Seq = (static_cast<UInt64>(ReadBEUInt32(Record + 1)) << 32) | ReadBEUInt32(Record + 5);
+		cChunkCoords Coords(static_cast<int>(ReadBEUInt32(Record + 9)), static_cast<int>(ReadBEUInt32(Record + 13)));
+		if (Record[0] == 'B')
+		{
+			if (Pos + JOURNAL_BLOCK_CHANGE_SIZE > Data.size())
+			{
+				break;
+			}
+			const Byte * Block = reinterpret_cast<const Byte *>(Record + JOURNAL_RECORD_HEADER_SIZE);
+			if ((Block[0] >= cChunkDef::Width) || (Block[2] >= cChunkDef::Width) || (Block[4] > 15))
+			{
+				break;
+			}
+			sBlockChange Change;
+			Change.m_Seq = Seq;
+			Change.m_RelX = Block[0];
+			Change.m_RelY = Block[1];
+			Change.m_RelZ = Block[2];
+			Change.m_BlockType = Block[3];
+			Change.m_BlockMeta = Block[4];
+			cChunkBlockChanges & ChunkChanges = Changes[Coords];
+			int Index = cChunkDef::MakeIndexNoCheck(Change.m_RelX, Change.m_RelY, Change.m_RelZ);
+			cChunkBlockChanges::iterator itr = ChunkChanges.find(Index);
+			if ((itr == ChunkChanges.end()) || (itr->second.m_Seq < Seq))
+			{
+				ChunkChanges[Index] = Change;
+			}
+			Pos += JOURNAL_BLOCK_CHANGE_SIZE;
+		}
+		else if (Record[0] == 'S')
+		{
+			UInt64 & SavedSeq = SavedSeqs[Coords];
+			SavedSeq = std::max(SavedSeq, Seq);
+			Pos += JOURNAL_RECORD_HEADER_SIZE;
+		}
+		else
+		{
+			break;
+		}
+		m_NextSeq = std::max(m_NextSeq.load(), Seq + 1);
+	}
+	if (Pos < Data.size())
+	{
+		LOGWARNING("Journal \"%s\" has a damaged record at offset %u, the rest of the journal is ignored",
+			m_FileName.c_str(), static_cast<unsigned>(Pos)
+		);
+	}
+
+	// Drop the changes made obsolete by the saves, the rest are ready to be replayed:
+	size_t NumChunks = 0;
+	m_NumUnsavedChanges = 0;
+	for (cChunkChangesMap::iterator itr = Changes.begin(), end = Changes.end(); itr != end; ++itr)
+	{
+		cChunkSeqMap::const_iterator itrSaved = SavedSeqs.find(itr->first);
+		if (itrSaved != SavedSeqs.end())
+		{
+			EraseChangesBefore(itr->second, itrSaved->second);
+		}
+		if (itr->second.empty())
+		{
+			continue;
+		}
+		sShard & Shard = GetShard(itr->first.m_ChunkX, itr->first.m_ChunkZ);
+		Shard.m_UnsavedChanges[itr->first] = itr->second;
+		Shard.m_ReplayChanges[itr->first] = itr->second;
+		m_NumUnsavedChanges += itr->second.size();
+		NumChunks += 1;
+	}
+	return NumChunks;
+}
+
+
+
+
+
+void cChunkJournal::Sync(void)
+{
+	AString Data;
+	size_t NumRecords = 0;
+	if (m_NumFileRecords > 2 * m_NumUnsavedChanges + JOURNAL_MIN_OBSOLETE_RECORDS)
+	{
+		if (RewriteFile(Data, NumRecords))
+		{
+			return;
+		}
+		// The rewrite failed, append all the unsaved changes to the old file instead, followed by the records that became pending meanwhile
+	}
+
+	// Collect the pending records from all the shards:
+	for (int i = 0; i < NUM_SHARDS; i++)
+	{
+		sShard & Shard = m_Shards[i];
+		cCSLock Lock(Shard.m_CS);
+		for (cChunkChangesMap::const_iterator itr = Shard.m_PendingChanges.begin(), end = Shard.m_PendingChanges.end(); itr != end; ++itr)
+		{
+			for (cChunkBlockChanges::const_iterator itrC = itr->second.begin(), endC = itr->second.end(); itrC != endC; ++itrC)
+			{
+				WriteBlockChange(Data, itr->first.m_ChunkX, itr->first.m_ChunkZ, itrC->second);
+				NumRecords += 1;
+			}
+		}
+		for (cChunkSeqMap::const_iterator itr = Shard.m_PendingSaves.begin(), end = Shard.m_PendingSaves.end(); itr != end; ++itr)
+		{
+			WriteRecordHeader(Data, 'S', itr->second, itr->first.m_ChunkX, itr->first.m_ChunkZ);
+			NumRecords += 1;
+		}
+		Shard.m_PendingChanges.clear();
+		Shard.m_PendingSaves.clear();
+	}
+	if (Data.empty())
+	{
+		return;
+	}
+	if ((m_File.Write(Data.data(), Data.size()) != static_cast<int>(Data.size())) || !m_File.Sync())
+	{
+		LOGWARNING("Cannot write to the journal file \"%s\", the last block changes may be lost in a crash", m_FileName.c_str());
+	}
+	m_NumFileRecords += NumRecords;
+}
+
+
+
+
+
+bool cChunkJournal::RewriteFile(AString & a_Data, size_t & a_NumRecords)
+{
+	// Take a snapshot of the live changes; the pending records are all contained in the snapshot, so they are dropped:
+	AString Saves;
+	size_t NumSaves = 0;
+	a_Data.clear();
+	a_Data.reserve(m_NumUnsavedChanges * JOURNAL_BLOCK_CHANGE_SIZE);
+	a_NumRecords = 0;
+	for (int i = 0; i < NUM_SHARDS; i++)
+	{
+		sShard & Shard = m_Shards[i];
+		cCSLock Lock(Shard.m_CS);
+		for (cChunkChangesMap::const_iterator itr = Shard.m_UnsavedChanges.begin(), end = Shard.m_UnsavedChanges.end(); itr != end; ++itr)
+		{
+			for (cChunkBlockChanges::const_iterator itrC = itr->second.begin(), endC = itr->second.end(); itrC != endC; ++itrC)
+			{
+				WriteBlockChange(a_Data, itr->first.m_ChunkX, itr->first.m_ChunkZ, itrC->second);
+				a_NumRecords += 1;
+			}
+		}
+
+		// The saves are only needed if the old file is kept:
+		for (cChunkSeqMap::const_iterator itr = Shard.m_PendingSaves.begin(), end = Shard.m_PendingSaves.end(); itr != end; ++itr)
+		{
+			WriteRecordHeader(Saves, 'S', itr->second, itr->first.m_ChunkX, itr->first.m_ChunkZ);
+			NumSaves += 1;
+		}
+		Shard.m_PendingChanges.clear();
+		Shard.m_PendingSaves.clear();
+	}
+
+	// Write the new file and replace the old one with it:
+	bool IsSuccess = false;
+	AString TempFileName = m_FileName + ".new";
+	{
+		cFile TempFile;
+		if (
+			TempFile.Open(TempFileName, cFile::fmWrite) &&
+			(TempFile.Write(a_Data.data(), a_Data.size()) == static_cast<int>(a_Data.size())) &&
+			TempFile.Sync()
+		)
+		{
+			IsSuccess = true;
+		}
+		else
+		{
+			TempFile.Close();
+			cFile::Delete(TempFileName);
+		}
+	}
+	if (IsSuccess)
+	{
+		m_File.Close();
+		if (!cFile::Rename(TempFileName, m_FileName))
+		{
+			// Some platforms don't allow renaming over an existing file:
+			IsSuccess = (cFile::Delete(m_FileName) && cFile::Rename(TempFileName, m_FileName));
+		}
+		if (!m_File.Open(m_FileName, cFile::fmAppend))
+		{
+			IsSuccess = false;
+		}
+	}
+	if (!IsSuccess)
+	{
+		a_Data.append(Saves);
+		a_NumRecords += NumSaves;
+		return false;
+	}
+	m_NumFileRecords = a_NumRecords;
+	return true;
+}
+
+
+
+
+
+void cChunkJournal::WriteBlockChange(AString & a_Dest, int a_ChunkX, int a_ChunkZ, const sBlockChange & a_Change)
+{
+	WriteRecordHeader(a_Dest, 'B', a_Change.m_Seq, a_ChunkX, a_ChunkZ);
+	a_Dest.push_back(static_cast<char>(a_Change.m_RelX));
+	a_Dest.push_back(static_cast<char>(a_Change.m_RelY));
+	a_Dest.push_back(static_cast<char>(a_Change.m_RelZ));
+	a_Dest.push_back(static_cast<char>(a_Change.m_BlockType));
+	a_Dest.push_back(static_cast<char>(a_Change.m_BlockMeta));
+}
+
+
+
+
+
+void cChunkJournal::WriteRecordHeader(AString & a_Dest, char a_Type, UInt64 a_Seq, int a_ChunkX, int a_ChunkZ)
+{
+	a_Dest.push_back(a_Type);
+	WriteBEUInt32(a_Dest, static_cast<UInt32>(a_Seq >> 32));
+	WriteBEUInt32(a_Dest, static_cast<UInt32>(a_Seq & 0xffffffff));
+	WriteBEUInt32(a_Dest, static_cast<UInt32>(a_ChunkX));
+	WriteBEUInt32(a_Dest, static_cast<UInt32>(a_ChunkZ));
+}
+
+
+
+
+
+void cChunkJournal::Execute(void)
+{
+	while (!m_ShouldTerminate)
+	{
+		m_evtSync.Wait(static_cast<unsigned>(m_SyncInterval));
+		Sync();
+	}
+
+	// The loop may have been skipped altogether if stopping right after starting; sync whatever is left:
+	Sync();
+}
+
+
+
+
@@ -0,0 +1,181 @@
+
+// ChunkJournal.h
+
+// Declares the cChunkJournal class representing the write-ahead journal of the block changes in a world
+
+/*
+Every block change in a loaded chunk is appended to the journal ("<world>/journal.mcj") and a background thread
+syncs the journal to the disk every few hundred milliseconds. When a chunk is saved by the storage, its journal
+records up to the moment the save began are no longer needed and a "chunk saved" record is appended.
+On startup, the records that haven't been superseded by a chunk save are read back and re-applied to each chunk
+as it is loaded, so a crash loses at most the changes since the last journal sync instead of those since the
+last autosave. The journal file is rewritten with only the live records whenever it grows too large.
+
+File format: a sequence of records, all numbers big-endian:
+	- Block change: 'B', UInt64 Seq, Int32 ChunkX, Int32 ChunkZ, Byte RelX, Byte RelY, Byte RelZ, Byte BlockType, Byte BlockMeta
+	- Chunk saved:  'S', UInt64 Seq, Int32 ChunkX, Int32 ChunkZ
+A chunk saved record makes all the block change records of that chunk with a lower Seq obsolete, regardless of
+their order in the file. Of several block change records for the same block, the one with the highest Seq wins;
+the changes are coalesced per block both in memory and in the records waiting to be written, so a block that
+changes many times between two syncs costs only a single record.
+A truncated or invalid record (crash while writing) ends the journal.
+The state is split into shards by the chunk coords, each with its own lock, so that chunks ticked in parallel
+don't contend on a single lock when journaling their changes.
+*/
+
+
+
+
+
+#pragma once
+
+#include "../ChunkDef.h"
+#include "../OSSupport/IsThread.h"
+#include "../OSSupport/File.h"
+#include <unordered_map>
+#include <atomic>
+
+
+
+
+
+// fwd: Chunk.h
+class cChunk;
+
+
+
+
+
+class cChunkJournal :
+	public cIsThread
+{
+	typedef cIsThread super;
+
+public:
+
+	/** A single journaled block change. */
+	struct sBlockChange
+	{
+		UInt64     m_Seq;
+		Byte       m_RelX, m_RelY, m_RelZ;
+		BLOCKTYPE  m_BlockType;
+		NIBBLETYPE m_BlockMeta;
+	} ;
+
+	typedef std::vector<sBlockChange> cBlockChanges;
+
+
+	cChunkJournal(void);
+	virtual ~cChunkJournal();
+
+	/** Reads the changes left over in the journal file by the previous run and starts the thread syncing the journal.
+	a_SyncInterval is the time between two syncs, in milliseconds.
+	Returns false if the journal file cannot be opened; the journal is disabled then. */
+	bool Start(const AString & a_FileName, int a_SyncInterval);
+
+	/** Syncs all the remaining changes to the disk and stops the syncing thread. */
+	void Stop(void);
+
+	/** Returns true if the journal has been started successfully. */
+	bool IsEnabled(void) const { return m_IsEnabled; }
+
+	/** Journals a change of a single block. Called by cChunk whenever it changes a block.
+	Must be called while the chunk is locked, so that the change and the chunk's save are ordered the same way in the journal as in the chunk. */
+	void AddBlockChange(int a_ChunkX, int a_ChunkZ, int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta);
+
+	/** Called by the storage before it starts saving the chunk; all the changes journaled so far will be contained in the save. */
+	void ChunkSaving(int a_ChunkX, int a_ChunkZ);
+
+	/** Called by the storage after the chunk has been saved successfully; drops the changes journaled before the matching ChunkSaving() call. */
+	void ChunkSaved(int a_ChunkX, int a_ChunkZ);
+
+	/** Moves the changes read from the journal file on startup for the specified chunk into a_Changes.
+	To be called when the chunk's data is set; returns false if there are no such changes. */
+	bool TakeReplayChanges(int a_ChunkX, int a_ChunkZ, cBlockChanges & a_Changes);
+
+protected:
+
+	/** Number of the shards the journaled state is split into. */
+	static const int NUM_SHARDS = 16;
+
+	/** The changes of a single chunk, coalesced per block; keyed by the block index within the chunk. */
+	typedef std::unordered_map<int, sBlockChange> cChunkBlockChanges;
+
+	typedef std::unordered_map<cChunkCoords, cChunkBlockChanges, cChunkCoordsHash> cChunkChangesMap;
+	typedef std::unordered_map<cChunkCoords, UInt64, cChunkCoordsHash> cChunkSeqMap;
+
+	/** The journaled state of the chunks that map into a single shard. */
+	struct sShard
+	{
+		/** Protects all the members of the shard. */
+		cCriticalSection m_CS;
+
+		/** The changes of each chunk that have not been saved by the storage yet; this is what the journal file would contain if it were rewritten. */
+		cChunkChangesMap m_UnsavedChanges;
+
+		/** The changes not yet written to the file. */
+		cChunkChangesMap m_PendingChanges;
+
+		/** The chunk saved records not yet written to the file, the Seq for each chunk. */
+		cChunkSeqMap m_PendingSaves;
+
+		/** The Seq number at the time each chunk currently being saved started saving. */
+		cChunkSeqMap m_SavingSeqs;
+
+		/** The changes read from the journal file on startup that haven't been re-applied to their chunks yet. */
+		cChunkChangesMap m_ReplayChanges;
+	} ;
+
+
+	/** Set when the journal has been started successfully. Changes are not journaled until then. */
+	bool m_IsEnabled;
+
+	AString m_FileName;
+	cFile m_File;
+
+	/** The time between two syncs, in milliseconds. */
+	int m_SyncInterval;
+
+	/** Set to wake the syncing thread up before the sync interval passes (when stopping). */
+	cEvent m_evtSync;
+
+	/** The Seq number assigned to the next journal record. */
+	std::atomic<UInt64> m_NextSeq;
+
+	/** The journaled state, split by the chunk coords. */
+	sShard m_Shards[NUM_SHARDS];
+
+	/** The total number of changes in all the shards' m_UnsavedChanges. */
+	std::atomic<size_t> m_NumUnsavedChanges;
+
+	/** The number of records in the journal file, including the obsolete ones. Used only by the syncing thread after Start(). */
+	size_t m_NumFileRecords;
+
+
+	/** Returns the shard holding the state of the specified chunk. */
+	sShard & GetShard(int a_ChunkX, int a_ChunkZ);
+
+	/** Reads the journal file left over by the previous run into the shards' m_UnsavedChanges and m_ReplayChanges.
+	Returns the number of chunks that have changes to replay. */
+	size_t ReadFile(void);
+
+	/** Writes the pending records into the file and syncs it. Rewrites the file if it contains too many obsolete records. */
+	void Sync(void);
+
+	/** Rewrites the journal file so that it contains only the unsaved changes; the pending records are dropped, since they are contained in it.
+	Returns true on success. On failure, a_Data contains the records of all the unsaved changes, so that they can be appended to the old file instead. */
+	bool RewriteFile(AString & a_Data, size_t & a_NumRecords);
+
+	/** Appends a block change record into a_Dest. */
+	static void WriteBlockChange(AString & a_Dest, int a_ChunkX, int a_ChunkZ, const sBlockChange & a_Change);
+
+	/** Appends a record header into a_Dest. */
+	static void WriteRecordHeader(AString & a_Dest, char a_Type, UInt64 a_Seq, int a_ChunkX, int a_ChunkZ);
+
+	// cIsThread overrides:
+	virtual void Execute(void) override;
+} ;
+
+
+
+
@@ -25,9 +25,9 @@ static const int MAX_LIST_ITEMS = 10000;
 
 #ifdef _MSC_VER
 	// Dodge a C4127 (conditional expression is constant) for this specific macro usage
-	#define RETURN_FALSE_IF_FALSE(X) do { if (!X) return false; } while ((false, false))
+	#define RETURN_FALSE_IF_FALSE(X) do { if (!(X)) return false; } while ((false, false))
 #else
-	#define RETURN_FALSE_IF_FALSE(X) do { if (!X) return false; } while (false)
+	#define RETURN_FALSE_IF_FALSE(X) do { if (!(X)) return false; } while (false)
 #endif
 
 
@@ -45,10 +45,12 @@ static const int MAX_LIST_ITEMS = 10000;
 
 
 
-cParsedNBT::cParsedNBT(const char * a_Data, size_t a_Length) :
+cParsedNBT::cParsedNBT(const char * a_Data, size_t a_Length, bool a_IsLazy) :
 	m_Data(a_Data),
 	m_Length(a_Length),
-	m_Pos(0)
+	m_IsLazy(a_IsLazy),
+	m_Pos(0),
+	m_NextSkipEntry(0)
 {
 	m_IsValid = Parse();
 }
@@ -77,7 +79,7 @@ bool cParsedNBT::Parse(void)
 	m_Pos = 1;
 	
 	RETURN_FALSE_IF_FALSE(ReadString(m_Tags.back().m_NameStart, m_Tags.back().m_NameLength));
-	RETURN_FALSE_IF_FALSE(ReadCompound());
+	RETURN_FALSE_IF_FALSE(ReadCompound(0));
 	
 	return true;
 }
@@ -104,12 +106,12 @@ bool cParsedNBT::ReadString(size_t & a_StringStart, size_t & a_StringLen)
 
 
 
-bool cParsedNBT::ReadCompound(void)
+bool cParsedNBT::ReadCompound(int a_ParentIdx)
 {
 	ASSERT(m_Tags.size() > 0);
 
-	// Reads the latest tag as a compound
-	int ParentIdx = (int)m_Tags.size() - 1;
+	// Reads the children of the specified tag as a compound
+	int ParentIdx = a_ParentIdx;
 	int PrevSibling = -1;
 	for (;;)
 	{
@@ -141,9 +143,9 @@ bool cParsedNBT::ReadCompound(void)
 
 
 
-bool cParsedNBT::ReadList(eTagType a_ChildrenType)
+bool cParsedNBT::ReadList(eTagType a_ChildrenType, int a_ParentIdx)
 {
-	// Reads the latest tag as a list of items of type a_ChildrenType
+	// Reads the children of the specified tag as a list of items of type a_ChildrenType
 	
 	// Read the count:
 	NEEDBYTES(4);
@@ -155,7 +157,7 @@ bool cParsedNBT::ReadList(eTagType a_ChildrenType)
 	}
 
 	// Read items:
-	int ParentIdx = (int)m_Tags.size() - 1;
+	int ParentIdx = a_ParentIdx;
 	int PrevSibling = -1;
 	for (int i = 0; i < Count; i++)
 	{
@@ -192,6 +194,10 @@ bool cParsedNBT::ReadList(eTagType a_ChildrenType)
 bool cParsedNBT::ReadTag(void)
 {
 	cFastNBTTag & Tag = m_Tags.back();
+	if (m_IsLazy && ((Tag.m_Type == TAG_List) || (Tag.m_Type == TAG_Compound)))
+	{
+		return ReadUnexpandedTag();
+	}
 	switch (Tag.m_Type)
 	{
 		CASE_SIMPLE_TAG(Byte,   1)
@@ -228,13 +234,13 @@ bool cParsedNBT::ReadTag(void)
 			NEEDBYTES(1);
 			eTagType ItemType = (eTagType)m_Data[m_Pos];
 			m_Pos++;
-			RETURN_FALSE_IF_FALSE(ReadList(ItemType));
+			RETURN_FALSE_IF_FALSE(ReadList(ItemType, (int)m_Tags.size() - 1));
 			return true;
 		}
 		
 		case TAG_Compound:
 		{
-			RETURN_FALSE_IF_FALSE(ReadCompound());
+			RETURN_FALSE_IF_FALSE(ReadCompound((int)m_Tags.size() - 1));
 			return true;
 		}
 		
@@ -270,6 +276,205 @@ bool cParsedNBT::ReadTag(void)
 
 
 
+bool cParsedNBT::ReadUnexpandedTag(void)
+{
+	cFastNBTTag & Tag = m_Tags.back();
+	Tag.m_DataStart = m_Pos;
+	if (m_NextSkipEntry < (int)m_SkipIndex.size())
+	{
+		// Expanding the parent tag, this tag has been validated already and its extent is known:
+		Tag.m_SkipEntry = m_NextSkipEntry;
+		m_Pos = m_SkipIndex[(size_t)m_NextSkipEntry].m_DataEnd;
+		m_NextSkipEntry = m_SkipIndex[(size_t)m_NextSkipEntry].m_NextEntry;
+		return true;
+	}
+
+	// The initial parse, validate the tag and add it to the skip index (SkipTag() does that, too):
+	Tag.m_SkipEntry = (int)m_SkipIndex.size();
+	RETURN_FALSE_IF_FALSE(SkipTag(Tag.m_Type));
+	m_NextSkipEntry = (int)m_SkipIndex.size();
+	return true;
+}
+
+
+
+
+
+/** Returns the size of a single payload of the specified tag type, or 0 if the size is variable. */
+static size_t GetFixedPayloadSize(eTagType a_Type)
+{
+	switch (a_Type)
+	{
+		case TAG_End:    return 0;  // Empty lists are sometimes stored with TAG_End as the item type
+		case TAG_Byte:   return 1;
+		case TAG_Short:  return 2;
+		case TAG_Int:    return 4;
+		case TAG_Long:   return 8;
+		case TAG_Float:  return 4;
+		case TAG_Double: return 8;
+		default:         return 0;
+	}
+}
+
+
+
+
+
+bool cParsedNBT::SkipTag(eTagType a_Type)
+{
+	switch (a_Type)
+	{
+		case TAG_Byte:
+		case TAG_Short:
+		case TAG_Int:
+		case TAG_Long:
+		case TAG_Float:
+		case TAG_Double:
+		{
+			size_t Size = GetFixedPayloadSize(a_Type);
+			NEEDBYTES(Size);
+			m_Pos += Size;
+			return true;
+		}
+
+		case TAG_String:
+		{
+			size_t Start, Length;
+			return ReadString(Start, Length);
+		}
+
+		case TAG_ByteArray:
+		case TAG_IntArray:
+		{
+			// Arrays are skipped as a whole, regardless of their size:
+			NEEDBYTES(4);
+			int Count = GetBEInt(m_Data + m_Pos);
+			m_Pos += 4;
+			if (Count < 0)
+			{
+				// Invalid length
+				return false;
+			}
+			size_t Size = (size_t)Count * ((a_Type == TAG_IntArray) ? 4 : 1);
+			NEEDBYTES(Size);
+			m_Pos += Size;
+			return true;
+		}
+
+		case TAG_List:
+		case TAG_Compound:
+		{
+			// Add an entry to the skip index, its extent is filled in once the nested tags have been skipped:
+			size_t Entry = m_SkipIndex.size();
+			m_SkipIndex.push_back(sSkipEntry());
+			RETURN_FALSE_IF_FALSE((a_Type == TAG_List) ? SkipList() : SkipCompound());
+			m_SkipIndex[Entry].m_DataEnd = m_Pos;
+			m_SkipIndex[Entry].m_NextEntry = (int)m_SkipIndex.size();
+			return true;
+		}
+
+		default:
+		{
+			// Invalid tag type
+			return false;
+		}
+	}  // switch (a_Type)
+}
+
+
+
+
+
+bool cParsedNBT::SkipCompound(void)
+{
+	for (;;)
+	{
+		NEEDBYTES(1);
+		eTagType TagType = (eTagType)(m_Data[m_Pos]);
+		m_Pos++;
+		if (TagType == TAG_End)
+		{
+			return true;
+		}
+		size_t NameStart, NameLength;
+		RETURN_FALSE_IF_FALSE(ReadString(NameStart, NameLength));
+		RETURN_FALSE_IF_FALSE(SkipTag(TagType));
+	}
+}
+
+
+
+
+
+bool cParsedNBT::SkipList(void)
+{
+	NEEDBYTES(5);
+	eTagType ItemType = (eTagType)m_Data[m_Pos];
+	int Count = GetBEInt(m_Data + m_Pos + 1);
+	m_Pos += 5;
+	if ((Count < 0) || (Count > MAX_LIST_ITEMS))
+	{
+		return false;
+	}
+
+	// Lists of fixed-size items are skipped as a whole:
+	size_t ItemSize = GetFixedPayloadSize(ItemType);
+	if ((ItemSize > 0) || (Count == 0))
+	{
+		NEEDBYTES(ItemSize * (size_t)Count);
+		m_Pos += ItemSize * (size_t)Count;
+		return true;
+	}
+	if (ItemType == TAG_End)
+	{
+		// A non-empty list of TAG_End items cannot be read by ReadTag() either
+		return false;
+	}
+	for (int i = 0; i < Count; i++)
+	{
+		RETURN_FALSE_IF_FALSE(SkipTag(ItemType));
+	}
+	return true;
+}
+
+
+
+
+
+void cParsedNBT::ExpandTag(int a_Tag)
+{
+	int Entry = m_Tags[(size_t)a_Tag].m_SkipEntry;
+	ASSERT(Entry >= 0);
+
+	// The data has been validated by skipping it in the initial parse, so indexing it cannot fail:
+	m_Tags[(size_t)a_Tag].m_SkipEntry = -1;
+	m_Pos = m_Tags[(size_t)a_Tag].m_DataStart;
+	m_NextSkipEntry = Entry + 1;
+	bool IsSuccess;
+	if (m_Tags[(size_t)a_Tag].m_Type == TAG_Compound)
+	{
+		IsSuccess = ReadCompound(a_Tag);
+	}
+	else
+	{
+		ASSERT(m_Tags[(size_t)a_Tag].m_Type == TAG_List);
+		eTagType ItemType = (eTagType)m_Data[m_Pos];
+		m_Pos++;
+		IsSuccess = ReadList(ItemType, a_Tag);
+	}
+	ASSERT(IsSuccess);
+	ASSERT(m_Pos == m_SkipIndex[(size_t)Entry].m_DataEnd);
+	ASSERT(m_NextSkipEntry == m_SkipIndex[(size_t)Entry].m_NextEntry);
+	UNUSED_VAR(IsSuccess);
+
+	// Compound and List tags report no data, same as in the non-lazy mode:
+	m_Tags[(size_t)a_Tag].m_DataStart = 0;
+}
+
+
+
+
+
 int cParsedNBT::FindChildByName(int a_Tag, const char * a_Name, size_t a_NameLength) const
 {
 	if (a_Tag < 0)
@@ -285,6 +490,7 @@ int cParsedNBT::FindChildByName(int a_Tag, const char * a_Name, size_t a_NameLen
 	{
 		a_NameLength = strlen(a_Name);
 	}
+	Expand(a_Tag);
 	for (int Child = m_Tags[a_Tag].m_FirstChild; Child != -1; Child = m_Tags[Child].m_NextSibling)
 	{
 		if (
@@ -340,10 +546,34 @@ int cParsedNBT::FindTagByPath(int a_Tag, const AString & a_Path) const
 // cFastNBTWriter:
 
 cFastNBTWriter::cFastNBTWriter(const AString & a_RootTagName) :
-	m_CurrentStack(0)
+	m_CurrentStack(0),
+	m_Output(nullptr)
 {
-	m_Stack[0].m_Type = TAG_Compound;
 	m_Result.reserve(100 * 1024);
+	Reset(a_RootTagName);
+}
+
+
+
+
+
+cFastNBTWriter::cFastNBTWriter(cOutput & a_Output, const AString & a_RootTagName) :
+	m_CurrentStack(0),
+	m_Output(&a_Output)
+{
+	m_Result.reserve(2 * STREAM_BUFFER_SIZE);
+	Reset(a_RootTagName);
+}
+
+
+
+
+
+void cFastNBTWriter::Reset(const AString & a_RootTagName)
+{
+	m_CurrentStack = 0;
+	m_Stack[0].m_Type = TAG_Compound;
+	m_Result.clear();
 	m_Result.push_back(TAG_Compound);
 	WriteString(a_RootTagName.data(), (UInt16)a_RootTagName.size());
 }
@@ -377,6 +607,7 @@ void cFastNBTWriter::EndCompound(void)
 	
 	m_Result.push_back(TAG_End);
 	--m_CurrentStack;
+	FlushIfFull();
 }
 
 
@@ -400,6 +631,34 @@ void cFastNBTWriter::BeginList(const AString & a_Name, eTagType a_ChildrenType)
 	m_Stack[m_CurrentStack].m_Type     = TAG_List;
 	m_Stack[m_CurrentStack].m_Pos      = (int)m_Result.size() - 4;
 	m_Stack[m_CurrentStack].m_Count    = 0;
+	m_Stack[m_CurrentStack].m_ExpectedCount = -1;
+	m_Stack[m_CurrentStack].m_ItemType = a_ChildrenType;
+}
+
+
+
+
+
+void cFastNBTWriter::BeginList(const AString & a_Name, eTagType a_ChildrenType, int a_Count)
+{
+	ASSERT(a_Count >= 0);
+	if (m_CurrentStack >= MAX_STACK - 1)
+	{
+		ASSERT(!"Stack overflow");
+		return;
+	}
+	
+	TagCommon(a_Name, TAG_List);
+	
+	m_Result.push_back((char)a_ChildrenType);
+	u_long Count = htonl((u_long)a_Count);
+	m_Result.append((const char *)&Count, 4);
+	
+	++m_CurrentStack;
+	m_Stack[m_CurrentStack].m_Type     = TAG_List;
+	m_Stack[m_CurrentStack].m_Pos      = -1;
+	m_Stack[m_CurrentStack].m_Count    = 0;
+	m_Stack[m_CurrentStack].m_ExpectedCount = a_Count;
 	m_Stack[m_CurrentStack].m_ItemType = a_ChildrenType;
 }
 
@@ -412,10 +671,18 @@ void cFastNBTWriter::EndList(void)
 	ASSERT(m_CurrentStack > 0);
 	ASSERT(m_Stack[m_CurrentStack].m_Type == TAG_List);
 	
-	// Update the list count:
-	SetBEInt((char *)(m_Result.c_str() + m_Stack[m_CurrentStack].m_Pos), m_Stack[m_CurrentStack].m_Count);
+	// Update the list count, unless it was written upfront:
+	if (m_Stack[m_CurrentStack].m_ExpectedCount < 0)
+	{
+		SetBEInt((char *)(m_Result.c_str() + m_Stack[m_CurrentStack].m_Pos), m_Stack[m_CurrentStack].m_Count);
+	}
+	else
+	{
+		ASSERT(m_Stack[m_CurrentStack].m_Count == m_Stack[m_CurrentStack].m_ExpectedCount);
+	}
 
 	--m_CurrentStack;
+	FlushIfFull();
 }
 
 
@@ -493,6 +760,7 @@ void cFastNBTWriter::AddString(const AString & a_Name, const AString & a_Value)
 	Int16 len = htons((short)(a_Value.size()));
 	m_Result.append((const char *)&len, 2);
 	m_Result.append(a_Value.c_str(), a_Value.size());
+	FlushIfFull();
 }
 
 
@@ -504,7 +772,16 @@ void cFastNBTWriter::AddByteArray(const AString & a_Name, const char * a_Value,
 	TagCommon(a_Name, TAG_ByteArray);
 	u_long len = htonl((u_long)a_NumElements);
 	m_Result.append((const char *)&len, 4);
+	
+	// A streaming writer passes large arrays directly to the output, without copying them into the buffer:
+	if ((m_Output != nullptr) && (a_NumElements >= STREAM_BUFFER_SIZE / 4) && CanFlushAll())
+	{
+		Flush();
+		m_Output->Write(a_Value, a_NumElements);
+		return;
+	}
 	m_Result.append(a_Value, a_NumElements);
+	FlushIfFull();
 }
 
 
@@ -527,6 +804,7 @@ void cFastNBTWriter::AddIntArray(const AString & a_Name, const int * a_Value, si
 		int Element = htonl(a_Value[i]);
 		m_Result.append((const char *)&Element, 4);
 	}
+	FlushIfFull();
 }
 
 
@@ -537,6 +815,63 @@ void cFastNBTWriter::Finish(void)
 {
 	ASSERT(m_CurrentStack == 0);
 	m_Result.push_back(TAG_End);
+	if (m_Output != nullptr)
+	{
+		Flush();
+	}
+}
+
+
+
+
+
+void cFastNBTWriter::Flush(void)
+{
+	ASSERT(m_Output != nullptr);
+	
+	// Only the data before the first list count that is yet to be filled in can be written:
+	size_t Size = m_Result.size();
+	int FirstPendingList = m_CurrentStack + 1;
+	for (int i = 1; i <= m_CurrentStack; i++)
+	{
+		if ((m_Stack[i].m_Type == TAG_List) && (m_Stack[i].m_ExpectedCount < 0))
+		{
+			Size = (size_t)m_Stack[i].m_Pos;
+			FirstPendingList = i;
+			break;
+		}
+	}
+	if (Size == 0)
+	{
+		return;
+	}
+	m_Output->Write(m_Result.data(), Size);
+	m_Result.erase(0, Size);
+	
+	// Move the pending list count positions accordingly:
+	for (int i = FirstPendingList; i <= m_CurrentStack; i++)
+	{
+		if ((m_Stack[i].m_Type == TAG_List) && (m_Stack[i].m_ExpectedCount < 0))
+		{
+			m_Stack[i].m_Pos -= (int)Size;
+		}
+	}
+}
+
+
+
+
+
+bool cFastNBTWriter::CanFlushAll(void) const
+{
+	for (int i = 1; i <= m_CurrentStack; i++)
+	{
+		if ((m_Stack[i].m_Type == TAG_List) && (m_Stack[i].m_ExpectedCount < 0))
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 
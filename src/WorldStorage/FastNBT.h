@@ -7,10 +7,17 @@
 The fast parser parses the data into a vector of cFastNBTTag structures. These structures describe the NBT tree,
 but themselves are allocated in a vector, thus minimizing reallocation.
 The structures have a minimal constructor, setting all member "pointers" to "invalid".
+In the lazy mode the parser only validates the data and indexes the top-level tags; the children of each Compound and
+List tag are indexed on their first access. Data that is never asked for (such as the heightmap in a chunk) is then
+only skipped over, with arrays and lists of fixed-size items skipped as a whole. The validation pass records the extent
+of each Compound and List tag into a small skip index, so that indexing the children later doesn't re-scan the data.
 
 The fast writer doesn't need a NBT tree structure built beforehand, it is commanded to open, append and close tags
 (just like XML); it keeps the internal tag stack and reports errors in usage.
 It directly outputs a string containing the serialized NBT data.
+Alternatively the writer can stream the data into a cFastNBTWriter::cOutput (such as a compressor) as it is produced,
+keeping only a small buffer. Lists whose count is not known upfront cannot be streamed until they are closed, because
+their count needs to be written into the data before them; use the BeginList() overload with the count where possible.
 */
 
 
@@ -73,6 +80,10 @@ public:
 	int m_NextSibling;
 	int m_FirstChild;
 	int m_LastChild;
+
+	/** For a Compound or List tag whose children haven't been indexed yet (lazy parsing), the index of its entry
+	in cParsedNBT's skip index, and m_DataStart points to its raw children data; -1 for all other tags. */
+	int m_SkipEntry;
 	
 	cFastNBTTag(eTagType a_Type, int a_Parent) :
 		m_Type(a_Type),
@@ -84,7 +95,8 @@ public:
 		m_PrevSibling(-1),
 		m_NextSibling(-1),
 		m_FirstChild(-1),
-		m_LastChild(-1)
+		m_LastChild(-1),
+		m_SkipEntry(-1)
 	{
 	}
 
@@ -98,7 +110,8 @@ public:
 		m_PrevSibling(a_PrevSibling),
 		m_NextSibling(-1),
 		m_FirstChild(-1),
-		m_LastChild(-1)
+		m_LastChild(-1),
+		m_SkipEntry(-1)
 	{
 	}
 } ;
@@ -118,7 +131,10 @@ Each primitive tag also stores the length of the contained data, in bytes.
 class cParsedNBT
 {
 public:
-	cParsedNBT(const char * a_Data, size_t a_Length);
+	/** Parses the specified NBT data. The data needs to stay valid for the entire lifetime of this object.
+	If a_IsLazy is true, the children of the Compound and List tags are indexed only once they are accessed;
+	as that modifies the tree internally, a lazy object must not be accessed from multiple threads at once. */
+	cParsedNBT(const char * a_Data, size_t a_Length, bool a_IsLazy = false);
 	
 	bool IsValid(void) const {return m_IsValid; }
 	
@@ -126,10 +142,18 @@ public:
 	int GetRoot(void) const {return 0; }
 
 	/** Returns the first child of the specified tag, or -1 if none / not applicable. */
-	int GetFirstChild (int a_Tag) const { return m_Tags[(size_t)a_Tag].m_FirstChild; }
+	int GetFirstChild (int a_Tag) const
+	{
+		Expand(a_Tag);
+		return m_Tags[(size_t)a_Tag].m_FirstChild;
+	}
 	
 	/** Returns the last child of the specified tag, or -1 if none / not applicable. */
-	int GetLastChild  (int a_Tag) const { return m_Tags[(size_t)a_Tag].m_LastChild; }
+	int GetLastChild  (int a_Tag) const
+	{
+		Expand(a_Tag);
+		return m_Tags[(size_t)a_Tag].m_LastChild;
+	}
 	
 	/** Returns the next sibling of the specified tag, or -1 if none. */
 	int GetNextSibling(int a_Tag) const { return m_Tags[(size_t)a_Tag].m_NextSibling; }
@@ -173,6 +197,7 @@ public:
 	eTagType GetChildrenType(int a_Tag) const
 	{
 		ASSERT(m_Tags[(size_t)a_Tag].m_Type == TAG_List);
+		Expand(a_Tag);
 		return (m_Tags[(size_t)a_Tag].m_FirstChild < 0) ? TAG_End : m_Tags[(size_t)m_Tags[(size_t)a_Tag].m_FirstChild].m_Type;
 	}
 	
@@ -258,15 +283,58 @@ protected:
 	size_t                   m_Length;
 	std::vector<cFastNBTTag> m_Tags;
 	bool                     m_IsValid;  // True if parsing succeeded
+	bool                     m_IsLazy;   // True if the children of Compound and List tags are indexed only on access
+
+	/** An entry of the skip index, describing a single Compound or List tag found while validating the data in the lazy mode. */
+	struct sSkipEntry
+	{
+		/** Position just after the tag's data. */
+		size_t m_DataEnd;
+
+		/** The index of the next entry that doesn't belong to a tag nested in this one. */
+		int m_NextEntry;
+	} ;
+
+	/** The skip index: an entry for each Compound and List tag below the top level, in the order of their appearance in the data.
+	The tags nested in a tag have their entries right after the tag's own entry. */
+	std::vector<sSkipEntry> m_SkipIndex;
 
 	// Used while parsing:
 	size_t m_Pos;
 
+	/** The skip index entry of the next Compound or List tag to be read while expanding a tag (lazy parsing). */
+	int m_NextSkipEntry;
+
 	bool Parse(void);
 	bool ReadString(size_t & a_StringStart, size_t & a_StringLen);  // Reads a simple string (2 bytes length + data), sets the string descriptors
-	bool ReadCompound(void);  // Reads the latest tag as a compound
-	bool ReadList(eTagType a_ChildrenType);  // Reads the latest tag as a list of items of type a_ChildrenType
+	bool ReadCompound(int a_ParentIdx);  // Reads the children of the specified tag as a compound
+	bool ReadList(eTagType a_ChildrenType, int a_ParentIdx);  // Reads the children of the specified tag as a list of items of type a_ChildrenType
 	bool ReadTag(void);       // Reads the latest tag, depending on its m_Type setting
+
+	/** Reads the latest tag, a Compound or a List, without indexing its children (lazy parsing). */
+	bool ReadUnexpandedTag(void);
+
+	/** Skips over a tag's payload of the specified type, only adding its Compound and List tags to the skip index. */
+	bool SkipTag(eTagType a_Type);
+
+	/** Skips over the children of a compound, including the terminating TAG_End. */
+	bool SkipCompound(void);
+
+	/** Skips over the item type, count and items of a list. */
+	bool SkipList(void);
+
+	/** Indexes the direct children of the specified tag, if it hasn't been done yet (lazy parsing).
+	This doesn't change the tree as seen by the accessors, it only fills it in, hence the const. */
+	void Expand(int a_Tag) const
+	{
+		if (m_Tags[(size_t)a_Tag].m_SkipEntry >= 0)
+		{
+			const_cast<cParsedNBT *>(this)->ExpandTag(a_Tag);
+		}
+	}
+
+	/** Indexes the direct children of the specified unexpanded Compound or List tag. */
+	void ExpandTag(int a_Tag);
 } ;
 
 
@@ -276,7 +344,26 @@ protected:
 class cFastNBTWriter
 {
 public:
+	/** The interface for receiving the data from a streaming writer. */
+	class cOutput
+	{
+	public:
+		// Force a virtual destructor in descendants:
+		virtual ~cOutput() {}
+
+		/** Called with the next part of the serialized data, in order. */
+		virtual void Write(const char * a_Data, size_t a_Size) = 0;
+	} ;
+
+
 	cFastNBTWriter(const AString & a_RootTagName = "");
+
+	/** Creates a streaming writer, the serialized data is written into a_Output as soon as possible, instead of into the result string. */
+	cFastNBTWriter(cOutput & a_Output, const AString & a_RootTagName = "");
+
+	/** Discards all the data written so far and starts a new NBT with the specified root tag.
+	The internal buffer is kept, so that a reused writer doesn't need to allocate memory. */
+	void Reset(const AString & a_RootTagName = "");
 	
 	void BeginCompound(const AString & a_Name);
 	void EndCompound(void);
@@ -284,6 +371,10 @@ public:
 	void BeginList(const AString & a_Name, eTagType a_ChildrenType);
 	void EndList(void);
 	
+	/** Begins a list with the count known upfront; exactly a_Count items need to be added before EndList().
+	Unlike the other overload, this allows the list's items to be streamed into the output. */
+	void BeginList(const AString & a_Name, eTagType a_ChildrenType, int a_Count);
+	
 	void AddByte     (const AString & a_Name, unsigned char a_Value);
 	void AddShort    (const AString & a_Name, Int16 a_Value);
 	void AddInt      (const AString & a_Name, Int32 a_Value);
@@ -299,6 +390,7 @@ public:
 		AddByteArray(a_Name, a_Value.data(), a_Value.size());
 	}
 	
+	/** Returns the serialized data. For a streaming writer, returns only the data not yet written to the output (none after Finish()). */
 	const AString & GetResult(void) const {return m_Result; }
 	
 	void Finish(void);
@@ -310,19 +402,41 @@ protected:
 		int m_Type;   // TAG_Compound or TAG_List
 		int m_Pos;    // for TAG_List, the position of the list count
 		int m_Count;  // for TAG_List, the element count
+		int m_ExpectedCount;  // for TAG_List, the element count if it was written upfront, -1 if the count is written in EndList()
 		eTagType m_ItemType;  // for TAG_List, the element type
 	} ;
 	
 	static const int MAX_STACK = 50;  // Highly doubtful that an NBT would be constructed this many levels deep
 	
+	/** The amount of data that a streaming writer buffers before writing it into the output. */
+	static const size_t STREAM_BUFFER_SIZE = 16 * 1024;
+	
 	// These two fields emulate a stack. A raw array is used due to speed issues - no reallocations are allowed.
 	sParent m_Stack[MAX_STACK];
 	int     m_CurrentStack;
 	
 	AString m_Result;
 	
+	/** The output for a streaming writer, nullptr for a writer producing the result string. */
+	cOutput * m_Output;
+	
 	bool IsStackTopCompound(void) const { return (m_Stack[m_CurrentStack].m_Type == TAG_Compound); }
 	
+	/** Writes as much of the buffered data as possible into m_Output. */
+	void Flush(void);
+	
+	/** Returns true if all the buffered data can be written into m_Output, i.e. no list count is waiting to be filled in. */
+	bool CanFlushAll(void) const;
+	
+	/** For a streaming writer, writes the buffered data into m_Output once there's enough of it. */
+	inline void FlushIfFull(void)
+	{
+		if ((m_Output != nullptr) && (m_Result.size() >= STREAM_BUFFER_SIZE))
+		{
+			Flush();
+		}
+	}
+	
 	void WriteString(const char * a_Data, UInt16 a_Length);
 	
 	inline void TagCommon(const AString & a_Name, eTagType a_Type)
@@ -0,0 +1,146 @@
+// MCAFormat.cpp
+
+// Implements the helpers for the layout of the Anvil region (MCA) files: the sector allocation map and the region file names
+
+#include "Globals.h"
+#include "MCAFormat.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cMCASectorMap:
+
+void cMCASectorMap::Build(const unsigned * a_Header, size_t a_NumChunks, int a_FileSize)
+{
+	m_UsedSectors.assign(static_cast<size_t>((std::max(a_FileSize, 0) + 4095) / 4096), false);
+	MarkSectors(0, 2, true);  // The header
+	for (size_t i = 0; i < a_NumChunks; i++)
+	{
+		unsigned ChunkLocation = ntohl(a_Header[i]);
+		if (((ChunkLocation >> 8) >= 2) && ((ChunkLocation & 0xff) > 0))
+		{
+			MarkSectors(ChunkLocation >> 8, ChunkLocation & 0xff, true);
+		}
+	}  // for i - a_Header[]
+	m_PendingFreeSectors.clear();
+}
+
+
+
+
+
+unsigned cMCASectorMap::Allocate(unsigned a_ChunkLocation, unsigned a_NumSectors)
+{
+	ASSERT(a_NumSectors > 0);
+
+	// See if it fits the current location:
+	unsigned ChunkOffset = a_ChunkLocation >> 8;
+	unsigned ChunkLen = a_ChunkLocation & 0xff;
+	bool HasLocation = (ChunkOffset >= 2) && (ChunkLen > 0);
+	if (HasLocation && (a_NumSectors <= ChunkLen))
+	{
+		if (a_NumSectors < ChunkLen)
+		{
+			m_PendingFreeSectors.push_back(cSectorRange(ChunkOffset + a_NumSectors, ChunkLen - a_NumSectors));
+		}
+		return ChunkOffset;
+	}
+	if (HasLocation)
+	{
+		m_PendingFreeSectors.push_back(cSectorRange(ChunkOffset, ChunkLen));
+	}
+	
+	// Doesn't fit, find the smallest free gap that is large enough:
+	unsigned BestStart = 0;
+	unsigned BestLen = 0;
+	unsigned NumSectorsTotal = static_cast<unsigned>(m_UsedSectors.size());
+	for (unsigned i = 2; i < NumSectorsTotal;)
+	{
+		if (m_UsedSectors[i])
+		{
+			i++;
+			continue;
+		}
+		unsigned GapStart = i;
+		while ((i < NumSectorsTotal) && !m_UsedSectors[i])
+		{
+			i++;
+		}
+		unsigned GapLen = i - GapStart;
+		if ((GapLen >= a_NumSectors) && ((BestLen == 0) || (GapLen < BestLen)))
+		{
+			BestStart = GapStart;
+			BestLen = GapLen;
+			if (GapLen == a_NumSectors)
+			{
+				// Cannot get any better
+				break;
+			}
+		}
+	}  // for i - m_UsedSectors[]
+	if (BestLen == 0)
+	{
+		// No gap large enough, append to the end of the file:
+		BestStart = std::max(NumSectorsTotal, 2u);
+	}
+	MarkSectors(BestStart, a_NumSectors, true);
+	return BestStart;
+}
+
+
+
+
+
+void cMCASectorMap::ReleasePending(void)
+{
+	for (cSectorRanges::const_iterator itr = m_PendingFreeSectors.begin(), end = m_PendingFreeSectors.end(); itr != end; ++itr)
+	{
+		MarkSectors(itr->first, itr->second, false);
+	}
+	m_PendingFreeSectors.clear();
+}
+
+
+
+
+
+void cMCASectorMap::MarkSectors(unsigned a_FirstSector, unsigned a_NumSectors, bool a_IsUsed)
+{
+	size_t End = static_cast<size_t>(a_FirstSector) + a_NumSectors;
+	if (m_UsedSectors.size() < End)
+	{
+		m_UsedSectors.resize(End, false);
+	}
+	std::fill(m_UsedSectors.begin() + a_FirstSector, m_UsedSectors.begin() + static_cast<std::ptrdiff_t>(End), a_IsUsed);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Globals:
+
+bool ParseRegionFileName(const AString & a_FileName, const AString & a_Suffix, int & a_RegionX, int & a_RegionZ)
+{
+	int RegionX, RegionZ;
+	if (sscanf(a_FileName.c_str(), "r.%d.%d.mca", &RegionX, &RegionZ) != 2)
+	{
+		return false;
+	}
+
+	// sscanf() accepts spaces, plus signs and leading zeros, and ignores anything after the match; only accept the canonical name:
+	if (a_FileName != Printf("r.%d.%d.mca%s", RegionX, RegionZ, a_Suffix.c_str()))
+	{
+		return false;
+	}
+	a_RegionX = RegionX;
+	a_RegionZ = RegionZ;
+	return true;
+}
+
+
+
+
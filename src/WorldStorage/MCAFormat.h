@@ -0,0 +1,71 @@
+// MCAFormat.h
+
+// Declares the helpers for the layout of the Anvil region (MCA) files: the sector allocation map and the region file names
+
+/*
+These are kept apart from cWSSAnvil so that they can be used and tested without the rest of the storage.
+*/
+
+
+
+
+
+#pragma once
+
+
+
+
+
+/** Tracks which 4 KiB sectors of a region file are used by the header or by a chunk, and allocates sectors for the chunks written into the file.
+Sectors released by a chunk are kept pending until ReleasePending() is called, after the header no longer pointing to them has been written,
+so that a chunk written later cannot overwrite data that the header in the file still points to. Not thread-safe, the owner locks it. */
+class cMCASectorMap
+{
+public:
+
+	/** Rebuilds the map from the header's chunk locations (in network byte order) and the file size. Drops the pending sectors. */
+	void Build(const unsigned * a_Header, size_t a_NumChunks, int a_FileSize);
+
+	/** Allocates a_NumSectors sectors for a chunk currently stored at a_ChunkLocation (header item, host byte order; 0 if not stored)
+	and releases the sectors it used before. Returns the first allocated sector.
+	If the chunk still fits into its current location, the location is reused; otherwise the smallest free gap
+	large enough is used (best fit), or new sectors are appended at the end of the file. */
+	unsigned Allocate(unsigned a_ChunkLocation, unsigned a_NumSectors);
+
+	/** Marks the sectors released by Allocate() since the last call as free. To be called after the header has been written into the file. */
+	void ReleasePending(void);
+
+	/** Returns true if the specified sector is used. Sectors past the end of the map are free. */
+	bool IsUsed(unsigned a_Sector) const { return (a_Sector < m_UsedSectors.size()) && m_UsedSectors[a_Sector]; }
+
+	/** Returns the number of sectors in the map; the file is at least this large once the allocated chunks are written. */
+	unsigned GetNumSectors(void) const { return static_cast<unsigned>(m_UsedSectors.size()); }
+
+protected:
+
+	/** A range of sectors in the file: the first sector and the number of sectors. */
+	typedef std::pair<unsigned, unsigned> cSectorRange;
+	typedef std::vector<cSectorRange> cSectorRanges;
+
+	/** The sector allocation bitmap: true for each sector used by the header or by a chunk, false for free sectors. */
+	std::vector<bool> m_UsedSectors;
+
+	/** Sectors released by Allocate() and not yet freed by ReleasePending(). */
+	cSectorRanges m_PendingFreeSectors;
+
+
+	/** Marks the specified sectors in m_UsedSectors, growing it as needed. */
+	void MarkSectors(unsigned a_FirstSector, unsigned a_NumSectors, bool a_IsUsed);
+} ;
+
+
+
+
+
+/** Parses the region coords from a file name that is exactly "r.<x>.<z>.mca" followed by a_Suffix (may be empty).
+Returns false for any other file name, such as "r.1.2.mca.bak". */
+extern bool ParseRegionFileName(const AString & a_FileName, const AString & a_Suffix, int & a_RegionX, int & a_RegionZ);
+
+
+
+
@@ -69,8 +69,24 @@ cNBTChunkSerializer::cNBTChunkSerializer(cFastNBTWriter & a_Writer) :
 
 
 
+void cNBTChunkSerializer::Reset(void)
+{
+	m_BiomesAreValid = false;
+	m_IsTagOpen = false;
+	m_HasHadEntity = false;
+	m_HasHadBlockEntity = false;
+	m_IsLightValid = false;
+}
+
+
+
+
+
 void cNBTChunkSerializer::Finish(void)
 {
+	// Fill the block data buffers, now that the chunk is no longer locked:
+	ExpandSnapshot();
+
 	if (m_IsTagOpen)
 	{
 		m_Writer.EndList();
@@ -66,7 +66,10 @@ public:
 
 	cNBTChunkSerializer(cFastNBTWriter & a_Writer);
 
-	/// Close NBT tags that we've opened
+	/** Prepares the serializer for another chunk, so that a single instance (with its large arrays) can be reused. */
+	void Reset(void);
+
+	/// Close NBT tags that we've opened and fill the block data buffers; call after the chunk data has been queried
 	void Finish(void);
 	
 	bool IsLightValid(void) const {return m_IsLightValid; }
@@ -68,6 +68,19 @@ Since only the header is actually in the memory, this number can be high, but st
 */
 #define MAX_MCA_FILES 32
 
+/** Number of attempts to read a chunk from the file mapping before falling back to reading under the file lock.
+An attempt fails when the chunk is written while being read. */
+#define MAX_MAPPED_READ_ATTEMPTS 3
+
+/** Maximum number of prefetched chunks kept per MCA file; the oldest ones are dropped when more are prefetched. */
+#define MAX_PREFETCHED_CHUNKS 64
+
+/** Maximum number of sectors that are read at once when prefetching (1 MiB). */
+#define MAX_PREFETCH_READ_SECTORS 256
+
+/** Maximum number of unwanted sectors between two prefetched chunks for them to be still read together. */
+#define MAX_PREFETCH_GAP_SECTORS 8
+
 #define LOAD_FAILED(CHX, CHZ) \
 	{ \
 		const int RegionX = FAST_FLOOR_DIV(CHX, 32); \
@@ -85,6 +98,65 @@ Since only the header is actually in the memory, this number can be high, but st
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// cWSSAnvil::cSaveScratch:
+
+/** The objects needed for serializing and compressing a chunk, kept between the saves so that saving doesn't allocate memory.
+The NBT writer streams its output into the deflater, which appends the compressed data to the output string;
+the serializer's arrays are too large for the stack anyway. */
+class cWSSAnvil::cSaveScratch :
+	public cFastNBTWriter::cOutput
+{
+public:
+	cFastNBTWriter      m_Writer;
+	cNBTChunkSerializer m_Serializer;
+	cZlibDeflater       m_Deflater;
+
+	/** The compressed data of the chunks in a batch; the strings keep their buffers between the batches. */
+	AStringVector m_Data;
+
+
+	cSaveScratch(void) :
+		m_Writer(*this),
+		m_Serializer(m_Writer),
+		m_DeflateResult(Z_OK)
+	{
+	}
+
+	/** Prepares the objects for saving another chunk, whose compressed data is to be appended to a_Output. Returns true on success. */
+	bool Begin(int a_CompressionFactor, AString & a_Output)
+	{
+		m_Writer.Reset();
+		m_Serializer.Reset();
+		m_DeflateResult = m_Deflater.Begin(a_CompressionFactor, a_Output);
+		return (m_DeflateResult == Z_OK);
+	}
+
+	/** Finishes the compressed data. Returns true if all the data has been compressed successfully. */
+	bool End(void)
+	{
+		int res = m_Deflater.End();
+		return ((m_DeflateResult == Z_OK) && (res == Z_OK));
+	}
+
+protected:
+	/** The first error reported by the deflater while streaming, Z_OK if none. */
+	int m_DeflateResult;
+
+	// cFastNBTWriter::cOutput override:
+	virtual void Write(const char * a_Data, size_t a_Size) override
+	{
+		if (m_DeflateResult == Z_OK)
+		{
+			m_DeflateResult = m_Deflater.Write(a_Data, a_Size);
+		}
+	}
+} ;
+
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // cWSSAnvil:
 
@@ -141,11 +213,16 @@ cWSSAnvil::cWSSAnvil(cWorld * a_World, int a_CompressionFactor) :
 
 cWSSAnvil::~cWSSAnvil()
 {
-	cCSLock Lock(m_CS);
-	for (cMCAFiles::iterator itr = m_Files.begin(); itr != m_Files.end(); ++itr)
+	{
+		cCSLock Lock(m_CS);
+		m_Files.clear();
+	}
+	cCSLock Lock(m_CSSaveScratches);
+	for (cSaveScratches::iterator itr = m_SaveScratches.begin(), end = m_SaveScratches.end(); itr != end; ++itr)
 	{
 		delete *itr;
-	}  // for itr - m_Files[]
+	}
+	m_SaveScratches.clear();
 }
 
 
@@ -154,14 +231,14 @@ cWSSAnvil::~cWSSAnvil()
 
 bool cWSSAnvil::LoadChunk(const cChunkCoords & a_Chunk)
 {
-	AString ChunkData;
-	if (!GetChunkData(a_Chunk, ChunkData))
+	AString Uncompressed;
+	if (!GetUncompressedChunkData(a_Chunk, Uncompressed))
 	{
-		// The reason for failure is already printed in GetChunkData()
+		// The reason for failure is already printed in GetUncompressedChunkData()
 		return false;
 	}
 	
-	return LoadChunkFromData(a_Chunk, ChunkData);
+	return LoadChunkFromData(a_Chunk, Uncompressed);
 }
 
 
@@ -170,35 +247,92 @@ bool cWSSAnvil::LoadChunk(const cChunkCoords & a_Chunk)
 
 bool cWSSAnvil::SaveChunk(const cChunkCoords & a_Chunk)
 {
-	AString ChunkData;
-	if (!SaveChunkToData(a_Chunk, ChunkData))
+	cSaveScratch * Scratch = AcquireSaveScratch();
+	if (Scratch->m_Data.empty())
+	{
+		Scratch->m_Data.resize(1);
+	}
+	AString & ChunkData = Scratch->m_Data.front();
+	bool res = false;
+	if (!SaveChunkToData(a_Chunk, *Scratch, ChunkData))
 	{
 		LOGWARNING("Cannot serialize chunk [%d, %d] into data", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
-		return false;
 	}
-	if (!SetChunkData(a_Chunk, ChunkData))
+	else if (!SetChunkData(a_Chunk, ChunkData))
 	{
 		LOGWARNING("Cannot store chunk [%d, %d] data", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
-		return false;
 	}
-	
-	// Everything successful
-	return true;
+	else
+	{
+		// Everything successful
+		res = true;
+	}
+	ReleaseSaveScratch(Scratch);
+	return res;
 }
 
 
 
 
 
-bool cWSSAnvil::GetChunkData(const cChunkCoords & a_Chunk, AString & a_Data)
+void cWSSAnvil::SaveChunks(const cChunkCoordsVector & a_Chunks, std::vector<bool> & a_IsSaved)
 {
-	cCSLock Lock(m_CS);
-	cMCAFile * File = LoadMCAFile(a_Chunk);
+	a_IsSaved.clear();
+	if (a_Chunks.empty())
+	{
+		return;
+	}
+
+	// Serialize and compress all the chunks first, without holding any file lock.
+	// The data strings are kept in the scratch, so that their buffers get reused by the next batch:
+	cSaveScratch * Scratch = AcquireSaveScratch();
+	AStringVector & Data = Scratch->m_Data;
+	if (Data.size() < a_Chunks.size())
+	{
+		Data.resize(a_Chunks.size());
+	}
+	for (size_t i = 0; i < a_Chunks.size(); i++)
+	{
+		if (!SaveChunkToData(a_Chunks[i], *Scratch, Data[i]))
+		{
+			LOGWARNING("Cannot serialize chunk [%d, %d] into data", a_Chunks[i].m_ChunkX, a_Chunks[i].m_ChunkZ);
+			Data[i].clear();
+		}
+	}
+
+	// Write all the chunks into the region file at once:
+	cMCAFilePtr File;
+	{
+		cCSLock Lock(m_CS);
+		File = LoadMCAFile(a_Chunks.front());
+	}
+	if (File == nullptr)
+	{
+		a_IsSaved.assign(a_Chunks.size(), false);
+	}
+	else
+	{
+		File->SetChunksData(a_Chunks, Data, a_IsSaved);
+	}
+	ReleaseSaveScratch(Scratch);
+}
+
+
+
+
+
+bool cWSSAnvil::GetUncompressedChunkData(const cChunkCoords & a_Chunk, AString & a_Uncompressed)
+{
+	cMCAFilePtr File;
+	{
+		cCSLock Lock(m_CS);
+		File = LoadMCAFile(a_Chunk);
+	}
 	if (File == nullptr)
 	{
 		return false;
 	}
-	return File->GetChunkData(a_Chunk, a_Data);
+	return File->GetUncompressedChunkData(a_Chunk, a_Uncompressed);
 }
 
 
@@ -207,8 +341,11 @@ bool cWSSAnvil::GetChunkData(const cChunkCoords & a_Chunk, AString & a_Data)
 
 bool cWSSAnvil::SetChunkData(const cChunkCoords & a_Chunk, const AString & a_Data)
 {
-	cCSLock Lock(m_CS);
-	cMCAFile * File = LoadMCAFile(a_Chunk);
+	cMCAFilePtr File;
+	{
+		cCSLock Lock(m_CS);
+		File = LoadMCAFile(a_Chunk);
+	}
 	if (File == nullptr)
 	{
 		return false;
@@ -220,7 +357,35 @@ bool cWSSAnvil::SetChunkData(const cChunkCoords & a_Chunk, const AString & a_Dat
 
 
 
-cWSSAnvil::cMCAFile * cWSSAnvil::LoadMCAFile(const cChunkCoords & a_Chunk)
+void cWSSAnvil::PrefetchChunks(const cChunkCoordsVector & a_Chunks)
+{
+	// Split the chunks by their regions:
+	std::map<std::pair<int, int>, cChunkCoordsVector> Regions;
+	for (cChunkCoordsVector::const_iterator itr = a_Chunks.begin(), end = a_Chunks.end(); itr != end; ++itr)
+	{
+		Regions[std::make_pair(FAST_FLOOR_DIV(itr->m_ChunkX, 32), FAST_FLOOR_DIV(itr->m_ChunkZ, 32))].push_back(*itr);
+	}
+
+	// Prefetch from each region file:
+	for (auto itr = Regions.begin(), end = Regions.end(); itr != end; ++itr)
+	{
+		cMCAFilePtr File;
+		{
+			cCSLock Lock(m_CS);
+			File = LoadMCAFile(itr->second.front());
+		}
+		if (File != nullptr)
+		{
+			File->PrefetchChunks(itr->second);
+		}
+	}
+}
+
+
+
+
+
+cWSSAnvil::cMCAFilePtr cWSSAnvil::LoadMCAFile(const cChunkCoords & a_Chunk)
 {
 	// ASSUME m_CS is locked
 	ASSERT(m_CS.IsLocked());
@@ -238,7 +403,7 @@ cWSSAnvil::cMCAFile * cWSSAnvil::LoadMCAFile(const cChunkCoords & a_Chunk)
 		if (((*itr) != nullptr) && ((*itr)->GetRegionX() == RegionX) && ((*itr)->GetRegionZ() == RegionZ))
 		{
 			// Move the file to front and return it:
-			cMCAFile * f = *itr;
+			cMCAFilePtr f = *itr;
 			if (itr != m_Files.begin())
 			{
 				m_Files.erase(itr);
@@ -253,18 +418,22 @@ cWSSAnvil::cMCAFile * cWSSAnvil::LoadMCAFile(const cChunkCoords & a_Chunk)
 	Printf(FileName, "%s/region", m_World->GetName().c_str());
 	cFile::CreateFolder(FILE_IO_PREFIX + FileName);
 	AppendPrintf(FileName, "/r.%d.%d.mca", RegionX, RegionZ);
-	cMCAFile * f = new cMCAFile(FileName, RegionX, RegionZ);
-	if (f == nullptr)
-	{
-		return nullptr;
-	}
+	cMCAFilePtr f = std::make_shared<cMCAFile>(FileName, RegionX, RegionZ);
 	m_Files.push_front(f);
 	
-	// If there are too many MCA files cached, delete the last one used:
+	// If there are too many MCA files cached, remove the least recently used one that is not in use by another thread
+	// (a file in use must stay in the cache, otherwise another cMCAFile object could be opened for the same file):
 	if (m_Files.size() > MAX_MCA_FILES)
 	{
-		delete m_Files.back();
-		m_Files.pop_back();
+		for (cMCAFiles::iterator itr = m_Files.end(); itr != m_Files.begin();)
+		{
+			--itr;
+			if (itr->unique())
+			{
+				m_Files.erase(itr);
+				break;
+			}
+		}
 	}
 	return f;
 }
@@ -273,20 +442,79 @@ cWSSAnvil::cMCAFile * cWSSAnvil::LoadMCAFile(const cChunkCoords & a_Chunk)
 
 
 
-bool cWSSAnvil::LoadChunkFromData(const cChunkCoords & a_Chunk, const AString & a_Data)
+void cWSSAnvil::CompactRegionFiles(void)
 {
-	// Uncompress the data:
-	AString Uncompressed;
-	int res = InflateString(a_Data.data(), a_Data.size(), Uncompressed);
-	if (res != Z_OK)
+	AString Folder;
+	Printf(Folder, "%s/region", m_World->GetName().c_str());
+	AStringVector Files = cFile::GetFolderContents(FILE_IO_PREFIX + Folder);
+	unsigned NumFiles = 0;
+	unsigned NumSectorsBefore = 0;
+	unsigned NumSectorsAfter = 0;
+
+	// Clean up the temporary files left over by an interrupted compaction:
+	AStringVector RestoredFiles;
+	for (AStringVector::iterator itr = Files.begin(); itr != Files.end();)
 	{
-		LOGWARNING("Uncompressing chunk [%d, %d] failed: %d", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, res);
-		LOAD_FAILED(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
-		return false;
+		int RegionX, RegionZ;
+		if (!ParseRegionFileName(*itr, ".compact", RegionX, RegionZ))
+		{
+			++itr;
+			continue;
+		}
+		AString TempFileName = FILE_IO_PREFIX + Folder + "/" + *itr;
+		AString RegionFileName = TempFileName.substr(0, TempFileName.size() - 8);  // Strip the ".compact"
+		if (cFile::IsFile(RegionFileName))
+		{
+			// The original is intact, the temp file is an unfinished copy:
+			LOG("Removing stale temporary file \"%s\"", TempFileName.c_str());
+			cFile::Delete(TempFileName);
+		}
+		else if (cFile::Rename(TempFileName, RegionFileName))
+		{
+			// The original was deleted but the compacted copy hasn't been renamed over it:
+			LOG("Restoring region file \"%s\" from an interrupted compaction", RegionFileName.c_str());
+			RestoredFiles.push_back(itr->substr(0, itr->size() - 8));
+		}
+		itr = Files.erase(itr);
 	}
-	
-	// Parse the NBT data:
-	cParsedNBT NBT(Uncompressed.data(), Uncompressed.size());
+	Files.insert(Files.end(), RestoredFiles.begin(), RestoredFiles.end());
+
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); itr != end; ++itr)
+	{
+		// Only process the files named exactly "r.<x>.<z>.mca":
+		int RegionX, RegionZ;
+		if (!ParseRegionFileName(*itr, "", RegionX, RegionZ))
+		{
+			continue;
+		}
+
+		// Compact through the cached file object, so that the loaders and savers see the new layout:
+		cMCAFilePtr File;
+		{
+			cCSLock Lock(m_CS);
+			File = LoadMCAFile(cChunkCoords(RegionX * 32, RegionZ * 32));
+		}
+		unsigned Before, After;
+		if (File->Compact(Before, After))
+		{
+			NumFiles += 1;
+			NumSectorsBefore += Before;
+			NumSectorsAfter += After;
+		}
+	}  // for itr - Files[]
+	LOG("World \"%s\": compacted %u region files, %u KiB freed (%u KiB -> %u KiB)",
+		m_World->GetName().c_str(), NumFiles, (NumSectorsBefore - NumSectorsAfter) * 4, NumSectorsBefore * 4, NumSectorsAfter * 4
+	);
+}
+
+
+
+
+
+bool cWSSAnvil::LoadChunkFromData(const cChunkCoords & a_Chunk, const AString & a_Uncompressed)
+{
+	// Parse the NBT data; lazily, so that the tags that the loader doesn't use are only skipped over:
+	cParsedNBT NBT(a_Uncompressed.data(), a_Uncompressed.size(), true);
 	if (!NBT.IsValid())
 	{
 		// NBT Parsing failed
@@ -302,17 +530,27 @@ bool cWSSAnvil::LoadChunkFromData(const cChunkCoords & a_Chunk, const AString &
 
 
 
-bool cWSSAnvil::SaveChunkToData(const cChunkCoords & a_Chunk, AString & a_Data)
+bool cWSSAnvil::SaveChunkToData(const cChunkCoords & a_Chunk, cSaveScratch & a_Scratch, AString & a_Data)
 {
-	cFastNBTWriter Writer;
-	if (!SaveChunkToNBT(a_Chunk, Writer))
+	// The writer streams the NBT directly into the deflater, which appends to a_Data:
+	a_Data.clear();
+	if (!a_Scratch.Begin(m_CompressionFactor, a_Data))
+	{
+		LOGWARNING("Cannot initialize the compressor for chunk [%d, %d]", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		return false;
+	}
+	if (!SaveChunkToNBT(a_Chunk, a_Scratch.m_Writer, a_Scratch.m_Serializer))
 	{
 		LOGWARNING("Cannot save chunk [%d, %d] to NBT", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		a_Scratch.End();
+		return false;
+	}
+	a_Scratch.m_Writer.Finish();
+	if (!a_Scratch.End())
+	{
+		LOGWARNING("Cannot compress chunk [%d, %d] data", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
 		return false;
 	}
-	Writer.Finish();
-	
-	CompressString(Writer.GetResult().data(), Writer.GetResult().size(), a_Data, m_CompressionFactor);
 	return true;
 }
 
@@ -320,6 +558,34 @@ bool cWSSAnvil::SaveChunkToData(const cChunkCoords & a_Chunk, AString & a_Data)
 
 
 
+cWSSAnvil::cSaveScratch * cWSSAnvil::AcquireSaveScratch(void)
+{
+	{
+		cCSLock Lock(m_CSSaveScratches);
+		if (!m_SaveScratches.empty())
+		{
+			cSaveScratch * res = m_SaveScratches.back();
+			m_SaveScratches.pop_back();
+			return res;
+		}
+	}
+	return new cSaveScratch;
+}
+
+
+
+
+
+void cWSSAnvil::ReleaseSaveScratch(cSaveScratch * a_Scratch)
+{
+	cCSLock Lock(m_CSSaveScratches);
+	m_SaveScratches.push_back(a_Scratch);
+}
+
+
+
+
+
 bool cWSSAnvil::LoadChunkFromNBT(const cChunkCoords & a_Chunk, const cParsedNBT & a_NBT)
 {
 	// The data arrays, in MCA-native y/z/x ordering (will be reordered for the final chunk data)
@@ -453,42 +719,41 @@ void cWSSAnvil::CopyNBTData(const cParsedNBT & a_NBT, int a_Tag, const AString &
 
 
 
-bool cWSSAnvil::SaveChunkToNBT(const cChunkCoords & a_Chunk, cFastNBTWriter & a_Writer)
+bool cWSSAnvil::SaveChunkToNBT(const cChunkCoords & a_Chunk, cFastNBTWriter & a_Writer, cNBTChunkSerializer & a_Serializer)
 {
 	a_Writer.BeginCompound("Level");
 	a_Writer.AddInt("xPos", a_Chunk.m_ChunkX);
 	a_Writer.AddInt("zPos", a_Chunk.m_ChunkZ);
 
-	cNBTChunkSerializer Serializer(a_Writer);
-	if (!m_World->GetChunkData(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, Serializer))
+	if (!m_World->GetChunkData(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, a_Serializer))
 	{
 		LOGWARNING("Cannot get chunk [%d, %d] data for NBT saving", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
 		return false;
 	}
-	Serializer.Finish();  // Close NBT tags
+	a_Serializer.Finish();  // Close NBT tags
 	
 	// Save biomes, both MCS (IntArray) and MC-vanilla (ByteArray):
-	if (Serializer.m_BiomesAreValid)
+	if (a_Serializer.m_BiomesAreValid)
 	{
-		a_Writer.AddByteArray("Biomes",    (const char *)(Serializer.m_VanillaBiomes), ARRAYCOUNT(Serializer.m_VanillaBiomes));
-		a_Writer.AddIntArray ("MCSBiomes", (const int *)(Serializer.m_Biomes),         ARRAYCOUNT(Serializer.m_Biomes));
+		a_Writer.AddByteArray("Biomes",    (const char *)(a_Serializer.m_VanillaBiomes), ARRAYCOUNT(a_Serializer.m_VanillaBiomes));
+		a_Writer.AddIntArray ("MCSBiomes", (const int *)(a_Serializer.m_Biomes),         ARRAYCOUNT(a_Serializer.m_Biomes));
 	}
 
 	// Save heightmap (Vanilla require this):
-	a_Writer.AddIntArray("HeightMap", (const int *)Serializer.m_VanillaHeightMap, ARRAYCOUNT(Serializer.m_VanillaHeightMap));
+	a_Writer.AddIntArray("HeightMap", (const int *)a_Serializer.m_VanillaHeightMap, ARRAYCOUNT(a_Serializer.m_VanillaHeightMap));
 
-	// Save blockdata:
-	a_Writer.BeginList("Sections", TAG_Compound);
+	// Save blockdata; the section count is known upfront, so that the sections can be streamed:
+	a_Writer.BeginList("Sections", TAG_Compound, 16);
 	size_t SliceSizeBlock  = cChunkDef::Width * cChunkDef::Width * 16;
 	size_t SliceSizeNibble = SliceSizeBlock / 2;
-	const char * BlockTypes    = (const char *)(Serializer.m_BlockTypes);
-	const char * BlockMetas    = (const char *)(Serializer.m_BlockMetas);
+	const char * BlockTypes    = (const char *)(a_Serializer.m_BlockTypes);
+	const char * BlockMetas    = (const char *)(a_Serializer.m_BlockMetas);
 	#ifdef DEBUG_SKYLIGHT
-		const char * BlockLight  = (const char *)(Serializer.m_BlockSkyLight);
+		const char * BlockLight  = (const char *)(a_Serializer.m_BlockSkyLight);
 	#else
-		const char * BlockLight  = (const char *)(Serializer.m_BlockLight);
+		const char * BlockLight  = (const char *)(a_Serializer.m_BlockLight);
 	#endif
-	const char * BlockSkyLight = (const char *)(Serializer.m_BlockSkyLight);
+	const char * BlockSkyLight = (const char *)(a_Serializer.m_BlockSkyLight);
 	for (int Y = 0; Y < 16; Y++)
 	{
 		a_Writer.BeginCompound("");
@@ -503,7 +768,7 @@ bool cWSSAnvil::SaveChunkToNBT(const cChunkCoords & a_Chunk, cFastNBTWriter & a_
 	
 	// Store the information that the lighting is valid.
 	// For compatibility reason, the default is "invalid" (missing) - this means older data is re-lighted upon loading.
-	if (Serializer.IsLightValid())
+	if (a_Serializer.IsLightValid())
 	{
 		a_Writer.AddByte("MCSIsLightValid", 1);
 	}
@@ -2961,7 +3226,8 @@ bool cWSSAnvil::GetBlockEntityNBTPos(const cParsedNBT & a_NBT, int a_TagIdx, int
 cWSSAnvil::cMCAFile::cMCAFile(const AString & a_FileName, int a_RegionX, int a_RegionZ) :
 	m_RegionX(a_RegionX),
 	m_RegionZ(a_RegionZ),
-	m_FileName(a_FileName)
+	m_FileName(a_FileName),
+	m_WriteGeneration(0)
 {
 }
 
@@ -2994,22 +3260,33 @@ bool cWSSAnvil::cMCAFile::OpenFile(bool a_IsForReading)
 		return false;
 	}
 	
-	// Load the header:
-	if (m_File.Read(m_Header, sizeof(m_Header)) != sizeof(m_Header))
+	// Map the file for reading and take the header directly from the mapping, if possible:
+	cMappedFilePtr Mapping = std::make_shared<cMappedFile>();
+	if (Mapping->Map(m_FileName) && (Mapping->GetSize() >= MCA_HEADER_SIZE))
 	{
-		// Cannot read the header - perhaps the file has just been created?
-		// Try writing a nullptr header for chunk offsets:
-		memset(m_Header, 0, sizeof(m_Header));
-		writeOutNeeded = true;
+		memcpy(m_Header, Mapping->GetData(), sizeof(m_Header));
+		memcpy(m_TimeStamps, Mapping->GetData() + sizeof(m_Header), sizeof(m_TimeStamps));
+		m_Mapping = Mapping;
 	}
-
-	// Load the TimeStamps:
-	if (m_File.Read(m_TimeStamps, sizeof(m_TimeStamps)) != sizeof(m_TimeStamps))
+	else
 	{
-		// Cannot read the time stamps - perhaps the file has just been created?
-		// Try writing a nullptr header for timestamps:
-		memset(m_TimeStamps, 0, sizeof(m_TimeStamps));
-		writeOutNeeded = true;
+		// Load the header:
+		if (m_File.Read(m_Header, sizeof(m_Header)) != sizeof(m_Header))
+		{
+			// Cannot read the header - perhaps the file has just been created?
+			// Try writing a nullptr header for chunk offsets:
+			memset(m_Header, 0, sizeof(m_Header));
+			writeOutNeeded = true;
+		}
+
+		// Load the TimeStamps:
+		if (m_File.Read(m_TimeStamps, sizeof(m_TimeStamps)) != sizeof(m_TimeStamps))
+		{
+			// Cannot read the time stamps - perhaps the file has just been created?
+			// Try writing a nullptr header for timestamps:
+			memset(m_TimeStamps, 0, sizeof(m_TimeStamps));
+			writeOutNeeded = true;
+		}
 	}
 	
 	if (writeOutNeeded)
@@ -3025,6 +3302,8 @@ bool cWSSAnvil::cMCAFile::OpenFile(bool a_IsForReading)
 			return false;
 		}
 	}
+	
+	m_SectorMap.Build(m_Header, ARRAYCOUNT(m_Header), m_File.GetSize());
 	return true;
 }
 
@@ -3034,6 +3313,7 @@ bool cWSSAnvil::cMCAFile::OpenFile(bool a_IsForReading)
 
 bool cWSSAnvil::cMCAFile::GetChunkData(const cChunkCoords & a_Chunk, AString & a_Data)
 {
+	cCSLock Lock(m_CS);
 	if (!OpenFile(true))
 	{
 		return false;
@@ -3093,14 +3373,323 @@ bool cWSSAnvil::cMCAFile::GetChunkData(const cChunkCoords & a_Chunk, AString & a
 
 
 
+bool cWSSAnvil::cMCAFile::GetUncompressedChunkData(const cChunkCoords & a_Chunk, AString & a_Uncompressed)
+{
+	int LocalX = a_Chunk.m_ChunkX % 32;
+	if (LocalX < 0)
+	{
+		LocalX = 32 + LocalX;
+	}
+	int LocalZ = a_Chunk.m_ChunkZ % 32;
+	if (LocalZ < 0)
+	{
+		LocalZ = 32 + LocalZ;
+	}
+
+	// Use the prefetched data, if available:
+	AString Compressed;
+	bool HasData;
+	{
+		cCSLock Lock(m_CS);
+		HasData = TakePrefetchedChunk(LocalX + 32 * LocalZ, Compressed);
+	}
+
+	// Otherwise inflate from the mapping, without holding the lock; retry if the chunk data is written meanwhile:
+	for (int i = 0; !HasData && (i < MAX_MAPPED_READ_ATTEMPTS); i++)
+	{
+		cMappedFilePtr Mapping;
+		const char * Data;
+		size_t Size;
+		unsigned Generation;
+		{
+			cCSLock Lock(m_CS);
+			if (!OpenFile(true))
+			{
+				return false;
+			}
+			if ((ntohl(m_Header[LocalX + 32 * LocalZ]) >> 8) < 2)
+			{
+				// Chunk not present in the file
+				return false;
+			}
+			if (!GetMappedChunkData(LocalX, LocalZ, Mapping, Data, Size))
+			{
+				break;
+			}
+			Generation = m_WriteGeneration;
+		}
+		int res = InflateString(Data, Size, a_Uncompressed);
+		if (m_WriteGeneration != Generation)
+		{
+			// The file has been written to while inflating, the data may be torn
+			continue;
+		}
+		if (res != Z_OK)
+		{
+			LOGWARNING("Uncompressing chunk [%d, %d] failed: %d", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, res);
+			LOAD_FAILED(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+			return false;
+		}
+		return true;
+	}
+
+	// Not prefetched and cannot use the mapping, read the data through the file:
+	if (!HasData && !GetChunkData(a_Chunk, Compressed))
+	{
+		return false;
+	}
+	int res = InflateString(Compressed.data(), Compressed.size(), a_Uncompressed);
+	if (res != Z_OK)
+	{
+		LOGWARNING("Uncompressing chunk [%d, %d] failed: %d", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, res);
+		LOAD_FAILED(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+bool cWSSAnvil::cMCAFile::GetMappedChunkData(int a_LocalX, int a_LocalZ, cMappedFilePtr & a_Mapping, const char *& a_Data, size_t & a_Size)
+{
+	size_t ChunkStart = static_cast<size_t>(ntohl(m_Header[a_LocalX + 32 * a_LocalZ]) >> 8) * 4096;
+
+	// Remap the file if the chunk header lies past the current mapping (the file has grown since mapped):
+	if ((m_Mapping == nullptr) || (m_Mapping->GetSize() < ChunkStart + MCA_CHUNK_HEADER_LENGTH))
+	{
+		cMappedFilePtr Mapping = std::make_shared<cMappedFile>();
+		if (!Mapping->Map(m_FileName))
+		{
+			return false;
+		}
+		m_Mapping = Mapping;
+		if (m_Mapping->GetSize() < ChunkStart + MCA_CHUNK_HEADER_LENGTH)
+		{
+			return false;
+		}
+	}
+
+	// Parse the chunk header:
+	const unsigned char * ChunkHeader = reinterpret_cast<const unsigned char *>(m_Mapping->GetData() + ChunkStart);
+	size_t ChunkSize = (static_cast<size_t>(ChunkHeader[0]) << 24) | (static_cast<size_t>(ChunkHeader[1]) << 16) | (static_cast<size_t>(ChunkHeader[2]) << 8) | ChunkHeader[3];
+	if ((ChunkSize < 1) || (ChunkHeader[4] != 2))
+	{
+		// Empty or in an unknown compression, let the regular read report it
+		return false;
+	}
+	ChunkSize -= 1;  // The compression type byte
+	if (m_Mapping->GetSize() < ChunkStart + MCA_CHUNK_HEADER_LENGTH + ChunkSize)
+	{
+		return false;
+	}
+
+	a_Mapping = m_Mapping;
+	a_Data = m_Mapping->GetData() + ChunkStart + MCA_CHUNK_HEADER_LENGTH;
+	a_Size = ChunkSize;
+	return true;
+}
+
+
+
+
+
+void cWSSAnvil::cMCAFile::PrefetchChunks(const cChunkCoordsVector & a_Chunks)
+{
+	cCSLock Lock(m_CS);
+	if (!OpenFile(true))
+	{
+		return;
+	}
+
+	// Get the locations of the chunks present in the file and not prefetched yet, in the order of their position in the file:
+	std::vector<std::pair<unsigned, int>> Locations;  // The location from the header and the chunk index into the header
+	for (cChunkCoordsVector::const_iterator itr = a_Chunks.begin(), end = a_Chunks.end(); itr != end; ++itr)
+	{
+		int LocalX = itr->m_ChunkX % 32;
+		if (LocalX < 0)
+		{
+			LocalX = 32 + LocalX;
+		}
+		int LocalZ = itr->m_ChunkZ % 32;
+		if (LocalZ < 0)
+		{
+			LocalZ = 32 + LocalZ;
+		}
+		int Index = LocalX + 32 * LocalZ;
+		unsigned Location = ntohl(m_Header[Index]);
+		if (((Location >> 8) < 2) || ((Location & 0xff) == 0))
+		{
+			// Chunk not present in the file
+			continue;
+		}
+		bool IsPrefetched = std::any_of(m_PrefetchedChunks.begin(), m_PrefetchedChunks.end(), [Index](const sPrefetchedChunk & a_Chunk)
+			{
+				return (a_Chunk.m_Index == Index);
+			}
+		);
+		if (!IsPrefetched)
+		{
+			Locations.push_back(std::make_pair(Location, Index));
+		}
+	}
+	std::sort(Locations.begin(), Locations.end());
+
+	// Read the chunks in runs of nearby sectors, each run with a single read:
+	size_t RunStart = 0;
+	while (RunStart < Locations.size())
+	{
+		unsigned FirstSector = Locations[RunStart].first >> 8;
+		unsigned EndSector = FirstSector + (Locations[RunStart].first & 0xff);
+		std::vector<int> Indices(1, Locations[RunStart].second);
+		size_t RunEnd = RunStart + 1;
+		for (; RunEnd < Locations.size(); RunEnd++)
+		{
+			unsigned Sector = Locations[RunEnd].first >> 8;
+			unsigned End = std::max(EndSector, Sector + (Locations[RunEnd].first & 0xff));
+			if ((Sector > EndSector + MAX_PREFETCH_GAP_SECTORS) || (End - FirstSector > MAX_PREFETCH_READ_SECTORS))
+			{
+				break;
+			}
+			EndSector = End;
+			Indices.push_back(Locations[RunEnd].second);
+		}
+		PrefetchSectors(FirstSector, EndSector - FirstSector, Indices);
+		RunStart = RunEnd;
+	}
+}
+
+
+
+
+
+bool cWSSAnvil::cMCAFile::TakePrefetchedChunk(int a_Index, AString & a_Data)
+{
+	for (cPrefetchedChunks::iterator itr = m_PrefetchedChunks.begin(), end = m_PrefetchedChunks.end(); itr != end; ++itr)
+	{
+		if (itr->m_Index == a_Index)
+		{
+			std::swap(a_Data, itr->m_Data);
+			m_PrefetchedChunks.erase(itr);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+void cWSSAnvil::cMCAFile::PrefetchSectors(unsigned a_FirstSector, unsigned a_NumSectors, const std::vector<int> & a_Chunks)
+{
+	// Read all the sectors; the last chunk in the file may be missing its padding, so a shorter read is fine:
+	AString Buffer;
+	Buffer.resize(static_cast<size_t>(a_NumSectors) * 4096);
+	if (m_File.Seek(static_cast<int>(a_FirstSector * 4096)) < 0)
+	{
+		return;
+	}
+	int NumRead = m_File.Read(&Buffer[0], Buffer.size());
+	if (NumRead <= 0)
+	{
+		return;
+	}
+	Buffer.resize(static_cast<size_t>(NumRead));
+
+	// Split the chunks out of the data read:
+	for (std::vector<int>::const_iterator itr = a_Chunks.begin(), end = a_Chunks.end(); itr != end; ++itr)
+	{
+		size_t ChunkStart = static_cast<size_t>((ntohl(m_Header[*itr]) >> 8) - a_FirstSector) * 4096;
+		if (ChunkStart + MCA_CHUNK_HEADER_LENGTH > Buffer.size())
+		{
+			continue;
+		}
+		const unsigned char * ChunkHeader = reinterpret_cast<const unsigned char *>(Buffer.data() + ChunkStart);
+		size_t ChunkSize = (static_cast<size_t>(ChunkHeader[0]) << 24) | (static_cast<size_t>(ChunkHeader[1]) << 16) | (static_cast<size_t>(ChunkHeader[2]) << 8) | ChunkHeader[3];
+		if ((ChunkSize < 1) || (ChunkHeader[4] != 2) || (ChunkStart + MCA_CHUNK_HEADER_LENGTH + ChunkSize - 1 > Buffer.size()))
+		{
+			// Empty, in an unknown compression or truncated, let the regular read report it
+			continue;
+		}
+
+		// Add to the cache, dropping the oldest item if full:
+		if (m_PrefetchedChunks.size() >= MAX_PREFETCHED_CHUNKS)
+		{
+			m_PrefetchedChunks.pop_front();
+		}
+		m_PrefetchedChunks.push_back(sPrefetchedChunk());
+		m_PrefetchedChunks.back().m_Index = *itr;
+		m_PrefetchedChunks.back().m_Data.assign(Buffer, ChunkStart + MCA_CHUNK_HEADER_LENGTH, ChunkSize - 1);
+	}
+}
+
+
+
+
+
 bool cWSSAnvil::cMCAFile::SetChunkData(const cChunkCoords & a_Chunk, const AString & a_Data)
 {
+	cCSLock Lock(m_CS);
 	if (!OpenFile(false))
 	{
 		LOGWARNING("Cannot save chunk [%d, %d], opening file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, GetFileName().c_str());
 		return false;
 	}
 
+	if (!WriteChunkData(a_Chunk, a_Data))
+	{
+		return false;
+	}
+	if (!WriteHeader())
+	{
+		LOGWARNING("Cannot save chunk [%d, %d], writing header to file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, GetFileName().c_str());
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+void cWSSAnvil::cMCAFile::SetChunksData(const cChunkCoordsVector & a_Chunks, const AStringVector & a_Data, std::vector<bool> & a_IsSaved)
+{
+	ASSERT(a_Chunks.size() == a_Data.size());
+	a_IsSaved.assign(a_Chunks.size(), false);
+
+	cCSLock Lock(m_CS);
+	if (!OpenFile(false))
+	{
+		LOGWARNING("Cannot save %u chunks, opening file \"%s\" failed", static_cast<unsigned>(a_Chunks.size()), GetFileName().c_str());
+		return;
+	}
+
+	bool HasWritten = false;
+	for (size_t i = 0; i < a_Chunks.size(); i++)
+	{
+		if (!a_Data[i].empty() && WriteChunkData(a_Chunks[i], a_Data[i]))
+		{
+			a_IsSaved[i] = true;
+			HasWritten = true;
+		}
+	}
+
+	// Write the header only once for the entire batch; if that fails, none of the chunks is reachable in the file:
+	if (HasWritten && !WriteHeader())
+	{
+		LOGWARNING("Cannot save %u chunks, writing header to file \"%s\" failed", static_cast<unsigned>(a_Chunks.size()), GetFileName().c_str());
+		a_IsSaved.assign(a_Chunks.size(), false);
+	}
+}
+
+
+
+
+
+bool cWSSAnvil::cMCAFile::WriteChunkData(const cChunkCoords & a_Chunk, const AString & a_Data)
+{
 	int LocalX = a_Chunk.m_ChunkX % 32;
 	if (LocalX < 0)
 	{
@@ -3112,10 +3701,29 @@ bool cWSSAnvil::cMCAFile::SetChunkData(const cChunkCoords & a_Chunk, const AStri
 		LocalZ = 32 + LocalZ;
 	}
 	
-	unsigned ChunkSector = FindFreeLocation(LocalX, LocalZ, a_Data);
+	// Check the size, round it *up* to the nearest 4KB sector, make it a sector number:
+	unsigned NumSectors = static_cast<unsigned>((a_Data.size() + MCA_CHUNK_HEADER_LENGTH + 4095) / 4096);
+	if (NumSectors > 255)
+	{
+		LOGWARNING("Cannot save chunk [%d, %d], the data is too large (%u KiB, maximum is 1024 KiB). Remove some entities and retry.",
+			a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, NumSectors * 4
+		);
+		return false;
+	}
+
+	unsigned ChunkSector = m_SectorMap.Allocate(ntohl(m_Header[LocalX + 32 * LocalZ]), NumSectors);
+	m_WriteGeneration += 1;
+
+	// The prefetched data of the chunk, if any, is outdated now:
+	int Index = LocalX + 32 * LocalZ;
+	m_PrefetchedChunks.remove_if([Index](const sPrefetchedChunk & a_Chunk)
+		{
+			return (a_Chunk.m_Index == Index);
+		}
+	);
 
 	// Store the chunk data:
-	m_File.Seek(ChunkSector * 4096);
+	m_File.Seek(static_cast<int>(ChunkSector * 4096));
 	u_long ChunkSize = htonl((u_long)a_Data.size() + 1);
 	if (m_File.Write(&ChunkSize, 4) != 4)
 	{
@@ -3139,38 +3747,35 @@ bool cWSSAnvil::cMCAFile::SetChunkData(const cChunkCoords & a_Chunk, const AStri
 	static const char Padding[4095] = {0};
 	m_File.Write(Padding, 4096 - (BytesWritten % 4096));
 	
-	// Store the header:
-	ChunkSize = ((u_long)a_Data.size() + MCA_CHUNK_HEADER_LENGTH + 4095) / 4096;  // Round data size *up* to nearest 4KB sector, make it a sector number
-	if (ChunkSize > 255)
-	{
-		LOGWARNING("Cannot save chunk [%d, %d], the data is too large (%u KiB, maximum is 1024 KiB). Remove some entities and retry.",
-			a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, (unsigned)(ChunkSize * 4)
-		);
-		return false;
-	}
-	
 	// Store the header info in the table
-	m_Header[LocalX + 32 * LocalZ] = htonl((ChunkSector << 8) | ChunkSize);
+	m_Header[LocalX + 32 * LocalZ] = htonl((ChunkSector << 8) | NumSectors);
 
 	// Set the modification time
 	m_TimeStamps[LocalX + 32 * LocalZ] =  htonl(static_cast<u_long>(time(nullptr)));
+	
+	return true;
+}
 
-	if (m_File.Seek(0) < 0)
-	{
-		LOGWARNING("Cannot save chunk [%d, %d], seeking in file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, GetFileName().c_str());
-		return false;
-	}
-	if (m_File.Write(m_Header, sizeof(m_Header)) != sizeof(m_Header))
-	{
-		LOGWARNING("Cannot save chunk [%d, %d], writing header to file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, GetFileName().c_str());
-		return false;
-	}
-	if (m_File.Write(m_TimeStamps, sizeof(m_TimeStamps)) != sizeof(m_TimeStamps))
+
+
+
+
+bool cWSSAnvil::cMCAFile::WriteHeader(void)
+{
+	if (
+		(m_File.Seek(0) < 0) ||
+		(m_File.Write(m_Header, sizeof(m_Header)) != sizeof(m_Header)) ||
+		(m_File.Write(m_TimeStamps, sizeof(m_TimeStamps)) != sizeof(m_TimeStamps))
+	)
 	{
-		LOGWARNING("Cannot save chunk [%d, %d], writing timestamps to file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, GetFileName().c_str());
 		return false;
 	}
-	
+
+	// Push the written data out of the stdio buffers, so that the readers see it through m_Mapping:
+	m_File.Flush();
+
+	// The header in the file no longer points to the released sectors, they can be reused:
+	m_SectorMap.ReleasePending();
 	return true;
 }
 
@@ -3178,30 +3783,103 @@ bool cWSSAnvil::cMCAFile::SetChunkData(const cChunkCoords & a_Chunk, const AStri
 
 
 
-unsigned cWSSAnvil::cMCAFile::FindFreeLocation(int a_LocalX, int a_LocalZ, const AString & a_Data)
+bool cWSSAnvil::cMCAFile::Compact(unsigned & a_NumSectorsBefore, unsigned & a_NumSectorsAfter)
 {
-	// See if it fits the current location:
-	unsigned ChunkLocation = ntohl(m_Header[a_LocalX + 32 * a_LocalZ]);
-	unsigned ChunkLen = ChunkLocation & 0xff;
-	if (a_Data.size() + MCA_CHUNK_HEADER_LENGTH <= (ChunkLen * 4096))
+	cCSLock Lock(m_CS);
+	if (!OpenFile(true))
 	{
-		return ChunkLocation >> 8;
+		return false;
 	}
-	
-	// Doesn't fit, append to the end of file (we're wasting a lot of space, TODO: fix this later)
-	unsigned MaxLocation = 2 << 8;  // Minimum sector is #2 - after the headers
+	a_NumSectorsBefore = static_cast<unsigned>((m_File.GetSize() + 4095) / 4096);
+
+	// Copy the chunks into a new file, one after another, starting right after the header:
+	AString TempFileName = m_FileName + ".compact";
+	cFile TempFile;
+	if (!TempFile.Open(TempFileName, cFile::fmWrite))
+	{
+		LOGWARNING("Cannot compact file \"%s\", creating the temporary file \"%s\" failed", m_FileName.c_str(), TempFileName.c_str());
+		return false;
+	}
+	unsigned NewHeader[MCA_MAX_CHUNKS];
+	unsigned NextSector = 2;
+	AString Data;
+	bool IsSuccess = true;
 	for (size_t i = 0; i < ARRAYCOUNT(m_Header); i++)
 	{
-		ChunkLocation = ntohl(m_Header[i]);
-		ChunkLocation = ChunkLocation + ((ChunkLocation & 0xff) << 8);  // Add the number of sectors used; don't care about the 4th byte
-		if (MaxLocation < ChunkLocation)
+		unsigned ChunkLocation = ntohl(m_Header[i]);
+		unsigned ChunkOffset = ChunkLocation >> 8;
+		NewHeader[i] = 0;
+		if ((ChunkOffset < 2) || ((ChunkLocation & 0xff) == 0))
 		{
-			MaxLocation = ChunkLocation;
+			continue;
 		}
+
+		// Read the chunk, with its 5-byte header; only the actual data is copied, any over-allocated sectors are dropped:
+		u_long ChunkSize = 0;
+		if ((m_File.Seek(static_cast<int>(ChunkOffset * 4096)) < 0) || (m_File.Read(&ChunkSize, 4) != 4))
+		{
+			IsSuccess = false;
+			break;
+		}
+		size_t DataSize = static_cast<size_t>(ntohl(ChunkSize)) + 4;
+		unsigned NumSectors = static_cast<unsigned>((DataSize + 4095) / 4096);
+		if ((DataSize <= MCA_CHUNK_HEADER_LENGTH) || (NumSectors > (ChunkLocation & 0xff)))
+		{
+			// The chunk is damaged, better leave the file as it is
+			IsSuccess = false;
+			break;
+		}
+		Data.resize(NumSectors * 4096);
+		memcpy(&Data[0], &ChunkSize, 4);
+		memset(&Data[DataSize], 0, Data.size() - DataSize);
+		if (
+			(m_File.Read(&Data[4], DataSize - 4) != static_cast<int>(DataSize - 4)) ||
+			(TempFile.Seek(static_cast<int>(NextSector * 4096)) < 0) ||
+			(TempFile.Write(Data.data(), Data.size()) != static_cast<int>(Data.size()))
+		)
+		{
+			IsSuccess = false;
+			break;
+		}
+		NewHeader[i] = htonl((NextSector << 8) | NumSectors);
+		NextSector += NumSectors;
 	}  // for i - m_Header[]
-	return MaxLocation >> 8;
+	if (
+		!IsSuccess ||
+		(TempFile.Seek(0) < 0) ||
+		(TempFile.Write(NewHeader, sizeof(NewHeader)) != sizeof(NewHeader)) ||
+		(TempFile.Write(m_TimeStamps, sizeof(m_TimeStamps)) != sizeof(m_TimeStamps))
+	)
+	{
+		LOGWARNING("Cannot compact file \"%s\", copying the chunks failed", m_FileName.c_str());
+		TempFile.Close();
+		cFile::Delete(TempFileName);
+		return false;
+	}
+	TempFile.Close();
+
+	// Replace the file with the compacted one and reopen it; the readers still inflating from the old mapping need to retry:
+	m_WriteGeneration += 1;
+	m_Mapping.reset();
+	m_File.Close();
+	if (!cFile::Rename(TempFileName, m_FileName))
+	{
+		// Some platforms don't allow renaming over an existing file:
+		if (!cFile::Delete(m_FileName) || !cFile::Rename(TempFileName, m_FileName))
+		{
+			LOGWARNING("Cannot compact file \"%s\", replacing it with \"%s\" failed", m_FileName.c_str(), TempFileName.c_str());
+			return false;
+		}
+	}
+	if (!OpenFile(true))
+	{
+		return false;
+	}
+	a_NumSectorsAfter = NextSector;
+	return true;
 }
 
 
 
 
+
@@ -10,6 +10,8 @@
 
 #include "WorldStorage.h"
 #include "FastNBT.h"
+#include "MCAFormat.h"
+#include "../OSSupport/MappedFile.h"
 #include "../Mobs/Monster.h"
 
 
@@ -22,6 +24,7 @@ class cItemGrid;
 class cProjectileEntity;
 class cHangingEntity;
 class cWolf;
+class cNBTChunkSerializer;
 
 
 
@@ -55,6 +58,7 @@ public:
 	
 protected:
 
+	/** A single region file. All the public functions lock the file's own CS, so that different files can be accessed in parallel. */
 	class cMCAFile
 	{
 	public:
@@ -65,12 +69,36 @@ protected:
 		bool SetChunkData  (const cChunkCoords & a_Chunk, const AString & a_Data);
 		bool EraseChunkData(const cChunkCoords & a_Chunk);
 		
+		/** Reads the chunk's data and uncompresses it into a_Uncompressed. Returns false if the chunk is not in the file.
+		The data is inflated directly from a read-only mapping of the file, without holding the file lock;
+		if the chunk gets written meanwhile, the read is retried. Falls back to GetChunkData() if the file cannot be mapped. */
+		bool GetUncompressedChunkData(const cChunkCoords & a_Chunk, AString & a_Uncompressed);
+		
+		/** Reads the compressed data of the specified chunks (all in this region) into the prefetch cache, so that loading them later
+		doesn't need to touch the disk. The chunks close to each other in the file are read with a single sequential read.
+		Chunks not present in the file, or already in the cache, are skipped. */
+		void PrefetchChunks(const cChunkCoordsVector & a_Chunks);
+
+		/** Stores the data of multiple chunks, writing the header only once, after all the chunks.
+		a_Data contains the compressed data for each chunk in a_Chunks, at the same index; chunks with empty data are skipped.
+		a_Data may contain more items than a_Chunks, the extra items are ignored.
+		a_IsSaved receives the result for each chunk. */
+		void SetChunksData(const cChunkCoordsVector & a_Chunks, const AStringVector & a_Data, std::vector<bool> & a_IsSaved);
+		
+		/** Rewrites the file so that all the chunks are stored contiguously, in the order of their index, without any free sectors.
+		a_NumSectorsBefore and a_NumSectorsAfter receive the file size, in sectors, before and after the compaction.
+		Returns false if the file doesn't exist or cannot be compacted; the file is left untouched in such a case. */
+		bool Compact(unsigned & a_NumSectorsBefore, unsigned & a_NumSectorsAfter);
+		
 		int             GetRegionX (void) const {return m_RegionX; }
 		int             GetRegionZ (void) const {return m_RegionZ; }
 		const AString & GetFileName(void) const {return m_FileName; }
 		
 	protected:
 	
+		/** Protects the file and the header data */
+		cCriticalSection m_CS;
+
 		int     m_RegionX;
 		int     m_RegionZ;
 		cFile   m_File;
@@ -83,36 +111,103 @@ protected:
 		// Chunk timestamps, following the chunk headers
 		unsigned m_TimeStamps[MCA_MAX_CHUNKS];
 		
-		/// Finds a free location large enough to hold a_Data. Gets a hint of the chunk coords, places the data there if it fits. Returns the sector number.
-		unsigned FindFreeLocation(int a_LocalX, int a_LocalZ, const AString & a_Data);
+		/** Read-only mapping of the file, used by GetUncompressedChunkData(); nullptr if not mapped yet.
+		Replaced by a new mapping when the file grows past it; readers keep their own reference while inflating from it. */
+		cMappedFilePtr m_Mapping;
+		
+		/** Incremented before any chunk data is written into the file.
+		Readers inflating from m_Mapping without the lock compare it with the value from before they started,
+		to detect data that has been overwritten under their hands. */
+		std::atomic<unsigned> m_WriteGeneration;
+		
+		/** The compressed data of a single chunk read ahead by PrefetchChunks(). */
+		struct sPrefetchedChunk
+		{
+			/** The chunk's index into m_Header. */
+			int m_Index;
+
+			/** The chunk's compressed data, without the chunk header. */
+			AString m_Data;
+		} ;
+		typedef std::list<sPrefetchedChunk> cPrefetchedChunks;
+
+		/** The prefetch cache: chunks read ahead and not loaded yet, the oldest first. Bounded to MAX_PREFETCHED_CHUNKS items.
+		An item is removed when its chunk is loaded, or written into the file. */
+		cPrefetchedChunks m_PrefetchedChunks;
+
+		/** The sector allocation map, built from the header whenever the file is opened. */
+		cMCASectorMap m_SectorMap;
 		
 		/// Opens a MCA file either for a Read operation (fails if doesn't exist) or for a Write operation (creates new if not found)
 		bool OpenFile(bool a_IsForReading);
+
+		/** Returns the compressed data of the specified chunk within m_Mapping, (re)mapping the file if needed.
+		a_Mapping receives a reference to the mapping that keeps the data alive after m_CS is unlocked.
+		Returns false if the chunk cannot be read from the mapping. Assumes m_CS is locked and the file is open. */
+		bool GetMappedChunkData(int a_LocalX, int a_LocalZ, cMappedFilePtr & a_Mapping, const char *& a_Data, size_t & a_Size);
+
+		/** Moves the specified chunk's data from the prefetch cache into a_Data. Returns false if the chunk is not in the cache.
+		Assumes m_CS is locked. */
+		bool TakePrefetchedChunk(int a_Index, AString & a_Data);
+
+		/** Reads the specified chunks, all within a_NumSectors sectors starting at a_FirstSector, with a single read and adds them to the prefetch cache.
+		a_Chunks holds the chunk indices into m_Header. Assumes m_CS is locked and the file is open. */
+		void PrefetchSectors(unsigned a_FirstSector, unsigned a_NumSectors, const std::vector<int> & a_Chunks);
+
+		/** Writes the chunk data into the file and updates the in-memory header, but doesn't write the header into the file.
+		Assumes m_CS is locked and the file is open for writing. */
+		bool WriteChunkData(const cChunkCoords & a_Chunk, const AString & a_Data);
+
+		/** Writes the in-memory header and timestamps into the file and frees the sectors released by the chunks written since the last header write.
+		Assumes m_CS is locked and the file is open for writing. */
+		bool WriteHeader(void);
 	} ;
-	typedef std::list<cMCAFile *> cMCAFiles;
+	typedef std::shared_ptr<cMCAFile> cMCAFilePtr;
+	typedef std::list<cMCAFilePtr> cMCAFiles;
 	
+	/** Protects m_Files; the files themselves have their own locks */
 	cCriticalSection m_CS;
-	cMCAFiles        m_Files;  // a MRU cache of MCA files
+
+	/** A MRU cache of MCA files. A file may be in use by a storage thread even after it's been removed from the cache. */
+	cMCAFiles m_Files;
 	
 	int m_CompressionFactor;
 
-	/// Gets chunk data from the correct file; locks file CS as needed
-	bool GetChunkData(const cChunkCoords & a_Chunk, AString & a_Data);
+	/** The reusable objects for saving a chunk, see cSaveScratch. */
+	class cSaveScratch;
+	typedef std::vector<cSaveScratch *> cSaveScratches;
+
+	/** Protects m_SaveScratches. */
+	cCriticalSection m_CSSaveScratches;
+
+	/** The pool of save scratches not currently in use by any storage thread. */
+	cSaveScratches m_SaveScratches;
+
+	/** Returns a save scratch from the pool, or a new one if the pool is empty. Return it using ReleaseSaveScratch(). */
+	cSaveScratch * AcquireSaveScratch(void);
+
+	/** Returns the save scratch into the pool. */
+	void ReleaseSaveScratch(cSaveScratch * a_Scratch);
+
+	/// Gets the uncompressed chunk data from the correct file; locks file CS as needed
+	bool GetUncompressedChunkData(const cChunkCoords & a_Chunk, AString & a_Uncompressed);
 
 	/// Sets chunk data into the correct file; locks file CS as needed
 	bool SetChunkData(const cChunkCoords & a_Chunk, const AString & a_Data);
 
-	/// Loads the chunk from the data (no locking needed)
-	bool LoadChunkFromData(const cChunkCoords & a_Chunk, const AString & a_Data);
+	/// Loads the chunk from the uncompressed data (no locking needed)
+	bool LoadChunkFromData(const cChunkCoords & a_Chunk, const AString & a_Uncompressed);
 	
-	/// Saves the chunk into datastream (no locking needed)
-	bool SaveChunkToData(const cChunkCoords & a_Chunk, AString & a_Data);
+	/** Saves the chunk into compressed data, streaming the NBT directly into the compressor (no locking needed).
+	a_Scratch provides the reusable objects for the serialization. */
+	bool SaveChunkToData(const cChunkCoords & a_Chunk, cSaveScratch & a_Scratch, AString & a_Data);
 	
 	/// Loads the chunk from NBT data (no locking needed)
 	bool LoadChunkFromNBT(const cChunkCoords & a_Chunk, const cParsedNBT & a_NBT);
 	
-	/// Saves the chunk into NBT data using a_Writer; returns true on success
-	bool SaveChunkToNBT(const cChunkCoords & a_Chunk, cFastNBTWriter & a_Writer);
+	/** Saves the chunk into NBT data using a_Writer; returns true on success.
+	a_Serializer is used for collecting the chunk data, it needs to be writing into a_Writer and be freshly reset. */
+	bool SaveChunkToNBT(const cChunkCoords & a_Chunk, cFastNBTWriter & a_Writer, cNBTChunkSerializer & a_Serializer);
 	
 	/// Loads the chunk's biome map from vanilla-format; returns a_BiomeMap if biomes present and valid, nullptr otherwise
 	cChunkDef::BiomeMap * LoadVanillaBiomeMapFromNBT(cChunkDef::BiomeMap * a_BiomeMap, const cParsedNBT & a_NBT, int a_TagIdx);
@@ -235,14 +330,20 @@ protected:
 	bool GetBlockEntityNBTPos(const cParsedNBT & a_NBT, int a_TagIdx, int & a_X, int & a_Y, int & a_Z);
 	
 	/// Gets the correct MCA file either from cache or from disk, manages the m_MCAFiles cache; assumes m_CS is locked
-	cMCAFile * LoadMCAFile(const cChunkCoords & a_Chunk);
+	cMCAFilePtr LoadMCAFile(const cChunkCoords & a_Chunk);
 	
+	/** Compacts all the region files of the world, see cMCAFile::Compact(). */
+	void CompactRegionFiles(void);
+
 	/// Copies a_Length bytes of data from the specified NBT Tag's Child into the a_Destination buffer
 	void CopyNBTData(const cParsedNBT & a_NBT, int a_Tag, const AString & a_ChildName, char * a_Destination, size_t a_Length);
 		
 	// cWSSchema overrides:
 	virtual bool LoadChunk(const cChunkCoords & a_Chunk) override;
 	virtual bool SaveChunk(const cChunkCoords & a_Chunk) override;
+	virtual void SaveChunks(const cChunkCoordsVector & a_Chunks, std::vector<bool> & a_IsSaved) override;
+	virtual void CompactFiles(void) override { CompactRegionFiles(); }
+	virtual void PrefetchChunks(const cChunkCoordsVector & a_Chunks) override;
 	virtual const AString GetName(void) const override {return "anvil"; }
 } ;
 
@@ -0,0 +1,277 @@
+
+// WSSBinary.cpp
+
+// Implements the cWSSBinary class representing the binary world storage schema
+
+#include "Globals.h"
+#include "WSSBinary.h"
+#include "NBTChunkSerializer.h"
+#include "../World.h"
+#include "../SetChunkData.h"
+
+
+
+
+
+/** Maximum number of region files that are cached in memory. Each file means an OS FS handle. */
+#define MAX_BINARY_REGION_FILES 32
+
+
+
+
+
+cWSSBinary::cWSSBinary(cWorld * a_World, int a_CompressionFactor) :
+	super(a_World, a_CompressionFactor)
+{
+}
+
+
+
+
+
+bool cWSSBinary::LoadChunk(const cChunkCoords & a_Chunk)
+{
+	cBinaryRegionFilePtr File = GetRegionFile(a_Chunk, false);
+	if (File == nullptr)
+	{
+		// No region file, no chunk:
+		return false;
+	}
+	AString Compressed;
+	if (!File->GetChunkData(a_Chunk.m_ChunkX - File->GetRegionX() * 32, a_Chunk.m_ChunkZ - File->GetRegionZ() * 32, Compressed))
+	{
+		return false;
+	}
+	AString Data;
+	if (!cBinaryChunk::Uncompress(Compressed.data(), Compressed.size(), Data))
+	{
+		LOGWARNING("Uncompressing chunk [%d, %d] from file \"%s\" failed", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, File->GetFileName().c_str());
+		return false;
+	}
+	return LoadChunkFromBinary(a_Chunk, Data);
+}
+
+
+
+
+
+bool cWSSBinary::SaveChunk(const cChunkCoords & a_Chunk)
+{
+	cChunkCoordsVector Chunks;
+	Chunks.push_back(a_Chunk);
+	std::vector<bool> IsSaved;
+	SaveChunks(Chunks, IsSaved);
+	return IsSaved.front();
+}
+
+
+
+
+
+void cWSSBinary::SaveChunks(const cChunkCoordsVector & a_Chunks, std::vector<bool> & a_IsSaved)
+{
+	a_IsSaved.clear();
+	if (a_Chunks.empty())
+	{
+		return;
+	}
+
+	// Serialize and compress all the chunks first, without holding any file lock:
+	cBinaryRegionFilePtr File = GetRegionFile(a_Chunks.front(), true);
+	std::vector<int> Indices(a_Chunks.size());
+	AStringVector Data(a_Chunks.size());
+	for (size_t i = 0; i < a_Chunks.size(); i++)
+	{
+		Indices[i] = (a_Chunks[i].m_ChunkX - File->GetRegionX() * 32) + 32 * (a_Chunks[i].m_ChunkZ - File->GetRegionZ() * 32);
+		ASSERT((Indices[i] >= 0) && (Indices[i] < cBinaryRegionFile::NUM_CHUNKS));  // All the chunks need to be in the same region
+		if (!SaveChunkToBinary(a_Chunks[i], Data[i]))
+		{
+			LOGWARNING("Cannot serialize chunk [%d, %d] into data", a_Chunks[i].m_ChunkX, a_Chunks[i].m_ChunkZ);
+			Data[i].clear();
+		}
+	}
+
+	File->SetChunksData(Indices, Data, a_IsSaved);
+}
+
+
+
+
+
+void cWSSBinary::CompactFiles(void)
+{
+	AString Folder;
+	Printf(Folder, "%s/binregion", m_World->GetName().c_str());
+	AStringVector Files = cFile::GetFolderContents(FILE_IO_PREFIX + Folder);
+	unsigned NumFiles = 0;
+	long SizeBefore = 0;
+	long SizeAfter = 0;
+	for (AStringVector::const_iterator itr = Files.begin(), end = Files.end(); itr != end; ++itr)
+	{
+		int RegionX, RegionZ;
+		char Ext[4] = "";
+		if ((sscanf(itr->c_str(), "r.%d.%d.%3s", &RegionX, &RegionZ, Ext) != 3) || (strcmp(Ext, "mcb") != 0))
+		{
+			continue;
+		}
+		long Before, After;
+		if (GetRegionFile(cChunkCoords(RegionX * 32, RegionZ * 32), true)->Compact(Before, After))
+		{
+			NumFiles += 1;
+			SizeBefore += Before;
+			SizeAfter += After;
+		}
+	}  // for itr - Files[]
+	LOG("World \"%s\": compacted %u binary region files, %ld KiB freed (%ld KiB -> %ld KiB)",
+		m_World->GetName().c_str(), NumFiles, (SizeBefore - SizeAfter) / 1024, SizeBefore / 1024, SizeAfter / 1024
+	);
+}
+
+
+
+
+
+cWSSBinary::cBinaryRegionFilePtr cWSSBinary::GetRegionFile(const cChunkCoords & a_Chunk, bool a_Create)
+{
+	const int RegionX = FAST_FLOOR_DIV(a_Chunk.m_ChunkX, 32);
+	const int RegionZ = FAST_FLOOR_DIV(a_Chunk.m_ChunkZ, 32);
+
+	cCSLock Lock(m_CSRegionFiles);
+
+	// Is it already cached?
+	for (cBinaryRegionFiles::iterator itr = m_RegionFiles.begin(); itr != m_RegionFiles.end(); ++itr)
+	{
+		if (((*itr)->GetRegionX() == RegionX) && ((*itr)->GetRegionZ() == RegionZ))
+		{
+			// Move the file to front and return it:
+			cBinaryRegionFilePtr f = *itr;
+			if (itr != m_RegionFiles.begin())
+			{
+				m_RegionFiles.erase(itr);
+				m_RegionFiles.push_front(f);
+			}
+			return f;
+		}
+	}
+
+	// Load it anew; when only loading, don't create anything for a region that has never been saved:
+	AString Folder, FileName;
+	Printf(Folder, "%s/binregion", m_World->GetName().c_str());
+	Printf(FileName, "%s/r.%d.%d.mcb", Folder.c_str(), RegionX, RegionZ);
+	if (!a_Create && !cFile::IsFile(FILE_IO_PREFIX + FileName))
+	{
+		return nullptr;
+	}
+	cFile::CreateFolder(FILE_IO_PREFIX + Folder);
+	cBinaryRegionFilePtr f = std::make_shared<cBinaryRegionFile>(FileName, RegionX, RegionZ);
+	m_RegionFiles.push_front(f);
+
+	// If there are too many files cached, remove the least recently used one that is not in use by another thread:
+	if (m_RegionFiles.size() > MAX_BINARY_REGION_FILES)
+	{
+		for (cBinaryRegionFiles::iterator itr = m_RegionFiles.end(); itr != m_RegionFiles.begin();)
+		{
+			--itr;
+			if (itr->unique())
+			{
+				m_RegionFiles.erase(itr);
+				break;
+			}
+		}
+	}
+	return f;
+}
+
+
+
+
+
+bool cWSSBinary::SaveChunkToBinary(const cChunkCoords & a_Chunk, AString & a_Compressed)
+{
+	// The entities and block entities are serialized into NBT by the Anvil serializer, which also collects the block data:
+	cFastNBTWriter Writer;
+	cNBTChunkSerializer Serializer(Writer);
+	if (!m_World->GetChunkData(a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ, Serializer))
+	{
+		LOGWARNING("Cannot get chunk [%d, %d] data for binary saving", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		return false;
+	}
+	Serializer.Finish();
+	Writer.Finish();
+
+	std::unique_ptr<cBinaryChunk> Chunk(new cBinaryChunk);
+	memcpy(Chunk->m_BlockTypes, Serializer.m_BlockTypes,    sizeof(Chunk->m_BlockTypes));
+	memcpy(Chunk->m_BlockMetas, Serializer.m_BlockMetas,    sizeof(Chunk->m_BlockMetas));
+	memcpy(Chunk->m_BlockLight, Serializer.m_BlockLight,    sizeof(Chunk->m_BlockLight));
+	memcpy(Chunk->m_SkyLight,   Serializer.m_BlockSkyLight, sizeof(Chunk->m_SkyLight));
+	Chunk->m_IsLightValid = Serializer.IsLightValid();
+	Chunk->m_AreBiomesValid = Serializer.m_BiomesAreValid;
+	if (Serializer.m_BiomesAreValid)
+	{
+		for (size_t i = 0; i < ARRAYCOUNT(Chunk->m_Biomes); i++)
+		{
+			Chunk->m_Biomes[i] = static_cast<Byte>(Serializer.m_Biomes[i]);
+		}
+	}
+	Chunk->m_EntitiesNBT = Writer.GetResult();
+
+	AString Data;
+	Chunk->Serialize(Data);
+	return cBinaryChunk::Compress(Data, a_Compressed);
+}
+
+
+
+
+
+bool cWSSBinary::LoadChunkFromBinary(const cChunkCoords & a_Chunk, const AString & a_Data)
+{
+	std::unique_ptr<cBinaryChunk> Chunk(new cBinaryChunk);
+	if (!Chunk->Parse(a_Data.data(), a_Data.size()))
+	{
+		LOGWARNING("Chunk [%d, %d] has invalid binary data, it will be regenerated", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		return false;
+	}
+
+	cChunkDef::BiomeMap BiomeMap;
+	if (Chunk->m_AreBiomesValid)
+	{
+		for (size_t i = 0; i < ARRAYCOUNT(BiomeMap); i++)
+		{
+			BiomeMap[i] = static_cast<EMCSBiome>(Chunk->m_Biomes[i]);
+		}
+	}
+
+	// Load the entities and block entities from the NBT:
+	cEntityList      Entities;
+	cBlockEntityList BlockEntities;
+	if (!Chunk->m_EntitiesNBT.empty())
+	{
+		cParsedNBT NBT(Chunk->m_EntitiesNBT.data(), Chunk->m_EntitiesNBT.size());
+		if (NBT.IsValid())
+		{
+			LoadEntitiesFromNBT     (Entities,      NBT, NBT.FindChildByName(NBT.GetRoot(), "Entities"));
+			LoadBlockEntitiesFromNBT(BlockEntities, NBT, NBT.FindChildByName(NBT.GetRoot(), "TileEntities"), Chunk->m_BlockTypes, Chunk->m_BlockMetas);
+		}
+		else
+		{
+			LOGWARNING("Chunk [%d, %d] has invalid entity data, the entities will be lost", a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ);
+		}
+	}
+
+	cSetChunkDataPtr SetChunkData(new cSetChunkData(
+		a_Chunk.m_ChunkX, a_Chunk.m_ChunkZ,
+		Chunk->m_BlockTypes, Chunk->m_BlockMetas,
+		Chunk->m_IsLightValid ? Chunk->m_BlockLight : nullptr,
+		Chunk->m_IsLightValid ? Chunk->m_SkyLight : nullptr,
+		nullptr, Chunk->m_AreBiomesValid ? &BiomeMap : nullptr,
+		Entities, BlockEntities,
+		false
+	));
+	m_World->QueueSetChunkData(SetChunkData);
+	return true;
+}
+
+
+
+
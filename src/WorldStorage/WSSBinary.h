@@ -0,0 +1,67 @@
+
+// WSSBinary.h
+
+// Declares the cWSSBinary class representing the binary world storage schema, optimized for the server's load and save speed
+
+/*
+The chunks are stored in the format described in BinaryRegionFile.h, in the "<world>/binregion" folder.
+The entities and block entities are still (de)serialized through the Anvil NBT code, which is why the schema
+derives from cWSSAnvil; the blocks skip the NBT altogether.
+Worlds can be converted between the two schemas using the RegionConverter tool.
+*/
+
+
+
+
+
+#pragma once
+
+#include "WSSAnvil.h"
+#include "BinaryRegionFile.h"
+
+
+
+
+
+class cWSSBinary :
+	public cWSSAnvil
+{
+	typedef cWSSAnvil super;
+
+public:
+
+	cWSSBinary(cWorld * a_World, int a_CompressionFactor);
+
+protected:
+
+	typedef std::shared_ptr<cBinaryRegionFile> cBinaryRegionFilePtr;
+	typedef std::list<cBinaryRegionFilePtr> cBinaryRegionFiles;
+
+	/** Protects m_RegionFiles; the files themselves have their own locks. */
+	cCriticalSection m_CSRegionFiles;
+
+	/** A MRU cache of the region files. A file may be in use by a storage thread even after it's been removed from the cache. */
+	cBinaryRegionFiles m_RegionFiles;
+
+
+	/** Returns the region file containing the specified chunk, from the cache or newly opened.
+	If a_Create is false and the file doesn't exist on the disk, returns nullptr without creating anything. */
+	cBinaryRegionFilePtr GetRegionFile(const cChunkCoords & a_Chunk, bool a_Create);
+
+	/** Serializes and compresses the chunk into a_Compressed. Returns false on failure. */
+	bool SaveChunkToBinary(const cChunkCoords & a_Chunk, AString & a_Compressed);
+
+	/** Loads the chunk from its uncompressed serialized data and queues it into the world. Returns false on failure. */
+	bool LoadChunkFromBinary(const cChunkCoords & a_Chunk, const AString & a_Data);
+
+	// cWSSchema overrides:
+	virtual bool LoadChunk(const cChunkCoords & a_Chunk) override;
+	virtual bool SaveChunk(const cChunkCoords & a_Chunk) override;
+	virtual void SaveChunks(const cChunkCoordsVector & a_Chunks, std::vector<bool> & a_IsSaved) override;
+	virtual void CompactFiles(void) override;
+	virtual const AString GetName(void) const override {return "binary"; }
+} ;
+
+
+
+
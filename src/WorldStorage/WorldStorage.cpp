@@ -1,13 +1,14 @@
 
 // WorldStorage.cpp
 
-// Implements the cWorldStorage class representing the chunk loading / saving thread
+// Implements the cWorldStorage class representing the pool of chunk loading / saving threads
 
 // To add a new storage schema, implement a cWSSchema descendant and add it to cWorldStorage::InitSchemas()
 
 #include "Globals.h"
 #include "WorldStorage.h"
 #include "WSSAnvil.h"
+#include "WSSBinary.h"
 #include "../World.h"
 #include "../Generating/ChunkGenerator.h"
 #include "../Entities/Entity.h"
@@ -16,6 +17,14 @@
 
 
 
+
+/** The maximum number of chunks that a worker takes from the save queue at once.
+Limits the time a worker spends saving, so that it soon gets back to loading chunks, which has priority. */
+#define MAX_SAVE_BATCH_SIZE 64
+
+
+
+
 /// Example storage schema - forgets all chunks ;)
 class cWSSForgetful :
 	public cWSSchema
@@ -38,9 +47,9 @@ protected:
 // cWorldStorage:
 
 cWorldStorage::cWorldStorage(void) :
-	super("cWorldStorage"),
 	m_World(nullptr),
-	m_SaveSchema(nullptr)
+	m_SaveSchema(nullptr),
+	m_ShouldCompactFiles(false)
 {
 }
 
@@ -50,6 +59,7 @@ cWorldStorage::cWorldStorage(void) :
 
 cWorldStorage::~cWorldStorage()
 {
+	ASSERT(m_Workers.empty());  // Stop() should have been called
 	for (cWSSchemaList::iterator itr = m_Schemas.begin(); itr != m_Schemas.end(); ++itr)
 	{
 		delete *itr;
@@ -60,13 +70,38 @@ cWorldStorage::~cWorldStorage()
 
 
 
-bool cWorldStorage::Start(cWorld * a_World, const AString & a_StorageSchemaName, int a_StorageCompressionFactor)
+bool cWorldStorage::Start(cWorld * a_World, const AString & a_StorageSchemaName, int a_StorageCompressionFactor, int a_NumThreads, bool a_ShouldCompactFiles, int a_JournalSyncInterval)
 {
+	ASSERT(m_Workers.empty());  // Not started yet
 	m_World = a_World;
 	m_StorageSchemaName = a_StorageSchemaName;
 	InitSchemas(a_StorageCompressionFactor);
 	
-	return super::Start();
+	if (a_ShouldCompactFiles)
+	{
+		m_SaveSchema->CompactFiles();
+	}
+	
+	// The journal needs to be read before any chunk loads, so that the lost changes can be replayed into the chunks:
+	if (a_JournalSyncInterval > 0)
+	{
+		m_Journal.Start(m_World->GetName() + "/journal.mcj", a_JournalSyncInterval);
+	}
+	
+	for (int i = 0; i < std::max(a_NumThreads, 1); i++)
+	{
+		cWorker * Worker = new cWorker(*this);
+		m_Workers.push_back(Worker);
+		if (!Worker->Start())
+		{
+			// Don't leave the workers started so far running on a storage that reports failure:
+			LOGWARNING("Cannot start the world storage threads");
+			StopWorkers();
+			m_Journal.Stop();
+			return false;
+		}
+	}
+	return true;
 }
 
 
@@ -93,11 +128,10 @@ void cWorldStorage::WaitForFinish(void)
 	// Wait for the saving to finish:
 	WaitForSaveQueueEmpty();
 	
-	// Wait for the thread to finish:
-	m_ShouldTerminate = true;
-	m_Event.Set();  // Wake up the thread if waiting
-	super::Wait();
-	LOG("World storage thread finished");
+	// Wait for the threads to finish; each finishes the batch it is currently saving:
+	StopWorkers();
+	m_Journal.Stop();
+	LOG("World storage threads finished");
 }
 
 
@@ -145,7 +179,7 @@ void cWorldStorage::QueueLoadChunk(int a_ChunkX, int a_ChunkZ, cChunkCoordCallba
 	ASSERT(m_World->IsChunkQueued(a_ChunkX, a_ChunkZ));
 
 	m_LoadQueue.EnqueueItem(cChunkCoordsWithCallback(a_ChunkX, a_ChunkZ, a_Callback));
-	m_Event.Set();
+	WakeUpWorkers();
 }
 
 
@@ -157,7 +191,7 @@ void cWorldStorage::QueueSaveChunk(int a_ChunkX, int a_ChunkZ, cChunkCoordCallba
 	ASSERT(m_World->IsChunkValid(a_ChunkX, a_ChunkZ));
 
 	m_SaveQueue.EnqueueItem(cChunkCoordsWithCallback(a_ChunkX, a_ChunkZ, a_Callback));
-	m_Event.Set();
+	WakeUpWorkers();
 }
 
 
@@ -194,6 +228,7 @@ void cWorldStorage::InitSchemas(int a_StorageCompressionFactor)
 {
 	// The first schema added is considered the default
 	m_Schemas.push_back(new cWSSAnvil    (m_World, a_StorageCompressionFactor));
+	m_Schemas.push_back(new cWSSBinary   (m_World, a_StorageCompressionFactor));
 	m_Schemas.push_back(new cWSSForgetful(m_World));
 	// Add new schemas here
 	
@@ -226,23 +261,11 @@ void cWorldStorage::InitSchemas(int a_StorageCompressionFactor)
 
 
 
-void cWorldStorage::Execute(void)
+void cWorldStorage::WakeUpWorkers(void)
 {
-	while (!m_ShouldTerminate)
+	for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
 	{
-		m_Event.Wait();
-		// Process both queues until they are empty again:
-		bool Success;
-		do
-		{
-			if (m_ShouldTerminate)
-			{
-				return;
-			}
-			
-			Success = LoadOneChunk();
-			Success |= SaveOneChunk();
-		} while (Success);
+		(*itr)->WakeUp();
 	}
 }
 
@@ -250,56 +273,214 @@ void cWorldStorage::Execute(void)
 
 
 
+void cWorldStorage::StopWorkers(void)
+{
+	for (cWorkers::iterator itr = m_Workers.begin(), end = m_Workers.end(); itr != end; ++itr)
+	{
+		(*itr)->Stop();
+		delete *itr;
+	}
+	m_Workers.clear();
+}
+
+
+
+
+
 bool cWorldStorage::LoadOneChunk(void)
 {
-	// Dequeue an item, bail out if there's none left:
+	// Dequeue the item nearest to the players, bail out if there's none left:
+	cChunkScheduler::cSnapshot Scheduler;
+	m_World->GetChunkScheduler().GetSnapshot(Scheduler);
 	cChunkCoordsWithCallback ToLoad(0, 0, nullptr);
-	bool ShouldLoad = m_LoadQueue.TryDequeueItem(ToLoad);
+	bool ShouldLoad = m_LoadQueue.TryDequeueBestItem(ToLoad, [&Scheduler](const cChunkCoordsWithCallback & a_Item)
+		{
+			return Scheduler.GetPriority(a_Item.m_ChunkX, a_Item.m_ChunkZ);
+		}
+	);
 	if (!ShouldLoad)
 	{
 		return false;
 	}
 
+	// Drop the request if nobody wants the chunk anymore (requests with a callback are never dropped):
+	if (
+		(ToLoad.m_Callback == nullptr) &&
+		(Scheduler.GetPriority(ToLoad.m_ChunkX, ToLoad.m_ChunkZ) == cChunkScheduler::UNWANTED) &&
+		m_World->TryUnqueueUnwantedChunk(ToLoad.m_ChunkX, ToLoad.m_ChunkZ)
+	)
+	{
+		return true;
+	}
+
 	// Load the chunk:
-	bool res = LoadChunk(ToLoad.m_ChunkX, ToLoad.m_ChunkZ);
+	LoadChunk(ToLoad.m_ChunkX, ToLoad.m_ChunkZ);
+	PrefetchChunksAhead(Scheduler);
 
 	// Call the callback, if specified:
 	if (ToLoad.m_Callback != nullptr)
 	{
 		ToLoad.m_Callback->Call(ToLoad.m_ChunkX, ToLoad.m_ChunkZ);
 	}
-	return res;
+	return true;
 }
 
 
 
 
 
-bool cWorldStorage::SaveOneChunk(void)
+void cWorldStorage::PrefetchChunksAhead(const cChunkScheduler::cSnapshot & a_Scheduler)
 {
-	// Dequeue one chunk to save:
-	cChunkCoordsWithCallback ToSave(0, 0, nullptr);
-	bool ShouldSave = m_SaveQueue.TryDequeueItem(ToSave);
-	if (!ShouldSave)
+	// Collect the chunks ahead of the players who have moved since their last prefetch:
+	cChunkCoordsVector Chunks;
 	{
-		return false;
+		cCSLock Lock(m_CSPrefetch);
+		std::unordered_map<int, cChunkCoords> Positions;  // Only the players present in the snapshot are kept
+		const cChunkScheduler::cPlayers & Players = a_Scheduler.GetPlayers();
+		for (cChunkScheduler::cPlayers::const_iterator itr = Players.begin(), end = Players.end(); itr != end; ++itr)
+		{
+			if (!itr->HasHeading())
+			{
+				continue;
+			}
+			cChunkCoords Pos(itr->m_ChunkX, itr->m_ChunkZ);
+			auto Prev = m_PrefetchPositions.find(itr->m_ID);
+			if ((Prev == m_PrefetchPositions.end()) || !(Prev->second == Pos))
+			{
+				cChunkScheduler::GetChunksAhead(*itr, Chunks);
+			}
+			Positions.emplace(itr->m_ID, Pos);
+		}
+		std::swap(Positions, m_PrefetchPositions);
+	}
+
+	// Chunks already in memory need no loading:
+	cChunkCoordsVector ToPrefetch;
+	ToPrefetch.reserve(Chunks.size());
+	for (cChunkCoordsVector::const_iterator itr = Chunks.begin(), end = Chunks.end(); itr != end; ++itr)
+	{
+		if (!m_World->IsChunkValid(itr->m_ChunkX, itr->m_ChunkZ))
+		{
+			ToPrefetch.push_back(*itr);
+		}
+	}
+	if (!ToPrefetch.empty())
+	{
+		m_SaveSchema->PrefetchChunks(ToPrefetch);
+	}
+}
+
+
+
+
+
+bool cWorldStorage::SaveChunkBatch(void)
+{
+	// Dequeue a batch of chunks from the same region, none of them being saved by another worker:
+	cChunkCoordsWithCallbackVector Batch;
+	{
+		cCSLock Lock(m_CSSavesInProgress);
+		bool HasDequeued = m_SaveQueue.TryDequeueItems(Batch, MAX_SAVE_BATCH_SIZE, [&](const cChunkCoordsWithCallback & a_Item)
+			{
+				if (m_SavesInProgress.find(cChunkCoords(a_Item.m_ChunkX, a_Item.m_ChunkZ)) != m_SavesInProgress.end())
+				{
+					return false;
+				}
+				for (const auto & Item: Batch)
+				{
+					if ((Item.m_ChunkX == a_Item.m_ChunkX) && (Item.m_ChunkZ == a_Item.m_ChunkZ))
+					{
+						// Queued twice, save it in a later batch
+						return false;
+					}
+				}
+				return (
+					Batch.empty() || (
+						(FAST_FLOOR_DIV(a_Item.m_ChunkX, 32) == FAST_FLOOR_DIV(Batch.front().m_ChunkX, 32)) &&
+						(FAST_FLOOR_DIV(a_Item.m_ChunkZ, 32) == FAST_FLOOR_DIV(Batch.front().m_ChunkZ, 32))
+					)
+				);
+			}
+		);
+		if (!HasDequeued)
+		{
+			return false;
+		}
+		for (const auto & Item: Batch)
+		{
+			m_SavesInProgress.insert(cChunkCoords(Item.m_ChunkX, Item.m_ChunkZ));
+		}
 	}
 	
-	// Save the chunk, if it's valid:
-	if (m_World->IsChunkValid(ToSave.m_ChunkX, ToSave.m_ChunkZ))
+	// Save the chunks that are valid:
+	cChunkCoordsVector ToSave;
+	for (const auto & Item: Batch)
 	{
-		m_World->MarkChunkSaving(ToSave.m_ChunkX, ToSave.m_ChunkZ);
-		if (m_SaveSchema->SaveChunk(cChunkCoords(ToSave.m_ChunkX, ToSave.m_ChunkZ)))
+		if (m_World->IsChunkValid(Item.m_ChunkX, Item.m_ChunkZ))
 		{
-			m_World->MarkChunkSaved(ToSave.m_ChunkX, ToSave.m_ChunkZ);
+			m_World->MarkChunkSaving(Item.m_ChunkX, Item.m_ChunkZ);
+			m_Journal.ChunkSaving(Item.m_ChunkX, Item.m_ChunkZ);
+			ToSave.push_back(cChunkCoords(Item.m_ChunkX, Item.m_ChunkZ));
+		}
+	}
+	if (!ToSave.empty())
+	{
+		std::vector<bool> IsSaved;
+		m_SaveSchema->SaveChunks(ToSave, IsSaved);
+		ASSERT(IsSaved.size() == ToSave.size());
+		for (size_t i = 0; i < ToSave.size(); i++)
+		{
+			if (IsSaved[i])
+			{
+				m_World->MarkChunkSaved(ToSave[i].m_ChunkX, ToSave[i].m_ChunkZ);
+				m_Journal.ChunkSaved(ToSave[i].m_ChunkX, ToSave[i].m_ChunkZ);
+			}
 		}
 	}
 
-	// Call the callback, if specified:
-	if (ToSave.m_Callback != nullptr)
 	{
-		ToSave.m_Callback->Call(ToSave.m_ChunkX, ToSave.m_ChunkZ);
+		cCSLock Lock(m_CSSavesInProgress);
+		for (const auto & Item: Batch)
+		{
+			m_SavesInProgress.erase(cChunkCoords(Item.m_ChunkX, Item.m_ChunkZ));
+		}
+	}
+
+	// The chunks may have been queued again while being saved, let the other workers know they're available now:
+	WakeUpWorkers();
+
+	// Call the callbacks, if specified:
+	for (const auto & Item: Batch)
+	{
+		if (Item.m_Callback != nullptr)
+		{
+			Item.m_Callback->Call(Item.m_ChunkX, Item.m_ChunkZ);
+		}
+	}
+	return true;
+}
+
+
+
+
+
+void cWorldStorage::QueueCompactFiles(void)
+{
+	m_ShouldCompactFiles = true;
+	WakeUpWorkers();
+}
+
+
+
+
+
+bool cWorldStorage::CompactFilesIfQueued(void)
+{
+	if (!m_ShouldCompactFiles.exchange(false))
+	{
+		return false;
 	}
+	m_SaveSchema->CompactFiles();
 	return true;
 }
 
@@ -338,3 +519,45 @@ bool cWorldStorage::LoadChunk(int a_ChunkX, int a_ChunkZ)
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// cWorldStorage::cWorker:
+
+cWorldStorage::cWorker::cWorker(cWorldStorage & a_WorldStorage) :
+	super("cWorldStorage"),
+	m_WorldStorage(a_WorldStorage)
+{
+}
+
+
+
+
+
+void cWorldStorage::cWorker::Stop(void)
+{
+	m_ShouldTerminate = true;
+	m_evtItemAdded.Set();
+
+	Wait();
+}
+
+
+
+
+
+void cWorldStorage::cWorker::Execute(void)
+{
+	while (!m_ShouldTerminate)
+	{
+		// Loading has priority, players are waiting for the chunks; save only when there's nothing to load:
+		if (m_WorldStorage.LoadOneChunk() || m_WorldStorage.CompactFilesIfQueued() || m_WorldStorage.SaveChunkBatch())
+		{
+			continue;
+		}
+		m_evtItemAdded.Wait();
+	}
+}
+
+
+
+
+
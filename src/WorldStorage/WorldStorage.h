@@ -1,7 +1,10 @@
 
 // WorldStorage.h
 
-// Interfaces to the cWorldStorage class representing the chunk loading / saving thread
+// Interfaces to the cWorldStorage class representing the pool of chunk loading / saving threads
+// The chunks are loaded in the order given by the world's cChunkScheduler, nearest to the players first
+// Loading has priority over saving; saves are taken in batches of chunks from a single region, so that
+// the schema can write them together (see cWSSchema::SaveChunks())
 // This class decides which storage schema to use for saving; it queries all available schemas for loading
 // Also declares the base class for all storage schemas, cWSSchema
 // Helper serialization class cJsonChunkSerializer is declared as well
@@ -15,8 +18,11 @@
 #define WORLDSTORAGE_H_INCLUDED
 
 #include "../ChunkDef.h"
+#include "../ChunkScheduler.h"
+#include "ChunkJournal.h"
 #include "../OSSupport/IsThread.h"
 #include "../OSSupport/Queue.h"
+#include <unordered_set>
 
 
 
@@ -31,7 +37,8 @@ typedef cQueue<cChunkCoordsWithCallback> cChunkCoordsQueue;
 
 
 
-/// Interface that all the world storage schemas need to implement
+/** Interface that all the world storage schemas need to implement.
+The functions are called from all the storage threads concurrently, the schemas need to be thread-safe. */
 class cWSSchema abstract
 {
 public:
@@ -41,6 +48,26 @@ public:
 	virtual bool LoadChunk(const cChunkCoords & a_Chunk) = 0;
 	virtual bool SaveChunk(const cChunkCoords & a_Chunk) = 0;
 	virtual const AString GetName(void) const = 0;
+
+	/** Saves all the specified chunks; a_IsSaved receives the result for each chunk, at the same index as in a_Chunks.
+	The chunks in a single call all belong to the same 32x32 chunk region.
+	The default implementation saves the chunks one by one; schemas may override it to write the whole batch at once. */
+	virtual void SaveChunks(const cChunkCoordsVector & a_Chunks, std::vector<bool> & a_IsSaved)
+	{
+		a_IsSaved.clear();
+		for (const auto & Chunk: a_Chunks)
+		{
+			a_IsSaved.push_back(SaveChunk(Chunk));
+		}
+	}
+
+	/** Rewrites the schema's files so that they don't waste any space. Called while chunks are being loaded and saved by other threads.
+	The default implementation does nothing, for schemas that have nothing to compact. */
+	virtual void CompactFiles(void) {}
+
+	/** Hints that the specified chunks are likely to be loaded soon, so that the schema may read their data ahead, in bulk.
+	The chunks may come from any regions and needn't exist in the storage. The default implementation does nothing. */
+	virtual void PrefetchChunks(const cChunkCoordsVector & a_Chunks) { UNUSED(a_Chunks); }
 	
 protected:
 
@@ -54,11 +81,8 @@ typedef std::list<cWSSchema *> cWSSchemaList;
 
 
 /// The actual world storage class
-class cWorldStorage :
-	public cIsThread
+class cWorldStorage
 {
-	typedef cIsThread super;
-	
 public:
 
 	cWorldStorage(void);
@@ -70,8 +94,11 @@ public:
 	void UnqueueLoad(int a_ChunkX, int a_ChunkZ);
 	void UnqueueSave(const cChunkCoords & a_Chunk);
 	
-	bool Start(cWorld * a_World, const AString & a_StorageSchemaName, int a_StorageCompressionFactor);  // Hide the cIsThread's Start() method, we need to provide args
-	void Stop(void);  // Hide the cIsThread's Stop() method, we need to signal the event
+	/** Starts the specified number of storage threads, loading and saving the chunks of a_World.
+	If a_ShouldCompactFiles is true, the storage files are compacted before the threads start (offline compaction).
+	If a_JournalSyncInterval is positive, the block changes are journaled and the journal is synced to the disk in this interval (in msec). */
+	bool Start(cWorld * a_World, const AString & a_StorageSchemaName, int a_StorageCompressionFactor, int a_NumThreads, bool a_ShouldCompactFiles, int a_JournalSyncInterval);
+	void Stop(void);
 	void WaitForFinish(void);
 	void WaitForLoadQueueEmpty(void);
 	void WaitForSaveQueueEmpty(void);
@@ -79,8 +106,46 @@ public:
 	size_t GetLoadQueueLength(void);
 	size_t GetSaveQueueLength(void);
 	
+	/** Queues the compaction of the storage files, to be done by a storage thread while the chunks are being loaded and saved (online compaction). */
+	void QueueCompactFiles(void);
+
+	/** Returns the number of threads loading and saving the chunks. */
+	size_t GetNumThreads(void) const { return m_Workers.size(); }
+
+	/** Returns the journal of the block changes not yet saved. */
+	cChunkJournal & GetJournal(void) { return m_Journal; }
+
 protected:
 
+	/** A single thread loading and saving chunks from the shared queues. */
+	class cWorker :
+		public cIsThread
+	{
+		typedef cIsThread super;
+
+	public:
+		cWorker(cWorldStorage & a_WorldStorage);
+
+		/** Signals the thread to terminate and waits until it's finished. */
+		void Stop(void);
+
+		/** Wakes the thread up if it's waiting for an item to process. */
+		void WakeUp(void) { m_evtItemAdded.Set(); }
+
+	protected:
+		cWorldStorage & m_WorldStorage;
+
+		/** Set when an item may be available for this worker, or to stop the thread */
+		cEvent m_evtItemAdded;
+
+		virtual void Execute(void) override;
+	} ;
+
+	typedef std::vector<cWorker *> cWorkers;
+	typedef std::vector<cChunkCoordsWithCallback> cChunkCoordsWithCallbackVector;
+	typedef std::unordered_set<cChunkCoords, cChunkCoordsHash> cChunkCoordsSet;
+
+
 	cWorld * m_World;
 	AString  m_StorageSchemaName;
 
@@ -93,21 +158,52 @@ protected:
 	/// The one storage schema used for saving
 	cWSSchema *   m_SaveSchema;
 
+	/** The threads doing the actual loading and saving. */
+	cWorkers m_Workers;
+
+	/** Protects m_SavesInProgress */
+	cCriticalSection m_CSSavesInProgress;
+
+	/** The chunks that are currently being saved by the workers.
+	A chunk is not taken from the save queue while it is being saved by another worker, so that an older version of the chunk cannot overwrite a newer one. */
+	cChunkCoordsSet m_SavesInProgress;
+
+	/** Set by QueueCompactFiles(), cleared by the worker that takes on the compaction. */
+	std::atomic<bool> m_ShouldCompactFiles;
+
+	/** The journal of the block changes, so that they survive a crash before the chunks are saved. */
+	cChunkJournal m_Journal;
+
+	/** Protects m_PrefetchPositions. */
+	cCriticalSection m_CSPrefetch;
+
+	/** For each player with a heading, the chunk the player was in when the chunks ahead of it were last prefetched, keyed by the player's ID. */
+	std::unordered_map<int, cChunkCoords> m_PrefetchPositions;
+
 	
 	/// Loads the chunk specified; returns true on success, false on failure
 	bool LoadChunk(int a_ChunkX, int a_ChunkZ);
 
 	void InitSchemas(int a_StorageCompressionFactor);
 	
-	virtual void Execute(void) override;
-	
-	cEvent m_Event;       // Set when there's any addition to the queues
+	/** Wakes up all the workers, to be called whenever an item is queued. */
+	void WakeUpWorkers(void);
 
-	/// Loads one chunk from the queue (if any queued); returns true if there are more chunks in the load queue
+	/** Stops all the workers, each finishing the batch it is currently saving, and deletes them. */
+	void StopWorkers(void);
+
+	/** Loads the chunk with the best priority from the queue (if any queued); returns true if a chunk was taken from the queue. */
 	bool LoadOneChunk(void);
+
+	/** Asks the save schema to prefetch the chunks ahead of each player that has moved to another chunk since the last prefetch,
+	so that players moving fast don't outrun the loading. */
+	void PrefetchChunksAhead(const cChunkScheduler::cSnapshot & a_Scheduler);
 	
-	/// Saves one chunk from the queue (if any queued); returns true if there are more chunks in the save queue
-	bool SaveOneChunk(void);
+	/** Saves a batch of queued chunks, all from the same region (if any queued); returns true if a batch was processed. */
+	bool SaveChunkBatch(void);
+
+	/** Compacts the files of the save schema, if queued; returns true if the compaction was done. */
+	bool CompactFilesIfQueued(void);
 } ;
 
 
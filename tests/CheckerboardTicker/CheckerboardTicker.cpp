@@ -0,0 +1,168 @@
+
+// CheckerboardTicker.cpp
+
+// Stress-tests the cCheckerboardTicker class with several threads ticking a grid of regions
+
+#include "Globals.h"
+#include "CheckerboardTicker.h"
+
+
+
+
+
+/** Size of the grid of regions, in each direction */
+static const int GRID_SIZE = 9;
+
+/** Number of ticks to run for each number of threads */
+static const int NUM_TICKS = 300;
+
+
+
+
+
+class cTestRegion;
+
+/** The grid of all the regions, for checking the neighbors. */
+static cTestRegion * g_Grid[GRID_SIZE][GRID_SIZE];
+
+/** Set when a region was ticked while one of its neighbors was being ticked, too. */
+static std::atomic<bool> g_HasCollided(false);
+
+/** Set when a region was ticked with a wrong Dt. */
+static std::atomic<bool> g_HasWrongDt(false);
+
+
+
+
+
+class cTestRegion :
+	public cCheckerboardTicker::cRegion
+{
+public:
+	cTestRegion(int a_X, int a_Z) :
+		m_X(a_X),
+		m_Z(a_Z),
+		m_IsTicking(false),
+		m_NumTicks(0),
+		m_Work(0)
+	{
+	}
+
+	virtual int GetRegionX(void) const override { return m_X; }
+	virtual int GetRegionZ(void) const override { return m_Z; }
+
+	virtual void TickRegion(float a_Dt) override
+	{
+		if (a_Dt != 50)
+		{
+			g_HasWrongDt = true;
+		}
+		m_IsTicking = true;
+		CheckNeighbors();
+
+		// Simulate some work reaching into the neighbors, so that the ticks of the threads overlap:
+		for (int i = 0; i < 2000; i++)
+		{
+			m_Work = m_Work * 1103515245 + 12345;
+		}
+		CheckNeighbors();
+
+		m_NumTicks += 1;
+		m_IsTicking = false;
+	}
+
+	/** Number of times the region has been ticked. Written only by the ticking threads, one at a time. */
+	int GetNumTicks(void) const { return m_NumTicks; }
+
+protected:
+	int m_X, m_Z;
+	std::atomic<bool> m_IsTicking;
+	int m_NumTicks;
+	unsigned m_Work;
+
+	void CheckNeighbors(void)
+	{
+		for (int x = m_X - 1; x <= m_X + 1; x++)
+		{
+			for (int z = m_Z - 1; z <= m_Z + 1; z++)
+			{
+				if (
+					(x >= 0) && (x < GRID_SIZE) && (z >= 0) && (z < GRID_SIZE) &&
+					((x != m_X) || (z != m_Z)) &&
+					g_Grid[x][z]->m_IsTicking
+				)
+				{
+					g_HasCollided = true;
+				}
+			}
+		}
+	}
+} ;
+
+
+
+
+
+static void TestWithThreads(int a_NumThreads)
+{
+	cCheckerboardTicker::cRegions Regions;
+	for (int x = 0; x < GRID_SIZE; x++)
+	{
+		for (int z = 0; z < GRID_SIZE; z++)
+		{
+			g_Grid[x][z] = new cTestRegion(x, z);
+			Regions.push_back(g_Grid[x][z]);
+		}
+	}
+
+	cCheckerboardTicker Ticker;
+	Ticker.StartThreads(a_NumThreads);
+	testassert(Ticker.GetNumThreads() == static_cast<size_t>(std::max(a_NumThreads, 1)));
+	for (int i = 0; i < NUM_TICKS; i++)
+	{
+		Ticker.Tick(Regions, 50);
+		testassert(!Ticker.IsTickingParallel());
+	}
+	Ticker.StopThreads();
+	testassert(Ticker.GetNumThreads() == 1);
+
+	// Each region has been ticked exactly once per tick, never together with a neighbor:
+	testassert(!g_HasCollided);
+	testassert(!g_HasWrongDt);
+	for (int x = 0; x < GRID_SIZE; x++)
+	{
+		for (int z = 0; z < GRID_SIZE; z++)
+		{
+			testassert(g_Grid[x][z]->GetNumTicks() == NUM_TICKS);
+			delete g_Grid[x][z];
+			g_Grid[x][z] = nullptr;
+		}
+	}
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	TestWithThreads(1);
+	TestWithThreads(2);
+	TestWithThreads(4);
+	TestWithThreads(8);
+
+	// Restarting the threads with a different count replaces the previous ones:
+	{
+		cCheckerboardTicker Ticker;
+		Ticker.StartThreads(4);
+		Ticker.StartThreads(3);
+		testassert(Ticker.GetNumThreads() == 3);
+	}
+
+	LOG("CheckerboardTicker test finished");
+	return 0;
+}
+
+
+
+
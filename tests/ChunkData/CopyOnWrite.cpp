@@ -0,0 +1,103 @@
+
+#include "Globals.h"
+#include "ChunkData.h"
+
+
+
+int main(int argc, char** argv)
+{
+	class cMockAllocationPool
+		: public cAllocationPool<cChunkData::sChunkSection>
+	{
+	public:
+		int m_NumAllocated;
+
+		cMockAllocationPool(void) :
+			m_NumAllocated(0)
+		{
+		}
+
+		virtual cChunkData::sChunkSection * Allocate()
+		{
+			m_NumAllocated++;
+			return new cChunkData::sChunkSection();
+		}
+
+		virtual void Free(cChunkData::sChunkSection * a_Ptr)
+		{
+			if (a_Ptr != nullptr)
+			{
+				m_NumAllocated--;
+			}
+			delete a_Ptr;
+		}
+	} Pool;
+	{
+		cChunkData buffer(Pool);
+		buffer.SetBlock(3, 1, 4, 0xDE);
+		buffer.SetMeta(3, 1, 4, 0xA);
+		testassert(Pool.m_NumAllocated == 1);
+
+		// The copy shares the section:
+		cChunkData copy = buffer.Copy();
+		testassert(Pool.m_NumAllocated == 1);
+		testassert(copy.GetBlock(3, 1, 4) == 0xDE);
+		testassert(copy.GetMeta(3, 1, 4) == 0xA);
+
+		// Writing into the copy duplicates the section and leaves the original untouched:
+		copy.SetBlock(3, 1, 4, 0xAD);
+		copy.SetMeta(3, 1, 4, 0x5);
+		testassert(Pool.m_NumAllocated == 2);
+		testassert(copy.GetBlock(3, 1, 4) == 0xAD);
+		testassert(copy.GetMeta(3, 1, 4) == 0x5);
+		testassert(buffer.GetBlock(3, 1, 4) == 0xDE);
+		testassert(buffer.GetMeta(3, 1, 4) == 0xA);
+
+		// Writing into the original duplicates the section, too:
+		{
+			cChunkData copy2 = buffer.Copy();
+			buffer.SetBlock(3, 1, 4, 0x01);
+			testassert(Pool.m_NumAllocated == 3);
+			testassert(copy2.GetBlock(3, 1, 4) == 0xDE);
+		}
+		testassert(Pool.m_NumAllocated == 2);
+
+		// Once the copy is gone, the original is written in place:
+		buffer.SetBlock(3, 1, 4, 0x02);
+		testassert(Pool.m_NumAllocated == 2);
+		testassert(buffer.GetBlock(3, 1, 4) == 0x02);
+	}
+	testassert(Pool.m_NumAllocated == 0);
+
+	{
+		cChunkData buffer(Pool);
+
+		// Fill a section with an increasing number of distinct blocktypes, widening the palette all the way up to 8 bits:
+		for (int i = 0; i < 256; i++)
+		{
+			buffer.SetBlock(i % 16, i / 16, 7, static_cast<BLOCKTYPE>(i));
+			for (int j = 0; j <= i; j++)
+			{
+				testassert(buffer.GetBlock(j % 16, j / 16, 7) == static_cast<BLOCKTYPE>(j));
+			}
+		}
+
+		// Set the entire chunk from a flat array containing only two blocktypes and read it back:
+		BLOCKTYPE SrcBlockBuffer[16 * 16 * 256];
+		for (int i = 0; i < 16 * 16 * 256; i++)
+		{
+			SrcBlockBuffer[i] = ((i % 3) == 0) ? 0x01 : 0x00;
+		}
+		buffer.SetBlockTypes(SrcBlockBuffer);
+		BLOCKTYPE DstBlockBuffer[16 * 16 * 256];
+		buffer.CopyBlockTypes(DstBlockBuffer);
+		testassert(memcmp(SrcBlockBuffer, DstBlockBuffer, sizeof(DstBlockBuffer)) == 0);
+		testassert(buffer.GetBlock(0, 0, 0) == 0x01);
+		testassert(buffer.GetBlock(1, 0, 0) == 0x00);
+		testassert(buffer.GetBlock(3, 255, 15) == SrcBlockBuffer[cChunkDef::MakeIndexNoCheck(3, 255, 15)]);
+	}
+	testassert(Pool.m_NumAllocated == 0);
+
+	// All tests successful:
+	return 0;
+}
@@ -0,0 +1,248 @@
+// ChunkJournal.cpp
+
+// Tests the cChunkJournal class: coalescing the changes per block, the sharded state, and the replay after the chunk saves
+
+#include "Globals.h"
+#include "WorldStorage/ChunkJournal.h"
+#include <thread>
+
+
+
+
+
+/** The journal file used by the tests, in the current folder. */
+static const AString JOURNAL_FILE = "ChunkJournalTest.mcj";
+
+/** The size of a single block change record in the journal file. */
+static const int BLOCK_CHANGE_RECORD_SIZE = 22;
+
+/** The sync interval used when the test doesn't want the journal to sync before it is stopped, in milliseconds. */
+static const int NO_SYNC_INTERVAL = 1000000;
+
+
+
+
+
+/** Starts a new journal on the file left over by the previous one; the changes read from the file can then be taken for the replay. */
+static void Reopen(cChunkJournal & a_Journal)
+{
+	testassert(a_Journal.Start(JOURNAL_FILE, NO_SYNC_INTERVAL));
+}
+
+
+
+
+
+/** Changing a single block many times between two syncs journals only its last change. */
+static void TestCoalescing(void)
+{
+	cFile::Delete(JOURNAL_FILE);
+	{
+		cChunkJournal Journal;
+		testassert(Journal.Start(JOURNAL_FILE, NO_SYNC_INTERVAL));
+		for (int i = 1; i <= 100; i++)
+		{
+			Journal.AddBlockChange(3, -5, 1, 64, 2, static_cast<BLOCKTYPE>(i), static_cast<NIBBLETYPE>(i % 16));
+		}
+		Journal.AddBlockChange(3, -5, 2, 64, 2, E_BLOCK_STONE, 0);
+		Journal.Stop();
+	}
+	testassert(cFile::GetSize(JOURNAL_FILE) == 2 * BLOCK_CHANGE_RECORD_SIZE);
+
+	cChunkJournal Journal;
+	Reopen(Journal);
+	cChunkJournal::cBlockChanges Changes;
+	testassert(Journal.TakeReplayChanges(3, -5, Changes));
+	testassert(Changes.size() == 2);
+	testassert((Changes[0].m_RelX == 1) && (Changes[0].m_RelY == 64) && (Changes[0].m_RelZ == 2));
+	testassert((Changes[0].m_BlockType == 100) && (Changes[0].m_BlockMeta == 100 % 16));
+	testassert((Changes[1].m_RelX == 2) && (Changes[1].m_BlockType == E_BLOCK_STONE));
+
+	// The changes are taken only once:
+	testassert(!Journal.TakeReplayChanges(3, -5, Changes));
+	Journal.Stop();
+	LOG("Coalescing test finished");
+}
+
+
+
+
+
+/** Several threads journal changes of chunks spread over all the shards, including chunks that share a shard.
+Each chunk gets back exactly its own changes. */
+static void TestSharding(void)
+{
+	static const int NUM_THREADS = 4;
+	static const int MIN_COORD = -20;
+	static const int MAX_COORD = 20;
+	cFile::Delete(JOURNAL_FILE);
+	{
+		cChunkJournal Journal;
+		testassert(Journal.Start(JOURNAL_FILE, 1));
+		std::vector<std::thread> Threads;
+		for (int t = 0; t < NUM_THREADS; t++)
+		{
+			Threads.emplace_back([&Journal, t]()
+				{
+					// Each thread changes its own column of blocks in every chunk, with the block type identifying the chunk:
+					for (int x = MIN_COORD; x <= MAX_COORD; x++)
+					{
+						for (int z = MIN_COORD; z <= MAX_COORD; z++)
+						{
+							for (int y = 0; y < 10; y++)
+							{
+								Journal.AddBlockChange(x, z, t, y, 0, static_cast<BLOCKTYPE>(x - MIN_COORD), static_cast<NIBBLETYPE>((z - MIN_COORD) % 16));
+							}
+						}
+					}
+				}
+			);
+		}
+		for (auto & Thread : Threads)
+		{
+			Thread.join();
+		}
+		Journal.Stop();
+	}
+
+	cChunkJournal Journal;
+	Reopen(Journal);
+	for (int x = MIN_COORD; x <= MAX_COORD; x++)
+	{
+		for (int z = MIN_COORD; z <= MAX_COORD; z++)
+		{
+			cChunkJournal::cBlockChanges Changes;
+			testassert(Journal.TakeReplayChanges(x, z, Changes));
+			testassert(Changes.size() == NUM_THREADS * 10);
+			for (const auto & Change : Changes)
+			{
+				testassert((Change.m_RelX < NUM_THREADS) && (Change.m_RelY < 10) && (Change.m_RelZ == 0));
+				testassert(Change.m_BlockType == x - MIN_COORD);
+				testassert(Change.m_BlockMeta == (z - MIN_COORD) % 16);
+			}
+		}
+	}
+	cChunkJournal::cBlockChanges Changes;
+	testassert(!Journal.TakeReplayChanges(MAX_COORD + 1, 0, Changes));
+	Journal.Stop();
+	LOG("Sharding test finished");
+}
+
+
+
+
+
+/** The changes are replayed in the order they were made, regardless of the order of the blocks. */
+static void TestReplayOrder(void)
+{
+	static const int Order[] = { 7, 2, 12, 0, 15, 9, 4 };
+	cFile::Delete(JOURNAL_FILE);
+	{
+		cChunkJournal Journal;
+		testassert(Journal.Start(JOURNAL_FILE, NO_SYNC_INTERVAL));
+		for (size_t i = 0; i < ARRAYCOUNT(Order); i++)
+		{
+			Journal.AddBlockChange(0, 0, Order[i], 10, Order[i], E_BLOCK_DIRT, 0);
+		}
+
+		// Changing a block again moves it to the end of the replay:
+		Journal.AddBlockChange(0, 0, Order[0], 10, Order[0], E_BLOCK_GRASS, 0);
+		Journal.Stop();
+	}
+
+	cChunkJournal Journal;
+	Reopen(Journal);
+	cChunkJournal::cBlockChanges Changes;
+	testassert(Journal.TakeReplayChanges(0, 0, Changes));
+	testassert(Changes.size() == ARRAYCOUNT(Order));
+	for (size_t i = 1; i < ARRAYCOUNT(Order); i++)
+	{
+		testassert(Changes[i - 1].m_RelX == Order[i]);
+		testassert(Changes[i - 1].m_Seq < Changes[i].m_Seq);
+	}
+	testassert((Changes.back().m_RelX == Order[0]) && (Changes.back().m_BlockType == E_BLOCK_GRASS));
+	Journal.Stop();
+	LOG("Replay order test finished");
+}
+
+
+
+
+
+/** A chunk save drops only the changes journaled before the save started (ChunkSaving()),
+both while they are still waiting to be written and after they have been written to the file. */
+static void TestSaves(void)
+{
+	cFile::Delete(JOURNAL_FILE);
+	{
+		cChunkJournal Journal;
+		testassert(Journal.Start(JOURNAL_FILE, 1));
+
+		// Chunk [1, 1]: a change written to the file, then saved while another change is made:
+		Journal.AddBlockChange(1, 1, 0, 0, 0, E_BLOCK_STONE, 0);
+		Journal.AddBlockChange(1, 1, 1, 0, 0, E_BLOCK_STONE, 0);
+		while (cFile::GetSize(JOURNAL_FILE) < 2 * BLOCK_CHANGE_RECORD_SIZE)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		Journal.ChunkSaving(1, 1);
+		Journal.AddBlockChange(1, 1, 1, 0, 0, E_BLOCK_DIRT, 0);  // Changed again after the save started, must survive
+		Journal.ChunkSaved(1, 1);
+
+		// Chunk [2, 2]: a save that hasn't finished doesn't drop anything:
+		Journal.AddBlockChange(2, 2, 0, 0, 0, E_BLOCK_STONE, 0);
+		Journal.ChunkSaving(2, 2);
+
+		// Chunk [3, 3]: a finished save without a ChunkSaving() call doesn't drop anything:
+		Journal.AddBlockChange(3, 3, 0, 0, 0, E_BLOCK_STONE, 0);
+		Journal.ChunkSaved(3, 3);
+
+		// Chunk [4, 4]: all the changes are saved:
+		Journal.AddBlockChange(4, 4, 0, 0, 0, E_BLOCK_STONE, 0);
+		Journal.ChunkSaving(4, 4);
+		Journal.ChunkSaved(4, 4);
+		Journal.Stop();
+	}
+
+	cChunkJournal Journal;
+	Reopen(Journal);
+	cChunkJournal::cBlockChanges Changes;
+	testassert(Journal.TakeReplayChanges(1, 1, Changes));
+	testassert(Changes.size() == 1);
+	testassert((Changes[0].m_RelX == 1) && (Changes[0].m_BlockType == E_BLOCK_DIRT));
+	testassert(Journal.TakeReplayChanges(2, 2, Changes));
+	testassert(Changes.size() == 1);
+	testassert(Journal.TakeReplayChanges(3, 3, Changes));
+	testassert(Changes.size() == 1);
+	testassert(!Journal.TakeReplayChanges(4, 4, Changes));
+
+	// The reopened journal continues the Seq numbers, so the replayed changes can be saved away, too:
+	Journal.ChunkSaving(1, 1);
+	Journal.ChunkSaved(1, 1);
+	Journal.Stop();
+	{
+		cChunkJournal Journal2;
+		Reopen(Journal2);
+		testassert(!Journal2.TakeReplayChanges(1, 1, Changes));
+		testassert(Journal2.TakeReplayChanges(2, 2, Changes));
+		Journal2.Stop();
+	}
+	LOG("Saves test finished");
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	TestCoalescing();
+	TestSharding();
+	TestReplayOrder();
+	TestSaves();
+	cFile::Delete(JOURNAL_FILE);
+	cFile::Delete(JOURNAL_FILE + ".new");
+
+	LOG("ChunkJournal test finished");
+	return 0;
+}
@@ -0,0 +1,308 @@
+// ChunkScheduler.cpp
+
+// Tests the cChunkScheduler class prioritizing the chunk requests by the player distance and looking ahead of the moving players
+
+#include "Globals.h"
+#include "ChunkScheduler.h"
+#include "OSSupport/Queue.h"
+
+
+
+
+
+/** Sets the players in the scheduler and fills a_Snapshot with them. */
+static void MakeSnapshot(cChunkScheduler & a_Scheduler, const cChunkScheduler::cPlayers & a_Players, cChunkScheduler::cSnapshot & a_Snapshot)
+{
+	a_Scheduler.SetPlayers(a_Players);
+	a_Scheduler.GetSnapshot(a_Snapshot);
+}
+
+
+
+
+
+/** Dequeues all the chunks from a_Queue the same way as the storage does, returns them in the dequeued order. */
+static cChunkCoordsVector DequeueAll(cQueue<cChunkCoords> & a_Queue, const cChunkScheduler::cSnapshot & a_Snapshot)
+{
+	cChunkCoordsVector res;
+	cChunkCoords Coords(0, 0);
+	while (a_Queue.TryDequeueBestItem(Coords, [&a_Snapshot](const cChunkCoords & a_Item)
+		{
+			return a_Snapshot.GetPriority(a_Item.m_ChunkX, a_Item.m_ChunkZ);
+		}
+	))
+	{
+		res.push_back(Coords);
+	}
+	return res;
+}
+
+
+
+
+
+/** The priority is the distance to the nearest player who wants the chunk, up to one chunk beyond its view distance. */
+static void TestPriority(void)
+{
+	cChunkScheduler Scheduler;
+	cChunkScheduler::cSnapshot Snapshot;
+
+	// No players, nobody wants anything:
+	Scheduler.GetSnapshot(Snapshot);
+	testassert(Snapshot.GetPriority(0, 0) == cChunkScheduler::UNWANTED);
+
+	cChunkScheduler::cPlayers Players;
+	Players.push_back(cChunkScheduler::sPlayer(1, 0, 0, 4));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(Snapshot.GetPriority(0, 0) == 0);
+	testassert(Snapshot.GetPriority(3, -2) == 3);
+	testassert(Snapshot.GetPriority(-4, 4) == 4);
+	testassert(Snapshot.GetPriority(5, 0) == 5);  // Needed for lighting the edge of the view
+	testassert(Snapshot.GetPriority(0, -6) == cChunkScheduler::UNWANTED);
+	testassert(Snapshot.GetPriority(100, 100) == cChunkScheduler::UNWANTED);
+
+	// With a second player, the nearer one counts, even if the chunk is within the view of both:
+	Players.push_back(cChunkScheduler::sPlayer(2, 10, 0, 8));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(Snapshot.GetPriority(3, 0) == 3);
+	testassert(Snapshot.GetPriority(6, 0) == 4);
+	testassert(Snapshot.GetPriority(2, -6) == 8);  // Beyond the first player's view, but within the second's
+	testassert(Snapshot.GetPriority(20, 0) == cChunkScheduler::UNWANTED);
+
+	// A snapshot keeps its players when the scheduler is updated:
+	Players.clear();
+	Scheduler.SetPlayers(Players);
+	testassert(Snapshot.GetPriority(0, 0) == 0);
+	Scheduler.GetSnapshot(Snapshot);
+	testassert(Snapshot.GetPriority(0, 0) == cChunkScheduler::UNWANTED);
+	LOG("Priority test finished");
+}
+
+
+
+
+
+/** The queue gives out the chunks nearest to the players first, the older request first on a tie, and the unwanted chunks last. */
+static void TestQueueOrder(void)
+{
+	cChunkScheduler Scheduler;
+	cChunkScheduler::cSnapshot Snapshot;
+	cChunkScheduler::cPlayers Players;
+	Players.push_back(cChunkScheduler::sPlayer(1, 0, 0, 3));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+
+	cQueue<cChunkCoords> Queue;
+	Queue.EnqueueItem(cChunkCoords(50, 50));  // Unwanted
+	Queue.EnqueueItem(cChunkCoords(3, 0));
+	Queue.EnqueueItem(cChunkCoords(0, 1));
+	Queue.EnqueueItem(cChunkCoords(-1, -1));  // Same distance as [0, 1], but queued later
+	Queue.EnqueueItem(cChunkCoords(-60, 0));  // Unwanted, queued later
+	Queue.EnqueueItem(cChunkCoords(0, 0));
+	cChunkCoordsVector Order = DequeueAll(Queue, Snapshot);
+	testassert(Order.size() == 6);
+	testassert(Order[0] == cChunkCoords(0, 0));
+	testassert(Order[1] == cChunkCoords(0, 1));
+	testassert(Order[2] == cChunkCoords(-1, -1));
+	testassert(Order[3] == cChunkCoords(3, 0));
+	testassert(Order[4] == cChunkCoords(50, 50));
+	testassert(Order[5] == cChunkCoords(-60, 0));
+
+	// After the player teleports, the chunks around the new position come first:
+	for (int x = -2; x <= 2; x++)
+	{
+		Queue.EnqueueItem(cChunkCoords(x, 0));
+		Queue.EnqueueItem(cChunkCoords(x + 100, 0));
+	}
+	Players[0].m_ChunkX = 100;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	Order = DequeueAll(Queue, Snapshot);
+	testassert(Order.size() == 10);
+	testassert(Order[0] == cChunkCoords(100, 0));
+	for (size_t i = 1; i < 5; i++)
+	{
+		testassert(Order[i].m_ChunkX >= 98);
+		testassert(Snapshot.GetPriority(Order[i - 1].m_ChunkX, Order[i - 1].m_ChunkZ) <= Snapshot.GetPriority(Order[i].m_ChunkX, Order[i].m_ChunkZ));
+	}
+	for (size_t i = 5; i < 10; i++)
+	{
+		testassert(Order[i].m_ChunkX == static_cast<int>(i) - 7);  // The unwanted chunks, in the queued order
+	}
+	LOG("Queue order test finished");
+}
+
+
+
+
+
+/** Returns the heading of the only player in a_Snapshot, encoded as a single number for easy comparison. */
+static int GetHeading(const cChunkScheduler::cSnapshot & a_Snapshot)
+{
+	testassert(a_Snapshot.GetPlayers().size() == 1);
+	const cChunkScheduler::sPlayer & Player = a_Snapshot.GetPlayers()[0];
+	return Player.m_HeadingX * 10 + Player.m_HeadingZ;
+}
+
+
+
+
+
+/** The heading follows the player's moves between the chunks; staying in a chunk keeps it, a teleport clears it. */
+static void TestHeading(void)
+{
+	cChunkScheduler Scheduler;
+	cChunkScheduler::cSnapshot Snapshot;
+	cChunkScheduler::cPlayers Players;
+	Players.push_back(cChunkScheduler::sPlayer(1, 0, 0, 4));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(!Snapshot.GetPlayers()[0].HasHeading());
+
+	Players[0].m_ChunkX = 1;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(GetHeading(Snapshot) == 10);
+
+	// Staying in the same chunk keeps the heading:
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(GetHeading(Snapshot) == 10);
+
+	// A diagonal move, skipping a chunk in one of the directions:
+	Players[0].m_ChunkX = 0;
+	Players[0].m_ChunkZ = 2;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(GetHeading(Snapshot) == -9);
+
+	// A teleport:
+	Players[0].m_ChunkX = 50;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(!Snapshot.GetPlayers()[0].HasHeading());
+
+	// The heading is kept per player, a player that leaves and comes back starts anew:
+	Players[0].m_ChunkX = 51;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(GetHeading(Snapshot) == 10);
+	Players.clear();
+	Scheduler.SetPlayers(Players);
+	Players.push_back(cChunkScheduler::sPlayer(1, 52, 2, 4));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	testassert(!Snapshot.GetPlayers()[0].HasHeading());
+	LOG("Heading test finished");
+}
+
+
+
+
+
+/** For each heading, the chunks ahead are exactly those that the player will newly want after one more step in it. */
+static void TestChunksAhead(void)
+{
+	for (int HeadingX = -1; HeadingX <= 1; HeadingX++)
+	{
+		for (int HeadingZ = -1; HeadingZ <= 1; HeadingZ++)
+		{
+			cChunkScheduler::sPlayer Player(1, 3, -7, 5);
+			Player.m_HeadingX = HeadingX;
+			Player.m_HeadingZ = HeadingZ;
+			cChunkCoordsVector Chunks;
+			cChunkScheduler::GetChunksAhead(Player, Chunks);
+
+			// Compare with the difference between the chunks wanted now and after the step:
+			cChunkScheduler Scheduler;
+			cChunkScheduler::cSnapshot Now, Next;
+			cChunkScheduler::cPlayers Players;
+			Players.push_back(Player);
+			MakeSnapshot(Scheduler, Players, Now);
+			Players[0].m_ChunkX += HeadingX;
+			Players[0].m_ChunkZ += HeadingZ;
+			MakeSnapshot(Scheduler, Players, Next);
+			size_t NumExpected = 0;
+			for (int x = -20; x <= 20; x++)
+			{
+				for (int z = -30; z <= 20; z++)
+				{
+					bool IsAhead = (
+						(Now.GetPriority(x, z) == cChunkScheduler::UNWANTED) &&
+						(Next.GetPriority(x, z) != cChunkScheduler::UNWANTED)
+					);
+					size_t NumFound = static_cast<size_t>(std::count(Chunks.begin(), Chunks.end(), cChunkCoords(x, z)));
+					testassert(NumFound == (IsAhead ? 1 : 0));
+					NumExpected += NumFound;
+				}
+			}
+			testassert(Chunks.size() == NumExpected);
+			testassert(Chunks.empty() == !Player.HasHeading());
+		}
+	}
+	LOG("Chunks ahead test finished");
+}
+
+
+
+
+
+/** The chunks ahead of a player aren't wanted until the player makes the step, so they can only be prefetched.
+After the step they are loaded after the chunks nearer to the player, but still before the chunks
+that nobody wants, such as those queued by a pregeneration. */
+static void TestLookAheadOrder(void)
+{
+	cChunkScheduler Scheduler;
+	cChunkScheduler::cSnapshot Snapshot;
+	cChunkScheduler::cPlayers Players;
+	Players.push_back(cChunkScheduler::sPlayer(1, 0, 0, 3));
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	Players[0].m_ChunkX = 1;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	cChunkCoordsVector Ahead;
+	cChunkScheduler::GetChunksAhead(Snapshot.GetPlayers()[0], Ahead);
+	testassert(Ahead.size() == 9);
+	for (cChunkCoordsVector::const_iterator itr = Ahead.begin(), end = Ahead.end(); itr != end; ++itr)
+	{
+		testassert(itr->m_ChunkX == 6);
+		testassert(Snapshot.GetPriority(itr->m_ChunkX, itr->m_ChunkZ) == cChunkScheduler::UNWANTED);
+	}
+
+	// The pregeneration chunks are queued first, then the chunks ahead, then the chunks around the player:
+	cQueue<cChunkCoords> Queue;
+	for (int x = 100; x < 103; x++)
+	{
+		Queue.EnqueueItem(cChunkCoords(x, 0));
+	}
+	for (cChunkCoordsVector::const_iterator itr = Ahead.begin(), end = Ahead.end(); itr != end; ++itr)
+	{
+		Queue.EnqueueItem(*itr);
+	}
+	Queue.EnqueueItem(cChunkCoords(4, 0));
+	Queue.EnqueueItem(cChunkCoords(2, 1));
+
+	// The player makes the step:
+	Players[0].m_ChunkX = 2;
+	MakeSnapshot(Scheduler, Players, Snapshot);
+	cChunkCoordsVector Order = DequeueAll(Queue, Snapshot);
+	testassert(Order.size() == 14);
+	testassert(Order[0] == cChunkCoords(2, 1));
+	testassert(Order[1] == cChunkCoords(4, 0));
+	for (size_t i = 2; i < 11; i++)
+	{
+		testassert(Order[i].m_ChunkX == 6);
+		testassert(Snapshot.GetPriority(Order[i].m_ChunkX, Order[i].m_ChunkZ) == 4);
+	}
+	for (size_t i = 11; i < 14; i++)
+	{
+		testassert(Order[i] == cChunkCoords(static_cast<int>(i) + 89, 0));  // The pregeneration chunks, in the queued order
+	}
+	LOG("Look-ahead order test finished");
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	TestPriority();
+	TestQueueOrder();
+	TestHeading();
+	TestChunksAhead();
+	TestLookAheadOrder();
+
+	LOG("ChunkScheduler test finished");
+	return 0;
+}
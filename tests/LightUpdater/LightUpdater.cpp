@@ -0,0 +1,418 @@
+// LightUpdater.cpp
+
+// Changes single blocks in a lighted area and checks that cLightUpdater leaves the same light as lighting it from scratch
+
+#include "Globals.h"
+#include "Chunk.h"
+#include "BlockInfo.h"
+
+
+
+
+
+/** A 3 * 3 chunks large world around chunk [0, 0], with the light kept up to date by the chunks' FastSetBlock(). */
+class cTestWorld
+{
+public:
+	/** Size of the world along the X and Z axes, in blocks. */
+	static const int SIZE = cChunkDef::Width * 3;
+
+	/** The light values for the whole world, indexed by Index(). */
+	typedef std::vector<NIBBLETYPE> cLight;
+
+
+	cTestWorld(void)
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			for (int z = 0; z < 3; z++)
+			{
+				cChunk * NeighborXM = (x > 0) ? m_Chunks[x - 1][z] : nullptr;
+				cChunk * NeighborZM = (z > 0) ? m_Chunks[x][z - 1] : nullptr;
+				m_Chunks[x][z] = new cChunk(x - 1, z - 1, nullptr, nullptr, NeighborXM, nullptr, NeighborZM, nullptr, m_Pool);
+			}
+		}
+	}
+
+	~cTestWorld()
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			for (int z = 0; z < 3; z++)
+			{
+				delete m_Chunks[x][z];
+			}
+		}
+	}
+
+	/** Returns the index into cLight for the specified block, the block coords are offset so that the world starts at 0. */
+	static size_t Index(int a_X, int a_Y, int a_Z)
+	{
+		return static_cast<size_t>(a_X + a_Z * SIZE + a_Y * SIZE * SIZE);
+	}
+
+	/** Sets the block the same way as cChunkMap does, the chunk updates its light if it is lighted. */
+	void SetBlock(int a_BlockX, int a_BlockY, int a_BlockZ, BLOCKTYPE a_BlockType)
+	{
+		int RelX = a_BlockX, RelZ = a_BlockZ;
+		GetChunk(RelX, RelZ)->FastSetBlock(RelX, a_BlockY, RelZ, a_BlockType, 0);
+	}
+
+	/** Lights the world from scratch the same way as cLightingThread does: the light sources and the blocks above
+	the heightmap are the seeds, and the light spreads from them losing each block's falloff, until nothing changes.
+	Nothing lies beyond the world, so no light comes from there. */
+	void CalcLight(bool a_IsSkyLight, cLight & a_Light)
+	{
+		a_Light.assign(static_cast<size_t>(SIZE * SIZE * cChunkDef::Height), 0);
+		std::vector<Vector3i> Seeds;
+		for (int z = 0; z < SIZE; z++)
+		{
+			for (int x = 0; x < SIZE; x++)
+			{
+				int RelX = x - cChunkDef::Width, RelZ = z - cChunkDef::Width;
+				cChunk * Chunk = GetChunk(RelX, RelZ);
+				int Height = Chunk->GetHeight(RelX, RelZ);
+				for (int y = 0; y < cChunkDef::Height; y++)
+				{
+					NIBBLETYPE Light = a_IsSkyLight ? ((y > Height) ? 15 : 0) : cBlockInfo::GetLightValue(Chunk->GetBlock(RelX, y, RelZ));
+					if (Light > 0)
+					{
+						a_Light[Index(x, y, z)] = Light;
+						Seeds.push_back(Vector3i(x, y, z));
+					}
+				}
+			}
+		}
+
+		static const Vector3i Offsets[] =
+		{
+			Vector3i( 1,  0,  0),
+			Vector3i(-1,  0,  0),
+			Vector3i( 0,  1,  0),
+			Vector3i( 0, -1,  0),
+			Vector3i( 0,  0,  1),
+			Vector3i( 0,  0, -1),
+		} ;
+		for (size_t i = 0; i < Seeds.size(); i++)
+		{
+			Vector3i Seed = Seeds[i];
+			NIBBLETYPE SeedLight = a_Light[Index(Seed.x, Seed.y, Seed.z)];
+			for (size_t n = 0; n < ARRAYCOUNT(Offsets); n++)
+			{
+				Vector3i Dst = Seed + Offsets[n];
+				if ((Dst.x < 0) || (Dst.x >= SIZE) || (Dst.y < 0) || (Dst.y >= cChunkDef::Height) || (Dst.z < 0) || (Dst.z >= SIZE))
+				{
+					continue;
+				}
+				NIBBLETYPE & DstLight = a_Light[Index(Dst.x, Dst.y, Dst.z)];
+				NIBBLETYPE Falloff = cBlockInfo::GetSpreadLightFalloff(GetBlock(Dst.x, Dst.y, Dst.z));
+				if (SeedLight > DstLight + Falloff)
+				{
+					DstLight = SeedLight - Falloff;
+					Seeds.push_back(Dst);
+				}
+			}
+		}
+	}
+
+	/** Lights the whole world from scratch, except for the chunk at a_UnlitChunkX, a_UnlitChunkZ, if specified. */
+	void LightAll(int a_UnlitChunkX = 100, int a_UnlitChunkZ = 100)
+	{
+		cLight BlockLight, SkyLight;
+		CalcLight(false, BlockLight);
+		CalcLight(true, SkyLight);
+		for (int cx = 0; cx < 3; cx++)
+		{
+			for (int cz = 0; cz < 3; cz++)
+			{
+				if ((cx - 1 == a_UnlitChunkX) && (cz - 1 == a_UnlitChunkZ))
+				{
+					continue;
+				}
+				cChunkDef::BlockNibbles ChunkBlockLight, ChunkSkyLight;
+				memset(ChunkBlockLight, 0, sizeof(ChunkBlockLight));
+				memset(ChunkSkyLight, 0, sizeof(ChunkSkyLight));
+				for (int y = 0; y < cChunkDef::Height; y++)
+				{
+					for (int z = 0; z < cChunkDef::Width; z++)
+					{
+						for (int x = 0; x < cChunkDef::Width; x++)
+						{
+							int Idx = cChunkDef::MakeIndexNoCheck(x, y, z);
+							size_t WorldIdx = Index(cx * cChunkDef::Width + x, y, cz * cChunkDef::Width + z);
+							ChunkBlockLight[Idx / 2] |= static_cast<NIBBLETYPE>(BlockLight[WorldIdx] << ((Idx & 1) * 4));
+							ChunkSkyLight[Idx / 2]   |= static_cast<NIBBLETYPE>(SkyLight[WorldIdx]   << ((Idx & 1) * 4));
+						}
+					}
+				}
+				m_Chunks[cx][cz]->SetLight(ChunkBlockLight, ChunkSkyLight);
+			}
+		}
+	}
+
+	/** Returns the number of blocks in the lighted chunks whose light differs from lighting the world from scratch.
+	Logs the first difference found. */
+	int CountLightDifferences(void)
+	{
+		int res = 0;
+		for (int Type = 0; Type < 2; Type++)
+		{
+			bool IsSkyLight = (Type == 1);
+			cLight Expected;
+			CalcLight(IsSkyLight, Expected);
+			for (int y = 0; y < cChunkDef::Height; y++)
+			{
+				for (int z = 0; z < SIZE; z++)
+				{
+					for (int x = 0; x < SIZE; x++)
+					{
+						int RelX = x - cChunkDef::Width, RelZ = z - cChunkDef::Width;
+						cChunk * Chunk = GetChunk(RelX, RelZ);
+						if (!Chunk->IsLightValid())
+						{
+							continue;
+						}
+						NIBBLETYPE Light = IsSkyLight ? Chunk->GetSkyLight(RelX, y, RelZ) : Chunk->GetBlockLight(RelX, y, RelZ);
+						if (Light == Expected[Index(x, y, z)])
+						{
+							continue;
+						}
+						if (res == 0)
+						{
+							LOG("%s differs at {%d, %d, %d}: %d instead of %d",
+								IsSkyLight ? "Skylight" : "Blocklight", x - cChunkDef::Width, y, z - cChunkDef::Width, Light, Expected[Index(x, y, z)]
+							);
+						}
+						res += 1;
+					}
+				}
+			}
+		}
+		return res;
+	}
+
+	bool IsChunkLighted(int a_ChunkX, int a_ChunkZ)
+	{
+		return m_Chunks[a_ChunkX + 1][a_ChunkZ + 1]->IsLightValid();
+	}
+
+protected:
+	class cMockAllocationPool :
+		public cAllocationPool<cChunkData::sChunkSection>
+	{
+		virtual cChunkData::sChunkSection * Allocate() override
+		{
+			return new cChunkData::sChunkSection();
+		}
+
+		virtual void Free(cChunkData::sChunkSection * a_Ptr) override
+		{
+			delete a_Ptr;
+		}
+	} ;
+
+	cMockAllocationPool m_Pool;
+	cChunk * m_Chunks[3][3];
+
+	/** Returns the chunk containing the block, converting the coords to relative ones. */
+	cChunk * GetChunk(int & a_BlockX, int & a_BlockZ)
+	{
+		int ChunkX, ChunkZ;
+		cChunkDef::BlockToChunk(a_BlockX, a_BlockZ, ChunkX, ChunkZ);
+		testassert((ChunkX >= -1) && (ChunkX <= 1) && (ChunkZ >= -1) && (ChunkZ <= 1));
+		a_BlockX -= ChunkX * cChunkDef::Width;
+		a_BlockZ -= ChunkZ * cChunkDef::Width;
+		return m_Chunks[ChunkX + 1][ChunkZ + 1];
+	}
+
+	/** Returns the block at the specified coords, offset so that the world starts at 0, as used by CalcLight(). */
+	BLOCKTYPE GetBlock(int a_X, int a_Y, int a_Z)
+	{
+		int RelX = a_X - cChunkDef::Width, RelZ = a_Z - cChunkDef::Width;
+		return GetChunk(RelX, RelZ)->GetBlock(RelX, a_Y, RelZ);
+	}
+} ;
+
+
+
+
+
+/** Builds the terrain shared by all the tests: stone ground up to Y = 39, a pool of water, a glass pane
+and a stone roof at Y = 50 over the corner where the four chunks around [0, 0] meet, so that the area under it is lit only from its sides. */
+static void BuildTerrain(cTestWorld & a_World, int a_UnlitChunkX = 100, int a_UnlitChunkZ = 100)
+{
+	for (int x = -16; x < 32; x++)
+	{
+		for (int z = -16; z < 32; z++)
+		{
+			for (int y = 0; y < 40; y++)
+			{
+				a_World.SetBlock(x, y, z, E_BLOCK_STONE);
+			}
+		}
+	}
+	for (int x = -10; x < -2; x++)
+	{
+		for (int z = 20; z < 28; z++)
+		{
+			for (int y = 35; y < 40; y++)
+			{
+				a_World.SetBlock(x, y, z, E_BLOCK_STATIONARY_WATER);
+			}
+		}
+	}
+	for (int z = -5; z < 5; z++)
+	{
+		for (int y = 40; y < 45; y++)
+		{
+			a_World.SetBlock(-6, y, z, E_BLOCK_GLASS);
+		}
+	}
+	for (int x = 8; x < 24; x++)
+	{
+		for (int z = 8; z < 24; z++)
+		{
+			a_World.SetBlock(x, 50, z, E_BLOCK_STONE);
+		}
+	}
+	a_World.LightAll(a_UnlitChunkX, a_UnlitChunkZ);
+	testassert(a_World.CountLightDifferences() == 0);
+}
+
+
+
+
+
+/** A torch placed and removed, under the roof next to the chunk corner, out in the open, in the water and behind the glass. */
+static void TestTorch(void)
+{
+	cTestWorld World;
+	BuildTerrain(World);
+
+	static const Vector3i Positions[] =
+	{
+		Vector3i(15, 40, 15),
+		Vector3i(16, 45, 9),
+		Vector3i(0, 40, 0),
+		Vector3i(-7, 39, 24),
+		Vector3i(-7, 42, 0),
+	} ;
+	for (size_t i = 0; i < ARRAYCOUNT(Positions); i++)
+	{
+		const Vector3i & Pos = Positions[i];
+		BLOCKTYPE Original = (Pos.y < 40) ? E_BLOCK_STATIONARY_WATER : E_BLOCK_AIR;
+		World.SetBlock(Pos.x, Pos.y, Pos.z, E_BLOCK_TORCH);
+		testassert(World.CountLightDifferences() == 0);
+		World.SetBlock(Pos.x, Pos.y, Pos.z, Original);
+		testassert(World.CountLightDifferences() == 0);
+	}
+
+	// Two torches whose light overlaps, removed in the opposite order:
+	World.SetBlock(12, 40, 12, E_BLOCK_TORCH);
+	World.SetBlock(18, 40, 14, E_BLOCK_TORCH);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(12, 40, 12, E_BLOCK_AIR);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(18, 40, 14, E_BLOCK_AIR);
+	testassert(World.CountLightDifferences() == 0);
+
+	// A glowstone block replacing the ground blocks the light that came through it and emits its own:
+	World.SetBlock(15, 39, 20, E_BLOCK_GLOWSTONE);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(15, 39, 20, E_BLOCK_STONE);
+	testassert(World.CountLightDifferences() == 0);
+	LOG("Torch test finished");
+}
+
+
+
+
+
+/** Blocks placed over a skylit column and removed again, and a hole opened in the roof and closed again. */
+static void TestSkyColumn(void)
+{
+	cTestWorld World;
+	BuildTerrain(World);
+
+	static const Vector3i Positions[] =
+	{
+		Vector3i(0, 60, 0),
+		Vector3i(-1, 45, 16),
+		Vector3i(4, 41, 4),
+		Vector3i(-7, 50, 24),
+		Vector3i(25, 51, 16),
+	} ;
+	for (size_t i = 0; i < ARRAYCOUNT(Positions); i++)
+	{
+		const Vector3i & Pos = Positions[i];
+		World.SetBlock(Pos.x, Pos.y, Pos.z, E_BLOCK_STONE);
+		testassert(World.CountLightDifferences() == 0);
+		World.SetBlock(Pos.x, Pos.y, Pos.z, E_BLOCK_AIR);
+		testassert(World.CountLightDifferences() == 0);
+	}
+
+	// A transparent block over the column still blocks the full skylight, the column below is lit from the sides:
+	World.SetBlock(3, 70, 3, E_BLOCK_GLASS);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(3, 70, 3, E_BLOCK_AIR);
+	testassert(World.CountLightDifferences() == 0);
+
+	// Holes in the roof, on both sides of the chunk border:
+	World.SetBlock(15, 50, 15, E_BLOCK_AIR);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(16, 50, 15, E_BLOCK_AIR);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(15, 50, 15, E_BLOCK_STONE);
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(16, 50, 15, E_BLOCK_STONE);
+	testassert(World.CountLightDifferences() == 0);
+	LOG("Sky column test finished");
+}
+
+
+
+
+
+/** The light doesn't spread into a loaded neighbor chunk that isn't lighted yet. When a change needs to, the changed
+chunk loses its valid light, so that it is lighted as a whole once the neighbor is; a change far from the neighbor keeps it. */
+static void TestUnlitNeighbor(void)
+{
+	cTestWorld World;
+	BuildTerrain(World, 1, 0);
+	testassert(!World.IsChunkLighted(1, 0));
+
+	// Far enough from the unlit chunk [1, 0] for the torch light not to reach it, even when removed:
+	World.SetBlock(1, 40, 8, E_BLOCK_TORCH);
+	testassert(World.IsChunkLighted(0, 0));
+	testassert(World.CountLightDifferences() == 0);
+	World.SetBlock(1, 40, 8, E_BLOCK_AIR);
+	testassert(World.IsChunkLighted(0, 0));
+
+	// Next to it:
+	World.SetBlock(14, 40, 8, E_BLOCK_TORCH);
+	testassert(!World.IsChunkLighted(0, 0));
+	testassert(World.IsChunkLighted(-1, 0));
+	testassert(World.IsChunkLighted(0, 1));
+
+	// Once lighted as a whole, the chunks are up to date again:
+	World.LightAll();
+	testassert(World.IsChunkLighted(0, 0) && World.IsChunkLighted(1, 0));
+	World.SetBlock(14, 40, 8, E_BLOCK_AIR);
+	testassert(World.IsChunkLighted(0, 0));
+	testassert(World.CountLightDifferences() == 0);
+	LOG("Unlit neighbor test finished");
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	TestTorch();
+	TestSkyColumn();
+	TestUnlitNeighbor();
+
+	LOG("LightUpdater test finished");
+	return 0;
+}
@@ -0,0 +1,247 @@
+// Stubs.cpp
+
+// Implements the parts of cChunk and the other server classes that the light updater uses
+// The chunks keep their blocks in a plain cChunkData and link to their neighbors, with no chunkmap or world behind them.
+
+#include "Globals.h"
+#include "Chunk.h"
+#include "LightUpdater.h"
+#include "Blocks/BlockHandler.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunk:
+
+std::atomic<UInt64> cChunk::s_DataVersionCounter(0);
+
+
+
+
+
+cChunk::cChunk(
+	int a_ChunkX, int a_ChunkZ,
+	cChunkMap * a_ChunkMap, cWorld * a_World,
+	cChunk * a_NeighborXM, cChunk * a_NeighborXP, cChunk * a_NeighborZM, cChunk * a_NeighborZP,
+	cAllocationPool<cChunkData::sChunkSection> & a_Pool
+) :
+	m_Presence(cpPresent),
+	m_ShouldGenerateIfLoadFailed(false),
+	m_IsExplicitlyRequested(false),
+	m_IsLightValid(false),
+	m_IsDirty(false),
+	m_IsSaving(false),
+	m_HasLoadFailed(false),
+	m_IsReplayingJournal(false),
+	m_DataVersion(++s_DataVersionCounter),
+	m_StayCount(0),
+	m_PosX(a_ChunkX),
+	m_PosZ(a_ChunkZ),
+	m_World(a_World),
+	m_ChunkMap(a_ChunkMap),
+	m_ChunkData(a_Pool),
+	m_BlockTickX(0),
+	m_BlockTickY(0),
+	m_BlockTickZ(0),
+	m_NeighborXM(a_NeighborXM),
+	m_NeighborXP(a_NeighborXP),
+	m_NeighborZM(a_NeighborZM),
+	m_NeighborZP(a_NeighborZP),
+	m_WaterSimulatorData(nullptr),
+	m_LavaSimulatorData(nullptr),
+	m_RedstoneSimulatorData(nullptr),
+	m_IsRedstoneDirty(false),
+	m_AlwaysTicked(0),
+	m_NumSkippedBlockEntityTicks(0),
+	m_AreBlockEntitiesWoken(false)
+{
+	memset(m_HeightMap, 0, sizeof(m_HeightMap));
+	if (a_NeighborXM != nullptr)
+	{
+		a_NeighborXM->m_NeighborXP = this;
+	}
+	if (a_NeighborXP != nullptr)
+	{
+		a_NeighborXP->m_NeighborXM = this;
+	}
+	if (a_NeighborZM != nullptr)
+	{
+		a_NeighborZM->m_NeighborZP = this;
+	}
+	if (a_NeighborZP != nullptr)
+	{
+		a_NeighborZP->m_NeighborZM = this;
+	}
+}
+
+
+
+
+
+cChunk::~cChunk()
+{
+	if (m_NeighborXM != nullptr)
+	{
+		m_NeighborXM->m_NeighborXP = nullptr;
+	}
+	if (m_NeighborXP != nullptr)
+	{
+		m_NeighborXP->m_NeighborXM = nullptr;
+	}
+	if (m_NeighborZM != nullptr)
+	{
+		m_NeighborZM->m_NeighborZP = nullptr;
+	}
+	if (m_NeighborZP != nullptr)
+	{
+		m_NeighborZP->m_NeighborZM = nullptr;
+	}
+}
+
+
+
+
+
+BLOCKTYPE cChunk::GetBlock(int a_RelX, int a_RelY, int a_RelZ) const
+{
+	return m_ChunkData.GetBlock(a_RelX, a_RelY, a_RelZ);
+}
+
+
+
+
+
+void cChunk::FastSetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, BLOCKTYPE a_BlockMeta, bool a_SendToClients)
+{
+	// Same as the real one, without the clients, block entities and the journal:
+	UNUSED(a_SendToClients);
+	const BLOCKTYPE OldBlockType = GetBlock(a_RelX, a_RelY, a_RelZ);
+	const BLOCKTYPE OldBlockMeta = m_ChunkData.GetMeta(a_RelX, a_RelY, a_RelZ);
+	if ((OldBlockType == a_BlockType) && (OldBlockMeta == a_BlockMeta))
+	{
+		return;
+	}
+	MarkDirty();
+	MarkDataChanged();
+	m_ChunkData.SetBlock(a_RelX, a_RelY, a_RelZ, a_BlockType);
+	m_ChunkData.SetMeta(a_RelX, a_RelY, a_RelZ, a_BlockMeta);
+
+	int OldHeight = m_HeightMap[a_RelX + a_RelZ * Width];
+	if (a_RelY >= m_HeightMap[a_RelX + a_RelZ * Width])
+	{
+		if (a_BlockType != E_BLOCK_AIR)
+		{
+			m_HeightMap[a_RelX + a_RelZ * Width] = (HEIGHTTYPE)a_RelY;
+		}
+		else
+		{
+			for (int y = a_RelY - 1; y > 0; --y)
+			{
+				if (GetBlock(a_RelX, y, a_RelZ) != E_BLOCK_AIR)
+				{
+					m_HeightMap[a_RelX + a_RelZ * Width] = (HEIGHTTYPE)y;
+					break;
+				}
+			}  // for y - column in m_BlockData
+		}
+	}
+
+	if (
+		(cBlockInfo::GetLightValue        (OldBlockType) != cBlockInfo::GetLightValue        (a_BlockType)) ||
+		(cBlockInfo::GetSpreadLightFalloff(OldBlockType) != cBlockInfo::GetSpreadLightFalloff(a_BlockType)) ||
+		(cBlockInfo::IsTransparent        (OldBlockType) != cBlockInfo::IsTransparent        (a_BlockType)) ||
+		(OldHeight != m_HeightMap[a_RelX + a_RelZ * Width])
+	)
+	{
+		if (m_IsLightValid)
+		{
+			cLightUpdater LightUpdater(*this);
+			LightUpdater.BlockChanged(a_RelX, a_RelY, a_RelZ, OldHeight);
+			if (LightUpdater.HasReachedUnlitChunk())
+			{
+				m_IsLightValid = false;
+			}
+		}
+	}
+}
+
+
+
+
+
+void cChunk::SetLight(
+	const cChunkDef::BlockNibbles & a_BlockLight,
+	const cChunkDef::BlockNibbles & a_SkyLight
+)
+{
+	m_ChunkData.SetBlockLight(a_BlockLight);
+	m_ChunkData.SetSkyLight(a_SkyLight);
+	m_IsLightValid = true;
+	MarkDataChanged();
+}
+
+
+
+
+
+int cChunk::GetHeight(int a_X, int a_Z)
+{
+	return m_HeightMap[a_X + a_Z * Width];
+}
+
+
+
+
+
+cChunk * cChunk::GetRelNeighborChunkAdjustCoords(int & a_RelX, int & a_RelZ) const
+{
+	// Same as the real one, only walking the neighbors; there is no chunkmap to find the chunks further away in:
+	cChunk * ToReturn = const_cast<cChunk *>(this);
+	int RelX = a_RelX;
+	int RelZ = a_RelZ;
+	while ((RelX >= Width) && (ToReturn != nullptr))
+	{
+		RelX -= Width;
+		ToReturn = ToReturn->m_NeighborXP;
+	}
+	while ((RelX < 0) && (ToReturn != nullptr))
+	{
+		RelX += Width;
+		ToReturn = ToReturn->m_NeighborXM;
+	}
+	while ((RelZ >= Width) && (ToReturn != nullptr))
+	{
+		RelZ -= Width;
+		ToReturn = ToReturn->m_NeighborZP;
+	}
+	while ((RelZ < 0) && (ToReturn != nullptr))
+	{
+		RelZ += Width;
+		ToReturn = ToReturn->m_NeighborZM;
+	}
+	if (ToReturn != nullptr)
+	{
+		a_RelX = RelX;
+		a_RelZ = RelZ;
+	}
+	return ToReturn;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Block handlers:
+
+cBlockHandler * cBlockHandler::CreateBlockHandler(BLOCKTYPE a_BlockType)
+{
+	// The light updater only uses the block info, not the handlers:
+	return nullptr;
+}
+
+
+
+
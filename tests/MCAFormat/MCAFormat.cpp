@@ -0,0 +1,174 @@
+// MCAFormat.cpp
+
+// Tests the region file sector allocation map and the region file name filter
+
+#include "Globals.h"
+#include "WorldStorage/MCAFormat.h"
+
+
+
+
+
+/** Returns the header item (host byte order) for a chunk stored at the specified sectors. */
+static unsigned MakeLocation(unsigned a_FirstSector, unsigned a_NumSectors)
+{
+	return (a_FirstSector << 8) | a_NumSectors;
+}
+
+
+
+
+
+/** Returns true if all the sectors in the specified range are used (a_IsUsed == true) or all are free (a_IsUsed == false). */
+static bool AreSectors(const cMCASectorMap & a_Map, unsigned a_FirstSector, unsigned a_NumSectors, bool a_IsUsed)
+{
+	for (unsigned i = a_FirstSector; i < a_FirstSector + a_NumSectors; i++)
+	{
+		if (a_Map.IsUsed(i) != a_IsUsed)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+/** Chunks growing, shrinking and moving around a new file; the released sectors are reused only after ReleasePending(). */
+static void TestAllocation(void)
+{
+	unsigned Header[4] = { 0 };
+	cMCASectorMap Map;
+	Map.Build(Header, ARRAYCOUNT(Header), 8192);
+	testassert(Map.GetNumSectors() == 2);
+	testassert(AreSectors(Map, 0, 2, true));
+
+	// New chunks are appended after the header:
+	testassert(Map.Allocate(0, 3) == 2);
+	testassert(Map.Allocate(0, 1) == 5);
+	testassert(AreSectors(Map, 2, 4, true));
+	testassert(Map.GetNumSectors() == 6);
+
+	// A chunk that fits its location stays there:
+	testassert(Map.Allocate(MakeLocation(2, 3), 3) == 2);
+
+	// A grown chunk moves to the end; its old sectors stay used until the header is written:
+	testassert(Map.Allocate(MakeLocation(2, 3), 5) == 6);
+	testassert(AreSectors(Map, 2, 3, true));
+	testassert(Map.Allocate(0, 2) == 11);
+	Map.ReleasePending();
+	testassert(AreSectors(Map, 2, 3, false));
+	testassert(Map.GetNumSectors() == 13);
+
+	// The freed sectors are reused:
+	testassert(Map.Allocate(0, 2) == 2);
+	testassert(AreSectors(Map, 2, 2, true));
+	testassert(!Map.IsUsed(4));
+
+	// A shrunk chunk stays in place and releases its tail:
+	testassert(Map.Allocate(MakeLocation(6, 5), 2) == 6);
+	testassert(AreSectors(Map, 8, 3, true));
+	Map.ReleasePending();
+	testassert(AreSectors(Map, 6, 2, true));
+	testassert(AreSectors(Map, 8, 3, false));
+
+	// Best fit: the one-sector gap at 4 is used rather than the three-sector gap at 8:
+	testassert(Map.Allocate(0, 1) == 4);
+	testassert(Map.Allocate(0, 3) == 8);
+
+	// No gap is large enough, append:
+	testassert(Map.Allocate(0, 4) == 13);
+	testassert(Map.GetNumSectors() == 17);
+	LOG("Allocation test finished");
+}
+
+
+
+
+
+/** The map built from an existing file's header marks the chunks' sectors; the gaps between them and the file's tail are free. */
+static void TestBuild(void)
+{
+	unsigned Header[4];
+	Header[0] = htonl(MakeLocation(2, 2));
+	Header[1] = htonl(MakeLocation(7, 1));
+	Header[2] = 0;  // Not present
+	Header[3] = htonl(MakeLocation(10, 3));
+	cMCASectorMap Map;
+	Map.Build(Header, ARRAYCOUNT(Header), 16 * 4096 + 100);  // The last sector is incomplete
+	testassert(Map.GetNumSectors() == 17);
+	testassert(AreSectors(Map, 0, 4, true));
+	testassert(AreSectors(Map, 4, 3, false));
+	testassert(Map.IsUsed(7));
+	testassert(AreSectors(Map, 8, 2, false));
+	testassert(AreSectors(Map, 10, 3, true));
+	testassert(AreSectors(Map, 13, 4, false));
+	testassert(!Map.IsUsed(100));
+
+	testassert(Map.Allocate(0, 2) == 8);
+	testassert(Map.Allocate(0, 4) == 13);
+	testassert(Map.Allocate(0, 3) == 4);
+	testassert(Map.Allocate(0, 1) == 17);
+
+	// Rebuilding drops the pending sectors, the header in the file is what counts:
+	Map.Allocate(MakeLocation(10, 3), 10);
+	Map.Build(Header, ARRAYCOUNT(Header), 16 * 4096);
+	Map.ReleasePending();
+	testassert(AreSectors(Map, 10, 3, true));
+	LOG("Build test finished");
+}
+
+
+
+
+
+/** Only the exact "r.<x>.<z>.mca" names, with the requested suffix, are region files. */
+static void TestRegionFileNames(void)
+{
+	int RegionX = 0, RegionZ = 0;
+	testassert(ParseRegionFileName("r.1.2.mca", "", RegionX, RegionZ));
+	testassert((RegionX == 1) && (RegionZ == 2));
+	testassert(ParseRegionFileName("r.-10.-20.mca", "", RegionX, RegionZ));
+	testassert((RegionX == -10) && (RegionZ == -20));
+	testassert(ParseRegionFileName("r.3.-4.mca.compact", ".compact", RegionX, RegionZ));
+	testassert((RegionX == 3) && (RegionZ == -4));
+
+	static const char * Invalid[] =
+	{
+		"r.1.2.mca.compact",
+		"r.1.2.mca.bak",
+		"r.1.2.mca~",
+		"r.1.2.mcr",
+		"r.1.mca",
+		"r.1.2.3.mca",
+		"r. 1.2.mca",
+		"r.+1.2.mca",
+		"r.01.2.mca",
+		"R.1.2.mca",
+		"xr.1.2.mca",
+		"",
+	};
+	for (size_t i = 0; i < ARRAYCOUNT(Invalid); i++)
+	{
+		testassert(!ParseRegionFileName(Invalid[i], "", RegionX, RegionZ));
+	}
+	testassert(!ParseRegionFileName("r.1.2.mca", ".compact", RegionX, RegionZ));
+	testassert(!ParseRegionFileName("r.1.2.mca.compact.old", ".compact", RegionX, RegionZ));
+	LOG("Region file names test finished");
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	TestAllocation();
+	TestBuild();
+	TestRegionFileNames();
+
+	LOG("MCAFormat test finished");
+	return 0;
+}
@@ -0,0 +1,387 @@
+
+// RedstoneSimulators.cpp
+
+// Builds wire, torch and repeater circuits and checks that the Graph and the Incremental redstone simulators power them alike
+
+#include "Globals.h"
+#include "Chunk.h"
+#include "World.h"
+#include "Simulator/GraphRedstoneSimulator.h"
+#include "Simulator/IncrementalRedstoneSimulator.h"
+
+
+
+
+
+/** The simulators only use their world for the sensors and mechanisms, which the tests don't build.
+They still need a world reference, so they get one to storage that is never constructed nor accessed. */
+static std::aligned_storage<sizeof(cWorld), alignof(cWorld)>::type g_WorldStorage;
+static cWorld & g_World = *reinterpret_cast<cWorld *>(&g_WorldStorage);
+
+
+
+
+
+/** The simulator that the chunks wake up and tick, used by the chunk stubs. */
+cRedstoneSimulator * g_RedstoneSimulator = nullptr;
+
+
+
+
+
+/** A 3 * 3 chunks large world around chunk [0, 0], simulated by a single redstone simulator.
+Changes the blocks the same way as cChunkMap does, waking the simulator up after each change. */
+class cTestWorld
+{
+public:
+	cTestWorld(cRedstoneSimulator & a_Simulator) :
+		m_Simulator(a_Simulator)
+	{
+		g_RedstoneSimulator = &a_Simulator;
+		for (int x = 0; x < 3; x++)
+		{
+			for (int z = 0; z < 3; z++)
+			{
+				cChunk * NeighborXM = (x > 0) ? m_Chunks[x - 1][z] : nullptr;
+				cChunk * NeighborZM = (z > 0) ? m_Chunks[x][z - 1] : nullptr;
+				m_Chunks[x][z] = new cChunk(x - 1, z - 1, nullptr, &g_World, NeighborXM, nullptr, NeighborZM, nullptr, m_Pool);
+				m_Chunks[x][z]->SetRedstoneSimulatorData(a_Simulator.CreateChunkData());
+			}
+		}
+	}
+
+	~cTestWorld()
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			for (int z = 0; z < 3; z++)
+			{
+				delete m_Chunks[x][z];
+			}
+		}
+	}
+
+	/** Sets the block, with a stone block under it, so that wires and torches have something to stand on. */
+	void SetBlockOnStone(int a_BlockX, int a_BlockY, int a_BlockZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+	{
+		SetBlock(a_BlockX, a_BlockY - 1, a_BlockZ, E_BLOCK_STONE, 0);
+		SetBlock(a_BlockX, a_BlockY, a_BlockZ, a_BlockType, a_BlockMeta);
+	}
+
+	/** Sets the block, like cChunkMap::SetBlock(). */
+	void SetBlock(int a_BlockX, int a_BlockY, int a_BlockZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+	{
+		int RelX = a_BlockX, RelZ = a_BlockZ;
+		cChunk * Chunk = GetChunk(RelX, RelZ);
+		Chunk->SetBlock(RelX, a_BlockY, RelZ, a_BlockType, a_BlockMeta);
+		m_Simulator.WakeUp(a_BlockX, a_BlockY, a_BlockZ, Chunk);
+	}
+
+	/** Sets the block meta, like a player flipping a lever does (cChunkMap::SetBlockMeta() followed by cWorld::WakeUpSimulators()). */
+	void SetMeta(int a_BlockX, int a_BlockY, int a_BlockZ, NIBBLETYPE a_BlockMeta)
+	{
+		int RelX = a_BlockX, RelZ = a_BlockZ;
+		cChunk * Chunk = GetChunk(RelX, RelZ);
+		Chunk->SetMeta(RelX, a_BlockY, RelZ, a_BlockMeta);
+		m_Simulator.WakeUp(a_BlockX, a_BlockY, a_BlockZ, Chunk);
+	}
+
+	BLOCKTYPE GetBlock(int a_BlockX, int a_BlockY, int a_BlockZ)
+	{
+		int RelX = a_BlockX, RelZ = a_BlockZ;
+		return GetChunk(RelX, RelZ)->GetBlock(RelX, a_BlockY, RelZ);
+	}
+
+	NIBBLETYPE GetMeta(int a_BlockX, int a_BlockY, int a_BlockZ)
+	{
+		int RelX = a_BlockX, RelZ = a_BlockZ;
+		return GetChunk(RelX, RelZ)->GetMeta(RelX, a_BlockY, RelZ);
+	}
+
+	/** Ticks all the chunks for the specified number of ticks. */
+	void Tick(int a_NumTicks)
+	{
+		for (int i = 0; i < a_NumTicks; i++)
+		{
+			for (int x = 0; x < 3; x++)
+			{
+				for (int z = 0; z < 3; z++)
+				{
+					m_Chunks[x][z]->Tick(50);
+				}
+			}
+		}
+	}
+
+protected:
+	class cMockAllocationPool :
+		public cAllocationPool<cChunkData::sChunkSection>
+	{
+		virtual cChunkData::sChunkSection * Allocate() override
+		{
+			return new cChunkData::sChunkSection();
+		}
+
+		virtual void Free(cChunkData::sChunkSection * a_Ptr) override
+		{
+			delete a_Ptr;
+		}
+	} ;
+
+	cRedstoneSimulator & m_Simulator;
+	cMockAllocationPool m_Pool;
+	cChunk * m_Chunks[3][3];
+
+	/** Returns the chunk containing the block, converting the coords to relative ones. */
+	cChunk * GetChunk(int & a_BlockX, int & a_BlockZ)
+	{
+		int ChunkX, ChunkZ;
+		cChunkDef::BlockToChunk(a_BlockX, a_BlockZ, ChunkX, ChunkZ);
+		testassert((ChunkX >= -1) && (ChunkX <= 1) && (ChunkZ >= -1) && (ChunkZ <= 1));
+		a_BlockX -= ChunkX * cChunkDef::Width;
+		a_BlockZ -= ChunkZ * cChunkDef::Width;
+		return m_Chunks[ChunkX + 1][ChunkZ + 1];
+	}
+} ;
+
+
+
+
+
+/** Lever meta for a lever lying on top of a block; bit 0x08 turns it on. */
+static const NIBBLETYPE LEVER_ON_GROUND = 0x05;
+static const NIBBLETYPE LEVER_ON = 0x08;
+
+/** Repeater metas for the repeaters facing (outputting to) the X+ direction, with the delay of 1 and 4 redstone ticks. */
+static const NIBBLETYPE REPEATER_XP_DELAY1 = 0x01;
+static const NIBBLETYPE REPEATER_XP_DELAY4 = 0x0d;
+
+/** The number of ticks long enough for any of the tested circuits to settle. */
+static const int SETTLE_TICKS = 40;
+
+
+
+
+
+/** Returns a string describing the blocks in the line from [a_MinX, a_Y, a_Z] to [a_MaxX, a_Y, a_Z], for comparing the simulators. */
+static AString DescribeLine(cTestWorld & a_World, int a_MinX, int a_MaxX, int a_Y, int a_Z)
+{
+	AString res;
+	for (int x = a_MinX; x <= a_MaxX; x++)
+	{
+		AppendPrintf(res, "%d:%d ", a_World.GetBlock(x, a_Y, a_Z), a_World.GetMeta(x, a_Y, a_Z));
+	}
+	return res;
+}
+
+
+
+
+
+/** A lever powering a line of wire crossing the chunk border at X = 16.
+The wire power drops by one per block. Returns the states of the line after each step. */
+static AString TestWire(cRedstoneSimulator & a_Simulator)
+{
+	cTestWorld World(a_Simulator);
+	AString res;
+	World.SetBlockOnStone(0, 65, 0, E_BLOCK_LEVER, LEVER_ON_GROUND);
+	for (int x = 1; x <= 20; x++)
+	{
+		World.SetBlockOnStone(x, 65, 0, E_BLOCK_REDSTONE_WIRE, 0);
+	}
+	World.Tick(SETTLE_TICKS);
+	res.append(DescribeLine(World, 1, 20, 65, 0));
+	for (int x = 1; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 0);
+	}
+
+	// Turn the lever on:
+	World.SetMeta(0, 65, 0, LEVER_ON_GROUND | LEVER_ON);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 1, 20, 65, 0));
+	for (int x = 1; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == std::max(16 - x, 0));
+	}
+
+	// Turn the lever off:
+	World.SetMeta(0, 65, 0, LEVER_ON_GROUND);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 1, 20, 65, 0));
+	for (int x = 1; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 0);
+	}
+
+	// Break the powered wire in the middle:
+	World.SetMeta(0, 65, 0, LEVER_ON_GROUND | LEVER_ON);
+	World.Tick(SETTLE_TICKS);
+	World.SetBlock(5, 65, 0, E_BLOCK_AIR, 0);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 1, 20, 65, 0));
+	for (int x = 1; x <= 4; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 16 - x);
+	}
+	for (int x = 6; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 0);
+	}
+	return res;
+}
+
+
+
+
+
+/** A lever powering a stone block with a torch on its side, the torch powering a line of wire. */
+static AString TestTorch(cRedstoneSimulator & a_Simulator)
+{
+	cTestWorld World(a_Simulator);
+	AString res;
+	World.SetBlock(14, 65, 0, E_BLOCK_STONE, 0);
+	World.SetBlock(14, 66, 0, E_BLOCK_LEVER, LEVER_ON_GROUND);
+	World.SetBlockOnStone(15, 65, 0, E_BLOCK_REDSTONE_TORCH_ON, E_META_TORCH_EAST);
+	for (int x = 16; x <= 20; x++)
+	{
+		World.SetBlockOnStone(x, 65, 0, E_BLOCK_REDSTONE_WIRE, 0);
+	}
+	World.Tick(SETTLE_TICKS);
+	res.append(DescribeLine(World, 15, 20, 65, 0));
+	testassert(World.GetBlock(15, 65, 0) == E_BLOCK_REDSTONE_TORCH_ON);
+	for (int x = 16; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 16 - (x - 15));
+	}
+
+	// Power the block, the torch turns off:
+	World.SetMeta(14, 66, 0, LEVER_ON_GROUND | LEVER_ON);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 15, 20, 65, 0));
+	testassert(World.GetBlock(15, 65, 0) == E_BLOCK_REDSTONE_TORCH_OFF);
+	for (int x = 16; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 0);
+	}
+
+	// Unpower the block, the torch turns back on:
+	World.SetMeta(14, 66, 0, LEVER_ON_GROUND);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 15, 20, 65, 0));
+	testassert(World.GetBlock(15, 65, 0) == E_BLOCK_REDSTONE_TORCH_ON);
+	for (int x = 16; x <= 20; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 16 - (x - 15));
+	}
+	return res;
+}
+
+
+
+
+
+/** A lever powering a line of wire, with a repeater in it restoring the power to full.
+The line stays inside one chunk; the chunk border is covered by TestWire. */
+static AString TestRepeater(cRedstoneSimulator & a_Simulator, NIBBLETYPE a_RepeaterMeta)
+{
+	cTestWorld World(a_Simulator);
+	AString res;
+	World.SetBlockOnStone(0, 65, 0, E_BLOCK_LEVER, LEVER_ON_GROUND);
+	for (int x = 1; x <= 14; x++)
+	{
+		if (x == 7)
+		{
+			World.SetBlockOnStone(x, 65, 0, E_BLOCK_REDSTONE_REPEATER_OFF, a_RepeaterMeta);
+		}
+		else
+		{
+			World.SetBlockOnStone(x, 65, 0, E_BLOCK_REDSTONE_WIRE, 0);
+		}
+	}
+	World.Tick(SETTLE_TICKS);
+	res.append(DescribeLine(World, 1, 14, 65, 0));
+	testassert(World.GetBlock(7, 65, 0) == E_BLOCK_REDSTONE_REPEATER_OFF);
+
+	// Turn the lever on; the repeater turns on and outputs full power:
+	World.SetMeta(0, 65, 0, LEVER_ON_GROUND | LEVER_ON);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 1, 14, 65, 0));
+	testassert(World.GetBlock(7, 65, 0) == E_BLOCK_REDSTONE_REPEATER_ON);
+	for (int x = 1; x <= 6; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 16 - x);
+	}
+	for (int x = 8; x <= 14; x++)
+	{
+		testassert(World.GetMeta(x, 65, 0) == 16 - (x - 7));
+	}
+
+	// Turn the lever off:
+	World.SetMeta(0, 65, 0, LEVER_ON_GROUND);
+	World.Tick(SETTLE_TICKS);
+	res.append("| ").append(DescribeLine(World, 1, 14, 65, 0));
+	testassert(World.GetBlock(7, 65, 0) == E_BLOCK_REDSTONE_REPEATER_OFF);
+	for (int x = 1; x <= 14; x++)
+	{
+		testassert((x == 7) || (World.GetMeta(x, 65, 0) == 0));
+	}
+	return res;
+}
+
+
+
+
+
+static AString TestFastRepeater(cRedstoneSimulator & a_Simulator)
+{
+	return TestRepeater(a_Simulator, REPEATER_XP_DELAY1);
+}
+
+
+
+
+
+static AString TestSlowRepeater(cRedstoneSimulator & a_Simulator)
+{
+	return TestRepeater(a_Simulator, REPEATER_XP_DELAY4);
+}
+
+
+
+
+
+/** Runs the test on both simulators and checks that they end up with the same blocks. */
+static void Compare(const char * a_TestName, AString (* a_Test)(cRedstoneSimulator &))
+{
+	cGraphRedstoneSimulator Graph(g_World);
+	cIncrementalRedstoneSimulator Incremental(g_World);
+	AString GraphResult = a_Test(Graph);
+	AString IncrementalResult = a_Test(Incremental);
+	if (GraphResult != IncrementalResult)
+	{
+		LOGWARNING("%s: the simulators differ:\nGraph:       %s\nIncremental: %s\n", a_TestName, GraphResult.c_str(), IncrementalResult.c_str());
+	}
+	testassert(GraphResult == IncrementalResult);
+}
+
+
+
+
+
+int main(int argc, char ** argv)
+{
+	cBlockInfo::Get(E_BLOCK_AIR);  // Initialize the block info table
+
+	Compare("Wire", TestWire);
+	Compare("Torch", TestTorch);
+	Compare("Repeater", TestFastRepeater);
+	Compare("Slow repeater", TestSlowRepeater);
+
+	LOG("RedstoneSimulators test finished\n");
+	return 0;
+}
+
+
+
+
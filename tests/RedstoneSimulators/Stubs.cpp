@@ -0,0 +1,558 @@
+
+// Stubs.cpp
+
+// Implements the parts of cChunk, cWorld and the other server classes that the redstone simulators use
+// The chunks keep their blocks in a plain cChunkData and link to their neighbors, with no chunkmap or world behind them;
+// the world functions are used only by the sensors and mechanisms, which the tests don't build, so they do nothing.
+// Same as the real chunks, the chunks check the changed blocks and their neighbors in their next tick, waking the simulator up for them.
+
+#include "Globals.h"
+#include "Chunk.h"
+#include "World.h"
+#include "Enchantments.h"
+#include "Blocks/BlockHandler.h"
+#include "Blocks/BlockPiston.h"
+#include "Blocks/ChunkInterface.h"
+#include "Simulator/RedstoneSimulator.h"
+
+
+
+
+
+/** The simulator that the chunks wake up and tick, set by the test. */
+extern cRedstoneSimulator * g_RedstoneSimulator;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunk:
+
+std::atomic<UInt64> cChunk::s_DataVersionCounter(0);
+
+
+
+
+
+cChunk::cChunk(
+	int a_ChunkX, int a_ChunkZ,
+	cChunkMap * a_ChunkMap, cWorld * a_World,
+	cChunk * a_NeighborXM, cChunk * a_NeighborXP, cChunk * a_NeighborZM, cChunk * a_NeighborZP,
+	cAllocationPool<cChunkData::sChunkSection> & a_Pool
+) :
+	m_Presence(cpPresent),
+	m_ShouldGenerateIfLoadFailed(false),
+	m_IsExplicitlyRequested(false),
+	m_IsLightValid(false),
+	m_IsDirty(false),
+	m_IsSaving(false),
+	m_HasLoadFailed(false),
+	m_IsReplayingJournal(false),
+	m_DataVersion(++s_DataVersionCounter),
+	m_StayCount(0),
+	m_PosX(a_ChunkX),
+	m_PosZ(a_ChunkZ),
+	m_World(a_World),
+	m_ChunkMap(a_ChunkMap),
+	m_ChunkData(a_Pool),
+	m_BlockTickX(0),
+	m_BlockTickY(0),
+	m_BlockTickZ(0),
+	m_NeighborXM(a_NeighborXM),
+	m_NeighborXP(a_NeighborXP),
+	m_NeighborZM(a_NeighborZM),
+	m_NeighborZP(a_NeighborZP),
+	m_WaterSimulatorData(nullptr),
+	m_LavaSimulatorData(nullptr),
+	m_RedstoneSimulatorData(nullptr),
+	m_IsRedstoneDirty(false),
+	m_AlwaysTicked(0),
+	m_NumSkippedBlockEntityTicks(0),
+	m_AreBlockEntitiesWoken(false)
+{
+	if (a_NeighborXM != nullptr)
+	{
+		a_NeighborXM->m_NeighborXP = this;
+	}
+	if (a_NeighborXP != nullptr)
+	{
+		a_NeighborXP->m_NeighborXM = this;
+	}
+	if (a_NeighborZM != nullptr)
+	{
+		a_NeighborZM->m_NeighborZP = this;
+	}
+	if (a_NeighborZP != nullptr)
+	{
+		a_NeighborZP->m_NeighborZM = this;
+	}
+}
+
+
+
+
+
+cChunk::~cChunk()
+{
+	if (m_NeighborXM != nullptr)
+	{
+		m_NeighborXM->m_NeighborXP = nullptr;
+	}
+	if (m_NeighborXP != nullptr)
+	{
+		m_NeighborXP->m_NeighborXM = nullptr;
+	}
+	if (m_NeighborZM != nullptr)
+	{
+		m_NeighborZM->m_NeighborZP = nullptr;
+	}
+	if (m_NeighborZP != nullptr)
+	{
+		m_NeighborZP->m_NeighborZM = nullptr;
+	}
+	delete m_RedstoneSimulatorData;
+	m_RedstoneSimulatorData = nullptr;
+}
+
+
+
+
+
+BLOCKTYPE cChunk::GetBlock(int a_RelX, int a_RelY, int a_RelZ) const
+{
+	return m_ChunkData.GetBlock(a_RelX, a_RelY, a_RelZ);
+}
+
+
+
+
+
+void cChunk::GetBlockTypeMeta(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE & a_BlockType, NIBBLETYPE & a_BlockMeta) const
+{
+	a_BlockType = GetBlock(a_RelX, a_RelY, a_RelZ);
+	a_BlockMeta = m_ChunkData.GetMeta(a_RelX, a_RelY, a_RelZ);
+}
+
+
+
+
+
+void cChunk::SetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta, bool a_SendToClients)
+{
+	// Same as the real FastSetBlock(), without the clients, lighting and block entities; doesn't wake the simulators up either:
+	UNUSED(a_SendToClients);
+	if ((GetBlock(a_RelX, a_RelY, a_RelZ) == a_BlockType) && (GetMeta(a_RelX, a_RelY, a_RelZ) == a_BlockMeta))
+	{
+		return;
+	}
+	MarkDirty();
+	MarkDataChanged();
+	m_IsRedstoneDirty = true;
+	m_ChunkData.SetBlock(a_RelX, a_RelY, a_RelZ, a_BlockType);
+	m_ChunkData.SetMeta(a_RelX, a_RelY, a_RelZ, a_BlockMeta);
+
+	// Check this block and its neighbors in the next tick:
+	m_ToTickBlocks.push_back(Vector3i(a_RelX, a_RelY, a_RelZ));
+	QueueTickBlockNeighbors(a_RelX, a_RelY, a_RelZ);
+}
+
+
+
+
+
+void cChunk::Tick(float a_Dt)
+{
+	// Same order as the real TickLocal() and TickShared():
+	CheckBlocks();
+	g_RedstoneSimulator->SimulateChunk(a_Dt, m_PosX, m_PosZ, this);
+}
+
+
+
+
+
+void cChunk::CheckBlocks()
+{
+	// The real block handlers' Check() wakes the simulators up for the blocks that can stay where they are:
+	std::vector<Vector3i> ToTickBlocks;
+	std::swap(m_ToTickBlocks, ToTickBlocks);
+	for (std::vector<Vector3i>::const_iterator itr = ToTickBlocks.begin(), end = ToTickBlocks.end(); itr != end; ++itr)
+	{
+		g_RedstoneSimulator->WakeUp(m_PosX * Width + itr->x, itr->y, m_PosZ * Width + itr->z, this);
+	}
+}
+
+
+
+
+
+void cChunk::QueueTickBlock(int a_RelX, int a_RelY, int a_RelZ)
+{
+	m_ToTickBlocks.push_back(Vector3i(a_RelX, a_RelY, a_RelZ));
+}
+
+
+
+
+
+void cChunk::QueueTickBlockNeighbors(int a_RelX, int a_RelY, int a_RelZ)
+{
+	static const Vector3i Offsets[] =
+	{
+		Vector3i( 1,  0,  0),
+		Vector3i(-1,  0,  0),
+		Vector3i( 0,  1,  0),
+		Vector3i( 0, -1,  0),
+		Vector3i( 0,  0,  1),
+		Vector3i( 0,  0, -1),
+	} ;
+	for (size_t i = 0; i < ARRAYCOUNT(Offsets); i++)
+	{
+		UnboundedQueueTickBlock(a_RelX + Offsets[i].x, a_RelY + Offsets[i].y, a_RelZ + Offsets[i].z);
+	}
+}
+
+
+
+
+
+void cChunk::UnboundedQueueTickBlock(int a_RelX, int a_RelY, int a_RelZ)
+{
+	if ((a_RelY < 0) || (a_RelY >= cChunkDef::Height))
+	{
+		return;
+	}
+	cChunk * Chunk = GetRelNeighborChunkAdjustCoords(a_RelX, a_RelZ);
+	if ((Chunk != nullptr) && Chunk->IsValid())
+	{
+		Chunk->QueueTickBlock(a_RelX, a_RelY, a_RelZ);
+	}
+}
+
+
+
+
+
+cChunk * cChunk::GetNeighborChunk(int a_BlockX, int a_BlockZ)
+{
+	a_BlockX -= m_PosX * cChunkDef::Width;
+	a_BlockZ -= m_PosZ * cChunkDef::Width;
+	return GetRelNeighborChunk(a_BlockX, a_BlockZ);
+}
+
+
+
+
+
+cChunk * cChunk::GetRelNeighborChunk(int a_RelX, int a_RelZ)
+{
+	return GetRelNeighborChunkAdjustCoords(a_RelX, a_RelZ);
+}
+
+
+
+
+
+cChunk * cChunk::GetRelNeighborChunkAdjustCoords(int & a_RelX, int & a_RelZ) const
+{
+	// Same as the real one, only walking the neighbors; there is no chunkmap to find the chunks further away in:
+	cChunk * ToReturn = const_cast<cChunk *>(this);
+	int RelX = a_RelX;
+	int RelZ = a_RelZ;
+	while ((RelX >= Width) && (ToReturn != nullptr))
+	{
+		RelX -= Width;
+		ToReturn = ToReturn->m_NeighborXP;
+	}
+	while ((RelX < 0) && (ToReturn != nullptr))
+	{
+		RelX += Width;
+		ToReturn = ToReturn->m_NeighborXM;
+	}
+	while ((RelZ >= Width) && (ToReturn != nullptr))
+	{
+		RelZ -= Width;
+		ToReturn = ToReturn->m_NeighborZP;
+	}
+	while ((RelZ < 0) && (ToReturn != nullptr))
+	{
+		RelZ += Width;
+		ToReturn = ToReturn->m_NeighborZM;
+	}
+	if (ToReturn != nullptr)
+	{
+		a_RelX = RelX;
+		a_RelZ = RelZ;
+	}
+	return ToReturn;
+}
+
+
+
+
+
+bool cChunk::UnboundedRelGetBlock(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE & a_BlockType, NIBBLETYPE & a_BlockMeta) const
+{
+	if ((a_RelY < 0) || (a_RelY >= cChunkDef::Height))
+	{
+		return false;
+	}
+	cChunk * Chunk = GetRelNeighborChunkAdjustCoords(a_RelX, a_RelZ);
+	if ((Chunk == nullptr) || !Chunk->IsValid())
+	{
+		return false;
+	}
+	Chunk->GetBlockTypeMeta(a_RelX, a_RelY, a_RelZ, a_BlockType, a_BlockMeta);
+	return true;
+}
+
+
+
+
+
+bool cChunk::UnboundedRelGetBlockType(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE & a_BlockType) const
+{
+	NIBBLETYPE BlockMeta;
+	return UnboundedRelGetBlock(a_RelX, a_RelY, a_RelZ, a_BlockType, BlockMeta);
+}
+
+
+
+
+
+NIBBLETYPE cChunk::GetTimeAlteredLight(NIBBLETYPE a_Skylight) const
+{
+	return a_Skylight;
+}
+
+
+
+
+
+void cChunk::JournalBlockChange(int a_RelX, int a_RelY, int a_RelZ, BLOCKTYPE a_BlockType, NIBBLETYPE a_BlockMeta)
+{
+}
+
+
+
+
+
+void cChunk::WakeBlockEntitiesAround(int a_RelX, int a_RelY, int a_RelZ)
+{
+}
+
+
+
+
+
+void cChunk::BroadcastSoundEffect(const AString & a_SoundName, double a_X, double a_Y, double a_Z, float a_Volume, float a_Pitch, const cClientHandle * a_Exclude)
+{
+}
+
+
+
+
+
+void cChunk::BroadcastSoundParticleEffect(int a_EffectID, int a_SrcX, int a_SrcY, int a_SrcZ, int a_Data, const cClientHandle * a_Exclude)
+{
+}
+
+
+
+
+
+bool cChunk::DoWithChestAt(int a_BlockX, int a_BlockY, int a_BlockZ, cChestCallback & a_Callback)
+{
+	return false;
+}
+
+
+
+
+
+bool cChunk::DoWithRedstonePoweredEntityAt(int a_BlockX, int a_BlockY, int a_BlockZ, cRedstonePoweredCallback & a_Callback)
+{
+	return false;
+}
+
+
+
+
+
+bool cChunk::ForEachEntityInBox(const cBoundingBox & a_Box, cEntityCallback & a_Callback)
+{
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cWorld:
+
+cPlayer * cWorld::FindClosestPlayer(const Vector3d & a_Pos, float a_SightLimit, bool a_CheckLineOfSight)
+{
+	return nullptr;
+}
+
+
+
+
+
+bool cWorld::ForEachEntityInChunk(int a_ChunkX, int a_ChunkZ, cEntityCallback & a_Callback)
+{
+	return true;
+}
+
+
+
+
+
+NIBBLETYPE cWorld::GetBlockSkyLight(int a_BlockX, int a_BlockY, int a_BlockZ)
+{
+	return 15;
+}
+
+
+
+
+
+bool cWorld::IsChunkLighted(int a_ChunkX, int a_ChunkZ)
+{
+	return true;
+}
+
+
+
+
+
+void cWorld::QueueLightChunk(int a_ChunkX, int a_ChunkZ, cChunkCoordCallback * a_Callback)
+{
+}
+
+
+
+
+
+bool cWorld::SetTrapdoorOpen(int a_BlockX, int a_BlockY, int a_BlockZ, bool a_Open)
+{
+	return false;
+}
+
+
+
+
+
+void cWorld::SpawnPrimedTNT(double a_X, double a_Y, double a_Z, int a_FuseTimeInSec, double a_InitialVelocityCoeff)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// cChunkInterface:
+
+BLOCKTYPE cChunkInterface::GetBlock(int a_BlockX, int a_BlockY, int a_BlockZ)
+{
+	return E_BLOCK_AIR;
+}
+
+
+
+
+
+NIBBLETYPE cChunkInterface::GetBlockMeta(int a_BlockX, int a_BlockY, int a_BlockZ)
+{
+	return 0;
+}
+
+
+
+
+
+void cChunkInterface::SetBlockMeta(int a_BlockX, int a_BlockY, int a_BlockZ, NIBBLETYPE a_MetaData)
+{
+}
+
+
+
+
+
+bool cChunkInterface::ForEachChunkInRect(int a_MinChunkX, int a_MaxChunkX, int a_MinChunkZ, int a_MaxChunkZ, cChunkDataCallback & a_Callback)
+{
+	return false;
+}
+
+
+
+
+
+bool cChunkInterface::WriteBlockArea(cBlockArea & a_Area, int a_MinBlockX, int a_MinBlockY, int a_MinBlockZ, int a_DataTypes)
+{
+	return false;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Block handlers:
+
+cBlockHandler * cBlockHandler::CreateBlockHandler(BLOCKTYPE a_BlockType)
+{
+	// The simulators don't use the handlers for the wires, torches and repeaters:
+	return nullptr;
+}
+
+
+
+
+
+void cBlockPistonHandler::ExtendPiston(int a_BlockX, int a_BlockY, int a_BlockZ, cWorld * a_World)
+{
+}
+
+
+
+
+
+void cBlockPistonHandler::RetractPiston(int a_BlockX, int a_BlockY, int a_BlockZ, cWorld * a_World)
+{
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Items, used by the chest entity header:
+
+cEnchantments::cEnchantments(const AString & a_StringSpec)
+{
+}
+
+
+
+
+
+void cEnchantments::Clear(void)
+{
+}
+
+
+
+
+
+AString ItemToFullString(const cItem & a_Item)
+{
+	return "";
+}
+
+
+
+